@@ -0,0 +1,690 @@
+/*
+AhoCorasick.c
+
+Multi-pattern substring matcher for the PassFiltEx blacklist.
+
+The old PasswordFilter called wcsstr once per blacklist token, so the cost of every password change grew with
+the size of the blacklist. This module compiles all of the tokens into one Aho-Corasick automaton, so that every
+occurrence of every token is found in a single pass over the password, no matter how many tokens there are.
+
+  - Platform-neutral C. Only the C runtime is used here, so the same file builds into the DLL and into tools on other platforms.
+
+  - Patterns are bytes. Password characters are 16-bit UTF-16 code units. A code unit that does not fit into a byte can't
+    be part of any token, so it simply sends the automaton back to the root.
+
+  - States are numbered in breadth-first order and every table is a flat array addressed by index, no pointers.
+    Breadth-first order keeps the shallow, hot states close together in memory.
+
+  - Each state knows the nearest state on its failure chain that ends a pattern (the dictionary link.) Following those
+    links from AcFirstMatch visits every pattern that ends at the current position, longest first.
+
+  - A big list can be built on several threads (see WorkerPool.c). Tokens that start with different bytes never share a trie
+    node, so separate builders can each take a range of first bytes, and AcBuilderAppend puts their tries together after. In
+    AcBuilderCompile, a state's failure link only depends on states that are closer to the root, so once one depth is done,
+    all of the states at the next depth can be worked on at the same time. The result is the same, whatever the thread count.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "AhoCorasick.h"
+
+#include "Strength.h"
+
+#include "WorkerPool.h"
+
+// Compiling is only split into tasks of at least this many states. Most depths of a small list are done on one thread.
+#define AC_COMPILE_TASK_STATES 4096
+
+typedef struct AC_BUILD_NODE
+{
+	uint32_t FirstChild;
+
+	uint32_t NextSibling;
+
+	uint32_t PatternId;
+
+	uint16_t Depth;
+
+	uint8_t Label;
+
+} AC_BUILD_NODE;
+
+struct AC_BUILDER
+{
+	AC_BUILD_NODE* Nodes;
+
+	uint32_t NodeCount;
+
+	uint32_t NodeCapacity;
+
+	uint32_t PatternCount;
+};
+
+static bool AcBuilderGrow(AC_BUILDER* Builder)
+{
+	if (Builder->NodeCount < Builder->NodeCapacity)
+	{
+		return(true);
+	}
+
+	if (Builder->NodeCapacity >= UINT32_MAX / 2)
+	{
+		return(false);
+	}
+
+	uint32_t NewCapacity = Builder->NodeCapacity * 2;
+
+	AC_BUILD_NODE* NewNodes = realloc(Builder->Nodes, (size_t)NewCapacity * sizeof(AC_BUILD_NODE));
+
+	if (NewNodes == NULL)
+	{
+		return(false);
+	}
+
+	Builder->Nodes = NewNodes;
+
+	Builder->NodeCapacity = NewCapacity;
+
+	return(true);
+}
+
+// Returns the index of the edge leaving State with Label, or UINT32_MAX if there is no such edge.
+static uint32_t AcFindEdge(const AC_AUTOMATON* Automaton, uint32_t State, uint8_t Label)
+{
+	const AC_STATE* Current = &Automaton->States[State];
+
+	uint32_t Low = Current->FirstEdge;
+
+	uint32_t High = Current->FirstEdge + Current->EdgeCount;
+
+	// Edges are sorted by label. Most states have one or two edges, so this loop is short.
+	while (Low < High)
+	{
+		uint32_t Middle = Low + ((High - Low) / 2);
+
+		if (Automaton->EdgeLabels[Middle] < Label)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+
+	if (Low < Current->FirstEdge + Current->EdgeCount && Automaton->EdgeLabels[Low] == Label)
+	{
+		return(Low);
+	}
+
+	return(UINT32_MAX);
+}
+
+AC_BUILDER* AcBuilderCreate(void)
+{
+	AC_BUILDER* Builder = calloc(1, sizeof(AC_BUILDER));
+
+	if (Builder == NULL)
+	{
+		return(NULL);
+	}
+
+	Builder->NodeCapacity = 1024;
+
+	if ((Builder->Nodes = calloc(Builder->NodeCapacity, sizeof(AC_BUILD_NODE))) == NULL)
+	{
+		free(Builder);
+
+		return(NULL);
+	}
+
+	Builder->Nodes[AC_ROOT_STATE].PatternId = AC_NO_PATTERN;
+
+	Builder->NodeCount = 1;
+
+	return(Builder);
+}
+
+// Empty patterns are ignored. If the same pattern is added twice, the first PatternId wins.
+bool AcBuilderAddPattern(AC_BUILDER* Builder, const uint8_t* Pattern, uint32_t Length, uint32_t PatternId)
+{
+	uint32_t Current = AC_ROOT_STATE;
+
+	if (Length == 0)
+	{
+		return(true);
+	}
+
+	if (Length > UINT16_MAX || PatternId == AC_NO_PATTERN)
+	{
+		return(false);
+	}
+
+	for (uint32_t Position = 0; Position < Length; Position++)
+	{
+		uint32_t Previous = 0;
+
+		uint32_t Child = Builder->Nodes[Current].FirstChild;
+
+		// Children are kept sorted by label so that the compiled edge lists come out sorted for free.
+		while (Child != 0 && Builder->Nodes[Child].Label < Pattern[Position])
+		{
+			Previous = Child;
+
+			Child = Builder->Nodes[Child].NextSibling;
+		}
+
+		if (Child != 0 && Builder->Nodes[Child].Label == Pattern[Position])
+		{
+			Current = Child;
+
+			continue;
+		}
+
+		if (AcBuilderGrow(Builder) == false)
+		{
+			return(false);
+		}
+
+		uint32_t NewNode = Builder->NodeCount++;
+
+		Builder->Nodes[NewNode].FirstChild = 0;
+
+		Builder->Nodes[NewNode].NextSibling = Child;
+
+		Builder->Nodes[NewNode].PatternId = AC_NO_PATTERN;
+
+		Builder->Nodes[NewNode].Depth = (uint16_t)(Position + 1);
+
+		Builder->Nodes[NewNode].Label = Pattern[Position];
+
+		if (Previous == 0)
+		{
+			Builder->Nodes[Current].FirstChild = NewNode;
+		}
+		else
+		{
+			Builder->Nodes[Previous].NextSibling = NewNode;
+		}
+
+		Current = NewNode;
+	}
+
+	if (Builder->Nodes[Current].PatternId == AC_NO_PATTERN)
+	{
+		Builder->Nodes[Current].PatternId = PatternId;
+
+		Builder->PatternCount++;
+	}
+
+	return(true);
+}
+
+// States from First up to Last, split into TaskStates at a time.
+typedef struct AC_COMPILE_TASKS
+{
+	const AC_BUILDER* Builder;
+
+	AC_AUTOMATON* Automaton;
+
+	const uint32_t* Order;
+
+	uint32_t First;
+
+	uint32_t Last;
+
+	uint32_t TaskStates;
+
+} AC_COMPILE_TASKS;
+
+// Runs Routine over the states from First up to Last, on as many threads as that is worth.
+static void AcRunTasks(const WORKER_POOL* Pool, AC_COMPILE_TASKS* Tasks, uint32_t First, uint32_t Last, WORKER_POOL_ROUTINE Routine)
+{
+	uint32_t States = Last - First;
+
+	uint32_t TaskStates = States / (WorkerPoolThreadCount(Pool) * 4);
+
+	Tasks->First = First;
+
+	Tasks->Last = Last;
+
+	Tasks->TaskStates = (TaskStates > AC_COMPILE_TASK_STATES) ? TaskStates : AC_COMPILE_TASK_STATES;
+
+	WorkerPoolRun(Pool, (States + Tasks->TaskStates - 1) / Tasks->TaskStates, Routine, Tasks);
+}
+
+// A compile task's states are Start up to, but not including, *End.
+static uint32_t AcTaskStates(const AC_COMPILE_TASKS* Tasks, uint32_t Task, uint32_t* End)
+{
+	uint32_t Start = Tasks->First + (Task * Tasks->TaskStates);
+
+	*End = (Tasks->Last - Start > Tasks->TaskStates) ? Start + Tasks->TaskStates : Tasks->Last;
+
+	return(Start);
+}
+
+// Copies each state's depth, pattern and edges out of the builder. Every node but the root is the target of exactly one edge,
+// and the edges are numbered in the same breadth-first order as the states, so edge i always leads to state i + 1.
+static void AcFillStates(void* Context, uint32_t Task)
+{
+	const AC_COMPILE_TASKS* Tasks = Context;
+
+	AC_AUTOMATON* Automaton = Tasks->Automaton;
+
+	uint32_t End = 0;
+
+	for (uint32_t State = AcTaskStates(Tasks, Task, &End); State < End; State++)
+	{
+		const AC_BUILD_NODE* Node = &Tasks->Builder->Nodes[Tasks->Order[State]];
+
+		uint32_t Edge = Automaton->States[State].FirstEdge;
+
+		Automaton->States[State].Depth = Node->Depth;
+
+		Automaton->States[State].PatternId = Node->PatternId;
+
+		for (uint32_t Child = Node->FirstChild; Child != 0; Child = Tasks->Builder->Nodes[Child].NextSibling)
+		{
+			Automaton->EdgeLabels[Edge] = Tasks->Builder->Nodes[Child].Label;
+
+			Automaton->EdgeTargets[Edge] = Edge + 1;
+
+			Edge++;
+		}
+	}
+}
+
+// Sets the failure and dictionary links of the children of a range of states, which must all be at the same depth, and have
+// links of their own already.
+static void AcLinkChildren(void* Context, uint32_t Task)
+{
+	const AC_COMPILE_TASKS* Tasks = Context;
+
+	AC_AUTOMATON* Automaton = Tasks->Automaton;
+
+	uint32_t End = 0;
+
+	for (uint32_t State = AcTaskStates(Tasks, Task, &End); State < End; State++)
+	{
+		const AC_STATE* Parent = &Automaton->States[State];
+
+		for (uint32_t Edge = Parent->FirstEdge; Edge < Parent->FirstEdge + Parent->EdgeCount; Edge++)
+		{
+			AC_STATE* Child = &Automaton->States[Automaton->EdgeTargets[Edge]];
+
+			uint32_t Failure = AC_ROOT_STATE;
+
+			if (State != AC_ROOT_STATE)
+			{
+				uint32_t Candidate = Parent->Failure;
+
+				while (true)
+				{
+					uint32_t Found = AcFindEdge(Automaton, Candidate, Automaton->EdgeLabels[Edge]);
+
+					if (Found != UINT32_MAX)
+					{
+						Failure = Automaton->EdgeTargets[Found];
+
+						break;
+					}
+
+					if (Candidate == AC_ROOT_STATE)
+					{
+						break;
+					}
+
+					Candidate = Automaton->States[Candidate].Failure;
+				}
+			}
+
+			Child->Failure = Failure;
+
+			Child->DictionaryLink = (Automaton->States[Failure].PatternId != AC_NO_PATTERN) ? Failure : Automaton->States[Failure].DictionaryLink;
+		}
+	}
+}
+
+/*
+Puts all of Other's patterns into Builder, as if they had been added to it. Every pattern in Other must start with a byte that
+is greater than the first byte of every pattern in Builder. Other is left alone.
+
+*/
+bool AcBuilderAppend(AC_BUILDER* Builder, const AC_BUILDER* Other)
+{
+	uint32_t Offset = Builder->NodeCount - 1;
+
+	uint32_t Last = 0;
+
+	if (Other->NodeCount <= 1)
+	{
+		return(true);
+	}
+
+	if ((uint64_t)Builder->NodeCount + Other->NodeCount - 1 > UINT32_MAX / 2)
+	{
+		return(false);
+	}
+
+	uint32_t NodeCount = Builder->NodeCount + Other->NodeCount - 1;
+
+	if (NodeCount > Builder->NodeCapacity)
+	{
+		AC_BUILD_NODE* NewNodes = realloc(Builder->Nodes, (size_t)NodeCount * sizeof(AC_BUILD_NODE));
+
+		if (NewNodes == NULL)
+		{
+			return(false);
+		}
+
+		Builder->Nodes = NewNodes;
+
+		Builder->NodeCapacity = NodeCount;
+	}
+
+	// Other's root goes away, and node i of Other becomes node Offset + i. 0 still means "none".
+	for (uint32_t Node = 1; Node < Other->NodeCount; Node++)
+	{
+		AC_BUILD_NODE* Copy = &Builder->Nodes[Offset + Node];
+
+		*Copy = Other->Nodes[Node];
+
+		Copy->FirstChild = (Copy->FirstChild != 0) ? Copy->FirstChild + Offset : 0;
+
+		Copy->NextSibling = (Copy->NextSibling != 0) ? Copy->NextSibling + Offset : 0;
+	}
+
+	for (uint32_t Child = Builder->Nodes[AC_ROOT_STATE].FirstChild; Child != 0; Child = Builder->Nodes[Child].NextSibling)
+	{
+		Last = Child;
+	}
+
+	if (Last == 0)
+	{
+		Builder->Nodes[AC_ROOT_STATE].FirstChild = Other->Nodes[AC_ROOT_STATE].FirstChild + Offset;
+	}
+	else
+	{
+		Builder->Nodes[Last].NextSibling = Other->Nodes[AC_ROOT_STATE].FirstChild + Offset;
+	}
+
+	Builder->NodeCount = NodeCount;
+
+	Builder->PatternCount += Other->PatternCount;
+
+	return(true);
+}
+
+// Pool may be NULL, to compile on the calling thread alone.
+AC_AUTOMATON* AcBuilderCompile(const AC_BUILDER* Builder, const WORKER_POOL* Pool)
+{
+	AC_AUTOMATON* Automaton = NULL;
+
+	uint32_t* Order = NULL;
+
+	AC_COMPILE_TASKS Tasks = { 0 };
+
+	uint32_t NodeCount = Builder->NodeCount;
+
+	if ((Order = malloc((size_t)NodeCount * sizeof(uint32_t))) == NULL)
+	{
+		goto Failed;
+	}
+
+	if ((Automaton = calloc(1, sizeof(AC_AUTOMATON))) == NULL)
+	{
+		goto Failed;
+	}
+
+	Automaton->StateCount = NodeCount;
+
+	Automaton->EdgeCount = NodeCount - 1;
+
+	Automaton->PatternCount = Builder->PatternCount;
+
+	Automaton->Coverage = AC_DEFAULT_COVERAGE;
+
+	// Every node except the root is the target of exactly one edge. The +1 keeps malloc(0) out of the picture.
+	if ((Automaton->States = calloc(NodeCount, sizeof(AC_STATE))) == NULL ||
+		(Automaton->EdgeLabels = malloc((size_t)NodeCount + 1)) == NULL ||
+		(Automaton->EdgeTargets = malloc(((size_t)NodeCount + 1) * sizeof(uint32_t))) == NULL)
+	{
+		goto Failed;
+	}
+
+	// The order in which we pull nodes off of this queue becomes their final state number. A state's edges lead to the
+	// children it adds to the queue, so they are numbered here as well.
+	uint32_t Head = 0;
+
+	uint32_t Tail = 0;
+
+	Order[Tail++] = AC_ROOT_STATE;
+
+	while (Head < Tail)
+	{
+		AC_STATE* State = &Automaton->States[Head];
+
+		uint32_t Node = Order[Head++];
+
+		State->FirstEdge = Tail - 1;
+
+		for (uint32_t Child = Builder->Nodes[Node].FirstChild; Child != 0; Child = Builder->Nodes[Child].NextSibling)
+		{
+			Order[Tail++] = Child;
+		}
+
+		State->EdgeCount = (uint16_t)(Tail - 1 - State->FirstEdge);
+	}
+
+	Tasks.Builder = Builder;
+
+	Tasks.Automaton = Automaton;
+
+	Tasks.Order = Order;
+
+	AcRunTasks(Pool, &Tasks, 0, NodeCount, AcFillStates);
+
+	for (uint32_t Label = 0; Label < AC_ALPHABET_SIZE; Label++)
+	{
+		uint32_t Edge = AcFindEdge(Automaton, AC_ROOT_STATE, (uint8_t)Label);
+
+		Automaton->RootTransitions[Label] = (Edge == UINT32_MAX) ? AC_ROOT_STATE : Automaton->EdgeTargets[Edge];
+	}
+
+	// A state's failure target is always closer to the root, so it and its dictionary link are final once every depth above
+	// it has been done. States are in breadth-first order, so each depth is one run of them.
+	for (uint32_t First = 0; First < NodeCount;)
+	{
+		uint32_t Last = First;
+
+		while (Last < NodeCount && Automaton->States[Last].Depth == Automaton->States[First].Depth)
+		{
+			Last++;
+		}
+
+		AcRunTasks(Pool, &Tasks, First, Last, AcLinkChildren);
+
+		First = Last;
+	}
+
+	free(Order);
+
+	return(Automaton);
+
+Failed:
+
+	free(Order);
+
+	AcDestroy(Automaton);
+
+	return(NULL);
+}
+
+void AcBuilderDestroy(AC_BUILDER* Builder)
+{
+	if (Builder != NULL)
+	{
+		free(Builder->Nodes);
+
+		free(Builder);
+	}
+}
+
+void AcDestroy(AC_AUTOMATON* Automaton)
+{
+	if (Automaton == NULL)
+	{
+		return;
+	}
+
+	if (Automaton->TablesBorrowed == false)
+	{
+		free(Automaton->States);
+
+		free(Automaton->EdgeLabels);
+
+		free(Automaton->EdgeTargets);
+
+		free(Automaton->PatternCoverage);
+
+		free(Automaton->Reach);
+
+		free(Automaton->Span);
+	}
+
+	free(Automaton->Strength);
+
+	free(Automaton);
+}
+
+size_t AcMemoryUsage(const AC_AUTOMATON* Automaton)
+{
+	if (Automaton == NULL)
+	{
+		return(0);
+	}
+
+	size_t Size = sizeof(AC_AUTOMATON) +
+		((size_t)Automaton->StateCount * sizeof(AC_STATE)) +
+		((size_t)Automaton->EdgeCount * (sizeof(uint8_t) + sizeof(uint32_t)));
+
+	if (Automaton->Reach != NULL)
+	{
+		Size += (size_t)Automaton->PatternCount + ((size_t)Automaton->StateCount * 2 * sizeof(uint16_t));
+	}
+
+	if (Automaton->Strength != NULL)
+	{
+		Size += sizeof(STRENGTH_TABLES);
+	}
+
+	return(Size);
+}
+
+uint32_t AcNextState(const AC_AUTOMATON* Automaton, uint32_t State, uint16_t Character)
+{
+	if (Character >= AC_ALPHABET_SIZE)
+	{
+		return(AC_ROOT_STATE);
+	}
+
+	while (State != AC_ROOT_STATE)
+	{
+		uint32_t Edge = AcFindEdge(Automaton, State, (uint8_t)Character);
+
+		if (Edge != UINT32_MAX)
+		{
+			return(Automaton->EdgeTargets[Edge]);
+		}
+
+		State = Automaton->States[State].Failure;
+	}
+
+	return(Automaton->RootTransitions[Character]);
+}
+
+// Returns the state of the longest pattern ending at State, or AC_ROOT_STATE if no pattern ends here.
+// Continue with States[Match].DictionaryLink to visit the shorter ones.
+uint32_t AcFirstMatch(const AC_AUTOMATON* Automaton, uint32_t State)
+{
+	if (Automaton->States[State].PatternId != AC_NO_PATTERN)
+	{
+		return(State);
+	}
+
+	return(Automaton->States[State].DictionaryLink);
+}
+
+// The share of a password, in percent, that the pattern has to make up to reject it on its own.
+uint32_t AcPatternCoverage(const AC_AUTOMATON* Automaton, uint32_t PatternId)
+{
+	if (Automaton->PatternCoverage == NULL)
+	{
+		return(Automaton->Coverage);
+	}
+
+	return(Automaton->PatternCoverage[PatternId] & AC_COVERAGE_PERCENT);
+}
+
+/*
+What Reach and Span should be for State, worked out from its own pattern, if any, and from the tables at its dictionary link.
+A pattern of Depth characters and a coverage of C percent rejects a password of up to Depth * 100 / C characters, rounded down,
+so one comparison against the password's length stands in for every pattern on the chain. The link is always closer to the
+root, so going through the states in order fills the tables in one pass. The root's are 0.
+
+*/
+void AcStateReach(const AC_AUTOMATON* Automaton, uint32_t State, uint16_t* Reach, uint16_t* Span)
+{
+	const AC_STATE* Current = &Automaton->States[State];
+
+	*Reach = 0;
+
+	*Span = 0;
+
+	if (State == AC_ROOT_STATE)
+	{
+		return;
+	}
+
+	*Reach = Automaton->Reach[Current->DictionaryLink];
+
+	*Span = Automaton->Span[Current->DictionaryLink];
+
+	if (Current->PatternId != AC_NO_PATTERN)
+	{
+		uint8_t Coverage = Automaton->PatternCoverage[Current->PatternId];
+
+		uint32_t Own = ((uint32_t)Current->Depth * 100) / (Coverage & AC_COVERAGE_PERCENT);
+
+		if (Own > *Reach)
+		{
+			*Reach = (uint16_t)Own;
+		}
+
+		// Longer than anything on the chain, which is all closer to the root.
+		if ((Coverage & AC_COVERAGE_EXACT) == 0)
+		{
+			*Span = Current->Depth;
+		}
+	}
+}
+
+// Fills in Reach and Span from PatternCoverage, which must already be there.
+bool AcBuildReach(AC_AUTOMATON* Automaton)
+{
+	if ((Automaton->Reach = malloc((size_t)Automaton->StateCount * sizeof(uint16_t))) == NULL ||
+		(Automaton->Span = malloc((size_t)Automaton->StateCount * sizeof(uint16_t))) == NULL)
+	{
+		return(false);
+	}
+
+	for (uint32_t State = 0; State < Automaton->StateCount; State++)
+	{
+		AcStateReach(Automaton, State, &Automaton->Reach[State], &Automaton->Span[State]);
+	}
+
+	return(true);
+}
@@ -0,0 +1,128 @@
+// Please read AhoCorasick.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "WorkerPool.h"
+
+#define AC_ROOT_STATE 0
+
+#define AC_NO_PATTERN 0xFFFFFFFF
+
+// Blacklist tokens are read from the file one byte at a time, so every pattern character fits in a byte.
+// Password characters above this range can never be part of a match.
+#define AC_ALPHABET_SIZE 256
+
+// How much of a password a token has to make up to reject it, in percent, unless the blacklist says otherwise. See Blacklist.c.
+#define AC_DEFAULT_COVERAGE 50
+
+// In PatternCoverage, the percent is in the low bits, and this bit marks a token that only rejects a password it is all of.
+#define AC_COVERAGE_PERCENT 0x7F
+
+#define AC_COVERAGE_EXACT 0x80
+
+typedef struct AC_STATE
+{
+	uint32_t FirstEdge;
+
+	uint16_t EdgeCount;
+
+	// Depth of a state is the length of the pattern that ends on it, if any.
+	uint16_t Depth;
+
+	uint32_t Failure;
+
+	// Nearest state on the failure chain that ends a pattern, or AC_ROOT_STATE if there is none.
+	uint32_t DictionaryLink;
+
+	uint32_t PatternId;
+
+} AC_STATE;
+
+// All tables are flat arrays addressed by index so that the automaton can be copied or mapped as-is.
+typedef struct AC_AUTOMATON
+{
+	uint32_t StateCount;
+
+	uint32_t EdgeCount;
+
+	uint32_t PatternCount;
+
+	AC_STATE* States;
+
+	uint8_t* EdgeLabels;
+
+	uint32_t* EdgeTargets;
+
+	uint32_t RootTransitions[AC_ALPHABET_SIZE];
+
+	// The blacklist's substitution map, if it has one (see BlacklistCanonicalize). It travels with the tables so that it can never
+	// be separated from the patterns that were built with it. Not used by the matcher itself.
+	bool Substituting;
+
+	uint8_t Substitutions[AC_ALPHABET_SIZE];
+
+	// The blacklist's !distance, or 0 for exact matches only (see FuzzyMatch.c). Like the map, it is only carried here.
+	uint8_t EditDistance;
+
+	// The blacklist's !coverage and !combined (0 when it has none), which the matcher does use. See BlacklistFindToken.
+	uint8_t Coverage;
+
+	uint8_t CombinedCoverage;
+
+	// Only there when the blacklist has !rule lines, and NULL otherwise. PatternCoverage is each pattern's coverage, by pattern ID.
+	// For each state, Reach is the longest password that a pattern ending there, or on its dictionary links, rejects on its own,
+	// and Span is the longest of those patterns that counts toward !combined. See AcStateReach.
+	uint8_t* PatternCoverage;
+
+	uint16_t* Reach;
+
+	uint16_t* Span;
+
+	// The blacklist's !strength, or 0 for none, and the tables that estimates look things up in, which are only there when it has
+	// one. They are always built when the blacklist is loaded, never mapped, so AcDestroy frees them even when the rest is borrowed.
+	uint8_t MinimumStrength;
+
+	struct STRENGTH_TABLES* Strength;
+
+	// Set when the tables belong to someone else, e.g. a mapped blacklist image. AcDestroy then only frees this structure.
+	bool TablesBorrowed;
+
+} AC_AUTOMATON;
+
+typedef struct AC_BUILDER AC_BUILDER;
+
+AC_BUILDER* AcBuilderCreate(void);
+
+bool AcBuilderAddPattern(AC_BUILDER* Builder, const uint8_t* Pattern, uint32_t Length, uint32_t PatternId);
+
+bool AcBuilderAppend(AC_BUILDER* Builder, const AC_BUILDER* Other);
+
+AC_AUTOMATON* AcBuilderCompile(const AC_BUILDER* Builder, const WORKER_POOL* Pool);
+
+void AcBuilderDestroy(AC_BUILDER* Builder);
+
+void AcDestroy(AC_AUTOMATON* Automaton);
+
+size_t AcMemoryUsage(const AC_AUTOMATON* Automaton);
+
+uint32_t AcNextState(const AC_AUTOMATON* Automaton, uint32_t State, uint16_t Character);
+
+uint32_t AcFirstMatch(const AC_AUTOMATON* Automaton, uint32_t State);
+
+uint32_t AcPatternCoverage(const AC_AUTOMATON* Automaton, uint32_t PatternId);
+
+void AcStateReach(const AC_AUTOMATON* Automaton, uint32_t State, uint16_t* Reach, uint16_t* Span);
+
+bool AcBuildReach(AC_AUTOMATON* Automaton);
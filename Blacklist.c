@@ -0,0 +1,1439 @@
+/*
+Blacklist.c
+
+The parts of the password filter that don't care which operating system they run on: turning lines of the blacklist
+file into tokens, compiling the tokens, and judging a password against them.
+
+PassFiltEx.c uses these from inside lsass, and PassFiltExTool uses the very same code to compile and verify blacklist
+images offline, so the two can never disagree about what a token is or when a password is rejected.
+
+Substitutions:
+
+Catching "P@ssw0rd" and "pa55word" used to take a line for every variant, and the number of variants grows with the product
+of the substitutions in each word. Instead, lines at the top of the blacklist can say which characters are interchangeable:
+
+  !substitute a@4
+  !substitute il1!|
+  !substitute o0
+  !substitute s$5
+
+Every character on a line becomes the same character, both in the tokens as they are loaded and in every password before it
+is matched, so one token covers all of its spellings. A character that could stand for either of two letters, such as 1 for
+l or i, simply joins both of them in one group. That costs no more than any other substitution, where trying each reading
+in turn would double the work for every 1 in a password. The price is that "pail" and "paii" now look the same, which for a
+blacklist errs on the safe side. Each group is written as its lowest letter, or its lowest character if it has no letters, so
+that matched tokens still read well in the trace.
+
+The directives have to come before the first token, since each token is rewritten as it is read.
+
+Typos:
+
+A line "!distance 1" (or 2, up to FUZZY_MAX_DISTANCE) makes a password fail when part of it is within that many edits of a
+token, so that "passwprd" fails on "password" as well. See FuzzyMatch.c for how, and for how short tokens are treated. It only
+changes how passwords are judged, not the tokens, so it can go anywhere in the file; the last one counts.
+
+Rules:
+
+A password used to be rejected by any token that made up at least half of it. That is now the default for a blacklist's
+coverage, which can be changed, for the whole list and for single tokens:
+
+  !coverage 60          a token has to make up at least 60% of a password to reject it
+  !combined 80          two or more tokens together that make up at least 80% of a password reject it too
+  !rule exact summer    this token only rejects a password that is all of it, and doesn't count toward !combined
+  !rule 30 contoso      this one rejects a password it makes up at least 30% of
+
+!coverage and !combined can go anywhere, and the last of each counts. A !rule line adds its token just as a line of the token
+alone would, so no !substitute can come after it, and the last rule for a token counts. Rules are compiled with the
+automaton into a coverage for every token, and from that a table that says, for each state, the longest password that a token
+ending there rejects. So however many rules there are, judging a password is still one pass over it, with a comparison or two
+for each character, and no floating point. See BlacklistFindToken. Rules apply to exact matches and typos (see FuzzyMatch.c),
+and !combined to exact matches only.
+
+Strength:
+
+A line "!strength 8" (up to STRENGTH_MAX_MINIMUM) rejects passwords that would take fewer than 10^8 guesses, however little of
+them any one token makes up: "Summer2019!" and "qwertyuiop" alike. It is checked after everything else, with the tokens of
+this list as the dictionary (see Strength.c). Like !distance, it can go anywhere, and the last one counts.
+
+Threads:
+
+BlacklistLoad can spread the work over a WorkerPool (see WorkerPool.c). The lines up to the first token are read first, on
+their own, since the substitutions they set up change every token after them. The rest of the file is cut into pieces at line
+breaks, and each piece is parsed, folded, sorted and deduplicated into a token store of its own at the same time as the others.
+The stores are merged in pairs, a round at a time, until one is left. Then each thread puts the tokens that start with its own
+range of bytes into a trie, the tries are joined, and the automaton is compiled a depth at a time (see AhoCorasick.c). The
+token store and the automaton come out exactly the same as they would on one thread.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistParser.h"
+
+#include "FuzzyMatch.h"
+
+#include "Normalize.h"
+
+#include "Platform.h"
+
+#include "Strength.h"
+
+// Files are cut into this many pieces for each thread, so that a thread that gets a slow piece doesn't hold up the rest for long.
+#define BLACKLIST_PIECES_PER_THREAD 2
+
+// No piece is made smaller than this, as each one costs a token store and a merge.
+#define BLACKLIST_MIN_PIECE_SIZE (256 * 1024)
+
+// Lists with fewer tokens than this are put into one trie.
+#define BLACKLIST_MIN_SHARD_TOKENS 65536
+
+// No !distance line can set this, so pieces of the file that didn't have one can be told apart from those that did.
+#define BLACKLIST_NO_DISTANCE 0xFF
+
+typedef struct BLACKLIST_LOAD_PIECE
+{
+	const uint8_t* Data;
+
+	size_t Size;
+
+	BLACKLIST_LOAD_CONTEXT LoadContext;
+
+	BLACKLIST_PARSER Parser;
+
+	uint32_t TokensAdded;
+
+	TOKEN_STORE Tokens;
+
+	bool Failed;
+
+} BLACKLIST_LOAD_PIECE;
+
+// One round of merging token stores in pairs. The odd one out, if there is one, is carried over to the next round as it is.
+typedef struct BLACKLIST_MERGE_ROUND
+{
+	TOKEN_STORE* Stores;
+
+	uint32_t StoreCount;
+
+	TOKEN_STORE* Merged;
+
+	bool* Failed;
+
+} BLACKLIST_MERGE_ROUND;
+
+// The tokens, which are sorted, cut into ranges that never share a first byte. Shard i is Starts[i] up to Starts[i + 1].
+typedef struct BLACKLIST_TRIE_SHARDS
+{
+	const TOKEN_STORE* Tokens;
+
+	uint32_t Starts[WORKER_POOL_MAX_THREADS + 1];
+
+	AC_BUILDER* Builders[WORKER_POOL_MAX_THREADS];
+
+} BLACKLIST_TRIE_SHARDS;
+
+static uint8_t FindGroup(uint8_t* Parents, uint8_t Character)
+{
+	while (Parents[Character] != Character)
+	{
+		Parents[Character] = Parents[Parents[Character]];
+
+		Character = Parents[Character];
+	}
+
+	return(Character);
+}
+
+// Joins every character of a !substitute line into one group. Spaces are there for readability and are left out.
+static void AddSubstitutions(BLACKLIST_LOAD_CONTEXT* LoadContext, const uint8_t* Characters, uint32_t Length)
+{
+	if (LoadContext->Substituting == false)
+	{
+		for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+		{
+			LoadContext->Substitutions[Character] = (uint8_t)Character;
+		}
+
+		LoadContext->Substituting = true;
+	}
+
+	int32_t First = -1;
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		if (Characters[Index] == ' ' || Characters[Index] == '\t')
+		{
+			continue;
+		}
+
+		if (First < 0)
+		{
+			First = FindGroup(LoadContext->Substitutions, Characters[Index]);
+
+			continue;
+		}
+
+		LoadContext->Substitutions[FindGroup(LoadContext->Substitutions, Characters[Index])] = (uint8_t)First;
+	}
+}
+
+static bool IsLetter(uint32_t Character)
+{
+	return(Character >= 'a' && Character <= 'z');
+}
+
+/*
+Turns the union-find forest into the finished map, with each group written as its lowest letter if it has one, and as its lowest
+character otherwise. Returns the map, or NULL if the blacklist has no substitutions. No !substitute lines are taken after this.
+
+*/
+const uint8_t* BlacklistSubstitutions(BLACKLIST_LOAD_CONTEXT* LoadContext)
+{
+	if (LoadContext->Substituting && LoadContext->SubstitutionsFinal == false)
+	{
+		uint8_t Groups[AC_ALPHABET_SIZE];
+
+		uint8_t Names[AC_ALPHABET_SIZE];
+
+		bool Named[AC_ALPHABET_SIZE] = { false };
+
+		for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+		{
+			Groups[Character] = FindGroup(LoadContext->Substitutions, (uint8_t)Character);
+		}
+
+		// Letters first, then everything else, each in ascending order, so a group is named after the first member to come up.
+		for (uint32_t Pass = 0; Pass < 2; Pass++)
+		{
+			for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+			{
+				if (IsLetter(Character) != (Pass == 0) || Named[Groups[Character]])
+				{
+					continue;
+				}
+
+				Names[Groups[Character]] = (uint8_t)Character;
+
+				Named[Groups[Character]] = true;
+			}
+		}
+
+		for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+		{
+			LoadContext->Substitutions[Character] = Names[Groups[Character]];
+		}
+	}
+
+	LoadContext->SubstitutionsFinal = true;
+
+	return(LoadContext->Substituting ? LoadContext->Substitutions : NULL);
+}
+
+static uint32_t SkipBlanks(const uint8_t* Characters, uint32_t Length, uint32_t Index)
+{
+	while (Index < Length && (Characters[Index] == ' ' || Characters[Index] == '\t'))
+	{
+		Index++;
+	}
+
+	return(Index);
+}
+
+// Reads a number of up to three digits from *Index on, and moves *Index past it.
+static bool ParseNumber(const uint8_t* Characters, uint32_t Length, uint32_t* Index, uint32_t* Value)
+{
+	uint32_t Digits = 0;
+
+	*Value = 0;
+
+	while (*Index < Length && Characters[*Index] >= '0' && Characters[*Index] <= '9' && Digits < 3)
+	{
+		*Value = (*Value * 10) + (uint32_t)(Characters[(*Index)++] - '0');
+
+		Digits++;
+	}
+
+	return(Digits > 0);
+}
+
+// "!distance n", after the directive itself. Anything other than one number no greater than FUZZY_MAX_DISTANCE is turned down.
+static bool ParseDistance(const uint8_t* Characters, uint32_t Length, uint8_t* Distance)
+{
+	uint32_t Value = 0;
+
+	uint32_t Index = SkipBlanks(Characters, Length, 0);
+
+	if (ParseNumber(Characters, Length, &Index, &Value) == false || SkipBlanks(Characters, Length, Index) != Length || Value > FUZZY_MAX_DISTANCE)
+	{
+		return(false);
+	}
+
+	*Distance = (uint8_t)Value;
+
+	return(true);
+}
+
+// "!coverage n" or "!combined n", after the directive itself. n is a percent, from 1 to 100.
+static bool ParsePercent(const uint8_t* Characters, uint32_t Length, uint8_t* Percent)
+{
+	uint32_t Value = 0;
+
+	uint32_t Index = SkipBlanks(Characters, Length, 0);
+
+	if (ParseNumber(Characters, Length, &Index, &Value) == false || SkipBlanks(Characters, Length, Index) != Length || Value == 0 || Value > 100)
+	{
+		return(false);
+	}
+
+	*Percent = (uint8_t)Value;
+
+	return(true);
+}
+
+// "!strength n", after the directive itself, from 1 to STRENGTH_MAX_MINIMUM.
+static bool ParseStrength(const uint8_t* Characters, uint32_t Length, uint8_t* Minimum)
+{
+	uint32_t Value = 0;
+
+	uint32_t Index = SkipBlanks(Characters, Length, 0);
+
+	if (ParseNumber(Characters, Length, &Index, &Value) == false || SkipBlanks(Characters, Length, Index) != Length || Value == 0 || Value > STRENGTH_MAX_MINIMUM)
+	{
+		return(false);
+	}
+
+	*Minimum = (uint8_t)Value;
+
+	return(true);
+}
+
+// "!rule exact token" or "!rule n token", after the directive itself. *TokenStart is where the token begins.
+static bool ParseRule(const uint8_t* Characters, uint32_t Length, uint8_t* Coverage, uint32_t* TokenStart)
+{
+	const uint32_t ExactLength = sizeof(BLACKLIST_RULE_EXACT) - 1;
+
+	uint32_t Value = 100 | AC_COVERAGE_EXACT;
+
+	uint32_t Index = SkipBlanks(Characters, Length, 0);
+
+	if (Length - Index >= ExactLength && memcmp(Characters + Index, BLACKLIST_RULE_EXACT, ExactLength) == 0)
+	{
+		Index += ExactLength;
+	}
+	else if (ParseNumber(Characters, Length, &Index, &Value) == false || Value == 0 || Value > 100)
+	{
+		return(false);
+	}
+
+	uint32_t Start = SkipBlanks(Characters, Length, Index);
+
+	// The token is whatever follows the blanks after the coverage, and there has to be one.
+	if (Start == Index || Start == Length)
+	{
+		return(false);
+	}
+
+	*Coverage = (uint8_t)Value;
+
+	*TokenStart = Start;
+
+	return(true);
+}
+
+static bool AddRule(BLACKLIST_LOAD_CONTEXT* LoadContext, uint8_t Coverage, const uint8_t* Token, uint32_t Length)
+{
+	if (LoadContext->RuleCount == LoadContext->RuleCapacity)
+	{
+		uint32_t Capacity = (LoadContext->RuleCapacity > 0) ? LoadContext->RuleCapacity * 2 : 16;
+
+		BLACKLIST_RULE* Rules = realloc(LoadContext->Rules, (size_t)Capacity * sizeof(BLACKLIST_RULE));
+
+		if (Rules == NULL)
+		{
+			return(false);
+		}
+
+		LoadContext->Rules = Rules;
+
+		LoadContext->RuleCapacity = Capacity;
+	}
+
+	BLACKLIST_RULE* Rule = &LoadContext->Rules[LoadContext->RuleCount++];
+
+	Rule->Coverage = Coverage;
+
+	Rule->Length = (uint8_t)Length;
+
+	memcpy(Rule->Token, Token, Length);
+
+	return(true);
+}
+
+// Moves From's rules onto the end of Into's.
+static bool TakeRules(BLACKLIST_LOAD_CONTEXT* Into, BLACKLIST_LOAD_CONTEXT* From)
+{
+	for (uint32_t Index = 0; Index < From->RuleCount; Index++)
+	{
+		const BLACKLIST_RULE* Rule = &From->Rules[Index];
+
+		if (AddRule(Into, Rule->Coverage, Rule->Token, Rule->Length) == false)
+		{
+			return(false);
+		}
+	}
+
+	BlacklistRulesFree(From);
+
+	return(true);
+}
+
+void BlacklistRulesFree(BLACKLIST_LOAD_CONTEXT* LoadContext)
+{
+	free(LoadContext->Rules);
+
+	LoadContext->Rules = NULL;
+
+	LoadContext->RuleCount = 0;
+
+	LoadContext->RuleCapacity = 0;
+}
+
+// A BLACKLIST_LINE_CALLBACK for BlacklistParser.c. Context is a BLACKLIST_LOAD_CONTEXT.
+bool BlacklistAddLine(void* Context, const uint8_t* Line, uint32_t Length)
+{
+	BLACKLIST_LOAD_CONTEXT* LoadContext = Context;
+
+	uint8_t Token[MAX_BLACKLIST_STRING_SIZE] = { 0 };
+
+	if (Length > MAX_BLACKLIST_STRING_SIZE - 1)
+	{
+		Length = MAX_BLACKLIST_STRING_SIZE - 1;
+	}
+
+	memcpy(Token, Line, Length);
+
+	NormalizeTokenBytes(Token, Length);
+
+	const uint32_t DirectiveLength = sizeof(BLACKLIST_SUBSTITUTE_DIRECTIVE) - 1;
+
+	if (Length > DirectiveLength && memcmp(Token, BLACKLIST_SUBSTITUTE_DIRECTIVE, DirectiveLength) == 0)
+	{
+		if (LoadContext->SubstitutionsFinal)
+		{
+			LoadContext->LateDirectives++;
+		}
+		else
+		{
+			AddSubstitutions(LoadContext, Token + DirectiveLength, Length - DirectiveLength);
+
+			LoadContext->Directives++;
+		}
+
+		return(true);
+	}
+
+	const uint32_t DistanceLength = sizeof(BLACKLIST_DISTANCE_DIRECTIVE) - 1;
+
+	if (Length > DistanceLength && memcmp(Token, BLACKLIST_DISTANCE_DIRECTIVE, DistanceLength) == 0)
+	{
+		if (ParseDistance(Token + DistanceLength, Length - DistanceLength, &LoadContext->EditDistance))
+		{
+			LoadContext->Directives++;
+		}
+		else
+		{
+			LoadContext->BadDirectives++;
+		}
+
+		return(true);
+	}
+
+	const uint32_t CoverageLength = sizeof(BLACKLIST_COVERAGE_DIRECTIVE) - 1;
+
+	const uint32_t CombinedLength = sizeof(BLACKLIST_COMBINED_DIRECTIVE) - 1;
+
+	if (Length > CoverageLength && memcmp(Token, BLACKLIST_COVERAGE_DIRECTIVE, CoverageLength) == 0)
+	{
+		if (ParsePercent(Token + CoverageLength, Length - CoverageLength, &LoadContext->Coverage))
+		{
+			LoadContext->Directives++;
+		}
+		else
+		{
+			LoadContext->BadDirectives++;
+		}
+
+		return(true);
+	}
+
+	if (Length > CombinedLength && memcmp(Token, BLACKLIST_COMBINED_DIRECTIVE, CombinedLength) == 0)
+	{
+		if (ParsePercent(Token + CombinedLength, Length - CombinedLength, &LoadContext->CombinedCoverage))
+		{
+			LoadContext->Directives++;
+		}
+		else
+		{
+			LoadContext->BadDirectives++;
+		}
+
+		return(true);
+	}
+
+	const uint32_t StrengthLength = sizeof(BLACKLIST_STRENGTH_DIRECTIVE) - 1;
+
+	if (Length > StrengthLength && memcmp(Token, BLACKLIST_STRENGTH_DIRECTIVE, StrengthLength) == 0)
+	{
+		if (ParseStrength(Token + StrengthLength, Length - StrengthLength, &LoadContext->MinimumStrength))
+		{
+			LoadContext->Directives++;
+		}
+		else
+		{
+			LoadContext->BadDirectives++;
+		}
+
+		return(true);
+	}
+
+	// A rule's token is added like any other line, so from here on it is just the token.
+	const uint32_t RuleLength = sizeof(BLACKLIST_RULE_DIRECTIVE) - 1;
+
+	uint8_t RuleCoverage = 0;
+
+	if (Length > RuleLength && memcmp(Token, BLACKLIST_RULE_DIRECTIVE, RuleLength) == 0)
+	{
+		uint32_t TokenStart = 0;
+
+		if (ParseRule(Token + RuleLength, Length - RuleLength, &RuleCoverage, &TokenStart) == false)
+		{
+			LoadContext->BadDirectives++;
+
+			return(true);
+		}
+
+		TokenStart += RuleLength;
+
+		Length -= TokenStart;
+
+		memmove(Token, Token + TokenStart, Length);
+
+		LoadContext->Directives++;
+	}
+
+	const uint8_t* Substitutions = BlacklistSubstitutions(LoadContext);
+
+	if (Substitutions != NULL)
+	{
+		for (uint32_t Index = 0; Index < Length; Index++)
+		{
+			Token[Index] = Substitutions[Token[Index]];
+		}
+	}
+
+	if (TokenStoreBuilderAdd(LoadContext->Builder, Token, Length) == false ||
+		(RuleCoverage != 0 && AddRule(LoadContext, RuleCoverage, Token, Length) == false))
+	{
+		LoadContext->OutOfMemory = true;
+
+		return(false);
+	}
+
+	return(true);
+}
+
+// Puts one shard of the tokens into a trie of its own. Builders[Task] is left NULL if there isn't enough memory.
+static void BlacklistBuildShard(void* Context, uint32_t Task)
+{
+	BLACKLIST_TRIE_SHARDS* Shards = Context;
+
+	AC_BUILDER* Builder = NULL;
+
+	if ((Builder = AcBuilderCreate()) == NULL)
+	{
+		return;
+	}
+
+	for (uint32_t PatternId = Shards->Starts[Task]; PatternId < Shards->Starts[Task + 1]; PatternId++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(Shards->Tokens, PatternId, &Length);
+
+		if (AcBuilderAddPattern(Builder, Token, Length, PatternId) == false)
+		{
+			AcBuilderDestroy(Builder);
+
+			return;
+		}
+	}
+
+	Shards->Builders[Task] = Builder;
+}
+
+static uint8_t FirstByte(const TOKEN_STORE* Tokens, uint32_t Index)
+{
+	uint32_t Length = 0;
+
+	return(*TokenStoreGet(Tokens, Index, &Length));
+}
+
+// Cuts the tokens into up to ShardCount shards of about the same size, each ending where the first byte changes. A list where
+// most tokens start with the same byte gets fewer, bigger shards.
+static uint32_t BlacklistCutShards(BLACKLIST_TRIE_SHARDS* Shards, uint32_t ShardCount)
+{
+	const TOKEN_STORE* Tokens = Shards->Tokens;
+
+	uint32_t Count = 0;
+
+	Shards->Starts[0] = 0;
+
+	for (uint32_t Shard = 1; Shard < ShardCount; Shard++)
+	{
+		uint32_t Start = (uint32_t)(((uint64_t)Tokens->TokenCount * Shard) / ShardCount);
+
+		if (Start <= Shards->Starts[Count])
+		{
+			continue;
+		}
+
+		while (Start < Tokens->TokenCount && FirstByte(Tokens, Start) == FirstByte(Tokens, Start - 1))
+		{
+			Start++;
+		}
+
+		if (Start < Tokens->TokenCount)
+		{
+			Shards->Starts[++Count] = Start;
+		}
+	}
+
+	Shards->Starts[++Count] = Tokens->TokenCount;
+
+	return(Count);
+}
+
+/*
+Turns the !rule lines into a coverage for every pattern, and the Reach and Span tables that BlacklistFindToken judges a
+password with. A token's pattern ID is its index in the store, so each rule's token is looked up there. The rules are gone
+through in the order they were read, so the last one for a token is the one it ends up with.
+
+*/
+static bool BlacklistCompileRules(const TOKEN_STORE* Tokens, const BLACKLIST_LOAD_CONTEXT* LoadContext, AC_AUTOMATON* Automaton)
+{
+	// The +1 keeps malloc(0) out of the picture.
+	if ((Automaton->PatternCoverage = malloc((size_t)Tokens->TokenCount + 1)) == NULL)
+	{
+		return(false);
+	}
+
+	memset(Automaton->PatternCoverage, Automaton->Coverage, Tokens->TokenCount);
+
+	for (uint32_t Index = 0; Index < LoadContext->RuleCount; Index++)
+	{
+		const BLACKLIST_RULE* Rule = &LoadContext->Rules[Index];
+
+		uint32_t PatternId = TokenStoreFind(Tokens, Rule->Token, Rule->Length);
+
+		if (PatternId != TOKEN_STORE_NOT_FOUND)
+		{
+			Automaton->PatternCoverage[PatternId] = Rule->Coverage;
+		}
+	}
+
+	return(AcBuildReach(Automaton));
+}
+
+/*
+Builds Tokens into Dawg (see TokenDawg.c), if Dawg isn't NULL, and Automaton's strength tables from it, if the list has a
+!strength. That is what the DLL keeps of the tokens once a blacklist is loaded. Without a Dawg, a !strength still needs one, so
+it is built just for the tables and freed again. On failure, nothing is left allocated.
+
+*/
+bool BlacklistBuildDawg(const TOKEN_STORE* Tokens, AC_AUTOMATON* Automaton, TOKEN_DAWG* Dawg)
+{
+	TOKEN_DAWG ScratchDawg;
+
+	TOKEN_DAWG* Built = (Dawg != NULL) ? Dawg : &ScratchDawg;
+
+	if (Dawg == NULL && Automaton->MinimumStrength == 0)
+	{
+		return(true);
+	}
+
+	if (TokenDawgBuild(Tokens, Built) == false)
+	{
+		return(false);
+	}
+
+	if (Automaton->MinimumStrength > 0 && (Automaton->Strength = StrengthTablesBuild(Built, Automaton, Automaton->MinimumStrength)) == NULL)
+	{
+		TokenDawgFree(Built);
+
+		return(false);
+	}
+
+	if (Dawg == NULL)
+	{
+		TokenDawgFree(&ScratchDawg);
+	}
+
+	return(true);
+}
+
+/*
+A token's pattern ID is its index in the token store, and in Dawg, which is built as well unless it is NULL (see
+BlacklistBuildDawg). LoadContext is what the tokens were loaded with; its directives go into the automaton along with them.
+Pool may be NULL, to build on the calling thread alone.
+
+*/
+AC_AUTOMATON* BlacklistBuildAutomaton(const TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, BLACKLIST_LOAD_CONTEXT* LoadContext, const WORKER_POOL* Pool)
+{
+	const uint8_t* Substitutions = BlacklistSubstitutions(LoadContext);
+
+	BLACKLIST_TRIE_SHARDS Shards = { 0 };
+
+	AC_BUILDER* Builder = NULL;
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	uint32_t ShardCount = WorkerPoolThreadCount(Pool);
+
+	if (ShardCount > Tokens->TokenCount / BLACKLIST_MIN_SHARD_TOKENS)
+	{
+		ShardCount = Tokens->TokenCount / BLACKLIST_MIN_SHARD_TOKENS;
+	}
+
+	Shards.Tokens = Tokens;
+
+	ShardCount = BlacklistCutShards(&Shards, (ShardCount > 0) ? ShardCount : 1);
+
+	WorkerPoolRun(Pool, ShardCount, BlacklistBuildShard, &Shards);
+
+	// The shards are in order of their first bytes, so each trie goes after the one before it.
+	Builder = Shards.Builders[0];
+
+	for (uint32_t Shard = 1; Shard < ShardCount && Builder != NULL; Shard++)
+	{
+		if (Shards.Builders[Shard] == NULL || AcBuilderAppend(Builder, Shards.Builders[Shard]) == false)
+		{
+			goto End;
+		}
+
+		AcBuilderDestroy(Shards.Builders[Shard]);
+
+		Shards.Builders[Shard] = NULL;
+	}
+
+	if (Builder == NULL || (Automaton = AcBuilderCompile(Builder, Pool)) == NULL)
+	{
+		goto End;
+	}
+
+	if (Substitutions != NULL)
+	{
+		Automaton->Substituting = true;
+
+		memcpy(Automaton->Substitutions, Substitutions, sizeof(Automaton->Substitutions));
+	}
+
+	Automaton->EditDistance = LoadContext->EditDistance;
+
+	Automaton->Coverage = (LoadContext->Coverage != 0) ? LoadContext->Coverage : AC_DEFAULT_COVERAGE;
+
+	Automaton->CombinedCoverage = LoadContext->CombinedCoverage;
+
+	Automaton->MinimumStrength = LoadContext->MinimumStrength;
+
+	if ((LoadContext->RuleCount > 0 && BlacklistCompileRules(Tokens, LoadContext, Automaton) == false) ||
+		BlacklistBuildDawg(Tokens, Automaton, Dawg) == false)
+	{
+		AcDestroy(Automaton);
+
+		Automaton = NULL;
+	}
+
+End:
+
+	for (uint32_t Shard = 0; Shard < ShardCount; Shard++)
+	{
+		AcBuilderDestroy(Shards.Builders[Shard]);
+	}
+
+	return(Automaton);
+}
+
+// Reads the lines up to and including the first token. Every token after that gets the substitutions as they are then.
+static bool BlacklistAddHeaderLine(void* Context, const uint8_t* Line, uint32_t Length)
+{
+	BLACKLIST_LOAD_CONTEXT* LoadContext = Context;
+
+	return(BlacklistAddLine(Context, Line, Length) && LoadContext->SubstitutionsFinal == false);
+}
+
+// Parses one piece of the file into a token store of its own.
+static void BlacklistLoadPiece(void* Context, uint32_t Task)
+{
+	BLACKLIST_LOAD_PIECE* Piece = &((BLACKLIST_LOAD_PIECE*)Context)[Task];
+
+	Piece->Failed = true;
+
+	if (Piece->LoadContext.Builder == NULL && (Piece->LoadContext.Builder = TokenStoreBuilderCreate()) == NULL)
+	{
+		return;
+	}
+
+	BlacklistParserInitialize(&Piece->Parser, MAX_BLACKLIST_STRING_SIZE - 1, BlacklistAddLine, &Piece->LoadContext);
+
+	BlacklistParserFeed(&Piece->Parser, Piece->Data, Piece->Size);
+
+	BlacklistParserFinish(&Piece->Parser);
+
+	Piece->TokensAdded = TokenStoreBuilderCount(Piece->LoadContext.Builder);
+
+	Piece->Failed = (Piece->LoadContext.OutOfMemory || TokenStoreBuilderFinish(Piece->LoadContext.Builder, &Piece->Tokens) == false);
+
+	// The builder holds a copy of every line, which can go as soon as the store is finished.
+	TokenStoreBuilderDestroy(Piece->LoadContext.Builder);
+
+	Piece->LoadContext.Builder = NULL;
+}
+
+static void BlacklistMergePair(void* Context, uint32_t Task)
+{
+	BLACKLIST_MERGE_ROUND* Round = Context;
+
+	TOKEN_STORE* Left = &Round->Stores[Task * 2];
+
+	if (Task * 2 + 1 == Round->StoreCount)
+	{
+		Round->Merged[Task] = *Left;
+
+		memset(Left, 0, sizeof(TOKEN_STORE));
+
+		return;
+	}
+
+	Round->Failed[Task] = (TokenStoreMerge(Left, Left + 1, &Round->Merged[Task]) == false);
+
+	TokenStoreFree(Left);
+
+	TokenStoreFree(Left + 1);
+}
+
+// Merges the stores into one, in pairs, a round at a time. Stores is emptied either way. Scratch and Failed have room for half
+// as many stores as there are, rounded up.
+static bool BlacklistMergeStores(TOKEN_STORE* Stores, uint32_t StoreCount, TOKEN_STORE* Scratch, bool* Failed, const WORKER_POOL* Pool, TOKEN_STORE* Tokens)
+{
+	bool Succeeded = true;
+
+	while (StoreCount > 1)
+	{
+		BLACKLIST_MERGE_ROUND Round = { Stores, StoreCount, Scratch, Failed };
+
+		uint32_t MergedCount = (StoreCount + 1) / 2;
+
+		memset(Failed, 0, MergedCount * sizeof(bool));
+
+		WorkerPoolRun(Pool, MergedCount, BlacklistMergePair, &Round);
+
+		for (uint32_t Index = 0; Index < MergedCount; Index++)
+		{
+			Succeeded = Succeeded && (Failed[Index] == false);
+		}
+
+		memcpy(Stores, Scratch, MergedCount * sizeof(TOKEN_STORE));
+
+		StoreCount = MergedCount;
+	}
+
+	if (Succeeded)
+	{
+		*Tokens = Stores[0];
+	}
+	else
+	{
+		TokenStoreFree(&Stores[0]);
+	}
+
+	return(Succeeded);
+}
+
+// Cuts Data into PieceCount pieces of about the same size, each ending just after a line break, or at the end of the file.
+static void BlacklistCutPieces(BLACKLIST_LOAD_PIECE* Pieces, uint32_t PieceCount, const uint8_t* Data, size_t Size)
+{
+	size_t Start = 0;
+
+	for (uint32_t Index = 0; Index < PieceCount; Index++)
+	{
+		size_t End = (size_t)(((uint64_t)Size * (Index + 1)) / PieceCount);
+
+		if (End < Start)
+		{
+			End = Start;
+		}
+
+		if (Index + 1 < PieceCount)
+		{
+			const uint8_t* LineBreak = (End > 0 && End < Size) ? memchr(Data + End - 1, '\n', Size - End + 1) : NULL;
+
+			End = (LineBreak != NULL) ? (size_t)(LineBreak - Data) + 1 : Size;
+		}
+		else
+		{
+			End = Size;
+		}
+
+		Pieces[Index].Data = Data + Start;
+
+		Pieces[Index].Size = End - Start;
+
+		Start = End;
+	}
+}
+
+/*
+Turns the contents of a text blacklist, all in memory (or mapped), into a finished token store and automaton, and a DAWG of
+the tokens if Dawg isn't NULL. This is all of the work of a reload except getting the bytes in the first place, which is the
+caller's business. On failure, nothing is left allocated. Pool may be NULL, to load on the calling thread alone.
+
+*/
+BLACKLIST_LOAD_STATUS BlacklistLoad(const uint8_t* Data, size_t Size, const WORKER_POOL* Pool, TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, AC_AUTOMATON** Automaton, BLACKLIST_LOAD_STATS* Stats)
+{
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoadTokensOutOfMemory;
+
+	BLACKLIST_LOAD_CONTEXT LoadContext = { 0 };
+
+	BLACKLIST_PARSER* Parser = NULL;
+
+	BLACKLIST_LOAD_PIECE* Pieces = NULL;
+
+	TOKEN_STORE* Stores = NULL;
+
+	bool* Failed = NULL;
+
+	uint32_t PieceCount = 0;
+
+	bool PieceFailed = false;
+
+	uint64_t StartTime = PlatformTimestamp();
+
+	memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+	if (Dawg != NULL)
+	{
+		memset(Dawg, 0, sizeof(TOKEN_DAWG));
+	}
+
+	memset(Stats, 0, sizeof(BLACKLIST_LOAD_STATS));
+
+	Stats->CompressedBytes = Size;
+
+	*Automaton = NULL;
+
+	// The parser carries a line buffer around with it, which is a bit big for the stack.
+	if ((LoadContext.Builder = TokenStoreBuilderCreate()) == NULL || (Parser = malloc(sizeof(BLACKLIST_PARSER))) == NULL)
+	{
+		goto End;
+	}
+
+	BlacklistParserInitialize(Parser, MAX_BLACKLIST_STRING_SIZE - 1, BlacklistAddHeaderLine, &LoadContext);
+
+	BlacklistParserFeed(Parser, Data, Size);
+
+	BlacklistParserFinish(Parser);
+
+	if (LoadContext.OutOfMemory)
+	{
+		goto End;
+	}
+
+	// The parser stops right after the first token's line.
+	size_t HeaderSize = (size_t)Parser->BytesRead;
+
+	size_t PieceSize = (WorkerPoolThreadCount(Pool) > 1) ? BLACKLIST_MIN_PIECE_SIZE : SIZE_MAX;
+
+	PieceCount = WorkerPoolThreadCount(Pool) * BLACKLIST_PIECES_PER_THREAD;
+
+	if (PieceCount > (Size - HeaderSize) / PieceSize)
+	{
+		PieceCount = (uint32_t)((Size - HeaderSize) / PieceSize);
+	}
+
+	PieceCount = (PieceCount > 0) ? PieceCount : 1;
+
+	if ((Pieces = calloc(PieceCount, sizeof(BLACKLIST_LOAD_PIECE))) == NULL ||
+		(Stores = calloc((size_t)PieceCount * 2, sizeof(TOKEN_STORE))) == NULL ||
+		(Failed = calloc(PieceCount, sizeof(bool))) == NULL)
+	{
+		goto End;
+	}
+
+	BlacklistCutPieces(Pieces, PieceCount, Data + HeaderSize, Size - HeaderSize);
+
+	// The first piece carries on where the header left off, first token and all. The others start out with the settled
+	// substitutions, and a distance that shows whether they had a !distance line of their own.
+	Pieces[0].LoadContext = LoadContext;
+
+	LoadContext.Builder = NULL;
+
+	LoadContext.Rules = NULL;
+
+	for (uint32_t Index = 1; Index < PieceCount; Index++)
+	{
+		Pieces[Index].LoadContext.Substituting = Pieces[0].LoadContext.Substituting;
+
+		Pieces[Index].LoadContext.SubstitutionsFinal = true;
+
+		memcpy(Pieces[Index].LoadContext.Substitutions, Pieces[0].LoadContext.Substitutions, sizeof(LoadContext.Substitutions));
+
+		Pieces[Index].LoadContext.EditDistance = BLACKLIST_NO_DISTANCE;
+	}
+
+	WorkerPoolRun(Pool, PieceCount, BlacklistLoadPiece, Pieces);
+
+	LoadContext = Pieces[0].LoadContext;
+
+	// The first piece's rules are LoadContext's now, and every other piece's go on the end of them, in order.
+	Pieces[0].LoadContext.Rules = NULL;
+
+	Stats->BytesRead = Parser->BytesRead;
+
+	Stats->LinesRead = Parser->LinesRead;
+
+	Stats->EmptyLines = Parser->EmptyLines;
+
+	Stats->TruncatedLines = Parser->TruncatedLines;
+
+	for (uint32_t Index = 0; Index < PieceCount; Index++)
+	{
+		BLACKLIST_LOAD_PIECE* Piece = &Pieces[Index];
+
+		Stats->BytesRead += Piece->Parser.BytesRead;
+
+		Stats->LinesRead += Piece->Parser.LinesRead;
+
+		Stats->EmptyLines += Piece->Parser.EmptyLines;
+
+		Stats->TruncatedLines += Piece->Parser.TruncatedLines;
+
+		Stats->TokensAdded += Piece->TokensAdded;
+
+		Stats->Directives += Piece->LoadContext.Directives;
+
+		Stats->LateDirectives += Piece->LoadContext.LateDirectives;
+
+		Stats->BadDirectives += Piece->LoadContext.BadDirectives;
+
+		if (Index > 0 && Piece->LoadContext.EditDistance != BLACKLIST_NO_DISTANCE)
+		{
+			LoadContext.EditDistance = Piece->LoadContext.EditDistance;
+		}
+
+		if (Index > 0 && Piece->LoadContext.Coverage != 0)
+		{
+			LoadContext.Coverage = Piece->LoadContext.Coverage;
+		}
+
+		if (Index > 0 && Piece->LoadContext.CombinedCoverage != 0)
+		{
+			LoadContext.CombinedCoverage = Piece->LoadContext.CombinedCoverage;
+		}
+
+		if (Index > 0 && Piece->LoadContext.MinimumStrength != 0)
+		{
+			LoadContext.MinimumStrength = Piece->LoadContext.MinimumStrength;
+		}
+
+		if (Index > 0 && TakeRules(&LoadContext, &Piece->LoadContext) == false)
+		{
+			PieceFailed = true;
+		}
+
+		Stores[Index] = Piece->Tokens;
+
+		PieceFailed = PieceFailed || Piece->Failed;
+	}
+
+	uint64_t ParsedTime = PlatformTimestamp();
+
+	Stats->Rules = LoadContext.RuleCount;
+
+	Stats->Threads = WorkerPoolThreadCount(Pool);
+
+	Stats->ParseMicroseconds = PlatformElapsedMicroseconds(StartTime, ParsedTime);
+
+	if (PieceFailed)
+	{
+		for (uint32_t Index = 0; Index < PieceCount; Index++)
+		{
+			TokenStoreFree(&Stores[Index]);
+		}
+
+		goto End;
+	}
+
+	// The second half of Stores is where each round of the merge puts its results.
+	if (BlacklistMergeStores(Stores, PieceCount, Stores + PieceCount, Failed, Pool, Tokens) == false)
+	{
+		goto End;
+	}
+
+	uint64_t MergedTime = PlatformTimestamp();
+
+	Stats->MergeMicroseconds = PlatformElapsedMicroseconds(ParsedTime, MergedTime);
+
+	if ((*Automaton = BlacklistBuildAutomaton(Tokens, Dawg, &LoadContext, Pool)) == NULL)
+	{
+		TokenStoreFree(Tokens);
+
+		Status = BlacklistLoadAutomatonOutOfMemory;
+
+		goto End;
+	}
+
+	Stats->AutomatonMicroseconds = PlatformElapsedMicroseconds(MergedTime, PlatformTimestamp());
+
+	Status = BlacklistLoadOk;
+
+End:
+
+	for (uint32_t Index = 0; Index < PieceCount && Pieces != NULL; Index++)
+	{
+		TokenStoreBuilderDestroy(Pieces[Index].LoadContext.Builder);
+
+		BlacklistRulesFree(&Pieces[Index].LoadContext);
+	}
+
+	free(Failed);
+
+	free(Stores);
+
+	free(Pieces);
+
+	free(Parser);
+
+	TokenStoreBuilderDestroy(LoadContext.Builder);
+
+	BlacklistRulesFree(&LoadContext);
+
+	return(Status);
+}
+
+const char* BlacklistLoadStatusString(BLACKLIST_LOAD_STATUS Status)
+{
+	switch (Status)
+	{
+		case BlacklistLoadOk:
+		{
+			return("OK");
+		}
+		case BlacklistLoadTokensOutOfMemory:
+		{
+			return("not enough memory for the blacklist tokens");
+		}
+		case BlacklistLoadAutomatonOutOfMemory:
+		{
+			return("not enough memory for the blacklist automaton");
+		}
+		case BlacklistLoadCorrupt:
+		{
+			return("the compressed blacklist is damaged");
+		}
+		case BlacklistLoadUnsupported:
+		{
+			return("the blacklist is compressed with zstd, which can't be read; use gzip");
+		}
+		default:
+		{
+			return("unknown error");
+		}
+	}
+}
+
+/*
+Puts a folded password into the form the blacklist's tokens are in, by making the same substitutions. Characters that don't fit
+into a byte can't be part of a token and are left alone. Automaton may be NULL, when there is no blacklist.
+
+*/
+void BlacklistCanonicalize(const AC_AUTOMATON* Automaton, uint16_t* Password, size_t PasswordLength)
+{
+	if (Automaton == NULL || Automaton->Substituting == false)
+	{
+		return;
+	}
+
+	for (size_t Index = 0; Index < PasswordLength; Index++)
+	{
+		if (Password[Index] < AC_ALPHABET_SIZE)
+		{
+			Password[Index] = Automaton->Substitutions[Password[Index]];
+		}
+	}
+}
+
+/*
+How many different spellings the tokens stand for, taking every substitution into account, and how many bytes they would take
+up as lines of a blacklist without substitutions (*TextBytes). Both stop growing at UINT64_MAX. This is what the load trace
+reports as the list's savings; nothing needs it to be exact.
+
+*/
+uint64_t BlacklistSpellingCount(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton, uint64_t* TextBytes)
+{
+	uint64_t GroupSizes[AC_ALPHABET_SIZE] = { 0 };
+
+	uint64_t Spellings = 0;
+
+	*TextBytes = 0;
+
+	// Upper case letters are already covered by case folding, so only characters that folding leaves alone count.
+	for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+	{
+		if (NormalizeCharacter((uint16_t)Character) == Character)
+		{
+			GroupSizes[Automaton->Substituting ? Automaton->Substitutions[Character] : Character]++;
+		}
+	}
+
+	for (uint32_t Index = 0; Index < Tokens->TokenCount; Index++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(Tokens, Index, &Length);
+
+		uint64_t TokenSpellings = 1;
+
+		for (uint32_t Position = 0; Position < Length; Position++)
+		{
+			uint64_t GroupSize = (GroupSizes[Token[Position]] > 0) ? GroupSizes[Token[Position]] : 1;
+
+			TokenSpellings = (TokenSpellings > UINT64_MAX / GroupSize) ? UINT64_MAX : TokenSpellings * GroupSize;
+		}
+
+		Spellings = (Spellings > UINT64_MAX - TokenSpellings) ? UINT64_MAX : Spellings + TokenSpellings;
+
+		uint64_t Bytes = (TokenSpellings > UINT64_MAX / (Length + 1)) ? UINT64_MAX : TokenSpellings * (Length + 1);
+
+		*TextBytes = (*TextBytes > UINT64_MAX - Bytes) ? UINT64_MAX : *TextBytes + Bytes;
+	}
+
+	return(Spellings);
+}
+
+// The longest pattern ending at State that makes up enough of a password of PasswordLength characters to reject it on its own.
+static uint32_t RejectingPattern(const AC_AUTOMATON* Automaton, uint32_t State, size_t PasswordLength)
+{
+	for (uint32_t Match = AcFirstMatch(Automaton, State); Match != AC_ROOT_STATE; Match = Automaton->States[Match].DictionaryLink)
+	{
+		const AC_STATE* Current = &Automaton->States[Match];
+
+		if ((uint64_t)Current->Depth * 100 >= (uint64_t)AcPatternCoverage(Automaton, Current->PatternId) * PasswordLength)
+		{
+			return(Current->PatternId);
+		}
+	}
+
+	return(AC_NO_PATTERN);
+}
+
+// The longest pattern ending at State that counts toward !combined, which is any but an exact one.
+static uint32_t CombiningPattern(const AC_AUTOMATON* Automaton, uint32_t State)
+{
+	for (uint32_t Match = AcFirstMatch(Automaton, State); Match != AC_ROOT_STATE; Match = Automaton->States[Match].DictionaryLink)
+	{
+		uint32_t PatternId = Automaton->States[Match].PatternId;
+
+		if (Automaton->PatternCoverage == NULL || (Automaton->PatternCoverage[PatternId] & AC_COVERAGE_EXACT) == 0)
+		{
+			return(PatternId);
+		}
+	}
+
+	return(AC_NO_PATTERN);
+}
+
+/*
+Moves *State on by Character. Returns the pattern ID of a token ending there that rejects the password on its own, or
+AC_NO_PATTERN, and sets *Span to the length of the longest token ending there that counts toward !combined, or 0.
+
+With rules, Reach and Span answer both for every token on the chain at once, and the chain is only walked to name the token
+once the password is known to be rejected. Without them every token has the same coverage, so the longest one decides.
+
+*/
+static uint32_t BlacklistStep(const AC_AUTOMATON* Automaton, uint32_t* State, uint16_t Character, size_t PasswordLength, uint32_t* Span)
+{
+	*State = AcNextState(Automaton, *State, Character);
+
+	if (Automaton->Reach != NULL)
+	{
+		*Span = Automaton->Span[*State];
+
+		return((Automaton->Reach[*State] >= PasswordLength) ? RejectingPattern(Automaton, *State, PasswordLength) : AC_NO_PATTERN);
+	}
+
+	const AC_STATE* Match = &Automaton->States[AcFirstMatch(Automaton, *State)];
+
+	// The root has a depth of 0 and no pattern.
+	*Span = Match->Depth;
+
+	if (Match->PatternId != AC_NO_PATTERN && (uint64_t)Match->Depth * 100 >= (uint64_t)Automaton->Coverage * PasswordLength)
+	{
+		return(Match->PatternId);
+	}
+
+	return(AC_NO_PATTERN);
+}
+
+/*
+How many characters of the password are inside at least one token, given the length of the longest token that ends at each
+position (Spans), and how many tokens it takes to cover them (*Tokens), leaving out any that lies inside another. Going from
+the end, Start is where the earliest-starting token that ends further on begins, so a position is covered if it isn't before
+Start. That is one pass with no sorting.
+
+*/
+static uint32_t BlacklistCombinedLength(const uint8_t* Spans, size_t PasswordLength, uint32_t* Tokens)
+{
+	size_t Start = PasswordLength;
+
+	uint32_t Covered = 0;
+
+	*Tokens = 0;
+
+	for (size_t Index = PasswordLength; Index-- > 0;)
+	{
+		if (Spans[Index] != 0 && Index + 1 - Spans[Index] < Start)
+		{
+			Start = Index + 1 - Spans[Index];
+
+			(*Tokens)++;
+		}
+
+		Covered += (Start <= Index);
+	}
+
+	return(Covered);
+}
+
+/*
+Returns the pattern ID of a token that makes up enough of the password to reject it, NAME_PATTERN if a part of the user's name
+makes up at least half of it (see NameMatch.c), or AC_NO_PATTERN if nothing does. The password must already be folded and
+canonicalized. Automaton, Overlay (the tokens appended since Automaton was built, see BlacklistDelta.c) and Names may each be
+NULL. Together, which may be NULL too, is set when the password is rejected by !combined; the token returned is then the longest
+of the ones that covered it.
+
+A token rejects a password when its length is at least its coverage (see Blacklist.c) of the password's, that is, when
+Length * 100 >= Coverage * PasswordLength, which needs no division. One pass over the password finds every blacklist token and
+every part of the name in it, whatever rules there are: each position costs one lookup in Reach and one in Span (or the depth of
+the first match, without rules), and the positions where tokens end give !combined all it needs once the pass is over. The
+name's parts are all in one Shift-And state, and the ones that are long enough are known before the pass begins.
+
+*/
+uint32_t BlacklistFindToken(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const NAME_PATTERNS* Names, const uint16_t* Password, size_t PasswordLength, bool* Together)
+{
+	const AC_AUTOMATON* Policy = (Automaton != NULL) ? Automaton : Overlay;
+
+	uint32_t State = AC_ROOT_STATE;
+
+	uint32_t OverlayState = AC_ROOT_STATE;
+
+	uint64_t NameState = 0;
+
+	uint64_t NameEnds = 0;
+
+	// The longest token that counts toward !combined ending at each position, and where the longest of all of them ended.
+	uint8_t Spans[BLACKLIST_COMBINED_MAX_LENGTH];
+
+	bool Combining = (Policy != NULL && Policy->CombinedCoverage != 0 && PasswordLength > 0 && PasswordLength <= BLACKLIST_COMBINED_MAX_LENGTH);
+
+	uint32_t LongestSpan = 0;
+
+	uint32_t LongestState = AC_ROOT_STATE;
+
+	const AC_AUTOMATON* LongestAutomaton = NULL;
+
+	if (Together != NULL)
+	{
+		*Together = false;
+	}
+
+	if (Names != NULL && Names->Starts != 0)
+	{
+		NameEnds = NameLongEnoughEnds(Names, PasswordLength);
+	}
+
+	for (size_t Index = 0; Index < PasswordLength; Index++)
+	{
+		uint32_t Span = 0;
+
+		uint32_t OverlaySpan = 0;
+
+		if (Automaton != NULL)
+		{
+			uint32_t Match = BlacklistStep(Automaton, &State, Password[Index], PasswordLength, &Span);
+
+			if (Match != AC_NO_PATTERN)
+			{
+				return(Match);
+			}
+		}
+
+		if (Overlay != NULL)
+		{
+			uint32_t Match = BlacklistStep(Overlay, &OverlayState, Password[Index], PasswordLength, &OverlaySpan);
+
+			if (Match != AC_NO_PATTERN)
+			{
+				return(Match);
+			}
+		}
+
+		if (Combining)
+		{
+			Spans[Index] = (uint8_t)((OverlaySpan > Span) ? OverlaySpan : Span);
+
+			if (Spans[Index] > LongestSpan)
+			{
+				LongestSpan = Spans[Index];
+
+				LongestState = (OverlaySpan > Span) ? OverlayState : State;
+
+				LongestAutomaton = (OverlaySpan > Span) ? Overlay : Automaton;
+			}
+		}
+
+		if (NameEnds != 0)
+		{
+			uint64_t Mask = (Password[Index] < AC_ALPHABET_SIZE) ? Names->DistinctMasks[Names->ByteIndex[Password[Index]]] : NameCharacterMask(Names, Password[Index]);
+
+			NameState = ((NameState << 1) | Names->Starts) & Mask;
+
+			if ((NameState & NameEnds) != 0)
+			{
+				return(NAME_PATTERN);
+			}
+		}
+	}
+
+	if (Combining && LongestSpan > 0)
+	{
+		uint32_t Tokens = 0;
+
+		uint32_t Covered = BlacklistCombinedLength(Spans, PasswordLength, &Tokens);
+
+		if (Tokens >= 2 && (uint64_t)Covered * 100 >= (uint64_t)Policy->CombinedCoverage * PasswordLength)
+		{
+			if (Together != NULL)
+			{
+				*Together = true;
+			}
+
+			return(CombiningPattern(LongestAutomaton, LongestState));
+		}
+	}
+
+	return(AC_NO_PATTERN);
+}
@@ -0,0 +1,175 @@
+// Please read Blacklist.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "NameMatch.h"
+
+#include "TokenDawg.h"
+
+#include "TokenStore.h"
+
+#include "WorkerPool.h"
+
+// Lines longer than MAX_BLACKLIST_STRING_SIZE - 1 characters are truncated. (It used to be the size of a wchar_t array that needed a terminator.)
+#define MAX_BLACKLIST_STRING_SIZE 128
+
+// A line that starts with this, ahead of the first token, makes the characters on the rest of the line interchangeable. See BlacklistAddLine.
+#define BLACKLIST_SUBSTITUTE_DIRECTIVE "!substitute "
+
+// A line that starts with this and goes on with a number turns on matching within that many edits. See FuzzyMatch.c.
+#define BLACKLIST_DISTANCE_DIRECTIVE "!distance "
+
+// How much of a password one token has to make up to reject it, and how much two or more together do, in percent. See Blacklist.c.
+#define BLACKLIST_COVERAGE_DIRECTIVE "!coverage "
+
+#define BLACKLIST_COMBINED_DIRECTIVE "!combined "
+
+// "!rule exact token" or "!rule 80 token" adds a token with a coverage of its own.
+#define BLACKLIST_RULE_DIRECTIVE "!rule "
+
+#define BLACKLIST_RULE_EXACT "exact"
+
+// "!strength n" rejects passwords that would take fewer than 10^n guesses, blacklist tokens or not. See Strength.c.
+#define BLACKLIST_STRENGTH_DIRECTIVE "!strength "
+
+// Longer passwords are only judged by one token at a time, not by !combined.
+#define BLACKLIST_COMBINED_MAX_LENGTH 256
+
+// A !rule line, as read. The token has already been normalized and substituted, the same as the token the line adds.
+typedef struct BLACKLIST_RULE
+{
+	// A percent, with AC_COVERAGE_EXACT for exact.
+	uint8_t Coverage;
+
+	uint8_t Length;
+
+	uint8_t Token[MAX_BLACKLIST_STRING_SIZE];
+
+} BLACKLIST_RULE;
+
+// Carried through the parser callbacks while a blacklist is being loaded. All zeros to begin with.
+typedef struct BLACKLIST_LOAD_CONTEXT
+{
+	TOKEN_STORE_BUILDER* Builder;
+
+	bool OutOfMemory;
+
+	// Set by the first !substitute line. Until SubstitutionsFinal, Substitutions is a union-find forest, and after it the finished map.
+	bool Substituting;
+
+	bool SubstitutionsFinal;
+
+	uint32_t Directives;
+
+	// !substitute lines after the first token. They would change what the tokens before them meant, so they are skipped.
+	uint32_t LateDirectives;
+
+	// Directives that say something this code doesn't understand, such as a distance that isn't a number.
+	uint32_t BadDirectives;
+
+	uint8_t EditDistance;
+
+	// The last !coverage and !combined, or 0 if there were none.
+	uint8_t Coverage;
+
+	uint8_t CombinedCoverage;
+
+	// The last !strength, or 0 if there was none.
+	uint8_t MinimumStrength;
+
+	uint8_t Substitutions[AC_ALPHABET_SIZE];
+
+	// Every !rule line, in order. A later rule for the same token wins. Freed with BlacklistRulesFree.
+	BLACKLIST_RULE* Rules;
+
+	uint32_t RuleCount;
+
+	uint32_t RuleCapacity;
+
+} BLACKLIST_LOAD_CONTEXT;
+
+typedef struct BLACKLIST_LOAD_STATS
+{
+	uint64_t BytesRead;
+
+	// The size of the file, which is BytesRead unless it was compressed. See BlacklistStream.c.
+	uint64_t CompressedBytes;
+
+	uint64_t LinesRead;
+
+	uint64_t EmptyLines;
+
+	uint64_t TruncatedLines;
+
+	// Lines that made it into the token store builder, duplicates and all.
+	uint32_t TokensAdded;
+
+	uint32_t Directives;
+
+	uint32_t LateDirectives;
+
+	uint32_t BadDirectives;
+
+	// !rule lines, which are counted among the directives as well.
+	uint32_t Rules;
+
+	// Threads the load was spread over, and how long each stage took: parsing and sorting the pieces of the file, merging them,
+	// and building the automaton.
+	uint32_t Threads;
+
+	uint64_t ParseMicroseconds;
+
+	uint64_t MergeMicroseconds;
+
+	uint64_t AutomatonMicroseconds;
+
+} BLACKLIST_LOAD_STATS;
+
+typedef enum BLACKLIST_LOAD_STATUS
+{
+	BlacklistLoadOk,
+
+	BlacklistLoadTokensOutOfMemory,
+
+	BlacklistLoadAutomatonOutOfMemory,
+
+	// A compressed file that turned out to be damaged, or compressed in a way that can't be read. See BlacklistStream.c.
+	BlacklistLoadCorrupt,
+
+	BlacklistLoadUnsupported
+
+} BLACKLIST_LOAD_STATUS;
+
+bool BlacklistAddLine(void* Context, const uint8_t* Line, uint32_t Length);
+
+const uint8_t* BlacklistSubstitutions(BLACKLIST_LOAD_CONTEXT* LoadContext);
+
+void BlacklistRulesFree(BLACKLIST_LOAD_CONTEXT* LoadContext);
+
+bool BlacklistBuildDawg(const TOKEN_STORE* Tokens, AC_AUTOMATON* Automaton, TOKEN_DAWG* Dawg);
+
+AC_AUTOMATON* BlacklistBuildAutomaton(const TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, BLACKLIST_LOAD_CONTEXT* LoadContext, const WORKER_POOL* Pool);
+
+BLACKLIST_LOAD_STATUS BlacklistLoad(const uint8_t* Data, size_t Size, const WORKER_POOL* Pool, TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, AC_AUTOMATON** Automaton, BLACKLIST_LOAD_STATS* Stats);
+
+const char* BlacklistLoadStatusString(BLACKLIST_LOAD_STATUS Status);
+
+void BlacklistCanonicalize(const AC_AUTOMATON* Automaton, uint16_t* Password, size_t PasswordLength);
+
+uint64_t BlacklistSpellingCount(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton, uint64_t* TextBytes);
+
+uint32_t BlacklistFindToken(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const NAME_PATTERNS* Names, const uint16_t* Password, size_t PasswordLength, bool* Together);
@@ -0,0 +1,277 @@
+/*
+BlacklistDelta.c
+
+Puts tokens that were appended to the text blacklist into effect without rebuilding everything else.
+
+Most changes to a big blacklist are a few lines added to the end of it, and a full reload parses, sorts and compiles every
+line again, which on a list of millions of lines is seconds of work on every DC for a hundred new tokens. So when the text file
+has only grown, and everything that was in it before is still there, byte for byte, only the new lines are read. Their tokens
+are compiled into an automaton of their own, the overlay, which PasswordCheck runs alongside the base automaton in the same
+pass over the password (see BlacklistFindToken). Tokens that the base already has are left out of it. The snapshot that
+PasswordFilter sees shares the base with the one before it, and gets the overlay on top.
+
+Telling that the file was only added to takes one pass over the old part of it: the CRC-32 of the text a snapshot was built
+from is kept with it (see BLACKLIST_TEXT_PREFIX), and must come out the same for the same number of bytes at the start of the
+new file. That is much cheaper than parsing them, and CRC-32 is certain to catch any edit of up to 32 bits in a row. The old
+text must also have ended with a complete line, or the first new line would really be the end of the last old one.
+
+Each time more lines are appended, the overlay is rebuilt from everything appended since the base, so there is only ever one.
+Once it gets big (see BlacklistDeltaNeedsCompaction), or the file has been left alone for a while, the blacklist thread does a
+full reload in the background, compacting the overlay into a new base, while the current snapshot goes on being used.
+
+New lines that hold directives always take a full reload, as they could change what the tokens already loaded mean.
+
+Platform-neutral C.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistDelta.h"
+
+#include "BlacklistImage.h"
+
+#include "BlacklistParser.h"
+
+void BlacklistTextPrefixInitialize(BLACKLIST_TEXT_PREFIX* Prefix, const uint8_t* Text, size_t Size)
+{
+	Prefix->Size = Size;
+
+	Prefix->Crc = BlacklistImageCrc32(0, Text, Size);
+}
+
+/*
+If the first Prefix->Size bytes of Text are the text Prefix describes, and end with a complete line, makes Prefix describe all of
+Text and returns true. Otherwise, Prefix is left alone and the answer is false.
+
+*/
+bool BlacklistTextPrefixExtend(BLACKLIST_TEXT_PREFIX* Prefix, const uint8_t* Text, size_t Size)
+{
+	if (Size < Prefix->Size)
+	{
+		return(false);
+	}
+
+	if (Prefix->Size > 0 && Text[Prefix->Size - 1] != '\n')
+	{
+		return(false);
+	}
+
+	if (BlacklistImageCrc32(0, Text, (size_t)Prefix->Size) != Prefix->Crc)
+	{
+		return(false);
+	}
+
+	Prefix->Crc = BlacklistImageCrc32(Prefix->Crc, Text + Prefix->Size, Size - (size_t)Prefix->Size);
+
+	Prefix->Size = Size;
+
+	return(true);
+}
+
+// Whether Token, already folded and canonicalized, is one of the base's own tokens, and not just part of one.
+static bool BaseHasToken(const AC_AUTOMATON* Base, const uint8_t* Token, uint32_t Length)
+{
+	uint32_t State = AC_ROOT_STATE;
+
+	if (Base == NULL)
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		State = AcNextState(Base, State, Token[Index]);
+	}
+
+	// Anything shallower is only a suffix of the token.
+	return(Base->States[State].Depth == Length && Base->States[State].PatternId != AC_NO_PATTERN);
+}
+
+/*
+Loads the lines appended to the text that the BaseTokenCount tokens of Base were loaded from. The tokens get the base's
+substitutions, and the overlay its !distance. Token i of *Tokens is pattern BaseTokenCount + i in *Overlay, so that pattern IDs from
+either automaton can be told apart (see BlacklistDeltaToken). *Overlay is NULL if every token was already in the base. On
+failure, nothing is left allocated.
+
+*/
+BLACKLIST_DELTA_STATUS BlacklistDeltaLoad(uint32_t BaseTokenCount, const AC_AUTOMATON* Base, const uint8_t* Appended, size_t Size, TOKEN_STORE* Tokens, AC_AUTOMATON** Overlay, BLACKLIST_DELTA_STATS* Stats)
+{
+	BLACKLIST_DELTA_STATUS Status = BlacklistDeltaOutOfMemory;
+
+	BLACKLIST_LOAD_CONTEXT LoadContext = { 0 };
+
+	BLACKLIST_PARSER* Parser = NULL;
+
+	AC_BUILDER* Builder = NULL;
+
+	memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+	memset(Stats, 0, sizeof(BLACKLIST_DELTA_STATS));
+
+	*Overlay = NULL;
+
+	// The substitutions were settled by the first token of the base.
+	if (Base != NULL)
+	{
+		LoadContext.Substituting = Base->Substituting;
+
+		memcpy(LoadContext.Substitutions, Base->Substitutions, sizeof(LoadContext.Substitutions));
+
+		LoadContext.EditDistance = Base->EditDistance;
+	}
+
+	LoadContext.SubstitutionsFinal = true;
+
+	if ((LoadContext.Builder = TokenStoreBuilderCreate()) == NULL || (Parser = malloc(sizeof(BLACKLIST_PARSER))) == NULL)
+	{
+		goto End;
+	}
+
+	BlacklistParserInitialize(Parser, MAX_BLACKLIST_STRING_SIZE - 1, BlacklistAddLine, &LoadContext);
+
+	BlacklistParserFeed(Parser, Appended, Size);
+
+	BlacklistParserFinish(Parser);
+
+	Stats->LinesRead = Parser->LinesRead;
+
+	if (LoadContext.Directives > 0 || LoadContext.LateDirectives > 0 || LoadContext.BadDirectives > 0)
+	{
+		Status = BlacklistDeltaHasDirectives;
+
+		goto End;
+	}
+
+	if (LoadContext.OutOfMemory || TokenStoreBuilderFinish(LoadContext.Builder, Tokens) == false)
+	{
+		goto End;
+	}
+
+	Stats->Tokens = Tokens->TokenCount;
+
+	if ((Builder = AcBuilderCreate()) == NULL)
+	{
+		goto Failed;
+	}
+
+	for (uint32_t Index = 0; Index < Tokens->TokenCount; Index++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(Tokens, Index, &Length);
+
+		if (BaseHasToken(Base, Token, Length))
+		{
+			Stats->KnownTokens++;
+
+			continue;
+		}
+
+		if (AcBuilderAddPattern(Builder, Token, Length, BaseTokenCount + Index) == false)
+		{
+			goto Failed;
+		}
+	}
+
+	if (Stats->KnownTokens < Stats->Tokens)
+	{
+		if ((*Overlay = AcBuilderCompile(Builder, NULL)) == NULL)
+		{
+			goto Failed;
+		}
+
+		(*Overlay)->Substituting = LoadContext.Substituting;
+
+		memcpy((*Overlay)->Substitutions, LoadContext.Substitutions, sizeof(LoadContext.Substitutions));
+
+		(*Overlay)->EditDistance = LoadContext.EditDistance;
+
+		// Appended tokens can't have rules of their own, since a !rule line means a full reload, so they go by the base's.
+		if (Base != NULL)
+		{
+			(*Overlay)->Coverage = Base->Coverage;
+
+			(*Overlay)->CombinedCoverage = Base->CombinedCoverage;
+		}
+	}
+
+	Status = BlacklistDeltaOk;
+
+	goto End;
+
+Failed:
+
+	TokenStoreFree(Tokens);
+
+End:
+
+	AcBuilderDestroy(Builder);
+
+	free(Parser);
+
+	TokenStoreBuilderDestroy(LoadContext.Builder);
+
+	BlacklistRulesFree(&LoadContext);
+
+	return(Status);
+}
+
+const char* BlacklistDeltaStatusString(BLACKLIST_DELTA_STATUS Status)
+{
+	switch (Status)
+	{
+		case BlacklistDeltaOk:
+		{
+			return("OK");
+		}
+		case BlacklistDeltaNotAppended:
+		{
+			return("the file was changed, not just appended to");
+		}
+		case BlacklistDeltaHasDirectives:
+		{
+			return("the appended lines have directives in them");
+		}
+		case BlacklistDeltaOutOfMemory:
+		{
+			return("not enough memory for the appended tokens");
+		}
+		default:
+		{
+			return("unknown error");
+		}
+	}
+}
+
+// Every password goes through the overlay as well as the base, and the overlay is rebuilt whole every time the file grows, so
+// it is kept small next to the base.
+bool BlacklistDeltaNeedsCompaction(uint32_t BaseTokenCount, uint32_t OverlayTokenCount)
+{
+	return(OverlayTokenCount >= BLACKLIST_DELTA_MAX_TOKENS || (uint64_t)OverlayTokenCount * BLACKLIST_DELTA_MAX_SHARE > BaseTokenCount);
+}
+
+/*
+Copies the token behind a pattern ID from either the base, which is kept as a DAWG, or the overlay into Token, which must have
+room for TOKEN_DAWG_MAX_LENGTH bytes, and returns its length. OverlayTokens may be NULL when there is no overlay.
+
+*/
+uint32_t BlacklistDeltaToken(const TOKEN_DAWG* BaseTokens, const TOKEN_STORE* OverlayTokens, uint32_t PatternId, uint8_t* Token)
+{
+	uint32_t Length = 0;
+
+	if (PatternId < BaseTokens->TokenCount || OverlayTokens == NULL)
+	{
+		return(TokenDawgGet(BaseTokens, PatternId, Token));
+	}
+
+	const uint8_t* OverlayToken = TokenStoreGet(OverlayTokens, PatternId - BaseTokens->TokenCount, &Length);
+
+	memcpy(Token, OverlayToken, Length);
+
+	return(Length);
+}
@@ -0,0 +1,74 @@
+// Please read BlacklistDelta.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "TokenDawg.h"
+
+#include "TokenStore.h"
+
+// An overlay is compacted into the base once it has this many tokens,
+#define BLACKLIST_DELTA_MAX_TOKENS 50000
+
+// or once it has more than one for every this many tokens in the base, whichever comes first.
+#define BLACKLIST_DELTA_MAX_SHARE 16
+
+// What is known about the text a snapshot was built from, enough to tell whether a bigger file is that text with more after it.
+typedef struct BLACKLIST_TEXT_PREFIX
+{
+	uint64_t Size;
+
+	// BlacklistImageCrc32 of the first Size bytes.
+	uint32_t Crc;
+
+} BLACKLIST_TEXT_PREFIX;
+
+typedef enum BLACKLIST_DELTA_STATUS
+{
+	BlacklistDeltaOk,
+
+	// Something other than lines being added to the end has happened to the file.
+	BlacklistDeltaNotAppended,
+
+	// The new lines have directives in them, which could change what the tokens already loaded mean.
+	BlacklistDeltaHasDirectives,
+
+	BlacklistDeltaOutOfMemory
+
+} BLACKLIST_DELTA_STATUS;
+
+typedef struct BLACKLIST_DELTA_STATS
+{
+	uint64_t LinesRead;
+
+	// Unique tokens in the appended lines, and how many of them the base already had.
+	uint32_t Tokens;
+
+	uint32_t KnownTokens;
+
+} BLACKLIST_DELTA_STATS;
+
+void BlacklistTextPrefixInitialize(BLACKLIST_TEXT_PREFIX* Prefix, const uint8_t* Text, size_t Size);
+
+bool BlacklistTextPrefixExtend(BLACKLIST_TEXT_PREFIX* Prefix, const uint8_t* Text, size_t Size);
+
+BLACKLIST_DELTA_STATUS BlacklistDeltaLoad(uint32_t BaseTokenCount, const AC_AUTOMATON* Base, const uint8_t* Appended, size_t Size, TOKEN_STORE* Tokens, AC_AUTOMATON** Overlay, BLACKLIST_DELTA_STATS* Stats);
+
+const char* BlacklistDeltaStatusString(BLACKLIST_DELTA_STATUS Status);
+
+bool BlacklistDeltaNeedsCompaction(uint32_t BaseTokenCount, uint32_t OverlayTokenCount);
+
+uint32_t BlacklistDeltaToken(const TOKEN_DAWG* BaseTokens, const TOKEN_STORE* OverlayTokens, uint32_t PatternId, uint8_t* Token);
@@ -0,0 +1,607 @@
+/*
+BlacklistImage.c
+
+A precompiled, binary form of the blacklist.
+
+Parsing, sorting and compiling a big PassFiltExBlacklist.txt takes a while, and every domain controller used to do all of it
+again every time the file changed. PassFiltExTool can do that work once, offline, and write the result out as an image: the
+normalized, deduplicated token store and the finished Aho-Corasick tables, each one laid out exactly as it is used in memory.
+
+The DLL maps the image read-only and points the TOKEN_STORE and AC_AUTOMATON straight at the mapped view. Nothing is parsed
+or copied. The only work left is checking that the image can be trusted, because a damaged table inside lsass would be far
+worse than no blacklist at all:
+
+  - The header must agree with itself and with the size of the file, and the CRC-32 must match.
+
+  - Every index in every table must point inside its table, failure and dictionary links must always lead to a shallower state
+    (otherwise the matcher could loop forever), and the depth of each state that ends a pattern must be that pattern's length.
+
+If the blacklist has substitutions (see Blacklist.c), the image ends with the 256-byte substitution map, which has to send
+every character to one that maps to itself, and every token must already be written with those. A !distance (see
+FuzzyMatch.c) is kept in the header. Rules come after that: the coverage and the combined coverage, and for !rule lines each
+token's coverage along with the Reach and Span tables made from them, which are checked by working each entry out again from the
+one at the state's dictionary link. A !strength (see Strength.c) is kept in the coverage section too, under a version of its
+own, but its tables are built again on open, since they only take a pass over the token lengths. The coverage section bytes that
+no version uses yet must be zero, so that one can be given a meaning later without an older DLL reading it as something else. Images without directives are exactly what they were before there were any, version and all.
+
+The format is little-endian, which is all that Windows runs on.
+
+Platform-neutral C.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistImage.h"
+
+#include "FuzzyMatch.h"
+
+#include "Strength.h"
+
+// The image relies on the exact layout of AC_STATE.
+typedef char AC_STATE_SIZE_CHECK[(sizeof(AC_STATE) == 20) ? 1 : -1];
+
+typedef char BLACKLIST_IMAGE_HEADER_SIZE_CHECK[(sizeof(BLACKLIST_IMAGE_HEADER) == 96) ? 1 : -1];
+
+static uint64_t AlignUp(uint64_t Value)
+{
+	return((Value + (BLACKLIST_IMAGE_ALIGNMENT - 1)) & ~(uint64_t)(BLACKLIST_IMAGE_ALIGNMENT - 1));
+}
+
+// Fills in the section offsets and the total size from the counts in the header.
+static void ComputeLayout(BLACKLIST_IMAGE_HEADER* Header)
+{
+	uint64_t Cursor = AlignUp(sizeof(BLACKLIST_IMAGE_HEADER));
+
+	Header->OffsetsOffset = Cursor;
+
+	Cursor = AlignUp(Cursor + (((uint64_t)Header->TokenCount + 1) * sizeof(uint32_t)));
+
+	Header->BytesOffset = Cursor;
+
+	Cursor = AlignUp(Cursor + Header->TokenByteCount);
+
+	Header->StatesOffset = Cursor;
+
+	Cursor = AlignUp(Cursor + ((uint64_t)Header->StateCount * sizeof(AC_STATE)));
+
+	Header->EdgeLabelsOffset = Cursor;
+
+	Cursor = AlignUp(Cursor + Header->EdgeCount);
+
+	Header->EdgeTargetsOffset = Cursor;
+
+	Cursor = AlignUp(Cursor + ((uint64_t)Header->EdgeCount * sizeof(uint32_t)));
+
+	Header->RootTransitionsOffset = Cursor;
+
+	Cursor += AC_ALPHABET_SIZE * sizeof(uint32_t);
+
+	// Right after the root transitions, which always end on a multiple of the alignment.
+	if (Header->Flags & BLACKLIST_IMAGE_FLAG_SUBSTITUTIONS)
+	{
+		Cursor += AC_ALPHABET_SIZE;
+	}
+
+	if (Header->Flags & BLACKLIST_IMAGE_FLAG_COVERAGE)
+	{
+		Cursor += BLACKLIST_IMAGE_COVERAGE_SIZE;
+	}
+
+	if (Header->Flags & BLACKLIST_IMAGE_FLAG_TOKEN_RULES)
+	{
+		Cursor = AlignUp(Cursor + Header->TokenCount);
+
+		Cursor = AlignUp(Cursor + ((uint64_t)Header->StateCount * sizeof(uint16_t)));
+
+		Cursor = AlignUp(Cursor + ((uint64_t)Header->StateCount * sizeof(uint16_t)));
+	}
+
+	Header->ImageSize = Cursor;
+}
+
+// Where the sections after the root transitions start. The header has no offsets for them, as they are found the same way.
+static uint64_t CoverageOffset(const BLACKLIST_IMAGE_HEADER* Header)
+{
+	return(Header->RootTransitionsOffset + (AC_ALPHABET_SIZE * sizeof(uint32_t)) + ((Header->Flags & BLACKLIST_IMAGE_FLAG_SUBSTITUTIONS) ? AC_ALPHABET_SIZE : 0));
+}
+
+static uint64_t PatternCoverageOffset(const BLACKLIST_IMAGE_HEADER* Header)
+{
+	return(CoverageOffset(Header) + ((Header->Flags & BLACKLIST_IMAGE_FLAG_COVERAGE) ? BLACKLIST_IMAGE_COVERAGE_SIZE : 0));
+}
+
+static uint64_t ReachOffset(const BLACKLIST_IMAGE_HEADER* Header)
+{
+	return(AlignUp(PatternCoverageOffset(Header) + Header->TokenCount));
+}
+
+static uint64_t SpanOffset(const BLACKLIST_IMAGE_HEADER* Header)
+{
+	return(AlignUp(ReachOffset(Header) + ((uint64_t)Header->StateCount * sizeof(uint16_t))));
+}
+
+static void FillHeader(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton, BLACKLIST_IMAGE_HEADER* Header)
+{
+	memset(Header, 0, sizeof(BLACKLIST_IMAGE_HEADER));
+
+	Header->Magic = BLACKLIST_IMAGE_MAGIC;
+
+	Header->Version = (Automaton->Substituting || Automaton->EditDistance > 0) ? BLACKLIST_IMAGE_VERSION_DIRECTIVES : BLACKLIST_IMAGE_VERSION;
+
+	Header->Flags = Automaton->Substituting ? BLACKLIST_IMAGE_FLAG_SUBSTITUTIONS : 0;
+
+	if (Automaton->Coverage != AC_DEFAULT_COVERAGE || Automaton->CombinedCoverage != 0 || Automaton->MinimumStrength != 0)
+	{
+		Header->Flags |= BLACKLIST_IMAGE_FLAG_COVERAGE;
+	}
+
+	if (Automaton->Reach != NULL)
+	{
+		Header->Flags |= BLACKLIST_IMAGE_FLAG_TOKEN_RULES;
+	}
+
+	if (Header->Flags & (BLACKLIST_IMAGE_FLAG_COVERAGE | BLACKLIST_IMAGE_FLAG_TOKEN_RULES))
+	{
+		Header->Version = (Automaton->MinimumStrength != 0) ? BLACKLIST_IMAGE_VERSION_STRENGTH : BLACKLIST_IMAGE_VERSION_RULES;
+	}
+
+	Header->EditDistance = Automaton->EditDistance;
+
+	Header->HeaderSize = sizeof(BLACKLIST_IMAGE_HEADER);
+
+	Header->TokenCount = Tokens->TokenCount;
+
+	Header->TokenByteCount = Tokens->ByteCount;
+
+	Header->StateCount = Automaton->StateCount;
+
+	Header->EdgeCount = Automaton->EdgeCount;
+
+	Header->PatternCount = Automaton->PatternCount;
+
+	ComputeLayout(Header);
+}
+
+uint32_t BlacklistImageCrc32(uint32_t Crc, const void* Data, size_t Size)
+{
+	uint32_t Table[256];
+
+	const uint8_t* Bytes = Data;
+
+	for (uint32_t Index = 0; Index < 256; Index++)
+	{
+		uint32_t Value = Index;
+
+		for (int Bit = 0; Bit < 8; Bit++)
+		{
+			Value = (Value & 1) ? (0xEDB88320 ^ (Value >> 1)) : (Value >> 1);
+		}
+
+		Table[Index] = Value;
+	}
+
+	Crc = ~Crc;
+
+	for (size_t Index = 0; Index < Size; Index++)
+	{
+		Crc = Table[(Crc ^ Bytes[Index]) & 0xFF] ^ (Crc >> 8);
+	}
+
+	return(~Crc);
+}
+
+size_t BlacklistImageSize(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton)
+{
+	BLACKLIST_IMAGE_HEADER Header;
+
+	FillHeader(Tokens, Automaton, &Header);
+
+	if (Header.ImageSize > (size_t)-1)
+	{
+		return(0);
+	}
+
+	return((size_t)Header.ImageSize);
+}
+
+bool BlacklistImageWrite(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton, void* Buffer, size_t BufferSize)
+{
+	BLACKLIST_IMAGE_HEADER Header;
+
+	uint8_t* Image = Buffer;
+
+	FillHeader(Tokens, Automaton, &Header);
+
+	if (BufferSize < Header.ImageSize)
+	{
+		return(false);
+	}
+
+	// Zero first so that the alignment padding is deterministic. Two compiles of the same list give identical files.
+	memset(Image, 0, (size_t)Header.ImageSize);
+
+	memcpy(Image + Header.OffsetsOffset, Tokens->Offsets, ((size_t)Tokens->TokenCount + 1) * sizeof(uint32_t));
+
+	memcpy(Image + Header.BytesOffset, Tokens->Bytes, Tokens->ByteCount);
+
+	memcpy(Image + Header.StatesOffset, Automaton->States, (size_t)Automaton->StateCount * sizeof(AC_STATE));
+
+	memcpy(Image + Header.EdgeLabelsOffset, Automaton->EdgeLabels, Automaton->EdgeCount);
+
+	memcpy(Image + Header.EdgeTargetsOffset, Automaton->EdgeTargets, (size_t)Automaton->EdgeCount * sizeof(uint32_t));
+
+	memcpy(Image + Header.RootTransitionsOffset, Automaton->RootTransitions, sizeof(Automaton->RootTransitions));
+
+	if (Automaton->Substituting)
+	{
+		memcpy(Image + Header.RootTransitionsOffset + sizeof(Automaton->RootTransitions), Automaton->Substitutions, sizeof(Automaton->Substitutions));
+	}
+
+	if (Header.Flags & BLACKLIST_IMAGE_FLAG_COVERAGE)
+	{
+		Image[CoverageOffset(&Header)] = Automaton->Coverage;
+
+		Image[CoverageOffset(&Header) + 1] = Automaton->CombinedCoverage;
+
+		Image[CoverageOffset(&Header) + 2] = Automaton->MinimumStrength;
+	}
+
+	if (Header.Flags & BLACKLIST_IMAGE_FLAG_TOKEN_RULES)
+	{
+		memcpy(Image + PatternCoverageOffset(&Header), Automaton->PatternCoverage, Tokens->TokenCount);
+
+		memcpy(Image + ReachOffset(&Header), Automaton->Reach, (size_t)Automaton->StateCount * sizeof(uint16_t));
+
+		memcpy(Image + SpanOffset(&Header), Automaton->Span, (size_t)Automaton->StateCount * sizeof(uint16_t));
+	}
+
+	Header.Checksum = BlacklistImageCrc32(0, Image + Header.HeaderSize, (size_t)Header.ImageSize - Header.HeaderSize);
+
+	memcpy(Image, &Header, sizeof(Header));
+
+	return(true);
+}
+
+static bool ValidateTables(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton)
+{
+	if (Tokens->Offsets[0] != 0 || Tokens->Offsets[Tokens->TokenCount] != Tokens->ByteCount)
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < Tokens->TokenCount; Index++)
+	{
+		// Every token has at least one character.
+		if (Tokens->Offsets[Index] >= Tokens->Offsets[Index + 1])
+		{
+			return(false);
+		}
+	}
+
+	if (Automaton->StateCount == 0 || Automaton->PatternCount > Tokens->TokenCount)
+	{
+		return(false);
+	}
+
+	const AC_STATE* Root = &Automaton->States[AC_ROOT_STATE];
+
+	if (Root->Depth != 0 || Root->Failure != AC_ROOT_STATE || Root->DictionaryLink != AC_ROOT_STATE || Root->PatternId != AC_NO_PATTERN)
+	{
+		return(false);
+	}
+
+	for (uint32_t StateIndex = 0; StateIndex < Automaton->StateCount; StateIndex++)
+	{
+		const AC_STATE* State = &Automaton->States[StateIndex];
+
+		if ((uint64_t)State->FirstEdge + State->EdgeCount > Automaton->EdgeCount ||
+			State->Failure >= Automaton->StateCount ||
+			State->DictionaryLink >= Automaton->StateCount)
+		{
+			return(false);
+		}
+
+		if (StateIndex != AC_ROOT_STATE &&
+			(Automaton->States[State->Failure].Depth >= State->Depth || Automaton->States[State->DictionaryLink].Depth >= State->Depth))
+		{
+			return(false);
+		}
+
+		if (State->PatternId != AC_NO_PATTERN)
+		{
+			if (State->PatternId >= Tokens->TokenCount ||
+				Tokens->Offsets[State->PatternId + 1] - Tokens->Offsets[State->PatternId] != State->Depth)
+			{
+				return(false);
+			}
+		}
+
+		for (uint32_t Edge = State->FirstEdge; Edge < State->FirstEdge + State->EdgeCount; Edge++)
+		{
+			uint32_t Target = Automaton->EdgeTargets[Edge];
+
+			if (Target >= Automaton->StateCount || Automaton->States[Target].Depth != State->Depth + 1)
+			{
+				return(false);
+			}
+		}
+	}
+
+	for (uint32_t Label = 0; Label < AC_ALPHABET_SIZE; Label++)
+	{
+		if (Automaton->RootTransitions[Label] >= Automaton->StateCount)
+		{
+			return(false);
+		}
+	}
+
+	if (Automaton->Substituting)
+	{
+		// A password is canonicalized once. A map that needed applying twice would leave it half done.
+		for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+		{
+			if (Automaton->Substitutions[Automaton->Substitutions[Character]] != Automaton->Substitutions[Character])
+			{
+				return(false);
+			}
+		}
+
+		for (uint32_t Index = 0; Index < Tokens->ByteCount; Index++)
+		{
+			if (Automaton->Substitutions[Tokens->Bytes[Index]] != Tokens->Bytes[Index])
+			{
+				return(false);
+			}
+		}
+	}
+
+	if (Automaton->Coverage == 0 || Automaton->Coverage > 100 || Automaton->CombinedCoverage > 100 || Automaton->MinimumStrength > STRENGTH_MAX_MINIMUM)
+	{
+		return(false);
+	}
+
+	if (Automaton->Reach != NULL)
+	{
+		for (uint32_t Index = 0; Index < Tokens->TokenCount; Index++)
+		{
+			uint32_t Percent = Automaton->PatternCoverage[Index] & AC_COVERAGE_PERCENT;
+
+			// An exact token is written down as 100%, which is what it is for a password on its own.
+			if (Percent == 0 || Percent > 100 || ((Automaton->PatternCoverage[Index] & AC_COVERAGE_EXACT) != 0 && Percent != 100))
+			{
+				return(false);
+			}
+		}
+
+		// Every entry is checked against the one at the state's dictionary link, which is closer to the root, so all of them
+		// together can only be the tables that AcBuildReach would have made.
+		for (uint32_t StateIndex = 0; StateIndex < Automaton->StateCount; StateIndex++)
+		{
+			uint16_t Reach = 0;
+
+			uint16_t Span = 0;
+
+			AcStateReach(Automaton, StateIndex, &Reach, &Span);
+
+			if (Automaton->Reach[StateIndex] != Reach || Automaton->Span[StateIndex] != Span)
+			{
+				return(false);
+			}
+		}
+	}
+
+	return(true);
+}
+
+/*
+Validates the image and, if it is good, points Tokens and a newly allocated AC_AUTOMATON into it. Nothing is copied except the
+256 root transitions, the substitution map and the coverage, so the image must stay mapped for as long as either of them is in
+use. Free the automaton with AcDestroy; the tables themselves are left alone. If Dawg isn't NULL, the tokens are built into it
+as well (see BlacklistBuildDawg), and it doesn't need the image.
+
+*/
+BLACKLIST_IMAGE_STATUS BlacklistImageOpen(const void* Image, size_t ImageSize, TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, AC_AUTOMATON** Automaton)
+{
+	BLACKLIST_IMAGE_HEADER Header;
+
+	BLACKLIST_IMAGE_HEADER Expected;
+
+	const uint8_t* Bytes = Image;
+
+	AC_AUTOMATON* NewAutomaton = NULL;
+
+	memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+	if (Dawg != NULL)
+	{
+		memset(Dawg, 0, sizeof(TOKEN_DAWG));
+	}
+
+	*Automaton = NULL;
+
+	if (ImageSize < sizeof(BLACKLIST_IMAGE_HEADER))
+	{
+		return(BlacklistImageTooSmall);
+	}
+
+	memcpy(&Header, Image, sizeof(Header));
+
+	if (Header.Magic != BLACKLIST_IMAGE_MAGIC)
+	{
+		return(BlacklistImageBadMagic);
+	}
+
+	bool HasStrength = (Header.Version == BLACKLIST_IMAGE_VERSION_STRENGTH);
+
+	bool HasRules = (Header.Version == BLACKLIST_IMAGE_VERSION_RULES || HasStrength);
+
+	bool UnknownCoverage = false;
+
+	bool HasDirectives = (Header.Version == BLACKLIST_IMAGE_VERSION_DIRECTIVES || HasRules);
+
+	if ((Header.Version != BLACKLIST_IMAGE_VERSION && HasDirectives == false) || Header.HeaderSize != sizeof(BLACKLIST_IMAGE_HEADER))
+	{
+		return(BlacklistImageBadVersion);
+	}
+
+	// Don't trust any offset in the file. Work out where everything has to be from the counts, and insist that the file agrees.
+	memcpy(&Expected, &Header, sizeof(Header));
+
+	Expected.Flags = HasDirectives ? (Header.Flags & BLACKLIST_IMAGE_FLAG_SUBSTITUTIONS) : 0;
+
+	Expected.Flags |= HasRules ? (Header.Flags & (BLACKLIST_IMAGE_FLAG_COVERAGE | BLACKLIST_IMAGE_FLAG_TOKEN_RULES)) : 0;
+
+	Expected.EditDistance = (HasDirectives && Header.EditDistance <= FUZZY_MAX_DISTANCE) ? Header.EditDistance : 0;
+
+	bool Substituting = ((Expected.Flags & BLACKLIST_IMAGE_FLAG_SUBSTITUTIONS) != 0);
+
+	ComputeLayout(&Expected);
+
+	if (memcmp(&Expected, &Header, sizeof(Header)) != 0 || Header.ImageSize != ImageSize)
+	{
+		return(BlacklistImageBadLayout);
+	}
+
+	if (BlacklistImageCrc32(0, Bytes + Header.HeaderSize, ImageSize - Header.HeaderSize) != Header.Checksum)
+	{
+		return(BlacklistImageBadChecksum);
+	}
+
+	if ((NewAutomaton = calloc(1, sizeof(AC_AUTOMATON))) == NULL)
+	{
+		return(BlacklistImageOutOfMemory);
+	}
+
+	Tokens->TokenCount = Header.TokenCount;
+
+	Tokens->ByteCount = Header.TokenByteCount;
+
+	Tokens->Offsets = (const uint32_t*)(const void*)(Bytes + Header.OffsetsOffset);
+
+	Tokens->Bytes = Bytes + Header.BytesOffset;
+
+	Tokens->Allocation = NULL;
+
+	NewAutomaton->StateCount = Header.StateCount;
+
+	NewAutomaton->EdgeCount = Header.EdgeCount;
+
+	NewAutomaton->PatternCount = Header.PatternCount;
+
+	NewAutomaton->States = (AC_STATE*)(uintptr_t)(Bytes + Header.StatesOffset);
+
+	NewAutomaton->EdgeLabels = (uint8_t*)(uintptr_t)(Bytes + Header.EdgeLabelsOffset);
+
+	NewAutomaton->EdgeTargets = (uint32_t*)(uintptr_t)(Bytes + Header.EdgeTargetsOffset);
+
+	NewAutomaton->TablesBorrowed = true;
+
+	memcpy(NewAutomaton->RootTransitions, Bytes + Header.RootTransitionsOffset, sizeof(NewAutomaton->RootTransitions));
+
+	NewAutomaton->EditDistance = (uint8_t)Header.EditDistance;
+
+	NewAutomaton->Coverage = AC_DEFAULT_COVERAGE;
+
+	if (Expected.Flags & BLACKLIST_IMAGE_FLAG_COVERAGE)
+	{
+		NewAutomaton->Coverage = Bytes[CoverageOffset(&Header)];
+
+		NewAutomaton->CombinedCoverage = Bytes[CoverageOffset(&Header) + 1];
+
+		NewAutomaton->MinimumStrength = HasStrength ? Bytes[CoverageOffset(&Header) + 2] : 0;
+
+		for (uint32_t Index = HasStrength ? 3 : 2; Index < BLACKLIST_IMAGE_COVERAGE_SIZE; Index++)
+		{
+			UnknownCoverage |= (Bytes[CoverageOffset(&Header) + Index] != 0);
+		}
+	}
+
+	// A version 4 image without a !strength is not one this code wrote.
+	UnknownCoverage |= (HasStrength && NewAutomaton->MinimumStrength == 0);
+
+	if (Expected.Flags & BLACKLIST_IMAGE_FLAG_TOKEN_RULES)
+	{
+		NewAutomaton->PatternCoverage = (uint8_t*)(uintptr_t)(Bytes + PatternCoverageOffset(&Header));
+
+		NewAutomaton->Reach = (uint16_t*)(uintptr_t)(Bytes + ReachOffset(&Header));
+
+		NewAutomaton->Span = (uint16_t*)(uintptr_t)(Bytes + SpanOffset(&Header));
+	}
+
+	if (Substituting)
+	{
+		NewAutomaton->Substituting = true;
+
+		memcpy(NewAutomaton->Substitutions, Bytes + Header.RootTransitionsOffset + sizeof(NewAutomaton->RootTransitions), sizeof(NewAutomaton->Substitutions));
+	}
+
+	if (UnknownCoverage || ValidateTables(Tokens, NewAutomaton) == false)
+	{
+		AcDestroy(NewAutomaton);
+
+		memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+		return(BlacklistImageBadTables);
+	}
+
+	if (BlacklistBuildDawg(Tokens, NewAutomaton, Dawg) == false)
+	{
+		AcDestroy(NewAutomaton);
+
+		memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+		return(BlacklistImageOutOfMemory);
+	}
+
+	*Automaton = NewAutomaton;
+
+	return(BlacklistImageOk);
+}
+
+const char* BlacklistImageStatusString(BLACKLIST_IMAGE_STATUS Status)
+{
+	switch (Status)
+	{
+		case BlacklistImageOk:
+		{
+			return("OK");
+		}
+		case BlacklistImageTooSmall:
+		{
+			return("file is too small to be a blacklist image");
+		}
+		case BlacklistImageBadMagic:
+		{
+			return("not a blacklist image");
+		}
+		case BlacklistImageBadVersion:
+		{
+			return("unsupported image version");
+		}
+		case BlacklistImageBadLayout:
+		{
+			return("header does not match the file");
+		}
+		case BlacklistImageBadChecksum:
+		{
+			return("checksum mismatch");
+		}
+		case BlacklistImageBadTables:
+		{
+			return("tables are inconsistent");
+		}
+		case BlacklistImageOutOfMemory:
+		{
+			return("out of memory");
+		}
+		default:
+		{
+			return("unknown error");
+		}
+	}
+}
@@ -0,0 +1,122 @@
+// Please read BlacklistImage.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "TokenDawg.h"
+
+#include "TokenStore.h"
+
+// "PFXB" in a little-endian file.
+#define BLACKLIST_IMAGE_MAGIC 0x42584650
+
+#define BLACKLIST_IMAGE_VERSION 1
+
+// An image of a blacklist with directives (see Blacklist.c) gets a version of its own, so that DLLs from before them turn it down
+// instead of matching without them. Substitutions take one more section, after the root transitions, and a flag says it is there.
+#define BLACKLIST_IMAGE_VERSION_DIRECTIVES 2
+
+#define BLACKLIST_IMAGE_FLAG_SUBSTITUTIONS 0x00000001
+
+// An image of a blacklist with rules (!coverage, !combined or !rule lines) is newer again. After the substitutions, if any, come
+// an 8-byte section with the coverage and the combined coverage, and then, for !rule lines, the coverage of every token and the
+// Reach and Span tables, each on a multiple of the alignment. The rest of the 8 bytes must be zero.
+#define BLACKLIST_IMAGE_VERSION_RULES 3
+
+// An image of a blacklist with a !strength is laid out the same, with the !strength in the third byte of the coverage section.
+// It gets a version of its own so that DLLs from before it turn the image down instead of accepting passwords without estimating.
+#define BLACKLIST_IMAGE_VERSION_STRENGTH 4
+
+#define BLACKLIST_IMAGE_FLAG_COVERAGE 0x00000002
+
+#define BLACKLIST_IMAGE_FLAG_TOKEN_RULES 0x00000004
+
+#define BLACKLIST_IMAGE_COVERAGE_SIZE 8
+
+// Every section starts on a multiple of this, so the tables can be used straight out of a mapped view.
+#define BLACKLIST_IMAGE_ALIGNMENT 8
+
+typedef struct BLACKLIST_IMAGE_HEADER
+{
+	uint32_t Magic;
+
+	uint16_t Version;
+
+	uint16_t HeaderSize;
+
+	// CRC-32 of everything after the header.
+	uint32_t Checksum;
+
+	uint32_t Flags;
+
+	uint64_t ImageSize;
+
+	uint32_t TokenCount;
+
+	uint32_t TokenByteCount;
+
+	uint32_t StateCount;
+
+	uint32_t EdgeCount;
+
+	uint32_t PatternCount;
+
+	// The blacklist's !distance. Always 0 in a version 1 image.
+	uint32_t EditDistance;
+
+	uint64_t OffsetsOffset;
+
+	uint64_t BytesOffset;
+
+	uint64_t StatesOffset;
+
+	uint64_t EdgeLabelsOffset;
+
+	uint64_t EdgeTargetsOffset;
+
+	uint64_t RootTransitionsOffset;
+
+} BLACKLIST_IMAGE_HEADER;
+
+typedef enum BLACKLIST_IMAGE_STATUS
+{
+	BlacklistImageOk,
+
+	BlacklistImageTooSmall,
+
+	BlacklistImageBadMagic,
+
+	BlacklistImageBadVersion,
+
+	BlacklistImageBadLayout,
+
+	BlacklistImageBadChecksum,
+
+	BlacklistImageBadTables,
+
+	BlacklistImageOutOfMemory
+
+} BLACKLIST_IMAGE_STATUS;
+
+size_t BlacklistImageSize(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton);
+
+bool BlacklistImageWrite(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton, void* Buffer, size_t BufferSize);
+
+BLACKLIST_IMAGE_STATUS BlacklistImageOpen(const void* Image, size_t ImageSize, TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, AC_AUTOMATON** Automaton);
+
+const char* BlacklistImageStatusString(BLACKLIST_IMAGE_STATUS Status);
+
+uint32_t BlacklistImageCrc32(uint32_t Crc, const void* Data, size_t Size);
@@ -0,0 +1,197 @@
+/*
+BlacklistParser.c
+
+Splits the raw bytes of the blacklist file into lines.
+
+The old loader called ReadFile once per byte. Now the caller hands us the file in as few pieces as it likes (usually one
+piece: a view of the whole memory-mapped file) and we look for the end of each line 16 bytes at a time.
+
+The rules are the same ones the byte-at-a-time loader had:
+
+  - A line ends at \n. Either \r\n or \n line endings work because \r is a control character, and
+
+  - all bytes below 0x20 are dropped, wherever they are on the line.
+
+  - Lines that are longer than MaxLineLength are truncated. The rest of the line is thrown away.
+
+  - Empty lines are counted but not reported.
+
+Case folding is not done here. That is up to whoever consumes the lines.
+
+Platform-neutral C, with an SSE2 fast path when the compiler targets x86 or x64.
+
+*/
+
+#include <string.h>
+
+#include "BlacklistParser.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+
+#define BLACKLIST_PARSER_SSE2
+
+#include <emmintrin.h>
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+#endif
+
+#endif
+
+#ifdef BLACKLIST_PARSER_SSE2
+
+static unsigned int CountTrailingZeros(unsigned int Mask)
+{
+#ifdef _MSC_VER
+
+	unsigned long Index = 0;
+
+	_BitScanForward(&Index, Mask);
+
+	return(Index);
+
+#else
+
+	return((unsigned int)__builtin_ctz(Mask));
+
+#endif
+}
+
+#endif
+
+// Returns the offset of the first byte below 0x20, or Size if there isn't one.
+size_t BlacklistFindControlByte(const uint8_t* Data, size_t Size)
+{
+	size_t Offset = 0;
+
+#ifdef BLACKLIST_PARSER_SSE2
+
+	const __m128i Limit = _mm_set1_epi8(0x1F);
+
+	for (; Offset + 16 <= Size; Offset += 16)
+	{
+		__m128i Block = _mm_loadu_si128((const __m128i*)(const void*)(Data + Offset));
+
+		// SSE2 has no unsigned byte compare, but min(x, 0x1F) == x only when x <= 0x1F.
+		unsigned int Mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(Block, Limit), Block));
+
+		if (Mask != 0)
+		{
+			return(Offset + CountTrailingZeros(Mask));
+		}
+	}
+
+#endif
+
+	for (; Offset < Size; Offset++)
+	{
+		if (Data[Offset] < 0x20)
+		{
+			return(Offset);
+		}
+	}
+
+	return(Size);
+}
+
+static void BlacklistParserEmitLine(BLACKLIST_PARSER* Parser, const uint8_t* Line, uint32_t Length, bool Truncated)
+{
+	Parser->LinesRead++;
+
+	if (Truncated)
+	{
+		Parser->TruncatedLines++;
+	}
+
+	if (Length == 0)
+	{
+		Parser->EmptyLines++;
+	}
+	else if (Parser->Callback(Parser->Context, Line, Length) == false)
+	{
+		Parser->Stopped = true;
+	}
+
+	Parser->LineLength = 0;
+
+	Parser->LineTruncated = false;
+}
+
+static void BlacklistParserAppend(BLACKLIST_PARSER* Parser, const uint8_t* Data, size_t Length)
+{
+	size_t Room = Parser->MaxLineLength - Parser->LineLength;
+
+	if (Length > Room)
+	{
+		Length = Room;
+
+		Parser->LineTruncated = true;
+	}
+
+	memcpy(Parser->Line + Parser->LineLength, Data, Length);
+
+	Parser->LineLength += (uint32_t)Length;
+}
+
+void BlacklistParserInitialize(BLACKLIST_PARSER* Parser, uint32_t MaxLineLength, BLACKLIST_LINE_CALLBACK Callback, void* Context)
+{
+	memset(Parser, 0, sizeof(BLACKLIST_PARSER));
+
+	Parser->Callback = Callback;
+
+	Parser->Context = Context;
+
+	Parser->MaxLineLength = (MaxLineLength > BLACKLIST_PARSER_MAX_LINE) ? BLACKLIST_PARSER_MAX_LINE : MaxLineLength;
+}
+
+// May be called any number of times with consecutive pieces of the file. Returns false if the callback asked us to stop.
+bool BlacklistParserFeed(BLACKLIST_PARSER* Parser, const uint8_t* Data, size_t Size)
+{
+	size_t Cursor = 0;
+
+	while (Cursor < Size && Parser->Stopped == false)
+	{
+		size_t RunEnd = Cursor + BlacklistFindControlByte(Data + Cursor, Size - Cursor);
+
+		size_t RunLength = RunEnd - Cursor;
+
+		bool EndOfLine = (RunEnd < Size && Data[RunEnd] == 0x0A);
+
+		if (EndOfLine && Parser->LineLength == 0 && Parser->LineTruncated == false)
+		{
+			// The common case: the whole line is right here in one piece, so there is no need to copy it anywhere.
+			bool Truncated = (RunLength > Parser->MaxLineLength);
+
+			BlacklistParserEmitLine(Parser, Data + Cursor, Truncated ? Parser->MaxLineLength : (uint32_t)RunLength, Truncated);
+		}
+		else
+		{
+			BlacklistParserAppend(Parser, Data + Cursor, RunLength);
+
+			if (EndOfLine)
+			{
+				BlacklistParserEmitLine(Parser, Parser->Line, Parser->LineLength, Parser->LineTruncated);
+			}
+		}
+
+		// Step over the control character that ended the run. If it wasn't \n, it's simply dropped.
+		Cursor = (RunEnd < Size) ? RunEnd + 1 : RunEnd;
+	}
+
+	Parser->BytesRead += Cursor;
+
+	return(Parser->Stopped == false);
+}
+
+// The last line of the file doesn't need a trailing newline.
+bool BlacklistParserFinish(BLACKLIST_PARSER* Parser)
+{
+	if (Parser->Stopped == false && (Parser->LineLength > 0 || Parser->LineTruncated))
+	{
+		BlacklistParserEmitLine(Parser, Parser->Line, Parser->LineLength, Parser->LineTruncated);
+	}
+
+	return(Parser->Stopped == false);
+}
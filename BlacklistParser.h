@@ -0,0 +1,55 @@
+// Please read BlacklistParser.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#define BLACKLIST_PARSER_MAX_LINE 1024
+
+// Called once for every non-empty line. Returning false stops the parser.
+typedef bool (*BLACKLIST_LINE_CALLBACK)(void* Context, const uint8_t* Line, uint32_t Length);
+
+typedef struct BLACKLIST_PARSER
+{
+	BLACKLIST_LINE_CALLBACK Callback;
+
+	void* Context;
+
+	uint32_t MaxLineLength;
+
+	uint32_t LineLength;
+
+	bool LineTruncated;
+
+	bool Stopped;
+
+	uint64_t BytesRead;
+
+	uint64_t LinesRead;
+
+	uint64_t EmptyLines;
+
+	uint64_t TruncatedLines;
+
+	// Holds a line that is split across two calls to BlacklistParserFeed, or that has control characters in the middle of it.
+	uint8_t Line[BLACKLIST_PARSER_MAX_LINE];
+
+} BLACKLIST_PARSER;
+
+void BlacklistParserInitialize(BLACKLIST_PARSER* Parser, uint32_t MaxLineLength, BLACKLIST_LINE_CALLBACK Callback, void* Context);
+
+bool BlacklistParserFeed(BLACKLIST_PARSER* Parser, const uint8_t* Data, size_t Size);
+
+bool BlacklistParserFinish(BLACKLIST_PARSER* Parser);
+
+size_t BlacklistFindControlByte(const uint8_t* Data, size_t Size);
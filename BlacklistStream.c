@@ -0,0 +1,354 @@
+/*
+BlacklistStream.c
+
+Loads a blacklist file that has been compressed with gzip, without ever writing it out or holding all of it uncompressed.
+
+A breach list of a few hundred million lines is gigabytes of text, but a fraction of that gzipped, and the file has to be
+copied to every DC. So PassFiltExBlacklist.txt may be gzipped as it is, and it is told apart from text by its first bytes.
+
+Loading it is a pipeline of two threads:
+
+  - A thread of its own decompresses the file (see Inflate.c) into a ring of BLACKLIST_STREAM_BUFFERS buffers, of
+    BLACKLIST_STREAM_BUFFER_SIZE bytes each. When every buffer is full of text that hasn't been parsed yet, it waits.
+
+  - The calling thread parses each buffer as it is filled, through the same BlacklistParser and BlacklistAddLine as a text
+    file, into one token store builder, and hands the buffer back. When there is nothing to parse yet, it waits.
+
+So decompressing and parsing, which take about as long as each other, happen at the same time, and the text in memory at any
+one moment is at most the ring, whatever size the file is. The parser keeps a line that is split across two buffers, the same
+as it does for any two pieces fed to it.
+
+Lines are read in order, by one BlacklistAddLine, so the tokens, directives and all come out exactly as they would from the
+text (PassFiltExTool stream-bench checks this). The token store is sorted, and the automaton built on the worker pool, the same
+as for a text file, once the last buffer is parsed. The pieces of a text file can be parsed by several threads at once because
+each one can be found in the mapped file without reading what is before it, which can't be done in a gzip stream.
+
+A file that turns out to be damaged is never half loaded: its tokens are thrown away and the load fails, and the blacklist
+that was loaded before stays in use.
+
+zstd files are recognized too, but can't be loaded, as there is no zstd decoder here. They fail with BlacklistLoadUnsupported,
+rather than being read as text full of garbage tokens.
+
+Platform-neutral C.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "BlacklistParser.h"
+
+#include "BlacklistStream.h"
+
+#include "Inflate.h"
+
+#include "Platform.h"
+
+// How long either thread waits for the other before it looks again, in case a wakeup was missed.
+#define BLACKLIST_STREAM_WAIT_MILLISECONDS 1000
+
+typedef struct BLACKLIST_STREAM
+{
+	INFLATE_STREAM Inflate;
+
+	uint8_t* Buffers[BLACKLIST_STREAM_BUFFERS];
+
+	size_t Sizes[BLACKLIST_STREAM_BUFFERS];
+
+	// How many buffers have been filled, and how many parsed, since the start. Each is only moved by its own thread.
+	volatile int32_t Filled;
+
+	volatile int32_t Emptied;
+
+	// Set by the decompressor once Status says how the file ended.
+	volatile int32_t Finished;
+
+	// Set by the parser if it runs out of memory, so the decompressor doesn't carry on for nothing.
+	volatile int32_t Stop;
+
+	INFLATE_STATUS Status;
+
+	PLATFORM_EVENT* FilledEvent;
+
+	PLATFORM_EVENT* EmptiedEvent;
+
+} BLACKLIST_STREAM;
+
+static uint32_t BlacklistDecompressProc(void* Argument)
+{
+	BLACKLIST_STREAM* Stream = Argument;
+
+	INFLATE_STATUS Status = InflateOk;
+
+	while (Status == InflateOk)
+	{
+		int32_t Filled = Stream->Filled;
+
+		while (Filled - PlatformLoad(&Stream->Emptied) == BLACKLIST_STREAM_BUFFERS && PlatformLoad(&Stream->Stop) == 0)
+		{
+			PlatformEventWait(Stream->EmptiedEvent, BLACKLIST_STREAM_WAIT_MILLISECONDS);
+		}
+
+		if (PlatformLoad(&Stream->Stop) != 0)
+		{
+			break;
+		}
+
+		uint32_t Slot = (uint32_t)Filled % BLACKLIST_STREAM_BUFFERS;
+
+		Status = InflateRead(&Stream->Inflate, Stream->Buffers[Slot], BLACKLIST_STREAM_BUFFER_SIZE, &Stream->Sizes[Slot]);
+
+		// What came out of a damaged file isn't worth parsing.
+		if (Status != InflateCorrupt)
+		{
+			PlatformStore(&Stream->Filled, Filled + 1);
+
+			PlatformEventSet(Stream->FilledEvent);
+		}
+	}
+
+	Stream->Status = Status;
+
+	PlatformStore(&Stream->Finished, 1);
+
+	PlatformEventSet(Stream->FilledEvent);
+
+	return(0);
+}
+
+// Parses each buffer as the decompressor fills it, until the file ends or the parser stops.
+static void BlacklistParseBuffers(BLACKLIST_STREAM* Stream, BLACKLIST_PARSER* Parser)
+{
+	int32_t Emptied = 0;
+
+	while (Parser->Stopped == false)
+	{
+		// Finished first: once it is set, every buffer that was going to be filled has been.
+		bool Finished = (PlatformLoad(&Stream->Finished) != 0);
+
+		if (Emptied == PlatformLoad(&Stream->Filled))
+		{
+			if (Finished)
+			{
+				return;
+			}
+
+			PlatformEventWait(Stream->FilledEvent, BLACKLIST_STREAM_WAIT_MILLISECONDS);
+
+			continue;
+		}
+
+		uint32_t Slot = (uint32_t)Emptied % BLACKLIST_STREAM_BUFFERS;
+
+		BlacklistParserFeed(Parser, Stream->Buffers[Slot], Stream->Sizes[Slot]);
+
+		PlatformStore(&Stream->Emptied, ++Emptied);
+
+		PlatformEventSet(Stream->EmptiedEvent);
+	}
+
+	PlatformStore(&Stream->Stop, 1);
+
+	PlatformEventSet(Stream->EmptiedEvent);
+}
+
+// The same, a buffer at a time on the calling thread, for when the decompressor's thread couldn't be started.
+static void BlacklistParseSerially(BLACKLIST_STREAM* Stream, BLACKLIST_PARSER* Parser)
+{
+	INFLATE_STATUS Status = InflateOk;
+
+	while (Status == InflateOk && Parser->Stopped == false)
+	{
+		Status = InflateRead(&Stream->Inflate, Stream->Buffers[0], BLACKLIST_STREAM_BUFFER_SIZE, &Stream->Sizes[0]);
+
+		if (Status != InflateCorrupt)
+		{
+			BlacklistParserFeed(Parser, Stream->Buffers[0], Stream->Sizes[0]);
+		}
+	}
+
+	Stream->Status = Status;
+}
+
+BLACKLIST_COMPRESSION BlacklistCompression(const uint8_t* Data, size_t Size)
+{
+	if (InflateIsGzip(Data, Size))
+	{
+		return(BlacklistCompressionGzip);
+	}
+
+	// A zstd frame's magic number, 0xFD2FB528, little-endian.
+	if (Size >= 4 && Data[0] == 0x28 && Data[1] == 0xB5 && Data[2] == 0x2F && Data[3] == 0xFD)
+	{
+		return(BlacklistCompressionZstd);
+	}
+
+	return(BlacklistCompressionNone);
+}
+
+/*
+Like BlacklistLoad, but Data (all in memory, or mapped) may be compressed, and if it is, it is decompressed as it is parsed.
+Text is simply handed to BlacklistLoad. Stats->BytesRead counts the bytes of text, and Stats->CompressedBytes the bytes of
+Data. Stats->ParseMicroseconds covers decompressing and parsing both, since they overlap, and MergeMicroseconds the sort.
+
+*/
+BLACKLIST_LOAD_STATUS BlacklistLoadCompressed(const uint8_t* Data, size_t Size, const WORKER_POOL* Pool, TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, AC_AUTOMATON** Automaton, BLACKLIST_LOAD_STATS* Stats)
+{
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoadTokensOutOfMemory;
+
+	BLACKLIST_LOAD_CONTEXT LoadContext = { 0 };
+
+	BLACKLIST_COMPRESSION Compression = BlacklistCompression(Data, Size);
+
+	BLACKLIST_STREAM* Stream = NULL;
+
+	BLACKLIST_PARSER* Parser = NULL;
+
+	uint8_t* Buffers = NULL;
+
+	PLATFORM_THREAD* Decompressor = NULL;
+
+	uint64_t StartTime = PlatformTimestamp();
+
+	if (Compression == BlacklistCompressionNone)
+	{
+		return(BlacklistLoad(Data, Size, Pool, Tokens, Dawg, Automaton, Stats));
+	}
+
+	memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+	if (Dawg != NULL)
+	{
+		memset(Dawg, 0, sizeof(TOKEN_DAWG));
+	}
+
+	memset(Stats, 0, sizeof(BLACKLIST_LOAD_STATS));
+
+	*Automaton = NULL;
+
+	Stats->CompressedBytes = Size;
+
+	if (Compression != BlacklistCompressionGzip)
+	{
+		Status = BlacklistLoadUnsupported;
+
+		goto End;
+	}
+
+	if ((Stream = calloc(1, sizeof(BLACKLIST_STREAM))) == NULL ||
+		(Parser = malloc(sizeof(BLACKLIST_PARSER))) == NULL ||
+		(Buffers = malloc((size_t)BLACKLIST_STREAM_BUFFERS * BLACKLIST_STREAM_BUFFER_SIZE)) == NULL ||
+		(LoadContext.Builder = TokenStoreBuilderCreate()) == NULL)
+	{
+		goto End;
+	}
+
+	InflateInitialize(&Stream->Inflate, Data, Size);
+
+	for (uint32_t Index = 0; Index < BLACKLIST_STREAM_BUFFERS; Index++)
+	{
+		Stream->Buffers[Index] = Buffers + (size_t)Index * BLACKLIST_STREAM_BUFFER_SIZE;
+	}
+
+	BlacklistParserInitialize(Parser, MAX_BLACKLIST_STRING_SIZE - 1, BlacklistAddLine, &LoadContext);
+
+	if ((Stream->FilledEvent = PlatformEventCreate()) != NULL &&
+		(Stream->EmptiedEvent = PlatformEventCreate()) != NULL &&
+		(Decompressor = PlatformStartThread(BlacklistDecompressProc, Stream)) != NULL)
+	{
+		BlacklistParseBuffers(Stream, Parser);
+
+		PlatformJoinThread(Decompressor);
+	}
+	else
+	{
+		BlacklistParseSerially(Stream, Parser);
+	}
+
+	BlacklistParserFinish(Parser);
+
+	uint64_t ParsedTime = PlatformTimestamp();
+
+	Stats->BytesRead = Parser->BytesRead;
+
+	Stats->LinesRead = Parser->LinesRead;
+
+	Stats->EmptyLines = Parser->EmptyLines;
+
+	Stats->TruncatedLines = Parser->TruncatedLines;
+
+	Stats->TokensAdded = TokenStoreBuilderCount(LoadContext.Builder);
+
+	Stats->Directives = LoadContext.Directives;
+
+	Stats->LateDirectives = LoadContext.LateDirectives;
+
+	Stats->BadDirectives = LoadContext.BadDirectives;
+
+	Stats->Rules = LoadContext.RuleCount;
+
+	Stats->Threads = WorkerPoolThreadCount(Pool);
+
+	Stats->ParseMicroseconds = PlatformElapsedMicroseconds(StartTime, ParsedTime);
+
+	if (LoadContext.OutOfMemory)
+	{
+		goto End;
+	}
+
+	if (Stream->Status == InflateCorrupt)
+	{
+		Status = BlacklistLoadCorrupt;
+
+		goto End;
+	}
+
+	// The text is gone by now, so only the builder's copy of the lines and the sorted store are ever in memory together.
+	free(Buffers);
+
+	Buffers = NULL;
+
+	if (TokenStoreBuilderFinish(LoadContext.Builder, Tokens) == false)
+	{
+		goto End;
+	}
+
+	uint64_t MergedTime = PlatformTimestamp();
+
+	Stats->MergeMicroseconds = PlatformElapsedMicroseconds(ParsedTime, MergedTime);
+
+	if ((*Automaton = BlacklistBuildAutomaton(Tokens, Dawg, &LoadContext, Pool)) == NULL)
+	{
+		TokenStoreFree(Tokens);
+
+		Status = BlacklistLoadAutomatonOutOfMemory;
+
+		goto End;
+	}
+
+	Stats->AutomatonMicroseconds = PlatformElapsedMicroseconds(MergedTime, PlatformTimestamp());
+
+	Status = BlacklistLoadOk;
+
+End:
+
+	if (Stream != NULL)
+	{
+		PlatformEventDestroy(Stream->FilledEvent);
+
+		PlatformEventDestroy(Stream->EmptiedEvent);
+	}
+
+	TokenStoreBuilderDestroy(LoadContext.Builder);
+
+	BlacklistRulesFree(&LoadContext);
+
+	free(Buffers);
+
+	free(Parser);
+
+	free(Stream);
+
+	return(Status);
+}
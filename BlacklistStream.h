@@ -0,0 +1,36 @@
+// Please read BlacklistStream.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "Blacklist.h"
+
+// How much decompressed text can be waiting to be parsed: BLACKLIST_STREAM_BUFFERS buffers of BLACKLIST_STREAM_BUFFER_SIZE bytes.
+#define BLACKLIST_STREAM_BUFFERS 4
+
+#define BLACKLIST_STREAM_BUFFER_SIZE (1024 * 1024)
+
+typedef enum BLACKLIST_COMPRESSION
+{
+	BlacklistCompressionNone,
+
+	BlacklistCompressionGzip,
+
+	BlacklistCompressionZstd
+
+} BLACKLIST_COMPRESSION;
+
+BLACKLIST_COMPRESSION BlacklistCompression(const uint8_t* Data, size_t Size);
+
+BLACKLIST_LOAD_STATUS BlacklistLoadCompressed(const uint8_t* Data, size_t Size, const WORKER_POOL* Pool, TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg, AC_AUTOMATON** Automaton, BLACKLIST_LOAD_STATS* Stats);
@@ -0,0 +1,69 @@
+/*
+BloomFilter.c
+
+A split block Bloom filter, as used by Parquet and Impala.
+
+An ordinary Bloom filter sets k bits spread over the whole filter, so a lookup costs k cache misses. Here the key picks one
+32-byte block, and one bit is set in each of the block's eight 32-bit words. Any lookup, hit or miss, touches exactly one
+cache line. The price is a slightly higher false positive rate for the same size: about 1.3% at 10 bits per key, compared
+with 0.8% for an unblocked filter.
+
+The keys are expected to be uniformly distributed already (they are taken from NT hashes), so they are used as they are
+instead of being hashed again: the high 32 bits choose the block and the low 32 bits choose the bits.
+
+Platform-neutral C.
+
+*/
+
+#include "BloomFilter.h"
+
+// Odd constants, one per word, that spread the low 32 bits of the key into eight independent-looking bit positions.
+static const uint32_t gBloomSalts[BLOOM_WORDS_PER_BLOCK] = { 0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D, 0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31 };
+
+uint64_t BloomFilterBlockCount(uint64_t KeyCount, uint32_t BitsPerKey)
+{
+	if (KeyCount == 0 || BitsPerKey == 0)
+	{
+		return(0);
+	}
+
+	uint64_t BlockCount = ((KeyCount * BitsPerKey) + (sizeof(BLOOM_BLOCK) * 8) - 1) / (sizeof(BLOOM_BLOCK) * 8);
+
+	// The block is picked with a 32 x 32 bit multiply, see BlockIndex.
+	return((BlockCount > UINT32_MAX) ? UINT32_MAX : BlockCount);
+}
+
+// Maps the high half of the key onto [0, BlockCount) without a division.
+static uint64_t BlockIndex(uint64_t BlockCount, uint64_t Key)
+{
+	return(((Key >> 32) * BlockCount) >> 32);
+}
+
+void BloomFilterAdd(BLOOM_BLOCK* Blocks, uint64_t BlockCount, uint64_t Key)
+{
+	BLOOM_BLOCK* Block = &Blocks[BlockIndex(BlockCount, Key)];
+
+	uint32_t BitKey = (uint32_t)Key;
+
+	for (int Word = 0; Word < BLOOM_WORDS_PER_BLOCK; Word++)
+	{
+		Block->Words[Word] |= 1u << ((BitKey * gBloomSalts[Word]) >> 27);
+	}
+}
+
+bool BloomFilterMayContain(const BLOOM_BLOCK* Blocks, uint64_t BlockCount, uint64_t Key)
+{
+	const BLOOM_BLOCK* Block = &Blocks[BlockIndex(BlockCount, Key)];
+
+	uint32_t BitKey = (uint32_t)Key;
+
+	uint32_t Missing = 0;
+
+	// No early exit: the eight words are checked together, which the compiler can turn into a single vector compare.
+	for (int Word = 0; Word < BLOOM_WORDS_PER_BLOCK; Word++)
+	{
+		Missing |= ~Block->Words[Word] & (1u << ((BitKey * gBloomSalts[Word]) >> 27));
+	}
+
+	return(Missing == 0);
+}
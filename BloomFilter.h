@@ -0,0 +1,30 @@
+// Please read BloomFilter.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#define BLOOM_WORDS_PER_BLOCK 8
+
+// Eight 32-bit words, so a block never straddles a cache line as long as the filter itself is 32-byte aligned.
+typedef struct BLOOM_BLOCK
+{
+	uint32_t Words[BLOOM_WORDS_PER_BLOCK];
+
+} BLOOM_BLOCK;
+
+uint64_t BloomFilterBlockCount(uint64_t KeyCount, uint32_t BitsPerKey);
+
+void BloomFilterAdd(BLOOM_BLOCK* Blocks, uint64_t BlockCount, uint64_t Key);
+
+bool BloomFilterMayContain(const BLOOM_BLOCK* Blocks, uint64_t BlockCount, uint64_t Key);
@@ -0,0 +1,295 @@
+/*
+BreachIndex.c
+
+An exact-match index of breached passwords, by NT hash.
+
+The token blacklist asks "does this password contain something bad?", which is the right question for a few hundred thousand
+words and patterns but the wrong one for a breach corpus of hundreds of millions of real passwords. For those the question is
+simply "is this exact password on the list?", and the answer has to come back without holding the list in lsass's heap.
+
+The index file is a header, a fanout table, the hashes themselves (sorted, 16 bytes each, nothing in between) and optionally
+a Bloom filter:
+
+  - The fanout table has one entry per possible value of a hash's first two bytes, plus one. Entry N is the number of hashes
+    that start with a value below N. So the hashes that start with N are the ones from Fanout[N] up to Fanout[N + 1], and a
+    lookup goes straight to a bucket of a few thousand hashes even with half a billion in the file.
+
+  - MD4 output is uniformly distributed, so inside a bucket the value of a hash tells us roughly where it must be. A couple of
+    interpolation probes usually land right on it; if they don't, a binary search finishes the job.
+
+  - Nearly every password that is checked is NOT in the index, and each of those misses would still cost a fanout lookup and
+    a few probes, each a page of the mapped file that may well not be resident. The Bloom filter (see BloomFilter.c) answers
+    most of them from a single cache line: about 99% of absent hashes are turned away without touching the records at all.
+    A positive answer from the filter is only ever a maybe, and is always confirmed against the records.
+
+The file is mapped read-only, so it costs address space, not memory: the pages a lookup touches are paged in from the file
+cache and can be dropped again by the memory manager at any time.
+
+Opening an index checks the header and the fanout table, which is all that stands between a bad file and a read outside of
+the mapped view. The records are not checksummed on open, because that would mean reading gigabytes inside lsass every time
+the file changes; a damaged record can only turn into a wrong answer for one hash, never into a bad memory access.
+PassFiltExTool breach-verify does check the records.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "BreachIndex.h"
+
+typedef char BREACH_INDEX_HEADER_SIZE_CHECK[(sizeof(BREACH_INDEX_HEADER) == 80) ? 1 : -1];
+
+typedef char BLOOM_BLOCK_SIZE_CHECK[(sizeof(BLOOM_BLOCK) == 32) ? 1 : -1];
+
+// How many interpolation probes to try before falling back to a plain binary search.
+#define BREACH_INDEX_INTERPOLATION_PROBES 3
+
+// Fills in everything but the checksums and the measured false positive rate, which can only be known once the file is written.
+void BreachIndexInitializeHeader(BREACH_INDEX_HEADER* Header, uint64_t HashCount, uint64_t FilterBlockCount)
+{
+	memset(Header, 0, sizeof(BREACH_INDEX_HEADER));
+
+	Header->Magic = BREACH_INDEX_MAGIC;
+
+	Header->Version = BREACH_INDEX_VERSION;
+
+	Header->HeaderSize = sizeof(BREACH_INDEX_HEADER);
+
+	Header->HashSize = BREACH_INDEX_HASH_SIZE;
+
+	Header->FanoutBits = BREACH_INDEX_FANOUT_BITS;
+
+	Header->HashCount = HashCount;
+
+	Header->FanoutOffset = sizeof(BREACH_INDEX_HEADER);
+
+	Header->RecordsOffset = Header->FanoutOffset + ((uint64_t)BREACH_INDEX_BUCKET_COUNT + 1) * sizeof(uint64_t);
+
+	Header->FilterOffset = Header->RecordsOffset + (HashCount * BREACH_INDEX_HASH_SIZE);
+
+	if (FilterBlockCount > 0)
+	{
+		Header->FilterOffset = (Header->FilterOffset + (BREACH_INDEX_FILTER_ALIGNMENT - 1)) & ~(uint64_t)(BREACH_INDEX_FILTER_ALIGNMENT - 1);
+	}
+
+	Header->FilterBlockCount = FilterBlockCount;
+
+	Header->FileSize = Header->FilterOffset + (FilterBlockCount * sizeof(BLOOM_BLOCK));
+}
+
+uint32_t BreachIndexBucket(const uint8_t Hash[BREACH_INDEX_HASH_SIZE])
+{
+	return(((uint32_t)Hash[0] << 8) | Hash[1]);
+}
+
+// Bytes 4 to 11 of the hash. Not the first two, which only say which fanout bucket the hash is in.
+uint64_t BreachIndexFilterKey(const uint8_t Hash[BREACH_INDEX_HASH_SIZE])
+{
+	uint64_t Key = 0;
+
+	for (int Index = 4; Index < 12; Index++)
+	{
+		Key = (Key << 8) | Hash[Index];
+	}
+
+	return(Key);
+}
+
+// The eight bytes after the bucket prefix, as a number that sorts the same way the hashes do.
+static uint64_t HashKey(const uint8_t* Hash)
+{
+	uint64_t Key = 0;
+
+	for (int Index = 2; Index < 10; Index++)
+	{
+		Key = (Key << 8) | Hash[Index];
+	}
+
+	return(Key);
+}
+
+BREACH_INDEX_STATUS BreachIndexOpen(const void* Image, size_t ImageSize, BREACH_INDEX* Index)
+{
+	BREACH_INDEX_HEADER Header;
+
+	BREACH_INDEX_HEADER Expected;
+
+	const uint8_t* Bytes = Image;
+
+	memset(Index, 0, sizeof(BREACH_INDEX));
+
+	if (ImageSize < sizeof(BREACH_INDEX_HEADER))
+	{
+		return(BreachIndexTooSmall);
+	}
+
+	memcpy(&Header, Image, sizeof(Header));
+
+	if (Header.Magic != BREACH_INDEX_MAGIC)
+	{
+		return(BreachIndexBadMagic);
+	}
+
+	if (Header.Version != BREACH_INDEX_VERSION || Header.HeaderSize != sizeof(BREACH_INDEX_HEADER))
+	{
+		return(BreachIndexBadVersion);
+	}
+
+	// As with blacklist images, work out where everything has to be and insist that the file agrees.
+	if (Header.HashCount > ImageSize / BREACH_INDEX_HASH_SIZE || Header.FilterBlockCount > UINT32_MAX)
+	{
+		return(BreachIndexBadLayout);
+	}
+
+	BreachIndexInitializeHeader(&Expected, Header.HashCount, Header.FilterBlockCount);
+
+	Expected.RecordsChecksum = Header.RecordsChecksum;
+
+	Expected.FilterChecksum = Header.FilterChecksum;
+
+	Expected.FilterFalsePositivesPerMillion = Header.FilterFalsePositivesPerMillion;
+
+	if (memcmp(&Expected, &Header, sizeof(Header)) != 0 || Header.FileSize != ImageSize)
+	{
+		return(BreachIndexBadLayout);
+	}
+
+	const uint64_t* Fanout = (const uint64_t*)(const void*)(Bytes + Header.FanoutOffset);
+
+	if (Fanout[0] != 0 || Fanout[BREACH_INDEX_BUCKET_COUNT] != Header.HashCount)
+	{
+		return(BreachIndexBadFanout);
+	}
+
+	for (uint32_t Bucket = 0; Bucket < BREACH_INDEX_BUCKET_COUNT; Bucket++)
+	{
+		if (Fanout[Bucket + 1] < Fanout[Bucket])
+		{
+			return(BreachIndexBadFanout);
+		}
+	}
+
+	Index->HashCount = Header.HashCount;
+
+	Index->Fanout = Fanout;
+
+	Index->Records = Bytes + Header.RecordsOffset;
+
+	if (Header.FilterBlockCount > 0)
+	{
+		Index->Filter = (const BLOOM_BLOCK*)(const void*)(Bytes + Header.FilterOffset);
+
+		Index->FilterBlockCount = Header.FilterBlockCount;
+	}
+
+	return(BreachIndexOk);
+}
+
+// The filter first, then the records if the filter can't rule the hash out.
+bool BreachIndexContains(const BREACH_INDEX* Index, const uint8_t Hash[BREACH_INDEX_HASH_SIZE])
+{
+	if (Index->Filter != NULL && BloomFilterMayContain(Index->Filter, Index->FilterBlockCount, BreachIndexFilterKey(Hash)) == false)
+	{
+		return(false);
+	}
+
+	return(BreachIndexSearch(Index, Hash));
+}
+
+// The records alone. This is the authoritative answer.
+bool BreachIndexSearch(const BREACH_INDEX* Index, const uint8_t Hash[BREACH_INDEX_HASH_SIZE])
+{
+	uint32_t Bucket = BreachIndexBucket(Hash);
+
+	uint64_t Low = Index->Fanout[Bucket];
+
+	uint64_t High = Index->Fanout[Bucket + 1];
+
+	uint64_t Key = HashKey(Hash);
+
+	int Probes = 0;
+
+	while (Low < High)
+	{
+		uint64_t Probe = Low + ((High - Low) / 2);
+
+		if (Probes < BREACH_INDEX_INTERPOLATION_PROBES && High - Low > 2)
+		{
+			uint64_t LowKey = HashKey(Index->Records + (size_t)(Low * BREACH_INDEX_HASH_SIZE));
+
+			uint64_t HighKey = HashKey(Index->Records + (size_t)((High - 1) * BREACH_INDEX_HASH_SIZE));
+
+			if (Key < LowKey || Key > HighKey)
+			{
+				return(false);
+			}
+
+			if (HighKey > LowKey)
+			{
+				Probe = Low + (uint64_t)(((double)(Key - LowKey) / (double)(HighKey - LowKey)) * (double)(High - 1 - Low));
+
+				// Rounding can push the estimate just past the end of the range.
+				if (Probe >= High)
+				{
+					Probe = High - 1;
+				}
+			}
+
+			Probes++;
+		}
+
+		int Comparison = memcmp(Index->Records + (size_t)(Probe * BREACH_INDEX_HASH_SIZE), Hash, BREACH_INDEX_HASH_SIZE);
+
+		if (Comparison == 0)
+		{
+			return(true);
+		}
+
+		if (Comparison < 0)
+		{
+			Low = Probe + 1;
+		}
+		else
+		{
+			High = Probe;
+		}
+	}
+
+	return(false);
+}
+
+const char* BreachIndexStatusString(BREACH_INDEX_STATUS Status)
+{
+	switch (Status)
+	{
+		case BreachIndexOk:
+		{
+			return("OK");
+		}
+		case BreachIndexTooSmall:
+		{
+			return("file is too small to be a breach index");
+		}
+		case BreachIndexBadMagic:
+		{
+			return("not a breach index");
+		}
+		case BreachIndexBadVersion:
+		{
+			return("unsupported index version");
+		}
+		case BreachIndexBadLayout:
+		{
+			return("header does not match the file");
+		}
+		case BreachIndexBadFanout:
+		{
+			return("fanout table is inconsistent");
+		}
+		default:
+		{
+			return("unknown error");
+		}
+	}
+}
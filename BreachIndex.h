@@ -0,0 +1,119 @@
+// Please read BreachIndex.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "BloomFilter.h"
+
+#include "Md4.h"
+
+// "PFXH" in a little-endian file.
+#define BREACH_INDEX_MAGIC 0x48584650
+
+#define BREACH_INDEX_VERSION 2
+
+#define BREACH_INDEX_HASH_SIZE MD4_DIGEST_SIZE
+
+// Hashes are bucketed by their first two bytes.
+#define BREACH_INDEX_FANOUT_BITS 16
+
+#define BREACH_INDEX_BUCKET_COUNT (1 << BREACH_INDEX_FANOUT_BITS)
+
+// The Bloom filter starts on a cache line boundary, so that no block straddles two of them.
+#define BREACH_INDEX_FILTER_ALIGNMENT 64
+
+typedef struct BREACH_INDEX_HEADER
+{
+	uint32_t Magic;
+
+	uint16_t Version;
+
+	uint16_t HeaderSize;
+
+	uint16_t HashSize;
+
+	uint16_t FanoutBits;
+
+	uint32_t Flags;
+
+	uint64_t HashCount;
+
+	uint64_t FanoutOffset;
+
+	uint64_t RecordsOffset;
+
+	uint64_t FilterOffset;
+
+	// Zero if the index was built without a filter.
+	uint64_t FilterBlockCount;
+
+	uint64_t FileSize;
+
+	// CRC-32 of the hash records and of the filter. Checked by PassFiltExTool breach-verify, not by the DLL; see BreachIndex.c.
+	uint32_t RecordsChecksum;
+
+	uint32_t FilterChecksum;
+
+	// Measured by PassFiltExTool when the filter was built, with random hashes that are not in the index.
+	uint32_t FilterFalsePositivesPerMillion;
+
+	uint32_t Reserved;
+
+} BREACH_INDEX_HEADER;
+
+typedef struct BREACH_INDEX
+{
+	uint64_t HashCount;
+
+	// BREACH_INDEX_BUCKET_COUNT + 1 entries. Bucket N holds the hashes from Fanout[N] up to, but not including, Fanout[N + 1].
+	const uint64_t* Fanout;
+
+	const uint8_t* Records;
+
+	// NULL if there is no filter. Every hash in Records is in the filter, so a negative answer from it is final.
+	const BLOOM_BLOCK* Filter;
+
+	uint64_t FilterBlockCount;
+
+} BREACH_INDEX;
+
+typedef enum BREACH_INDEX_STATUS
+{
+	BreachIndexOk,
+
+	BreachIndexTooSmall,
+
+	BreachIndexBadMagic,
+
+	BreachIndexBadVersion,
+
+	BreachIndexBadLayout,
+
+	BreachIndexBadFanout
+
+} BREACH_INDEX_STATUS;
+
+void BreachIndexInitializeHeader(BREACH_INDEX_HEADER* Header, uint64_t HashCount, uint64_t FilterBlockCount);
+
+uint32_t BreachIndexBucket(const uint8_t Hash[BREACH_INDEX_HASH_SIZE]);
+
+BREACH_INDEX_STATUS BreachIndexOpen(const void* Image, size_t ImageSize, BREACH_INDEX* Index);
+
+uint64_t BreachIndexFilterKey(const uint8_t Hash[BREACH_INDEX_HASH_SIZE]);
+
+bool BreachIndexContains(const BREACH_INDEX* Index, const uint8_t Hash[BREACH_INDEX_HASH_SIZE]);
+
+bool BreachIndexSearch(const BREACH_INDEX* Index, const uint8_t Hash[BREACH_INDEX_HASH_SIZE]);
+
+const char* BreachIndexStatusString(BREACH_INDEX_STATUS Status);
@@ -0,0 +1,170 @@
+/*
+FileWatch.c
+
+Tells BlacklistThreadProc when one of the files it loads has changed and is ready to be read.
+
+The blacklist thread used to wake up every 60 seconds and open every file to compare its last write time, whether or not
+anything had changed, and an urgent change to the blacklist still took up to a minute to be noticed. Now the directory is
+watched instead (see PlatformWatchStart), and the thread only opens a file after being told that something happened to it.
+Nothing else in the directory costs more than a look at its name.
+
+A change is rarely one notification. A file being copied or saved in place is written to several times before it is
+complete, and reading it halfway through would load half a blacklist. So a file only becomes due once it has been quiet for
+DebounceMilliseconds: every notification for it starts the wait over. That doesn't depend on how the file is written, which
+is all that can be done on Windows, where there is no "closed after writing" notification. Renaming a finished file over the
+old one is still the better way to replace it, and is then picked up one quiet period after the rename.
+
+If the directory can't be watched, or the watch stops working, every file is due every PollMilliseconds instead, as it used
+to be. When notifications are lost because too many came at once, every file is due as well.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "FileWatch.h"
+
+static uint64_t ElapsedMilliseconds(uint64_t StartTimestamp, uint64_t EndTimestamp)
+{
+	return(PlatformElapsedMicroseconds(StartTimestamp, EndTimestamp) / 1000);
+}
+
+static uint32_t AllFiles(const FILE_WATCH* Watch)
+{
+	return((Watch->FileCount == 32) ? UINT32_MAX : (((uint32_t)1 << Watch->FileCount) - 1));
+}
+
+/*
+Watches FileNames in Directory. The names must stay put until FileWatchStop. Returns whether the directory is really being
+watched; if not, the files will be polled, so the FILE_WATCH can be used either way.
+
+*/
+bool FileWatchStart(FILE_WATCH* Watch, const char* Directory, const char* const* FileNames, uint32_t FileCount, uint32_t DebounceMilliseconds, uint32_t PollMilliseconds)
+{
+	memset(Watch, 0, sizeof(FILE_WATCH));
+
+	Watch->FileCount = (FileCount < FILE_WATCH_MAX_FILES) ? FileCount : FILE_WATCH_MAX_FILES;
+
+	Watch->DebounceMilliseconds = DebounceMilliseconds;
+
+	Watch->PollMilliseconds = PollMilliseconds;
+
+	Watch->LastPoll = PlatformTimestamp();
+
+	Watch->Watch = PlatformWatchStart(Directory, FileNames, Watch->FileCount);
+
+	return(Watch->Watch != NULL);
+}
+
+/*
+Waits up to Milliseconds for files to become due. Returns a bit for each one that is, in the order they were given to
+FileWatchStart, or 0 if none did in time.
+
+*/
+uint32_t FileWatchWait(FILE_WATCH* Watch, uint32_t Milliseconds)
+{
+	const uint64_t Start = PlatformTimestamp();
+
+	while (true)
+	{
+		const uint64_t Now = PlatformTimestamp();
+
+		const uint64_t Waited = ElapsedMilliseconds(Start, Now);
+
+		uint64_t Wait = (Waited < Milliseconds) ? Milliseconds - Waited : 0;
+
+		uint32_t Due = 0;
+
+		if (Watch->Watch == NULL)
+		{
+			uint64_t SincePoll = ElapsedMilliseconds(Watch->LastPoll, Now);
+
+			if (SincePoll >= Watch->PollMilliseconds)
+			{
+				Watch->LastPoll = Now;
+
+				return(AllFiles(Watch));
+			}
+
+			if (Wait == 0)
+			{
+				return(0);
+			}
+
+			PlatformSleep((uint32_t)((Wait < Watch->PollMilliseconds - SincePoll) ? Wait : Watch->PollMilliseconds - SincePoll));
+
+			continue;
+		}
+
+		for (uint32_t File = 0; File < Watch->FileCount; File++)
+		{
+			if ((Watch->Pending & ((uint32_t)1 << File)) == 0)
+			{
+				continue;
+			}
+
+			uint64_t Quiet = ElapsedMilliseconds(Watch->LastChange[File], Now);
+
+			if (Quiet >= Watch->DebounceMilliseconds)
+			{
+				Due |= (uint32_t)1 << File;
+			}
+			else if (Watch->DebounceMilliseconds - Quiet < Wait)
+			{
+				Wait = Watch->DebounceMilliseconds - Quiet;
+			}
+		}
+
+		if (Due != 0)
+		{
+			Watch->Pending &= ~Due;
+
+			return(Due);
+		}
+
+		if (Wait == 0)
+		{
+			return(0);
+		}
+
+		uint32_t Changed = 0;
+
+		if (PlatformWatchWait(Watch->Watch, (uint32_t)Wait, &Changed) == false)
+		{
+			PlatformWatchStop(Watch->Watch);
+
+			Watch->Watch = NULL;
+
+			Watch->WatchFailed = true;
+
+			Watch->Pending = 0;
+
+			// Anything could have happened since the watch last worked.
+			Watch->LastPoll = Now;
+
+			return(AllFiles(Watch));
+		}
+
+		const uint64_t ChangedAt = PlatformTimestamp();
+
+		for (uint32_t File = 0; File < Watch->FileCount; File++)
+		{
+			if ((Changed & ((uint32_t)1 << File)) != 0)
+			{
+				Watch->Pending |= (uint32_t)1 << File;
+
+				Watch->LastChange[File] = ChangedAt;
+
+				Watch->Notifications++;
+			}
+		}
+	}
+}
+
+void FileWatchStop(FILE_WATCH* Watch)
+{
+	PlatformWatchStop(Watch->Watch);
+
+	Watch->Watch = NULL;
+}
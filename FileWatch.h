@@ -0,0 +1,50 @@
+// Please read FileWatch.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stdint.h>
+
+#include "Platform.h"
+
+// Up to one per bit of what FileWatchWait returns.
+#define FILE_WATCH_MAX_FILES 32
+
+typedef struct FILE_WATCH
+{
+	// NULL while the files are polled instead.
+	PLATFORM_WATCH* Watch;
+
+	uint32_t FileCount;
+
+	uint32_t DebounceMilliseconds;
+
+	uint32_t PollMilliseconds;
+
+	// Files that have changed, but not long enough ago to be read yet.
+	uint32_t Pending;
+
+	uint64_t LastChange[FILE_WATCH_MAX_FILES];
+
+	uint64_t LastPoll;
+
+	// Set once the watch stops working and the files are polled from then on.
+	bool WatchFailed;
+
+	// Notifications seen for the watched files, for the trace. Several of them usually make one change.
+	uint64_t Notifications;
+
+} FILE_WATCH;
+
+bool FileWatchStart(FILE_WATCH* Watch, const char* Directory, const char* const* FileNames, uint32_t FileCount, uint32_t DebounceMilliseconds, uint32_t PollMilliseconds);
+
+uint32_t FileWatchWait(FILE_WATCH* Watch, uint32_t Milliseconds);
+
+void FileWatchStop(FILE_WATCH* Watch);
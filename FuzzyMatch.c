@@ -0,0 +1,210 @@
+/*
+FuzzyMatch.c
+
+Catches blacklist tokens that turn up in a password with a typo or two, such as "passwprd" or "pasword", without listing the
+variants.
+
+A blacklist asks for this with a !distance line (see Blacklist.c). A token then counts as found if some stretch of the
+password is within that many edits of it, an edit being one character changed, added or left out, and the token still makes
+up as much of the password as its coverage asks for (half, unless the blacklist says otherwise), as with an exact match. Short tokens get fewer edits than long ones, one for every
+FUZZY_CHARACTERS_PER_EDIT characters, since "abc" is within one edit of half of all three-letter strings.
+
+Going through the tokens one by one would make every password change cost as much as the whole list again. Instead, the search
+walks the trie that the Aho-Corasick automaton is built on (every state and its edges, ignoring the failure links), so tokens
+that start alike are only looked at once, and whole branches are dropped as soon as nothing in them can come close enough.
+Below the first few characters, that is every branch but the ones that go on with a character of the password.
+
+For each trie state on the way down, the search keeps one 64-bit row per number of edits d, from 0 up to the distance, with the
+bit for password position j set when the token prefix spelled by the state is within d edits of some stretch of the password
+that ends at j. This is the bit-parallel matcher of Wu and Manber with the password as the pattern, so each step down the trie
+is a handful of shifts and ORs for all positions of the password at once, and the step for a character only needs the mask of
+where that character is in the password. Once the row for the full distance is empty, no longer token can come back within
+reach, and the branch is dropped. That keeps the search near the top of the trie and to the few paths that look like pieces of
+the password.
+
+The work still grows with the distance and with how many tokens share their first few characters, so each search stops after
+FUZZY_STATE_BUDGET trie states, and the password is then judged on the exact match alone. PassFiltExTool fuzzy-bench shows
+how far from the budget real-sized lists are.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "FuzzyMatch.h"
+
+#include "Md4.h"
+
+// No state the search keeps is deeper than the password plus the distance; beyond that, every row is empty.
+#define FUZZY_FRAME_COUNT (FUZZY_MAX_PASSWORD_LENGTH + FUZZY_MAX_DISTANCE + 1)
+
+typedef struct FUZZY_FRAME
+{
+	uint32_t NextEdge;
+
+	uint32_t EndEdge;
+
+	// Set when no child whose character isn't in the password can come within the distance, so those are skipped unseen.
+	bool SkipOthers;
+
+	uint64_t Rows[FUZZY_MAX_DISTANCE + 1];
+
+} FUZZY_FRAME;
+
+// How many edits a token of TokenLength characters may be away from the password, when the blacklist allows Distance.
+uint32_t FuzzyAllowedEdits(uint32_t Distance, uint32_t TokenLength)
+{
+	uint32_t Edits = TokenLength / FUZZY_CHARACTERS_PER_EDIT;
+
+	return((Edits < Distance) ? Edits : Distance);
+}
+
+/*
+Returns the pattern ID of a token that is within its allowed edits of part of the password and makes up at least half of it,
+or AC_NO_PATTERN. The password must already be folded and canonicalized. *Status says why nothing was found, if nothing was.
+StatesVisited may be NULL; PassFiltExTool uses it to see how close searches come to StateBudget.
+
+*/
+uint32_t FuzzyFindToken(const AC_AUTOMATON* Automaton, const uint16_t* Password, size_t PasswordLength, uint32_t Distance, uint64_t StateBudget, FUZZY_STATUS* Status, uint64_t* StatesVisited)
+{
+	uint64_t Masks[AC_ALPHABET_SIZE] = { 0 };
+
+	FUZZY_FRAME Frames[FUZZY_FRAME_COUNT];
+
+	uint32_t Match = AC_NO_PATTERN;
+
+	uint32_t Depth = 0;
+
+	uint64_t Visited = 0;
+
+	*Status = FuzzyNotFound;
+
+	if (Distance > FUZZY_MAX_DISTANCE)
+	{
+		Distance = FUZZY_MAX_DISTANCE;
+	}
+
+	if (PasswordLength > FUZZY_MAX_PASSWORD_LENGTH)
+	{
+		*Status = FuzzyTooLong;
+
+		goto End;
+	}
+
+	// Bit 0 is the start of the password, and bit j the end of its jth character.
+	const uint64_t Positions = UINT64_MAX >> (FUZZY_MAX_PASSWORD_LENGTH - PasswordLength);
+
+	for (size_t Index = 0; Index < PasswordLength; Index++)
+	{
+		if (Password[Index] < AC_ALPHABET_SIZE)
+		{
+			Masks[Password[Index]] |= (uint64_t)1 << (Index + 1);
+		}
+	}
+
+	// The empty prefix at the root is within no edits of the empty stretch at every position.
+	Frames[0].NextEdge = Automaton->States[AC_ROOT_STATE].FirstEdge;
+
+	Frames[0].EndEdge = Frames[0].NextEdge + Automaton->States[AC_ROOT_STATE].EdgeCount;
+
+	for (uint32_t Edits = 0; Edits <= Distance; Edits++)
+	{
+		Frames[0].Rows[Edits] = Positions;
+	}
+
+	Frames[0].SkipOthers = false;
+
+	while (true)
+	{
+		FUZZY_FRAME* Parent = &Frames[Depth];
+
+		if (Parent->NextEdge == Parent->EndEdge)
+		{
+			if (Depth == 0)
+			{
+				break;
+			}
+
+			Depth--;
+
+			continue;
+		}
+
+		uint32_t Edge = Parent->NextEdge++;
+
+		const uint64_t Equal = Masks[Automaton->EdgeLabels[Edge]];
+
+		if (Equal == 0 && Parent->SkipOthers)
+		{
+			continue;
+		}
+
+		if (++Visited > StateBudget)
+		{
+			*Status = FuzzyOverBudget;
+
+			goto End;
+		}
+
+		FUZZY_FRAME* Child = &Frames[Depth + 1];
+
+		// A match of the new character, or, with one more edit: a different character, the character left out of the password,
+		// or an extra password character in front of it.
+		Child->Rows[0] = (Parent->Rows[0] << 1) & Equal;
+
+		for (uint32_t Edits = 1; Edits <= Distance; Edits++)
+		{
+			Child->Rows[Edits] = (((Parent->Rows[Edits] << 1) & Equal) | (Parent->Rows[Edits - 1] << 1) | Parent->Rows[Edits - 1] | (Child->Rows[Edits - 1] << 1)) & Positions;
+		}
+
+		if (Child->Rows[Distance] == 0)
+		{
+			continue;
+		}
+
+		const AC_STATE* State = &Automaton->States[Automaton->EdgeTargets[Edge]];
+
+		if (State->PatternId != AC_NO_PATTERN && (uint64_t)State->Depth * 100 >= (uint64_t)AcPatternCoverage(Automaton, State->PatternId) * PasswordLength && Child->Rows[FuzzyAllowedEdits(Distance, State->Depth)] != 0)
+		{
+			Match = State->PatternId;
+
+			*Status = FuzzyFound;
+
+			goto End;
+		}
+
+		if (State->EdgeCount == 0 || Depth + 2 >= FUZZY_FRAME_COUNT)
+		{
+			continue;
+		}
+
+		Child->NextEdge = State->FirstEdge;
+
+		Child->EndEdge = State->FirstEdge + State->EdgeCount;
+
+		// A character that is nowhere in the password can only be paid for with an edit, which is the same for all of them.
+		uint64_t Others = 0;
+
+		for (uint32_t Edits = 1; Edits <= Distance; Edits++)
+		{
+			Others = ((Child->Rows[Edits - 1] << 1) | Child->Rows[Edits - 1] | (Others << 1)) & Positions;
+		}
+
+		Child->SkipOthers = (Others == 0);
+
+		Depth++;
+	}
+
+End:
+
+	// The masks say where each character of the password is.
+	SecureWipe(Masks, sizeof(Masks));
+
+	if (StatesVisited != NULL)
+	{
+		*StatesVisited = Visited;
+	}
+
+	return(Match);
+}
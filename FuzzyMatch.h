@@ -0,0 +1,46 @@
+// Please read FuzzyMatch.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+// The largest edit distance a blacklist can ask for with a !distance line.
+#define FUZZY_MAX_DISTANCE 3
+
+// A token is allowed one edit for every this many characters, up to the blacklist's distance. Shorter tokens must match exactly.
+#define FUZZY_CHARACTERS_PER_EDIT 4
+
+// Longer passwords are only checked for exact matches. A row of the search has to fit into 64 bits, one for each position and
+// one for the start.
+#define FUZZY_MAX_PASSWORD_LENGTH 63
+
+// Trie states one search may visit before it gives up. Each one can be a cache miss, so this is up to about 10 milliseconds.
+#define FUZZY_STATE_BUDGET 100000
+
+typedef enum FUZZY_STATUS
+{
+	FuzzyNotFound,
+
+	FuzzyFound,
+
+	// The search went through FUZZY_STATE_BUDGET states without an answer.
+	FuzzyOverBudget,
+
+	// The password is longer than FUZZY_MAX_PASSWORD_LENGTH.
+	FuzzyTooLong
+
+} FUZZY_STATUS;
+
+uint32_t FuzzyAllowedEdits(uint32_t Distance, uint32_t TokenLength);
+
+uint32_t FuzzyFindToken(const AC_AUTOMATON* Automaton, const uint16_t* Password, size_t PasswordLength, uint32_t Distance, uint64_t StateBudget, FUZZY_STATUS* Status, uint64_t* StatesVisited);
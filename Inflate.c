@@ -0,0 +1,752 @@
+/*
+Inflate.c
+
+Decompresses a gzip file (RFC 1952), a buffer at a time, so that a compressed blacklist can be loaded without ever being
+written out or held in memory uncompressed. See BlacklistStream.c.
+
+Breach lists run to gigabytes of text, and gzip gets them down to a fraction of that, so that is what gets copied to every DC.
+There's no zlib to link against inside lsass (and no wish to ship one), so this is a DEFLATE decoder of our own (RFC 1951).
+It only ever decompresses, which is the simple half:
+
+  - The whole compressed file is in memory, or mapped, to begin with, so input never runs out halfway through a code. Only
+    the output is taken a buffer at a time: InflateRead stops when the caller's buffer is full, in the middle of a stored
+    block or a match if need be, and carries on from there next time.
+
+  - Huffman codes of up to INFLATE_FAST_BITS bits, which are nearly all of them, are decoded with one table lookup. Longer
+    ones are decoded a bit at a time from the code counts, the way RFC 1951 describes them.
+
+  - The last INFLATE_WINDOW_SIZE bytes of output are kept in a ring, for matches to copy from. That and the tables are all
+    the memory a stream needs, however big the file.
+
+  - A file can have any number of gzip members one after the other, as concatenating .gz files makes, and each member's CRC-32
+    and size are checked against its trailer. A damaged file is rejected, never half loaded.
+
+zstd compresses better and faster, but a zstd decoder is several times the size of this one, so zstd files are recognized
+(see BlacklistStream.c) and turned away rather than decoded. Recompress them with gzip.
+
+PassFiltExTool stream-bench checks this against the plain text and times it.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "Inflate.h"
+
+typedef enum INFLATE_STATE
+{
+	InflateStateMemberHeader,
+
+	InflateStateBlockHeader,
+
+	InflateStateStored,
+
+	InflateStateHuffman,
+
+	InflateStateTrailer,
+
+	InflateStateDone,
+
+	InflateStateCorrupt
+
+} INFLATE_STATE;
+
+#define GZIP_FLAG_TEXT 0x01
+
+#define GZIP_FLAG_HEADER_CRC 0x02
+
+#define GZIP_FLAG_EXTRA 0x04
+
+#define GZIP_FLAG_NAME 0x08
+
+#define GZIP_FLAG_COMMENT 0x10
+
+#define GZIP_FLAG_RESERVED 0xE0
+
+static const uint16_t gLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+static const uint8_t gLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+static const uint16_t gDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+static const uint8_t gDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// The order the lengths of the code length code come in.
+static const uint8_t gCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static void Refill(INFLATE_STREAM* Stream)
+{
+	while (Stream->BitCount <= 56 && Stream->InputPosition < Stream->InputSize)
+	{
+		Stream->BitBuffer |= (uint64_t)Stream->Input[Stream->InputPosition++] << Stream->BitCount;
+
+		Stream->BitCount += 8;
+	}
+}
+
+// Count is at most 16. Marks the stream corrupt, and returns 0, if the input has run out.
+static uint32_t GetBits(INFLATE_STREAM* Stream, uint32_t Count)
+{
+	if (Stream->BitCount < Count)
+	{
+		Refill(Stream);
+
+		if (Stream->BitCount < Count)
+		{
+			Stream->State = InflateStateCorrupt;
+
+			return(0);
+		}
+	}
+
+	uint32_t Value = (uint32_t)(Stream->BitBuffer & ((1u << Count) - 1));
+
+	Stream->BitBuffer >>= Count;
+
+	Stream->BitCount -= Count;
+
+	return(Value);
+}
+
+// Drops what is left of the current byte, and hands back the whole bytes already in the bit buffer, so that the input can be
+// read a byte at a time again.
+static void AlignToByte(INFLATE_STREAM* Stream)
+{
+	Stream->InputPosition -= Stream->BitCount / 8;
+
+	Stream->BitBuffer = 0;
+
+	Stream->BitCount = 0;
+}
+
+static uint32_t ReverseBits(uint32_t Code, uint32_t Length)
+{
+	uint32_t Reversed = 0;
+
+	for (uint32_t Bit = 0; Bit < Length; Bit++)
+	{
+		Reversed = (Reversed << 1) | ((Code >> Bit) & 1);
+	}
+
+	return(Reversed);
+}
+
+// Builds the decoding tables for a code from the length of each symbol's code. Returns false if the lengths over-subscribe
+// the code, which no encoder would produce. A code with too few lengths is allowed; using one of its missing codes isn't.
+static bool BuildHuffman(INFLATE_HUFFMAN* Huffman, const uint8_t* Lengths, uint32_t SymbolCount)
+{
+	uint16_t Offsets[INFLATE_MAX_BITS + 2] = { 0 };
+
+	uint32_t NextCode[INFLATE_MAX_BITS + 1] = { 0 };
+
+	memset(Huffman, 0, sizeof(INFLATE_HUFFMAN));
+
+	for (uint32_t Symbol = 0; Symbol < SymbolCount; Symbol++)
+	{
+		Huffman->Counts[Lengths[Symbol]]++;
+	}
+
+	Huffman->Counts[0] = 0;
+
+	int32_t Left = 1;
+
+	for (uint32_t Length = 1; Length <= INFLATE_MAX_BITS; Length++)
+	{
+		Left = (Left << 1) - Huffman->Counts[Length];
+
+		if (Left < 0)
+		{
+			return(false);
+		}
+	}
+
+	for (uint32_t Length = 1; Length <= INFLATE_MAX_BITS; Length++)
+	{
+		Offsets[Length + 1] = (uint16_t)(Offsets[Length] + Huffman->Counts[Length]);
+
+		NextCode[Length] = (Length > 1) ? (NextCode[Length - 1] + Huffman->Counts[Length - 1]) << 1 : 0;
+	}
+
+	for (uint32_t Symbol = 0; Symbol < SymbolCount; Symbol++)
+	{
+		uint32_t Length = Lengths[Symbol];
+
+		if (Length == 0)
+		{
+			continue;
+		}
+
+		Huffman->Symbols[Offsets[Length]++] = (uint16_t)Symbol;
+
+		uint32_t Code = NextCode[Length]++;
+
+		if (Length <= INFLATE_FAST_BITS)
+		{
+			// Codes go into the stream from their top bit down, and bits come out of the buffer from the bottom up.
+			for (uint32_t Index = ReverseBits(Code, Length); Index < (1u << INFLATE_FAST_BITS); Index += (1u << Length))
+			{
+				Huffman->Fast[Index] = (uint16_t)(Symbol | (Length << 9));
+			}
+		}
+	}
+
+	return(true);
+}
+
+// Returns the next symbol, or -1 and marks the stream corrupt if the bits aren't a code.
+static int32_t DecodeSymbol(INFLATE_STREAM* Stream, const INFLATE_HUFFMAN* Huffman)
+{
+	if (Stream->BitCount < INFLATE_MAX_BITS)
+	{
+		Refill(Stream);
+	}
+
+	uint32_t Entry = Huffman->Fast[Stream->BitBuffer & ((1u << INFLATE_FAST_BITS) - 1)];
+
+	uint32_t Length = Entry >> 9;
+
+	if (Entry != 0 && Length <= Stream->BitCount)
+	{
+		Stream->BitBuffer >>= Length;
+
+		Stream->BitCount -= Length;
+
+		return((int32_t)(Entry & 0x1FF));
+	}
+
+	// Longer than the fast table, or past the end of the input: a bit at a time.
+	int32_t Code = 0;
+
+	int32_t First = 0;
+
+	int32_t Index = 0;
+
+	for (Length = 1; Length <= INFLATE_MAX_BITS && Length <= Stream->BitCount; Length++)
+	{
+		Code |= (int32_t)((Stream->BitBuffer >> (Length - 1)) & 1);
+
+		int32_t Count = Huffman->Counts[Length];
+
+		if (Code - Count < First)
+		{
+			Stream->BitBuffer >>= Length;
+
+			Stream->BitCount -= Length;
+
+			return(Huffman->Symbols[Index + (Code - First)]);
+		}
+
+		Index += Count;
+
+		First = (First + Count) << 1;
+
+		Code <<= 1;
+	}
+
+	Stream->State = InflateStateCorrupt;
+
+	return(-1);
+}
+
+static bool ReadDynamicTables(INFLATE_STREAM* Stream)
+{
+	uint8_t Lengths[INFLATE_MAX_SYMBOLS + 32] = { 0 };
+
+	uint8_t CodeLengths[19] = { 0 };
+
+	INFLATE_HUFFMAN* CodeLengthCode = &Stream->DynamicDistances;
+
+	uint32_t LiteralCount = GetBits(Stream, 5) + 257;
+
+	uint32_t DistanceCount = GetBits(Stream, 5) + 1;
+
+	uint32_t CodeLengthCount = GetBits(Stream, 4) + 4;
+
+	if (LiteralCount > 286 || DistanceCount > 30)
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < CodeLengthCount; Index++)
+	{
+		CodeLengths[gCodeLengthOrder[Index]] = (uint8_t)GetBits(Stream, 3);
+	}
+
+	// The distance code's table is free until the end of this, so the code length code borrows it.
+	if (Stream->State == InflateStateCorrupt || BuildHuffman(CodeLengthCode, CodeLengths, 19) == false)
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < LiteralCount + DistanceCount; )
+	{
+		int32_t Symbol = DecodeSymbol(Stream, CodeLengthCode);
+
+		uint32_t Repeat = 1;
+
+		uint8_t Length = 0;
+
+		if (Symbol < 0)
+		{
+			return(false);
+		}
+
+		if (Symbol < 16)
+		{
+			Length = (uint8_t)Symbol;
+		}
+		else if (Symbol == 16)
+		{
+			if (Index == 0)
+			{
+				return(false);
+			}
+
+			Length = Lengths[Index - 1];
+
+			Repeat = 3 + GetBits(Stream, 2);
+		}
+		else
+		{
+			Repeat = (Symbol == 17) ? 3 + GetBits(Stream, 3) : 11 + GetBits(Stream, 7);
+		}
+
+		if (Stream->State == InflateStateCorrupt || Index + Repeat > LiteralCount + DistanceCount)
+		{
+			return(false);
+		}
+
+		while (Repeat-- > 0)
+		{
+			Lengths[Index++] = Length;
+		}
+	}
+
+	// A block without an end-of-block code could never end.
+	if (Lengths[256] == 0)
+	{
+		return(false);
+	}
+
+	if (BuildHuffman(&Stream->DynamicLiterals, Lengths, LiteralCount) == false || BuildHuffman(&Stream->DynamicDistances, Lengths + LiteralCount, DistanceCount) == false)
+	{
+		return(false);
+	}
+
+	Stream->Literals = &Stream->DynamicLiterals;
+
+	Stream->Distances = &Stream->DynamicDistances;
+
+	return(true);
+}
+
+static bool ReadMemberHeader(INFLATE_STREAM* Stream)
+{
+	const uint8_t* Header = Stream->Input + Stream->InputPosition;
+
+	size_t Left = Stream->InputSize - Stream->InputPosition;
+
+	size_t Position = 10;
+
+	if (InflateIsGzip(Header, Left) == false || Left < 10 || (Header[3] & GZIP_FLAG_RESERVED) != 0)
+	{
+		return(false);
+	}
+
+	uint8_t Flags = Header[3];
+
+	if ((Flags & GZIP_FLAG_EXTRA) != 0)
+	{
+		if (Left < Position + 2)
+		{
+			return(false);
+		}
+
+		Position += 2 + (size_t)(Header[Position] | (Header[Position + 1] << 8));
+	}
+
+	// The original file name and a comment, both null-terminated.
+	for (uint32_t Flag = GZIP_FLAG_NAME; Flag <= GZIP_FLAG_COMMENT; Flag <<= 1)
+	{
+		if ((Flags & Flag) == 0)
+		{
+			continue;
+		}
+
+		const uint8_t* Terminator = (Position < Left) ? memchr(Header + Position, 0, Left - Position) : NULL;
+
+		if (Terminator == NULL)
+		{
+			return(false);
+		}
+
+		Position = (size_t)(Terminator - Header) + 1;
+	}
+
+	if ((Flags & GZIP_FLAG_HEADER_CRC) != 0)
+	{
+		Position += 2;
+	}
+
+	if (Position > Left)
+	{
+		return(false);
+	}
+
+	Stream->InputPosition += Position;
+
+	Stream->Crc = 0;
+
+	Stream->MemberSize = 0;
+
+	Stream->Members++;
+
+	return(true);
+}
+
+static bool ReadMemberTrailer(INFLATE_STREAM* Stream)
+{
+	AlignToByte(Stream);
+
+	if (Stream->InputSize - Stream->InputPosition < 8)
+	{
+		return(false);
+	}
+
+	const uint8_t* Trailer = Stream->Input + Stream->InputPosition;
+
+	uint32_t Crc = (uint32_t)Trailer[0] | ((uint32_t)Trailer[1] << 8) | ((uint32_t)Trailer[2] << 16) | ((uint32_t)Trailer[3] << 24);
+
+	uint32_t Size = (uint32_t)Trailer[4] | ((uint32_t)Trailer[5] << 8) | ((uint32_t)Trailer[6] << 16) | ((uint32_t)Trailer[7] << 24);
+
+	Stream->InputPosition += 8;
+
+	return(Crc == Stream->Crc && Size == (uint32_t)Stream->MemberSize);
+}
+
+/*
+Decodes a Huffman block into Output from Produced on, until Output is full, the block ends or the input turns out to be
+damaged, and returns where it got to in Output. Loops here rather than going round the state machine for every symbol, since
+this is where nearly all of the time goes.
+
+*/
+static size_t InflateHuffmanBlock(INFLATE_STREAM* Stream, uint8_t* Output, size_t OutputSize, size_t Produced)
+{
+	uint8_t* Window = Stream->Window;
+
+	uint32_t WindowPosition = Stream->WindowPosition;
+
+	size_t Started = Produced;
+
+	while (Produced < OutputSize)
+	{
+		// The match the last buffer filled up in the middle of, or the one just decoded.
+		if (Stream->CopyLength > 0)
+		{
+			size_t Count = OutputSize - Produced;
+
+			Count = (Count > Stream->CopyLength) ? Stream->CopyLength : Count;
+
+			for (size_t Index = 0; Index < Count; Index++)
+			{
+				uint8_t Byte = Window[(WindowPosition - Stream->CopyDistance) & (INFLATE_WINDOW_SIZE - 1)];
+
+				Window[WindowPosition++ & (INFLATE_WINDOW_SIZE - 1)] = Byte;
+
+				Output[Produced++] = Byte;
+			}
+
+			Stream->CopyLength -= (uint32_t)Count;
+
+			continue;
+		}
+
+		int32_t Symbol = DecodeSymbol(Stream, Stream->Literals);
+
+		if (Symbol < 256)
+		{
+			if (Symbol < 0)
+			{
+				break;
+			}
+
+			Window[WindowPosition++ & (INFLATE_WINDOW_SIZE - 1)] = (uint8_t)Symbol;
+
+			Output[Produced++] = (uint8_t)Symbol;
+
+			continue;
+		}
+
+		if (Symbol == 256)
+		{
+			Stream->State = Stream->LastBlock ? InflateStateTrailer : InflateStateBlockHeader;
+
+			break;
+		}
+
+		if (Symbol > 285)
+		{
+			Stream->State = InflateStateCorrupt;
+
+			break;
+		}
+
+		uint32_t Length = gLengthBase[Symbol - 257] + GetBits(Stream, gLengthExtra[Symbol - 257]);
+
+		int32_t DistanceSymbol = DecodeSymbol(Stream, Stream->Distances);
+
+		if (DistanceSymbol < 0 || DistanceSymbol > 29)
+		{
+			Stream->State = InflateStateCorrupt;
+
+			break;
+		}
+
+		uint32_t Distance = gDistanceBase[DistanceSymbol] + GetBits(Stream, gDistanceExtra[DistanceSymbol]);
+
+		// Members start afresh, so a match can't reach back into the one before.
+		if (Stream->State == InflateStateCorrupt || Distance > Stream->MemberSize + (Produced - Started))
+		{
+			Stream->State = InflateStateCorrupt;
+
+			break;
+		}
+
+		Stream->CopyLength = Length;
+
+		Stream->CopyDistance = Distance;
+	}
+
+	Stream->WindowPosition = WindowPosition;
+
+	Stream->MemberSize += Produced - Started;
+
+	return(Produced);
+}
+
+bool InflateIsGzip(const uint8_t* Data, size_t Size)
+{
+	// The magic number, and deflate, the only compression method gzip has ever had.
+	return(Size >= 3 && Data[0] == 0x1F && Data[1] == 0x8B && Data[2] == 8);
+}
+
+void InflateInitialize(INFLATE_STREAM* Stream, const uint8_t* Data, size_t Size)
+{
+	uint8_t Lengths[INFLATE_MAX_SYMBOLS];
+
+	memset(Stream, 0, offsetof(INFLATE_STREAM, Window));
+
+	Stream->Input = Data;
+
+	Stream->InputSize = Size;
+
+	Stream->State = InflateStateMemberHeader;
+
+	for (uint32_t Index = 0; Index < 256; Index++)
+	{
+		uint32_t Crc = Index;
+
+		for (uint32_t Bit = 0; Bit < 8; Bit++)
+		{
+			Crc = (Crc >> 1) ^ ((Crc & 1) ? 0xEDB88320 : 0);
+		}
+
+		Stream->CrcTable[Index] = Crc;
+	}
+
+	// The fixed codes of RFC 1951, section 3.2.6.
+	memset(Lengths, 8, 144);
+
+	memset(Lengths + 144, 9, 112);
+
+	memset(Lengths + 256, 7, 24);
+
+	memset(Lengths + 280, 8, 8);
+
+	BuildHuffman(&Stream->FixedLiterals, Lengths, INFLATE_MAX_SYMBOLS);
+
+	memset(Lengths, 5, 30);
+
+	BuildHuffman(&Stream->FixedDistances, Lengths, 30);
+}
+
+uint32_t InflateCrc32(const INFLATE_STREAM* Stream, uint32_t Crc, const uint8_t* Data, size_t Size)
+{
+	Crc = ~Crc;
+
+	for (size_t Index = 0; Index < Size; Index++)
+	{
+		Crc = Stream->CrcTable[(Crc ^ Data[Index]) & 0xFF] ^ (Crc >> 8);
+	}
+
+	return(~Crc);
+}
+
+/*
+Decompresses up to OutputSize bytes into Output, and sets *Written to how many. Returns InflateOk if there may be more to come,
+InflateEnd once the last member has been decompressed and checked, and InflateCorrupt if the file is damaged, after which
+nothing more can be read from it. Output written by a call that finds the file damaged has not been checked, and shouldn't be
+used.
+
+*/
+INFLATE_STATUS InflateRead(INFLATE_STREAM* Stream, uint8_t* Output, size_t OutputSize, size_t* Written)
+{
+	size_t Produced = 0;
+
+	// Where in Output the current member's CRC is to be carried on from.
+	size_t CrcFrom = 0;
+
+	while (Produced < OutputSize && Stream->State != InflateStateDone && Stream->State != InflateStateCorrupt)
+	{
+		switch (Stream->State)
+		{
+			case InflateStateMemberHeader:
+			{
+				Stream->State = ReadMemberHeader(Stream) ? InflateStateBlockHeader : InflateStateCorrupt;
+
+				break;
+			}
+			case InflateStateBlockHeader:
+			{
+				Stream->LastBlock = (GetBits(Stream, 1) != 0);
+
+				uint32_t Type = GetBits(Stream, 2);
+
+				if (Stream->State == InflateStateCorrupt)
+				{
+					break;
+				}
+
+				if (Type == 0)
+				{
+					AlignToByte(Stream);
+
+					const uint8_t* Header = Stream->Input + Stream->InputPosition;
+
+					if (Stream->InputSize - Stream->InputPosition < 4 || (Header[0] ^ Header[2]) != 0xFF || (Header[1] ^ Header[3]) != 0xFF)
+					{
+						Stream->State = InflateStateCorrupt;
+
+						break;
+					}
+
+					Stream->StoredRemaining = (uint32_t)Header[0] | ((uint32_t)Header[1] << 8);
+
+					Stream->InputPosition += 4;
+
+					Stream->State = InflateStateStored;
+				}
+				else if (Type == 1)
+				{
+					Stream->Literals = &Stream->FixedLiterals;
+
+					Stream->Distances = &Stream->FixedDistances;
+
+					Stream->State = InflateStateHuffman;
+				}
+				else if (Type == 2 && ReadDynamicTables(Stream))
+				{
+					Stream->State = InflateStateHuffman;
+				}
+				else
+				{
+					Stream->State = InflateStateCorrupt;
+				}
+
+				break;
+			}
+			case InflateStateStored:
+			{
+				size_t Count = OutputSize - Produced;
+
+				if (Count > Stream->StoredRemaining)
+				{
+					Count = Stream->StoredRemaining;
+				}
+
+				if (Stream->InputSize - Stream->InputPosition < Count)
+				{
+					Stream->State = InflateStateCorrupt;
+
+					break;
+				}
+
+				const uint8_t* Source = Stream->Input + Stream->InputPosition;
+
+				memcpy(Output + Produced, Source, Count);
+
+				// Only the last window's worth can ever be copied from.
+				for (size_t Index = (Count > INFLATE_WINDOW_SIZE) ? Count - INFLATE_WINDOW_SIZE : 0; Index < Count; Index++)
+				{
+					Stream->Window[Stream->WindowPosition++ & (INFLATE_WINDOW_SIZE - 1)] = Source[Index];
+				}
+
+				Stream->InputPosition += Count;
+
+				Stream->StoredRemaining -= (uint32_t)Count;
+
+				Stream->MemberSize += Count;
+
+				Produced += Count;
+
+				if (Stream->StoredRemaining == 0)
+				{
+					Stream->State = Stream->LastBlock ? InflateStateTrailer : InflateStateBlockHeader;
+				}
+
+				break;
+			}
+			case InflateStateHuffman:
+			{
+				Produced = InflateHuffmanBlock(Stream, Output, OutputSize, Produced);
+
+				break;
+			}
+			case InflateStateTrailer:
+			{
+				Stream->Crc = InflateCrc32(Stream, Stream->Crc, Output + CrcFrom, Produced - CrcFrom);
+
+				CrcFrom = Produced;
+
+				if (ReadMemberTrailer(Stream) == false)
+				{
+					Stream->State = InflateStateCorrupt;
+				}
+				else
+				{
+					Stream->State = (Stream->InputPosition == Stream->InputSize) ? InflateStateDone : InflateStateMemberHeader;
+				}
+
+				break;
+			}
+			default:
+			{
+				Stream->State = InflateStateCorrupt;
+
+				break;
+			}
+		}
+	}
+
+	// The trailer may be all that is left once the last byte is out.
+	if (Stream->State == InflateStateTrailer && Produced == OutputSize)
+	{
+		Stream->Crc = InflateCrc32(Stream, Stream->Crc, Output + CrcFrom, Produced - CrcFrom);
+
+		CrcFrom = Produced;
+
+		Stream->State = (ReadMemberTrailer(Stream) == false) ? InflateStateCorrupt : (Stream->InputPosition == Stream->InputSize) ? InflateStateDone : InflateStateMemberHeader;
+	}
+
+	if (Stream->State != InflateStateCorrupt)
+	{
+		Stream->Crc = InflateCrc32(Stream, Stream->Crc, Output + CrcFrom, Produced - CrcFrom);
+	}
+
+	Stream->TotalOut += Produced;
+
+	*Written = Produced;
+
+	return((Stream->State == InflateStateCorrupt) ? InflateCorrupt : (Stream->State == InflateStateDone) ? InflateEnd : InflateOk);
+}
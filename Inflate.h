@@ -0,0 +1,114 @@
+// Please read Inflate.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+// How far back a DEFLATE match can reach. A power of two.
+#define INFLATE_WINDOW_SIZE 32768
+
+// Codes up to this long are decoded with a single table lookup.
+#define INFLATE_FAST_BITS 10
+
+#define INFLATE_MAX_BITS 15
+
+#define INFLATE_MAX_SYMBOLS 288
+
+typedef enum INFLATE_STATUS
+{
+	// There may be more to come.
+	InflateOk,
+
+	// Every member has been decompressed, and every trailer checked.
+	InflateEnd,
+
+	// Not a gzip file, or a damaged one: a bad header, an impossible code, a match that reaches back before the start, input
+	// that ends too soon, or a CRC or size in a trailer that doesn't match.
+	InflateCorrupt
+
+} INFLATE_STATUS;
+
+typedef struct INFLATE_HUFFMAN
+{
+	// Symbol | (Length << 9) for every code of up to INFLATE_FAST_BITS bits, indexed by the next bits of input. 0 if the code
+	// starting with those bits is longer.
+	uint16_t Fast[1 << INFLATE_FAST_BITS];
+
+	// How many codes there are of each length, and the symbols in code order, for the longer ones.
+	uint16_t Counts[INFLATE_MAX_BITS + 1];
+
+	uint16_t Symbols[INFLATE_MAX_SYMBOLS];
+
+} INFLATE_HUFFMAN;
+
+// Everything about one gzip file being decompressed. Large, because of the window; allocate it rather than put it on the stack.
+typedef struct INFLATE_STREAM
+{
+	const uint8_t* Input;
+
+	size_t InputSize;
+
+	size_t InputPosition;
+
+	uint64_t BitBuffer;
+
+	uint32_t BitCount;
+
+	uint32_t State;
+
+	bool LastBlock;
+
+	// Bytes left in the stored block being copied.
+	uint32_t StoredRemaining;
+
+	// A match that didn't fit in the last output buffer.
+	uint32_t CopyLength;
+
+	uint32_t CopyDistance;
+
+	const INFLATE_HUFFMAN* Literals;
+
+	const INFLATE_HUFFMAN* Distances;
+
+	// Of the current member.
+	uint32_t Crc;
+
+	uint64_t MemberSize;
+
+	uint32_t Members;
+
+	uint64_t TotalOut;
+
+	uint32_t WindowPosition;
+
+	uint8_t Window[INFLATE_WINDOW_SIZE];
+
+	INFLATE_HUFFMAN DynamicLiterals;
+
+	INFLATE_HUFFMAN DynamicDistances;
+
+	INFLATE_HUFFMAN FixedLiterals;
+
+	INFLATE_HUFFMAN FixedDistances;
+
+	uint32_t CrcTable[256];
+
+} INFLATE_STREAM;
+
+bool InflateIsGzip(const uint8_t* Data, size_t Size);
+
+void InflateInitialize(INFLATE_STREAM* Stream, const uint8_t* Data, size_t Size);
+
+INFLATE_STATUS InflateRead(INFLATE_STREAM* Stream, uint8_t* Output, size_t OutputSize, size_t* Written);
+
+uint32_t InflateCrc32(const INFLATE_STREAM* Stream, uint32_t Crc, const uint8_t* Data, size_t Size);
@@ -0,0 +1,205 @@
+/*
+Md4.c
+
+MD4 (RFC 1320), for one reason only: the NT hash of a password is the MD4 of its UTF-16LE encoding, and that is the form
+in which breached password corpora are published for Windows (e.g. the NTLM downloads of Have I Been Pwned.) Hashing the
+candidate password the same way lets PasswordFilter look it up without ever storing a plaintext list.
+
+MD4 is long broken as a cryptographic hash. That doesn't matter here; it is only being used as a well-known fingerprint.
+
+Everything that held password material is wiped before returning, since this runs inside lsass.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "Md4.h"
+
+#define MD4_F(X, Y, Z) (((X) & (Y)) | (~(X) & (Z)))
+
+#define MD4_G(X, Y, Z) (((X) & (Y)) | ((X) & (Z)) | ((Y) & (Z)))
+
+#define MD4_H(X, Y, Z) ((X) ^ (Y) ^ (Z))
+
+#define MD4_ROTATE(Value, Bits) (((Value) << (Bits)) | ((Value) >> (32 - (Bits))))
+
+#define MD4_ROUND1(A, B, C, D, K, S) (A) = MD4_ROTATE((A) + MD4_F((B), (C), (D)) + Words[K], (S))
+
+#define MD4_ROUND2(A, B, C, D, K, S) (A) = MD4_ROTATE((A) + MD4_G((B), (C), (D)) + Words[K] + 0x5A827999, (S))
+
+#define MD4_ROUND3(A, B, C, D, K, S) (A) = MD4_ROTATE((A) + MD4_H((B), (C), (D)) + Words[K] + 0x6ED9EBA1, (S))
+
+// memset on a buffer that is never read again may be optimized away. Writing through a volatile pointer may not.
+void SecureWipe(void* Buffer, size_t Size)
+{
+	volatile uint8_t* Bytes = Buffer;
+
+	while (Size-- > 0)
+	{
+		*Bytes++ = 0;
+	}
+}
+
+static void Md4Transform(uint32_t State[4], const uint8_t Block[64])
+{
+	uint32_t Words[16];
+
+	for (int Index = 0; Index < 16; Index++)
+	{
+		Words[Index] = (uint32_t)Block[Index * 4] | ((uint32_t)Block[Index * 4 + 1] << 8) | ((uint32_t)Block[Index * 4 + 2] << 16) | ((uint32_t)Block[Index * 4 + 3] << 24);
+	}
+
+	uint32_t A = State[0];
+
+	uint32_t B = State[1];
+
+	uint32_t C = State[2];
+
+	uint32_t D = State[3];
+
+	MD4_ROUND1(A, B, C, D, 0, 3);  MD4_ROUND1(D, A, B, C, 1, 7);  MD4_ROUND1(C, D, A, B, 2, 11);  MD4_ROUND1(B, C, D, A, 3, 19);
+	MD4_ROUND1(A, B, C, D, 4, 3);  MD4_ROUND1(D, A, B, C, 5, 7);  MD4_ROUND1(C, D, A, B, 6, 11);  MD4_ROUND1(B, C, D, A, 7, 19);
+	MD4_ROUND1(A, B, C, D, 8, 3);  MD4_ROUND1(D, A, B, C, 9, 7);  MD4_ROUND1(C, D, A, B, 10, 11); MD4_ROUND1(B, C, D, A, 11, 19);
+	MD4_ROUND1(A, B, C, D, 12, 3); MD4_ROUND1(D, A, B, C, 13, 7); MD4_ROUND1(C, D, A, B, 14, 11); MD4_ROUND1(B, C, D, A, 15, 19);
+
+	MD4_ROUND2(A, B, C, D, 0, 3);  MD4_ROUND2(D, A, B, C, 4, 5);  MD4_ROUND2(C, D, A, B, 8, 9);   MD4_ROUND2(B, C, D, A, 12, 13);
+	MD4_ROUND2(A, B, C, D, 1, 3);  MD4_ROUND2(D, A, B, C, 5, 5);  MD4_ROUND2(C, D, A, B, 9, 9);   MD4_ROUND2(B, C, D, A, 13, 13);
+	MD4_ROUND2(A, B, C, D, 2, 3);  MD4_ROUND2(D, A, B, C, 6, 5);  MD4_ROUND2(C, D, A, B, 10, 9);  MD4_ROUND2(B, C, D, A, 14, 13);
+	MD4_ROUND2(A, B, C, D, 3, 3);  MD4_ROUND2(D, A, B, C, 7, 5);  MD4_ROUND2(C, D, A, B, 11, 9);  MD4_ROUND2(B, C, D, A, 15, 13);
+
+	MD4_ROUND3(A, B, C, D, 0, 3);  MD4_ROUND3(D, A, B, C, 8, 9);  MD4_ROUND3(C, D, A, B, 4, 11);  MD4_ROUND3(B, C, D, A, 12, 15);
+	MD4_ROUND3(A, B, C, D, 2, 3);  MD4_ROUND3(D, A, B, C, 10, 9); MD4_ROUND3(C, D, A, B, 6, 11);  MD4_ROUND3(B, C, D, A, 14, 15);
+	MD4_ROUND3(A, B, C, D, 1, 3);  MD4_ROUND3(D, A, B, C, 9, 9);  MD4_ROUND3(C, D, A, B, 5, 11);  MD4_ROUND3(B, C, D, A, 13, 15);
+	MD4_ROUND3(A, B, C, D, 3, 3);  MD4_ROUND3(D, A, B, C, 11, 9); MD4_ROUND3(C, D, A, B, 7, 11);  MD4_ROUND3(B, C, D, A, 15, 15);
+
+	State[0] += A;
+
+	State[1] += B;
+
+	State[2] += C;
+
+	State[3] += D;
+
+	SecureWipe(Words, sizeof(Words));
+}
+
+void Md4Initialize(MD4_CONTEXT* Context)
+{
+	Context->State[0] = 0x67452301;
+
+	Context->State[1] = 0xEFCDAB89;
+
+	Context->State[2] = 0x98BADCFE;
+
+	Context->State[3] = 0x10325476;
+
+	Context->ByteCount = 0;
+}
+
+void Md4Update(MD4_CONTEXT* Context, const void* Data, size_t Size)
+{
+	const uint8_t* Bytes = Data;
+
+	size_t Buffered = (size_t)(Context->ByteCount & 63);
+
+	Context->ByteCount += Size;
+
+	if (Buffered > 0)
+	{
+		size_t Needed = 64 - Buffered;
+
+		if (Size < Needed)
+		{
+			memcpy(Context->Block + Buffered, Bytes, Size);
+
+			return;
+		}
+
+		memcpy(Context->Block + Buffered, Bytes, Needed);
+
+		Md4Transform(Context->State, Context->Block);
+
+		Bytes += Needed;
+
+		Size -= Needed;
+	}
+
+	while (Size >= 64)
+	{
+		Md4Transform(Context->State, Bytes);
+
+		Bytes += 64;
+
+		Size -= 64;
+	}
+
+	memcpy(Context->Block, Bytes, Size);
+}
+
+void Md4Finalize(MD4_CONTEXT* Context, uint8_t Digest[MD4_DIGEST_SIZE])
+{
+	static const uint8_t Padding[64] = { 0x80 };
+
+	uint8_t LengthBytes[8];
+
+	uint64_t BitCount = Context->ByteCount * 8;
+
+	for (int Index = 0; Index < 8; Index++)
+	{
+		LengthBytes[Index] = (uint8_t)(BitCount >> (Index * 8));
+	}
+
+	size_t Buffered = (size_t)(Context->ByteCount & 63);
+
+	Md4Update(Context, Padding, (Buffered < 56) ? (56 - Buffered) : (120 - Buffered));
+
+	Md4Update(Context, LengthBytes, sizeof(LengthBytes));
+
+	for (int Index = 0; Index < 4; Index++)
+	{
+		Digest[Index * 4] = (uint8_t)Context->State[Index];
+
+		Digest[Index * 4 + 1] = (uint8_t)(Context->State[Index] >> 8);
+
+		Digest[Index * 4 + 2] = (uint8_t)(Context->State[Index] >> 16);
+
+		Digest[Index * 4 + 3] = (uint8_t)(Context->State[Index] >> 24);
+	}
+
+	SecureWipe(Context, sizeof(MD4_CONTEXT));
+}
+
+// The NT hash: MD4 over the password as UTF-16LE, with no terminator.
+void NtlmHash(const uint16_t* Password, size_t Length, uint8_t Hash[MD4_DIGEST_SIZE])
+{
+	MD4_CONTEXT Context;
+
+	uint8_t Bytes[64];
+
+	size_t Buffered = 0;
+
+	Md4Initialize(&Context);
+
+	// Spelled out a byte at a time rather than hashing the wchar_t buffer directly, so the tool gets the same answer on any machine.
+	for (size_t Index = 0; Index < Length; Index++)
+	{
+		Bytes[Buffered++] = (uint8_t)Password[Index];
+
+		Bytes[Buffered++] = (uint8_t)(Password[Index] >> 8);
+
+		if (Buffered == sizeof(Bytes))
+		{
+			Md4Update(&Context, Bytes, Buffered);
+
+			Buffered = 0;
+		}
+	}
+
+	Md4Update(&Context, Bytes, Buffered);
+
+	Md4Finalize(&Context, Hash);
+
+	SecureWipe(Bytes, sizeof(Bytes));
+}
@@ -0,0 +1,35 @@
+// Please read Md4.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#define MD4_DIGEST_SIZE 16
+
+typedef struct MD4_CONTEXT
+{
+	uint32_t State[4];
+
+	uint64_t ByteCount;
+
+	uint8_t Block[64];
+
+} MD4_CONTEXT;
+
+void Md4Initialize(MD4_CONTEXT* Context);
+
+void Md4Update(MD4_CONTEXT* Context, const void* Data, size_t Size);
+
+void Md4Finalize(MD4_CONTEXT* Context, uint8_t Digest[MD4_DIGEST_SIZE]);
+
+void NtlmHash(const uint16_t* Password, size_t Length, uint8_t Hash[MD4_DIGEST_SIZE]);
+
+void SecureWipe(void* Buffer, size_t Size);
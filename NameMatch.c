@@ -0,0 +1,268 @@
+/*
+NameMatch.c
+
+Rejects passwords that are mostly the user's own name, such as "JSmith2024!" for jsmith or "Johnny.Appleseed" for Johnny
+Appleseed, the way the blacklist rejects passwords that are mostly a token. Windows' own complexity rule has a weaker form of
+this, but that only comes with the rest of the complexity rule, and it doesn't see "j0hnny" when the blacklist makes 0 and o
+the same.
+
+The account name and the full name are split into parts wherever Windows splits them (commas, periods, dashes, underscores,
+spaces, pound signs and tabs), parts shorter than NAME_MIN_PART_LENGTH are left out, and the account name is also kept whole
+when it has more than one part. Each part is folded and canonicalized like a blacklist token, and then counts as one, only for
+this one password change: it must make up at least half of the password.
+
+The names change with every call, so building them into the blacklist's automaton is out of the question, and so is an
+automaton of their own, which would mean allocating on every call. Instead, all of the parts are laid end to end in one 64-bit
+word and matched with the Shift-And algorithm (Baeza-Yates and Gonnet), which BlacklistFindToken runs in the same pass over the
+password as the blacklist's automaton: each character of the password is a shift, an OR and an AND, with the mask of where that
+character is in the parts. NAME_PATTERNS holds the masks and everything else, on the stack of the call. Parts that would take
+the total past NAME_MAX_CHARACTERS are left out, starting with the whole account name.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "NameMatch.h"
+
+#include "Blacklist.h"
+
+#include "Normalize.h"
+
+static bool IsNameDelimiter(uint16_t Character)
+{
+	switch (Character)
+	{
+		case L',':
+		case L'.':
+		case L'-':
+		case L'_':
+		case L' ':
+		case L'#':
+		case L'\t':
+		{
+			return(true);
+		}
+		default:
+		{
+			return(false);
+		}
+	}
+}
+
+static void AddCharacter(NAME_PATTERNS* Names, uint16_t Character, uint64_t Bit)
+{
+	uint32_t Index = 0;
+
+	if (Character < AC_ALPHABET_SIZE)
+	{
+		Index = Names->ByteIndex[Character];
+	}
+	else
+	{
+		for (uint32_t Distinct = 1; Distinct <= Names->DistinctCount; Distinct++)
+		{
+			if (Names->Distinct[Distinct] == Character)
+			{
+				Index = Distinct;
+
+				break;
+			}
+		}
+	}
+
+	if (Index != 0)
+	{
+		Names->DistinctMasks[Index] |= Bit;
+
+		return;
+	}
+
+	// There are never more distinct characters than there are characters, so this always fits.
+	Index = ++Names->DistinctCount;
+
+	Names->Distinct[Index] = Character;
+
+	Names->DistinctMasks[Index] = Bit;
+
+	if (Character < AC_ALPHABET_SIZE)
+	{
+		Names->ByteIndex[Character] = (uint8_t)Index;
+	}
+}
+
+static bool HavePart(const NAME_PATTERNS* Names, const uint16_t* Part, uint32_t Length)
+{
+	for (uint32_t Index = 0; Index < Names->PartCount; Index++)
+	{
+		if (Names->PartLengths[Index] == Length && memcmp(&Names->Characters[Names->PartStarts[Index]], Part, Length * sizeof(uint16_t)) == 0)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+// Part is already folded and canonicalized.
+static void AddPart(NAME_PATTERNS* Names, const uint16_t* Part, uint32_t Length)
+{
+	if (Length < NAME_MIN_PART_LENGTH)
+	{
+		return;
+	}
+
+	if (Length > NAME_MAX_CHARACTERS - Names->CharacterCount)
+	{
+		Names->PartsDropped++;
+
+		return;
+	}
+
+	// "John Smith" for smith.john would otherwise take up room twice.
+	if (HavePart(Names, Part, Length))
+	{
+		return;
+	}
+
+	uint32_t First = Names->CharacterCount;
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Names->Characters[First + Index] = Part[Index];
+
+		AddCharacter(Names, Part[Index], (uint64_t)1 << (First + Index));
+	}
+
+	Names->Starts |= (uint64_t)1 << First;
+
+	Names->PartStarts[Names->PartCount] = (uint8_t)First;
+
+	Names->PartLengths[Names->PartCount] = (uint8_t)Length;
+
+	Names->PartCount++;
+
+	Names->CharacterCount += Length;
+}
+
+/*
+Folds and canonicalizes the whole of Name into Folded, once, and adds its parts from there. Names are split where the name as
+given has a delimiter, whatever the blacklist substitutes it with. Returns the length of Folded, which is 0 when there is no
+name. *Split says whether it had more than one part.
+
+*/
+static size_t AddParts(NAME_PATTERNS* Names, const AC_AUTOMATON* Automaton, const PLATFORM_STRING* Name, uint16_t* Folded, bool* Split)
+{
+	size_t Length = 0;
+
+	size_t Start = 0;
+
+	*Split = false;
+
+	if (Name == NULL || Name->Buffer == NULL)
+	{
+		return(0);
+	}
+
+	Length = Name->Length / sizeof(uint16_t);
+
+	Length = (Length < NAME_MAX_NAME_LENGTH) ? Length : NAME_MAX_NAME_LENGTH;
+
+	memcpy(Folded, Name->Buffer, Length * sizeof(uint16_t));
+
+	NormalizeString(Folded, Length);
+
+	BlacklistCanonicalize(Automaton, Folded, Length);
+
+	for (size_t Index = 0; Index <= Length; Index++)
+	{
+		if (Index < Length && IsNameDelimiter(Name->Buffer[Index]) == false)
+		{
+			continue;
+		}
+
+		if (Index < Length)
+		{
+			*Split = true;
+		}
+
+		if (Index - Start <= NAME_MAX_CHARACTERS)
+		{
+			AddPart(Names, &Folded[Start], (uint32_t)(Index - Start));
+		}
+		else
+		{
+			Names->PartsDropped++;
+		}
+
+		Start = Index + 1;
+	}
+
+	return(Length);
+}
+
+/*
+Builds the patterns for one password change. Either name may be NULL or empty, and so may Automaton, in which case nothing is
+canonicalized. Names->Starts is 0 when there is nothing to look for.
+
+*/
+void NamePatternsBuild(NAME_PATTERNS* Names, const AC_AUTOMATON* Automaton, const PLATFORM_STRING* AccountName, const PLATFORM_STRING* FullName)
+{
+	uint16_t FoldedAccountName[NAME_MAX_NAME_LENGTH];
+
+	uint16_t FoldedFullName[NAME_MAX_NAME_LENGTH];
+
+	bool AccountNameSplit = false;
+
+	bool FullNameSplit = false;
+
+	memset(Names, 0, offsetof(NAME_PATTERNS, DistinctMasks));
+
+	Names->DistinctMasks[0] = 0;
+
+	size_t AccountNameLength = AddParts(Names, Automaton, AccountName, FoldedAccountName, &AccountNameSplit);
+
+	AddParts(Names, Automaton, FullName, FoldedFullName, &FullNameSplit);
+
+	// The whole account name goes in last, so that it is what gets left out if there isn't room for everything.
+	if (AccountNameSplit && AccountNameLength <= NAME_MAX_CHARACTERS)
+	{
+		AddPart(Names, FoldedAccountName, (uint32_t)AccountNameLength);
+	}
+}
+
+// Where Character is in the parts. BlacklistFindToken looks characters that fit into a byte up itself.
+uint64_t NameCharacterMask(const NAME_PATTERNS* Names, uint16_t Character)
+{
+	if (Character < AC_ALPHABET_SIZE)
+	{
+		return(Names->DistinctMasks[Names->ByteIndex[Character]]);
+	}
+
+	for (uint32_t Index = 1; Index <= Names->DistinctCount; Index++)
+	{
+		if (Names->Distinct[Index] == Character)
+		{
+			return(Names->DistinctMasks[Index]);
+		}
+	}
+
+	return(0);
+}
+
+// The ends of the parts that are long enough to make up at least half of a password of PasswordLength characters.
+uint64_t NameLongEnoughEnds(const NAME_PATTERNS* Names, size_t PasswordLength)
+{
+	uint64_t LongEnough = 0;
+
+	for (uint32_t Index = 0; Index < Names->PartCount; Index++)
+	{
+		if ((size_t)Names->PartLengths[Index] * 2 >= PasswordLength)
+		{
+			LongEnough |= (uint64_t)1 << (Names->PartStarts[Index] + Names->PartLengths[Index] - 1);
+		}
+	}
+
+	return(LongEnough);
+}
@@ -0,0 +1,70 @@
+// Please read NameMatch.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "Platform.h"
+
+// Returned by BlacklistFindToken in place of a pattern ID when it was the user's own name that matched.
+#define NAME_PATTERN 0xFFFFFFFE
+
+// Parts of a name shorter than this are left out, as they are by the Windows password complexity rule.
+#define NAME_MIN_PART_LENGTH 3
+
+// All of the parts of both names together. Each character is one bit of the matcher's state.
+#define NAME_MAX_CHARACTERS 64
+
+// Only this much of each name is looked at. An account name is at most 20 characters, and a full name at most 256.
+#define NAME_MAX_NAME_LENGTH 256
+
+// No part is shorter than NAME_MIN_PART_LENGTH.
+#define NAME_MAX_PARTS (NAME_MAX_CHARACTERS / NAME_MIN_PART_LENGTH)
+
+// Everything is in here, so that it can live on the stack of the call it is built for. Only the fields up to DistinctMasks are
+// cleared for each call; the rest is only read where it has been written.
+typedef struct NAME_PATTERNS
+{
+	// Bit i stands for character i of the parts, laid end to end.
+	uint64_t Starts;
+
+	uint32_t CharacterCount;
+
+	uint32_t PartCount;
+
+	uint32_t DistinctCount;
+
+	// Parts that didn't fit into NAME_MAX_CHARACTERS.
+	uint32_t PartsDropped;
+
+	// For a character that fits into a byte, its index in DistinctMasks, or 0 if it isn't in any part.
+	uint8_t ByteIndex[AC_ALPHABET_SIZE];
+
+	// Where each of the distinct characters is in the parts. The mask at 0 is always empty.
+	uint64_t DistinctMasks[NAME_MAX_CHARACTERS + 1];
+
+	uint16_t Distinct[NAME_MAX_CHARACTERS + 1];
+
+	uint16_t Characters[NAME_MAX_CHARACTERS];
+
+	uint8_t PartStarts[NAME_MAX_PARTS];
+
+	uint8_t PartLengths[NAME_MAX_PARTS];
+
+} NAME_PATTERNS;
+
+void NamePatternsBuild(NAME_PATTERNS* Names, const AC_AUTOMATON* Automaton, const PLATFORM_STRING* AccountName, const PLATFORM_STRING* FullName);
+
+uint64_t NameCharacterMask(const NAME_PATTERNS* Names, uint16_t Character);
+
+uint64_t NameLongEnoughEnds(const NAME_PATTERNS* Names, size_t PasswordLength);
@@ -0,0 +1,478 @@
+/*
+Normalize.c
+
+Case folding shared by everything that produces or consumes blacklist tokens.
+
+Tokens used to be folded with towlower inside the DLL. The result of towlower depends on the C runtime and its locale,
+and the offline compiler (see PassFiltExTool) must fold exactly the way the DLL does, or a compiled image would not give
+the same verdicts as the text file. So the folding rule is spelled out here instead.
+
+Only characters whose lowercase form fits into a byte matter, because those are the only ones that can ever match a token:
+
+  - A-Z and the Latin-1 capitals U+00C0 - U+00DE (except the multiplication sign U+00D7) are shifted down by 0x20.
+
+  - A handful of characters outside of Latin-1 lowercase into it: U+0130, U+0178, U+212A and U+212B.
+
+Everything else is returned unchanged.
+
+Every blacklist line is folded once as it is loaded, and every password once as it is checked, so the folding is done a
+whole string at a time, by one of several kernels that all give exactly the same result:
+
+  - Scalar: one character at a time, looked up in gNormalizeLatin1, with the four exceptions above handled on the side.
+    This is the reference, and what runs on anything that isn't x86.
+
+  - SSE2: 8 characters (or 16 bytes) at a time. Every x64 CPU has it, so it is compiled in whenever the compiler targets it,
+    the same way BlacklistParser.c does it. The range checks leave anything above U+00FF alone, which is right for all but
+    the four exceptions, so a block with one of those in it is handed to the scalar kernel instead.
+
+  - AVX2: 16 characters (or 32 bytes) at a time, but only if the CPU and the OS both support it, which is found out with
+    CPUID the first time anything is folded.
+
+PassFiltExTool normalize-bench checks every kernel against the scalar one and measures how fast each of them is.
+
+Platform-neutral C.
+
+*/
+
+#include <stddef.h>
+
+#include "Normalize.h"
+
+#include "Platform.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+
+#define NORMALIZE_SSE2
+
+#include <emmintrin.h>
+
+#endif
+
+// AVX2 has to be asked for function by function on GCC and Clang, since the rest of the file must run on any x64 CPU.
+#if defined(NORMALIZE_SSE2) && (defined(_M_X64) || (defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))))
+
+#define NORMALIZE_AVX2
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+#define NORMALIZE_TARGET_AVX2
+
+#else
+
+#include <cpuid.h>
+
+#define NORMALIZE_TARGET_AVX2 __attribute__((target("avx2")))
+
+#endif
+
+#endif
+
+// A-Z and U+00C0 - U+00DE, except U+00D7, moved down by 0x20. Everything else maps to itself.
+static const uint8_t gNormalizeLatin1[256] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+	0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+	0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+	0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,
+	0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+	0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+	0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+	0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+	0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+	0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+	0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xD7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xDF,
+	0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+	0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
+};
+
+typedef void (*NORMALIZE_STRING_ROUTINE)(uint16_t* Text, size_t Length);
+
+typedef void (*NORMALIZE_BYTES_ROUTINE)(uint8_t* Text, size_t Length);
+
+// -1 until the first call works out which kernel this CPU can run. Every thread that races to do that comes to the same answer.
+static volatile int32_t gNormalizeKernel = -1;
+
+uint16_t NormalizeCharacter(uint16_t Character)
+{
+	if (Character < 0x100)
+	{
+		return(gNormalizeLatin1[Character]);
+	}
+
+	switch (Character)
+	{
+		case 0x0130:
+		{
+			return(0x0069);
+		}
+		case 0x0178:
+		{
+			return(0x00FF);
+		}
+		case 0x212A:
+		{
+			return(0x006B);
+		}
+		case 0x212B:
+		{
+			return(0x00E5);
+		}
+		default:
+		{
+			return(Character);
+		}
+	}
+}
+
+static void NormalizeStringScalar(uint16_t* Text, size_t Length)
+{
+	for (size_t Index = 0; Index < Length; Index++)
+	{
+		Text[Index] = NormalizeCharacter(Text[Index]);
+	}
+}
+
+static void NormalizeBytesScalar(uint8_t* Text, size_t Length)
+{
+	for (size_t Index = 0; Index < Length; Index++)
+	{
+		Text[Index] = gNormalizeLatin1[Text[Index]];
+	}
+}
+
+#ifdef NORMALIZE_SSE2
+
+// Signed comparisons, but characters from U+0100 up fall outside both ranges either way, and are left alone.
+static __m128i FoldLatin1Sse2(__m128i Characters)
+{
+	__m128i Upper = _mm_and_si128(_mm_cmpgt_epi16(Characters, _mm_set1_epi16('A' - 1)), _mm_cmplt_epi16(Characters, _mm_set1_epi16('Z' + 1)));
+
+	__m128i Latin1Upper = _mm_and_si128(_mm_cmpgt_epi16(Characters, _mm_set1_epi16(0xBF)), _mm_cmplt_epi16(Characters, _mm_set1_epi16(0xDF)));
+
+	Latin1Upper = _mm_andnot_si128(_mm_cmpeq_epi16(Characters, _mm_set1_epi16(0xD7)), Latin1Upper);
+
+	return(_mm_add_epi16(Characters, _mm_and_si128(_mm_or_si128(Upper, Latin1Upper), _mm_set1_epi16(0x20))));
+}
+
+// Whether any of the four characters that fold into Latin-1 from outside it is among Characters.
+static bool HasExceptionSse2(__m128i Characters)
+{
+	__m128i Found = _mm_or_si128(_mm_cmpeq_epi16(Characters, _mm_set1_epi16(0x0130)), _mm_cmpeq_epi16(Characters, _mm_set1_epi16(0x0178)));
+
+	Found = _mm_or_si128(Found, _mm_or_si128(_mm_cmpeq_epi16(Characters, _mm_set1_epi16(0x212A)), _mm_cmpeq_epi16(Characters, _mm_set1_epi16(0x212B))));
+
+	return(_mm_movemask_epi8(Found) != 0);
+}
+
+// Lanes of Bytes that are between Low and High inclusive, as unsigned bytes. SSE2 only compares signed bytes.
+static __m128i BytesInRangeSse2(__m128i Bytes, uint8_t Low, uint8_t High)
+{
+	__m128i Offset = _mm_sub_epi8(Bytes, _mm_set1_epi8((char)Low));
+
+	return(_mm_cmpeq_epi8(_mm_min_epu8(Offset, _mm_set1_epi8((char)(High - Low))), Offset));
+}
+
+static void NormalizeStringSse2(uint16_t* Text, size_t Length)
+{
+	size_t Index = 0;
+
+	for (; Index + 8 <= Length; Index += 8)
+	{
+		__m128i Characters = _mm_loadu_si128((const __m128i*)(const void*)(Text + Index));
+
+		if (HasExceptionSse2(Characters))
+		{
+			NormalizeStringScalar(Text + Index, 8);
+
+			continue;
+		}
+
+		_mm_storeu_si128((__m128i*)(void*)(Text + Index), FoldLatin1Sse2(Characters));
+	}
+
+	NormalizeStringScalar(Text + Index, Length - Index);
+}
+
+static void NormalizeBytesSse2(uint8_t* Text, size_t Length)
+{
+	size_t Index = 0;
+
+	for (; Index + 16 <= Length; Index += 16)
+	{
+		__m128i Bytes = _mm_loadu_si128((const __m128i*)(const void*)(Text + Index));
+
+		__m128i Fold = _mm_or_si128(BytesInRangeSse2(Bytes, 'A', 'Z'), _mm_andnot_si128(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8((char)0xD7)), BytesInRangeSse2(Bytes, 0xC0, 0xDE)));
+
+		_mm_storeu_si128((__m128i*)(void*)(Text + Index), _mm_add_epi8(Bytes, _mm_and_si128(Fold, _mm_set1_epi8(0x20))));
+	}
+
+	NormalizeBytesScalar(Text + Index, Length - Index);
+}
+
+#endif
+
+#ifdef NORMALIZE_AVX2
+
+NORMALIZE_TARGET_AVX2 static __m256i FoldLatin1Avx2(__m256i Characters)
+{
+	__m256i Upper = _mm256_and_si256(_mm256_cmpgt_epi16(Characters, _mm256_set1_epi16('A' - 1)), _mm256_cmpgt_epi16(_mm256_set1_epi16('Z' + 1), Characters));
+
+	__m256i Latin1Upper = _mm256_and_si256(_mm256_cmpgt_epi16(Characters, _mm256_set1_epi16(0xBF)), _mm256_cmpgt_epi16(_mm256_set1_epi16(0xDF), Characters));
+
+	Latin1Upper = _mm256_andnot_si256(_mm256_cmpeq_epi16(Characters, _mm256_set1_epi16(0xD7)), Latin1Upper);
+
+	return(_mm256_add_epi16(Characters, _mm256_and_si256(_mm256_or_si256(Upper, Latin1Upper), _mm256_set1_epi16(0x20))));
+}
+
+NORMALIZE_TARGET_AVX2 static bool HasExceptionAvx2(__m256i Characters)
+{
+	__m256i Found = _mm256_or_si256(_mm256_cmpeq_epi16(Characters, _mm256_set1_epi16(0x0130)), _mm256_cmpeq_epi16(Characters, _mm256_set1_epi16(0x0178)));
+
+	Found = _mm256_or_si256(Found, _mm256_or_si256(_mm256_cmpeq_epi16(Characters, _mm256_set1_epi16(0x212A)), _mm256_cmpeq_epi16(Characters, _mm256_set1_epi16(0x212B))));
+
+	return(_mm256_testz_si256(Found, Found) == 0);
+}
+
+NORMALIZE_TARGET_AVX2 static __m256i BytesInRangeAvx2(__m256i Bytes, uint8_t Low, uint8_t High)
+{
+	__m256i Offset = _mm256_sub_epi8(Bytes, _mm256_set1_epi8((char)Low));
+
+	return(_mm256_cmpeq_epi8(_mm256_min_epu8(Offset, _mm256_set1_epi8((char)(High - Low))), Offset));
+}
+
+NORMALIZE_TARGET_AVX2 static void NormalizeStringAvx2(uint16_t* Text, size_t Length)
+{
+	size_t Index = 0;
+
+	for (; Index + 16 <= Length; Index += 16)
+	{
+		__m256i Characters = _mm256_loadu_si256((const __m256i*)(const void*)(Text + Index));
+
+		if (HasExceptionAvx2(Characters))
+		{
+			NormalizeStringScalar(Text + Index, 16);
+
+			continue;
+		}
+
+		_mm256_storeu_si256((__m256i*)(void*)(Text + Index), FoldLatin1Avx2(Characters));
+	}
+
+	NormalizeStringSse2(Text + Index, Length - Index);
+}
+
+NORMALIZE_TARGET_AVX2 static void NormalizeBytesAvx2(uint8_t* Text, size_t Length)
+{
+	size_t Index = 0;
+
+	for (; Index + 32 <= Length; Index += 32)
+	{
+		__m256i Bytes = _mm256_loadu_si256((const __m256i*)(const void*)(Text + Index));
+
+		__m256i Fold = _mm256_or_si256(BytesInRangeAvx2(Bytes, 'A', 'Z'), _mm256_andnot_si256(_mm256_cmpeq_epi8(Bytes, _mm256_set1_epi8((char)0xD7)), BytesInRangeAvx2(Bytes, 0xC0, 0xDE)));
+
+		_mm256_storeu_si256((__m256i*)(void*)(Text + Index), _mm256_add_epi8(Bytes, _mm256_and_si256(Fold, _mm256_set1_epi8(0x20))));
+	}
+
+	NormalizeBytesSse2(Text + Index, Length - Index);
+}
+
+// AVX2 needs the CPU to have it, and the OS to save the YMM registers on a context switch (XCR0 bits 1 and 2).
+static bool CpuHasAvx2(void)
+{
+	unsigned int Registers[4] = { 0 };
+
+	uint64_t EnabledState = 0;
+
+#ifdef _MSC_VER
+
+	__cpuid((int*)Registers, 0);
+
+	if (Registers[0] < 7)
+	{
+		return(false);
+	}
+
+	__cpuid((int*)Registers, 1);
+
+#else
+
+	if (__get_cpuid_max(0, NULL) < 7)
+	{
+		return(false);
+	}
+
+	__cpuid(1, Registers[0], Registers[1], Registers[2], Registers[3]);
+
+#endif
+
+	// OSXSAVE and AVX.
+	if ((Registers[2] & (1u << 27)) == 0 || (Registers[2] & (1u << 28)) == 0)
+	{
+		return(false);
+	}
+
+#ifdef _MSC_VER
+
+	EnabledState = _xgetbv(0);
+
+	__cpuidex((int*)Registers, 7, 0);
+
+#else
+
+	uint32_t EnabledLow = 0;
+
+	uint32_t EnabledHigh = 0;
+
+	__asm__ __volatile__("xgetbv" : "=a"(EnabledLow), "=d"(EnabledHigh) : "c"(0));
+
+	EnabledState = ((uint64_t)EnabledHigh << 32) | EnabledLow;
+
+	__cpuid_count(7, 0, Registers[0], Registers[1], Registers[2], Registers[3]);
+
+#endif
+
+	return((EnabledState & 6) == 6 && (Registers[1] & (1u << 5)) != 0);
+}
+
+#endif
+
+static const NORMALIZE_STRING_ROUTINE gNormalizeStringRoutines[NormalizeKernelCount] =
+{
+	NormalizeStringScalar,
+
+#ifdef NORMALIZE_SSE2
+	NormalizeStringSse2,
+#else
+	NULL,
+#endif
+
+#ifdef NORMALIZE_AVX2
+	NormalizeStringAvx2,
+#else
+	NULL,
+#endif
+};
+
+static const NORMALIZE_BYTES_ROUTINE gNormalizeBytesRoutines[NormalizeKernelCount] =
+{
+	NormalizeBytesScalar,
+
+#ifdef NORMALIZE_SSE2
+	NormalizeBytesSse2,
+#else
+	NULL,
+#endif
+
+#ifdef NORMALIZE_AVX2
+	NormalizeBytesAvx2,
+#else
+	NULL,
+#endif
+};
+
+bool NormalizeKernelSupported(NORMALIZE_KERNEL Kernel)
+{
+	switch (Kernel)
+	{
+		case NormalizeKernelScalar:
+		{
+			return(true);
+		}
+		case NormalizeKernelSse2:
+		{
+			return(gNormalizeStringRoutines[NormalizeKernelSse2] != NULL);
+		}
+		case NormalizeKernelAvx2:
+		{
+#ifdef NORMALIZE_AVX2
+			return(CpuHasAvx2());
+#else
+			return(false);
+#endif
+		}
+		default:
+		{
+			return(false);
+		}
+	}
+}
+
+// The fastest kernel this CPU can run. Worked out once.
+NORMALIZE_KERNEL NormalizeBestKernel(void)
+{
+	int32_t Kernel = PlatformLoad(&gNormalizeKernel);
+
+	if (Kernel >= 0)
+	{
+		return((NORMALIZE_KERNEL)Kernel);
+	}
+
+	Kernel = NormalizeKernelScalar;
+
+	for (int32_t Candidate = NormalizeKernelCount - 1; Candidate > NormalizeKernelScalar; Candidate--)
+	{
+		if (NormalizeKernelSupported((NORMALIZE_KERNEL)Candidate))
+		{
+			Kernel = Candidate;
+
+			break;
+		}
+	}
+
+	PlatformStore(&gNormalizeKernel, Kernel);
+
+	return((NORMALIZE_KERNEL)Kernel);
+}
+
+const char* NormalizeKernelName(NORMALIZE_KERNEL Kernel)
+{
+	switch (Kernel)
+	{
+		case NormalizeKernelScalar:
+		{
+			return("scalar");
+		}
+		case NormalizeKernelSse2:
+		{
+			return("SSE2");
+		}
+		case NormalizeKernelAvx2:
+		{
+			return("AVX2");
+		}
+		default:
+		{
+			return("unknown kernel");
+		}
+	}
+}
+
+// Folds Length characters of Text in place, every one of them.
+void NormalizeString(uint16_t* Text, size_t Length)
+{
+	gNormalizeStringRoutines[NormalizeBestKernel()](Text, Length);
+}
+
+void NormalizeTokenBytes(uint8_t* Token, uint32_t Length)
+{
+	gNormalizeBytesRoutines[NormalizeBestKernel()](Token, Length);
+}
+
+// The same as NormalizeString, with the given kernel, which must be supported. For comparing kernels with each other.
+void NormalizeStringWith(NORMALIZE_KERNEL Kernel, uint16_t* Text, size_t Length)
+{
+	gNormalizeStringRoutines[Kernel](Text, Length);
+}
+
+void NormalizeTokenBytesWith(NORMALIZE_KERNEL Kernel, uint8_t* Token, uint32_t Length)
+{
+	gNormalizeBytesRoutines[Kernel](Token, Length);
+}
@@ -0,0 +1,37 @@
+// Please read Normalize.c for full commentary.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+typedef enum NORMALIZE_KERNEL
+{
+	NormalizeKernelScalar,
+
+	NormalizeKernelSse2,
+
+	NormalizeKernelAvx2,
+
+	NormalizeKernelCount
+
+} NORMALIZE_KERNEL;
+
+uint16_t NormalizeCharacter(uint16_t Character);
+
+void NormalizeString(uint16_t* Text, size_t Length);
+
+void NormalizeTokenBytes(uint8_t* Token, uint32_t Length);
+
+bool NormalizeKernelSupported(NORMALIZE_KERNEL Kernel);
+
+NORMALIZE_KERNEL NormalizeBestKernel(void);
+
+const char* NormalizeKernelName(NORMALIZE_KERNEL Kernel);
+
+void NormalizeStringWith(NORMALIZE_KERNEL Kernel, uint16_t* Text, size_t Length);
+
+void NormalizeTokenBytesWith(NORMALIZE_KERNEL Kernel, uint8_t* Token, uint32_t Length);
@@ -0,0 +1,374 @@
+/*
+NotifyQueue.c
+
+Takes the work that follows a password change off the thread that LSA called PasswordChangeNotify on.
+
+LSA waits for PasswordChangeNotify to return before it goes on, so anything done there makes every password change take that
+much longer. Writing an audit record to a file, or passing the change on to anyone else, means disk I/O that can take
+milliseconds, or far longer on a busy DC. So PasswordChangeNotify only posts a small record here and returns, and a worker
+thread of the queue's own hands the records, a batch at a time, to a NOTIFY_SINK that does the slow part.
+
+  - The queue is a fixed ring of NOTIFY_QUEUE_SIZE slots, lock-free for any number of posting threads, in the style of
+    Dmitry Vyukov's bounded queue, the same as the trace rings (see Trace.c): every slot carries a sequence number that says
+    whose turn it is. A post is a compare-exchange and a copy, never waits for another post or for the worker, and never
+    allocates.
+
+  - When the ring is full, which only happens if the sink falls far behind, a post is turned away, never made to wait: LSA
+    must not be held up by a slow disk. The drop is counted, and the worker puts a NotifyRecordsDropped record where the gap
+    is, so whoever reads what the sink wrote can tell that records are missing and how many.
+
+  - Records are batched. The worker sleeps until a batch's worth is waiting, when the post that completes it wakes it, or for
+    at most NOTIFY_FLUSH_MILLISECONDS, so a quiet DC writes at most once a second, and a busy one NOTIFY_BATCH_SIZE records
+    at a time. The worker copies records out of the ring before it calls the sink, so a slow sink never keeps slots taken
+    any longer than it takes to copy them.
+
+  - NotifyQueueStop closes the queue to new posts, waits for any post that is already under way, has the worker hand over
+    everything that is left, and only then returns. Nothing that was posted is lost on the way out.
+
+PassFiltExTool notify-check posts from several threads at once to a fast sink and to a slow one, and shows that posting costs
+the same either way.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "NotifyQueue.h"
+
+#include "Platform.h"
+
+typedef char NOTIFY_QUEUE_SIZE_CHECK[((NOTIFY_QUEUE_SIZE & (NOTIFY_QUEUE_SIZE - 1)) == 0) ? 1 : -1];
+
+typedef struct NOTIFY_SLOT
+{
+	// Equal to the position a poster may claim the slot at, or one past it once the record is in and can be read.
+	volatile int32_t Sequence;
+
+	NOTIFY_RECORD Record;
+
+} NOTIFY_SLOT;
+
+struct NOTIFY_QUEUE
+{
+	// Next position to post at. Shared by every posting thread.
+	volatile int32_t Head;
+
+	uint8_t HeadPadding[64 - sizeof(int32_t)];
+
+	// Next position to read. Only the worker moves it; posts look at it to tell how many records are waiting.
+	volatile int32_t Tail;
+
+	uint8_t TailPadding[64 - sizeof(int32_t)];
+
+	// Set by the post that wakes the worker, until the worker starts draining, so that a batch costs one wake and not one per record.
+	volatile int32_t WakePending;
+
+	// Posts under way. NotifyQueueStop waits for them.
+	volatile int32_t Posters;
+
+	volatile int32_t Closing;
+
+	volatile int32_t Stopping;
+
+	volatile int32_t Dropped;
+
+	// How many of the drops the worker has already put a NotifyRecordsDropped record out for. Only the worker touches it.
+	uint32_t DroppedReported;
+
+	volatile int64_t Posted;
+
+	volatile int64_t Written;
+
+	volatile int64_t Failed;
+
+	volatile int64_t Batches;
+
+	NOTIFY_SINK Sink;
+
+	void* Context;
+
+	PLATFORM_EVENT* Wake;
+
+	PLATFORM_THREAD* Worker;
+
+	// Where the worker collects records before handing them to the sink.
+	NOTIFY_RECORD Batch[NOTIFY_BATCH_SIZE];
+
+	NOTIFY_SLOT Slots[NOTIFY_QUEUE_SIZE];
+};
+
+// Hands Count records to the sink. Posted of them came from posts; the rest report drops.
+static void FlushBatch(NOTIFY_QUEUE* Queue, uint32_t Count, uint32_t Posted)
+{
+	if (Count == 0)
+	{
+		return;
+	}
+
+	bool Written = Queue->Sink(Queue->Context, Queue->Batch, Count);
+
+	PlatformAdd64(Written ? &Queue->Written : &Queue->Failed, Posted);
+
+	PlatformAdd64(&Queue->Batches, 1);
+}
+
+// Takes every record that has been posted so far out of the ring, and hands them over a batch at a time.
+static void DrainQueue(NOTIFY_QUEUE* Queue)
+{
+	uint32_t Count = 0;
+
+	uint32_t Posted = 0;
+
+	while (true)
+	{
+		uint32_t Dropped = (uint32_t)PlatformLoad(&Queue->Dropped);
+
+		if (Dropped != Queue->DroppedReported)
+		{
+			NOTIFY_RECORD* Record = &Queue->Batch[Count++];
+
+			memset(Record, 0, sizeof(NOTIFY_RECORD));
+
+			Record->Timestamp = PlatformTimestamp();
+
+			Record->Kind = NotifyRecordsDropped;
+
+			Record->Count = Dropped - Queue->DroppedReported;
+
+			Record->ThreadId = PlatformThreadId();
+
+			Queue->DroppedReported = Dropped;
+		}
+		else
+		{
+			int32_t Tail = Queue->Tail;
+
+			NOTIFY_SLOT* Slot = &Queue->Slots[Tail & (NOTIFY_QUEUE_SIZE - 1)];
+
+			if (PlatformLoad(&Slot->Sequence) != (int32_t)((uint32_t)Tail + 1))
+			{
+				break;
+			}
+
+			Queue->Batch[Count++] = Slot->Record;
+
+			Posted++;
+
+			// Free the slot for the post that will get to it on the next lap.
+			PlatformStore(&Slot->Sequence, (int32_t)((uint32_t)Tail + NOTIFY_QUEUE_SIZE));
+
+			PlatformStore(&Queue->Tail, (int32_t)((uint32_t)Tail + 1));
+		}
+
+		if (Count == NOTIFY_BATCH_SIZE)
+		{
+			FlushBatch(Queue, Count, Posted);
+
+			Count = 0;
+
+			Posted = 0;
+		}
+	}
+
+	FlushBatch(Queue, Count, Posted);
+}
+
+static uint32_t NotifyWorkerProc(void* Argument)
+{
+	NOTIFY_QUEUE* Queue = Argument;
+
+	while (true)
+	{
+		// Looked at before draining. Once it is set, nothing more can be posted, so this drain is the last one needed.
+		bool Stopping = (PlatformLoad(&Queue->Stopping) != 0);
+
+		PlatformStore(&Queue->WakePending, 0);
+
+		DrainQueue(Queue);
+
+		if (Stopping)
+		{
+			break;
+		}
+
+		PlatformEventWait(Queue->Wake, NOTIFY_FLUSH_MILLISECONDS);
+	}
+
+	return(0);
+}
+
+// Starts the worker thread. Returns NULL if it couldn't be started, or there wasn't enough memory for the queue.
+NOTIFY_QUEUE* NotifyQueueStart(NOTIFY_SINK Sink, void* Context)
+{
+	NOTIFY_QUEUE* Queue = PlatformAllocate(sizeof(NOTIFY_QUEUE));
+
+	if (Queue == NULL)
+	{
+		return(NULL);
+	}
+
+	for (int32_t Slot = 0; Slot < NOTIFY_QUEUE_SIZE; Slot++)
+	{
+		Queue->Slots[Slot].Sequence = Slot;
+	}
+
+	Queue->Sink = Sink;
+
+	Queue->Context = Context;
+
+	if ((Queue->Wake = PlatformEventCreate()) == NULL || (Queue->Worker = PlatformStartThread(NotifyWorkerProc, Queue)) == NULL)
+	{
+		PlatformEventDestroy(Queue->Wake);
+
+		PlatformFree(Queue);
+
+		return(NULL);
+	}
+
+	return(Queue);
+}
+
+/*
+Posts a record of a password change, and returns straight away; the sink gets it later, on the worker thread. Name is cut off
+after NOTIFY_NAME_LENGTH characters. Safe to call from any number of threads at once, and while the queue is being stopped,
+but not once NotifyQueueStop has returned.
+
+*/
+NOTIFY_POST_STATUS NotifyQueuePost(NOTIFY_QUEUE* Queue, uint32_t RelativeId, const uint16_t* Name, size_t NameLength)
+{
+	NOTIFY_POST_STATUS Status = NotifyPosted;
+
+	NOTIFY_SLOT* Slot = NULL;
+
+	// Counted before Closing is looked at, so that NotifyQueueStop either sees this post and waits for it, or this post sees
+	// that the queue is closing.
+	PlatformIncrement(&Queue->Posters);
+
+	if (PlatformLoad(&Queue->Closing) != 0)
+	{
+		Status = NotifyQueueClosed;
+
+		goto End;
+	}
+
+	int32_t Position = PlatformLoad(&Queue->Head);
+
+	while (true)
+	{
+		Slot = &Queue->Slots[Position & (NOTIFY_QUEUE_SIZE - 1)];
+
+		int32_t Difference = (int32_t)((uint32_t)PlatformLoad(&Slot->Sequence) - (uint32_t)Position);
+
+		if (Difference == 0)
+		{
+			int32_t Seen = PlatformCompareExchange(&Queue->Head, (int32_t)((uint32_t)Position + 1), Position);
+
+			if (Seen == Position)
+			{
+				break;
+			}
+
+			Position = Seen;
+		}
+		else if (Difference < 0)
+		{
+			// The worker hasn't freed this slot yet: the queue is full.
+			PlatformIncrement(&Queue->Dropped);
+
+			Status = NotifyQueueFull;
+
+			goto End;
+		}
+		else
+		{
+			// Another post got here first.
+			Position = PlatformLoad(&Queue->Head);
+		}
+	}
+
+	if (NameLength > NOTIFY_NAME_LENGTH)
+	{
+		NameLength = NOTIFY_NAME_LENGTH;
+	}
+
+	Slot->Record.Timestamp = PlatformTimestamp();
+
+	Slot->Record.Count = 0;
+
+	Slot->Record.Kind = NotifyPasswordChanged;
+
+	Slot->Record.RelativeId = RelativeId;
+
+	Slot->Record.ThreadId = PlatformThreadId();
+
+	Slot->Record.NameLength = (Name != NULL) ? (uint16_t)NameLength : 0;
+
+	if (Name != NULL && NameLength > 0)
+	{
+		memcpy(Slot->Record.Name, Name, NameLength * sizeof(uint16_t));
+	}
+
+	// Only now may the worker have it.
+	PlatformStore(&Slot->Sequence, (int32_t)((uint32_t)Position + 1));
+
+	PlatformAdd64(&Queue->Posted, 1);
+
+	// A batch's worth is waiting, so there's no point in the worker sleeping out the rest of NOTIFY_FLUSH_MILLISECONDS.
+	if ((int32_t)((uint32_t)Position + 1 - (uint32_t)PlatformLoad(&Queue->Tail)) >= NOTIFY_BATCH_SIZE && PlatformCompareExchange(&Queue->WakePending, 1, 0) == 0)
+	{
+		PlatformEventSet(Queue->Wake);
+	}
+
+End:
+
+	PlatformDecrement(&Queue->Posters);
+
+	return(Status);
+}
+
+void NotifyQueueCounts(NOTIFY_QUEUE* Queue, NOTIFY_QUEUE_COUNTS* Counts)
+{
+	Counts->Posted = (uint64_t)PlatformAdd64(&Queue->Posted, 0);
+
+	Counts->Dropped = (uint32_t)PlatformLoad(&Queue->Dropped);
+
+	Counts->Written = (uint64_t)PlatformAdd64(&Queue->Written, 0);
+
+	Counts->Failed = (uint64_t)PlatformAdd64(&Queue->Failed, 0);
+
+	Counts->Batches = (uint64_t)PlatformAdd64(&Queue->Batches, 0);
+}
+
+// Hands everything that was posted to the sink, stops the worker and frees the queue. Queue may be NULL. If Counts isn't
+// NULL, it gets the final counts, which can't be asked for any more once the queue is gone.
+void NotifyQueueStop(NOTIFY_QUEUE* Queue, NOTIFY_QUEUE_COUNTS* Counts)
+{
+	if (Queue == NULL)
+	{
+		return;
+	}
+
+	PlatformStore(&Queue->Closing, 1);
+
+	// A post that got in before the queue closed must be finished before the last drain, or it would be left behind.
+	while (PlatformLoad(&Queue->Posters) != 0)
+	{
+		PlatformSleep(0);
+	}
+
+	PlatformStore(&Queue->Stopping, 1);
+
+	PlatformEventSet(Queue->Wake);
+
+	PlatformJoinThread(Queue->Worker);
+
+	if (Counts != NULL)
+	{
+		NotifyQueueCounts(Queue, Counts);
+	}
+
+	PlatformEventDestroy(Queue->Wake);
+
+	PlatformFree(Queue);
+}
@@ -0,0 +1,97 @@
+// Please read NotifyQueue.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+// Longer account names are cut off. A sAMAccountName is at most 20 characters, and this leaves room for a UPN.
+#define NOTIFY_NAME_LENGTH 64
+
+// Records the queue holds before it turns new ones away. A power of two.
+#define NOTIFY_QUEUE_SIZE 1024
+
+// Records handed to the sink at once, at most.
+#define NOTIFY_BATCH_SIZE 64
+
+// Records wait at most this long for a batch to fill up before they are handed over anyway.
+#define NOTIFY_FLUSH_MILLISECONDS 1000
+
+typedef enum NOTIFY_RECORD_KIND
+{
+	// RelativeId and Name are the user whose password was changed.
+	NotifyPasswordChanged = 1,
+
+	// Count records were turned away because the queue was full, somewhere between the record before this one and the one after.
+	NotifyRecordsDropped = 2
+
+} NOTIFY_RECORD_KIND;
+
+typedef struct NOTIFY_RECORD
+{
+	// PlatformTimestamp() ticks, taken as the record was posted.
+	uint64_t Timestamp;
+
+	uint64_t Count;
+
+	uint32_t Kind;
+
+	uint32_t RelativeId;
+
+	uint32_t ThreadId;
+
+	uint16_t NameLength;
+
+	// Not null-terminated.
+	uint16_t Name[NOTIFY_NAME_LENGTH];
+
+} NOTIFY_RECORD;
+
+// Writes a batch of records out, on the queue's worker thread. Returns false if they could not be written, which loses them.
+typedef bool (*NOTIFY_SINK)(void* Context, const NOTIFY_RECORD* Records, uint32_t Count);
+
+typedef enum NOTIFY_POST_STATUS
+{
+	NotifyPosted,
+
+	// The queue was full. The record was dropped and counted.
+	NotifyQueueFull,
+
+	// The queue is being stopped.
+	NotifyQueueClosed
+
+} NOTIFY_POST_STATUS;
+
+typedef struct NOTIFY_QUEUE_COUNTS
+{
+	uint64_t Posted;
+
+	uint64_t Dropped;
+
+	// Records the sink took, and the ones it failed to write.
+	uint64_t Written;
+
+	uint64_t Failed;
+
+	uint64_t Batches;
+
+} NOTIFY_QUEUE_COUNTS;
+
+typedef struct NOTIFY_QUEUE NOTIFY_QUEUE;
+
+NOTIFY_QUEUE* NotifyQueueStart(NOTIFY_SINK Sink, void* Context);
+
+NOTIFY_POST_STATUS NotifyQueuePost(NOTIFY_QUEUE* Queue, uint32_t RelativeId, const uint16_t* Name, size_t NameLength);
+
+void NotifyQueueCounts(NOTIFY_QUEUE* Queue, NOTIFY_QUEUE_COUNTS* Counts);
+
+void NotifyQueueStop(NOTIFY_QUEUE* Queue, NOTIFY_QUEUE_COUNTS* Counts);
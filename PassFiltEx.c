@@ -41,10 +41,16 @@ Operation:
     need to check for password length, password complexity, password age, etc., because those things are already checked for using the in-box Windows password policy.
 
   - If a password contains any of the character sequences in the blacklist, *and* the blacklisted character sequence makes at least 50% of the password, then the password is rejected.
+    The share can be changed for the whole list with a line "!coverage 60", and for one token with "!rule 30 contoso" or "!rule exact summer" (only the
+    whole password). A line "!combined 80" also rejects a password that two or more tokens together make up at least 80% of. See Blacklist.c.
+
+  - A line "!strength 8" also rejects passwords that would take fewer than 10^8 guesses to crack: keyboard walks, sequences, repeats, dates, and
+    blacklisted strings with those around them, such as Summer2019! or qwertyuiop. See Strength.c.
 
   - Comparisons are NOT case sensitive.
 
-  - The blacklist is reloaded every 60 seconds, so feel free to edit the blacklist file at will. The password filter will read the new updates within a minute.
+  - The blacklist is reloaded as soon as it changes, so feel free to edit the blacklist file at will. The password filter will read the new updates within a second of the file
+    being saved. (If System32 can't be watched for changes, it falls back to checking the files every 60 seconds.)
 
   - No Unicode support at this time. Everything is ASCII/ANSI. (You can still use Unicode characters in your passwords, but Unicode characters will not match against anything in the blacklist.)
 
@@ -53,11 +59,36 @@ Operation:
   - For example, if the blacklist contains the token "abc", then the passwords abc and abc123 and AbC123 and 123Abc will all be rejected. But Abc123! will be accepted, because the token abc 
     does not make up half (50%) of the full password or more.
 
+  - The same goes for the user's own names: any part of the account name or the full name of three characters or more (split on commas, periods, dashes,
+    underscores, spaces, pound signs and tabs, as Windows does), or the whole account name, that makes up at least half of the password gets it rejected.
+    So jsmith can't use JSmith2024!, even without the Windows complexity rule turned on.
+
   - Question: Why don't you store the blacklist file in SYSVOL? Answer: Might add that later. For now, I was concerned that having the blacklist file available for all Authenticated Users
     to read might pose a security threat, as it gives potential attackers a lot of information about which passwords you blacklist. For example, a hacker could feed your blacklist into his
 	or her password cracker so that the password cracker would not attempt any blacklisted passwords, which would save the hacker time and give them fewer passwords to search for.
 	So for now you'll need to copy the blacklist file to each DC and update it on each DC.
 
+  - Big blacklists can be compiled ahead of time with PassFiltExTool: PassFiltExTool compile PassFiltExBlacklist.txt PassFiltExBlacklist.bin
+    Copy PassFiltExBlacklist.bin into System32 next to the text file and the password filter will map it instead of parsing the text file. The image is
+	checked (CRC and table validation) before it is used, and if it is missing or damaged, the text file is used as before. PassFiltExTool verify
+	checks an image against its text file, and optionally against a list of passwords.
+
+  - Lines added to the end of the text file (echo newtoken >> PassFiltExBlacklist.txt) are loaded on their own, in milliseconds, without parsing
+    and compiling the rest of the file again. Any other change to the file, or a directive among the new lines, still reloads all of it. Once
+    enough lines have been added, or the file has been left alone for ten minutes, the whole list is rebuilt in the background to keep matching fast.
+
+  - PassFiltExBlacklist.txt can be gzipped as it is (gzip -c list.txt > PassFiltExBlacklist.txt), so a breach list that is gigabytes of text
+    takes a fraction of that to copy to every DC. It is decompressed as it is parsed, a few megabytes at a time, and never written out. A gzipped
+    list is always reloaded in full, and a damaged one is rejected and the previous list kept. zstd is not supported. PassFiltExTool stream-bench
+    checks that a gzipped list loads the same as its text.
+
+  - Optionally, passwords can also be checked against a list of known breached passwords, such as the NTLM hash list from Have I Been Pwned.
+    Build an index with PassFiltExTool breach-build pwned-passwords-ntlm-ordered-by-hash.txt PassFiltExBreached.bin and copy it into System32.
+	Any password whose NT hash is in the index is rejected outright. This is an exact, case-sensitive match, unlike the blacklist. The index
+	is memory-mapped, not loaded, so even hundreds of millions of hashes cost almost no memory. Delete the file to turn the check off.
+	The index carries a Bloom filter (about 1.25 bytes per hash by default; see breach-build --filter-bits) that turns away almost every
+	password that isn't in it without touching the rest of the file.
+
 Debugging:
 
   - The password filter utilizes Event Tracing for Windows (ETW). ETW is fast, lightweight, and there is no concern over managing text-based log files which are slow and consume disk space.
@@ -75,6 +106,28 @@ Debugging:
     (There are other tools that understand ETW as well. Use what you like.) Add the "payload" as a Column, and decode the payload column as Unicode. 
 	Then it should look like a normal, human-readable text log.
 
+  - To see how fast the password filter is without a domain controller, build PassFiltExTool (it builds anywhere with a C11 compiler) and run
+    PassFiltExTool bench. It runs the very code that PasswordFilter runs against generated blacklists of up to 10 million lines and reports
+	load times and p50/p99/p99.9 latency. Compare the numbers before and after a change, before rolling out a new DLL.
+	PassFiltExTool storm does the same with many threads at once while the blacklist is reloaded in the background, and prints CSV.
+
+  - Nothing is formatted unless a trace session is listening. The message for each password checked is written as a small binary event
+    and only turned into text on the blacklist thread, about once a second, so it can show up in the trace a moment after the rest.
+	PassFiltExTool trace-bench shows what tracing costs with and without a session.
+
+  - Counters are kept all the time, without a trace, in PassFiltExStats.bin next to the blacklist: password checks, SETs and CHANGEs,
+    verdicts, a latency histogram, blacklist and breach index reloads, and how often each blacklisted token caused a rejection.
+	Run PassFiltExTool stats C:\Windows\System32\PassFiltExStats.bin [--histogram] at any time to see them. They start from zero
+	whenever lsass loads the DLL.
+
+  - PasswordFilter doesn't allocate. Each password is copied into one of 64 buffers set aside and locked into memory when the DLL is
+    loaded, and wiped as soon as it has been judged. PassFiltExTool alloc-check proves it, by counting allocations around a run of checks.
+
+  - Every password change is written to PassFiltExChanges.txt next to the blacklist, one line with the time, the RID and the user name, never
+    the password. PasswordChangeNotify only posts it to a queue and returns; a thread of its own writes the lines out, up to 64 at a time.
+	If the disk falls so far behind that the queue fills up, changes are dropped rather than hold up LSA, and a "dropped" line says how many.
+	The file is renamed to PassFiltExChanges.old once it reaches 16 MB. PassFiltExTool notify-check shows what posting costs.
+
 Coding Guidelines:
 
   - Want to contibute? Cool! I'd like to stick to these rules:
@@ -123,6 +176,44 @@ Coding Guidelines:
 
 #pragma warning(pop)
 
+#include "AhoCorasick.h"
+
+#include "Blacklist.h"
+
+#include "BlacklistDelta.h"
+
+#include "BlacklistImage.h"
+
+#include "BlacklistStream.h"
+
+#include "BreachIndex.h"
+
+#include "FileWatch.h"
+
+#include "FuzzyMatch.h"
+
+#include "NotifyQueue.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#include "SnapshotGuard.h"
+
+#include "Stats.h"
+
+#include "Strength.h"
+
+#include "TokenDawg.h"
+
+#include "TokenStore.h"
+
+#include "Trace.h"
+
+#include "WorkerPool.h"
+
 #include "PassFiltEx.h"
 
 
@@ -131,15 +222,44 @@ REGHANDLE gEtwRegHandle;
 
 HANDLE gBlacklistThread;
 
-CRITICAL_SECTION gBlacklistCritSec;
+// PasswordFilter only ever reads from this. See AcquireBlacklistSnapshot.
+BLACKLIST_SNAPSHOT* volatile gBlacklistSnapshot;
+
+// Covers both gBlacklistSnapshot and gBreachSnapshot.
+SNAPSHOT_GUARD gSnapshotGuard;
+
+// NULL unless a breach index is installed. Read under the same reader registration as gBlacklistSnapshot.
+BREACH_SNAPSHOT* volatile gBreachSnapshot;
 
-BADSTRING* gBlacklistHead;
+FILETIME gBreachIndexFileTime;
 
 FILETIME gBlackListOldFileTime;
 
 FILETIME gBlackListNewFileTime;
 
-LARGE_INTEGER gPerformanceFrequency;
+// Whether gBlackListOldFileTime belongs to the image or to the text file.
+BOOL gBlacklistFromImage;
+
+// An image that failed validation is not looked at again until it changes.
+FILETIME gRejectedImageFileTime;
+
+// When lines appended to the text file were last put into effect. See BlacklistCompactionDue.
+uint64_t gBlacklistAppendedAt;
+
+// Set while ReloadBlacklistIfChanged is to rebuild the text file from scratch, whether or not lines were only appended to it.
+BOOL gCompactBlacklist;
+
+// The last compaction failed, so the overlay is left as it is until the file has been left alone for a while.
+BOOL gBlacklistCompactionFailed;
+
+// Always-on counters. See OpenStatsSegment. NULL only if there wasn't even enough memory for a private copy.
+STATS_SEGMENT* gStats;
+
+// Where PasswordFilter copies each password to. See ScratchPool.c.
+SCRATCH_POOL gScratchPool;
+
+// Takes what PasswordChangeNotify has to do off LSA's thread. NULL if it couldn't be started. See WriteNotifyRecords.
+NOTIFY_QUEUE* gNotifyQueue;
 
 /*
 DllMain
@@ -149,6 +269,9 @@ https://msdn.microsoft.com/en-us/library/windows/desktop/ms682583(v=vs.85).aspx
 
 The only winning move is not to play.
 
+That includes stopping gNotifyQueue. Waiting for its worker thread to finish under the loader lock would hang, and lsass
+doesn't unload password filters while it runs anyway. Whatever is still queued when lsass exits is lost with it.
+
 */
 BOOL WINAPI DllMain(_In_ HINSTANCE DLLHandle, _In_ DWORD Reason, _In_ LPVOID Reserved)
 {
@@ -195,21 +318,36 @@ __declspec(dllexport) BOOL CALLBACK InitializeChangeNotify(void)
 {
 	const GUID ETWProviderGuid = { 0x07d83223, 0x7594, 0x4852, { 0xba, 0xbc, 0x78, 0x48, 0x03, 0xfd, 0xf6, 0xc5 } };	
 	
-	if (EventRegister(&ETWProviderGuid, NULL, NULL, &gEtwRegHandle) != ERROR_SUCCESS)
+	if (EventRegister(&ETWProviderGuid, EtwEnableCallback, NULL, &gEtwRegHandle) != ERROR_SUCCESS)
 	{
 		return(FALSE);
 	}
 
 	EventWriteStringW2(L"[%s:%s@%d] ETW provider registered.", __FILENAMEW__, __FUNCTIONW__, __LINE__);
 
-#pragma warning(push)
-#pragma warning(disable: 6031) 
-	// MSDN states that this call never fails so no need to bother with the return value.
-	InitializeCriticalSectionAndSpinCount(&gBlacklistCritSec, 4000);
-	
-	// Same as above.
-	QueryPerformanceFrequency(&gPerformanceFrequency);
-#pragma warning(pop)	
+	gStats = OpenStatsSegment();
+
+	// If this fails, PasswordFilter still works; it just copies every password to the heap, as it used to.
+	if (ScratchPoolInitialize(&gScratchPool) == false)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Not enough memory for the scratch pool! Password copies will come from the heap.", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+	}
+	else if (gScratchPool.Locked == false)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] The scratch pool could not be locked into memory. Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, GetLastError());
+	}
+
+	// Without it, PasswordChangeNotify still traces every change; it just can't write them to the spool file.
+	if ((gNotifyQueue = NotifyQueueStart(WriteNotifyRecords, NULL)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to start the password change queue! Changes won't be written to %s.", __FILENAMEW__, __FUNCTIONW__, __LINE__, NOTIFY_SPOOL_FILENAME);
+	}
+
+	// Started before the thread that loads the blacklist, so that the events about the first load are passed on as they come.
+	if (TraceStartDrain(TraceEventToEtw, NULL, TRACE_DRAIN_FREQUENCY) == false)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] WARNING: Failed to start the trace drain thread! Typed trace events won't reach ETW.", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+	}
 
 	if ((gBlacklistThread = CreateThread(NULL, 0, BlacklistThreadProc, NULL, 0, NULL)) == NULL)
 	{
@@ -265,21 +403,23 @@ Structured exception handling should be used when appropriate.
 */
 __declspec(dllexport) NTSTATUS CALLBACK PasswordChangeNotify(_In_ PUNICODE_STRING UserName, _In_ ULONG RelativeId, _In_ PUNICODE_STRING NewPassword)
 {
-	UNREFERENCED_PARAMETER(UserName);
-
-	UNREFERENCED_PARAMETER(RelativeId);
-
 	UNREFERENCED_PARAMETER(NewPassword);
 
-	// UNICODE_STRINGs are usually not null-terminated.
-	// Let's make a null-terminated copy of it. sAMAccountNames can't be very long
-	// so I think we're safe with this buffer size.
+	const uint64_t Values[TRACE_VALUE_COUNT] = { RelativeId, 0, 0, 0 };
 
-	wchar_t UserNameCopy[128] = { 0 };
+	const uint16_t* Name = (UserName != NULL) ? (const uint16_t*)UserName->Buffer : NULL;
 
-	memcpy(&UserNameCopy, UserName->Buffer, UserName->Length);
+	size_t NameLength = (UserName != NULL) ? UserName->Length / sizeof(wchar_t) : 0;
 
-	EventWriteStringW2(L"[%s:%s@%d] Password for %s (RID %lu) was changed.", __FILENAMEW__, __FUNCTIONW__, __LINE__, UserNameCopy, RelativeId);
+	// The name is copied into the event as it is, so there's no need for a null-terminated copy of it here.
+	TraceWrite(TraceEventPasswordChanged, Values, Name, NameLength);
+
+	// Writing the change to the spool file is left to the queue's worker; LSA is held up only as long as it takes to post it.
+	// A queue that is full turns the record away and the worker notes the gap in the file, rather than keep LSA waiting.
+	if (gNotifyQueue != NULL)
+	{
+		NotifyQueuePost(gNotifyQueue, RelativeId, Name, NameLength);
+	}
 
 	return(STATUS_SUCCESS);
 }
@@ -326,101 +466,147 @@ Any process exception that is not handled within this function may cause securit
 */
 __declspec(dllexport) BOOL CALLBACK PasswordFilter(_In_ PUNICODE_STRING AccountName, _In_ PUNICODE_STRING FullName, _In_ PUNICODE_STRING Password, _In_ BOOL SetOperation)
 {
-	UNREFERENCED_PARAMETER(FullName);
-
 	BOOL PasswordIsOK = TRUE;
 
-	LARGE_INTEGER StartTime = { 0 };
+	int32_t ReaderSlot = 0;
 
-	LARGE_INTEGER EndTime = { 0 };
+	BLACKLIST_SNAPSHOT* Snapshot = AcquireBlacklistSnapshot(&ReaderSlot);
 
-	LARGE_INTEGER ElapsedMicroseconds = { 0 };
+	BREACH_SNAPSHOT* Breach = gBreachSnapshot;
 
-	EnterCriticalSection(&gBlacklistCritSec);
+	uint64_t StartTime = PlatformTimestamp();
 
-	QueryPerformanceCounter(&StartTime);
-
-	BADSTRING* CurrentNode = gBlacklistHead;
+	if (Snapshot == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] No blacklist is loaded.", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+	}
 
-	// UNICODE_STRINGs are usually not null-terminated.
-	// Let's make a null-terminated copy of it. sAMAccountNames can't be very long
-	// so I think we're safe with this buffer size.
+	// The checks themselves live in PasswordCheck.c, where PassFiltExTool can time them too.
+	PLATFORM_STRING PasswordString = { Password->Length, Password->MaximumLength, (const uint16_t*)Password->Buffer };
 
-	wchar_t AccountNameCopy[128] = { 0 };
+	// The names are looked for in the same pass over the password as the blacklist. See NameMatch.c.
+	PLATFORM_STRING AccountNameString = { AccountName->Length, AccountName->MaximumLength, (const uint16_t*)AccountName->Buffer };
 
-	memcpy(&AccountNameCopy, AccountName->Buffer, AccountName->Length);
+	PLATFORM_STRING FullNameString = { 0 };
 
-	if (SetOperation)
+	if (FullName != NULL)
 	{
-		EventWriteStringW2(L"[%s:%s@%d] SET password for user %s.", __FILENAMEW__, __FUNCTIONW__, __LINE__, AccountNameCopy);
+		FullNameString.Length = FullName->Length;
+
+		FullNameString.MaximumLength = FullName->MaximumLength;
+
+		FullNameString.Buffer = (const uint16_t*)FullName->Buffer;
 	}
-	else
-	{
-		EventWriteStringW2(L"[%s:%s@%d] CHANGE password for user %s.", __FILENAMEW__, __FUNCTIONW__, __LINE__, AccountNameCopy);
-	}	
 
-	wchar_t* PasswordCopy = NULL;
-	
-	if ((PasswordCopy = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Password->MaximumLength)) == NULL)
+	uint32_t MatchedPattern = AC_NO_PATTERN;
+
+	PASSWORD_VERDICT Verdict = PasswordCheck((Snapshot != NULL) ? Snapshot->Automaton : NULL, (Snapshot != NULL) ? Snapshot->Overlay : NULL, (Breach != NULL) ? &Breach->Index : NULL, &gScratchPool, &PasswordString, &AccountNameString, &FullNameString, &MatchedPattern);
+
+	// Rejections are rare, and the messages below are only formatted while a trace session is listening (see EventWriteStringW2.)
+	switch (Verdict)
 	{
-		EventWriteStringW2(L"[%s:%s@%d] Error allocating memory! Cannot change password!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+		case PasswordAccepted:
+		{
+			break;
+		}
+		case PasswordBreached:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Rejecting password because it appears in the breached password index!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
 
-		PasswordIsOK = FALSE;
+			PasswordIsOK = FALSE;
 
-		goto End;
-	}
+			break;
+		}
+		case PasswordBlacklisted:
+		{
+			uint8_t MatchedToken[TOKEN_DAWG_MAX_LENGTH];
 
-	memcpy(PasswordCopy, Password->Buffer, Password->Length);
+			uint32_t MatchedLength = BlacklistDeltaToken(&Snapshot->Tokens, &Snapshot->OverlayTokens, MatchedPattern, MatchedToken);
 
-	for (unsigned int Counter = 0; Counter < wcslen(PasswordCopy) - 1; Counter++)
-	{
-		PasswordCopy[Counter] = towlower(PasswordCopy[Counter]);
-	}	
+			EventWriteStringW2(L"[%s:%s@%d] Rejecting password because it contains the blacklisted string \"%.*hs\" and it makes up enough of the full password!", __FILENAMEW__, __FUNCTIONW__, __LINE__, MatchedLength, MatchedToken);
 
-	while (CurrentNode->Next != NULL)
-	{
-		CurrentNode = CurrentNode->Next;
+			StatsRecordTokenHit(gStats, MatchedToken, MatchedLength);
 
-		if (wcslen(CurrentNode->String) == 0)
+			PasswordIsOK = FALSE;
+
+			break;
+		}
+		case PasswordNearlyBlacklisted:
 		{
-			EventWriteStringW2(L"[%s:%s@%d] ERROR: This blacklist token is 0 characters long. It will be skipped. Check your blacklist file for blank lines!", __FILENAMEW__, __FUNCTIONW__, __LINE__, CurrentNode->String);
+			uint8_t MatchedToken[TOKEN_DAWG_MAX_LENGTH];
+
+			uint32_t MatchedLength = BlacklistDeltaToken(&Snapshot->Tokens, &Snapshot->OverlayTokens, MatchedPattern, MatchedToken);
+
+			EventWriteStringW2(L"[%s:%s@%d] Rejecting password because part of it is within %u edits of the blacklisted string \"%.*hs\" and it makes up enough of the full password!", __FILENAMEW__, __FUNCTIONW__, __LINE__, (unsigned)Snapshot->Automaton->EditDistance, MatchedLength, MatchedToken);
 
-			continue;
+			StatsRecordTokenHit(gStats, MatchedToken, MatchedLength);
+
+			PasswordIsOK = FALSE;
+
+			break;
 		}
+		case PasswordContainsName:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Rejecting password because it contains part of the user's account name or full name and it is at least half of the full password!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+
+			PasswordIsOK = FALSE;
 
-		if (wcsstr(PasswordCopy, CurrentNode->String))
+			break;
+		}
+		case PasswordBlacklistedTogether:
 		{
-			if (((float)wcslen(CurrentNode->String) / (float)wcslen(PasswordCopy)) >= 0.50f)
-			{
-				EventWriteStringW2(L"[%s:%s@%d] Rejecting password because it contains the blacklisted string \"%s\" and it is at least half of the full password!", __FILENAMEW__, __FUNCTIONW__, __LINE__, CurrentNode->String);
+			uint8_t MatchedToken[TOKEN_DAWG_MAX_LENGTH];
 
-				PasswordIsOK = FALSE;
+			uint32_t MatchedLength = BlacklistDeltaToken(&Snapshot->Tokens, &Snapshot->OverlayTokens, MatchedPattern, MatchedToken);
 
-				break;
-			}
+			EventWriteStringW2(L"[%s:%s@%d] Rejecting password because blacklisted strings, the longest of them \"%.*hs\", together make up at least %u%% of the full password!", __FILENAMEW__, __FUNCTIONW__, __LINE__, MatchedLength, MatchedToken, (unsigned)Snapshot->Automaton->CombinedCoverage);
+
+			StatsRecordTokenHit(gStats, MatchedToken, MatchedLength);
+
+			PasswordIsOK = FALSE;
+
+			break;
 		}
-	}
+		case PasswordAcceptedOverBudget:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] WARNING: Gave up looking for blacklisted strings with typos after %u trie states. The password was only checked for exact matches.", __FILENAMEW__, __FUNCTIONW__, __LINE__, (unsigned)FUZZY_STATE_BUDGET);
+
+			break;
+		}
+		case PasswordTooGuessable:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Rejecting password because it would take fewer than 10^%u guesses to crack!", __FILENAMEW__, __FUNCTIONW__, __LINE__, (unsigned)Snapshot->Automaton->MinimumStrength);
+
+			PasswordIsOK = FALSE;
 
-	End:
+			break;
+		}
+		case PasswordStrengthOverBudget:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] WARNING: Gave up estimating how easy the password is to guess after %u steps. It was accepted on what had been found by then.", __FILENAMEW__, __FUNCTIONW__, __LINE__, (unsigned)STRENGTH_WORK_BUDGET);
 
-	QueryPerformanceCounter(&EndTime);
+			break;
+		}
+		default:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Error allocating memory! Cannot change password!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
 
-	ElapsedMicroseconds.QuadPart = EndTime.QuadPart - StartTime.QuadPart;
+			PasswordIsOK = FALSE;
 
-	ElapsedMicroseconds.QuadPart *= 1000000;
+			break;
+		}
+	}
 
-	ElapsedMicroseconds.QuadPart /= gPerformanceFrequency.QuadPart;
+	uint64_t EndTime = PlatformTimestamp();
 
-	EventWriteStringW2(L"[%s:%s@%d] Finished in %llu microseconds.", __FILENAMEW__, __FUNCTIONW__, __LINE__, ElapsedMicroseconds.QuadPart);
+	StatsRecordPassword(gStats, Verdict, SetOperation != FALSE, PlatformElapsedNanoseconds(StartTime, EndTime));
 
-	if (PasswordCopy != NULL)
-	{
-		SecureZeroMemory(PasswordCopy, Password->Length);
+	// Every password ends up here, so this is a typed event rather than a message. TraceEventToEtw formats it later, on Trace.c's drain thread.
+	const uint64_t Values[TRACE_VALUE_COUNT] = { (uint64_t)Verdict, SetOperation ? 1 : 0, MatchedPattern, PlatformElapsedMicroseconds(StartTime, EndTime) };
 
-		HeapFree(GetProcessHeap(), 0, PasswordCopy);
-	}	
+	TraceWrite(TraceEventPasswordChecked, Values, (const uint16_t*)AccountName->Buffer, AccountName->Length / sizeof(wchar_t));
 
-	LeaveCriticalSection(&gBlacklistCritSec);
+	ReleaseBlacklistSnapshot(ReaderSlot);
 
 	return(PasswordIsOK);
 }
@@ -429,183 +615,1190 @@ DWORD WINAPI BlacklistThreadProc(_In_ LPVOID Args)
 {
 	UNREFERENCED_PARAMETER(Args);
 
+	// In the same order as the bits FileWatchWait returns for them.
+	static const char* const FileNames[] = { BLACKLIST_IMAGE_FILE, BLACKLIST_FILE, BREACH_INDEX_FILE };
+
+	const uint32_t BlacklistFiles = 0x1 | 0x2;
+
+	const uint32_t BreachIndexFile = 0x4;
+
+	FILE_WATCH Watch;
+
+	// Everything is loaded once at startup, whether or not it has changed.
+	uint32_t Due = BlacklistFiles | BreachIndexFile;
+
+	// We are being loaded by lsass.exe, and its current working directory is where the files are.
+	if (FileWatchStart(&Watch, ".", FileNames, sizeof(FileNames) / sizeof(FileNames[0]), BLACKLIST_DEBOUNCE_MILLISECONDS, BLACKLIST_THREAD_RUN_FREQUENCY) == false)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Unable to watch the current directory for changes! Error 0x%08lx. Checking the files every %d seconds instead.", __FILENAMEW__, __FUNCTIONW__, __LINE__, GetLastError(), BLACKLIST_THREAD_RUN_FREQUENCY / 1000);
+	}
+
 	while (TRUE)
 	{
-		HANDLE BlacklistFileHandle = INVALID_HANDLE_VALUE;
+		bool WatchFailed = Watch.WatchFailed;
+
+		if (Due != 0)
+		{
+			uint64_t StartTime = PlatformTimestamp();
 
-		LARGE_INTEGER StartTime = { 0 };
+			// A compiled image is preferred. The text file is only read when there is no image, or the image is no good. The
+			// pair is looked at together whichever of the two has changed, because a change to one can decide which is used.
+			if ((Due & BlacklistFiles) != 0 && ReloadBlacklistIfChanged(BLACKLIST_IMAGE_FILENAME, TRUE) == FALSE)
+			{
+				ReloadBlacklistIfChanged(BLACKLIST_FILENAME, FALSE);
+			}
 
-		LARGE_INTEGER EndTime = { 0 };
+			if ((Due & BreachIndexFile) != 0)
+			{
+				ReloadBreachIndexIfChanged();
+			}
 
-		LARGE_INTEGER ElapsedMicroseconds = { 0 };
+			EventWriteStringW2(L"[%s:%s@%d] Finished in %llu microseconds, after %llu change notifications in all.", __FILENAMEW__, __FUNCTIONW__, __LINE__, PlatformElapsedMicroseconds(StartTime, PlatformTimestamp()), Watch.Notifications);
+		}
 
-		EnterCriticalSection(&gBlacklistCritSec);
+		// PasswordFilter goes on using the overlay while the whole list is rebuilt.
+		if (BlacklistCompactionDue())
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Compacting %lu appended tokens into a new blacklist.", __FILENAMEW__, __FUNCTIONW__, __LINE__, gBlacklistSnapshot->OverlayTokens.TokenCount);
 
-		QueryPerformanceCounter(&StartTime);
+			gCompactBlacklist = TRUE;
 
-		// We are being loaded by lsass.exe. The current working directory of lsass should be C:\Windows\System32			
+			ReloadBlacklistIfChanged(BLACKLIST_FILENAME, FALSE);
 
-		if ((BlacklistFileHandle = CreateFile(BLACKLIST_FILENAME, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
-		{
-			EventWriteStringW2(L"[%s:%s@%d] Unable to open %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, GetLastError());
+			gCompactBlacklist = FALSE;
 
-			goto Sleep;
+			gBlacklistCompactionFailed = gBlacklistSnapshot->Appended;
+
+			gBlacklistAppendedAt = PlatformTimestamp();
+		}
+
+		// Trace events are passed on to ETW by Trace.c's own drain thread, so there is nothing to wake up for here but the files
+		// and the compaction check.
+		Due = FileWatchWait(&Watch, BLACKLIST_THREAD_RUN_FREQUENCY);
+
+		if (Watch.WatchFailed && WatchFailed == false)
+		{
+			EventWriteStringW2(L"[%s:%s@%d] WARNING: The current directory can no longer be watched for changes. Checking the files every %d seconds instead.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_THREAD_RUN_FREQUENCY / 1000);
 		}
 
-		EventWriteStringW2(L"[%s:%s@%d] %s opened for read.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME);
+		ReportDroppedTraceEvents();
+	}
+
+	return(0);
+}
+
+/*
+ReloadBlacklistIfChanged
+------------------------
+
+Loads and publishes a new snapshot from FileName if it has changed since the last time we looked, or if the last snapshot
+came from the other kind of file. Returns TRUE if FileName is what the current blacklist came from, whether or not it had
+to be reloaded, and FALSE if it could not be opened or loaded.
+
+*/
+BOOL ReloadBlacklistIfChanged(_In_ PCWSTR FileName, _In_ BOOL IsImage)
+{
+	BOOL Result = FALSE;
+
+	HANDLE BlacklistFileHandle = INVALID_HANDLE_VALUE;
 
-		if (GetFileTime(BlacklistFileHandle, NULL, NULL, &gBlackListNewFileTime) == 0)
+	// We are being loaded by lsass.exe. The current working directory of lsass should be C:\Windows\System32
+	// The image stays mapped for as long as it is in use, so FILE_SHARE_DELETE is needed to let an administrator
+	// rename a freshly compiled image over it.
+
+	if ((BlacklistFileHandle = CreateFile(FileName, GENERIC_READ, IsImage ? (FILE_SHARE_READ | FILE_SHARE_DELETE) : (FILE_SHARE_READ | FILE_SHARE_WRITE), NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		// Not having an image is normal.
+		if (IsImage == FALSE || GetLastError() != ERROR_FILE_NOT_FOUND)
 		{
-			EventWriteStringW2(L"[%s:%s@%d] Failed to call GetFileTime on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, GetLastError());
+			EventWriteStringW2(L"[%s:%s@%d] Unable to open %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, FileName, GetLastError());
+		}
+
+		goto End;
+	}
+
+	EventWriteStringW2(L"[%s:%s@%d] %s opened for read.", __FILENAMEW__, __FUNCTIONW__, __LINE__, FileName);
+
+	if (GetFileTime(BlacklistFileHandle, NULL, NULL, &gBlackListNewFileTime) == 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call GetFileTime on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, FileName, GetLastError());
+
+		goto End;
+	}
+
+	if (IsImage && CompareFileTime(&gBlackListNewFileTime, &gRejectedImageFileTime) == 0)
+	{
+		goto End;
+	}
 
-			goto Sleep;
+	if (CompareFileTime(&gBlackListNewFileTime, &gBlackListOldFileTime) != 0 || IsImage != gBlacklistFromImage || (gCompactBlacklist && IsImage == FALSE))
+	{
+		EventWriteStringW2(L"[%s:%s@%d] %s has changed since the last time we looked. Let's reload it.", __FILENAMEW__, __FUNCTIONW__, __LINE__, FileName);
+
+		// Nobody else can see the new snapshot until it is published, so all of the slow work
+		// happens without getting in the way of PasswordFilter.
+		BLACKLIST_SNAPSHOT* NewSnapshot = NULL;
+
+		uint64_t StartTime = PlatformTimestamp();
+
+		if (IsImage)
+		{
+			NewSnapshot = LoadBlacklistImageSnapshot(BlacklistFileHandle);
+		}
+		else
+		{
+			// If all that happened to the text file was lines being added to the end, only they are loaded.
+			NewSnapshot = LoadBlacklistSnapshot(BlacklistFileHandle, (gBlacklistFromImage == FALSE && gCompactBlacklist == FALSE) ? gBlacklistSnapshot : NULL);
 		}
 
-		if (CompareFileTime(&gBlackListNewFileTime, &gBlackListOldFileTime) != 0)
+		if (NewSnapshot == NULL)
 		{
-			EventWriteStringW2(L"[%s:%s@%d] The last modified time of %s has changed since the last time we looked. Let's reload it.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME);			
+			StatsRecordBlacklistReload(gStats, false, 0, 0, 0, 0, IsImage != FALSE);
 
-			// Initialize list head if we're here for the first time.
-			if (gBlacklistHead == NULL)
+			if (IsImage)
 			{
-				if ((gBlacklistHead = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BADSTRING))) == NULL)
-				{
-					EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for list head!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+				EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to load %s! Falling back to %s until the image is replaced.", __FILENAMEW__, __FUNCTIONW__, __LINE__, FileName, BLACKLIST_FILENAME);
 
-					goto Sleep;
-				}
+				gRejectedImageFileTime = gBlackListNewFileTime;
+			}
+			else
+			{
+				EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to load %s! The previous blacklist stays in effect and we'll try again next time.", __FILENAMEW__, __FUNCTIONW__, __LINE__, FileName);
 			}
 
-			// Need to clear blacklist and free memory first.
-			BADSTRING* CurrentNode = gBlacklistHead;
+			goto End;
+		}
 
-			while (CurrentNode->Next != NULL)
-			{
-				CurrentNode = CurrentNode->Next;
+		uint64_t ElapsedMicroseconds = PlatformElapsedMicroseconds(StartTime, PlatformTimestamp());
 
-				if (HeapFree(GetProcessHeap(), 0, CurrentNode) == 0)
-				{
-					EventWriteStringW2(L"[%s:%s@%d] HeapFree failed while clearing blacklist! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, GetLastError());
+		uint32_t OverlayStates = (NewSnapshot->Overlay != NULL) ? NewSnapshot->Overlay->StateCount : 0;
 
-					goto Sleep;
-				}
-			}
+		StatsRecordBlacklistReload(gStats, true, ElapsedMicroseconds, NewSnapshot->Tokens.TokenCount + NewSnapshot->OverlayTokens.TokenCount, NewSnapshot->Automaton->StateCount + OverlayStates,
+			TokenDawgMemoryUsage(&NewSnapshot->Tokens) + AcMemoryUsage(NewSnapshot->Automaton) + TokenStoreMemoryUsage(&NewSnapshot->OverlayTokens) + ((NewSnapshot->Overlay != NULL) ? AcMemoryUsage(NewSnapshot->Overlay) : 0),
+			IsImage != FALSE);
 
-			// Create a new node for the first line of text in the file.
-			if ((CurrentNode = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BADSTRING))) == NULL)
-			{
-				EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for list node!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+		if (NewSnapshot->Appended)
+		{
+			const uint64_t Values[TRACE_VALUE_COUNT] = { NewSnapshot->OverlayTokens.TokenCount, OverlayStates, ElapsedMicroseconds, NewSnapshot->BaseLoadMicroseconds };
 
-				goto Sleep;
-			}
+			TraceWrite(TraceEventBlacklistAppended, Values, NULL, 0);
+
+			// The new snapshot owns the base from now on.
+			gBlacklistSnapshot->BaseHandedOver = TRUE;
 
-			gBlacklistHead->Next = CurrentNode;
+			gBlacklistAppendedAt = PlatformTimestamp();
+		}
+		else
+		{
+			const uint64_t Values[TRACE_VALUE_COUNT] = { NewSnapshot->Tokens.TokenCount, NewSnapshot->Automaton->StateCount, IsImage ? 1 : 0, ElapsedMicroseconds };
+
+			TraceWrite(TraceEventBlacklistLoaded, Values, NULL, 0);
+
+			NewSnapshot->BaseLoadMicroseconds = ElapsedMicroseconds;
+		}
 
-			DWORD TotalBytesRead = 0;
+		PublishBlacklistSnapshot(NewSnapshot);
 
-			DWORD BytesRead = 0;
+		gBlackListOldFileTime = gBlackListNewFileTime;
 
-			BYTE Read = 0;			
+		gBlacklistFromImage = IsImage;
+	}
 
-			DWORD BytesOnThisLine = 0;
+	Result = TRUE;
 
-			DWORD LinesRead = 1;
+End:
 
-			while (TRUE)
-			{
-				if (ReadFile(BlacklistFileHandle, &Read, 1, &BytesRead, NULL) == FALSE)
-				{
-					break;
-				}
+	if (BlacklistFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(BlacklistFileHandle);
+	}
 
-				if (BytesRead == 0)
-				{
-					break;
-				}
+	return(Result);
+}
 
-				if (BytesOnThisLine >= MAX_BLACKLIST_STRING_SIZE - 1)
-				{
-					EventWriteStringW2(L"[%s:%s@%d] WARNING: Line longer than max length of %d! Will truncate this line and attempt to resume reading the next line.", __FILENAMEW__, __FUNCTIONW__, __LINE__, MAX_BLACKLIST_STRING_SIZE);
+/*
+LoadBlacklistSnapshot
+---------------------
 
-					Read = 0x0A;
-				}
+Reads the whole blacklist file into a brand new snapshot and compiles its automaton. The snapshot is private to the
+caller until it is handed to PublishBlacklistSnapshot. Returns NULL if anything goes wrong.
 
-				// Ignore unprintable characters
-				if (Read < 0x20)
-				{
-					// Unless it's \n
-					if (Read != 0x0A)
-					{
-						TotalBytesRead++;
+If Current came from this file, and the file has only had lines added to the end of it since, the new snapshot is Current with
+those lines on top instead (see LoadAppendedBlacklistSnapshot), and its Appended is set.
 
-						continue;
-					}
-				}
+The file is mapped into memory and handed to BlacklistLoad (see Blacklist.c) in one piece, so a big file costs a handful of page faults
+instead of one ReadFile call per byte.
 
-				if (Read == 0x0A)
-				{
-					BytesOnThisLine = 0;
+The file may be gzipped (see BlacklistStream.c), which is told by its first bytes. A compressed file is always loaded from
+scratch, since lines can't be appended to it.
 
-					BADSTRING* NewNode = NULL;
+*/
+BLACKLIST_SNAPSHOT* LoadBlacklistSnapshot(_In_ HANDLE BlacklistFileHandle, _In_opt_ const BLACKLIST_SNAPSHOT* Current)
+{
+	BLACKLIST_SNAPSHOT* Snapshot = NULL;
 
-					if ((NewNode = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BADSTRING))) == NULL)
-					{
-						EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for list node!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+	HANDLE MappingHandle = NULL;
 
-						goto Sleep;
-					}
+	const BYTE* FileView = NULL;
 
-					CurrentNode->Next = NewNode;
+	LARGE_INTEGER FileSize = { 0 };
 
-					CurrentNode = NewNode;					
+	BLACKLIST_LOAD_STATS Stats = { 0 };
 
-					TotalBytesRead++;
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoadOk;
 
-					LinesRead++;
-					
-					continue;
-				}
-				
+	// Only until the directives have been traced. The snapshot keeps the tokens as a DAWG.
+	TOKEN_STORE Tokens = { 0 };
 
-				CurrentNode->String[BytesOnThisLine] = (wchar_t)towlower(Read);
+	WORKER_POOL Pool;
 
-				TotalBytesRead++;
+	if (GetFileSizeEx(BlacklistFileHandle, &FileSize) == 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call GetFileSizeEx on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, GetLastError());
 
-				BytesOnThisLine++;
-			}
+		goto Failed;
+	}
 
-			EventWriteStringW2(L"[%s:%s@%d] Read %lu bytes, %lu lines from file %s", __FILENAMEW__, __FUNCTIONW__, __LINE__, TotalBytesRead, LinesRead, BLACKLIST_FILENAME);
-		}	
+	// An empty file can't be mapped, but it is still a perfectly good (empty) blacklist.
+	if (FileSize.QuadPart > 0)
+	{
+		if ((ULONGLONG)FileSize.QuadPart > (SIZE_T)-1)
+		{
+			EventWriteStringW2(L"[%s:%s@%d] ERROR: %s is too big to map into this process!", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME);
 
-	Sleep:
+			goto Failed;
+		}
 
-		if (BlacklistFileHandle != INVALID_HANDLE_VALUE)
+		if ((MappingHandle = CreateFileMapping(BlacklistFileHandle, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL)
 		{
-			CloseHandle(BlacklistFileHandle);
-		}		
+			EventWriteStringW2(L"[%s:%s@%d] Failed to call CreateFileMapping on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, GetLastError());
 
-		gBlackListOldFileTime = gBlackListNewFileTime;
+			goto Failed;
+		}
+
+		if ((FileView = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0)) == NULL)
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Failed to call MapViewOfFile on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, GetLastError());
 
-		QueryPerformanceCounter(&EndTime);
+			goto Failed;
+		}
+	}
 
-		ElapsedMicroseconds.QuadPart = EndTime.QuadPart - StartTime.QuadPart;
-		
-		ElapsedMicroseconds.QuadPart *= 1000000;
-		
-		ElapsedMicroseconds.QuadPart /= gPerformanceFrequency.QuadPart;
+	BLACKLIST_COMPRESSION Compression = BlacklistCompression(FileView, (SIZE_T)FileSize.QuadPart);
 
-		EventWriteStringW2(L"[%s:%s@%d] Finished in %llu microseconds.", __FILENAMEW__, __FUNCTIONW__, __LINE__, ElapsedMicroseconds.QuadPart);
+	if (Current != NULL && Compression == BlacklistCompressionNone && (Snapshot = LoadAppendedBlacklistSnapshot(Current, FileView, (SIZE_T)FileSize.QuadPart)) != NULL)
+	{
+		goto End;
+	}
 
-		LeaveCriticalSection(&gBlacklistCritSec);
+	if ((Snapshot = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BLACKLIST_SNAPSHOT))) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for blacklist snapshot!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
 
-		Sleep(BLACKLIST_THREAD_RUN_FREQUENCY);
+		goto Failed;
 	}
 
-	return(0);
+	WorkerPoolInitialize(&Pool, WorkerPoolDefaultThreadCount(BLACKLIST_BUILD_MAX_THREADS));
+
+	// Everything from here on is platform-neutral, and is what PassFiltExTool bench, build-bench and stream-bench time.
+	if ((Status = BlacklistLoadCompressed(FileView, (SIZE_T)FileSize.QuadPart, &Pool, &Tokens, &Snapshot->Tokens, &Snapshot->Automaton, &Stats)) != BlacklistLoadOk)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to load %s: %hs!", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, BlacklistLoadStatusString(Status));
+
+		goto Failed;
+	}
+
+	// One more pass over the file, so that the next change can be told apart from lines being appended. For a compressed file
+	// this is over the compressed bytes, which no text file starts with, so a text file that replaces it is loaded from scratch.
+	BlacklistTextPrefixInitialize(&Snapshot->Text, FileView, (SIZE_T)FileSize.QuadPart);
+
+	Snapshot->BaseSize = Snapshot->Text.Size;
+
+	if (Stats.TruncatedLines > 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] WARNING: %llu lines were longer than max length of %d and have been truncated.", __FILENAMEW__, __FUNCTIONW__, __LINE__, Stats.TruncatedLines, MAX_BLACKLIST_STRING_SIZE - 1);
+	}
+
+	if (Stats.EmptyLines > 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Skipped %llu empty lines. Check your blacklist file for blank lines!", __FILENAMEW__, __FUNCTIONW__, __LINE__, Stats.EmptyLines);
+	}
+
+	EventWriteStringW2(L"[%s:%s@%d] Read %llu bytes, %llu lines from file %s", __FILENAMEW__, __FUNCTIONW__, __LINE__, Stats.BytesRead, Stats.LinesRead, BLACKLIST_FILENAME);
+
+	if (Compression != BlacklistCompressionNone)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] %s is compressed: decompressed %llu bytes from %llu.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, Stats.BytesRead, Stats.CompressedBytes);
+	}
+
+	// The old layout was one BADSTRING of 128 wchar_ts plus a Next pointer per line, plus the heap's own bookkeeping for each one.
+	EventWriteStringW2(L"[%s:%s@%d] Token store: %lu unique tokens out of %lu lines in %llu bytes (%llu bytes per token, down from about %llu.)", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+		Tokens.TokenCount,
+		Stats.TokensAdded,
+		(ULONGLONG)TokenStoreMemoryUsage(&Tokens),
+		(ULONGLONG)(TokenStoreMemoryUsage(&Tokens) / (Tokens.TokenCount ? Tokens.TokenCount : 1)),
+		(ULONGLONG)(MAX_BLACKLIST_STRING_SIZE * sizeof(wchar_t) + sizeof(void*) + (2 * sizeof(void*))));
+
+	TraceTokenDawg(&Snapshot->Tokens, &Tokens);
+
+	EventWriteStringW2(L"[%s:%s@%d] Compiled %lu blacklist tokens into %lu automaton states (%llu bytes.)", __FILENAMEW__, __FUNCTIONW__, __LINE__, Snapshot->Tokens.TokenCount, Snapshot->Automaton->StateCount, (ULONGLONG)AcMemoryUsage(Snapshot->Automaton));
+
+	EventWriteStringW2(L"[%s:%s@%d] Loaded on %lu threads: %llu microseconds parsing and sorting, %llu merging and %llu building the automaton.", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+		Stats.Threads,
+		Stats.ParseMicroseconds,
+		Stats.MergeMicroseconds,
+		Stats.AutomatonMicroseconds);
+
+	if (Stats.LateDirectives > 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] WARNING: Skipped %lu %hslines that came after the first token. Move them to the top of %s!", __FILENAMEW__, __FUNCTIONW__, __LINE__, Stats.LateDirectives, BLACKLIST_SUBSTITUTE_DIRECTIVE, BLACKLIST_FILENAME);
+	}
+
+	if (Stats.BadDirectives > 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] WARNING: Skipped %lu directives in %s that could not be understood. A %hsline takes one number from 0 to %d, %hsand %hslines a percent from 1 to 100, %hslines %hs or a percent, then the token, and a %hsline one number from 1 to %d.", __FILENAMEW__, __FUNCTIONW__, __LINE__, Stats.BadDirectives, BLACKLIST_FILENAME, BLACKLIST_DISTANCE_DIRECTIVE, FUZZY_MAX_DISTANCE, BLACKLIST_COVERAGE_DIRECTIVE, BLACKLIST_COMBINED_DIRECTIVE, BLACKLIST_RULE_DIRECTIVE, BLACKLIST_RULE_EXACT, BLACKLIST_STRENGTH_DIRECTIVE, STRENGTH_MAX_MINIMUM);
+	}
+
+	TraceBlacklistDirectives(Snapshot, &Tokens);
+
+	goto End;
+
+Failed:
+
+	FreeBlacklistSnapshot(Snapshot);
+
+	Snapshot = NULL;
+
+End:
+
+	TokenStoreFree(&Tokens);
+
+	if (FileView != NULL)
+	{
+		UnmapViewOfFile(FileView);
+	}
+
+	if (MappingHandle != NULL)
+	{
+		CloseHandle(MappingHandle);
+	}
+
+	return(Snapshot);
 }
 
-ULONG EventWriteStringW2(_In_ PCWSTR String, _In_ ...)
+/*
+LoadAppendedBlacklistSnapshot
+-----------------------------
+
+Makes a snapshot that shares Current's tokens and automaton, with everything appended to the text file since they were built
+in an overlay on top (see BlacklistDelta.c). Returns NULL if the file has changed in any other way, or the new lines can't be
+loaded on their own, and the whole file has to be loaded instead. FileView is the whole file, and may be NULL if it is empty.
+
+Whoever publishes the new snapshot has to set Current->BaseHandedOver, so that freeing Current leaves the shared parts alone.
+
+*/
+BLACKLIST_SNAPSHOT* LoadAppendedBlacklistSnapshot(_In_ const BLACKLIST_SNAPSHOT* Current, _In_ const BYTE* FileView, _In_ SIZE_T FileSize)
 {
+	BLACKLIST_SNAPSHOT* Snapshot = NULL;
+
+	BLACKLIST_DELTA_STATS Stats = { 0 };
+
+	BLACKLIST_DELTA_STATUS Status = BlacklistDeltaOk;
+
+	BLACKLIST_TEXT_PREFIX Text = Current->Text;
+
+	uint64_t StartTime = PlatformTimestamp();
+
+	if (BlacklistTextPrefixExtend(&Text, FileView, FileSize) == false)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] %s has changed, not just grown. Loading all of it.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME);
+
+		return(NULL);
+	}
+
+	uint64_t CheckedTime = PlatformTimestamp();
+
+	if ((Snapshot = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BLACKLIST_SNAPSHOT))) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for blacklist snapshot!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+
+		return(NULL);
+	}
+
+	// The overlay is rebuilt from everything after the base, so that there is only ever one.
+	if ((Status = BlacklistDeltaLoad(Current->Tokens.TokenCount, Current->Automaton, FileView + Current->BaseSize, FileSize - (SIZE_T)Current->BaseSize, &Snapshot->OverlayTokens, &Snapshot->Overlay, &Stats)) != BlacklistDeltaOk)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] The lines appended to %s can't be loaded on their own: %hs. Loading all of it.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_FILENAME, BlacklistDeltaStatusString(Status));
+
+		HeapFree(GetProcessHeap(), 0, Snapshot);
+
+		return(NULL);
+	}
+
+	Snapshot->Tokens = Current->Tokens;
+
+	Snapshot->Automaton = Current->Automaton;
+
+	Snapshot->Text = Text;
+
+	Snapshot->BaseSize = Current->BaseSize;
+
+	Snapshot->BaseLoadMicroseconds = Current->BaseLoadMicroseconds;
+
+	Snapshot->Appended = TRUE;
+
+	EventWriteStringW2(L"[%s:%s@%d] Read %llu lines appended to %s: %lu tokens, %lu of them already in the blacklist, into an overlay of %lu automaton states. Checking that nothing else had changed took %llu microseconds, and loading the new lines %llu.", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+		Stats.LinesRead,
+		BLACKLIST_FILENAME,
+		Stats.Tokens,
+		Stats.KnownTokens,
+		(Snapshot->Overlay != NULL) ? Snapshot->Overlay->StateCount : 0,
+		PlatformElapsedMicroseconds(StartTime, CheckedTime),
+		PlatformElapsedMicroseconds(CheckedTime, PlatformTimestamp()));
+
+	return(Snapshot);
+}
+
+/*
+BlacklistCompactionDue
+----------------------
+
+Whether the overlay on the current blacklist should be compacted into a new one: straight away if it has grown too big to be
+cheap (see BlacklistDeltaNeedsCompaction), and otherwise once the text file has been left alone for a while, so that a list
+that is added to a few lines at a time isn't rebuilt after every one of them. Only ever called from BlacklistThreadProc.
+
+*/
+BOOL BlacklistCompactionDue(void)
+{
+	const BLACKLIST_SNAPSHOT* Snapshot = gBlacklistSnapshot;
+
+	if (Snapshot == NULL || Snapshot->Appended == FALSE)
+	{
+		return(FALSE);
+	}
+
+	if (gBlacklistCompactionFailed == FALSE && BlacklistDeltaNeedsCompaction(Snapshot->Tokens.TokenCount, Snapshot->OverlayTokens.TokenCount))
+	{
+		return(TRUE);
+	}
+
+	return(PlatformElapsedMicroseconds(gBlacklistAppendedAt, PlatformTimestamp()) >= (uint64_t)BLACKLIST_COMPACT_IDLE_MILLISECONDS * 1000);
+}
+
+/*
+LoadBlacklistImageSnapshot
+--------------------------
+
+Maps a blacklist image compiled by PassFiltExTool and points a new snapshot straight into it. Nothing is parsed, sorted or
+compiled; see BlacklistImage.c for the checks that are made before any of it is trusted. The view stays mapped until the
+snapshot is freed. Returns NULL if anything goes wrong.
+
+*/
+BLACKLIST_SNAPSHOT* LoadBlacklistImageSnapshot(_In_ HANDLE ImageFileHandle)
+{
+	BLACKLIST_SNAPSHOT* Snapshot = NULL;
+
+	LARGE_INTEGER FileSize = { 0 };
+
+	BLACKLIST_IMAGE_STATUS Status = BlacklistImageOk;
+
+	// Points into the view, and is only read to build the DAWG the snapshot keeps and to trace the directives.
+	TOKEN_STORE Tokens = { 0 };
+
+	if ((Snapshot = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BLACKLIST_SNAPSHOT))) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for blacklist snapshot!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+
+		goto Failed;
+	}
+
+	if (GetFileSizeEx(ImageFileHandle, &FileSize) == 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call GetFileSizeEx on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_IMAGE_FILENAME, GetLastError());
+
+		goto Failed;
+	}
+
+	if (FileSize.QuadPart < (LONGLONG)sizeof(BLACKLIST_IMAGE_HEADER) || (ULONGLONG)FileSize.QuadPart > (SIZE_T)-1)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: %s is %lld bytes, which can't be a blacklist image!", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_IMAGE_FILENAME, FileSize.QuadPart);
+
+		goto Failed;
+	}
+
+	if ((Snapshot->ImageMapping = CreateFileMapping(ImageFileHandle, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call CreateFileMapping on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_IMAGE_FILENAME, GetLastError());
+
+		goto Failed;
+	}
+
+	if ((Snapshot->ImageView = MapViewOfFile(Snapshot->ImageMapping, FILE_MAP_READ, 0, 0, 0)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call MapViewOfFile on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_IMAGE_FILENAME, GetLastError());
+
+		goto Failed;
+	}
+
+	if ((Status = BlacklistImageOpen(Snapshot->ImageView, (SIZE_T)FileSize.QuadPart, &Tokens, &Snapshot->Tokens, &Snapshot->Automaton)) != BlacklistImageOk)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: %s was rejected: %hs", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_IMAGE_FILENAME, BlacklistImageStatusString(Status));
+
+		goto Failed;
+	}
+
+	EventWriteStringW2(L"[%s:%s@%d] Mapped %s: %lu tokens, %lu automaton states, %lld bytes.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BLACKLIST_IMAGE_FILENAME, Snapshot->Tokens.TokenCount, Snapshot->Automaton->StateCount, FileSize.QuadPart);
+
+	TraceTokenDawg(&Snapshot->Tokens, &Tokens);
+
+	TraceBlacklistDirectives(Snapshot, &Tokens);
+
+	return(Snapshot);
+
+Failed:
+
+	FreeBlacklistSnapshot(Snapshot);
+
+	return(NULL);
+}
+
+/*
+ReloadBreachIndexIfChanged
+--------------------------
+
+The breach index is optional and independent of the blacklist. It is remapped when its last modified time changes, and
+dropped if the file goes away.
+
+*/
+void ReloadBreachIndexIfChanged(void)
+{
+	HANDLE IndexFileHandle = INVALID_HANDLE_VALUE;
+
+	FILETIME IndexFileTime = { 0 };
+
+	// FILE_SHARE_DELETE for the same reason as with the blacklist image: a new index can be renamed over the one we have mapped.
+	if ((IndexFileHandle = CreateFile(BREACH_INDEX_FILENAME, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		DWORD Error = GetLastError();
+
+		if (Error != ERROR_FILE_NOT_FOUND)
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Unable to open %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, Error);
+		}
+		else if (gBreachSnapshot != NULL)
+		{
+			EventWriteStringW2(L"[%s:%s@%d] %s was removed. Passwords are no longer checked against it.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME);
+
+			PublishBreachSnapshot(NULL);
+
+			StatsRecordBreachReload(gStats, true, 0, 0);
+
+			ZeroMemory(&gBreachIndexFileTime, sizeof(FILETIME));
+		}
+
+		return;
+	}
+
+	if (GetFileTime(IndexFileHandle, NULL, NULL, &IndexFileTime) == 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call GetFileTime on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, GetLastError());
+
+		goto End;
+	}
+
+	if (CompareFileTime(&IndexFileTime, &gBreachIndexFileTime) == 0)
+	{
+		goto End;
+	}
+
+	EventWriteStringW2(L"[%s:%s@%d] %s has changed since the last time we looked. Let's reload it.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME);
+
+	BREACH_SNAPSHOT* NewSnapshot = NULL;
+
+	uint64_t StartTime = PlatformTimestamp();
+
+	if ((NewSnapshot = LoadBreachSnapshot(IndexFileHandle)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to load %s! The previous breach index (if any) stays in effect and we'll try again next time.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME);
+
+		StatsRecordBreachReload(gStats, false, 0, 0);
+
+		goto End;
+	}
+
+	uint64_t ElapsedMicroseconds = PlatformElapsedMicroseconds(StartTime, PlatformTimestamp());
+
+	StatsRecordBreachReload(gStats, true, ElapsedMicroseconds, NewSnapshot->Index.HashCount);
+
+	const uint64_t Values[TRACE_VALUE_COUNT] = { NewSnapshot->Index.HashCount, NewSnapshot->Index.FilterBlockCount, (NewSnapshot->ResidentFilter != NULL) ? 1 : 0, ElapsedMicroseconds };
+
+	TraceWrite(TraceEventBreachIndexLoaded, Values, NULL, 0);
+
+	PublishBreachSnapshot(NewSnapshot);
+
+	gBreachIndexFileTime = IndexFileTime;
+
+End:
+
+	CloseHandle(IndexFileHandle);
+}
+
+/*
+LoadBreachSnapshot
+------------------
+
+Maps a breach index and checks its header and fanout table (see BreachIndex.c.) The hashes themselves are only paged in as
+lookups touch them, so even an index of many gigabytes costs next to nothing up front. Returns NULL if anything goes wrong.
+
+*/
+BREACH_SNAPSHOT* LoadBreachSnapshot(_In_ HANDLE IndexFileHandle)
+{
+	BREACH_SNAPSHOT* Snapshot = NULL;
+
+	LARGE_INTEGER FileSize = { 0 };
+
+	BREACH_INDEX_STATUS Status = BreachIndexOk;
+
+	if ((Snapshot = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(BREACH_SNAPSHOT))) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: Failed to allocate memory for breach snapshot!", __FILENAMEW__, __FUNCTIONW__, __LINE__);
+
+		goto Failed;
+	}
+
+	if (GetFileSizeEx(IndexFileHandle, &FileSize) == 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call GetFileSizeEx on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, GetLastError());
+
+		goto Failed;
+	}
+
+	// A 32-bit process can't map a big index. The tool tells you how big it is; use a 64-bit build.
+	if (FileSize.QuadPart < (LONGLONG)sizeof(BREACH_INDEX_HEADER) || (ULONGLONG)FileSize.QuadPart > (SIZE_T)-1)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: %s is %lld bytes, which can't be mapped as a breach index!", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, FileSize.QuadPart);
+
+		goto Failed;
+	}
+
+	if ((Snapshot->Mapping = CreateFileMapping(IndexFileHandle, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call CreateFileMapping on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, GetLastError());
+
+		goto Failed;
+	}
+
+	if ((Snapshot->View = MapViewOfFile(Snapshot->Mapping, FILE_MAP_READ, 0, 0, 0)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call MapViewOfFile on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, GetLastError());
+
+		goto Failed;
+	}
+
+	if ((Status = BreachIndexOpen(Snapshot->View, (SIZE_T)FileSize.QuadPart, &Snapshot->Index)) != BreachIndexOk)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] ERROR: %s was rejected: %hs", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, BreachIndexStatusString(Status));
+
+		goto Failed;
+	}
+
+	EventWriteStringW2(L"[%s:%s@%d] Mapped %s: %llu breached password hashes.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME, Snapshot->Index.HashCount);
+
+	if (Snapshot->Index.Filter == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] WARNING: %s has no Bloom filter. Every password will be searched for in the mapped file.", __FILENAMEW__, __FUNCTIONW__, __LINE__, BREACH_INDEX_FILENAME);
+
+		return(Snapshot);
+	}
+
+	SIZE_T FilterSize = (SIZE_T)Snapshot->Index.FilterBlockCount * sizeof(BLOOM_BLOCK);
+
+	BREACH_INDEX_HEADER Header;
+
+	memcpy(&Header, Snapshot->View, sizeof(Header));
+
+	// VirtualAlloc rather than HeapAlloc, for page alignment: no filter block ever straddles a cache line.
+	if (FilterSize <= BREACH_FILTER_MAX_RESIDENT_SIZE && (Snapshot->ResidentFilter = VirtualAlloc(NULL, FilterSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)) != NULL)
+	{
+		DWORD OldProtection = 0;
+
+		memcpy(Snapshot->ResidentFilter, Snapshot->Index.Filter, FilterSize);
+
+		VirtualProtect(Snapshot->ResidentFilter, FilterSize, PAGE_READONLY, &OldProtection);
+
+		Snapshot->Index.Filter = Snapshot->ResidentFilter;
+	}
+
+	EventWriteStringW2(L"[%s:%s@%d] Bloom filter: %llu bytes (%s), %lu.%04lu%% false positives. Breach lookups only touch the mapped file for those and for real hits.", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+		(ULONGLONG)FilterSize,
+		(Snapshot->ResidentFilter != NULL) ? L"resident" : L"mapped",
+		Header.FilterFalsePositivesPerMillion / 10000,
+		Header.FilterFalsePositivesPerMillion % 10000);
+
+	return(Snapshot);
+
+Failed:
+
+	FreeBreachSnapshot(Snapshot);
+
+	return(NULL);
+}
+
+void FreeBreachSnapshot(_In_opt_ BREACH_SNAPSHOT* Snapshot)
+{
+	if (Snapshot == NULL)
+	{
+		return;
+	}
+
+	if (Snapshot->ResidentFilter != NULL)
+	{
+		VirtualFree(Snapshot->ResidentFilter, 0, MEM_RELEASE);
+	}
+
+	if (Snapshot->View != NULL)
+	{
+		UnmapViewOfFile(Snapshot->View);
+	}
+
+	if (Snapshot->Mapping != NULL)
+	{
+		CloseHandle(Snapshot->Mapping);
+	}
+
+	HeapFree(GetProcessHeap(), 0, Snapshot);
+}
+
+/*
+TraceTokenDawg
+--------------
+
+Says how much memory keeping the tokens as a DAWG (see TokenDawg.c) saves lsass over keeping the token store they were loaded
+into, which is freed as soon as the snapshot is loaded. A list of random strings can come out worse off.
+
+*/
+void TraceTokenDawg(_In_ const TOKEN_DAWG* Dawg, _In_ const TOKEN_STORE* Tokens)
+{
+	ULONGLONG DawgBytes = (ULONGLONG)TokenDawgMemoryUsage(Dawg);
+
+	ULONGLONG StoreBytes = (ULONGLONG)TokenStoreMemoryUsage(Tokens);
+
+	EventWriteStringW2(L"[%s:%s@%d] Tokens are kept as a DAWG of %llu bytes (%llu bytes per token) instead of a token store of %llu bytes, which saves %lld bytes.", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+		DawgBytes,
+		DawgBytes / (Dawg->TokenCount ? Dawg->TokenCount : 1),
+		StoreBytes,
+		(LONGLONG)StoreBytes - (LONGLONG)DawgBytes);
+}
+
+/*
+TraceBlacklistDirectives
+------------------------
+
+Says what the blacklist's directives (see Blacklist.c) do. For !rule lines, that includes how many tokens ended up with a
+coverage of their own. For !substitute lines, that is how many spellings its tokens cover and how big a text file listing every
+one of them would be, next to what the tokens and the automaton take in memory now. Walking the tokens isn't free on a big list,
+so it is skipped when nobody is tracing. Tokens is the token store the snapshot's DAWG was built from, which is still around
+while the snapshot is being loaded.
+
+*/
+void TraceBlacklistDirectives(_In_ const BLACKLIST_SNAPSHOT* Snapshot, _In_ const TOKEN_STORE* Tokens)
+{
+	if (TraceEnabled() == false)
+	{
+		return;
+	}
+
+	if (Snapshot->Automaton->EditDistance > 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Passwords are also rejected for tokens within %u edits (one for every %u characters of the token), for passwords up to %u characters.", __FILENAMEW__, __FUNCTIONW__, __LINE__, (unsigned)Snapshot->Automaton->EditDistance, (unsigned)FUZZY_CHARACTERS_PER_EDIT, (unsigned)FUZZY_MAX_PASSWORD_LENGTH);
+	}
+
+	if (Snapshot->Automaton->Coverage != AC_DEFAULT_COVERAGE || Snapshot->Automaton->CombinedCoverage != 0 || Snapshot->Automaton->PatternCoverage != NULL)
+	{
+		ULONG RuledTokens = 0;
+
+		for (ULONG Index = 0; Index < Snapshot->Tokens.TokenCount && Snapshot->Automaton->PatternCoverage != NULL; Index++)
+		{
+			RuledTokens += (Snapshot->Automaton->PatternCoverage[Index] != Snapshot->Automaton->Coverage);
+		}
+
+		EventWriteStringW2(L"[%s:%s@%d] Rules: a token rejects a password it makes up %u%% of, %lu tokens have rules of their own, and tokens together reject one they make up %u%% of (0 is never.)", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+			(unsigned)Snapshot->Automaton->Coverage,
+			RuledTokens,
+			(unsigned)Snapshot->Automaton->CombinedCoverage);
+	}
+
+	if (Snapshot->Automaton->MinimumStrength > 0)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Strength: passwords up to %u characters that would take fewer than 10^%u guesses are rejected, with the tokens as the dictionary.", __FILENAMEW__, __FUNCTIONW__, __LINE__, (unsigned)STRENGTH_MAX_PASSWORD_LENGTH, (unsigned)Snapshot->Automaton->MinimumStrength);
+	}
+
+	if (Snapshot->Automaton->Substituting == false)
+	{
+		return;
+	}
+
+	ULONGLONG TextBytes = 0;
+
+	ULONGLONG Spellings = BlacklistSpellingCount(Tokens, Snapshot->Automaton, &TextBytes);
+
+	EventWriteStringW2(L"[%s:%s@%d] Substitutions: %lu tokens cover %llu spellings, which would take %llu bytes listed one per line. Tokens and automaton take %llu bytes.", __FILENAMEW__, __FUNCTIONW__, __LINE__,
+		Snapshot->Tokens.TokenCount,
+		Spellings,
+		TextBytes,
+		(ULONGLONG)(TokenDawgMemoryUsage(&Snapshot->Tokens) + AcMemoryUsage(Snapshot->Automaton)));
+}
+
+void FreeBlacklistSnapshot(_In_opt_ BLACKLIST_SNAPSHOT* Snapshot)
+{
+	if (Snapshot == NULL)
+	{
+		return;
+	}
+
+	AcDestroy(Snapshot->Overlay);
+
+	TokenStoreFree(&Snapshot->OverlayTokens);
+
+	if (Snapshot->BaseHandedOver == FALSE)
+	{
+		AcDestroy(Snapshot->Automaton);
+
+		TokenDawgFree(&Snapshot->Tokens);
+	}
+
+	// Only after the automaton is gone, since it may point into the view.
+	if (Snapshot->ImageView != NULL)
+	{
+		UnmapViewOfFile(Snapshot->ImageView);
+	}
+
+	if (Snapshot->ImageMapping != NULL)
+	{
+		CloseHandle(Snapshot->ImageMapping);
+	}
+
+	HeapFree(GetProcessHeap(), 0, Snapshot);
+}
+
+/*
+AcquireBlacklistSnapshot / ReleaseBlacklistSnapshot
+---------------------------------------------------
+
+PasswordFilter runs on many lsass threads at once and must never wait behind a reload, so readers do not take any lock.
+Instead, they register with gSnapshotGuard (see SnapshotGuard.c), which keeps both gBlacklistSnapshot and gBreachSnapshot
+alive until they leave again.
+
+*/
+BLACKLIST_SNAPSHOT* AcquireBlacklistSnapshot(_Out_ int32_t* ReaderSlot)
+{
+	return(SnapshotGuardEnter(&gSnapshotGuard, (void* volatile*)&gBlacklistSnapshot, ReaderSlot));
+}
+
+void ReleaseBlacklistSnapshot(_In_ int32_t ReaderSlot)
+{
+	SnapshotGuardLeave(&gSnapshotGuard, ReaderSlot);
+}
+
+// Only ever called from BlacklistThreadProc, so there is never more than one writer.
+void PublishBlacklistSnapshot(_In_ BLACKLIST_SNAPSHOT* NewSnapshot)
+{
+	FreeBlacklistSnapshot(SnapshotGuardExchange(&gSnapshotGuard, (void* volatile*)&gBlacklistSnapshot, NewSnapshot));
+}
+
+void PublishBreachSnapshot(_In_opt_ BREACH_SNAPSHOT* NewSnapshot)
+{
+	FreeBreachSnapshot(SnapshotGuardExchange(&gSnapshotGuard, (void* volatile*)&gBreachSnapshot, NewSnapshot));
+}
+
+/*
+OpenStatsSegment
+----------------
+
+The counters in Stats.c live in a file next to the blacklist, mapped for as long as lsass runs, so that PassFiltExTool stats
+can map it too and read them while they are being kept. It is started afresh every time the DLL is loaded. If the file can't
+be used, the counters are kept in memory instead, where nobody else can see them, rather than not at all.
+
+*/
+STATS_SEGMENT* OpenStatsSegment(void)
+{
+	HANDLE StatsFileHandle = INVALID_HANDLE_VALUE;
+
+	HANDLE MappingHandle = NULL;
+
+	STATS_SEGMENT* Segment = NULL;
+
+	// Shared for reading and writing, since it's only a view of our counters, and for deleting, so it can be cleaned up while we run.
+	if ((StatsFileHandle = CreateFile(STATS_FILENAME, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Unable to create %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, STATS_FILENAME, GetLastError());
+
+		goto End;
+	}
+
+	if ((MappingHandle = CreateFileMapping(StatsFileHandle, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(STATS_SEGMENT), NULL)) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call CreateFileMapping on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, STATS_FILENAME, GetLastError());
+
+		goto End;
+	}
+
+	if ((Segment = MapViewOfFile(MappingHandle, FILE_MAP_WRITE, 0, 0, sizeof(STATS_SEGMENT))) == NULL)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to call MapViewOfFile on %s! Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, STATS_FILENAME, GetLastError());
+	}
+
+End:
+
+	// The view, which is never unmapped, keeps the mapping and the file open by itself.
+	if (MappingHandle != NULL)
+	{
+		CloseHandle(MappingHandle);
+	}
+
+	if (StatsFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(StatsFileHandle);
+	}
+
+	if (Segment == NULL && (Segment = HeapAlloc(GetProcessHeap(), 0, sizeof(STATS_SEGMENT))) == NULL)
+	{
+		return(NULL);
+	}
+
+	StatsInitialize(Segment);
+
+	return(Segment);
+}
+
+/*
+WriteNotifyRecords
+------------------
+
+The NOTIFY_SINK for gNotifyQueue, so it runs on the queue's worker thread and never on one of LSA's. Appends a line for each
+record to the spool file next to the blacklist, in UTF-8, with tabs between the fields:
+
+    2026-10-16T09:30:12.345Z	changed	1104	jdoe
+    2026-10-16T09:30:13.001Z	dropped	12
+
+where the number is the RID of the user whose password was changed, or how many changes the queue had to turn away at that
+point. A batch goes out in a single WriteFile. The file is opened anew for every batch, so that it can be read, moved or
+deleted at any time, and once it has grown past NOTIFY_SPOOL_MAX_SIZE it is renamed to NOTIFY_SPOOL_OLD_FILENAME, replacing
+the one before, so that the two never take up more than twice that.
+
+*/
+bool WriteNotifyRecords(_In_opt_ void* Context, _In_reads_(Count) const NOTIFY_RECORD* Records, _In_ uint32_t Count)
+{
+	UNREFERENCED_PARAMETER(Context);
+
+	char Buffer[NOTIFY_BATCH_SIZE * NOTIFY_SPOOL_LINE_SIZE];
+
+	size_t BufferLength = 0;
+
+	HANDLE SpoolFileHandle = INVALID_HANDLE_VALUE;
+
+	DWORD BytesWritten = 0;
+
+	bool Written = false;
+
+	FILETIME Now = { 0 };
+
+	// Records carry PlatformTimestamp ticks, which only count up from boot. They are turned into the time of day by how long
+	// ago they were taken.
+	GetSystemTimeAsFileTime(&Now);
+
+	uint64_t NowTicks = PlatformTimestamp();
+
+	uint64_t NowTime = ((uint64_t)Now.dwHighDateTime << 32) | Now.dwLowDateTime;
+
+	for (uint32_t Index = 0; Index < Count && Index < NOTIFY_BATCH_SIZE; Index++)
+	{
+		const NOTIFY_RECORD* Record = &Records[Index];
+
+		char Name[NOTIFY_NAME_LENGTH * 3 + 1] = { 0 };
+
+		SYSTEMTIME Time = { 0 };
+
+		uint64_t RecordTime = NowTime - (PlatformElapsedMicroseconds(Record->Timestamp, NowTicks) * 10);
+
+		FILETIME RecordFileTime = { (DWORD)RecordTime, (DWORD)(RecordTime >> 32) };
+
+		FileTimeToSystemTime(&RecordFileTime, &Time);
+
+		if (Record->NameLength > 0)
+		{
+			WideCharToMultiByte(CP_UTF8, 0, (LPCWCH)Record->Name, Record->NameLength, Name, (int)sizeof(Name) - 1, NULL, NULL);
+		}
+
+		int LineLength = _snprintf_s(
+			Buffer + BufferLength,
+			sizeof(Buffer) - BufferLength,
+			_TRUNCATE,
+			"%04u-%02u-%02uT%02u:%02u:%02u.%03uZ\t%s\t%llu\t%s\r\n",
+			Time.wYear, Time.wMonth, Time.wDay, Time.wHour, Time.wMinute, Time.wSecond, Time.wMilliseconds,
+			(Record->Kind == NotifyRecordsDropped) ? "dropped" : "changed",
+			(Record->Kind == NotifyRecordsDropped) ? (unsigned long long)Record->Count : (unsigned long long)Record->RelativeId,
+			Name);
+
+		if (LineLength < 0)
+		{
+			break;
+		}
+
+		BufferLength += (size_t)LineLength;
+	}
+
+	WIN32_FILE_ATTRIBUTE_DATA Attributes = { 0 };
+
+	if (GetFileAttributesExW(NOTIFY_SPOOL_FILENAME, GetFileExInfoStandard, &Attributes) && (((uint64_t)Attributes.nFileSizeHigh << 32) | Attributes.nFileSizeLow) >= NOTIFY_SPOOL_MAX_SIZE)
+	{
+		// If this fails, the file just keeps growing until it doesn't.
+		MoveFileExW(NOTIFY_SPOOL_FILENAME, NOTIFY_SPOOL_OLD_FILENAME, MOVEFILE_REPLACE_EXISTING);
+	}
+
+	if ((SpoolFileHandle = CreateFile(NOTIFY_SPOOL_FILENAME, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Unable to open %s! %lu records lost. Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, NOTIFY_SPOOL_FILENAME, Count, GetLastError());
+
+		goto End;
+	}
+
+	if (WriteFile(SpoolFileHandle, Buffer, (DWORD)BufferLength, &BytesWritten, NULL) == FALSE || BytesWritten != BufferLength)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] Failed to write to %s! %lu records lost. Error 0x%08lx", __FILENAMEW__, __FUNCTIONW__, __LINE__, NOTIFY_SPOOL_FILENAME, Count, GetLastError());
+
+		goto End;
+	}
+
+	Written = true;
+
+End:
+
+	if (SpoolFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(SpoolFileHandle);
+	}
+
+	return(Written);
+}
+
+/*
+EtwEnableCallback
+-----------------
+
+Called by ETW whenever a trace session enables or disables our provider, including from inside EventRegister if a session
+was already waiting for it. Keeps Trace.c's flag in step, so that nothing is traced or formatted while nobody is listening.
+
+*/
+void NTAPI EtwEnableCallback(_In_ LPCGUID SourceId, _In_ ULONG IsEnabled, _In_ UCHAR Level, _In_ ULONGLONG MatchAnyKeyword, _In_ ULONGLONG MatchAllKeyword, _In_opt_ PEVENT_FILTER_DESCRIPTOR FilterData, _Inout_opt_ PVOID CallbackContext)
+{
+	UNREFERENCED_PARAMETER(SourceId);
+
+	UNREFERENCED_PARAMETER(Level);
+
+	UNREFERENCED_PARAMETER(MatchAnyKeyword);
+
+	UNREFERENCED_PARAMETER(MatchAllKeyword);
+
+	UNREFERENCED_PARAMETER(FilterData);
+
+	UNREFERENCED_PARAMETER(CallbackContext);
+
+	if (IsEnabled == EVENT_CONTROL_CODE_ENABLE_PROVIDER)
+	{
+		TraceSetEnabled(true);
+	}
+	else if (IsEnabled == EVENT_CONTROL_CODE_DISABLE_PROVIDER)
+	{
+		// One session going away doesn't mean that every session has.
+		TraceSetEnabled(EventProviderEnabled(gEtwRegHandle, 0, 0) != FALSE);
+	}
+}
+
+/*
+ReportDroppedTraceEvents / TraceEventToEtw
+------------------------------------------
+
+TraceEventToEtw turns the typed events that have piled up in Trace.c's rings into the same kind of messages that
+EventWriteStringW2 writes, so that a trace session sees one stream of text as it always has. It runs on the drain thread that
+InitializeChangeNotify starts, never in PasswordFilter. ReportDroppedTraceEvents runs on BlacklistThreadProc, every time it
+wakes up, which is often enough for a warning.
+
+*/
+void ReportDroppedTraceEvents(void)
+{
+	static uint64_t ReportedDrops;
+
+	uint64_t Dropped = TraceDroppedEvents();
+
+	if (Dropped != ReportedDrops)
+	{
+		EventWriteStringW2(L"[%s:%s@%d] WARNING: %llu trace events were dropped because the trace rings were full.", __FILENAMEW__, __FUNCTIONW__, __LINE__, Dropped - ReportedDrops);
+
+		ReportedDrops = Dropped;
+	}
+}
+
+void TraceEventToEtw(_In_opt_ void* Context, _In_ const TRACE_EVENT* Event)
+{
+	UNREFERENCED_PARAMETER(Context);
+
+	switch (Event->Id)
+	{
+		case TraceEventPasswordChecked:
+		{
+			EventWriteStringW2(L"[%s:PasswordFilter] Thread %lu: %s password for user %.*s: %hs (token #%lld) in %llu microseconds.", __FILENAMEW__,
+				Event->ThreadId,
+				Event->Values[1] ? L"SET" : L"CHANGE",
+				(int)Event->TextLength,
+				(const wchar_t*)Event->Text,
+				PasswordVerdictString((PASSWORD_VERDICT)Event->Values[0]),
+				(Event->Values[2] == AC_NO_PATTERN) ? -1LL : (LONGLONG)Event->Values[2],
+				Event->Values[3]);
+
+			break;
+		}
+		case TraceEventPasswordChanged:
+		{
+			EventWriteStringW2(L"[%s:PasswordChangeNotify] Thread %lu: Password for %.*s (RID %llu) was changed.", __FILENAMEW__, Event->ThreadId, (int)Event->TextLength, (const wchar_t*)Event->Text, Event->Values[0]);
+
+			break;
+		}
+		case TraceEventBlacklistLoaded:
+		{
+			EventWriteStringW2(L"[%s:ReloadBlacklistIfChanged] Loaded %llu tokens and %llu automaton states from the %s in %llu microseconds.", __FILENAMEW__, Event->Values[0], Event->Values[1], Event->Values[2] ? L"image" : L"text file", Event->Values[3]);
+
+			break;
+		}
+		case TraceEventBlacklistAppended:
+		{
+			EventWriteStringW2(L"[%s:ReloadBlacklistIfChanged] Put %llu appended tokens (%llu automaton states) on top of the blacklist in %llu microseconds. The last full rebuild took %llu microseconds.", __FILENAMEW__, Event->Values[0], Event->Values[1], Event->Values[2], Event->Values[3]);
+
+			break;
+		}
+		case TraceEventBreachIndexLoaded:
+		{
+			EventWriteStringW2(L"[%s:ReloadBreachIndexIfChanged] Loaded %llu breached password hashes and %llu %s Bloom filter blocks in %llu microseconds.", __FILENAMEW__, Event->Values[0], Event->Values[1], Event->Values[2] ? L"resident" : L"mapped", Event->Values[3]);
+
+			break;
+		}
+		default:
+		{
+			EventWriteStringW2(L"[%s:%s@%d] Unknown trace event %u.", __FILENAMEW__, __FUNCTIONW__, __LINE__, Event->Id);
+
+			break;
+		}
+	}
+}
+
+ULONG EventWriteStringW2(_In_ PCWSTR String, _In_ ...)
+{
+	// Nobody is listening, so there's no point formatting anything.
+	if (TraceEnabled() == false)
+	{
+		return(ERROR_SUCCESS);
+	}
+
 	wchar_t FormattedString[ETW_MAX_STRING_SIZE] = { 0 };
 
 	va_list ArgPointer = NULL;
@@ -8,19 +8,109 @@
 
 #define ETW_MAX_STRING_SIZE 2048
 
-#define MAX_BLACKLIST_STRING_SIZE 128
-
+// Only used when System32 can't be watched for changes. Otherwise the files are reloaded as soon as they have changed.
 #define BLACKLIST_THREAD_RUN_FREQUENCY 60000
 
-#define BLACKLIST_FILENAME L"PassFiltExBlacklist.txt"
+// How long a file has to go without being written to before it is reloaded, so that one that is still being copied or saved
+// isn't read halfway through. See FileWatch.c.
+#define BLACKLIST_DEBOUNCE_MILLISECONDS 250
+
+// An overlay of appended tokens is compacted into a new base once the blacklist has gone this long without growing, if it
+// hasn't grown big enough to be compacted before then. See BlacklistDelta.c.
+#define BLACKLIST_COMPACT_IDLE_MILLISECONDS (10 * 60 * 1000)
+
+// A full reload of the text blacklist is spread over at most this many threads, and never more than half of the processors, so
+// that a big list comes into effect sooner without taking the machine away from logons. 1 keeps it on BlacklistThreadProc
+// alone. See WorkerPool.c.
+#define BLACKLIST_BUILD_MAX_THREADS 4
+
+// How often Trace.c's drain thread passes trace events on to ETW when the rings are not filling up any faster.
+#define TRACE_DRAIN_FREQUENCY 1000
+
+// The narrow names are what FileWatchStart is given.
+#define BLACKLIST_FILE "PassFiltExBlacklist.txt"
+
+#define BLACKLIST_FILENAME L"" BLACKLIST_FILE
+
+// Compiled from the text file by PassFiltExTool. Used instead of the text file whenever it is present and intact.
+#define BLACKLIST_IMAGE_FILE "PassFiltExBlacklist.bin"
+
+#define BLACKLIST_IMAGE_FILENAME L"" BLACKLIST_IMAGE_FILE
+
+// Built by PassFiltExTool breach-build. Optional.
+#define BREACH_INDEX_FILE "PassFiltExBreached.bin"
+
+#define BREACH_INDEX_FILENAME L"" BREACH_INDEX_FILE
+
+// Written by the DLL for PassFiltExTool stats to read. See OpenStatsSegment.
+#define STATS_FILENAME L"PassFiltExStats.bin"
+
+// Where the notify queue's worker writes a line for every password change. See WriteNotifyRecords.
+#define NOTIFY_SPOOL_FILENAME L"PassFiltExChanges.txt"
+
+#define NOTIFY_SPOOL_OLD_FILENAME L"PassFiltExChanges.old"
 
-typedef struct BADSTRING
+#define NOTIFY_SPOOL_MAX_SIZE (16 * 1024 * 1024)
+
+// Long enough for the time, the RID and a NOTIFY_NAME_LENGTH name of three-byte UTF-8 characters.
+#define NOTIFY_SPOOL_LINE_SIZE 256
+
+// Bloom filters up to this size are copied out of the mapped index into memory of their own, so that a lookup that the filter
+// turns away can never wait on a page fault. Bigger ones stay in the mapped file along with the rest of the index.
+#define BREACH_FILTER_MAX_RESIDENT_SIZE (64 * 1024 * 1024)
+
+// Everything PasswordFilter needs to judge a password. Once published, a snapshot is never modified, only replaced.
+typedef struct BLACKLIST_SNAPSHOT
 {
-	wchar_t String[MAX_BLACKLIST_STRING_SIZE];
+	// The tokens Automaton was built from, as a DAWG (see TokenDawg.c). For a list of words and their variations that is about
+	// half the memory of the token store they were loaded into; random strings share too little and come out a bit bigger, which
+	// next to the automaton is a few percent either way. The load trace says which. Token i is pattern i of Automaton. Only read
+	// to say which token a password was rejected for.
+	TOKEN_DAWG Tokens;
+
+	AC_AUTOMATON* Automaton;
+
+	// Only set when the snapshot came from a blacklist image. Automaton then points into this view.
+	HANDLE ImageMapping;
+
+	const void* ImageView;
+
+	// The text file the snapshot came from, so that lines appended to it can be told apart from any other change, and how
+	// much of it Tokens and Automaton were built from. The rest is in the overlay. See BlacklistDelta.c.
+	BLACKLIST_TEXT_PREFIX Text;
 
-	struct BADSTRING* Next;
+	uint64_t BaseSize;
 
-} BADSTRING;
+	// How long building Tokens and Automaton took, to compare overlays with.
+	uint64_t BaseLoadMicroseconds;
+
+	// Tokens appended to the text file since Tokens and Automaton were built. Overlay is NULL if there are none that are new.
+	TOKEN_STORE OverlayTokens;
+
+	AC_AUTOMATON* Overlay;
+
+	// Whether this snapshot was made by putting an overlay on top of the one before it, which it shares Tokens and Automaton with.
+	BOOL Appended;
+
+	// Set on a snapshot whose Tokens and Automaton a newer one has taken over, so that freeing it leaves them alone. Only the
+	// blacklist thread ever looks at it, so setting it doesn't count as modifying a published snapshot.
+	BOOL BaseHandedOver;
+
+} BLACKLIST_SNAPSHOT;
+
+// A mapped breach index. Published and retired the same way as a BLACKLIST_SNAPSHOT.
+typedef struct BREACH_SNAPSHOT
+{
+	BREACH_INDEX Index;
+
+	HANDLE Mapping;
+
+	const void* View;
+
+	// The resident copy of the Bloom filter, if there is one. Index.Filter points here instead of into View.
+	void* ResidentFilter;
+
+} BREACH_SNAPSHOT;
 
 
 
@@ -34,4 +124,44 @@ __declspec(dllexport) BOOL CALLBACK PasswordFilter(_In_ PUNICODE_STRING AccountN
 
 ULONG EventWriteStringW2(_In_ PCWSTR String, _In_ ...);
 
-DWORD WINAPI BlacklistThreadProc(_In_ LPVOID Args);
\ No newline at end of file
+STATS_SEGMENT* OpenStatsSegment(void);
+
+bool WriteNotifyRecords(_In_opt_ void* Context, _In_reads_(Count) const NOTIFY_RECORD* Records, _In_ uint32_t Count);
+
+void NTAPI EtwEnableCallback(_In_ LPCGUID SourceId, _In_ ULONG IsEnabled, _In_ UCHAR Level, _In_ ULONGLONG MatchAnyKeyword, _In_ ULONGLONG MatchAllKeyword, _In_opt_ PEVENT_FILTER_DESCRIPTOR FilterData, _Inout_opt_ PVOID CallbackContext);
+
+void ReportDroppedTraceEvents(void);
+
+void TraceEventToEtw(_In_opt_ void* Context, _In_ const TRACE_EVENT* Event);
+
+DWORD WINAPI BlacklistThreadProc(_In_ LPVOID Args);
+
+BOOL ReloadBlacklistIfChanged(_In_ PCWSTR FileName, _In_ BOOL IsImage);
+
+BLACKLIST_SNAPSHOT* LoadBlacklistSnapshot(_In_ HANDLE BlacklistFileHandle, _In_opt_ const BLACKLIST_SNAPSHOT* Current);
+
+BLACKLIST_SNAPSHOT* LoadAppendedBlacklistSnapshot(_In_ const BLACKLIST_SNAPSHOT* Current, _In_ const BYTE* FileView, _In_ SIZE_T FileSize);
+
+BOOL BlacklistCompactionDue(void);
+
+BLACKLIST_SNAPSHOT* LoadBlacklistImageSnapshot(_In_ HANDLE ImageFileHandle);
+
+void ReloadBreachIndexIfChanged(void);
+
+BREACH_SNAPSHOT* LoadBreachSnapshot(_In_ HANDLE IndexFileHandle);
+
+void TraceTokenDawg(_In_ const TOKEN_DAWG* Dawg, _In_ const TOKEN_STORE* Tokens);
+
+void TraceBlacklistDirectives(_In_ const BLACKLIST_SNAPSHOT* Snapshot, _In_ const TOKEN_STORE* Tokens);
+
+void FreeBreachSnapshot(_In_opt_ BREACH_SNAPSHOT* Snapshot);
+
+void FreeBlacklistSnapshot(_In_opt_ BLACKLIST_SNAPSHOT* Snapshot);
+
+BLACKLIST_SNAPSHOT* AcquireBlacklistSnapshot(_Out_ int32_t* ReaderSlot);
+
+void ReleaseBlacklistSnapshot(_In_ int32_t ReaderSlot);
+
+void PublishBlacklistSnapshot(_In_ BLACKLIST_SNAPSHOT* NewSnapshot);
+
+void PublishBreachSnapshot(_In_opt_ BREACH_SNAPSHOT* NewSnapshot);
\ No newline at end of file
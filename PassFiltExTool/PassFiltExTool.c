@@ -0,0 +1,908 @@
+/*
+PassFiltExTool.c
+
+Offline companion to PassFiltEx.dll. It is built from the same platform-neutral sources as the DLL (Blacklist.c,
+BlacklistParser.c, TokenStore.c, AhoCorasick.c and friends), so whatever it reports is exactly what the DLL would do.
+
+Usage:
+
+  PassFiltExTool compile <blacklist.txt> <blacklist.bin>
+
+    Parses, normalizes, deduplicates and compiles a text blacklist into a binary image. Copy the image next to
+    PassFiltExBlacklist.txt as PassFiltExBlacklist.bin and the DLL will use it instead of the text file. If the blacklist has
+    !substitute lines (see Blacklist.c), it also reports how many spellings the tokens cover.
+
+  PassFiltExTool verify <blacklist.bin> [<blacklist.txt> [<passwords.txt>]]
+
+    Checks that an image is intact. If a text blacklist is given too, the image must be identical to what compiling that text
+    file would produce. If a password file is given as well, every password in it is judged both ways and the verdicts compared.
+
+  PassFiltExTool breach-build [--plaintext] [--filter-bits <0-64>] <input.txt> <breached.bin>
+
+    Builds a breached password index (see BreachIndex.c), with a Bloom filter of 10 bits per hash unless told otherwise. By default the input is in the format of the Have I Been Pwned NTLM
+    downloads: one hex NT hash per line, optionally followed by a colon and a count. With --plaintext, every line is a password
+    (UTF-8) and is hashed here. Input that is already sorted by hash is streamed straight through, so the index can be far
+    bigger than memory; anything else is sorted in memory first. Copy the result into System32 as PassFiltExBreached.bin.
+
+  PassFiltExTool breach-verify <breached.bin> [<passwords.txt>]
+
+    Checks the whole index, including the hash records that the DLL does not checksum, and optionally looks up every password
+    in a file.
+
+  PassFiltExTool breach-bench <breached.bin> [<lookups>]
+
+    Measures lookup throughput against a mapped index, for hashes that are in it and hashes that aren't, with and without the
+    Bloom filter.
+
+  PassFiltExTool bench [--max-tokens <n>] [--checks <n>] [--breach <breached.bin>]
+
+    Generates blacklists of 1,000 up to 10,000,000 lines (or --max-tokens), and for each one measures how fast it loads, as
+    text and as an image, and the p50, p99 and p99.9 latency of judging passwords of several lengths, with several shares of
+    them built to be rejected. See ToolBench.c. Run it before and after a change to catch a slowdown before it reaches a DC.
+
+  PassFiltExTool storm [--threads <n,n,...>] [--seconds <n>] [--tokens <n>] [--set-percent <0-100>] [--reload-ms <n>] [--stats <stats.bin>]
+
+    Has many threads judge passwords at once, a mix of SETs and CHANGEs, while another thread keeps reloading the blacklist,
+    and prints one line of CSV per thread count: throughput, latency percentiles, time spent registering as a reader and
+    time the reloads spent waiting for readers. See ToolStorm.c. With --stats, it also keeps the DLL's counters in a file
+    that the stats command can read, and checks them as it goes.
+
+  PassFiltExTool snapshot-stress [--threads <n>] [--seconds <n>] [--reload-ms <n>]
+
+    Has many threads read small snapshots that another thread publishes and retires as fast as it can, poisoning each one it
+    retires, and fails if any reader ever sees a poisoned one. Reports the longest any reader spent in SnapshotGuardEnter.
+    See ToolSnapshot.c, which also says how to build for the address and thread sanitizers, to run it under those.
+
+  PassFiltExTool match-check [--lists <n>] [--passwords <n>]
+
+    Checks that the automaton finds every token in a password that looking for each token in turn does, and that a password
+    is rejected exactly when one of them makes up at least half of it, with random lists of overlapping tokens, characters
+    above 255 and passwords exactly twice as long as a token. See ToolMatch.c.
+
+  PassFiltExTool load-bench [--lines <n,n,...>] [--rounds <n>] [--directory <directory>]
+
+    Writes blacklists of 1,000,000, 10,000,000 and 100,000,000 lines (or --lines), maps each one the way the DLL does, and
+    reports how many MB/s the SSE2 line splitter in BlacklistParser.c gets through, against a scalar one. See ToolLoad.c.
+
+  PassFiltExTool stats <PassFiltExStats.bin> [--top <n>] [--histogram]
+
+    Prints the counters that the DLL keeps in System32\PassFiltExStats.bin while it runs: calls, verdicts, the latency
+    distribution, reloads and the most hit blacklist tokens. See Stats.c.
+
+  PassFiltExTool trace-bench [--events <n>] [--threads <n>] [--rate <n>] [--seconds <n>]
+
+    Measures what a trace event costs with tracing off and on, against formatting a message the way the DLL used to for
+    every password, and checks that events written from several threads at once, --rate a second each, all come back
+    through the drain thread, bar one in a thousand at most. See ToolTrace.c.
+
+  PassFiltExTool alloc-check [--tokens <n>] [--checks <n>] [--threads <n>] [--breach <breached.bin>]
+
+    Counts allocations around runs of PasswordCheck, from one thread and from several, and fails unless judging a password
+    with the scratch pool that the DLL uses takes none at all and leaves every pool buffer wiped. See ToolScratch.c.
+
+  PassFiltExTool normalize-bench [--megabytes <n>]
+
+    Checks that the SSE2 and AVX2 case folding kernels (whichever this CPU has) fold every character exactly as the scalar
+    one does, and measures how fast each of them is. See ToolNormalize.c.
+
+  PassFiltExTool fuzzy-bench [--tokens <n>] [--checks <n>] [--length <n>]
+
+    Checks the search for tokens with typos in them (see FuzzyMatch.c) against a slow but obvious one, then times PasswordCheck
+    with a !distance of 0, 1 and 2 on a big generated blacklist. See ToolFuzzy.c.
+
+  PassFiltExTool name-check [--tokens <n>] [--checks <n>]
+
+    Checks that passwords made of the user's own names are rejected (see NameMatch.c), against a slow but obvious search and a
+    list of known cases, then times PasswordCheck with and without the names on a big generated blacklist. See ToolNames.c.
+
+  PassFiltExTool watch-check [--directory <directory>] [--rounds <n>] [--debounce-ms <n>]
+
+    Checks that a blacklist is reloaded once, and soon, each time it is rewritten, even slowly, and never opened while it
+    isn't, the way BlacklistThreadProc watches System32 (see FileWatch.c). Prints how long each reload took to happen after
+    the file was closed. See ToolWatch.c.
+
+  PassFiltExTool delta-bench [--tokens <n>] [--appended <n>] [--rounds <n>] [--checks <n>]
+
+    Appends lines to a big generated blacklist, round after round, and times loading only them on top of it (see
+    BlacklistDelta.c) next to rebuilding all of it. Fails unless both judge every password the same, and unless any other
+    change to the file takes a full reload. See ToolDelta.c.
+
+  PassFiltExTool build-bench [--tokens <n>] [--threads <n>] [--rounds <n>]
+
+    Loads a big generated blacklist on 1, 2, 4 and more threads (see WorkerPool.c), and prints how long each stage of the load
+    took and the speedup. Fails unless every thread count builds exactly the same blacklist. See ToolBuild.c.
+
+  PassFiltExTool dawg-bench [--tokens <n>] [--checks <n>] [--random | --file <blacklist.txt>]
+
+    Builds a blacklist of 10,000,000 generated lines (or --tokens, or a real one with --file) into a bit-packed DAWG (see
+    TokenDawg.c), as the DLL keeps it, and prints the bytes per token it takes next to the token store and automaton, and the
+    latency of the substring check on each. Fails unless both find a token in exactly the same passwords. See ToolDawg.c.
+
+  PassFiltExTool notify-check [--posts <n>] [--threads <n>] [--sink-ms <n>]
+
+    Posts password changes from 4 threads (or --threads) to the queue that PasswordChangeNotify hands its work to (see
+    NotifyQueue.c), first with a fast sink and then with one that takes --sink-ms (default 5) over every batch, and prints the
+    p50, p99, p99.9 and worst latency of a post for each, next to how many were dropped. Fails unless every record posted
+    comes out, in order, or is reported as dropped. See ToolNotify.c.
+
+  PassFiltExTool audit <blacklist.txt> <passwords.txt> [--threads <n>] [--top <n>] [--breach <breached.bin>]
+
+    Judges every line of a password file the way PasswordFilter would, on all the processors (or --threads), and prints how
+    many would be accepted and rejected and why, the --top (default 20) tokens that reject the most, and passwords per
+    second. Run it over a list of real passwords before rolling out a new blacklist. See ToolAudit.c.
+
+  PassFiltExTool stream-bench [--tokens <n>] [--gzip <blacklist.txt.gz> <blacklist.txt>]
+
+    Gzips a blacklist of 1,000,000 generated lines (or --tokens) three different ways, and checks that each decompresses to
+    the text and loads (see BlacklistStream.c) into exactly the same blacklist as the text does, then prints how fast each one
+    decompresses and loads. Damaged files must fail to load. With --gzip, a file gzipped elsewhere is checked against its
+    text instead. See ToolStream.c.
+
+  PassFiltExTool rule-check [--tokens <n>] [--checks <n>]
+
+    Checks that !coverage, !combined and !rule (see Blacklist.c) reject exactly the passwords they should, against a list of
+    known cases and a slow but obvious way of applying them to random lists, loaded, through an image and with lines appended.
+    Then times PasswordCheck on a big generated blacklist with no rules, and with more and more of its tokens given a rule of
+    their own. See ToolRules.c.
+
+  PassFiltExTool strength-bench [--tokens <n>] [--checks <n>]
+
+    Checks that !strength (see Strength.c) rejects walks, sequences, repeats, dates and tokens with those around them, and
+    not passwords only brute force gets, loaded and through an image. Then times estimates of the longest, most adversarial
+    passwords against a big generated blacklist, and of "aaa..." against a list of every run of "a". See ToolStrength.c.
+
+Building:
+
+  - Windows: PassFiltExTool.vcxproj, part of PassFiltEx.sln.
+
+  - Anything else with a C11 compiler, from this directory:
+    cc -O2 -std=c11 -pthread -I.. -o passfiltex-tool *.c ../AhoCorasick.c ../Blacklist.c ../BlacklistDelta.c ../BlacklistImage.c ../BlacklistParser.c ../BlacklistStream.c ../BloomFilter.c ../BreachIndex.c ../FileWatch.c ../FuzzyMatch.c ../Inflate.c ../Md4.c ../NameMatch.c ../Normalize.c ../NotifyQueue.c ../PasswordCheck.c ../Platform.c ../ScratchPool.c ../SnapshotGuard.c ../Stats.c ../Strength.c ../TokenDawg.c ../TokenStore.c ../Trace.c ../WorkerPool.c
+
+*/
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+#else
+
+// For mmap.
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+
+#include <sys/mman.h>
+
+#include <sys/stat.h>
+
+#include <unistd.h>
+
+#endif
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistParser.h"
+
+#include "FuzzyMatch.h"
+
+#include "Normalize.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#define TOOL_READ_CHUNK_SIZE (1024 * 1024)
+
+static uint64_t gToolRandomState = 0x9E3779B97F4A7C15ULL;
+
+static void PrintUsage(void)
+{
+	fprintf(stderr,
+		"Usage:\n"
+		"  PassFiltExTool compile <blacklist.txt> <blacklist.bin>\n"
+		"  PassFiltExTool verify <blacklist.bin> [<blacklist.txt> [<passwords.txt>]]\n"
+		"  PassFiltExTool breach-build [--plaintext] [--filter-bits <0-64>] <input.txt> <breached.bin>\n"
+		"  PassFiltExTool breach-verify <breached.bin> [<passwords.txt>]\n"
+		"  PassFiltExTool breach-bench <breached.bin> [<lookups>]\n"
+		"  PassFiltExTool bench [--max-tokens <n>] [--checks <n>] [--breach <breached.bin>]\n"
+		"  PassFiltExTool storm [--threads <n,n,...>] [--seconds <n>] [--tokens <n>] [--set-percent <0-100>] [--reload-ms <n>] [--stats <stats.bin>]\n"
+		"  PassFiltExTool snapshot-stress [--threads <n>] [--seconds <n>] [--reload-ms <n>]\n"
+		"  PassFiltExTool match-check [--lists <n>] [--passwords <n>]\n"
+		"  PassFiltExTool load-bench [--lines <n,n,...>] [--rounds <n>] [--directory <directory>]\n"
+		"  PassFiltExTool stats <PassFiltExStats.bin> [--top <n>] [--histogram]\n"
+		"  PassFiltExTool trace-bench [--events <n>] [--threads <n>] [--rate <n>] [--seconds <n>]\n"
+		"  PassFiltExTool alloc-check [--tokens <n>] [--checks <n>] [--threads <n>] [--breach <breached.bin>]\n"
+		"  PassFiltExTool normalize-bench [--megabytes <n>]\n"
+		"  PassFiltExTool fuzzy-bench [--tokens <n>] [--checks <n>] [--length <n>]\n"
+		"  PassFiltExTool name-check [--tokens <n>] [--checks <n>]\n"
+		"  PassFiltExTool watch-check [--directory <directory>] [--rounds <n>] [--debounce-ms <n>]\n"
+		"  PassFiltExTool delta-bench [--tokens <n>] [--appended <n>] [--rounds <n>] [--checks <n>]\n"
+		"  PassFiltExTool build-bench [--tokens <n>] [--threads <n>] [--rounds <n>]\n"
+		"  PassFiltExTool dawg-bench [--tokens <n>] [--checks <n>] [--random | --file <blacklist.txt>]\n"
+		"  PassFiltExTool notify-check [--posts <n>] [--threads <n>] [--sink-ms <n>]\n"
+		"  PassFiltExTool audit <blacklist.txt> <passwords.txt> [--threads <n>] [--top <n>] [--breach <breached.bin>]\n"
+		"  PassFiltExTool stream-bench [--tokens <n>] [--gzip <blacklist.txt.gz> <blacklist.txt>]\n"
+		"  PassFiltExTool rule-check [--tokens <n>] [--checks <n>]\n"
+		"  PassFiltExTool strength-bench [--tokens <n>] [--checks <n>]\n");
+}
+
+int main(int ArgumentCount, char** Arguments)
+{
+	if (ArgumentCount < 2)
+	{
+		PrintUsage();
+
+		return(2);
+	}
+
+	if (strcmp(Arguments[1], "compile") == 0)
+	{
+		return(CommandCompile(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "verify") == 0)
+	{
+		return(CommandVerify(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "breach-build") == 0)
+	{
+		return(CommandBreachBuild(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "breach-verify") == 0)
+	{
+		return(CommandBreachVerify(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "breach-bench") == 0)
+	{
+		return(CommandBreachBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "bench") == 0)
+	{
+		return(CommandBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "storm") == 0)
+	{
+		return(CommandStorm(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "snapshot-stress") == 0)
+	{
+		return(CommandSnapshotStress(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "match-check") == 0)
+	{
+		return(CommandMatchCheck(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "load-bench") == 0)
+	{
+		return(CommandLoadBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "stats") == 0)
+	{
+		return(CommandStats(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "trace-bench") == 0)
+	{
+		return(CommandTraceBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "alloc-check") == 0)
+	{
+		return(CommandAllocCheck(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "normalize-bench") == 0)
+	{
+		return(CommandNormalizeBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "fuzzy-bench") == 0)
+	{
+		return(CommandFuzzyBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "name-check") == 0)
+	{
+		return(CommandNameCheck(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "watch-check") == 0)
+	{
+		return(CommandWatchCheck(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "delta-bench") == 0)
+	{
+		return(CommandDeltaBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "build-bench") == 0)
+	{
+		return(CommandBuildBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "dawg-bench") == 0)
+	{
+		return(CommandDawgBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "notify-check") == 0)
+	{
+		return(CommandNotifyCheck(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "audit") == 0)
+	{
+		return(CommandAudit(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "stream-bench") == 0)
+	{
+		return(CommandStreamBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "rule-check") == 0)
+	{
+		return(CommandRuleCheck(ArgumentCount - 2, Arguments + 2));
+	}
+
+	if (strcmp(Arguments[1], "strength-bench") == 0)
+	{
+		return(CommandStrengthBench(ArgumentCount - 2, Arguments + 2));
+	}
+
+	PrintUsage();
+
+	return(2);
+}
+
+// Feeds a text file through BlacklistParser.c a chunk at a time, so files far bigger than memory are fine.
+bool ToolParseTextFile(const char* Path, uint32_t MaxLineLength, BLACKLIST_LINE_CALLBACK Callback, void* Context, TOOL_TEXT_STATS* Stats)
+{
+	bool Result = false;
+
+	FILE* File = NULL;
+
+	uint8_t* Chunk = NULL;
+
+	BLACKLIST_PARSER* Parser = NULL;
+
+	if ((File = fopen(Path, "rb")) == NULL)
+	{
+		fprintf(stderr, "Unable to open %s!\n", Path);
+
+		goto End;
+	}
+
+	if ((Chunk = malloc(TOOL_READ_CHUNK_SIZE)) == NULL || (Parser = malloc(sizeof(BLACKLIST_PARSER))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	BlacklistParserInitialize(Parser, MaxLineLength, Callback, Context);
+
+	size_t BytesRead = 0;
+
+	while ((BytesRead = fread(Chunk, 1, TOOL_READ_CHUNK_SIZE, File)) > 0)
+	{
+		if (BlacklistParserFeed(Parser, Chunk, BytesRead) == false)
+		{
+			break;
+		}
+	}
+
+	BlacklistParserFinish(Parser);
+
+	if (ferror(File))
+	{
+		fprintf(stderr, "Error reading %s!\n", Path);
+
+		goto End;
+	}
+
+	if (Stats != NULL)
+	{
+		Stats->BytesRead = Parser->BytesRead;
+
+		Stats->LinesRead = Parser->LinesRead;
+
+		Stats->EmptyLines = Parser->EmptyLines;
+
+		Stats->TruncatedLines = Parser->TruncatedLines;
+	}
+
+	Result = true;
+
+End:
+
+	if (File != NULL)
+	{
+		fclose(File);
+	}
+
+	free(Chunk);
+
+	free(Parser);
+
+	return(Result);
+}
+
+// Reads a text blacklist exactly the way the DLL does, into a finished token store.
+// Loads and compiles a text blacklist the way the DLL does, substitutions and all. Stats may be NULL.
+bool ToolLoadBlacklistText(const char* Path, TOKEN_STORE* Tokens, AC_AUTOMATON** Automaton, TOOL_TEXT_STATS* Stats)
+{
+	bool Result = false;
+
+	BLACKLIST_LOAD_CONTEXT LoadContext = { 0 };
+
+	memset(Tokens, 0, sizeof(TOKEN_STORE));
+
+	*Automaton = NULL;
+
+	if ((LoadContext.Builder = TokenStoreBuilderCreate()) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if (ToolParseTextFile(Path, MAX_BLACKLIST_STRING_SIZE - 1, BlacklistAddLine, &LoadContext, Stats) == false)
+	{
+		goto End;
+	}
+
+	if (LoadContext.OutOfMemory || TokenStoreBuilderFinish(LoadContext.Builder, Tokens) == false)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if (LoadContext.LateDirectives > 0)
+	{
+		fprintf(stderr, "WARNING: %lu %slines came after the first token in %s and were skipped. Move them to the top.\n", (unsigned long)LoadContext.LateDirectives, BLACKLIST_SUBSTITUTE_DIRECTIVE, Path);
+	}
+
+	if (LoadContext.BadDirectives > 0)
+	{
+		fprintf(stderr, "WARNING: %lu directives in %s could not be understood and were skipped. A %sline takes one number from 0 to %d, %sand %slines a percent from 1 to 100, and %slines %s or a percent, then the token.\n", (unsigned long)LoadContext.BadDirectives, Path, BLACKLIST_DISTANCE_DIRECTIVE, FUZZY_MAX_DISTANCE, BLACKLIST_COVERAGE_DIRECTIVE, BLACKLIST_COMBINED_DIRECTIVE, BLACKLIST_RULE_DIRECTIVE, BLACKLIST_RULE_EXACT);
+	}
+
+	if ((*Automaton = BlacklistBuildAutomaton(Tokens, NULL, &LoadContext, NULL)) == NULL)
+	{
+		fprintf(stderr, "Out of memory building the automaton!\n");
+
+		TokenStoreFree(Tokens);
+
+		goto End;
+	}
+
+	Result = true;
+
+End:
+
+	TokenStoreBuilderDestroy(LoadContext.Builder);
+
+	BlacklistRulesFree(&LoadContext);
+
+	return(Result);
+}
+
+void* ToolReadFile(const char* Path, size_t* Size)
+{
+	FILE* File = NULL;
+
+	uint8_t* Data = NULL;
+
+	size_t Capacity = TOOL_READ_CHUNK_SIZE;
+
+	size_t Length = 0;
+
+	if ((File = fopen(Path, "rb")) == NULL)
+	{
+		fprintf(stderr, "Unable to open %s!\n", Path);
+
+		return(NULL);
+	}
+
+	// Grow as we go instead of asking for the size up front. ftell is only 32 bits wide on Windows.
+	while (true)
+	{
+		if (Data == NULL || Length == Capacity)
+		{
+			uint8_t* NewData = realloc(Data, (Data == NULL) ? Capacity : Capacity * 2);
+
+			if (NewData == NULL)
+			{
+				fprintf(stderr, "Out of memory reading %s!\n", Path);
+
+				free(Data);
+
+				fclose(File);
+
+				return(NULL);
+			}
+
+			Capacity = (Data == NULL) ? Capacity : Capacity * 2;
+
+			Data = NewData;
+		}
+
+		size_t BytesRead = fread(Data + Length, 1, Capacity - Length, File);
+
+		if (BytesRead == 0)
+		{
+			break;
+		}
+
+		Length += BytesRead;
+	}
+
+	if (ferror(File))
+	{
+		fprintf(stderr, "Error reading %s!\n", Path);
+
+		free(Data);
+
+		Data = NULL;
+	}
+
+	fclose(File);
+
+	*Size = Length;
+
+	return(Data);
+}
+
+bool ToolWriteFile(const char* Path, const void* Data, size_t Size)
+{
+	FILE* File = NULL;
+
+	if ((File = fopen(Path, "wb")) == NULL)
+	{
+		fprintf(stderr, "Unable to create %s!\n", Path);
+
+		return(false);
+	}
+
+	bool Result = (fwrite(Data, 1, Size, File) == Size);
+
+	if (fclose(File) != 0)
+	{
+		Result = false;
+	}
+
+	if (Result == false)
+	{
+		fprintf(stderr, "Error writing %s!\n", Path);
+	}
+
+	return(Result);
+}
+
+// Maps a whole file read-only. Breach indexes can be many gigabytes, so they are never read into memory.
+const void* ToolMapFile(const char* Path, size_t* Size)
+{
+	const void* Data = NULL;
+
+	*Size = 0;
+
+#ifdef _WIN32
+
+	HANDLE File = INVALID_HANDLE_VALUE;
+
+	HANDLE Mapping = NULL;
+
+	LARGE_INTEGER FileSize = { 0 };
+
+	// FILE_SHARE_WRITE too, or PassFiltExStats.bin couldn't be opened while lsass has it mapped for writing.
+	if ((File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		fprintf(stderr, "Unable to open %s!\n", Path);
+
+		return(NULL);
+	}
+
+	if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0 && (ULONGLONG)FileSize.QuadPart <= (SIZE_T)-1)
+	{
+		if ((Mapping = CreateFileMapping(File, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+		{
+			Data = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+
+			// The view keeps the mapping alive.
+			CloseHandle(Mapping);
+		}
+	}
+
+	CloseHandle(File);
+
+	if (Data != NULL)
+	{
+		*Size = (size_t)FileSize.QuadPart;
+	}
+
+#else
+
+	int File = -1;
+
+	struct stat FileStatus;
+
+	if ((File = open(Path, O_RDONLY)) < 0)
+	{
+		fprintf(stderr, "Unable to open %s!\n", Path);
+
+		return(NULL);
+	}
+
+	if (fstat(File, &FileStatus) == 0 && FileStatus.st_size > 0 && (unsigned long long)FileStatus.st_size <= (size_t)-1)
+	{
+		void* View = mmap(NULL, (size_t)FileStatus.st_size, PROT_READ, MAP_SHARED, File, 0);
+
+		if (View != MAP_FAILED)
+		{
+			Data = View;
+
+			*Size = (size_t)FileStatus.st_size;
+		}
+	}
+
+	close(File);
+
+#endif
+
+	if (Data == NULL)
+	{
+		fprintf(stderr, "Unable to map %s!\n", Path);
+	}
+
+	return(Data);
+}
+
+// Creates or replaces a file of Size zero bytes and maps it for writing, shared, so that other processes that map it see every change.
+void* ToolCreateMappedFile(const char* Path, size_t Size)
+{
+	void* Data = NULL;
+
+#ifdef _WIN32
+
+	HANDLE File = INVALID_HANDLE_VALUE;
+
+	HANDLE Mapping = NULL;
+
+	if ((File = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		fprintf(stderr, "Unable to create %s!\n", Path);
+
+		return(NULL);
+	}
+
+	if ((Mapping = CreateFileMapping(File, NULL, PAGE_READWRITE, (DWORD)((ULONGLONG)Size >> 32), (DWORD)Size, NULL)) != NULL)
+	{
+		Data = MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, Size);
+
+		// The view keeps the mapping alive.
+		CloseHandle(Mapping);
+	}
+
+	CloseHandle(File);
+
+#else
+
+	int File = -1;
+
+	if ((File = open(Path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+	{
+		fprintf(stderr, "Unable to create %s!\n", Path);
+
+		return(NULL);
+	}
+
+	if (ftruncate(File, (off_t)Size) == 0)
+	{
+		void* View = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+
+		if (View != MAP_FAILED)
+		{
+			Data = View;
+		}
+	}
+
+	close(File);
+
+#endif
+
+	if (Data == NULL)
+	{
+		fprintf(stderr, "Unable to map %s!\n", Path);
+	}
+
+	return(Data);
+}
+
+void ToolUnmapFile(const void* Data, size_t Size)
+{
+	if (Data == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+
+	(void)Size;
+
+	UnmapViewOfFile(Data);
+
+#else
+
+	munmap((void*)(uintptr_t)Data, Size);
+
+#endif
+}
+
+/*
+Decodes one line of a password file into UTF-16, which is what LSA hands to PasswordFilter. Lines are expected to be UTF-8;
+a byte that isn't part of a valid UTF-8 sequence is taken to be Latin-1, so old ANSI word lists still come out sensibly.
+Returns the number of UTF-16 code units written.
+
+*/
+size_t ToolDecodeUtf8(const uint8_t* Line, uint32_t Length, uint16_t* Output, size_t Capacity)
+{
+	size_t Count = 0;
+
+	uint32_t Index = 0;
+
+	while (Index < Length && Count < Capacity)
+	{
+		uint32_t CodePoint = Line[Index];
+
+		uint32_t SequenceLength = 1;
+
+		if (CodePoint >= 0xC2 && CodePoint <= 0xF4)
+		{
+			SequenceLength = (CodePoint >= 0xF0) ? 4 : (CodePoint >= 0xE0) ? 3 : 2;
+
+			uint32_t Decoded = CodePoint & (0xFF >> (SequenceLength + 1));
+
+			for (uint32_t Continuation = 1; Continuation < SequenceLength; Continuation++)
+			{
+				if (Index + Continuation >= Length || (Line[Index + Continuation] & 0xC0) != 0x80)
+				{
+					SequenceLength = 1;
+
+					break;
+				}
+
+				Decoded = (Decoded << 6) | (Line[Index + Continuation] & 0x3F);
+			}
+
+			// Overlong forms, surrogates and anything past U+10FFFF aren't valid UTF-8 either.
+			if (SequenceLength > 1)
+			{
+				uint32_t Minimum = (SequenceLength == 2) ? 0x80 : (SequenceLength == 3) ? 0x800 : 0x10000;
+
+				if (Decoded < Minimum || Decoded > 0x10FFFF || (Decoded >= 0xD800 && Decoded <= 0xDFFF))
+				{
+					SequenceLength = 1;
+				}
+				else
+				{
+					CodePoint = Decoded;
+				}
+			}
+		}
+
+		if (CodePoint >= 0x10000)
+		{
+			if (Count + 2 > Capacity)
+			{
+				break;
+			}
+
+			Output[Count++] = (uint16_t)(0xD800 + ((CodePoint - 0x10000) >> 10));
+
+			Output[Count++] = (uint16_t)(0xDC00 + ((CodePoint - 0x10000) & 0x3FF));
+		}
+		else
+		{
+			Output[Count++] = (uint16_t)CodePoint;
+		}
+
+		Index += SequenceLength;
+	}
+
+	return(Count);
+}
+
+// Decodes a line of a password file and folds it the way PasswordFilter does. Returns the number of characters written.
+size_t ToolNormalizePassword(const uint8_t* Line, uint32_t Length, uint16_t* Password, size_t Capacity)
+{
+	size_t Count = ToolDecodeUtf8(Line, Length, Password, Capacity);
+
+	NormalizeString(Password, Count);
+
+	return(Count);
+}
+
+// xorshift64*. Benchmarks want the same inputs every run, so it always starts from the same seed.
+uint64_t ToolRandom(void)
+{
+	gToolRandomState ^= gToolRandomState >> 12;
+
+	gToolRandomState ^= gToolRandomState << 25;
+
+	gToolRandomState ^= gToolRandomState >> 27;
+
+	return(gToolRandomState * 0x2545F4914F6CDD1DULL);
+}
+
+// The same monotonic clock that PasswordFilter times itself with.
+double ToolNowInSeconds(void)
+{
+	return((double)PlatformTimestamp() / (double)PlatformTimestampFrequency());
+}
+
+double ToolTicksToNanoseconds(uint64_t Ticks)
+{
+	return(((double)Ticks * 1e9) / (double)PlatformTimestampFrequency());
+}
+
+static int CompareLatencies(const void* Left, const void* Right)
+{
+	uint64_t LeftValue = *(const uint64_t*)Left;
+
+	uint64_t RightValue = *(const uint64_t*)Right;
+
+	return((LeftValue > RightValue) - (LeftValue < RightValue));
+}
+
+static uint64_t LatencyAt(const uint64_t* SortedLatencies, uint64_t Count, uint64_t PerThousand)
+{
+	uint64_t Index = (Count * PerThousand) / 1000;
+
+	return((uint64_t)ToolTicksToNanoseconds(SortedLatencies[(Index < Count) ? Index : Count - 1]));
+}
+
+// Every benchmark reports the same few numbers, worked out the same way, so that they can be held up against each other.
+// Latencies are in PlatformTimestamp ticks, and are sorted in place. Count must not be 0.
+void ToolSummarizeLatencies(uint64_t* Latencies, uint64_t Count, TOOL_LATENCY_SUMMARY* Summary)
+{
+	uint64_t Total = 0;
+
+	for (uint64_t Index = 0; Index < Count; Index++)
+	{
+		Total += Latencies[Index];
+	}
+
+	qsort(Latencies, (size_t)Count, sizeof(uint64_t), CompareLatencies);
+
+	Summary->Min = LatencyAt(Latencies, Count, 0);
+
+	Summary->Mean = (uint64_t)ToolTicksToNanoseconds(Total / Count);
+
+	Summary->P50 = LatencyAt(Latencies, Count, 500);
+
+	Summary->P99 = LatencyAt(Latencies, Count, 990);
+
+	Summary->P999 = LatencyAt(Latencies, Count, 999);
+
+	Summary->Max = LatencyAt(Latencies, Count, 1000);
+}
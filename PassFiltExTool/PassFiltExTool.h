@@ -0,0 +1,159 @@
+// Please read PassFiltExTool.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "BlacklistParser.h"
+
+#include "Platform.h"
+
+#include "Stats.h"
+
+#include "TokenStore.h"
+
+typedef struct TOOL_TEXT_STATS
+{
+	uint64_t BytesRead;
+
+	uint64_t LinesRead;
+
+	uint64_t EmptyLines;
+
+	uint64_t TruncatedLines;
+
+} TOOL_TEXT_STATS;
+
+// What ToolSummarizeLatencies makes of a set of timings, all in nanoseconds.
+typedef struct TOOL_LATENCY_SUMMARY
+{
+	uint64_t Min;
+
+	uint64_t Mean;
+
+	uint64_t P50;
+
+	uint64_t P99;
+
+	uint64_t P999;
+
+	uint64_t Max;
+
+} TOOL_LATENCY_SUMMARY;
+
+// The user the bench, storm and alloc-check commands change passwords for. PasswordFilter is always given both names, and
+// looks for them in every password, so the numbers should include that.
+#define TOOL_ACCOUNT_NAME "jsmith.admin"
+
+#define TOOL_FULL_NAME "John Q. Smith-Jones"
+
+#define TOOL_MAX_NAME_LENGTH 256
+
+// Names the way PasswordFilter is handed them. The strings point into the buffers, so this can't be copied.
+typedef struct TOOL_NAMES
+{
+	uint16_t AccountNameBuffer[TOOL_MAX_NAME_LENGTH];
+
+	uint16_t FullNameBuffer[TOOL_MAX_NAME_LENGTH];
+
+	PLATFORM_STRING AccountName;
+
+	PLATFORM_STRING FullName;
+
+} TOOL_NAMES;
+
+int CommandCompile(int ArgumentCount, char** Arguments);
+
+int CommandVerify(int ArgumentCount, char** Arguments);
+
+int CommandBreachBuild(int ArgumentCount, char** Arguments);
+
+int CommandBreachVerify(int ArgumentCount, char** Arguments);
+
+int CommandBreachBench(int ArgumentCount, char** Arguments);
+
+int CommandBench(int ArgumentCount, char** Arguments);
+
+int CommandStorm(int ArgumentCount, char** Arguments);
+
+int CommandSnapshotStress(int ArgumentCount, char** Arguments);
+
+int CommandMatchCheck(int ArgumentCount, char** Arguments);
+
+int CommandLoadBench(int ArgumentCount, char** Arguments);
+
+int CommandStats(int ArgumentCount, char** Arguments);
+
+int CommandTraceBench(int ArgumentCount, char** Arguments);
+
+int CommandAllocCheck(int ArgumentCount, char** Arguments);
+
+int CommandNormalizeBench(int ArgumentCount, char** Arguments);
+
+int CommandFuzzyBench(int ArgumentCount, char** Arguments);
+
+int CommandNameCheck(int ArgumentCount, char** Arguments);
+
+int CommandWatchCheck(int ArgumentCount, char** Arguments);
+
+int CommandDeltaBench(int ArgumentCount, char** Arguments);
+
+int CommandBuildBench(int ArgumentCount, char** Arguments);
+
+int CommandDawgBench(int ArgumentCount, char** Arguments);
+
+int CommandNotifyCheck(int ArgumentCount, char** Arguments);
+
+int CommandAudit(int ArgumentCount, char** Arguments);
+
+int CommandStreamBench(int ArgumentCount, char** Arguments);
+
+int CommandRuleCheck(int ArgumentCount, char** Arguments);
+
+int CommandStrengthBench(int ArgumentCount, char** Arguments);
+
+bool ToolParseTextFile(const char* Path, uint32_t MaxLineLength, BLACKLIST_LINE_CALLBACK Callback, void* Context, TOOL_TEXT_STATS* Stats);
+
+bool ToolLoadBlacklistText(const char* Path, TOKEN_STORE* Tokens, AC_AUTOMATON** Automaton, TOOL_TEXT_STATS* Stats);
+
+void* ToolReadFile(const char* Path, size_t* Size);
+
+bool ToolWriteFile(const char* Path, const void* Data, size_t Size);
+
+const void* ToolMapFile(const char* Path, size_t* Size);
+
+void* ToolCreateMappedFile(const char* Path, size_t Size);
+
+void ToolUnmapFile(const void* Data, size_t Size);
+
+size_t ToolDecodeUtf8(const uint8_t* Line, uint32_t Length, uint16_t* Output, size_t Capacity);
+
+size_t ToolNormalizePassword(const uint8_t* Line, uint32_t Length, uint16_t* Password, size_t Capacity);
+
+uint64_t ToolRandom(void);
+
+double ToolNowInSeconds(void);
+
+double ToolTicksToNanoseconds(uint64_t Ticks);
+
+void ToolSummarizeLatencies(uint64_t* Latencies, uint64_t Count, TOOL_LATENCY_SUMMARY* Summary);
+
+uint8_t* ToolGenerateBlacklist(uint32_t TokenCount, size_t* Size);
+
+bool ToolStatsAddUp(const STATS_SNAPSHOT* Snapshot);
+
+void ToolMakePassword(uint16_t* Password, uint32_t Length, const TOKEN_STORE* Tokens, bool IsHit);
+
+void ToolMakeNames(TOOL_NAMES* Names, const char* AccountName, const char* FullName);
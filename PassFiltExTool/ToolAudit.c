@@ -0,0 +1,426 @@
+/*
+ToolAudit.c
+
+The audit command: what a blacklist would do to real passwords, before it goes anywhere near a domain controller.
+
+Every line of the password file is judged by PasswordCheck, the very function PasswordFilter calls, against the blacklist
+(and a breach index, if one is given), and the command prints how many would be accepted, how many rejected and why, the
+tokens that reject the most, and how many passwords it got through per second. No user names are given, since the lines
+belong to nobody in particular, so the name check is the only part of PasswordFilter that doesn't run.
+
+Password files can be many gigabytes, so the file is mapped rather than read, and cut into chunks of AUDIT_CHUNK_SIZE bytes
+that are handed out to a WorkerPool (see WorkerPool.c), all the processors by default. Threads claim chunks one at a time
+as they finish the last, so one that is held up, or gets a chunk of long lines, doesn't hold the rest up. A chunk starts at
+the first line that starts in it and ends with the last one that does, however far past the end of the chunk that line runs.
+
+Lines are UTF-8, one password each. A carriage return at the end is ignored, and empty lines are skipped. Lines longer than
+AUDIT_MAX_PASSWORD_LENGTH characters are counted but not judged: Windows doesn't take passwords that long.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "BlacklistParser.h"
+
+#include "BreachIndex.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#include "WorkerPool.h"
+
+#define AUDIT_CHUNK_SIZE (1024 * 1024)
+
+#define AUDIT_DEFAULT_TOP 20
+
+// The longest password Windows will set.
+#define AUDIT_MAX_PASSWORD_LENGTH 256
+
+#define AUDIT_VERDICT_COUNT (PasswordStrengthOverBudget + 1)
+
+typedef struct AUDIT_CONTEXT
+{
+	const AC_AUTOMATON* Automaton;
+
+	const BREACH_INDEX* Breach;
+
+	SCRATCH_POOL* Scratch;
+
+	const uint8_t* Text;
+
+	size_t Size;
+
+	// Rejections by pattern ID.
+	volatile int32_t* TokenHits;
+
+	volatile int64_t Verdicts[AUDIT_VERDICT_COUNT];
+
+	volatile int64_t TooLong;
+
+} AUDIT_CONTEXT;
+
+typedef struct AUDIT_TOKEN
+{
+	uint32_t Hits;
+
+	uint32_t PatternId;
+
+} AUDIT_TOKEN;
+
+static void AuditChunk(void* Argument, uint32_t Task)
+{
+	AUDIT_CONTEXT* Context = Argument;
+
+	uint64_t Verdicts[AUDIT_VERDICT_COUNT] = { 0 };
+
+	uint64_t TooLong = 0;
+
+	uint16_t Password[AUDIT_MAX_PASSWORD_LENGTH + 1];
+
+	size_t Position = (size_t)Task * AUDIT_CHUNK_SIZE;
+
+	size_t End = (Context->Size - Position > AUDIT_CHUNK_SIZE) ? Position + AUDIT_CHUNK_SIZE : Context->Size;
+
+	// The line that runs into this chunk belongs to the chunk before.
+	if (Position > 0 && Context->Text[Position - 1] != '\n')
+	{
+		const uint8_t* NewLine = memchr(Context->Text + Position, '\n', Context->Size - Position);
+
+		Position = (NewLine != NULL) ? (size_t)(NewLine - Context->Text) + 1 : Context->Size;
+	}
+
+	while (Position < End)
+	{
+		const uint8_t* Line = Context->Text + Position;
+
+		const uint8_t* NewLine = memchr(Line, '\n', Context->Size - Position);
+
+		size_t Length = (NewLine != NULL) ? (size_t)(NewLine - Line) : Context->Size - Position;
+
+		Position += Length + 1;
+
+		if (Length > 0 && Line[Length - 1] == '\r')
+		{
+			Length--;
+		}
+
+		if (Length == 0)
+		{
+			continue;
+		}
+
+		// A character takes at most four bytes, so a line longer than this has too many of them.
+		if (Length > AUDIT_MAX_PASSWORD_LENGTH * 4)
+		{
+			TooLong++;
+
+			continue;
+		}
+
+		size_t PasswordLength = ToolDecodeUtf8(Line, (uint32_t)Length, Password, AUDIT_MAX_PASSWORD_LENGTH + 1);
+
+		if (PasswordLength > AUDIT_MAX_PASSWORD_LENGTH)
+		{
+			TooLong++;
+
+			continue;
+		}
+
+		PLATFORM_STRING String = { (uint16_t)(PasswordLength * sizeof(uint16_t)), (uint16_t)(PasswordLength * sizeof(uint16_t)), Password };
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Context->Automaton, NULL, Context->Breach, Context->Scratch, &String, NULL, NULL, &MatchedPattern);
+
+		Verdicts[Verdict]++;
+
+		if (MatchedPattern != AC_NO_PATTERN)
+		{
+			PlatformIncrement(&Context->TokenHits[MatchedPattern]);
+		}
+	}
+
+	for (uint32_t Verdict = 0; Verdict < AUDIT_VERDICT_COUNT; Verdict++)
+	{
+		PlatformAdd64(&Context->Verdicts[Verdict], (int64_t)Verdicts[Verdict]);
+	}
+
+	PlatformAdd64(&Context->TooLong, (int64_t)TooLong);
+}
+
+static int CompareTokens(const void* Left, const void* Right)
+{
+	const AUDIT_TOKEN* LeftToken = Left;
+
+	const AUDIT_TOKEN* RightToken = Right;
+
+	// Most hits first, and then in blacklist order, so that the output is the same every run.
+	if (LeftToken->Hits != RightToken->Hits)
+	{
+		return((LeftToken->Hits < RightToken->Hits) ? 1 : -1);
+	}
+
+	return((LeftToken->PatternId > RightToken->PatternId) - (LeftToken->PatternId < RightToken->PatternId));
+}
+
+static double Share(uint64_t Part, uint64_t Whole)
+{
+	return((Whole > 0) ? (100.0 * (double)Part) / (double)Whole : 0.0);
+}
+
+static void PrintTopTokens(const TOKEN_STORE* Tokens, const volatile int32_t* TokenHits, uint32_t Top, uint64_t Rejected)
+{
+	AUDIT_TOKEN* Hit = malloc(((size_t)Tokens->TokenCount + 1) * sizeof(AUDIT_TOKEN));
+
+	uint32_t HitCount = 0;
+
+	if (Hit == NULL)
+	{
+		fprintf(stderr, "Out of memory sorting the tokens!\n");
+
+		return;
+	}
+
+	for (uint32_t PatternId = 0; PatternId < Tokens->TokenCount; PatternId++)
+	{
+		if (TokenHits[PatternId] > 0)
+		{
+			Hit[HitCount].Hits = (uint32_t)TokenHits[PatternId];
+
+			Hit[HitCount].PatternId = PatternId;
+
+			HitCount++;
+		}
+	}
+
+	qsort(Hit, HitCount, sizeof(AUDIT_TOKEN), CompareTokens);
+
+	printf("\n%lu of %lu tokens rejected at least one password. The top %lu:\n\n", (unsigned long)HitCount, (unsigned long)Tokens->TokenCount, (unsigned long)((HitCount < Top) ? HitCount : Top));
+
+	printf("%12s %10s  %s\n", "Rejections", "Share", "Token");
+
+	for (uint32_t Index = 0; Index < HitCount && Index < Top; Index++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(Tokens, Hit[Index].PatternId, &Length);
+
+		printf("%12lu %9.2f%%  %.*s\n", (unsigned long)Hit[Index].Hits, Share(Hit[Index].Hits, Rejected), (int)Length, (const char*)Token);
+	}
+
+	free(Hit);
+}
+
+int CommandAudit(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	const char* BlacklistPath = NULL;
+
+	const char* PasswordsPath = NULL;
+
+	const char* BreachPath = NULL;
+
+	uint32_t ThreadCount = PlatformProcessorCount();
+
+	uint32_t Top = AUDIT_DEFAULT_TOP;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	TOOL_TEXT_STATS Stats = { 0 };
+
+	const void* BreachImage = NULL;
+
+	size_t BreachSize = 0;
+
+	BREACH_INDEX Breach = { 0 };
+
+	SCRATCH_POOL Scratch = { 0 };
+
+	AUDIT_CONTEXT Context = { 0 };
+
+	bool Valid = true;
+
+	for (int Argument = 0; Argument < ArgumentCount && Valid; Argument++)
+	{
+		if (strcmp(Arguments[Argument], "--threads") == 0 && Argument + 1 < ArgumentCount)
+		{
+			Valid = ((ThreadCount = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0 && ThreadCount <= WORKER_POOL_MAX_THREADS);
+		}
+		else if (strcmp(Arguments[Argument], "--top") == 0 && Argument + 1 < ArgumentCount)
+		{
+			Top = (uint32_t)strtoul(Arguments[++Argument], NULL, 10);
+		}
+		else if (strcmp(Arguments[Argument], "--breach") == 0 && Argument + 1 < ArgumentCount)
+		{
+			BreachPath = Arguments[++Argument];
+		}
+		else if (BlacklistPath == NULL)
+		{
+			BlacklistPath = Arguments[Argument];
+		}
+		else if (PasswordsPath == NULL)
+		{
+			PasswordsPath = Arguments[Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+	}
+
+	if (Valid == false || PasswordsPath == NULL)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool audit <blacklist.txt> <passwords.txt> [--threads <1-%d>] [--top <n>] [--breach <breached.bin>]\n", WORKER_POOL_MAX_THREADS);
+
+		return(2);
+	}
+
+	// All of them by default: this isn't lsass, and there's nothing else for them to do.
+	if (ThreadCount > WORKER_POOL_MAX_THREADS)
+	{
+		ThreadCount = WORKER_POOL_MAX_THREADS;
+	}
+
+	double StartTime = ToolNowInSeconds();
+
+	if (ToolLoadBlacklistText(BlacklistPath, &Tokens, &Automaton, &Stats) == false)
+	{
+		goto End;
+	}
+
+	printf("%s: %lu tokens, loaded in %.2f s.\n", BlacklistPath, (unsigned long)Tokens.TokenCount, ToolNowInSeconds() - StartTime);
+
+	if (BreachPath != NULL)
+	{
+		if ((BreachImage = ToolMapFile(BreachPath, &BreachSize)) == NULL)
+		{
+			goto End;
+		}
+
+		BREACH_INDEX_STATUS Status = BreachIndexOpen(BreachImage, BreachSize, &Breach);
+
+		if (Status != BreachIndexOk)
+		{
+			fprintf(stderr, "%s is not usable: %s\n", BreachPath, BreachIndexStatusString(Status));
+
+			goto End;
+		}
+
+		Context.Breach = &Breach;
+	}
+
+	// One counter for every token, whether it ever rejects anything or not, so that counting a rejection is a single increment.
+	if ((Context.TokenHits = calloc((size_t)Tokens.TokenCount + 1, sizeof(int32_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if ((Context.Text = ToolMapFile(PasswordsPath, &Context.Size)) == NULL)
+	{
+		goto End;
+	}
+
+	// Set up once and shared by every thread, as the DLL does.
+	ScratchPoolInitialize(&Scratch);
+
+	Context.Automaton = Automaton;
+
+	Context.Scratch = &Scratch;
+
+	WORKER_POOL Pool;
+
+	WorkerPoolInitialize(&Pool, ThreadCount);
+
+	uint64_t ChunkCount = (Context.Size + AUDIT_CHUNK_SIZE - 1) / AUDIT_CHUNK_SIZE;
+
+	if (ChunkCount > UINT32_MAX)
+	{
+		fprintf(stderr, "%s is too big to audit in one go!\n", PasswordsPath);
+
+		goto End;
+	}
+
+	StartTime = ToolNowInSeconds();
+
+	WorkerPoolRun(&Pool, (uint32_t)ChunkCount, AuditChunk, &Context);
+
+	double Elapsed = ToolNowInSeconds() - StartTime;
+
+	uint64_t Judged = 0;
+
+	uint64_t Rejected = 0;
+
+	for (uint32_t Verdict = 0; Verdict < AUDIT_VERDICT_COUNT; Verdict++)
+	{
+		Judged += (uint64_t)Context.Verdicts[Verdict];
+
+		if (PasswordVerdictRejects((PASSWORD_VERDICT)Verdict))
+		{
+			Rejected += (uint64_t)Context.Verdicts[Verdict];
+		}
+	}
+
+	printf("%s: %llu passwords judged", PasswordsPath, (unsigned long long)Judged);
+
+	if (Context.TooLong > 0)
+	{
+		printf(", %llu more longer than %d characters skipped", (unsigned long long)Context.TooLong, AUDIT_MAX_PASSWORD_LENGTH);
+	}
+
+	printf(".\n\n");
+
+	printf("%-38s %14s %9s\n", "Verdict", "Passwords", "Share");
+
+	for (uint32_t Verdict = 0; Verdict < AUDIT_VERDICT_COUNT; Verdict++)
+	{
+		if (Context.Verdicts[Verdict] > 0)
+		{
+			printf("%-38s %14llu %8.2f%%\n", PasswordVerdictString((PASSWORD_VERDICT)Verdict), (unsigned long long)Context.Verdicts[Verdict], Share((uint64_t)Context.Verdicts[Verdict], Judged));
+		}
+	}
+
+	printf("\nAccepted %llu (%.2f%%), rejected %llu (%.2f%%).\n", (unsigned long long)(Judged - Rejected), Share(Judged - Rejected, Judged), (unsigned long long)Rejected, Share(Rejected, Judged));
+
+	if (Top > 0)
+	{
+		PrintTopTokens(&Tokens, Context.TokenHits, Top, Rejected);
+	}
+
+	printf("\n%.2f s on %lu threads: %.0f passwords/s, %.1f MB/s.\n",
+		Elapsed,
+		(unsigned long)WorkerPoolThreadCount(&Pool),
+		(double)Judged / Elapsed,
+		((double)Context.Size / (1024.0 * 1024.0)) / Elapsed);
+
+	ExitCode = 0;
+
+End:
+
+	ToolUnmapFile(Context.Text, Context.Size);
+
+	ToolUnmapFile(BreachImage, BreachSize);
+
+	ScratchPoolDestroy(&Scratch);
+
+	free((void*)Context.TokenHits);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(ExitCode);
+}
@@ -0,0 +1,465 @@
+/*
+ToolBench.c
+
+The bench command: how long PasswordFilter takes to judge a password, and how long a reload takes, as the blacklist grows.
+
+For each blacklist size, a synthetic blacklist is generated and loaded through BlacklistLoad, the same code the DLL uses on
+PassFiltExBlacklist.txt, and through BlacklistImageOpen, which is what the DLL does with a compiled image. Then batches of
+synthetic passwords are pushed one at a time through PasswordCheck, scratch pool, hashing and all, which is everything
+PasswordFilter does apart from logging. Every call is timed separately, so the tail of the distribution is visible and not
+just the average. Every password is checked for the same user, TOOL_ACCOUNT_NAME, since PasswordFilter always looks for the
+user's names as well.
+
+Passwords come in two kinds. A hit is built around a token from the blacklist, as long a one as fits, padded out with digits
+and punctuation; it is rejected whenever the token is at least half of it, which is impossible for the longer lengths.
+A miss is random printable ASCII, which now and then happens to contain a token anyway. The rejected column says what
+actually happened.
+
+The inputs come from a fixed seed, so two runs on the same machine see exactly the same blacklists and passwords and can be
+compared directly.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistImage.h"
+
+#include "BreachIndex.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#define BENCH_DEFAULT_MAX_TOKENS 10000000
+
+#define BENCH_DEFAULT_CHECKS 100000
+
+#define BENCH_MIN_TOKEN_LENGTH 4
+
+#define BENCH_MAX_TOKEN_LENGTH 16
+
+#define BENCH_MAX_PASSWORD_LENGTH 64
+
+// Loads are repeated until they add up to at least this long, so that loads per second means something for small lists.
+#define BENCH_LOAD_SECONDS 1.0
+
+// How many tokens to look at when picking the one to build a hit around.
+#define BENCH_TOKEN_PICKS 16
+
+static const uint32_t gBenchTokenCounts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+static const uint32_t gBenchPasswordLengths[] = { 8, 12, 16, 32, 64 };
+
+static const uint32_t gBenchHitPercentages[] = { 0, 10, 50, 100 };
+
+// Weighted by how often letters turn up in English, so that generated tokens share prefixes the way real word lists do.
+static const char gBenchLetters[] = "eeeeeeeeeeeetttttttttaaaaaaaaooooooooiiiiiiinnnnnnnsssssshhhhhhrrrrrrddddlllluuuccmmmwwffggyyppbbvkjxqz";
+
+static const char gBenchFiller[] = "0123456789!@#$%^&*-_=+.";
+
+typedef struct BENCH_RESULT
+{
+	uint64_t Rejected;
+
+	TOOL_LATENCY_SUMMARY Latency;
+
+	double ChecksPerSecond;
+
+} BENCH_RESULT;
+
+static char RandomCharacter(const char* Characters, size_t Count)
+{
+	return(Characters[ToolRandom() % Count]);
+}
+
+// One token per line, a fifth of them with a year or a PIN on the end, as in a real list. Also used by the storm command.
+uint8_t* ToolGenerateBlacklist(uint32_t TokenCount, size_t* Size)
+{
+	size_t Capacity = (size_t)TokenCount * (BENCH_MAX_TOKEN_LENGTH + 1);
+
+	uint8_t* Text = malloc(Capacity);
+
+	size_t Length = 0;
+
+	if (Text == NULL)
+	{
+		return(NULL);
+	}
+
+	for (uint32_t Token = 0; Token < TokenCount; Token++)
+	{
+		uint32_t TokenLength = BENCH_MIN_TOKEN_LENGTH + (uint32_t)(ToolRandom() % (BENCH_MAX_TOKEN_LENGTH - BENCH_MIN_TOKEN_LENGTH + 1));
+
+		uint32_t DigitCount = ((ToolRandom() % 5) == 0) ? (uint32_t)(1 + (ToolRandom() % 4)) : 0;
+
+		if (DigitCount > TokenLength - BENCH_MIN_TOKEN_LENGTH)
+		{
+			DigitCount = TokenLength - BENCH_MIN_TOKEN_LENGTH;
+		}
+
+		for (uint32_t Index = 0; Index < TokenLength; Index++)
+		{
+			Text[Length++] = (Index < TokenLength - DigitCount) ? (uint8_t)RandomCharacter(gBenchLetters, sizeof(gBenchLetters) - 1) : (uint8_t)('0' + (ToolRandom() % 10));
+		}
+
+		Text[Length++] = '\n';
+	}
+
+	*Size = Length;
+
+	return(Text);
+}
+
+// A hit is built around a token from Tokens; see the top of this file.
+void ToolMakePassword(uint16_t* Password, uint32_t Length, const TOKEN_STORE* Tokens, bool IsHit)
+{
+	if (IsHit == false || Tokens->TokenCount == 0)
+	{
+		for (uint32_t Index = 0; Index < Length; Index++)
+		{
+			Password[Index] = (uint16_t)(0x21 + (ToolRandom() % 94));
+		}
+
+		return;
+	}
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Password[Index] = (uint16_t)RandomCharacter(gBenchFiller, sizeof(gBenchFiller) - 1);
+	}
+
+	const uint8_t* Token = NULL;
+
+	uint32_t TokenLength = 0;
+
+	for (int Pick = 0; Pick < BENCH_TOKEN_PICKS; Pick++)
+	{
+		uint32_t CandidateLength = 0;
+
+		const uint8_t* Candidate = TokenStoreGet(Tokens, (uint32_t)(ToolRandom() % Tokens->TokenCount), &CandidateLength);
+
+		if (CandidateLength <= Length && CandidateLength > TokenLength)
+		{
+			Token = Candidate;
+
+			TokenLength = CandidateLength;
+
+			if (TokenLength * 2 >= Length)
+			{
+				break;
+			}
+		}
+	}
+
+	uint32_t Offset = (uint32_t)(ToolRandom() % (Length - TokenLength + 1));
+
+	for (uint32_t Index = 0; Index < TokenLength; Index++)
+	{
+		Password[Offset + Index] = Token[Index];
+	}
+
+	// Make the password go through case folding the way a real one would. Never the last character, which isn't folded.
+	if (TokenLength > 0 && Offset + 1 < Length && Password[Offset] >= 'a' && Password[Offset] <= 'z')
+	{
+		Password[Offset] = (uint16_t)(Password[Offset] - 0x20);
+	}
+}
+
+static void RunChecks(const AC_AUTOMATON* Automaton, const BREACH_INDEX* Breach, SCRATCH_POOL* Scratch, const TOOL_NAMES* Names, const uint16_t* Passwords, uint32_t Length, uint64_t Checks, uint64_t* Latencies, BENCH_RESULT* Result)
+{
+	memset(Result, 0, sizeof(BENCH_RESULT));
+
+	double StartTime = ToolNowInSeconds();
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		PLATFORM_STRING Password = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Passwords + (Check * Length) };
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		uint64_t CheckStart = PlatformTimestamp();
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, Breach, Scratch, &Password, &Names->AccountName, &Names->FullName, &MatchedPattern);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		Result->Rejected += PasswordVerdictRejects(Verdict);
+	}
+
+	Result->ChecksPerSecond = (double)Checks / (ToolNowInSeconds() - StartTime);
+
+	ToolSummarizeLatencies(Latencies, Checks, &Result->Latency);
+}
+
+// Loads Text over and over and keeps the last result. Returns the average time per load in seconds, or a negative number if it failed.
+static double BenchTextLoad(const uint8_t* Text, size_t TextSize, TOKEN_STORE* Tokens, AC_AUTOMATON** Automaton, BLACKLIST_LOAD_STATS* Stats)
+{
+	uint32_t Loads = 0;
+
+	double StartTime = ToolNowInSeconds();
+
+	double Elapsed = 0;
+
+	do
+	{
+		if (Loads > 0)
+		{
+			AcDestroy(*Automaton);
+
+			TokenStoreFree(Tokens);
+		}
+
+		BLACKLIST_LOAD_STATUS Status = BlacklistLoad(Text, TextSize, NULL, Tokens, NULL, Automaton, Stats);
+
+		if (Status != BlacklistLoadOk)
+		{
+			fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(Status));
+
+			return(-1.0);
+		}
+
+		Loads++;
+
+		Elapsed = ToolNowInSeconds() - StartTime;
+
+	} while (Elapsed < BENCH_LOAD_SECONDS);
+
+	return(Elapsed / Loads);
+}
+
+// The same, for a compiled image in memory. Returns a negative number if the image could not be built or opened.
+static double BenchImageLoad(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton)
+{
+	size_t ImageSize = BlacklistImageSize(Tokens, Automaton);
+
+	void* Image = malloc(ImageSize);
+
+	uint32_t Loads = 0;
+
+	double Elapsed = -1.0;
+
+	if (Image == NULL || BlacklistImageWrite(Tokens, Automaton, Image, ImageSize) == false)
+	{
+		fprintf(stderr, "Unable to build a blacklist image!\n");
+
+		goto End;
+	}
+
+	double StartTime = ToolNowInSeconds();
+
+	do
+	{
+		TOKEN_STORE ImageTokens;
+
+		AC_AUTOMATON* ImageAutomaton = NULL;
+
+		if (BlacklistImageOpen(Image, ImageSize, &ImageTokens, NULL, &ImageAutomaton) != BlacklistImageOk)
+		{
+			fprintf(stderr, "Unable to open the blacklist image!\n");
+
+			Elapsed = -1.0;
+
+			goto End;
+		}
+
+		AcDestroy(ImageAutomaton);
+
+		TokenStoreFree(&ImageTokens);
+
+		Loads++;
+
+		Elapsed = ToolNowInSeconds() - StartTime;
+
+	} while (Elapsed < BENCH_LOAD_SECONDS);
+
+	Elapsed /= Loads;
+
+End:
+
+	free(Image);
+
+	return(Elapsed);
+}
+
+int CommandBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t MaxTokens = BENCH_DEFAULT_MAX_TOKENS;
+
+	uint64_t Checks = BENCH_DEFAULT_CHECKS;
+
+	const char* BreachPath = NULL;
+
+	size_t BreachSize = 0;
+
+	const void* BreachImage = NULL;
+
+	BREACH_INDEX Breach;
+
+	uint16_t* Passwords = NULL;
+
+	uint64_t* Latencies = NULL;
+
+	SCRATCH_POOL Scratch;
+
+	TOOL_NAMES Names;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		if (strcmp(Arguments[Argument], "--max-tokens") == 0 && Argument + 1 < ArgumentCount)
+		{
+			MaxTokens = strtoull(Arguments[++Argument], NULL, 10);
+		}
+		else if (strcmp(Arguments[Argument], "--checks") == 0 && Argument + 1 < ArgumentCount)
+		{
+			Checks = strtoull(Arguments[++Argument], NULL, 10);
+		}
+		else if (strcmp(Arguments[Argument], "--breach") == 0 && Argument + 1 < ArgumentCount)
+		{
+			BreachPath = Arguments[++Argument];
+		}
+		else
+		{
+			fprintf(stderr, "Usage: PassFiltExTool bench [--max-tokens <n>] [--checks <n>] [--breach <breached.bin>]\n");
+
+			return(2);
+		}
+	}
+
+	if (Checks == 0 || MaxTokens == 0)
+	{
+		fprintf(stderr, "The number of checks and tokens must be positive numbers.\n");
+
+		return(2);
+	}
+
+	// Set up once, as InitializeChangeNotify does.
+	ScratchPoolInitialize(&Scratch);
+
+	ToolMakeNames(&Names, TOOL_ACCOUNT_NAME, TOOL_FULL_NAME);
+
+	if (BreachPath != NULL)
+	{
+		if ((BreachImage = ToolMapFile(BreachPath, &BreachSize)) == NULL)
+		{
+			goto End;
+		}
+
+		BREACH_INDEX_STATUS Status = BreachIndexOpen(BreachImage, BreachSize, &Breach);
+
+		if (Status != BreachIndexOk)
+		{
+			fprintf(stderr, "%s is not usable: %s\n", BreachPath, BreachIndexStatusString(Status));
+
+			goto End;
+		}
+	}
+
+	if ((Passwords = malloc((size_t)Checks * BENCH_MAX_PASSWORD_LENGTH * sizeof(uint16_t))) == NULL || (Latencies = malloc((size_t)Checks * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	printf("%llu checks per row%s%s.\n", (unsigned long long)Checks, (BreachPath != NULL) ? ", breach index " : "", (BreachPath != NULL) ? BreachPath : "");
+
+	for (size_t SizeIndex = 0; SizeIndex < sizeof(gBenchTokenCounts) / sizeof(gBenchTokenCounts[0]) && gBenchTokenCounts[SizeIndex] <= MaxTokens; SizeIndex++)
+	{
+		size_t TextSize = 0;
+
+		uint8_t* Text = ToolGenerateBlacklist(gBenchTokenCounts[SizeIndex], &TextSize);
+
+		TOKEN_STORE Tokens = { 0 };
+
+		AC_AUTOMATON* Automaton = NULL;
+
+		BLACKLIST_LOAD_STATS Stats = { 0 };
+
+		if (Text == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+
+		double TextLoadSeconds = BenchTextLoad(Text, TextSize, &Tokens, &Automaton, &Stats);
+
+		free(Text);
+
+		if (TextLoadSeconds < 0)
+		{
+			goto End;
+		}
+
+		double ImageLoadSeconds = BenchImageLoad(&Tokens, Automaton);
+
+		printf("\n%lu lines, %lu unique tokens, %lu automaton states, %llu bytes in memory.\n", (unsigned long)gBenchTokenCounts[SizeIndex], (unsigned long)Tokens.TokenCount, (unsigned long)Automaton->StateCount, (unsigned long long)(TokenStoreMemoryUsage(&Tokens) + AcMemoryUsage(Automaton)));
+
+		printf("  text load:  %10.3f ms, %10.2f loads/s\n", TextLoadSeconds * 1e3, 1.0 / TextLoadSeconds);
+
+		if (ImageLoadSeconds > 0)
+		{
+			printf("  image load: %10.3f ms, %10.2f loads/s\n", ImageLoadSeconds * 1e3, 1.0 / ImageLoadSeconds);
+		}
+
+		printf("  length   hits  rejected    p50 ns    p99 ns  p99.9 ns     checks/s\n");
+
+		for (size_t LengthIndex = 0; LengthIndex < sizeof(gBenchPasswordLengths) / sizeof(gBenchPasswordLengths[0]); LengthIndex++)
+		{
+			uint32_t Length = gBenchPasswordLengths[LengthIndex];
+
+			for (size_t HitIndex = 0; HitIndex < sizeof(gBenchHitPercentages) / sizeof(gBenchHitPercentages[0]); HitIndex++)
+			{
+				BENCH_RESULT Result;
+
+				for (uint64_t Check = 0; Check < Checks; Check++)
+				{
+					ToolMakePassword(Passwords + (Check * Length), Length, &Tokens, (ToolRandom() % 100) < gBenchHitPercentages[HitIndex]);
+				}
+
+				RunChecks(Automaton, (BreachPath != NULL) ? &Breach : NULL, &Scratch, &Names, Passwords, Length, Checks, Latencies, &Result);
+
+				printf("  %6lu  %4lu%%  %7.2f%%  %8llu  %8llu  %8llu  %11.0f\n",
+					(unsigned long)Length,
+					(unsigned long)gBenchHitPercentages[HitIndex],
+					(100.0 * (double)Result.Rejected) / (double)Checks,
+					(unsigned long long)Result.Latency.P50,
+					(unsigned long long)Result.Latency.P99,
+					(unsigned long long)Result.Latency.P999,
+					Result.ChecksPerSecond);
+			}
+		}
+
+		fflush(stdout);
+
+		AcDestroy(Automaton);
+
+		TokenStoreFree(&Tokens);
+	}
+
+	ExitCode = 0;
+
+End:
+
+	free(Passwords);
+
+	free(Latencies);
+
+	ToolUnmapFile(BreachImage, BreachSize);
+
+	ScratchPoolDestroy(&Scratch);
+
+	return(ExitCode);
+}
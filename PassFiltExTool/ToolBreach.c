@@ -0,0 +1,815 @@
+/*
+ToolBreach.c
+
+The breach-build, breach-verify and breach-bench commands. See PassFiltExTool.c for usage and BreachIndex.c for the format.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "BlacklistImage.h"
+
+#include "BloomFilter.h"
+
+#include "BreachIndex.h"
+
+#include "PassFiltExTool.h"
+
+// Lines in a password file can be longer than blacklist tokens; a hash line is 32 hex digits plus a count.
+#define BREACH_MAX_LINE_LENGTH (BLACKLIST_PARSER_MAX_LINE - 1)
+
+// Queries are generated up front so that the timed loop measures lookups and nothing else.
+#define BREACH_BENCH_QUERY_COUNT (1024 * 1024)
+
+// About 1% false positives. Each bit per key costs an eighth of a byte per hash, against 16 bytes for the hash itself.
+#define BREACH_DEFAULT_FILTER_BITS 10
+
+// Random hashes probed to measure the filter's false positive rate after it is built.
+#define BREACH_FILTER_PROBE_COUNT 1000000
+
+typedef enum BREACH_ADD_RESULT
+{
+	BreachAddAdded,
+
+	BreachAddDuplicate,
+
+	BreachAddUnsorted
+
+} BREACH_ADD_RESULT;
+
+// Writes an index front to back. The header and fanout table can only be filled in at the end, so space is left for them.
+typedef struct BREACH_WRITER
+{
+	FILE* File;
+
+	uint64_t* BucketCounts;
+
+	uint32_t FilterBitsPerKey;
+
+	uint64_t HashCount;
+
+	uint64_t Duplicates;
+
+	uint32_t Checksum;
+
+	uint8_t LastHash[BREACH_INDEX_HASH_SIZE];
+
+	BREACH_INDEX_HEADER Header;
+
+} BREACH_WRITER;
+
+typedef struct BREACH_BUILD_CONTEXT
+{
+	bool Plaintext;
+
+	BREACH_WRITER* Writer;
+
+	// Used instead of Writer once the input turns out not to be sorted.
+	uint8_t* Hashes;
+
+	uint64_t HashCount;
+
+	uint64_t HashCapacity;
+
+	uint64_t MalformedLines;
+
+	bool Unsorted;
+
+	bool Failed;
+
+} BREACH_BUILD_CONTEXT;
+
+typedef struct BREACH_LOOKUP_CONTEXT
+{
+	const BREACH_INDEX* Index;
+
+	uint64_t Passwords;
+
+	uint64_t Found;
+
+} BREACH_LOOKUP_CONTEXT;
+
+static int HexDigit(uint8_t Character)
+{
+	if (Character >= '0' && Character <= '9')
+	{
+		return(Character - '0');
+	}
+
+	if (Character >= 'a' && Character <= 'f')
+	{
+		return(Character - 'a' + 10);
+	}
+
+	if (Character >= 'A' && Character <= 'F')
+	{
+		return(Character - 'A' + 10);
+	}
+
+	return(-1);
+}
+
+// "8846F7EAEE8FB117AD06BDD830B7586C" or "8846F7EAEE8FB117AD06BDD830B7586C:12345"
+static bool ParseHashLine(const uint8_t* Line, uint32_t Length, uint8_t Hash[BREACH_INDEX_HASH_SIZE])
+{
+	if (Length < BREACH_INDEX_HASH_SIZE * 2 || (Length > BREACH_INDEX_HASH_SIZE * 2 && Line[BREACH_INDEX_HASH_SIZE * 2] != ':'))
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < BREACH_INDEX_HASH_SIZE; Index++)
+	{
+		int High = HexDigit(Line[Index * 2]);
+
+		int Low = HexDigit(Line[Index * 2 + 1]);
+
+		if (High < 0 || Low < 0)
+		{
+			return(false);
+		}
+
+		Hash[Index] = (uint8_t)((High << 4) | Low);
+	}
+
+	return(true);
+}
+
+static bool BreachWriterBegin(BREACH_WRITER* Writer, const char* Path, uint32_t FilterBitsPerKey)
+{
+	BREACH_INDEX_HEADER Placeholder;
+
+	memset(Writer, 0, sizeof(BREACH_WRITER));
+
+	Writer->FilterBitsPerKey = FilterBitsPerKey;
+
+	if ((Writer->BucketCounts = calloc(BREACH_INDEX_BUCKET_COUNT + 1, sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(false);
+	}
+
+	// Opened for reading as well, because the filter is built from the records after they have all been written.
+	if ((Writer->File = fopen(Path, "w+b")) == NULL)
+	{
+		fprintf(stderr, "Unable to create %s!\n", Path);
+
+		return(false);
+	}
+
+	memset(&Placeholder, 0, sizeof(Placeholder));
+
+	if (fwrite(&Placeholder, sizeof(Placeholder), 1, Writer->File) != 1 ||
+		fwrite(Writer->BucketCounts, sizeof(uint64_t), BREACH_INDEX_BUCKET_COUNT + 1, Writer->File) != BREACH_INDEX_BUCKET_COUNT + 1)
+	{
+		fprintf(stderr, "Error writing %s!\n", Path);
+
+		return(false);
+	}
+
+	return(true);
+}
+
+static BREACH_ADD_RESULT BreachWriterAdd(BREACH_WRITER* Writer, const uint8_t Hash[BREACH_INDEX_HASH_SIZE])
+{
+	if (Writer->HashCount > 0)
+	{
+		int Comparison = memcmp(Hash, Writer->LastHash, BREACH_INDEX_HASH_SIZE);
+
+		if (Comparison == 0)
+		{
+			Writer->Duplicates++;
+
+			return(BreachAddDuplicate);
+		}
+
+		if (Comparison < 0)
+		{
+			return(BreachAddUnsorted);
+		}
+	}
+
+	// Write errors are sticky, and caught by ferror in BreachWriterFinish.
+	fwrite(Hash, 1, BREACH_INDEX_HASH_SIZE, Writer->File);
+
+	Writer->Checksum = BlacklistImageCrc32(Writer->Checksum, Hash, BREACH_INDEX_HASH_SIZE);
+
+	Writer->BucketCounts[BreachIndexBucket(Hash)]++;
+
+	memcpy(Writer->LastHash, Hash, BREACH_INDEX_HASH_SIZE);
+
+	Writer->HashCount++;
+
+	return(BreachAddAdded);
+}
+
+/*
+Reads the records back from the file and adds every one of them to a Bloom filter, then appends the filter. Streaming the
+records to disk first means the filter is the only thing that has to fit in memory, and it is an eighth of a byte per bit.
+The false positive rate is measured rather than estimated, so the DLL can report what it really is.
+
+*/
+static bool BreachWriterAppendFilter(BREACH_WRITER* Writer)
+{
+	bool Result = false;
+
+	BLOOM_BLOCK* Filter = NULL;
+
+	uint8_t* Chunk = NULL;
+
+	uint64_t BlockCount = Writer->Header.FilterBlockCount;
+
+	size_t ChunkHashes = 65536;
+
+	if (BlockCount == 0)
+	{
+		return(true);
+	}
+
+	if (BlockCount > ((size_t)-1) / sizeof(BLOOM_BLOCK) ||
+		(Filter = calloc((size_t)BlockCount, sizeof(BLOOM_BLOCK))) == NULL ||
+		(Chunk = malloc(ChunkHashes * BREACH_INDEX_HASH_SIZE)) == NULL)
+	{
+		fprintf(stderr, "Out of memory building a %llu byte filter!\n", (unsigned long long)(BlockCount * sizeof(BLOOM_BLOCK)));
+
+		goto End;
+	}
+
+	// The records section starts beyond 2 GB only if the fanout table does, which it doesn't, so fseek's long is wide enough.
+	if (fflush(Writer->File) != 0 || fseek(Writer->File, (long)Writer->Header.RecordsOffset, SEEK_SET) != 0)
+	{
+		goto End;
+	}
+
+	for (uint64_t Remaining = Writer->HashCount; Remaining > 0;)
+	{
+		size_t Count = (Remaining < ChunkHashes) ? (size_t)Remaining : ChunkHashes;
+
+		if (fread(Chunk, BREACH_INDEX_HASH_SIZE, Count, Writer->File) != Count)
+		{
+			goto End;
+		}
+
+		for (size_t Hash = 0; Hash < Count; Hash++)
+		{
+			BloomFilterAdd(Filter, BlockCount, BreachIndexFilterKey(Chunk + (Hash * BREACH_INDEX_HASH_SIZE)));
+		}
+
+		Remaining -= Count;
+	}
+
+	uint64_t Padding = Writer->Header.FilterOffset - (Writer->Header.RecordsOffset + (Writer->HashCount * BREACH_INDEX_HASH_SIZE));
+
+	static const uint8_t Zeroes[BREACH_INDEX_FILTER_ALIGNMENT] = { 0 };
+
+	// Switching from reading to writing needs a seek in between.
+	if (fseek(Writer->File, 0, SEEK_END) != 0 ||
+		fwrite(Zeroes, 1, (size_t)Padding, Writer->File) != Padding ||
+		fwrite(Filter, sizeof(BLOOM_BLOCK), (size_t)BlockCount, Writer->File) != BlockCount)
+	{
+		goto End;
+	}
+
+	Writer->Header.FilterChecksum = BlacklistImageCrc32(0, Filter, (size_t)BlockCount * sizeof(BLOOM_BLOCK));
+
+	uint32_t FalsePositives = 0;
+
+	for (uint32_t Probe = 0; Probe < BREACH_FILTER_PROBE_COUNT; Probe++)
+	{
+		FalsePositives += BloomFilterMayContain(Filter, BlockCount, ToolRandom());
+	}
+
+	Writer->Header.FilterFalsePositivesPerMillion = (uint32_t)(((uint64_t)FalsePositives * 1000000) / BREACH_FILTER_PROBE_COUNT);
+
+	Result = true;
+
+End:
+
+	free(Chunk);
+
+	free(Filter);
+
+	return(Result);
+}
+
+// Turns the bucket counts into the fanout table, appends the filter, and fills in the space left at the front of the file.
+static bool BreachWriterFinish(BREACH_WRITER* Writer, const char* Path)
+{
+	uint64_t Total = 0;
+
+	for (uint32_t Bucket = 0; Bucket <= BREACH_INDEX_BUCKET_COUNT; Bucket++)
+	{
+		uint64_t Count = Writer->BucketCounts[Bucket];
+
+		Writer->BucketCounts[Bucket] = Total;
+
+		Total += Count;
+	}
+
+	BreachIndexInitializeHeader(&Writer->Header, Writer->HashCount, BloomFilterBlockCount(Writer->HashCount, Writer->FilterBitsPerKey));
+
+	Writer->Header.RecordsChecksum = Writer->Checksum;
+
+	if (ferror(Writer->File) ||
+		BreachWriterAppendFilter(Writer) == false ||
+		fseek(Writer->File, 0, SEEK_SET) != 0 ||
+		fwrite(&Writer->Header, sizeof(BREACH_INDEX_HEADER), 1, Writer->File) != 1 ||
+		fwrite(Writer->BucketCounts, sizeof(uint64_t), BREACH_INDEX_BUCKET_COUNT + 1, Writer->File) != BREACH_INDEX_BUCKET_COUNT + 1)
+	{
+		fprintf(stderr, "Error writing %s!\n", Path);
+
+		return(false);
+	}
+
+	int CloseResult = fclose(Writer->File);
+
+	Writer->File = NULL;
+
+	if (CloseResult != 0)
+	{
+		fprintf(stderr, "Error writing %s!\n", Path);
+
+		return(false);
+	}
+
+	return(true);
+}
+
+static void BreachWriterDestroy(BREACH_WRITER* Writer)
+{
+	if (Writer->File != NULL)
+	{
+		fclose(Writer->File);
+	}
+
+	free(Writer->BucketCounts);
+
+	memset(Writer, 0, sizeof(BREACH_WRITER));
+}
+
+static bool BreachBuildLine(void* Context, const uint8_t* Line, uint32_t Length)
+{
+	BREACH_BUILD_CONTEXT* BuildContext = Context;
+
+	uint8_t Hash[BREACH_INDEX_HASH_SIZE];
+
+	if (BuildContext->Plaintext)
+	{
+		uint16_t Password[BLACKLIST_PARSER_MAX_LINE];
+
+		size_t PasswordLength = ToolDecodeUtf8(Line, Length, Password, BLACKLIST_PARSER_MAX_LINE);
+
+		NtlmHash(Password, PasswordLength, Hash);
+	}
+	else if (ParseHashLine(Line, Length, Hash) == false)
+	{
+		BuildContext->MalformedLines++;
+
+		return(true);
+	}
+
+	if (BuildContext->Writer != NULL)
+	{
+		if (BreachWriterAdd(BuildContext->Writer, Hash) == BreachAddUnsorted)
+		{
+			BuildContext->Unsorted = true;
+
+			return(false);
+		}
+
+		return(true);
+	}
+
+	if (BuildContext->HashCount == BuildContext->HashCapacity)
+	{
+		uint64_t NewCapacity = (BuildContext->HashCapacity == 0) ? 65536 : BuildContext->HashCapacity * 2;
+
+		uint8_t* NewHashes = NULL;
+
+		if (NewCapacity > ((size_t)-1) / BREACH_INDEX_HASH_SIZE || (NewHashes = realloc(BuildContext->Hashes, (size_t)NewCapacity * BREACH_INDEX_HASH_SIZE)) == NULL)
+		{
+			BuildContext->Failed = true;
+
+			return(false);
+		}
+
+		BuildContext->Hashes = NewHashes;
+
+		BuildContext->HashCapacity = NewCapacity;
+	}
+
+	memcpy(BuildContext->Hashes + (BuildContext->HashCount * BREACH_INDEX_HASH_SIZE), Hash, BREACH_INDEX_HASH_SIZE);
+
+	BuildContext->HashCount++;
+
+	return(true);
+}
+
+static int CompareHashes(const void* Left, const void* Right)
+{
+	return(memcmp(Left, Right, BREACH_INDEX_HASH_SIZE));
+}
+
+int CommandBreachBuild(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	BREACH_BUILD_CONTEXT BuildContext = { 0 };
+
+	BREACH_WRITER Writer = { 0 };
+
+	TOOL_TEXT_STATS Stats = { 0 };
+
+	uint32_t FilterBitsPerKey = BREACH_DEFAULT_FILTER_BITS;
+
+	while (ArgumentCount > 2)
+	{
+		if (strcmp(Arguments[0], "--plaintext") == 0)
+		{
+			BuildContext.Plaintext = true;
+
+			ArgumentCount--;
+
+			Arguments++;
+		}
+		else if (strcmp(Arguments[0], "--filter-bits") == 0 && ArgumentCount > 3)
+		{
+			FilterBitsPerKey = (uint32_t)strtoul(Arguments[1], NULL, 10);
+
+			ArgumentCount -= 2;
+
+			Arguments += 2;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (ArgumentCount != 2 || FilterBitsPerKey > 64)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool breach-build [--plaintext] [--filter-bits <0-64>] <input.txt> <breached.bin>\n");
+
+		return(2);
+	}
+
+	const char* InputPath = Arguments[0];
+
+	const char* OutputPath = Arguments[1];
+
+	// Hash lists are normally published sorted, and then they can go straight to disk, however big they are.
+	if (BuildContext.Plaintext == false)
+	{
+		if (BreachWriterBegin(&Writer, OutputPath, FilterBitsPerKey) == false)
+		{
+			goto End;
+		}
+
+		BuildContext.Writer = &Writer;
+
+		if (ToolParseTextFile(InputPath, BREACH_MAX_LINE_LENGTH, BreachBuildLine, &BuildContext, &Stats) == false)
+		{
+			goto End;
+		}
+
+		if (BuildContext.Unsorted == false)
+		{
+			if (BreachWriterFinish(&Writer, OutputPath) == false)
+			{
+				goto End;
+			}
+
+			goto Done;
+		}
+
+		printf("%s is not sorted by hash, so it will be sorted in memory.\n", InputPath);
+
+		BreachWriterDestroy(&Writer);
+
+		BuildContext.Writer = NULL;
+
+		BuildContext.MalformedLines = 0;
+	}
+
+	if (ToolParseTextFile(InputPath, BREACH_MAX_LINE_LENGTH, BreachBuildLine, &BuildContext, &Stats) == false)
+	{
+		goto End;
+	}
+
+	if (BuildContext.Failed)
+	{
+		fprintf(stderr, "Out of memory after %llu hashes!\n", (unsigned long long)BuildContext.HashCount);
+
+		goto End;
+	}
+
+	qsort(BuildContext.Hashes, (size_t)BuildContext.HashCount, BREACH_INDEX_HASH_SIZE, CompareHashes);
+
+	if (BreachWriterBegin(&Writer, OutputPath, FilterBitsPerKey) == false)
+	{
+		goto End;
+	}
+
+	for (uint64_t Index = 0; Index < BuildContext.HashCount; Index++)
+	{
+		BreachWriterAdd(&Writer, BuildContext.Hashes + (Index * BREACH_INDEX_HASH_SIZE));
+	}
+
+	if (BreachWriterFinish(&Writer, OutputPath) == false)
+	{
+		goto End;
+	}
+
+Done:
+
+	printf("Read %llu lines (%llu malformed, %llu truncated) from %s\n", (unsigned long long)Stats.LinesRead, (unsigned long long)BuildContext.MalformedLines, (unsigned long long)Stats.TruncatedLines, InputPath);
+
+	printf("Wrote %llu unique hashes (%llu duplicates dropped) to %s\n", (unsigned long long)Writer.HashCount, (unsigned long long)Writer.Duplicates, OutputPath);
+
+	if (Writer.Header.FilterBlockCount > 0)
+	{
+		printf("Bloom filter: %llu bytes, %u bits per hash, %.3f%% false positives\n", (unsigned long long)(Writer.Header.FilterBlockCount * sizeof(BLOOM_BLOCK)), FilterBitsPerKey, Writer.Header.FilterFalsePositivesPerMillion / 10000.0);
+	}
+
+	ExitCode = 0;
+
+End:
+
+	BreachWriterDestroy(&Writer);
+
+	free(BuildContext.Hashes);
+
+	return(ExitCode);
+}
+
+static bool BreachLookupLine(void* Context, const uint8_t* Line, uint32_t Length)
+{
+	BREACH_LOOKUP_CONTEXT* LookupContext = Context;
+
+	uint16_t Password[BLACKLIST_PARSER_MAX_LINE];
+
+	uint8_t Hash[BREACH_INDEX_HASH_SIZE];
+
+	NtlmHash(Password, ToolDecodeUtf8(Line, Length, Password, BLACKLIST_PARSER_MAX_LINE), Hash);
+
+	LookupContext->Passwords++;
+
+	if (BreachIndexContains(LookupContext->Index, Hash))
+	{
+		if (LookupContext->Found < 10)
+		{
+			printf("Breached: \"%.*s\"\n", (int)Length, (const char*)Line);
+		}
+
+		LookupContext->Found++;
+	}
+
+	return(true);
+}
+
+int CommandBreachVerify(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	size_t ImageSize = 0;
+
+	const uint8_t* Image = NULL;
+
+	BREACH_INDEX Index;
+
+	BREACH_INDEX_HEADER Header;
+
+	if (ArgumentCount < 1 || ArgumentCount > 2)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool breach-verify <breached.bin> [<passwords.txt>]\n");
+
+		return(2);
+	}
+
+	if ((Image = ToolMapFile(Arguments[0], &ImageSize)) == NULL)
+	{
+		goto End;
+	}
+
+	BREACH_INDEX_STATUS Status = BreachIndexOpen(Image, ImageSize, &Index);
+
+	if (Status != BreachIndexOk)
+	{
+		fprintf(stderr, "%s is not usable: %s\n", Arguments[0], BreachIndexStatusString(Status));
+
+		goto End;
+	}
+
+	memcpy(&Header, Image, sizeof(Header));
+
+	// Everything the DLL doesn't check when it opens the file: the checksum, the order of the hashes, and that every hash is in its bucket.
+	if (BlacklistImageCrc32(0, Index.Records, (size_t)Index.HashCount * BREACH_INDEX_HASH_SIZE) != Header.RecordsChecksum)
+	{
+		fprintf(stderr, "%s is damaged: checksum mismatch\n", Arguments[0]);
+
+		goto End;
+	}
+
+	for (uint32_t Bucket = 0; Bucket < BREACH_INDEX_BUCKET_COUNT; Bucket++)
+	{
+		for (uint64_t Record = Index.Fanout[Bucket]; Record < Index.Fanout[Bucket + 1]; Record++)
+		{
+			const uint8_t* Hash = Index.Records + (Record * BREACH_INDEX_HASH_SIZE);
+
+			if (BreachIndexBucket(Hash) != Bucket || (Record > 0 && memcmp(Hash - BREACH_INDEX_HASH_SIZE, Hash, BREACH_INDEX_HASH_SIZE) >= 0))
+			{
+				fprintf(stderr, "%s is damaged: hash %llu is out of order\n", Arguments[0], (unsigned long long)Record);
+
+				goto End;
+			}
+
+			// A hash missing from the filter could never be found, so this is the one thing the filter must not get wrong.
+			if (Index.Filter != NULL && BloomFilterMayContain(Index.Filter, Index.FilterBlockCount, BreachIndexFilterKey(Hash)) == false)
+			{
+				fprintf(stderr, "%s is damaged: hash %llu is missing from the filter\n", Arguments[0], (unsigned long long)Record);
+
+				goto End;
+			}
+		}
+	}
+
+	if (Index.Filter != NULL && BlacklistImageCrc32(0, Index.Filter, (size_t)Index.FilterBlockCount * sizeof(BLOOM_BLOCK)) != Header.FilterChecksum)
+	{
+		fprintf(stderr, "%s is damaged: filter checksum mismatch\n", Arguments[0]);
+
+		goto End;
+	}
+
+	printf("%s: %llu hashes, %llu bytes. Index is intact.\n", Arguments[0], (unsigned long long)Index.HashCount, (unsigned long long)ImageSize);
+
+	if (Index.Filter != NULL)
+	{
+		printf("Bloom filter: %llu bytes, %.3f%% false positives when it was built.\n", (unsigned long long)(Index.FilterBlockCount * sizeof(BLOOM_BLOCK)), Header.FilterFalsePositivesPerMillion / 10000.0);
+	}
+
+	if (ArgumentCount == 2)
+	{
+		BREACH_LOOKUP_CONTEXT LookupContext = { 0 };
+
+		LookupContext.Index = &Index;
+
+		if (ToolParseTextFile(Arguments[1], BREACH_MAX_LINE_LENGTH, BreachLookupLine, &LookupContext, NULL) == false)
+		{
+			goto End;
+		}
+
+		printf("%llu passwords checked, %llu found in the index.\n", (unsigned long long)LookupContext.Passwords, (unsigned long long)LookupContext.Found);
+	}
+
+	ExitCode = 0;
+
+End:
+
+	ToolUnmapFile(Image, ImageSize);
+
+	return(ExitCode);
+}
+
+// Runs the same queries with the filter in front of the records, and again without it.
+static void BenchLookups(const char* Label, const BREACH_INDEX* Index, const uint8_t* Queries, uint64_t Lookups)
+{
+	BREACH_INDEX Unfiltered = *Index;
+
+	Unfiltered.Filter = NULL;
+
+	for (int Pass = (Index->Filter != NULL) ? 0 : 1; Pass < 2; Pass++)
+	{
+		const BREACH_INDEX* Target = (Pass == 0) ? Index : &Unfiltered;
+
+		uint64_t Found = 0;
+
+		double StartTime = ToolNowInSeconds();
+
+		for (uint64_t Lookup = 0; Lookup < Lookups; Lookup++)
+		{
+			Found += BreachIndexContains(Target, Queries + ((Lookup % BREACH_BENCH_QUERY_COUNT) * BREACH_INDEX_HASH_SIZE));
+		}
+
+		double Seconds = ToolNowInSeconds() - StartTime;
+
+		printf("  %-7s %-14s %10.0f lookups/s, %7.1f ns/lookup (%llu found)\n", Label, (Pass == 0) ? "with filter:" : "records only:", (double)Lookups / Seconds, (Seconds * 1e9) / (double)Lookups, (unsigned long long)Found);
+	}
+}
+
+int CommandBreachBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	size_t ImageSize = 0;
+
+	const uint8_t* Image = NULL;
+
+	uint8_t* Queries = NULL;
+
+	BREACH_INDEX Index;
+
+	uint64_t Lookups = 10000000;
+
+	if (ArgumentCount < 1 || ArgumentCount > 2)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool breach-bench <breached.bin> [<lookups>]\n");
+
+		return(2);
+	}
+
+	if (ArgumentCount == 2 && (Lookups = strtoull(Arguments[1], NULL, 10)) == 0)
+	{
+		fprintf(stderr, "The number of lookups must be a positive number.\n");
+
+		return(2);
+	}
+
+	if ((Image = ToolMapFile(Arguments[0], &ImageSize)) == NULL)
+	{
+		goto End;
+	}
+
+	BREACH_INDEX_STATUS Status = BreachIndexOpen(Image, ImageSize, &Index);
+
+	if (Status != BreachIndexOk)
+	{
+		fprintf(stderr, "%s is not usable: %s\n", Arguments[0], BreachIndexStatusString(Status));
+
+		goto End;
+	}
+
+	if (Index.HashCount == 0)
+	{
+		fprintf(stderr, "%s is empty.\n", Arguments[0]);
+
+		goto End;
+	}
+
+	if ((Queries = malloc((size_t)BREACH_BENCH_QUERY_COUNT * BREACH_INDEX_HASH_SIZE)) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	printf("%s: %llu hashes, %llu lookups per run.\n", Arguments[0], (unsigned long long)Index.HashCount, (unsigned long long)Lookups);
+
+	if (Index.Filter != NULL)
+	{
+		BREACH_INDEX_HEADER Header;
+
+		memcpy(&Header, Image, sizeof(Header));
+
+		printf("Bloom filter: %llu bytes, %.3f%% false positives.\n", (unsigned long long)(Index.FilterBlockCount * sizeof(BLOOM_BLOCK)), Header.FilterFalsePositivesPerMillion / 10000.0);
+	}
+
+	// Hits: hashes picked at random from all over the index, so the page cache can't help more than it would in real life.
+	for (uint32_t Query = 0; Query < BREACH_BENCH_QUERY_COUNT; Query++)
+	{
+		memcpy(Queries + ((size_t)Query * BREACH_INDEX_HASH_SIZE), Index.Records + ((ToolRandom() % Index.HashCount) * BREACH_INDEX_HASH_SIZE), BREACH_INDEX_HASH_SIZE);
+	}
+
+	BenchLookups("present", &Index, Queries, Lookups);
+
+	// Misses: random hashes, which (barring a miracle) are not in the index. This is what almost every real password looks like.
+	for (size_t Byte = 0; Byte < (size_t)BREACH_BENCH_QUERY_COUNT * BREACH_INDEX_HASH_SIZE; Byte += sizeof(uint64_t))
+	{
+		uint64_t Random = ToolRandom();
+
+		memcpy(Queries + Byte, &Random, sizeof(Random));
+	}
+
+	BenchLookups("absent", &Index, Queries, Lookups);
+
+	// What PasswordFilter pays on top of the lookup to hash the password in the first place.
+	uint16_t Password[12] = { 'C', 'o', 'r', 'r', 'e', 'c', 't', 'H', 'o', 'r', 's', 'e' };
+
+	uint8_t Hash[BREACH_INDEX_HASH_SIZE];
+
+	double StartTime = ToolNowInSeconds();
+
+	for (uint32_t Iteration = 0; Iteration < BREACH_BENCH_QUERY_COUNT; Iteration++)
+	{
+		Password[Iteration % 12] = (uint16_t)('a' + (Iteration % 26));
+
+		NtlmHash(Password, 12, Hash);
+	}
+
+	double Seconds = ToolNowInSeconds() - StartTime;
+
+	printf("  NT hash:                %10.0f hashes/s,  %7.1f ns/hash (12 characters, %02x)\n", (double)BREACH_BENCH_QUERY_COUNT / Seconds, (Seconds * 1e9) / (double)BREACH_BENCH_QUERY_COUNT, Hash[0]);
+
+	ExitCode = 0;
+
+End:
+
+	free(Queries);
+
+	ToolUnmapFile(Image, ImageSize);
+
+	return(ExitCode);
+}
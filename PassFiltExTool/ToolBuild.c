@@ -0,0 +1,325 @@
+/*
+ToolBuild.c
+
+The build-bench command: how a blacklist load scales with the number of threads it is spread over (see WorkerPool.c and
+BlacklistLoad), and proof that the result doesn't depend on it.
+
+A blacklist of the usual synthetic tokens (see ToolBench.c) is loaded on 1 thread, then 2, 4 and so on up to --threads (all
+of the processors by default), each a few times over, keeping the fastest. The time each stage took is printed along with the
+speedup over 1 thread. The list starts with a !substitute line and a !rule, and has !distance, !coverage, !combined and !rule
+lines in the middle of it, so that the pieces of the file have to agree on those too.
+
+Every load must produce exactly the same token store, automaton and counts as the one on 1 thread, down to the last byte of
+every table, or the command fails.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#include "Strength.h"
+
+#include "WorkerPool.h"
+
+#define BUILD_BENCH_DEFAULT_TOKENS 2000000
+
+#define BUILD_BENCH_DEFAULT_ROUNDS 3
+
+static const char gBuildBenchHeader[] = BLACKLIST_SUBSTITUTE_DIRECTIVE "o0\n" BLACKLIST_RULE_DIRECTIVE "30 qqqq\n";
+
+// Two of each, so that the last one has to win wherever the pieces are cut, and a rule for the header's token that has to win
+// over the one in the header.
+static const char gBuildBenchDistance[] = BLACKLIST_DISTANCE_DIRECTIVE "2\n" BLACKLIST_DISTANCE_DIRECTIVE "1\n"
+	BLACKLIST_COVERAGE_DIRECTIVE "70\n" BLACKLIST_COVERAGE_DIRECTIVE "60\n" BLACKLIST_COMBINED_DIRECTIVE "90\n"
+	BLACKLIST_RULE_DIRECTIVE BLACKLIST_RULE_EXACT " qqqq\n" BLACKLIST_RULE_DIRECTIVE "40 zzzz\n" BLACKLIST_STRENGTH_DIRECTIVE "10\n" BLACKLIST_STRENGTH_DIRECTIVE "8\n";
+
+typedef struct BUILD_BENCH_RESULT
+{
+	TOKEN_STORE Tokens;
+
+	AC_AUTOMATON* Automaton;
+
+	BLACKLIST_LOAD_STATS Stats;
+
+	uint64_t Microseconds;
+
+} BUILD_BENCH_RESULT;
+
+static void FreeResult(BUILD_BENCH_RESULT* Result)
+{
+	AcDestroy(Result->Automaton);
+
+	TokenStoreFree(&Result->Tokens);
+
+	memset(Result, 0, sizeof(BUILD_BENCH_RESULT));
+}
+
+// The generated list, with the header in front and the other directives halfway through.
+static uint8_t* MakeText(uint32_t TokenCount, size_t* Size)
+{
+	size_t ListSize = 0;
+
+	uint8_t* List = ToolGenerateBlacklist(TokenCount, &ListSize);
+
+	uint8_t* Text = NULL;
+
+	if (List == NULL || (Text = malloc(ListSize + sizeof(gBuildBenchHeader) + sizeof(gBuildBenchDistance))) == NULL)
+	{
+		free(List);
+
+		return(NULL);
+	}
+
+	const uint8_t* Middle = memchr(List + (ListSize / 2), '\n', ListSize - (ListSize / 2));
+
+	size_t FirstHalf = (size_t)(Middle - List) + 1;
+
+	*Size = 0;
+
+	memcpy(Text + *Size, gBuildBenchHeader, sizeof(gBuildBenchHeader) - 1);
+
+	*Size += sizeof(gBuildBenchHeader) - 1;
+
+	memcpy(Text + *Size, List, FirstHalf);
+
+	*Size += FirstHalf;
+
+	memcpy(Text + *Size, gBuildBenchDistance, sizeof(gBuildBenchDistance) - 1);
+
+	*Size += sizeof(gBuildBenchDistance) - 1;
+
+	memcpy(Text + *Size, List + FirstHalf, ListSize - FirstHalf);
+
+	*Size += ListSize - FirstHalf;
+
+	free(List);
+
+	return(Text);
+}
+
+// Loads Text Rounds times on ThreadCount threads, and keeps the fastest load.
+static bool LoadText(const uint8_t* Text, size_t Size, uint32_t ThreadCount, uint64_t Rounds, BUILD_BENCH_RESULT* Result)
+{
+	WORKER_POOL Pool;
+
+	WorkerPoolInitialize(&Pool, ThreadCount);
+
+	for (uint64_t Round = 0; Round < Rounds; Round++)
+	{
+		BUILD_BENCH_RESULT Load = { 0 };
+
+		uint64_t Start = PlatformTimestamp();
+
+		BLACKLIST_LOAD_STATUS Status = BlacklistLoad(Text, Size, &Pool, &Load.Tokens, NULL, &Load.Automaton, &Load.Stats);
+
+		Load.Microseconds = PlatformElapsedMicroseconds(Start, PlatformTimestamp());
+
+		if (Status != BlacklistLoadOk)
+		{
+			fprintf(stderr, "Unable to load the blacklist on %u threads: %s\n", ThreadCount, BlacklistLoadStatusString(Status));
+
+			return(false);
+		}
+
+		if (Round == 0 || Load.Microseconds < Result->Microseconds)
+		{
+			FreeResult(Result);
+
+			*Result = Load;
+		}
+		else
+		{
+			FreeResult(&Load);
+		}
+	}
+
+	return(true);
+}
+
+// Whether two loads came out the same, byte for byte.
+static bool SameResult(const BUILD_BENCH_RESULT* Left, const BUILD_BENCH_RESULT* Right)
+{
+	const TOKEN_STORE* LeftTokens = &Left->Tokens;
+
+	const TOKEN_STORE* RightTokens = &Right->Tokens;
+
+	const AC_AUTOMATON* LeftAutomaton = Left->Automaton;
+
+	const AC_AUTOMATON* RightAutomaton = Right->Automaton;
+
+	if (LeftTokens->TokenCount != RightTokens->TokenCount || LeftTokens->ByteCount != RightTokens->ByteCount ||
+		memcmp(LeftTokens->Offsets, RightTokens->Offsets, ((size_t)LeftTokens->TokenCount + 1) * sizeof(uint32_t)) != 0 ||
+		memcmp(LeftTokens->Bytes, RightTokens->Bytes, LeftTokens->ByteCount) != 0)
+	{
+		fprintf(stderr, "The token stores are different!\n");
+
+		return(false);
+	}
+
+	if (LeftAutomaton->StateCount != RightAutomaton->StateCount || LeftAutomaton->EdgeCount != RightAutomaton->EdgeCount ||
+		LeftAutomaton->PatternCount != RightAutomaton->PatternCount ||
+		memcmp(LeftAutomaton->States, RightAutomaton->States, (size_t)LeftAutomaton->StateCount * sizeof(AC_STATE)) != 0 ||
+		memcmp(LeftAutomaton->EdgeLabels, RightAutomaton->EdgeLabels, LeftAutomaton->EdgeCount) != 0 ||
+		memcmp(LeftAutomaton->EdgeTargets, RightAutomaton->EdgeTargets, (size_t)LeftAutomaton->EdgeCount * sizeof(uint32_t)) != 0 ||
+		memcmp(LeftAutomaton->RootTransitions, RightAutomaton->RootTransitions, sizeof(LeftAutomaton->RootTransitions)) != 0 ||
+		LeftAutomaton->Substituting != RightAutomaton->Substituting ||
+		memcmp(LeftAutomaton->Substitutions, RightAutomaton->Substitutions, sizeof(LeftAutomaton->Substitutions)) != 0 ||
+		LeftAutomaton->EditDistance != RightAutomaton->EditDistance ||
+		LeftAutomaton->Coverage != RightAutomaton->Coverage ||
+		LeftAutomaton->CombinedCoverage != RightAutomaton->CombinedCoverage ||
+		(LeftAutomaton->Reach != NULL) != (RightAutomaton->Reach != NULL) ||
+		LeftAutomaton->MinimumStrength != RightAutomaton->MinimumStrength ||
+		(LeftAutomaton->Strength != NULL) != (RightAutomaton->Strength != NULL) ||
+		(LeftAutomaton->Strength != NULL && memcmp(LeftAutomaton->Strength, RightAutomaton->Strength, sizeof(STRENGTH_TABLES)) != 0))
+	{
+		fprintf(stderr, "The automatons are different!\n");
+
+		return(false);
+	}
+
+	if (LeftAutomaton->Reach != NULL &&
+		(memcmp(LeftAutomaton->PatternCoverage, RightAutomaton->PatternCoverage, LeftTokens->TokenCount) != 0 ||
+		memcmp(LeftAutomaton->Reach, RightAutomaton->Reach, (size_t)LeftAutomaton->StateCount * sizeof(uint16_t)) != 0 ||
+		memcmp(LeftAutomaton->Span, RightAutomaton->Span, (size_t)LeftAutomaton->StateCount * sizeof(uint16_t)) != 0))
+	{
+		fprintf(stderr, "The rules are different!\n");
+
+		return(false);
+	}
+
+	if (Left->Stats.BytesRead != Right->Stats.BytesRead || Left->Stats.LinesRead != Right->Stats.LinesRead ||
+		Left->Stats.EmptyLines != Right->Stats.EmptyLines || Left->Stats.TruncatedLines != Right->Stats.TruncatedLines ||
+		Left->Stats.TokensAdded != Right->Stats.TokensAdded || Left->Stats.Directives != Right->Stats.Directives ||
+		Left->Stats.LateDirectives != Right->Stats.LateDirectives || Left->Stats.BadDirectives != Right->Stats.BadDirectives ||
+		Left->Stats.Rules != Right->Stats.Rules)
+	{
+		fprintf(stderr, "The load counts are different!\n");
+
+		return(false);
+	}
+
+	return(true);
+}
+
+int CommandBuildBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = BUILD_BENCH_DEFAULT_TOKENS;
+
+	uint64_t Rounds = BUILD_BENCH_DEFAULT_ROUNDS;
+
+	uint64_t MaxThreads = PlatformProcessorCount();
+
+	uint8_t* Text = NULL;
+
+	size_t Size = 0;
+
+	BUILD_BENCH_RESULT Baseline = { 0 };
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX / 2);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--threads") == 0)
+		{
+			Valid = ((MaxThreads = strtoull(Arguments[++Argument], NULL, 10)) > 0 && MaxThreads <= WORKER_POOL_MAX_THREADS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--rounds") == 0)
+		{
+			Valid = ((Rounds = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool build-bench [--tokens <n>] [--threads <1-%d>] [--rounds <n>]\n", WORKER_POOL_MAX_THREADS);
+
+			return(2);
+		}
+	}
+
+	MaxThreads = (MaxThreads > WORKER_POOL_MAX_THREADS) ? WORKER_POOL_MAX_THREADS : MaxThreads;
+
+	if ((Text = MakeText((uint32_t)TokenCount, &Size)) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	printf("\n%llu lines (%llu bytes) on up to %llu threads, %u processors. Fastest of %llu loads each.\n\n",
+		(unsigned long long)TokenCount,
+		(unsigned long long)Size,
+		(unsigned long long)MaxThreads,
+		PlatformProcessorCount(),
+		(unsigned long long)Rounds);
+
+	printf("threads  parse+sort ms  merge ms  automaton ms  total ms  speedup\n");
+
+	for (uint64_t Threads = 1; Threads <= MaxThreads; Threads = (Threads * 2 > MaxThreads && Threads < MaxThreads) ? MaxThreads : Threads * 2)
+	{
+		BUILD_BENCH_RESULT Result = { 0 };
+
+		if (LoadText(Text, Size, (uint32_t)Threads, Rounds, (Threads == 1) ? &Baseline : &Result) == false)
+		{
+			FreeResult(&Result);
+
+			goto End;
+		}
+
+		const BUILD_BENCH_RESULT* Shown = (Threads == 1) ? &Baseline : &Result;
+
+		printf("%7llu  %13.1f  %8.1f  %12.1f  %8.1f  %6.2fx\n",
+			(unsigned long long)Threads,
+			(double)Shown->Stats.ParseMicroseconds / 1000.0,
+			(double)Shown->Stats.MergeMicroseconds / 1000.0,
+			(double)Shown->Stats.AutomatonMicroseconds / 1000.0,
+			(double)Shown->Microseconds / 1000.0,
+			(double)Baseline.Microseconds / (double)((Shown->Microseconds > 0) ? Shown->Microseconds : 1));
+
+		fflush(stdout);
+
+		bool Same = (Threads == 1) || SameResult(&Baseline, &Result);
+
+		FreeResult(&Result);
+
+		if (Same == false)
+		{
+			fprintf(stderr, "Loading on %llu threads doesn't give the same blacklist as on 1!\n", (unsigned long long)Threads);
+
+			goto End;
+		}
+	}
+
+	printf("\n%lu unique tokens, %lu automaton states, distance %u. Every thread count built the same blacklist.\n",
+		(unsigned long)Baseline.Tokens.TokenCount,
+		(unsigned long)Baseline.Automaton->StateCount,
+		(unsigned)Baseline.Automaton->EditDistance);
+
+	ExitCode = 0;
+
+End:
+
+	free(Text);
+
+	FreeResult(&Baseline);
+
+	return(ExitCode);
+}
@@ -0,0 +1,301 @@
+/*
+ToolCompile.c
+
+The compile and verify commands. See PassFiltExTool.c for usage.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistImage.h"
+
+#include "BlacklistParser.h"
+
+#include "FuzzyMatch.h"
+
+#include "PassFiltExTool.h"
+
+typedef struct VERIFY_CONTEXT
+{
+	const AC_AUTOMATON* ImageAutomaton;
+
+	const AC_AUTOMATON* TextAutomaton;
+
+	uint64_t Passwords;
+
+	uint64_t Rejected;
+
+	uint64_t Mismatches;
+
+} VERIFY_CONTEXT;
+
+// The blacklist half of PasswordCheck: the token that rejects a folded password, exactly or within the automaton's distance.
+static uint32_t FindToken(const AC_AUTOMATON* Automaton, uint16_t* Password, size_t PasswordLength)
+{
+	BlacklistCanonicalize(Automaton, Password, PasswordLength);
+
+	uint32_t Match = BlacklistFindToken(Automaton, NULL, NULL, Password, PasswordLength, NULL);
+
+	if (Match == AC_NO_PATTERN && Automaton->EditDistance > 0)
+	{
+		FUZZY_STATUS Status = FuzzyNotFound;
+
+		Match = FuzzyFindToken(Automaton, Password, PasswordLength, Automaton->EditDistance, FUZZY_STATE_BUDGET, &Status, NULL);
+	}
+
+	return(Match);
+}
+
+static bool VerifyPasswordLine(void* Context, const uint8_t* Line, uint32_t Length)
+{
+	VERIFY_CONTEXT* VerifyContext = Context;
+
+	uint16_t Password[BLACKLIST_PARSER_MAX_LINE];
+
+	uint16_t TextPassword[BLACKLIST_PARSER_MAX_LINE];
+
+	size_t PasswordLength = ToolNormalizePassword(Line, Length, Password, BLACKLIST_PARSER_MAX_LINE);
+
+	// Each blacklist canonicalizes with its own substitutions, which is exactly what needs checking.
+	memcpy(TextPassword, Password, PasswordLength * sizeof(uint16_t));
+
+	uint32_t ImageVerdict = FindToken(VerifyContext->ImageAutomaton, Password, PasswordLength);
+
+	uint32_t TextVerdict = FindToken(VerifyContext->TextAutomaton, TextPassword, PasswordLength);
+
+	VerifyContext->Passwords++;
+
+	if (ImageVerdict != AC_NO_PATTERN)
+	{
+		VerifyContext->Rejected++;
+	}
+
+	if (ImageVerdict != TextVerdict)
+	{
+		if (VerifyContext->Mismatches < 10)
+		{
+			fprintf(stderr, "Verdicts differ for \"%.*s\"!\n", (int)Length, (const char*)Line);
+		}
+
+		VerifyContext->Mismatches++;
+	}
+
+	return(true);
+}
+
+int CommandCompile(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	TOOL_TEXT_STATS Stats = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	void* Image = NULL;
+
+	if (ArgumentCount != 2)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool compile <blacklist.txt> <blacklist.bin>\n");
+
+		return(2);
+	}
+
+	if (ToolLoadBlacklistText(Arguments[0], &Tokens, &Automaton, &Stats) == false)
+	{
+		goto End;
+	}
+
+	size_t ImageSize = BlacklistImageSize(&Tokens, Automaton);
+
+	if (ImageSize == 0 || (Image = malloc(ImageSize)) == NULL)
+	{
+		fprintf(stderr, "Out of memory building the image!\n");
+
+		goto End;
+	}
+
+	if (BlacklistImageWrite(&Tokens, Automaton, Image, ImageSize) == false || ToolWriteFile(Arguments[1], Image, ImageSize) == false)
+	{
+		goto End;
+	}
+
+	printf("Read %llu bytes, %llu lines (%llu empty, %llu truncated) from %s\n", (unsigned long long)Stats.BytesRead, (unsigned long long)Stats.LinesRead, (unsigned long long)Stats.EmptyLines, (unsigned long long)Stats.TruncatedLines, Arguments[0]);
+
+	printf("Wrote %u unique tokens, %u automaton states, %llu bytes to %s\n", Tokens.TokenCount, Automaton->StateCount, (unsigned long long)ImageSize, Arguments[1]);
+
+	if (Automaton->Substituting)
+	{
+		uint64_t TextBytes = 0;
+
+		uint64_t Spellings = BlacklistSpellingCount(&Tokens, Automaton, &TextBytes);
+
+		printf("With substitutions, those tokens cover %llu spellings, which would take %llu bytes as a list without them.\n", (unsigned long long)Spellings, (unsigned long long)TextBytes);
+	}
+
+	if (Automaton->EditDistance > 0)
+	{
+		printf("Passwords will also be rejected for tokens within %u edits, one for every %d characters of the token.\n", (unsigned)Automaton->EditDistance, FUZZY_CHARACTERS_PER_EDIT);
+	}
+
+	if (Automaton->Coverage != AC_DEFAULT_COVERAGE || Automaton->PatternCoverage != NULL)
+	{
+		uint32_t RuledTokens = 0;
+
+		for (uint32_t Index = 0; Index < Tokens.TokenCount && Automaton->PatternCoverage != NULL; Index++)
+		{
+			RuledTokens += (Automaton->PatternCoverage[Index] != Automaton->Coverage);
+		}
+
+		printf("A token rejects a password it makes up %u%% of, and %u tokens have rules of their own.\n", (unsigned)Automaton->Coverage, RuledTokens);
+	}
+
+	if (Automaton->CombinedCoverage != 0)
+	{
+		printf("Two or more tokens together reject a password they make up %u%% of.\n", (unsigned)Automaton->CombinedCoverage);
+	}
+
+	if (Automaton->MinimumStrength > 0)
+	{
+		printf("Passwords that would take fewer than 10^%u guesses will be rejected.\n", (unsigned)Automaton->MinimumStrength);
+	}
+
+	ExitCode = 0;
+
+End:
+
+	free(Image);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(ExitCode);
+}
+
+int CommandVerify(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	size_t ImageSize = 0;
+
+	void* Image = NULL;
+
+	TOKEN_STORE ImageTokens = { 0 };
+
+	AC_AUTOMATON* ImageAutomaton = NULL;
+
+	TOKEN_STORE TextTokens = { 0 };
+
+	AC_AUTOMATON* TextAutomaton = NULL;
+
+	void* TextImage = NULL;
+
+	if (ArgumentCount < 1 || ArgumentCount > 3)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool verify <blacklist.bin> [<blacklist.txt> [<passwords.txt>]]\n");
+
+		return(2);
+	}
+
+	if ((Image = ToolReadFile(Arguments[0], &ImageSize)) == NULL)
+	{
+		goto End;
+	}
+
+	BLACKLIST_IMAGE_STATUS Status = BlacklistImageOpen(Image, ImageSize, &ImageTokens, NULL, &ImageAutomaton);
+
+	if (Status != BlacklistImageOk)
+	{
+		fprintf(stderr, "%s is not usable: %s\n", Arguments[0], BlacklistImageStatusString(Status));
+
+		goto End;
+	}
+
+	printf("%s: %u tokens, %u automaton states, %llu bytes. Image is intact.\n", Arguments[0], ImageTokens.TokenCount, ImageAutomaton->StateCount, (unsigned long long)ImageSize);
+
+	if (ArgumentCount >= 2)
+	{
+		if (ToolLoadBlacklistText(Arguments[1], &TextTokens, &TextAutomaton, NULL) == false)
+		{
+			goto End;
+		}
+
+		// Compiling is deterministic, so an image that matches the text file must match it byte for byte.
+		size_t TextImageSize = BlacklistImageSize(&TextTokens, TextAutomaton);
+
+		if (TextImageSize == 0 || (TextImage = malloc(TextImageSize)) == NULL || BlacklistImageWrite(&TextTokens, TextAutomaton, TextImage, TextImageSize) == false)
+		{
+			fprintf(stderr, "Out of memory building the image!\n");
+
+			goto End;
+		}
+
+		if (TextImageSize != ImageSize || memcmp(TextImage, Image, ImageSize) != 0)
+		{
+			fprintf(stderr, "%s was not compiled from %s (or was compiled by a different version.)\n", Arguments[0], Arguments[1]);
+
+			goto End;
+		}
+
+		printf("%s matches %s.\n", Arguments[0], Arguments[1]);
+	}
+
+	if (ArgumentCount == 3)
+	{
+		VERIFY_CONTEXT VerifyContext = { 0 };
+
+		VerifyContext.ImageAutomaton = ImageAutomaton;
+
+		VerifyContext.TextAutomaton = TextAutomaton;
+
+		size_t PasswordFileSize = 0;
+
+		uint8_t* PasswordFile = ToolReadFile(Arguments[2], &PasswordFileSize);
+
+		BLACKLIST_PARSER Parser;
+
+		if (PasswordFile == NULL)
+		{
+			goto End;
+		}
+
+		BlacklistParserInitialize(&Parser, BLACKLIST_PARSER_MAX_LINE, VerifyPasswordLine, &VerifyContext);
+
+		BlacklistParserFeed(&Parser, PasswordFile, PasswordFileSize);
+
+		BlacklistParserFinish(&Parser);
+
+		free(PasswordFile);
+
+		printf("%llu passwords checked, %llu rejected, %llu verdicts differ.\n", (unsigned long long)VerifyContext.Passwords, (unsigned long long)VerifyContext.Rejected, (unsigned long long)VerifyContext.Mismatches);
+
+		if (VerifyContext.Mismatches > 0)
+		{
+			goto End;
+		}
+	}
+
+	ExitCode = 0;
+
+End:
+
+	free(TextImage);
+
+	AcDestroy(TextAutomaton);
+
+	TokenStoreFree(&TextTokens);
+
+	AcDestroy(ImageAutomaton);
+
+	free(Image);
+
+	return(ExitCode);
+}
@@ -0,0 +1,519 @@
+/*
+ToolDawg.c
+
+The dawg-bench command: how much memory the blacklist takes as a bit-packed DAWG (see TokenDawg.c), which is how the DLL keeps
+its tokens, next to the token store they are loaded into and the automaton, how the substring check does on it, and proof that
+it gives the same answers.
+
+The blacklist is 10 million lines by default. The usual synthetic tokens (see ToolBench.c) are random letters, which share
+beginnings but hardly ever endings, and that is the worst case for a DAWG. Real lists are mostly words with the same few
+endings tacked on, such as "1", "123", "!" and years, so that is what gets generated unless --random is given. With --file,
+a real blacklist is used instead.
+
+Every token is looked up in the DAWG, both ways, and must come back with the index it has in the token store, and the DAWG
+must count as many tokens of each length as the store has, since the strength tables are built from that. Then batches of
+passwords of several lengths, some built around tokens and some random, are folded the way PasswordCheck folds them and
+searched for tokens with BlacklistFindToken and with TokenDawgFindToken, one at a time and timed. The command fails unless both
+agree on every password, and unless every token the DAWG finds really is in the password and at least half of it.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "Normalize.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#include "TokenDawg.h"
+
+#define DAWG_BENCH_DEFAULT_TOKENS 10000000
+
+#define DAWG_BENCH_DEFAULT_CHECKS 100000
+
+#define DAWG_BENCH_MAX_PASSWORD_LENGTH 64
+
+#define DAWG_BENCH_MIN_STEM_LENGTH 4
+
+#define DAWG_BENCH_MAX_STEM_LENGTH 10
+
+// Each word gets about this many endings.
+#define DAWG_BENCH_TOKENS_PER_STEM 40
+
+// A word, two of them, and an ending.
+#define DAWG_BENCH_MAX_LINE ((DAWG_BENCH_MAX_STEM_LENGTH * 2) + 8)
+
+static const uint32_t gDawgBenchPasswordLengths[] = { 8, 12, 16, 32, 64 };
+
+static const uint32_t gDawgBenchHitPercentages[] = { 0, 50, 100 };
+
+// As in ToolBench.c, weighted by how often letters turn up in English.
+static const char gDawgBenchLetters[] = "eeeeeeeeeeeetttttttttaaaaaaaaooooooooiiiiiiinnnnnnnsssssshhhhhhrrrrrrddddlllluuuccmmmwwffggyyppbbvkjxqz";
+
+static const char* const gDawgBenchEndings[] = { "1", "12", "123", "1234", "12345", "!", "!!", "1!", "123!", "01", "007", "69", "99", "00", "#1", "x" };
+
+typedef struct DAWG_BENCH_RESULT
+{
+	uint64_t Rejected;
+
+	TOOL_LATENCY_SUMMARY Latency;
+
+	double ChecksPerSecond;
+
+} DAWG_BENCH_RESULT;
+
+static void Summarize(uint64_t* Latencies, uint64_t Checks, double Seconds, DAWG_BENCH_RESULT* Result)
+{
+	ToolSummarizeLatencies(Latencies, Checks, &Result->Latency);
+
+	Result->ChecksPerSecond = (double)Checks / Seconds;
+}
+
+// Words with endings: a fifth of them with a year, some with one of the usual endings, some with a few digits, and a few
+// with a second word.
+static uint8_t* MakeWordList(uint32_t TokenCount, size_t* Size)
+{
+	uint32_t StemCount = (TokenCount / DAWG_BENCH_TOKENS_PER_STEM) + 1;
+
+	char (*Stems)[DAWG_BENCH_MAX_STEM_LENGTH + 1] = calloc(StemCount, DAWG_BENCH_MAX_STEM_LENGTH + 1);
+
+	uint8_t* Text = malloc((size_t)TokenCount * (DAWG_BENCH_MAX_LINE + 1));
+
+	size_t Length = 0;
+
+	if (Stems == NULL || Text == NULL)
+	{
+		free(Stems);
+
+		free(Text);
+
+		return(NULL);
+	}
+
+	for (uint32_t Stem = 0; Stem < StemCount; Stem++)
+	{
+		uint32_t StemLength = DAWG_BENCH_MIN_STEM_LENGTH + (uint32_t)(ToolRandom() % (DAWG_BENCH_MAX_STEM_LENGTH - DAWG_BENCH_MIN_STEM_LENGTH + 1));
+
+		for (uint32_t Index = 0; Index < StemLength; Index++)
+		{
+			Stems[Stem][Index] = gDawgBenchLetters[ToolRandom() % (sizeof(gDawgBenchLetters) - 1)];
+		}
+	}
+
+	for (uint32_t Token = 0; Token < TokenCount; Token++)
+	{
+		const char* Stem = Stems[ToolRandom() % StemCount];
+
+		uint32_t Kind = (uint32_t)(ToolRandom() % 10);
+
+		char Ending[DAWG_BENCH_MAX_STEM_LENGTH + 8] = { 0 };
+
+		if (Kind < 2)
+		{
+			snprintf(Ending, sizeof(Ending), "%u", (unsigned)(1950 + (ToolRandom() % 80)));
+		}
+		else if (Kind < 5)
+		{
+			snprintf(Ending, sizeof(Ending), "%s", gDawgBenchEndings[ToolRandom() % (sizeof(gDawgBenchEndings) / sizeof(gDawgBenchEndings[0]))]);
+		}
+		else if (Kind < 9)
+		{
+			snprintf(Ending, sizeof(Ending), "%u", (unsigned)(ToolRandom() % 10000));
+		}
+		else
+		{
+			snprintf(Ending, sizeof(Ending), "%s", Stems[ToolRandom() % StemCount]);
+		}
+
+		Length += (size_t)sprintf((char*)Text + Length, "%s%s\n", Stem, Ending);
+	}
+
+	free(Stems);
+
+	*Size = Length;
+
+	return(Text);
+}
+
+// Every token must have the same index in the DAWG as in the store, both ways, and the lengths must add up the same.
+static bool CheckIndexes(const TOKEN_STORE* Tokens, const TOKEN_DAWG* Dawg)
+{
+	uint8_t Token[TOKEN_DAWG_MAX_LENGTH];
+
+	uint32_t StoreLengths[TOKEN_DAWG_MAX_LENGTH + 1] = { 0 };
+
+	uint32_t DawgLengths[TOKEN_DAWG_MAX_LENGTH + 1];
+
+	if (Dawg->TokenCount != Tokens->TokenCount)
+	{
+		fprintf(stderr, "The DAWG has %lu tokens, and the store %lu!\n", (unsigned long)Dawg->TokenCount, (unsigned long)Tokens->TokenCount);
+
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < Tokens->TokenCount; Index++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Stored = TokenStoreGet(Tokens, Index, &Length);
+
+		uint32_t Found = TokenDawgIndex(Dawg, Stored, Length);
+
+		if (Found != Index)
+		{
+			fprintf(stderr, "Token %lu (%.*s) has index %lu in the DAWG!\n", (unsigned long)Index, (int)Length, (const char*)Stored, (unsigned long)Found);
+
+			return(false);
+		}
+
+		if (TokenDawgGet(Dawg, Index, Token) != Length || memcmp(Token, Stored, Length) != 0)
+		{
+			fprintf(stderr, "Token %lu (%.*s) comes back from the DAWG as something else!\n", (unsigned long)Index, (int)Length, (const char*)Stored);
+
+			return(false);
+		}
+
+		StoreLengths[Length]++;
+	}
+
+	TokenDawgCountLengths(Dawg, DawgLengths);
+
+	if (memcmp(StoreLengths, DawgLengths, sizeof(StoreLengths)) != 0)
+	{
+		fprintf(stderr, "The DAWG counts the tokens of some length differently!\n");
+
+		return(false);
+	}
+
+	if (TokenDawgIndex(Dawg, (const uint8_t*)"\x01\x02\x03", 3) != TOKEN_DAWG_NO_TOKEN || TokenDawgGet(Dawg, Tokens->TokenCount, Token) != 0)
+	{
+		fprintf(stderr, "The DAWG finds a token that isn't there!\n");
+
+		return(false);
+	}
+
+	return(true);
+}
+
+// Whether token Index is in Password and at least half of it.
+static bool TokenCounts(const TOKEN_STORE* Tokens, uint32_t Index, const uint16_t* Password, uint32_t PasswordLength)
+{
+	uint32_t Length = 0;
+
+	if (Index >= Tokens->TokenCount)
+	{
+		return(false);
+	}
+
+	const uint8_t* Token = TokenStoreGet(Tokens, Index, &Length);
+
+	if (Length * 2 < PasswordLength || Length > PasswordLength)
+	{
+		return(false);
+	}
+
+	for (uint32_t Start = 0; Start + Length <= PasswordLength; Start++)
+	{
+		uint32_t Matched = 0;
+
+		while (Matched < Length && Password[Start + Matched] == Token[Matched])
+		{
+			Matched++;
+		}
+
+		if (Matched == Length)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+// Times both searches over the same folded passwords, and fails on the first password they disagree about.
+static bool RunChecks(const TOKEN_STORE* Tokens, const AC_AUTOMATON* Automaton, const TOKEN_DAWG* Dawg, const uint16_t* Passwords, uint32_t Length, uint64_t Checks, uint64_t* Latencies, DAWG_BENCH_RESULT* AutomatonResult, DAWG_BENCH_RESULT* DawgResult)
+{
+	memset(AutomatonResult, 0, sizeof(DAWG_BENCH_RESULT));
+
+	memset(DawgResult, 0, sizeof(DAWG_BENCH_RESULT));
+
+	double StartTime = ToolNowInSeconds();
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		uint64_t CheckStart = PlatformTimestamp();
+
+		uint32_t Match = BlacklistFindToken(Automaton, NULL, NULL, Passwords + (Check * Length), Length, NULL);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		AutomatonResult->Rejected += (Match != AC_NO_PATTERN);
+	}
+
+	Summarize(Latencies, Checks, ToolNowInSeconds() - StartTime, AutomatonResult);
+
+	StartTime = ToolNowInSeconds();
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		uint64_t CheckStart = PlatformTimestamp();
+
+		uint32_t Match = TokenDawgFindToken(Dawg, Passwords + (Check * Length), Length);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		DawgResult->Rejected += (Match != TOKEN_DAWG_NO_TOKEN);
+	}
+
+	Summarize(Latencies, Checks, ToolNowInSeconds() - StartTime, DawgResult);
+
+	// Again, untimed, one password at a time.
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		const uint16_t* Password = Passwords + (Check * Length);
+
+		uint32_t AutomatonMatch = BlacklistFindToken(Automaton, NULL, NULL, Password, Length, NULL);
+
+		uint32_t DawgMatch = TokenDawgFindToken(Dawg, Password, Length);
+
+		if ((AutomatonMatch == AC_NO_PATTERN) != (DawgMatch == TOKEN_DAWG_NO_TOKEN) || (DawgMatch != TOKEN_DAWG_NO_TOKEN && TokenCounts(Tokens, DawgMatch, Password, Length) == false))
+		{
+			fprintf(stderr, "Password %llu of length %lu: the automaton found pattern %lu, the DAWG token %lu!\n", (unsigned long long)Check, (unsigned long)Length, (unsigned long)AutomatonMatch, (unsigned long)DawgMatch);
+
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+int CommandDawgBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = DAWG_BENCH_DEFAULT_TOKENS;
+
+	uint64_t Checks = DAWG_BENCH_DEFAULT_CHECKS;
+
+	bool Random = false;
+
+	const char* Path = NULL;
+
+	uint8_t* Text = NULL;
+
+	size_t Size = 0;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	TOKEN_DAWG Dawg = { 0 };
+
+	uint16_t* Passwords = NULL;
+
+	uint64_t* Latencies = NULL;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = true;
+
+		if (strcmp(Arguments[Argument], "--random") == 0)
+		{
+			Random = true;
+		}
+		else if (Argument + 1 < ArgumentCount && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX / (DAWG_BENCH_MAX_LINE + 1));
+		}
+		else if (Argument + 1 < ArgumentCount && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Argument + 1 < ArgumentCount && strcmp(Arguments[Argument], "--file") == 0)
+		{
+			Path = Arguments[++Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool dawg-bench [--tokens <n>] [--checks <n>] [--random | --file <blacklist.txt>]\n");
+
+			return(2);
+		}
+	}
+
+	if ((Passwords = malloc((size_t)Checks * DAWG_BENCH_MAX_PASSWORD_LENGTH * sizeof(uint16_t))) == NULL || (Latencies = malloc((size_t)Checks * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	double StartTime = ToolNowInSeconds();
+
+	if (Path != NULL)
+	{
+		TOOL_TEXT_STATS TextStats = { 0 };
+
+		if (ToolLoadBlacklistText(Path, &Tokens, &Automaton, &TextStats) == false)
+		{
+			goto End;
+		}
+
+		printf("\n%s: %llu lines", Path, (unsigned long long)TextStats.LinesRead);
+	}
+	else
+	{
+		BLACKLIST_LOAD_STATS Stats = { 0 };
+
+		if ((Text = Random ? ToolGenerateBlacklist((uint32_t)TokenCount, &Size) : MakeWordList((uint32_t)TokenCount, &Size)) == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+
+		StartTime = ToolNowInSeconds();
+
+		BLACKLIST_LOAD_STATUS Status = BlacklistLoad(Text, Size, NULL, &Tokens, NULL, &Automaton, &Stats);
+
+		free(Text);
+
+		Text = NULL;
+
+		if (Status != BlacklistLoadOk)
+		{
+			fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(Status));
+
+			goto End;
+		}
+
+		printf("\n%llu generated lines (%s)", (unsigned long long)Stats.LinesRead, Random ? "random letters" : "words with endings");
+	}
+
+	double LoadSeconds = ToolNowInSeconds() - StartTime;
+
+	StartTime = ToolNowInSeconds();
+
+	if (TokenDawgBuild(&Tokens, &Dawg) == false)
+	{
+		fprintf(stderr, "Unable to build a DAWG of the blacklist!\n");
+
+		goto End;
+	}
+
+	double DawgSeconds = ToolNowInSeconds() - StartTime;
+
+	double PerToken = (Tokens.TokenCount > 0) ? 1.0 / (double)Tokens.TokenCount : 0.0;
+
+	size_t StoreBytes = TokenStoreMemoryUsage(&Tokens);
+
+	size_t AutomatonBytes = AcMemoryUsage(Automaton);
+
+	size_t DawgBytes = TokenDawgMemoryUsage(&Dawg);
+
+	printf(", %lu unique tokens of %.1f bytes on average.\n\n", (unsigned long)Tokens.TokenCount, (double)Tokens.ByteCount * PerToken);
+
+	printf("                          bytes  bytes/token   build ms\n");
+
+	printf("  token store      %12llu  %11.2f\n", (unsigned long long)StoreBytes, (double)StoreBytes * PerToken);
+
+	printf("  automaton        %12llu  %11.2f   (%lu states, %lu edges)\n", (unsigned long long)AutomatonBytes, (double)AutomatonBytes * PerToken, (unsigned long)Automaton->StateCount, (unsigned long)Automaton->EdgeCount);
+
+	printf("  both             %12llu  %11.2f  %9.1f\n", (unsigned long long)(StoreBytes + AutomatonBytes), (double)(StoreBytes + AutomatonBytes) * PerToken, LoadSeconds * 1e3);
+
+	printf("  DAWG             %12llu  %11.2f  %9.1f   (%lu edges of %lu bits), %.1f%% of both\n\n",
+		(unsigned long long)DawgBytes,
+		(double)DawgBytes * PerToken,
+		DawgSeconds * 1e3,
+		(unsigned long)(Dawg.EdgeCount - 1),
+		(unsigned long)Dawg.EdgeBits,
+		(100.0 * (double)DawgBytes) / (double)(StoreBytes + AutomatonBytes));
+
+	fflush(stdout);
+
+	if (CheckIndexes(&Tokens, &Dawg) == false)
+	{
+		goto End;
+	}
+
+	printf("Every token has the same index in the DAWG as in the store, and the lengths add up the same.\n\n");
+
+	printf("                   --------- automaton ---------  ------------ DAWG -----------\n");
+
+	printf("  length   hits  rejected  p50 ns  p99 ns   checks/s  rejected  p50 ns  p99 ns   checks/s\n");
+
+	for (size_t LengthIndex = 0; LengthIndex < sizeof(gDawgBenchPasswordLengths) / sizeof(gDawgBenchPasswordLengths[0]); LengthIndex++)
+	{
+		uint32_t Length = gDawgBenchPasswordLengths[LengthIndex];
+
+		for (size_t HitIndex = 0; HitIndex < sizeof(gDawgBenchHitPercentages) / sizeof(gDawgBenchHitPercentages[0]); HitIndex++)
+		{
+			DAWG_BENCH_RESULT AutomatonResult;
+
+			DAWG_BENCH_RESULT DawgResult;
+
+			for (uint64_t Check = 0; Check < Checks; Check++)
+			{
+				uint16_t* Password = Passwords + (Check * Length);
+
+				ToolMakePassword(Password, Length, &Tokens, (ToolRandom() % 100) < gDawgBenchHitPercentages[HitIndex]);
+
+				// What PasswordCheck does before it searches.
+				NormalizeString(Password, Length);
+
+				BlacklistCanonicalize(Automaton, Password, Length);
+			}
+
+			if (RunChecks(&Tokens, Automaton, &Dawg, Passwords, Length, Checks, Latencies, &AutomatonResult, &DawgResult) == false)
+			{
+				goto End;
+			}
+
+			printf("  %6lu  %4lu%%  %7.2f%%  %6llu  %6llu  %9.0f  %7.2f%%  %6llu  %6llu  %9.0f\n",
+				(unsigned long)Length,
+				(unsigned long)gDawgBenchHitPercentages[HitIndex],
+				(100.0 * (double)AutomatonResult.Rejected) / (double)Checks,
+				(unsigned long long)AutomatonResult.Latency.P50,
+				(unsigned long long)AutomatonResult.Latency.P99,
+				AutomatonResult.ChecksPerSecond,
+				(100.0 * (double)DawgResult.Rejected) / (double)Checks,
+				(unsigned long long)DawgResult.Latency.P50,
+				(unsigned long long)DawgResult.Latency.P99,
+				DawgResult.ChecksPerSecond);
+
+			fflush(stdout);
+		}
+	}
+
+	printf("\nThe automaton and the DAWG agreed on every password.\n");
+
+	ExitCode = 0;
+
+End:
+
+	free(Text);
+
+	free(Passwords);
+
+	free(Latencies);
+
+	TokenDawgFree(&Dawg);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(ExitCode);
+}
@@ -0,0 +1,488 @@
+/*
+ToolDelta.c
+
+The delta-bench command: what putting lines appended to the text blacklist into effect costs (see BlacklistDelta.c), next to
+the full rebuild it saves, and proof that the result judges passwords exactly as the full rebuild would.
+
+A blacklist of the usual synthetic tokens (see ToolBench.c) is loaded the way LoadBlacklistSnapshot loads it, and then, round
+after round, more lines are appended to it. Each round does what the DLL does: checks that the old text is still there, and
+loads everything appended since the base into a new overlay. Some of the new lines repeat tokens the base already has, as
+real additions often do. The same text is also rebuilt from scratch, and both are timed.
+
+After the last round, batches of passwords built around base tokens, around appended tokens, and around nothing at all are
+put through PasswordCheck both ways, and the command fails unless every verdict is the same. It also fails unless a change
+in the middle of the old text, a shorter file, and a directive among the new lines all stop the overlay from being used.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistDelta.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#define DELTA_BENCH_DEFAULT_TOKENS 1000000
+
+#define DELTA_BENCH_DEFAULT_APPENDED 100
+
+#define DELTA_BENCH_DEFAULT_ROUNDS 5
+
+#define DELTA_BENCH_DEFAULT_CHECKS 20000
+
+#define DELTA_BENCH_LENGTH 12
+
+// Longer than any line ToolGenerateBlacklist makes.
+#define DELTA_BENCH_MAX_LINE 32
+
+// One appended line in this many is a copy of a base token.
+#define DELTA_BENCH_REPEAT_EVERY 10
+
+#define DELTA_BENCH_KINDS 3
+
+static const char* gDeltaBenchKinds[DELTA_BENCH_KINDS] = { "random", "base token", "new token" };
+
+typedef struct DELTA_BENCH_BLACKLIST
+{
+	TOKEN_STORE Tokens;
+
+	AC_AUTOMATON* Automaton;
+
+	TOKEN_STORE OverlayTokens;
+
+	AC_AUTOMATON* Overlay;
+
+} DELTA_BENCH_BLACKLIST;
+
+static void FreeBlacklist(DELTA_BENCH_BLACKLIST* Blacklist)
+{
+	AcDestroy(Blacklist->Overlay);
+
+	TokenStoreFree(&Blacklist->OverlayTokens);
+
+	AcDestroy(Blacklist->Automaton);
+
+	TokenStoreFree(&Blacklist->Tokens);
+
+	memset(Blacklist, 0, sizeof(DELTA_BENCH_BLACKLIST));
+}
+
+// Appends Count lines to Text, which has room for them, and returns its new size.
+static size_t AppendLines(uint8_t* Text, size_t Size, const TOKEN_STORE* BaseTokens, uint32_t Count)
+{
+	size_t NewSize = 0;
+
+	uint8_t* NewLines = ToolGenerateBlacklist(Count, &NewSize);
+
+	if (NewLines == NULL)
+	{
+		return(Size);
+	}
+
+	memcpy(Text + Size, NewLines, NewSize);
+
+	free(NewLines);
+
+	// Every so often, a token the base already has instead, which must not end up in the overlay. One that is longer than
+	// the line it would replace is left out.
+	size_t Position = Size;
+
+	for (uint32_t Line = 0; Line < Count && BaseTokens->TokenCount > 0; Line++)
+	{
+		size_t End = Position;
+
+		while (Text[End] != '\n')
+		{
+			End++;
+		}
+
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(BaseTokens, (uint32_t)(ToolRandom() % BaseTokens->TokenCount), &Length);
+
+		if ((Line % DELTA_BENCH_REPEAT_EVERY) == 0 && Length <= End - Position)
+		{
+			memcpy(Text + Position, Token, Length);
+
+			memmove(Text + Position + Length, Text + End, Size + NewSize - End);
+
+			NewSize -= (End - Position) - Length;
+
+			End = Position + Length;
+		}
+
+		Position = End + 1;
+	}
+
+	return(Size + NewSize);
+}
+
+static uint64_t TicksToMicroseconds(uint64_t Ticks)
+{
+	return((uint64_t)(((double)Ticks * 1e6) / (double)PlatformTimestampFrequency()));
+}
+
+// Judges Passwords with both blacklists. Returns the number of verdicts they disagree on, and adds up the time each took.
+static uint64_t CompareVerdicts(const DELTA_BENCH_BLACKLIST* Delta, const DELTA_BENCH_BLACKLIST* Full, SCRATCH_POOL* Scratch, const uint16_t* Passwords, uint64_t Checks, uint64_t* Rejected, uint64_t* DeltaTicks, uint64_t* FullTicks)
+{
+	uint64_t Errors = 0;
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		PLATFORM_STRING String = { DELTA_BENCH_LENGTH * sizeof(uint16_t), DELTA_BENCH_LENGTH * sizeof(uint16_t), (uint16_t*)(Passwords + (Check * DELTA_BENCH_LENGTH)) };
+
+		uint32_t DeltaPattern = AC_NO_PATTERN;
+
+		uint32_t FullPattern = AC_NO_PATTERN;
+
+		uint64_t Start = PlatformTimestamp();
+
+		PASSWORD_VERDICT DeltaVerdict = PasswordCheck(Delta->Automaton, Delta->Overlay, NULL, Scratch, &String, NULL, NULL, &DeltaPattern);
+
+		uint64_t Middle = PlatformTimestamp();
+
+		PASSWORD_VERDICT FullVerdict = PasswordCheck(Full->Automaton, NULL, NULL, Scratch, &String, NULL, NULL, &FullPattern);
+
+		*DeltaTicks += Middle - Start;
+
+		*FullTicks += PlatformTimestamp() - Middle;
+
+		*Rejected += PasswordVerdictRejects(DeltaVerdict);
+
+		if (DeltaVerdict != FullVerdict)
+		{
+			if (Errors < 10)
+			{
+				fprintf(stderr, "With the overlay: %s. Rebuilt: %s. For \"", PasswordVerdictString(DeltaVerdict), PasswordVerdictString(FullVerdict));
+
+				for (uint32_t Position = 0; Position < DELTA_BENCH_LENGTH; Position++)
+				{
+					fputc((int)String.Buffer[Position], stderr);
+				}
+
+				fprintf(stderr, "\".\n");
+			}
+
+			Errors++;
+		}
+	}
+
+	return(Errors);
+}
+
+// Whether the prefix check and BlacklistDeltaLoad turn down the changes that must take a full reload.
+static bool CheckFallbacks(const BLACKLIST_TEXT_PREFIX* Base, const DELTA_BENCH_BLACKLIST* Blacklist, uint8_t* Text, size_t Size)
+{
+	static const char Directive[] = BLACKLIST_DISTANCE_DIRECTIVE "1\n";
+
+	BLACKLIST_TEXT_PREFIX Prefix = *Base;
+
+	BLACKLIST_DELTA_STATS Stats = { 0 };
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Overlay = NULL;
+
+	bool Passed = true;
+
+	// One byte changed in the middle of the old text.
+	size_t Position = (size_t)(ToolRandom() % Base->Size);
+
+	Text[Position] ^= 1;
+
+	if (BlacklistTextPrefixExtend(&Prefix, Text, Size))
+	{
+		fprintf(stderr, "A change in the middle of the file was taken for lines being appended!\n");
+
+		Passed = false;
+	}
+
+	Text[Position] ^= 1;
+
+	// The file cut short, in the middle of a line and then at the end of one.
+	if (BlacklistTextPrefixExtend(&Prefix, Text, (size_t)Base->Size - 3) || BlacklistTextPrefixExtend(&Prefix, Text, (size_t)Base->Size / 2))
+	{
+		fprintf(stderr, "A shorter file was taken for lines being appended!\n");
+
+		Passed = false;
+	}
+
+	// A directive among the new lines.
+	memcpy(Text + Size, Directive, sizeof(Directive) - 1);
+
+	BLACKLIST_DELTA_STATUS Status = BlacklistDeltaLoad(Blacklist->Tokens.TokenCount, Blacklist->Automaton, Text + Base->Size, Size + sizeof(Directive) - 1 - (size_t)Base->Size, &Tokens, &Overlay, &Stats);
+
+	if (Status != BlacklistDeltaHasDirectives)
+	{
+		fprintf(stderr, "A directive among the appended lines was not caught: %s.\n", BlacklistDeltaStatusString(Status));
+
+		Passed = false;
+	}
+
+	AcDestroy(Overlay);
+
+	TokenStoreFree(&Tokens);
+
+	if (BlacklistTextPrefixExtend(&Prefix, Text, Size) == false)
+	{
+		fprintf(stderr, "The untouched file was not taken for lines being appended!\n");
+
+		Passed = false;
+	}
+
+	printf("A change in the middle, a shorter file and a directive among the new lines: %s.\n", Passed ? "all take a full reload" : "FAILED");
+
+	return(Passed);
+}
+
+int CommandDeltaBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = DELTA_BENCH_DEFAULT_TOKENS;
+
+	uint64_t Appended = DELTA_BENCH_DEFAULT_APPENDED;
+
+	uint64_t Rounds = DELTA_BENCH_DEFAULT_ROUNDS;
+
+	uint64_t Checks = DELTA_BENCH_DEFAULT_CHECKS;
+
+	uint8_t* Text = NULL;
+
+	size_t BaseSize = 0;
+
+	size_t Size = 0;
+
+	DELTA_BENCH_BLACKLIST Delta = { 0 };
+
+	DELTA_BENCH_BLACKLIST Full = { 0 };
+
+	BLACKLIST_LOAD_STATS LoadStats = { 0 };
+
+	BLACKLIST_TEXT_PREFIX Base = { 0 };
+
+	BLACKLIST_TEXT_PREFIX Prefix = { 0 };
+
+	uint16_t* Passwords = NULL;
+
+	uint64_t Errors = 0;
+
+	SCRATCH_POOL Scratch;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX / 2);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--appended") == 0)
+		{
+			Valid = ((Appended = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Appended <= UINT32_MAX / 2);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--rounds") == 0)
+		{
+			Valid = ((Rounds = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Rounds * Appended <= UINT32_MAX / 2);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool delta-bench [--tokens <n>] [--appended <n>] [--rounds <n>] [--checks <n>]\n");
+
+			return(2);
+		}
+	}
+
+	ScratchPoolInitialize(&Scratch);
+
+	uint8_t* BaseText = ToolGenerateBlacklist((uint32_t)TokenCount, &BaseSize);
+
+	// Room for every round's lines, and a directive after them.
+	size_t Capacity = BaseSize + ((size_t)(Rounds * Appended) * DELTA_BENCH_MAX_LINE) + 64;
+
+	if (BaseText == NULL || (Text = malloc(Capacity)) == NULL || (Passwords = malloc((size_t)Checks * DELTA_BENCH_LENGTH * sizeof(uint16_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		free(BaseText);
+
+		goto End;
+	}
+
+	memcpy(Text, BaseText, BaseSize);
+
+	free(BaseText);
+
+	Size = BaseSize;
+
+	// The base, the way LoadBlacklistSnapshot loads it.
+	uint64_t Start = PlatformTimestamp();
+
+	BLACKLIST_LOAD_STATUS LoadStatus = BlacklistLoad(Text, Size, NULL, &Delta.Tokens, NULL, &Delta.Automaton, &LoadStats);
+
+	uint64_t Loaded = PlatformTimestamp();
+
+	BlacklistTextPrefixInitialize(&Base, Text, Size);
+
+	if (LoadStatus != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(LoadStatus));
+
+		goto End;
+	}
+
+	printf("\n%llu lines, %lu unique tokens, %lu automaton states. Loaded in %llu us, and the CRC for the next change took %llu us more.\n\n",
+		(unsigned long long)TokenCount,
+		(unsigned long)Delta.Tokens.TokenCount,
+		(unsigned long)Delta.Automaton->StateCount,
+		(unsigned long long)TicksToMicroseconds(Loaded - Start),
+		(unsigned long long)TicksToMicroseconds(PlatformTimestamp() - Loaded));
+
+	printf("round  appended  new tokens  overlay states  check us  overlay us  rebuild us  speedup  compact\n");
+
+	Prefix = Base;
+
+	for (uint64_t Round = 1; Round <= Rounds; Round++)
+	{
+		BLACKLIST_DELTA_STATS Stats = { 0 };
+
+		Size = AppendLines(Text, Size, &Delta.Tokens, (uint32_t)Appended);
+
+		AcDestroy(Delta.Overlay);
+
+		TokenStoreFree(&Delta.OverlayTokens);
+
+		Delta.Overlay = NULL;
+
+		// What LoadAppendedBlacklistSnapshot does.
+		uint64_t CheckStart = PlatformTimestamp();
+
+		if (BlacklistTextPrefixExtend(&Prefix, Text, Size) == false)
+		{
+			fprintf(stderr, "The appended lines were not taken for lines being appended!\n");
+
+			goto End;
+		}
+
+		uint64_t Checked = PlatformTimestamp();
+
+		BLACKLIST_DELTA_STATUS Status = BlacklistDeltaLoad(Delta.Tokens.TokenCount, Delta.Automaton, Text + BaseSize, Size - BaseSize, &Delta.OverlayTokens, &Delta.Overlay, &Stats);
+
+		uint64_t Overlaid = PlatformTimestamp();
+
+		if (Status != BlacklistDeltaOk)
+		{
+			fprintf(stderr, "Unable to load the appended lines: %s\n", BlacklistDeltaStatusString(Status));
+
+			goto End;
+		}
+
+		// And what it saves.
+		FreeBlacklist(&Full);
+
+		Start = PlatformTimestamp();
+
+		if ((LoadStatus = BlacklistLoad(Text, Size, NULL, &Full.Tokens, NULL, &Full.Automaton, &LoadStats)) != BlacklistLoadOk)
+		{
+			fprintf(stderr, "Unable to rebuild the blacklist: %s\n", BlacklistLoadStatusString(LoadStatus));
+
+			goto End;
+		}
+
+		uint64_t Rebuild = TicksToMicroseconds(PlatformTimestamp() - Start);
+
+		uint64_t Overlay = TicksToMicroseconds(Overlaid - Checked);
+
+		uint64_t Check = TicksToMicroseconds(Checked - CheckStart);
+
+		printf("%5llu  %8lu  %10lu  %14lu  %8llu  %10llu  %10llu  %6.0fx  %7s\n",
+			(unsigned long long)Round,
+			(unsigned long)Stats.Tokens,
+			(unsigned long)(Stats.Tokens - Stats.KnownTokens),
+			(unsigned long)((Delta.Overlay != NULL) ? Delta.Overlay->StateCount : 0),
+			(unsigned long long)Check,
+			(unsigned long long)Overlay,
+			(unsigned long long)Rebuild,
+			(double)Rebuild / (double)((Check + Overlay > 0) ? Check + Overlay : 1),
+			BlacklistDeltaNeedsCompaction(Delta.Tokens.TokenCount, Delta.OverlayTokens.TokenCount) ? "yes" : "no");
+
+		if (Full.Tokens.TokenCount != Delta.Tokens.TokenCount + Stats.Tokens - Stats.KnownTokens)
+		{
+			fprintf(stderr, "The rebuilt blacklist has %lu tokens, and the base and overlay %lu!\n", (unsigned long)Full.Tokens.TokenCount, (unsigned long)(Delta.Tokens.TokenCount + Stats.Tokens - Stats.KnownTokens));
+
+			goto End;
+		}
+
+		fflush(stdout);
+	}
+
+	printf("\nkind        rejected  overlay ns  rebuilt ns  disagree\n");
+
+	for (uint32_t Kind = 0; Kind < DELTA_BENCH_KINDS; Kind++)
+	{
+		uint64_t Rejected = 0;
+
+		uint64_t DeltaTicks = 0;
+
+		uint64_t FullTicks = 0;
+
+		for (uint64_t Index = 0; Index < Checks; Index++)
+		{
+			ToolMakePassword(Passwords + (Index * DELTA_BENCH_LENGTH), DELTA_BENCH_LENGTH, (Kind == 2) ? &Delta.OverlayTokens : &Delta.Tokens, Kind > 0);
+		}
+
+		uint64_t KindErrors = CompareVerdicts(&Delta, &Full, &Scratch, Passwords, Checks, &Rejected, &DeltaTicks, &FullTicks);
+
+		printf("%-10s  %7.2f%%  %10.0f  %10.0f  %8llu\n",
+			gDeltaBenchKinds[Kind],
+			(100.0 * (double)Rejected) / (double)Checks,
+			((double)TicksToMicroseconds(DeltaTicks) * 1000.0) / (double)Checks,
+			((double)TicksToMicroseconds(FullTicks) * 1000.0) / (double)Checks,
+			(unsigned long long)KindErrors);
+
+		Errors += KindErrors;
+	}
+
+	printf("\n");
+
+	if (CheckFallbacks(&Base, &Delta, Text, Size) == false || Errors > 0)
+	{
+		goto End;
+	}
+
+	ExitCode = 0;
+
+End:
+
+	free(Passwords);
+
+	free(Text);
+
+	FreeBlacklist(&Delta);
+
+	FreeBlacklist(&Full);
+
+	ScratchPoolDestroy(&Scratch);
+
+	return(ExitCode);
+}
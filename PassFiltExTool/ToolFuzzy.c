@@ -0,0 +1,460 @@
+/*
+ToolFuzzy.c
+
+The fuzzy-bench command: what a !distance costs (see FuzzyMatch.c), and proof that the trie search finds exactly what it should.
+
+First, the search is checked against the obvious way of doing the same thing: every token, one at a time, against every
+stretch of the password, with the textbook edit distance table. That is far too slow for a real list, so it is done with a
+small one, for each distance, on passwords with and without typos in them. The command fails if the two ever disagree on
+whether a password is rejected.
+
+Then a blacklist of the usual synthetic tokens (see ToolBench.c) is loaded, and the same batches of passwords are put through
+PasswordCheck with the blacklist's distance set to 0, 1 and 2 in turn: random ones, ones built around a token, and the same
+with one or two typos made in them. Every call is timed on its own, and for each batch the trie states searched are counted as
+well, for the passwords that get as far as that search, to show how close the worst one comes to FUZZY_STATE_BUDGET.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "FuzzyMatch.h"
+
+#include "Normalize.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#define FUZZY_BENCH_DEFAULT_TOKENS 1000000
+
+#define FUZZY_BENCH_DEFAULT_CHECKS 20000
+
+#define FUZZY_BENCH_DEFAULT_LENGTH 12
+
+#define FUZZY_BENCH_CHECK_TOKENS 2000
+
+#define FUZZY_BENCH_CHECK_PASSWORDS 3000
+
+#define FUZZY_BENCH_MAX_DISTANCE 2
+
+#define FUZZY_BENCH_KINDS 4
+
+static const char* gFuzzyBenchKinds[FUZZY_BENCH_KINDS] = { "random", "token", "1 typo", "2 typos" };
+
+static const char gFuzzyBenchTypos[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+typedef struct FUZZY_BENCH_RESULT
+{
+	uint64_t Rejected;
+
+	uint64_t OverBudget;
+
+	TOOL_LATENCY_SUMMARY Latency;
+
+	double AverageStates;
+
+	uint64_t MaxStates;
+
+} FUZZY_BENCH_RESULT;
+
+// Changes, adds or leaves out one character, keeping the password Length characters long.
+static void MakeTypo(uint16_t* Password, uint32_t Length)
+{
+	uint32_t Position = (uint32_t)(ToolRandom() % Length);
+
+	uint16_t Character = (uint16_t)gFuzzyBenchTypos[ToolRandom() % (sizeof(gFuzzyBenchTypos) - 1)];
+
+	switch (ToolRandom() % 3)
+	{
+		case 0:
+		{
+			Password[Position] = Character;
+
+			break;
+		}
+		case 1:
+		{
+			memmove(Password + Position + 1, Password + Position, (size_t)(Length - Position - 1) * sizeof(uint16_t));
+
+			Password[Position] = Character;
+
+			break;
+		}
+		default:
+		{
+			memmove(Password + Position, Password + Position + 1, (size_t)(Length - Position - 1) * sizeof(uint16_t));
+
+			Password[Length - 1] = Character;
+
+			break;
+		}
+	}
+}
+
+static void MakePasswords(uint16_t* Passwords, uint32_t Length, uint64_t Count, const TOKEN_STORE* Tokens, uint32_t Kind)
+{
+	for (uint64_t Index = 0; Index < Count; Index++)
+	{
+		uint16_t* Password = Passwords + (Index * Length);
+
+		ToolMakePassword(Password, Length, Tokens, Kind > 0);
+
+		for (uint32_t Typo = 1; Typo < Kind; Typo++)
+		{
+			MakeTypo(Password, Length);
+		}
+	}
+}
+
+// Whether some token is within its allowed edits of a stretch of Password, and at least half of it, the slow way.
+static bool SlowFind(const TOKEN_STORE* Tokens, uint32_t Distance, const uint16_t* Password, uint32_t PasswordLength)
+{
+	uint32_t Row[FUZZY_MAX_PASSWORD_LENGTH + 1];
+
+	for (uint32_t TokenIndex = 0; TokenIndex < Tokens->TokenCount; TokenIndex++)
+	{
+		uint32_t TokenLength = 0;
+
+		const uint8_t* Token = TokenStoreGet(Tokens, TokenIndex, &TokenLength);
+
+		if (TokenLength * 2 < PasswordLength)
+		{
+			continue;
+		}
+
+		// A stretch may start anywhere, so the first row is all zeros.
+		memset(Row, 0, sizeof(Row));
+
+		for (uint32_t TokenPosition = 1; TokenPosition <= TokenLength; TokenPosition++)
+		{
+			uint32_t Diagonal = Row[0];
+
+			Row[0] = TokenPosition;
+
+			for (uint32_t Position = 1; Position <= PasswordLength; Position++)
+			{
+				uint32_t Above = Row[Position];
+
+				uint32_t Best = Diagonal + ((Password[Position - 1] == Token[TokenPosition - 1]) ? 0 : 1);
+
+				Best = (Above + 1 < Best) ? Above + 1 : Best;
+
+				Best = (Row[Position - 1] + 1 < Best) ? Row[Position - 1] + 1 : Best;
+
+				Diagonal = Above;
+
+				Row[Position] = Best;
+			}
+		}
+
+		for (uint32_t Position = 1; Position <= PasswordLength; Position++)
+		{
+			if (Row[Position] <= FuzzyAllowedEdits(Distance, TokenLength))
+			{
+				return(true);
+			}
+		}
+	}
+
+	return(false);
+}
+
+// The trie search against SlowFind, on a small list. Returns the number of passwords they disagree about.
+static uint64_t CheckAgainstSlowFind(void)
+{
+	size_t TextSize = 0;
+
+	uint8_t* Text = ToolGenerateBlacklist(FUZZY_BENCH_CHECK_TOKENS, &TextSize);
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t Password[FUZZY_MAX_PASSWORD_LENGTH];
+
+	uint64_t Errors = 0;
+
+	uint64_t Found = 0;
+
+	if (Text == NULL || BlacklistLoad(Text, TextSize, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the blacklist!\n");
+
+		free(Text);
+
+		return(1);
+	}
+
+	free(Text);
+
+	for (uint32_t Distance = 0; Distance <= FUZZY_MAX_DISTANCE; Distance++)
+	{
+		for (uint32_t Index = 0; Index < FUZZY_BENCH_CHECK_PASSWORDS; Index++)
+		{
+			uint32_t Length = 4 + (uint32_t)(ToolRandom() % 20);
+
+			MakePasswords(Password, Length, 1, &Tokens, Index % FUZZY_BENCH_KINDS);
+
+			NormalizeString(Password, Length);
+
+			FUZZY_STATUS Status = FuzzyNotFound;
+
+			uint32_t Match = FuzzyFindToken(Automaton, Password, Length, Distance, UINT64_MAX, &Status, NULL);
+
+			bool Expected = SlowFind(&Tokens, Distance, Password, Length);
+
+			Found += Expected;
+
+			if ((Match != AC_NO_PATTERN) != Expected)
+			{
+				if (Errors < 10)
+				{
+					fprintf(stderr, "The trie search says %s for \"", (Match != AC_NO_PATTERN) ? "found" : "not found");
+
+					for (uint32_t Position = 0; Position < Length; Position++)
+					{
+						fputc((int)Password[Position], stderr);
+					}
+
+					fprintf(stderr, "\" at distance %u.\n", Distance);
+				}
+
+				Errors++;
+			}
+		}
+	}
+
+	printf("%u passwords against %u tokens at each distance from 0 to %d: %llu rejected, %llu searches wrong.\n",
+		FUZZY_BENCH_CHECK_PASSWORDS,
+		Tokens.TokenCount,
+		FUZZY_MAX_DISTANCE,
+		(unsigned long long)Found,
+		(unsigned long long)Errors);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(Errors);
+}
+
+static void RunChecks(AC_AUTOMATON* Automaton, SCRATCH_POOL* Scratch, const uint16_t* Passwords, uint32_t Length, uint64_t Checks, uint64_t* Latencies, FUZZY_BENCH_RESULT* Result)
+{
+	uint16_t Password[FUZZY_MAX_PASSWORD_LENGTH];
+
+	uint64_t TotalStates = 0;
+
+	uint64_t Searches = 0;
+
+	memset(Result, 0, sizeof(FUZZY_BENCH_RESULT));
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		PLATFORM_STRING String = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Passwords + (Check * Length) };
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		uint64_t CheckStart = PlatformTimestamp();
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, NULL, Scratch, &String, NULL, NULL, &MatchedPattern);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		Result->Rejected += PasswordVerdictRejects(Verdict);
+
+		Result->OverBudget += (Verdict == PasswordAcceptedOverBudget);
+	}
+
+	// The search again, outside of the timing, just to count how much of the trie it goes through when it runs at all.
+	for (uint64_t Check = 0; Automaton->EditDistance > 0 && Check < Checks && Length <= FUZZY_MAX_PASSWORD_LENGTH; Check++)
+	{
+		FUZZY_STATUS Status = FuzzyNotFound;
+
+		uint64_t States = 0;
+
+		memcpy(Password, Passwords + (Check * Length), Length * sizeof(uint16_t));
+
+		NormalizeString(Password, Length);
+
+		BlacklistCanonicalize(Automaton, Password, Length);
+
+		if (BlacklistFindToken(Automaton, NULL, NULL, Password, Length, NULL) != AC_NO_PATTERN)
+		{
+			continue;
+		}
+
+		FuzzyFindToken(Automaton, Password, Length, Automaton->EditDistance, FUZZY_STATE_BUDGET, &Status, &States);
+
+		TotalStates += States;
+
+		Searches++;
+
+		Result->MaxStates = (States > Result->MaxStates) ? States : Result->MaxStates;
+	}
+
+	Result->AverageStates = (Searches > 0) ? (double)TotalStates / (double)Searches : 0;
+
+	ToolSummarizeLatencies(Latencies, Checks, &Result->Latency);
+}
+
+int CommandFuzzyBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = FUZZY_BENCH_DEFAULT_TOKENS;
+
+	uint64_t Checks = FUZZY_BENCH_DEFAULT_CHECKS;
+
+	uint64_t Length = FUZZY_BENCH_DEFAULT_LENGTH;
+
+	uint8_t* Text = NULL;
+
+	size_t TextSize = 0;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t* Passwords[FUZZY_BENCH_KINDS] = { NULL };
+
+	uint64_t* Latencies = NULL;
+
+	SCRATCH_POOL Scratch;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--length") == 0)
+		{
+			Valid = ((Length = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Length <= FUZZY_MAX_PASSWORD_LENGTH);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool fuzzy-bench [--tokens <n>] [--checks <n>] [--length <1-%d>]\n", FUZZY_MAX_PASSWORD_LENGTH);
+
+			return(2);
+		}
+	}
+
+	if (CheckAgainstSlowFind() != 0)
+	{
+		fprintf(stderr, "The trie search doesn't agree with the slow one!\n");
+
+		return(1);
+	}
+
+	ScratchPoolInitialize(&Scratch);
+
+	if ((Text = ToolGenerateBlacklist((uint32_t)TokenCount, &TextSize)) == NULL || (Latencies = malloc((size_t)Checks * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoad(Text, TextSize, NULL, &Tokens, NULL, &Automaton, &Stats);
+
+	if (Status != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(Status));
+
+		goto End;
+	}
+
+	for (uint32_t Kind = 0; Kind < FUZZY_BENCH_KINDS; Kind++)
+	{
+		if ((Passwords[Kind] = malloc((size_t)Checks * (size_t)Length * sizeof(uint16_t))) == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+
+		MakePasswords(Passwords[Kind], (uint32_t)Length, Checks, &Tokens, Kind);
+	}
+
+	printf("\n%llu lines, %lu unique tokens, %lu automaton states. %llu checks of %llu characters per row, state budget %d.\n\n",
+		(unsigned long long)TokenCount,
+		(unsigned long)Tokens.TokenCount,
+		(unsigned long)Automaton->StateCount,
+		(unsigned long long)Checks,
+		(unsigned long long)Length,
+		FUZZY_STATE_BUDGET);
+
+	printf("distance  passwords  rejected    p50 ns    p99 ns  p99.9 ns    max ns  avg states  max states  over budget\n");
+
+	for (uint32_t Distance = 0; Distance <= FUZZY_BENCH_MAX_DISTANCE; Distance++)
+	{
+		Automaton->EditDistance = (uint8_t)Distance;
+
+		for (uint32_t Kind = 0; Kind < FUZZY_BENCH_KINDS; Kind++)
+		{
+			FUZZY_BENCH_RESULT Result;
+
+			RunChecks(Automaton, &Scratch, Passwords[Kind], (uint32_t)Length, Checks, Latencies, &Result);
+
+			printf("%8lu  %9s  %7.2f%%  %8llu  %8llu  %8llu  %8llu  %10.0f  %10llu  %11llu\n",
+				(unsigned long)Distance,
+				gFuzzyBenchKinds[Kind],
+				(100.0 * (double)Result.Rejected) / (double)Checks,
+				(unsigned long long)Result.Latency.P50,
+				(unsigned long long)Result.Latency.P99,
+				(unsigned long long)Result.Latency.P999,
+				(unsigned long long)Result.Latency.Max,
+				Result.AverageStates,
+				(unsigned long long)Result.MaxStates,
+				(unsigned long long)Result.OverBudget);
+		}
+
+		fflush(stdout);
+	}
+
+	ExitCode = 0;
+
+End:
+
+	for (uint32_t Kind = 0; Kind < FUZZY_BENCH_KINDS; Kind++)
+	{
+		free(Passwords[Kind]);
+	}
+
+	free(Latencies);
+
+	free(Text);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	ScratchPoolDestroy(&Scratch);
+
+	return(ExitCode);
+}
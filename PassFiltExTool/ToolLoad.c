@@ -0,0 +1,298 @@
+/*
+ToolLoad.c
+
+The load-bench command: how fast the blacklist file is split into lines, the way LoadBlacklistSnapshot reads it, against the
+way it would be without the SSE2 fast path in BlacklistParser.c.
+
+For each line count, a blacklist of the usual synthetic tokens (see ToolBench.c) is written to a file, a million lines at a
+time so that even the biggest never has to fit in memory, and mapped read-only, as the DLL maps PassFiltExBlacklist.txt.
+Then the mapped view is split into lines over and over, by BlacklistParserFeed and by a scalar splitter here that goes by the
+same rules one byte at a time, each handing its lines to the same callback, which does next to nothing. The first pass of all
+is not timed, so that both start with the file in the cache, and the best of the timed rounds is what counts, since what is
+being measured is the splitter, not the disk. Both have to find the same lines, or the command fails.
+
+Megabytes are 10^6 bytes. The files are deleted again afterwards.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistParser.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#define LOAD_BENCH_DEFAULT_ROUNDS 3
+
+#define LOAD_BENCH_MAX_SIZES 16
+
+// Lines are generated and written this many at a time.
+#define LOAD_BENCH_CHUNK_LINES 1000000
+
+#define LOAD_BENCH_FILE "PassFiltExLoadBench.txt"
+
+static const uint64_t gLoadBenchDefaultLines[] = { 1000000, 10000000, 100000000 };
+
+// What the callback saw. The two splitters must come out with the same.
+typedef struct LOAD_BENCH_LINES
+{
+	uint64_t Lines;
+
+	uint64_t Bytes;
+
+	uint64_t Sum;
+
+} LOAD_BENCH_LINES;
+
+static bool CountLine(void* Context, const uint8_t* Line, uint32_t Length)
+{
+	LOAD_BENCH_LINES* Lines = Context;
+
+	Lines->Lines++;
+
+	Lines->Bytes += Length;
+
+	// Touches the line, so that it has to be there, and tells lines apart a little without costing much.
+	Lines->Sum += (uint64_t)Line[0] * Length + Line[Length - 1];
+
+	return(true);
+}
+
+// The same rules as BlacklistParserFeed, one byte at a time: lines end at \n, bytes below 0x20 are dropped, long lines are cut.
+static void ScalarSplit(const uint8_t* Data, size_t Size, uint32_t MaxLineLength, LOAD_BENCH_LINES* Lines)
+{
+	uint8_t Line[BLACKLIST_PARSER_MAX_LINE];
+
+	uint32_t Length = 0;
+
+	for (size_t Offset = 0; Offset < Size; Offset++)
+	{
+		uint8_t Byte = Data[Offset];
+
+		if (Byte == 0x0A)
+		{
+			if (Length > 0)
+			{
+				CountLine(Lines, Line, Length);
+			}
+
+			Length = 0;
+		}
+		else if (Byte >= 0x20 && Length < MaxLineLength)
+		{
+			Line[Length++] = Byte;
+		}
+	}
+
+	if (Length > 0)
+	{
+		CountLine(Lines, Line, Length);
+	}
+}
+
+static void ParserSplit(const uint8_t* Data, size_t Size, uint32_t MaxLineLength, LOAD_BENCH_LINES* Lines)
+{
+	BLACKLIST_PARSER Parser;
+
+	BlacklistParserInitialize(&Parser, MaxLineLength, CountLine, Lines);
+
+	BlacklistParserFeed(&Parser, Data, Size);
+
+	BlacklistParserFinish(&Parser);
+}
+
+// Accepts a comma-separated list of line counts. Returns how many there were, or 0 if the list is no good.
+static uint32_t ParseLineCounts(const char* List, uint64_t* LineCounts, uint32_t Capacity)
+{
+	uint32_t Count = 0;
+
+	while (*List != '\0')
+	{
+		char* End = NULL;
+
+		unsigned long long Value = strtoull(List, &End, 10);
+
+		if (End == List || Value == 0 || Value > UINT32_MAX || Count == Capacity || (*End != ',' && *End != '\0'))
+		{
+			return(0);
+		}
+
+		LineCounts[Count++] = (uint64_t)Value;
+
+		List = (*End == ',') ? End + 1 : End;
+	}
+
+	return(Count);
+}
+
+static bool WriteBlacklist(const char* Path, uint64_t LineCount)
+{
+	FILE* File = NULL;
+
+	bool Written = true;
+
+	if ((File = fopen(Path, "wb")) == NULL)
+	{
+		return(false);
+	}
+
+	for (uint64_t Line = 0; Line < LineCount && Written; Line += LOAD_BENCH_CHUNK_LINES)
+	{
+		size_t Size = 0;
+
+		uint32_t Count = (uint32_t)((LineCount - Line < LOAD_BENCH_CHUNK_LINES) ? LineCount - Line : LOAD_BENCH_CHUNK_LINES);
+
+		uint8_t* Text = ToolGenerateBlacklist(Count, &Size);
+
+		Written = (Text != NULL && fwrite(Text, 1, Size, File) == Size);
+
+		free(Text);
+	}
+
+	return((fclose(File) == 0) && Written);
+}
+
+// Best of Rounds, in seconds.
+static double TimeSplitter(void (*Split)(const uint8_t*, size_t, uint32_t, LOAD_BENCH_LINES*), const uint8_t* Data, size_t Size, uint64_t Rounds, LOAD_BENCH_LINES* Lines)
+{
+	double Best = 0.0;
+
+	for (uint64_t Round = 0; Round < Rounds; Round++)
+	{
+		memset(Lines, 0, sizeof(LOAD_BENCH_LINES));
+
+		double StartTime = ToolNowInSeconds();
+
+		Split(Data, Size, MAX_BLACKLIST_STRING_SIZE - 1, Lines);
+
+		double Elapsed = ToolNowInSeconds() - StartTime;
+
+		Best = (Round == 0 || Elapsed < Best) ? Elapsed : Best;
+	}
+
+	return(Best);
+}
+
+int CommandLoadBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t LineCounts[LOAD_BENCH_MAX_SIZES] = { 0 };
+
+	uint32_t LineCountCount = sizeof(gLoadBenchDefaultLines) / sizeof(gLoadBenchDefaultLines[0]);
+
+	uint64_t Rounds = LOAD_BENCH_DEFAULT_ROUNDS;
+
+	const char* Directory = ".";
+
+	char Path[1024] = { 0 };
+
+	memcpy(LineCounts, gLoadBenchDefaultLines, sizeof(gLoadBenchDefaultLines));
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--lines") == 0)
+		{
+			Valid = ((LineCountCount = ParseLineCounts(Arguments[++Argument], LineCounts, LOAD_BENCH_MAX_SIZES)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--rounds") == 0)
+		{
+			Valid = ((Rounds = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--directory") == 0)
+		{
+			Directory = Arguments[++Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool load-bench [--lines <n,n,...>] [--rounds <n>] [--directory <directory>]\n");
+
+			return(2);
+		}
+	}
+
+	snprintf(Path, sizeof(Path), "%s/%s", Directory, LOAD_BENCH_FILE);
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+
+	const char* Kernel = "SSE2";
+
+#else
+
+	const char* Kernel = "scalar (no SSE2 on this target)";
+
+#endif
+
+	printf("Best of %llu rounds, over a mapped file. BlacklistParserFeed is %s.\n\n", (unsigned long long)Rounds, Kernel);
+
+	printf("      lines   file MB   parser MB/s   scalar MB/s   speedup\n");
+
+	for (uint32_t Index = 0; Index < LineCountCount; Index++)
+	{
+		LOAD_BENCH_LINES ParserLines = { 0 };
+
+		LOAD_BENCH_LINES ScalarLines = { 0 };
+
+		size_t Size = 0;
+
+		const uint8_t* Data = NULL;
+
+		if (WriteBlacklist(Path, LineCounts[Index]) == false || (Data = ToolMapFile(Path, &Size)) == NULL)
+		{
+			fprintf(stderr, "Unable to write and map %s!\n", Path);
+
+			goto End;
+		}
+
+		// Once through, untimed, so that both splitters find the file in the cache.
+		ScalarSplit(Data, Size, MAX_BLACKLIST_STRING_SIZE - 1, &ScalarLines);
+
+		double ParserSeconds = TimeSplitter(ParserSplit, Data, Size, Rounds, &ParserLines);
+
+		double ScalarSeconds = TimeSplitter(ScalarSplit, Data, Size, Rounds, &ScalarLines);
+
+		ToolUnmapFile(Data, Size);
+
+		remove(Path);
+
+		double Megabytes = (double)Size / 1e6;
+
+		printf("%11llu %9.1f %13.0f %13.0f %8.2fx\n",
+			(unsigned long long)LineCounts[Index],
+			Megabytes,
+			Megabytes / ParserSeconds,
+			Megabytes / ScalarSeconds,
+			ScalarSeconds / ParserSeconds);
+
+		fflush(stdout);
+
+		if (memcmp(&ParserLines, &ScalarLines, sizeof(LOAD_BENCH_LINES)) != 0 || ParserLines.Lines != LineCounts[Index])
+		{
+			fprintf(stderr, "The splitters found different lines: %llu and %llu, of %llu written!\n", (unsigned long long)ParserLines.Lines, (unsigned long long)ScalarLines.Lines, (unsigned long long)LineCounts[Index]);
+
+			goto End;
+		}
+	}
+
+	ExitCode = 0;
+
+End:
+
+	remove(Path);
+
+	return(ExitCode);
+}
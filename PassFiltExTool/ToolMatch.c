@@ -0,0 +1,412 @@
+/*
+ToolMatch.c
+
+The match-check command: proof that the Aho-Corasick automaton (see AhoCorasick.c) finds exactly what the old PasswordFilter
+found by calling wcsstr once per blacklist token, and that BlacklistFindToken rejects exactly the passwords it did, with a
+token that makes up at least half of the password.
+
+Small random blacklists are loaded, and random passwords are judged against each of them twice: the fast way, and the slow way,
+which is every token looked for at every position of the password in turn, character by character. They have to agree on
+three things: every place where a token ends in the password, which is found by walking the automaton with AcNextState and
+following AcFirstMatch down the dictionary links; whether any token rejects the password; and, when one does, that the token
+BlacklistFindToken returned is really in the password and long enough to reject it.
+
+The lists are made to be where an automaton goes wrong, if it does:
+
+  - Tokens are spelled from a few letters, some of them Latin-1 letters above 127, so that they overlap, nest inside each other
+    and turn up next to each other all the time. Some lists are every piece of one random word, which are all suffixes and
+    prefixes of each other.
+
+  - Passwords also have characters above 255 in them, whose low byte is one of the letters of the tokens. Those can never be
+    part of a token, so a matcher that cut them down to a byte would be caught.
+
+  - Some passwords are made around a token to be exactly twice as long as it, where it just rejects them, or one character
+    longer, where it just doesn't.
+
+The command fails if the two ways ever disagree.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "PassFiltExTool.h"
+
+#define MATCH_CHECK_DEFAULT_LISTS 5000
+
+#define MATCH_CHECK_DEFAULT_PASSWORDS 200
+
+#define MATCH_CHECK_MAX_TOKENS 16
+
+#define MATCH_CHECK_MAX_TOKEN_LENGTH 6
+
+#define MATCH_CHECK_MAX_PASSWORD_LENGTH 24
+
+// Room for every piece of a word as long as the longest token.
+#define MATCH_CHECK_MAX_PIECES ((MATCH_CHECK_MAX_TOKEN_LENGTH * (MATCH_CHECK_MAX_TOKEN_LENGTH + 1)) / 2)
+
+// Tokens can only be spelled from these. 0xE9 and 0xF6 are é and ö, which are already lowercase.
+static const uint8_t gMatchCheckTokenAlphabet[] = { 'a', 'b', 'c', 0xE9, 0xF6 };
+
+// Passwords are spelled from the same, and from characters that have one of them as their low byte: š, ǩ, ũ (U+0161, U+01E9,
+// U+0169), and two that have nothing to do with them.
+static const uint16_t gMatchCheckPasswordAlphabet[] = { 'a', 'b', 'c', 0xE9, 0xF6, 0x0161, 0x01E9, 0x0169, 0x4E2D, '1' };
+
+typedef struct MATCH_CHECK_TOKEN
+{
+	uint8_t Text[MATCH_CHECK_MAX_TOKEN_LENGTH];
+
+	uint32_t Length;
+
+} MATCH_CHECK_TOKEN;
+
+typedef struct MATCH_CHECK_LIST
+{
+	MATCH_CHECK_TOKEN Tokens[MATCH_CHECK_MAX_PIECES];
+
+	uint32_t TokenCount;
+
+} MATCH_CHECK_LIST;
+
+typedef struct MATCH_CHECK_COUNTS
+{
+	uint64_t Passwords;
+
+	uint64_t Rejected;
+
+	uint64_t Matches;
+
+	uint64_t HalfExactly;
+
+	uint64_t HalfAndOne;
+
+	uint64_t Wrong;
+
+} MATCH_CHECK_COUNTS;
+
+// Adds a token unless the list already has it, since the token store keeps only one of each.
+static void AddToken(MATCH_CHECK_LIST* List, const uint8_t* Text, uint32_t Length)
+{
+	for (uint32_t Index = 0; Index < List->TokenCount; Index++)
+	{
+		if (List->Tokens[Index].Length == Length && memcmp(List->Tokens[Index].Text, Text, Length) == 0)
+		{
+			return;
+		}
+	}
+
+	memcpy(List->Tokens[List->TokenCount].Text, Text, Length);
+
+	List->Tokens[List->TokenCount].Length = Length;
+
+	List->TokenCount++;
+}
+
+static uint32_t RandomWord(uint8_t* Text)
+{
+	uint32_t Length = 1 + (uint32_t)(ToolRandom() % MATCH_CHECK_MAX_TOKEN_LENGTH);
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Text[Index] = gMatchCheckTokenAlphabet[ToolRandom() % sizeof(gMatchCheckTokenAlphabet)];
+	}
+
+	return(Length);
+}
+
+// Writes a random list into Text, one token a line, and the tokens into List. Returns the size of the text.
+static size_t RandomList(MATCH_CHECK_LIST* List, uint8_t* Text)
+{
+	uint8_t Word[MATCH_CHECK_MAX_TOKEN_LENGTH];
+
+	size_t Size = 0;
+
+	memset(List, 0, sizeof(MATCH_CHECK_LIST));
+
+	if (ToolRandom() % 4 == 0)
+	{
+		uint32_t Length = RandomWord(Word);
+
+		for (uint32_t Start = 0; Start < Length; Start++)
+		{
+			for (uint32_t End = Start + 1; End <= Length; End++)
+			{
+				AddToken(List, Word + Start, End - Start);
+			}
+		}
+	}
+	else
+	{
+		uint32_t Count = 1 + (uint32_t)(ToolRandom() % MATCH_CHECK_MAX_TOKENS);
+
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			uint32_t Length = RandomWord(Word);
+
+			AddToken(List, Word, Length);
+		}
+	}
+
+	for (uint32_t Index = 0; Index < List->TokenCount; Index++)
+	{
+		memcpy(Text + Size, List->Tokens[Index].Text, List->Tokens[Index].Length);
+
+		Size += List->Tokens[Index].Length;
+
+		Text[Size++] = '\n';
+	}
+
+	return(Size);
+}
+
+static void RandomCharacters(uint16_t* Password, uint32_t Length)
+{
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Password[Index] = gMatchCheckPasswordAlphabet[ToolRandom() % (sizeof(gMatchCheckPasswordAlphabet) / sizeof(gMatchCheckPasswordAlphabet[0]))];
+	}
+}
+
+// Random characters, or random characters around one of the tokens, making the password exactly twice as long as it or one more.
+static uint32_t RandomPassword(const MATCH_CHECK_LIST* List, uint16_t* Password, MATCH_CHECK_COUNTS* Counts)
+{
+	uint32_t Kind = (uint32_t)(ToolRandom() % 3);
+
+	if (Kind == 0)
+	{
+		uint32_t Length = 1 + (uint32_t)(ToolRandom() % MATCH_CHECK_MAX_PASSWORD_LENGTH);
+
+		RandomCharacters(Password, Length);
+
+		return(Length);
+	}
+
+	const MATCH_CHECK_TOKEN* Token = &List->Tokens[ToolRandom() % List->TokenCount];
+
+	uint32_t Length = (Token->Length * 2) + (Kind - 1);
+
+	uint32_t Start = (uint32_t)(ToolRandom() % (Length - Token->Length + 1));
+
+	RandomCharacters(Password, Length);
+
+	for (uint32_t Index = 0; Index < Token->Length; Index++)
+	{
+		Password[Start + Index] = Token->Text[Index];
+	}
+
+	if (Kind == 1)
+	{
+		Counts->HalfExactly++;
+	}
+	else
+	{
+		Counts->HalfAndOne++;
+	}
+
+	return(Length);
+}
+
+// The old way: every token looked for at every position, the way wcsstr would, counting every place where one ends.
+static bool SlowFind(const uint8_t* Token, uint32_t TokenLength, const uint16_t* Password, uint32_t Length, uint64_t* Matches)
+{
+	bool Found = false;
+
+	for (uint32_t Start = 0; Start + TokenLength <= Length; Start++)
+	{
+		uint32_t Matched = 0;
+
+		while (Matched < TokenLength && Password[Start + Matched] == (uint16_t)Token[Matched])
+		{
+			Matched++;
+		}
+
+		if (Matched == TokenLength)
+		{
+			Found = true;
+
+			*Matches += 1;
+		}
+	}
+
+	return(Found);
+}
+
+static bool SlowRejects(const MATCH_CHECK_LIST* List, const uint16_t* Password, uint32_t Length, uint64_t* Matches)
+{
+	bool Rejected = false;
+
+	for (uint32_t Index = 0; Index < List->TokenCount; Index++)
+	{
+		const MATCH_CHECK_TOKEN* Token = &List->Tokens[Index];
+
+		if (SlowFind(Token->Text, Token->Length, Password, Length, Matches) && Token->Length * 100 >= AC_DEFAULT_COVERAGE * Length)
+		{
+			Rejected = true;
+		}
+	}
+
+	return(Rejected);
+}
+
+// Every place where a token ends, by walking the automaton and the dictionary links of every state on the way.
+static uint64_t AutomatonMatches(const AC_AUTOMATON* Automaton, const uint16_t* Password, uint32_t Length)
+{
+	uint64_t Matches = 0;
+
+	uint32_t State = AC_ROOT_STATE;
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		State = AcNextState(Automaton, State, Password[Index]);
+
+		for (uint32_t Match = AcFirstMatch(Automaton, State); Match != AC_ROOT_STATE; Match = Automaton->States[Match].DictionaryLink)
+		{
+			Matches++;
+		}
+	}
+
+	return(Matches);
+}
+
+static void CheckList(const MATCH_CHECK_LIST* List, const uint8_t* Text, size_t Size, uint32_t Passwords, MATCH_CHECK_COUNTS* Counts)
+{
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t Password[MATCH_CHECK_MAX_PASSWORD_LENGTH];
+
+	if (BlacklistLoad(Text, Size, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk || Tokens.TokenCount != List->TokenCount)
+	{
+		fprintf(stderr, "Unable to load a random blacklist of %lu tokens, or it came out with %lu!\n", (unsigned long)List->TokenCount, (unsigned long)Tokens.TokenCount);
+
+		Counts->Wrong++;
+
+		goto End;
+	}
+
+	for (uint32_t Check = 0; Check < Passwords; Check++)
+	{
+		uint64_t SlowMatches = 0;
+
+		uint32_t Length = RandomPassword(List, Password, Counts);
+
+		bool Expected = SlowRejects(List, Password, Length, &SlowMatches);
+
+		uint64_t FastMatches = AutomatonMatches(Automaton, Password, Length);
+
+		uint32_t PatternId = BlacklistFindToken(Automaton, NULL, NULL, Password, Length, NULL);
+
+		bool Valid = (FastMatches == SlowMatches && (PatternId != AC_NO_PATTERN) == Expected);
+
+		if (Valid && PatternId != AC_NO_PATTERN)
+		{
+			uint32_t TokenLength = 0;
+
+			uint64_t Ignored = 0;
+
+			const uint8_t* Token = TokenStoreGet(&Tokens, PatternId, &TokenLength);
+
+			Valid = (SlowFind(Token, TokenLength, Password, Length, &Ignored) && TokenLength * 100 >= AC_DEFAULT_COVERAGE * Length);
+		}
+
+		if (Valid == false)
+		{
+			if (Counts->Wrong < 10)
+			{
+				fprintf(stderr, "A password of %lu characters: %llu matches the slow way, %llu the fast way, expected %s, got pattern %lu. The list:\n%.*s\n",
+					(unsigned long)Length,
+					(unsigned long long)SlowMatches,
+					(unsigned long long)FastMatches,
+					Expected ? "rejected" : "accepted",
+					(unsigned long)PatternId,
+					(int)Size,
+					(const char*)Text);
+			}
+
+			Counts->Wrong++;
+		}
+
+		Counts->Passwords++;
+
+		Counts->Rejected += Expected;
+
+		Counts->Matches += SlowMatches;
+	}
+
+End:
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+}
+
+int CommandMatchCheck(int ArgumentCount, char** Arguments)
+{
+	uint64_t Lists = MATCH_CHECK_DEFAULT_LISTS;
+
+	uint64_t Passwords = MATCH_CHECK_DEFAULT_PASSWORDS;
+
+	uint8_t Text[MATCH_CHECK_MAX_PIECES * (MATCH_CHECK_MAX_TOKEN_LENGTH + 1)];
+
+	MATCH_CHECK_LIST List;
+
+	MATCH_CHECK_COUNTS Counts = { 0 };
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--lists") == 0)
+		{
+			Valid = ((Lists = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--passwords") == 0)
+		{
+			Valid = ((Passwords = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Passwords <= UINT32_MAX);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool match-check [--lists <n>] [--passwords <n>]\n");
+
+			return(2);
+		}
+	}
+
+	for (uint64_t Round = 0; Round < Lists; Round++)
+	{
+		size_t Size = RandomList(&List, Text);
+
+		CheckList(&List, Text, Size, (uint32_t)Passwords, &Counts);
+	}
+
+	printf("%llu random blacklists, %llu passwords, %llu of them made exactly twice as long as a token and %llu one longer: %llu rejected, %llu token matches, %llu wrong.\n",
+		(unsigned long long)Lists,
+		(unsigned long long)Counts.Passwords,
+		(unsigned long long)Counts.HalfExactly,
+		(unsigned long long)Counts.HalfAndOne,
+		(unsigned long long)Counts.Rejected,
+		(unsigned long long)Counts.Matches,
+		(unsigned long long)Counts.Wrong);
+
+	if (Counts.Wrong != 0)
+	{
+		fprintf(stderr, "The automaton and the slow way disagreed!\n");
+
+		return(1);
+	}
+
+	return(0);
+}
@@ -0,0 +1,503 @@
+/*
+ToolNames.c
+
+The name-check command: proof that passwords made of the user's own names are rejected (see NameMatch.c), and what looking for
+the names adds to every password change.
+
+First, a handful of known cases go through PasswordCheck, with a small blacklist that has !substitute lines, so that the
+splitting, the folding, the substitutions and the 50% rule are all seen to work, as is a blacklist token winning over a name.
+
+Then the Shift-And matcher is checked against the obvious way of doing the same thing: every part of both names, split the way
+Windows splits them, looked for in the password one at a time. The names and passwords are random, from a small alphabet with
+the delimiters in it, so that parts are short and matches are common. The command fails if the two ever disagree.
+
+Last, a blacklist of the usual synthetic tokens (see ToolBench.c) is loaded, and the same passwords are put through
+PasswordCheck without names and with TOOL_ACCOUNT_NAME and TOOL_FULL_NAME, each call timed on its own, with allocations counted
+around the runs with names. The command fails if there were any.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "NameMatch.h"
+
+#include "Normalize.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#define NAME_CHECK_DEFAULT_TOKENS 1000000
+
+#define NAME_CHECK_DEFAULT_CHECKS 100000
+
+#define NAME_CHECK_PASSWORD_LENGTH 12
+
+#define NAME_CHECK_RANDOM_CASES 200000
+
+// Short enough that every part of both names, and the whole account name, always fit into NAME_MAX_CHARACTERS.
+#define NAME_CHECK_MAX_ACCOUNT_NAME 12
+
+#define NAME_CHECK_MAX_FULL_NAME 20
+
+// Twice the longest name.
+#define NAME_CHECK_MAX_RANDOM_PASSWORD 40
+
+static const char gNameCheckBlacklist[] = "!substitute o0\n!substitute a@4\npassword\n";
+
+// Upper and lower case, both sides of each substitution, and every delimiter, though less often, so that most parts are long
+// enough to count.
+static const char gNameCheckAlphabet[] = "abABo0@4s" "abABo0@4s" "abABo0@4s" ",.-_ #\t";
+
+static const char gNameCheckDelimiters[] = ",.-_ #\t";
+
+typedef struct NAME_CHECK_CASE
+{
+	const char* AccountName;
+
+	const char* FullName;
+
+	const char* Password;
+
+	PASSWORD_VERDICT Expected;
+
+} NAME_CHECK_CASE;
+
+// The Cyrillic ones are UTF-8, spelled out so that every compiler reads them the same way.
+static const NAME_CHECK_CASE gNameCheckCases[] =
+{
+	{ "jsmith", "John Smith", "JSmith2024!", PasswordContainsName },
+	{ "jsmith", "John Smith", "Smith.John", PasswordContainsName },
+	{ "jsmith", "John Smith", "Smith.John.1234", PasswordAccepted },
+	{ "jsmith", "Johnny Appleseed", "J0HNNY!!", PasswordContainsName },
+	{ "jsmith", "Johnny Appleseed", "4ppleseed99", PasswordContainsName },
+	{ "jsmith", "Johnny Appleseed", "Johnny!Appleseed!99", PasswordAccepted },
+	{ "jsmith.admin", "", "Jsmith.Admin1", PasswordContainsName },
+	{ "jsmith.admin", "", "jsmith-admin1", PasswordAccepted },
+	{ "al", "Al Bo", "al", PasswordAccepted },
+	{ "jsmith", "John Smith", "password1", PasswordBlacklisted },
+	{ "jsmith", "John Smith", "P@ssw0rdSmith", PasswordBlacklisted },
+	{ NULL, NULL, "JSmith2024!", PasswordAccepted },
+	{ "ivan", "\xD0\x98\xD0\xB2\xD0\xB0\xD0\xBD \xD0\x9F\xD0\xB5\xD1\x82\xD1\x80\xD0\xBE\xD0\xB2", "\xD0\x98\xD0\xB2\xD0\xB0\xD0\xBD" "2024", PasswordContainsName },
+};
+
+void ToolMakeNames(TOOL_NAMES* Names, const char* AccountName, const char* FullName)
+{
+	Names->AccountName.Length = (uint16_t)(ToolDecodeUtf8((const uint8_t*)AccountName, (uint32_t)strlen(AccountName), Names->AccountNameBuffer, TOOL_MAX_NAME_LENGTH) * sizeof(uint16_t));
+
+	Names->AccountName.MaximumLength = (uint16_t)sizeof(Names->AccountNameBuffer);
+
+	Names->AccountName.Buffer = Names->AccountNameBuffer;
+
+	Names->FullName.Length = (uint16_t)(ToolDecodeUtf8((const uint8_t*)FullName, (uint32_t)strlen(FullName), Names->FullNameBuffer, TOOL_MAX_NAME_LENGTH) * sizeof(uint16_t));
+
+	Names->FullName.MaximumLength = (uint16_t)sizeof(Names->FullNameBuffer);
+
+	Names->FullName.Buffer = Names->FullNameBuffer;
+}
+
+static bool IsDelimiter(uint16_t Character)
+{
+	return(Character < 0x80 && Character != 0 && strchr(gNameCheckDelimiters, (char)Character) != NULL);
+}
+
+// Whether Part, folded and canonicalized, is in Password (which already is) and makes up at least half of it.
+static bool SlowFindPart(const AC_AUTOMATON* Automaton, const uint16_t* Part, size_t PartLength, const uint16_t* Password, size_t PasswordLength)
+{
+	uint16_t Folded[TOOL_MAX_NAME_LENGTH];
+
+	if (PartLength < NAME_MIN_PART_LENGTH || PartLength * 2 < PasswordLength || PartLength > PasswordLength)
+	{
+		return(false);
+	}
+
+	for (size_t Index = 0; Index < PartLength; Index++)
+	{
+		Folded[Index] = NormalizeCharacter(Part[Index]);
+	}
+
+	BlacklistCanonicalize(Automaton, Folded, PartLength);
+
+	for (size_t Start = 0; Start + PartLength <= PasswordLength; Start++)
+	{
+		if (memcmp(&Password[Start], Folded, PartLength * sizeof(uint16_t)) == 0)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+// Returns whether any part of Name is in the password, and sets *Split if Name has more than one part.
+static bool SlowFindParts(const AC_AUTOMATON* Automaton, const PLATFORM_STRING* Name, const uint16_t* Password, size_t PasswordLength, bool* Split)
+{
+	size_t Length = Name->Length / sizeof(uint16_t);
+
+	size_t Start = 0;
+
+	bool Found = false;
+
+	*Split = false;
+
+	for (size_t Index = 0; Index < Length; Index++)
+	{
+		if (IsDelimiter(Name->Buffer[Index]))
+		{
+			Found |= SlowFindPart(Automaton, &Name->Buffer[Start], Index - Start, Password, PasswordLength);
+
+			Start = Index + 1;
+
+			*Split = true;
+		}
+	}
+
+	return(Found | SlowFindPart(Automaton, &Name->Buffer[Start], Length - Start, Password, PasswordLength));
+}
+
+static bool SlowContainsName(const AC_AUTOMATON* Automaton, const TOOL_NAMES* Names, const uint16_t* Password, size_t PasswordLength)
+{
+	uint16_t Folded[NAME_CHECK_MAX_RANDOM_PASSWORD];
+
+	bool AccountNameSplit = false;
+
+	bool FullNameSplit = false;
+
+	for (size_t Index = 0; Index < PasswordLength; Index++)
+	{
+		Folded[Index] = NormalizeCharacter(Password[Index]);
+	}
+
+	BlacklistCanonicalize(Automaton, Folded, PasswordLength);
+
+	bool Found = SlowFindParts(Automaton, &Names->AccountName, Folded, PasswordLength, &AccountNameSplit);
+
+	Found |= SlowFindParts(Automaton, &Names->FullName, Folded, PasswordLength, &FullNameSplit);
+
+	if (AccountNameSplit)
+	{
+		Found |= SlowFindPart(Automaton, Names->AccountName.Buffer, Names->AccountName.Length / sizeof(uint16_t), Folded, PasswordLength);
+	}
+
+	return(Found);
+}
+
+static void RandomText(char* Text, uint32_t MaxLength)
+{
+	uint32_t Length = (uint32_t)(ToolRandom() % (MaxLength + 1));
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Text[Index] = gNameCheckAlphabet[ToolRandom() % (sizeof(gNameCheckAlphabet) - 1)];
+	}
+
+	Text[Length] = '\0';
+}
+
+// Half of the passwords are a piece of one of the names with up to as many random characters again around it, so that a good
+// share of them match, and many only just do or just don't.
+static uint32_t RandomPassword(uint16_t* Password, const TOOL_NAMES* Names)
+{
+	uint32_t Length = 1 + (uint32_t)(ToolRandom() % NAME_CHECK_MAX_RANDOM_PASSWORD);
+
+	const PLATFORM_STRING* Name = (ToolRandom() % 2) ? &Names->AccountName : &Names->FullName;
+
+	uint32_t NameLength = Name->Length / sizeof(uint16_t);
+
+	uint32_t PieceStart = 0;
+
+	uint32_t PieceLength = 0;
+
+	if ((ToolRandom() % 2) == 0 && NameLength > 0)
+	{
+		PieceStart = (uint32_t)(ToolRandom() % NameLength);
+
+		PieceLength = 1 + (uint32_t)(ToolRandom() % (NameLength - PieceStart));
+
+		Length = PieceLength + (uint32_t)(ToolRandom() % (PieceLength + 1));
+	}
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Password[Index] = (uint16_t)gNameCheckAlphabet[ToolRandom() % (sizeof(gNameCheckAlphabet) - 1)];
+	}
+
+	uint32_t Offset = (uint32_t)(ToolRandom() % (Length - PieceLength + 1));
+
+	memcpy(&Password[Offset], &Name->Buffer[PieceStart], PieceLength * sizeof(uint16_t));
+
+	return(Length);
+}
+
+// The known cases, then the Shift-And matcher against SlowContainsName. Returns the number of passwords that came out wrong.
+static uint64_t CheckCases(void)
+{
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	TOOL_NAMES Names;
+
+	uint16_t Password[TOOL_MAX_NAME_LENGTH];
+
+	char AccountName[NAME_CHECK_MAX_ACCOUNT_NAME + 1];
+
+	char FullName[NAME_CHECK_MAX_FULL_NAME + 1];
+
+	uint64_t Wrong = 0;
+
+	uint64_t Matches = 0;
+
+	if (BlacklistLoad((const uint8_t*)gNameCheckBlacklist, sizeof(gNameCheckBlacklist) - 1, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the test blacklist!\n");
+
+		return(1);
+	}
+
+	for (size_t Case = 0; Case < sizeof(gNameCheckCases) / sizeof(gNameCheckCases[0]); Case++)
+	{
+		const NAME_CHECK_CASE* Known = &gNameCheckCases[Case];
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		size_t Length = ToolDecodeUtf8((const uint8_t*)Known->Password, (uint32_t)strlen(Known->Password), Password, TOOL_MAX_NAME_LENGTH);
+
+		PLATFORM_STRING String = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Password };
+
+		PASSWORD_VERDICT Verdict = PasswordAccepted;
+
+		if (Known->AccountName != NULL)
+		{
+			ToolMakeNames(&Names, Known->AccountName, Known->FullName);
+
+			Verdict = PasswordCheck(Automaton, NULL, NULL, NULL, &String, &Names.AccountName, &Names.FullName, &MatchedPattern);
+		}
+		else
+		{
+			Verdict = PasswordCheck(Automaton, NULL, NULL, NULL, &String, NULL, NULL, &MatchedPattern);
+		}
+
+		if (Verdict != Known->Expected)
+		{
+			fprintf(stderr, "%s / %s / %s: expected %s, got %s.\n", (Known->AccountName != NULL) ? Known->AccountName : "(none)", (Known->FullName != NULL) ? Known->FullName : "(none)", Known->Password, PasswordVerdictString(Known->Expected), PasswordVerdictString(Verdict));
+
+			Wrong++;
+		}
+	}
+
+	printf("%lu known cases, %llu wrong.\n", (unsigned long)(sizeof(gNameCheckCases) / sizeof(gNameCheckCases[0])), (unsigned long long)Wrong);
+
+	// No token can be spelled with the random alphabet, so a rejection here is always the name.
+	for (uint32_t Case = 0; Case < NAME_CHECK_RANDOM_CASES; Case++)
+	{
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		RandomText(AccountName, NAME_CHECK_MAX_ACCOUNT_NAME);
+
+		RandomText(FullName, NAME_CHECK_MAX_FULL_NAME);
+
+		ToolMakeNames(&Names, AccountName, FullName);
+
+		uint32_t Length = RandomPassword(Password, &Names);
+
+		PLATFORM_STRING String = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Password };
+
+		bool Expected = SlowContainsName(Automaton, &Names, Password, Length);
+
+		bool Found = (PasswordCheck(Automaton, NULL, NULL, NULL, &String, &Names.AccountName, &Names.FullName, &MatchedPattern) == PasswordContainsName);
+
+		Matches += Expected;
+
+		if (Found != Expected)
+		{
+			if (Wrong < 10)
+			{
+				fprintf(stderr, "\"%s\" / \"%s\": expected %s for a password of %lu characters.\n", AccountName, FullName, Expected ? "a match" : "no match", (unsigned long)Length);
+			}
+
+			Wrong++;
+		}
+	}
+
+	printf("%lu random names and passwords, %llu containing a name, %llu wrong in all.\n", (unsigned long)NAME_CHECK_RANDOM_CASES, (unsigned long long)Matches, (unsigned long long)Wrong);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(Wrong);
+}
+
+static void RunChecks(const AC_AUTOMATON* Automaton, SCRATCH_POOL* Scratch, const TOOL_NAMES* Names, const uint16_t* Passwords, uint64_t Checks, uint64_t* Latencies)
+{
+	uint64_t Rejected = 0;
+
+	TOOL_LATENCY_SUMMARY Latency;
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		PLATFORM_STRING String = { NAME_CHECK_PASSWORD_LENGTH * sizeof(uint16_t), NAME_CHECK_PASSWORD_LENGTH * sizeof(uint16_t), Passwords + (Check * NAME_CHECK_PASSWORD_LENGTH) };
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		uint64_t CheckStart = PlatformTimestamp();
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, NULL, Scratch, &String, (Names != NULL) ? &Names->AccountName : NULL, (Names != NULL) ? &Names->FullName : NULL, &MatchedPattern);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		Rejected += PasswordVerdictRejects(Verdict);
+	}
+
+	ToolSummarizeLatencies(Latencies, Checks, &Latency);
+
+	printf("%10s  %7.2f%%  %8llu  %8llu  %8llu  %8llu\n",
+		(Names != NULL) ? "with" : "without",
+		(100.0 * (double)Rejected) / (double)Checks,
+		(unsigned long long)Latency.Mean,
+		(unsigned long long)Latency.P50,
+		(unsigned long long)Latency.P99,
+		(unsigned long long)Latency.P999);
+}
+
+int CommandNameCheck(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = NAME_CHECK_DEFAULT_TOKENS;
+
+	uint64_t Checks = NAME_CHECK_DEFAULT_CHECKS;
+
+	uint8_t* Text = NULL;
+
+	size_t TextSize = 0;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t* Passwords = NULL;
+
+	uint64_t* Latencies = NULL;
+
+	TOOL_NAMES Names;
+
+	SCRATCH_POOL Scratch;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool name-check [--tokens <n>] [--checks <n>]\n");
+
+			return(2);
+		}
+	}
+
+	if (CheckCases() != 0)
+	{
+		fprintf(stderr, "Names were not matched the way they should have been!\n");
+
+		return(1);
+	}
+
+	ScratchPoolInitialize(&Scratch);
+
+	ToolMakeNames(&Names, TOOL_ACCOUNT_NAME, TOOL_FULL_NAME);
+
+	if ((Text = ToolGenerateBlacklist((uint32_t)TokenCount, &TextSize)) == NULL ||
+		(Passwords = malloc((size_t)Checks * NAME_CHECK_PASSWORD_LENGTH * sizeof(uint16_t))) == NULL ||
+		(Latencies = malloc((size_t)Checks * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoad(Text, TextSize, NULL, &Tokens, NULL, &Automaton, &Stats);
+
+	if (Status != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(Status));
+
+		goto End;
+	}
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		ToolMakePassword(Passwords + (Check * NAME_CHECK_PASSWORD_LENGTH), NAME_CHECK_PASSWORD_LENGTH, &Tokens, false);
+	}
+
+	printf("\n%llu lines, %lu unique tokens. %llu checks of %d characters, for %s (%s).\n\n",
+		(unsigned long long)TokenCount,
+		(unsigned long)Tokens.TokenCount,
+		(unsigned long long)Checks,
+		NAME_CHECK_PASSWORD_LENGTH,
+		TOOL_ACCOUNT_NAME,
+		TOOL_FULL_NAME);
+
+	printf("     names  rejected   mean ns    p50 ns    p99 ns  p99.9 ns\n");
+
+	// Once each way to warm up, then the runs that count.
+	RunChecks(Automaton, &Scratch, NULL, Passwords, Checks, Latencies);
+
+	RunChecks(Automaton, &Scratch, &Names, Passwords, Checks, Latencies);
+
+	uint64_t AllocationsBefore = PlatformAllocationCount();
+
+	RunChecks(Automaton, &Scratch, &Names, Passwords, Checks, Latencies);
+
+	uint64_t Allocations = PlatformAllocationCount() - AllocationsBefore;
+
+	RunChecks(Automaton, &Scratch, NULL, Passwords, Checks, Latencies);
+
+	printf("\n%llu allocations while checking with names.\n", (unsigned long long)Allocations);
+
+	ExitCode = (Allocations == 0) ? 0 : 1;
+
+End:
+
+	free(Latencies);
+
+	free(Passwords);
+
+	free(Text);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	ScratchPoolDestroy(&Scratch);
+
+	return(ExitCode);
+}
@@ -0,0 +1,324 @@
+/*
+ToolNormalize.c
+
+The normalize-bench command: checks that every folding kernel this CPU can run (see Normalize.c) gives exactly what the
+scalar one does, and then measures how fast each of them is.
+
+The checks:
+
+  - Every character of the BMP, one after the other, in one long string, so that each kernel sees blocks of nothing but
+    ASCII and Latin-1 as well as blocks with higher characters in them.
+
+  - Lots of random strings, from empty up to a few hundred characters, starting at every alignment, drawn mostly from ASCII
+    with some Latin-1, some of the four characters that fold into Latin-1 from outside it, and some anything at all. The
+    characters either side of each string must be left alone.
+
+  - The same for bytes, the way blacklist lines are folded.
+
+The command fails if a kernel gets anything wrong, so it doubles as a test of Normalize.c on whatever machine it runs on.
+Then it times each kernel on passwords of a typical length, on long ASCII text, on long text with a share of characters
+above Latin-1, and on bytes.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Normalize.h"
+
+#include "PassFiltExTool.h"
+
+#define NORMALIZE_BENCH_DEFAULT_MEGABYTES 256
+
+#define NORMALIZE_BENCH_RANDOM_STRINGS 200000
+
+#define NORMALIZE_BENCH_MAX_RANDOM_LENGTH 300
+
+// Room for the longest random string at any alignment, with a guard character either side.
+#define NORMALIZE_BENCH_SCRATCH_LENGTH (NORMALIZE_BENCH_MAX_RANDOM_LENGTH + 64)
+
+#define NORMALIZE_BENCH_GUARD 0x5A5A
+
+#define NORMALIZE_BENCH_PASSWORD_LENGTH 16
+
+#define NORMALIZE_BENCH_LONG_LENGTH 4096
+
+static const uint16_t gOutsideLatin1Folds[] = { 0x0130, 0x0178, 0x212A, 0x212B };
+
+static uint16_t RandomCharacter(void)
+{
+	uint64_t Random = ToolRandom();
+
+	switch (Random % 10)
+	{
+		case 0:
+		{
+			return((uint16_t)(0x80 + ((Random >> 8) % 0x80)));
+		}
+		case 1:
+		{
+			return(gOutsideLatin1Folds[(Random >> 8) % 4]);
+		}
+		case 2:
+		{
+			return((uint16_t)(Random >> 8));
+		}
+		default:
+		{
+			return((uint16_t)((Random >> 8) % 0x80));
+		}
+	}
+}
+
+// Every character of the BMP in order, folded by Kernel, against NormalizeCharacter.
+static uint64_t CheckWholeBmp(NORMALIZE_KERNEL Kernel, uint16_t* Text)
+{
+	uint64_t Errors = 0;
+
+	for (uint32_t Character = 0; Character <= 0xFFFF; Character++)
+	{
+		Text[Character] = (uint16_t)Character;
+	}
+
+	NormalizeStringWith(Kernel, Text, 0x10000);
+
+	for (uint32_t Character = 0; Character <= 0xFFFF; Character++)
+	{
+		Errors += (Text[Character] != NormalizeCharacter((uint16_t)Character));
+	}
+
+	return(Errors);
+}
+
+// Random strings at every alignment, folded by Kernel and by the scalar kernel, guards included.
+static uint64_t CheckRandomStrings(NORMALIZE_KERNEL Kernel)
+{
+	uint16_t Expected[NORMALIZE_BENCH_SCRATCH_LENGTH];
+
+	uint16_t Actual[NORMALIZE_BENCH_SCRATCH_LENGTH];
+
+	uint8_t ExpectedBytes[NORMALIZE_BENCH_SCRATCH_LENGTH];
+
+	uint8_t ActualBytes[NORMALIZE_BENCH_SCRATCH_LENGTH];
+
+	uint64_t Errors = 0;
+
+	for (uint32_t Round = 0; Round < NORMALIZE_BENCH_RANDOM_STRINGS; Round++)
+	{
+		size_t Offset = 1 + (Round % 32);
+
+		size_t Length = (size_t)(ToolRandom() % (NORMALIZE_BENCH_MAX_RANDOM_LENGTH + 1));
+
+		for (size_t Index = 0; Index < NORMALIZE_BENCH_SCRATCH_LENGTH; Index++)
+		{
+			Expected[Index] = (Index >= Offset && Index < Offset + Length) ? RandomCharacter() : NORMALIZE_BENCH_GUARD;
+
+			ExpectedBytes[Index] = (uint8_t)Expected[Index];
+		}
+
+		memcpy(Actual, Expected, sizeof(Actual));
+
+		memcpy(ActualBytes, ExpectedBytes, sizeof(ActualBytes));
+
+		NormalizeStringWith(NormalizeKernelScalar, Expected + Offset, Length);
+
+		NormalizeStringWith(Kernel, Actual + Offset, Length);
+
+		NormalizeTokenBytesWith(NormalizeKernelScalar, ExpectedBytes + Offset, (uint32_t)Length);
+
+		NormalizeTokenBytesWith(Kernel, ActualBytes + Offset, (uint32_t)Length);
+
+		Errors += (memcmp(Expected, Actual, sizeof(Actual)) != 0);
+
+		Errors += (memcmp(ExpectedBytes, ActualBytes, sizeof(ActualBytes)) != 0);
+	}
+
+	return(Errors);
+}
+
+static uint64_t CheckEveryByte(NORMALIZE_KERNEL Kernel)
+{
+	uint8_t Bytes[256];
+
+	uint64_t Errors = 0;
+
+	for (uint32_t Byte = 0; Byte < 256; Byte++)
+	{
+		Bytes[Byte] = (uint8_t)Byte;
+	}
+
+	NormalizeTokenBytesWith(Kernel, Bytes, 256);
+
+	for (uint32_t Byte = 0; Byte < 256; Byte++)
+	{
+		Errors += (Bytes[Byte] != (uint8_t)NormalizeCharacter((uint16_t)Byte));
+	}
+
+	return(Errors);
+}
+
+// Folds Text, Length characters at a time, until Bytes bytes have gone through. Returns megabytes per second.
+static double TimeStrings(NORMALIZE_KERNEL Kernel, uint16_t* Text, size_t Length, uint64_t Bytes)
+{
+	uint64_t Rounds = Bytes / (Length * sizeof(uint16_t));
+
+	double StartTime = ToolNowInSeconds();
+
+	for (uint64_t Round = 0; Round < Rounds; Round++)
+	{
+		NormalizeStringWith(Kernel, Text, Length);
+	}
+
+	double Elapsed = ToolNowInSeconds() - StartTime;
+
+	return(((double)Rounds * (double)(Length * sizeof(uint16_t))) / 1e6 / ((Elapsed > 0) ? Elapsed : 1e-9));
+}
+
+static double TimeBytes(NORMALIZE_KERNEL Kernel, uint8_t* Text, uint32_t Length, uint64_t Bytes)
+{
+	uint64_t Rounds = Bytes / Length;
+
+	double StartTime = ToolNowInSeconds();
+
+	for (uint64_t Round = 0; Round < Rounds; Round++)
+	{
+		NormalizeTokenBytesWith(Kernel, Text, Length);
+	}
+
+	double Elapsed = ToolNowInSeconds() - StartTime;
+
+	return(((double)Rounds * (double)Length) / 1e6 / ((Elapsed > 0) ? Elapsed : 1e-9));
+}
+
+int CommandNormalizeBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t Megabytes = NORMALIZE_BENCH_DEFAULT_MEGABYTES;
+
+	uint16_t* Text = NULL;
+
+	uint16_t* Ascii = NULL;
+
+	uint16_t* Mixed = NULL;
+
+	uint8_t* Bytes = NULL;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--megabytes") == 0)
+		{
+			Valid = ((Megabytes = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool normalize-bench [--megabytes <n>]\n");
+
+			return(2);
+		}
+	}
+
+	if ((Text = malloc(0x10000 * sizeof(uint16_t))) == NULL ||
+		(Ascii = malloc(NORMALIZE_BENCH_LONG_LENGTH * sizeof(uint16_t))) == NULL ||
+		(Mixed = malloc(NORMALIZE_BENCH_LONG_LENGTH * sizeof(uint16_t))) == NULL ||
+		(Bytes = malloc(NORMALIZE_BENCH_LONG_LENGTH)) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	printf("Kernel in use: %s\n\n", NormalizeKernelName(NormalizeBestKernel()));
+
+	bool Equivalent = true;
+
+	for (int32_t Kernel = NormalizeKernelScalar; Kernel < NormalizeKernelCount; Kernel++)
+	{
+		if (NormalizeKernelSupported((NORMALIZE_KERNEL)Kernel) == false)
+		{
+			printf("%-8s not supported here\n", NormalizeKernelName((NORMALIZE_KERNEL)Kernel));
+
+			continue;
+		}
+
+		uint64_t BmpErrors = CheckWholeBmp((NORMALIZE_KERNEL)Kernel, Text);
+
+		uint64_t ByteErrors = CheckEveryByte((NORMALIZE_KERNEL)Kernel);
+
+		uint64_t RandomErrors = CheckRandomStrings((NORMALIZE_KERNEL)Kernel);
+
+		printf("%-8s %llu wrong characters in the BMP, %llu wrong bytes, %llu of %d random strings folded differently from scalar\n",
+			NormalizeKernelName((NORMALIZE_KERNEL)Kernel),
+			(unsigned long long)BmpErrors,
+			(unsigned long long)ByteErrors,
+			(unsigned long long)RandomErrors,
+			NORMALIZE_BENCH_RANDOM_STRINGS * 2);
+
+		if (BmpErrors != 0 || ByteErrors != 0 || RandomErrors != 0)
+		{
+			Equivalent = false;
+		}
+	}
+
+	if (Equivalent == false)
+	{
+		fprintf(stderr, "The kernels don't agree!\n");
+
+		goto End;
+	}
+
+	// Upper and lower case ASCII; and the same with about one character in ten from anywhere in the BMP.
+	for (size_t Index = 0; Index < NORMALIZE_BENCH_LONG_LENGTH; Index++)
+	{
+		uint64_t Random = ToolRandom();
+
+		Ascii[Index] = (uint16_t)(((Random & 1) ? 'A' : 'a') + ((Random >> 1) % 26));
+
+		Mixed[Index] = ((Random >> 16) % 10 == 0) ? (uint16_t)(Random >> 32) : Ascii[Index];
+
+		Bytes[Index] = (uint8_t)Ascii[Index];
+	}
+
+	uint64_t Budget = Megabytes * 1000000;
+
+	printf("\nMB/s, %llu MB each:\n\n%-8s %14s %14s %14s %14s\n", (unsigned long long)Megabytes, "Kernel", "16 characters", "4096 ASCII", "4096 mixed", "4096 bytes");
+
+	for (int32_t Kernel = NormalizeKernelScalar; Kernel < NormalizeKernelCount; Kernel++)
+	{
+		if (NormalizeKernelSupported((NORMALIZE_KERNEL)Kernel) == false)
+		{
+			continue;
+		}
+
+		printf("%-8s %14.0f %14.0f %14.0f %14.0f\n",
+			NormalizeKernelName((NORMALIZE_KERNEL)Kernel),
+			TimeStrings((NORMALIZE_KERNEL)Kernel, Ascii, NORMALIZE_BENCH_PASSWORD_LENGTH, Budget),
+			TimeStrings((NORMALIZE_KERNEL)Kernel, Ascii, NORMALIZE_BENCH_LONG_LENGTH, Budget),
+			TimeStrings((NORMALIZE_KERNEL)Kernel, Mixed, NORMALIZE_BENCH_LONG_LENGTH, Budget),
+			TimeBytes((NORMALIZE_KERNEL)Kernel, Bytes, NORMALIZE_BENCH_LONG_LENGTH, Budget));
+	}
+
+	ExitCode = 0;
+
+End:
+
+	free(Bytes);
+
+	free(Mixed);
+
+	free(Ascii);
+
+	free(Text);
+
+	return(ExitCode);
+}
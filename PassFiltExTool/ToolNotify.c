@@ -0,0 +1,589 @@
+/*
+ToolNotify.c
+
+The notify-check command: what posting a password change to the notify queue (see NotifyQueue.c) costs the thread that posts
+it, and whether everything posted comes out the other end.
+
+Several threads post as fast as they can, first to a sink that takes every batch straight away, then to one that sleeps for
+--sink-ms milliseconds over every batch, the way a slow disk would. For each, it prints the p50, p99, p99.9 and worst latency
+of a post, how many records were dropped, and how many batches the sink was handed. A slow sink should make many more records
+drop, and no post any slower: LSA must never wait for the disk.
+
+Every run checks, and the command fails unless:
+
+  - every record the sink is handed is intact, and each thread's records come out in the order they were posted;
+
+  - every post was either written or turned away as full, and the NotifyRecordsDropped records add up to exactly the number
+    turned away;
+
+  - NotifyQueueStop hands over everything that was posted before it returns.
+
+The same again with a sink that fails every batch, whose records must all be counted as failed. Then two smaller checks: that
+a lone record is handed over within a flush interval without waiting for a batch to fill up, and that posting while the queue
+is being stopped is turned away as closed.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "NotifyQueue.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#define NOTIFY_CHECK_DEFAULT_POSTS 200000
+
+#define NOTIFY_CHECK_DEFAULT_THREADS 4
+
+#define NOTIFY_CHECK_MAX_THREADS 64
+
+#define NOTIFY_CHECK_DEFAULT_SINK_MILLISECONDS 5
+
+// A record's RelativeId is its thread's index above these bits, and its sequence number below them.
+#define NOTIFY_CHECK_SEQUENCE_BITS 24
+
+#define NOTIFY_CHECK_MAX_POSTS (1u << NOTIFY_CHECK_SEQUENCE_BITS)
+
+typedef struct NOTIFY_CHECK
+{
+	// Only the sink touches these, on the queue's worker thread, until the queue has been stopped.
+	uint64_t Received;
+
+	uint64_t DroppedReported;
+
+	uint64_t Batches;
+
+	uint64_t Errors;
+
+	uint32_t NextSequence[NOTIFY_CHECK_MAX_THREADS];
+
+	uint16_t Name[TOOL_MAX_NAME_LENGTH];
+
+	size_t NameLength;
+
+	uint32_t SleepMilliseconds;
+
+	bool Fail;
+
+	// Set while the sink is to wait before it returns.
+	volatile int32_t Hold;
+
+	// Records received so far, for another thread to watch.
+	volatile int32_t Delivered;
+
+} NOTIFY_CHECK;
+
+typedef struct NOTIFY_PRODUCER
+{
+	NOTIFY_QUEUE* Queue;
+
+	NOTIFY_CHECK* Check;
+
+	uint32_t Index;
+
+	uint32_t Posts;
+
+	volatile int32_t* Start;
+
+	uint64_t* Latencies;
+
+	uint64_t Full;
+
+	uint64_t Closed;
+
+} NOTIFY_PRODUCER;
+
+static bool CheckingSink(void* Context, const NOTIFY_RECORD* Records, uint32_t Count)
+{
+	NOTIFY_CHECK* Check = Context;
+
+	Check->Batches++;
+
+	if (Count == 0 || Count > NOTIFY_BATCH_SIZE)
+	{
+		Check->Errors++;
+	}
+
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		const NOTIFY_RECORD* Record = &Records[Index];
+
+		if (Record->Kind == NotifyRecordsDropped)
+		{
+			if (Record->Count == 0)
+			{
+				Check->Errors++;
+			}
+
+			Check->DroppedReported += Record->Count;
+
+			continue;
+		}
+
+		uint32_t Producer = Record->RelativeId >> NOTIFY_CHECK_SEQUENCE_BITS;
+
+		uint32_t Sequence = Record->RelativeId & (NOTIFY_CHECK_MAX_POSTS - 1);
+
+		Check->Received++;
+
+		if (Record->Kind != NotifyPasswordChanged ||
+			Producer >= NOTIFY_CHECK_MAX_THREADS ||
+			Record->NameLength != Check->NameLength ||
+			memcmp(Record->Name, Check->Name, Check->NameLength * sizeof(uint16_t)) != 0 ||
+			Sequence < Check->NextSequence[Producer])
+		{
+			Check->Errors++;
+
+			continue;
+		}
+
+		// Dropped records leave gaps, but a thread's records never come out of order.
+		Check->NextSequence[Producer] = Sequence + 1;
+	}
+
+	PlatformStore(&Check->Delivered, (int32_t)Check->Received);
+
+	if (Check->SleepMilliseconds > 0)
+	{
+		PlatformSleep(Check->SleepMilliseconds);
+	}
+
+	while (PlatformLoad(&Check->Hold) != 0)
+	{
+		PlatformSleep(1);
+	}
+
+	return(Check->Fail == false);
+}
+
+static uint32_t NotifyProducer(void* Argument)
+{
+	NOTIFY_PRODUCER* Producer = Argument;
+
+	while (PlatformLoad(Producer->Start) == 0)
+	{
+	}
+
+	for (uint32_t Sequence = 0; Sequence < Producer->Posts; Sequence++)
+	{
+		uint32_t RelativeId = (Producer->Index << NOTIFY_CHECK_SEQUENCE_BITS) | Sequence;
+
+		uint64_t StartTime = PlatformTimestamp();
+
+		NOTIFY_POST_STATUS Status = NotifyQueuePost(Producer->Queue, RelativeId, Producer->Check->Name, Producer->Check->NameLength);
+
+		Producer->Latencies[Sequence] = PlatformTimestamp() - StartTime;
+
+		if (Status == NotifyQueueFull)
+		{
+			Producer->Full++;
+		}
+		else if (Status == NotifyQueueClosed)
+		{
+			Producer->Closed++;
+		}
+	}
+
+	return(0);
+}
+
+static NOTIFY_CHECK* NewCheck(uint32_t SleepMilliseconds, bool Fail)
+{
+	NOTIFY_CHECK* Check = calloc(1, sizeof(NOTIFY_CHECK));
+
+	if (Check == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(NULL);
+	}
+
+	const char* Name = TOOL_ACCOUNT_NAME;
+
+	Check->NameLength = strlen(Name);
+
+	for (size_t Character = 0; Character < Check->NameLength; Character++)
+	{
+		Check->Name[Character] = (uint16_t)Name[Character];
+	}
+
+	Check->SleepMilliseconds = SleepMilliseconds;
+
+	Check->Fail = Fail;
+
+	return(Check);
+}
+
+// Checks what the queue counted against what the sink saw and what the posting threads were told. Call after NotifyQueueStop.
+static bool CountsAddUp(const NOTIFY_QUEUE_COUNTS* Counts, const NOTIFY_CHECK* Check, uint64_t Attempted, uint64_t Full, bool Fail)
+{
+	if (Check->Errors > 0 ||
+		Counts->Posted + Counts->Dropped != Attempted ||
+		Counts->Dropped != Full ||
+		Check->DroppedReported != Full ||
+		Check->Received != Counts->Posted ||
+		Counts->Written + Counts->Failed != Counts->Posted ||
+		(Fail ? Counts->Written : Counts->Failed) != 0 ||
+		Counts->Batches != Check->Batches)
+	{
+		fprintf(stderr, "Notify records went missing or came back wrong: %llu attempted, %llu posted, %llu dropped (%llu reported), %llu received, %llu written, %llu failed, %llu bad.\n",
+			(unsigned long long)Attempted,
+			(unsigned long long)Counts->Posted,
+			(unsigned long long)Counts->Dropped,
+			(unsigned long long)Check->DroppedReported,
+			(unsigned long long)Check->Received,
+			(unsigned long long)Counts->Written,
+			(unsigned long long)Counts->Failed,
+			(unsigned long long)Check->Errors);
+
+		return(false);
+	}
+
+	return(true);
+}
+
+// Has ThreadCount threads post Posts records each to a sink that sleeps SleepMilliseconds over every batch, and prints a line.
+static bool RunProducers(const char* Label, uint32_t ThreadCount, uint32_t Posts, uint32_t SleepMilliseconds, bool Fail)
+{
+	bool Result = false;
+
+	NOTIFY_PRODUCER Producers[NOTIFY_CHECK_MAX_THREADS] = { 0 };
+
+	PLATFORM_THREAD* Threads[NOTIFY_CHECK_MAX_THREADS] = { 0 };
+
+	NOTIFY_QUEUE* Queue = NULL;
+
+	volatile int32_t Start = 0;
+
+	uint32_t Started = 0;
+
+	uint64_t Attempted = (uint64_t)ThreadCount * Posts;
+
+	uint64_t* Latencies = malloc((size_t)Attempted * sizeof(uint64_t));
+
+	TOOL_LATENCY_SUMMARY Latency = { 0 };
+
+	NOTIFY_CHECK* Check = NewCheck(SleepMilliseconds, Fail);
+
+	if (Latencies == NULL || Check == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if ((Queue = NotifyQueueStart(CheckingSink, Check)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the notify queue!\n");
+
+		goto End;
+	}
+
+	for (Started = 0; Started < ThreadCount; Started++)
+	{
+		Producers[Started].Queue = Queue;
+
+		Producers[Started].Check = Check;
+
+		Producers[Started].Index = Started;
+
+		Producers[Started].Posts = Posts;
+
+		Producers[Started].Start = &Start;
+
+		Producers[Started].Latencies = Latencies + ((size_t)Started * Posts);
+
+		if ((Threads[Started] = PlatformStartThread(NotifyProducer, &Producers[Started])) == NULL)
+		{
+			fprintf(stderr, "Unable to start producer thread %lu!\n", (unsigned long)Started);
+
+			break;
+		}
+	}
+
+	double StartTime = ToolNowInSeconds();
+
+	PlatformStore(&Start, 1);
+
+	for (uint32_t Index = 0; Index < Started; Index++)
+	{
+		PlatformJoinThread(Threads[Index]);
+	}
+
+	double PostSeconds = ToolNowInSeconds() - StartTime;
+
+	NOTIFY_QUEUE_COUNTS Counts = { 0 };
+
+	NotifyQueueStop(Queue, &Counts);
+
+	Queue = NULL;
+
+	double StopSeconds = ToolNowInSeconds() - StartTime - PostSeconds;
+
+	if (Started < ThreadCount)
+	{
+		goto End;
+	}
+
+	uint64_t Full = 0;
+
+	uint64_t Closed = 0;
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		Full += Producers[Index].Full;
+
+		Closed += Producers[Index].Closed;
+	}
+
+	if (Closed > 0)
+	{
+		fprintf(stderr, "%llu posts were turned away as closed before the queue was stopped!\n", (unsigned long long)Closed);
+
+		goto End;
+	}
+
+	if (CountsAddUp(&Counts, Check, Attempted, Full, Fail) == false)
+	{
+		goto End;
+	}
+
+	ToolSummarizeLatencies(Latencies, Attempted, &Latency);
+
+	printf("%-10s %8lu %10llu %10llu %10llu %8llu %8llu %8llu %10llu %10.1f\n",
+		Label,
+		(unsigned long)SleepMilliseconds,
+		(unsigned long long)Counts.Posted,
+		(unsigned long long)Counts.Dropped,
+		(unsigned long long)Check->Batches,
+		(unsigned long long)Latency.P50,
+		(unsigned long long)Latency.P99,
+		(unsigned long long)Latency.P999,
+		(unsigned long long)Latency.Max,
+		StopSeconds * 1000.0);
+
+	Result = true;
+
+End:
+
+	NotifyQueueStop(Queue, NULL);
+
+	free(Latencies);
+
+	free(Check);
+
+	return(Result);
+}
+
+// A lone record must reach the sink within a flush interval, without a batch filling up and without the queue being stopped.
+static bool CheckFlushTimer(void)
+{
+	bool Result = false;
+
+	NOTIFY_CHECK* Check = NewCheck(0, false);
+
+	NOTIFY_QUEUE* Queue = NULL;
+
+	if (Check == NULL || (Queue = NotifyQueueStart(CheckingSink, Check)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the notify queue!\n");
+
+		goto End;
+	}
+
+	// Give the worker time to find the queue empty and go to sleep, so that only the timer can wake it.
+	PlatformSleep(100);
+
+	double StartTime = ToolNowInSeconds();
+
+	NotifyQueuePost(Queue, 0, Check->Name, Check->NameLength);
+
+	while (PlatformLoad(&Check->Delivered) == 0 && ToolNowInSeconds() - StartTime < 3.0 * NOTIFY_FLUSH_MILLISECONDS / 1000.0)
+	{
+		PlatformSleep(1);
+	}
+
+	double Waited = ToolNowInSeconds() - StartTime;
+
+	if (PlatformLoad(&Check->Delivered) == 0)
+	{
+		fprintf(stderr, "A lone record wasn't handed to the sink within %.1f seconds!\n", Waited);
+
+		goto End;
+	}
+
+	printf("A lone record reached the sink after %.0f ms (flush interval %d ms).\n", Waited * 1000.0, NOTIFY_FLUSH_MILLISECONDS);
+
+	Result = true;
+
+End:
+
+	NotifyQueueStop(Queue, NULL);
+
+	free(Check);
+
+	return(Result);
+}
+
+static uint32_t StopQueueThread(void* Argument)
+{
+	NotifyQueueStop(Argument, NULL);
+
+	return(0);
+}
+
+/*
+Posting while the queue is being stopped must be turned away as closed, and everything posted before must still reach the
+sink. The sink is held so that the queue can't finish stopping while this thread posts.
+
+*/
+static bool CheckStopWhilePosting(void)
+{
+	bool Result = false;
+
+	NOTIFY_CHECK* Check = NewCheck(0, false);
+
+	NOTIFY_QUEUE* Queue = NULL;
+
+	PLATFORM_THREAD* Stopper = NULL;
+
+	uint32_t Posted = 0;
+
+	if (Check == NULL || (Queue = NotifyQueueStart(CheckingSink, Check)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the notify queue!\n");
+
+		goto End;
+	}
+
+	PlatformStore(&Check->Hold, 1);
+
+	// A full batch, so that the worker wakes up and gets stuck in the sink.
+	for (Posted = 0; Posted < NOTIFY_BATCH_SIZE; Posted++)
+	{
+		NotifyQueuePost(Queue, Posted, Check->Name, Check->NameLength);
+	}
+
+	if ((Stopper = PlatformStartThread(StopQueueThread, Queue)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the stopping thread!\n");
+
+		PlatformStore(&Check->Hold, 0);
+
+		goto End;
+	}
+
+	// Until the queue closes, posts still go in; they must all come out when it stops.
+	while (Posted < NOTIFY_CHECK_MAX_POSTS)
+	{
+		NOTIFY_POST_STATUS Status = NotifyQueuePost(Queue, Posted, Check->Name, Check->NameLength);
+
+		if (Status == NotifyQueueClosed)
+		{
+			break;
+		}
+
+		if (Status == NotifyPosted)
+		{
+			Posted++;
+		}
+	}
+
+	PlatformStore(&Check->Hold, 0);
+
+	PlatformJoinThread(Stopper);
+
+	Queue = NULL;
+
+	if (Posted == NOTIFY_CHECK_MAX_POSTS)
+	{
+		fprintf(stderr, "Posting while the queue was being stopped was never turned away!\n");
+
+		goto End;
+	}
+
+	if (Check->Errors > 0 || Check->Received != Posted)
+	{
+		fprintf(stderr, "Stopping lost records: %lu posted, %llu handed to the sink, %llu bad.\n", (unsigned long)Posted, (unsigned long long)Check->Received, (unsigned long long)Check->Errors);
+
+		goto End;
+	}
+
+	printf("Stopping while posting: %lu records posted before the queue closed, all handed to the sink.\n", (unsigned long)Posted);
+
+	Result = true;
+
+End:
+
+	NotifyQueueStop(Queue, NULL);
+
+	free(Check);
+
+	return(Result);
+}
+
+int CommandNotifyCheck(int ArgumentCount, char** Arguments)
+{
+	uint32_t Posts = NOTIFY_CHECK_DEFAULT_POSTS;
+
+	uint32_t ThreadCount = NOTIFY_CHECK_DEFAULT_THREADS;
+
+	uint32_t SinkMilliseconds = NOTIFY_CHECK_DEFAULT_SINK_MILLISECONDS;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--posts") == 0)
+		{
+			Valid = ((Posts = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0 && Posts < NOTIFY_CHECK_MAX_POSTS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--threads") == 0)
+		{
+			Valid = ((ThreadCount = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0 && ThreadCount <= NOTIFY_CHECK_MAX_THREADS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--sink-ms") == 0)
+		{
+			Valid = ((SinkMilliseconds = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool notify-check [--posts <n>] [--threads <1-%d>] [--sink-ms <n>]\n", NOTIFY_CHECK_MAX_THREADS);
+
+			return(2);
+		}
+	}
+
+	printf("%lu threads posting %lu records each, to a queue of %d with batches of up to %d. Latencies are per post, in ns.\n\n",
+		(unsigned long)ThreadCount, (unsigned long)Posts, NOTIFY_QUEUE_SIZE, NOTIFY_BATCH_SIZE);
+
+	printf("%-10s %8s %10s %10s %10s %8s %8s %8s %10s %10s\n", "Sink", "ms/batch", "Posted", "Dropped", "Batches", "p50", "p99", "p99.9", "max", "Stop ms");
+
+	if (RunProducers("fast", ThreadCount, Posts, 0, false) == false ||
+		RunProducers("slow", ThreadCount, Posts, SinkMilliseconds, false) == false ||
+		RunProducers("failing", ThreadCount, Posts, 0, true) == false)
+	{
+		return(1);
+	}
+
+	printf("\n");
+
+	if (CheckFlushTimer() == false || CheckStopWhilePosting() == false)
+	{
+		return(1);
+	}
+
+	printf("\nEvery record posted was handed to the sink or reported as dropped.\n");
+
+	return(0);
+}
@@ -0,0 +1,772 @@
+/*
+ToolRules.c
+
+The rule-check command: proof that a blacklist's rules (!coverage, !combined and !rule, see Blacklist.c) reject exactly the
+passwords they should, and that judging a password costs the same however many rules there are.
+
+First, a blacklist with rules of every kind, some of them given twice, goes through PasswordCheck with a handful of known cases.
+
+Then small random blacklists, written with random rules, are checked against the obvious way of applying them: every token
+looked for in the password one at a time, each against its own coverage, and the characters of every token that counts toward
+!combined marked off one by one. Tokens and passwords are spelled from a three-letter alphabet, so that tokens overlap and turn
+up next to each other all the time. Each list is judged as it was loaded, as a blacklist image, and with more tokens appended to
+it (see BlacklistDelta.c). The command fails if any of them ever disagrees with the slow way.
+
+Last, a blacklist of the usual synthetic tokens (see ToolBench.c) is loaded with no rules, then with !combined and more and more
+of its tokens given a !rule of their own, up to all of them, and the same passwords are timed through PasswordCheck against each.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistDelta.h"
+
+#include "BlacklistImage.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#define RULE_CHECK_DEFAULT_TOKENS 1000000
+
+#define RULE_CHECK_DEFAULT_CHECKS 100000
+
+#define RULE_CHECK_PASSWORD_LENGTH 12
+
+#define RULE_CHECK_HIT_PERCENT 50
+
+#define RULE_CHECK_RANDOM_LISTS 2000
+
+#define RULE_CHECK_PASSWORDS_PER_LIST 200
+
+#define RULE_CHECK_MAX_TOKENS 12
+
+#define RULE_CHECK_MAX_TOKEN_LENGTH 4
+
+#define RULE_CHECK_MAX_APPENDED 4
+
+// Long enough that most tokens can't reject a password on their own, and !combined has to decide.
+#define RULE_CHECK_MAX_PASSWORD_LENGTH 24
+
+// A line of a random list, at most "!rule exact " and a token.
+#define RULE_CHECK_MAX_LINE 32
+
+#define RULE_CHECK_BENCH_ROWS 5
+
+static const char gRuleCheckBlacklist[] =
+	BLACKLIST_SUBSTITUTE_DIRECTIVE "o0\n"
+	BLACKLIST_RULE_DIRECTIVE "90 falcon\n"
+	BLACKLIST_COVERAGE_DIRECTIVE "60\n"
+	BLACKLIST_COMBINED_DIRECTIVE "80\n"
+	BLACKLIST_RULE_DIRECTIVE BLACKLIST_RULE_EXACT " summer\n"
+	BLACKLIST_RULE_DIRECTIVE "30 contoso\n"
+	"password\n"
+	"winter\n"
+	"dragon\n"
+	BLACKLIST_RULE_DIRECTIVE "25 falcon\n"
+	BLACKLIST_RULE_DIRECTIVE "101 dragon\n";
+
+static const char gRuleCheckAlphabet[] = "abc";
+
+// The rules given to more and more of the big list's tokens. 0 is no rules at all, !combined included.
+static const uint32_t gRuleCheckBenchPercentages[RULE_CHECK_BENCH_ROWS] = { 0, 0, 1, 10, 100 };
+
+typedef struct RULE_CHECK_CASE
+{
+	const char* Password;
+
+	PASSWORD_VERDICT Expected;
+
+} RULE_CHECK_CASE;
+
+static const RULE_CHECK_CASE gRuleCheckCases[] =
+{
+	{ "Summer", PasswordBlacklisted },
+	{ "summer1", PasswordAccepted },
+	// Exact tokens don't count toward !combined, and winter alone is short of 60%.
+	{ "summerwinter", PasswordAccepted },
+	{ "Contoso2024!!", PasswordBlacklisted },
+	{ "contoso1234567890123456", PasswordBlacklisted },
+	{ "contoso12345678901234567", PasswordAccepted },
+	{ "passw0rd12345", PasswordBlacklisted },
+	{ "password123456", PasswordAccepted },
+	{ "winterdragon", PasswordBlacklistedTogether },
+	{ "WinterDragon123", PasswordBlacklistedTogether },
+	{ "winterdragon1234", PasswordAccepted },
+	{ "winterwinter", PasswordBlacklistedTogether },
+	// The later rule for falcon, 25%, is the one that counts.
+	{ "falcon123456789012345678", PasswordBlacklisted },
+	{ "falcon1234567890123456789", PasswordAccepted },
+	// A rule that can't be understood is skipped, so dragon is at the list's 60%, but the token is still there.
+	{ "dragon1234", PasswordBlacklisted },
+	{ "dragon12345", PasswordAccepted }
+};
+
+// A token of a random list, the way the slow way sees it. Coverage is 0 until a rule gives it one of its own.
+typedef struct RULE_CHECK_TOKEN
+{
+	char Text[RULE_CHECK_MAX_TOKEN_LENGTH + 1];
+
+	uint32_t Length;
+
+	uint32_t Coverage;
+
+	bool Exact;
+
+} RULE_CHECK_TOKEN;
+
+typedef struct RULE_CHECK_LIST
+{
+	RULE_CHECK_TOKEN Tokens[RULE_CHECK_MAX_TOKENS + RULE_CHECK_MAX_APPENDED];
+
+	uint32_t TokenCount;
+
+	uint32_t Coverage;
+
+	uint32_t CombinedCoverage;
+
+} RULE_CHECK_LIST;
+
+typedef enum RULE_CHECK_KIND
+{
+	RuleCheckAccepted,
+
+	RuleCheckBlacklisted,
+
+	RuleCheckTogether
+
+} RULE_CHECK_KIND;
+
+static const char* gRuleCheckKinds[] = { "accepted", "blacklisted", "together" };
+
+static RULE_CHECK_TOKEN* AddToken(RULE_CHECK_LIST* List, const char* Text, uint32_t Length)
+{
+	for (uint32_t Index = 0; Index < List->TokenCount; Index++)
+	{
+		if (List->Tokens[Index].Length == Length && memcmp(List->Tokens[Index].Text, Text, Length) == 0)
+		{
+			return(&List->Tokens[Index]);
+		}
+	}
+
+	RULE_CHECK_TOKEN* Token = &List->Tokens[List->TokenCount++];
+
+	memset(Token, 0, sizeof(RULE_CHECK_TOKEN));
+
+	memcpy(Token->Text, Text, Length);
+
+	Token->Length = Length;
+
+	return(Token);
+}
+
+static uint32_t RandomToken(char* Text)
+{
+	uint32_t Length = 1 + (uint32_t)(ToolRandom() % RULE_CHECK_MAX_TOKEN_LENGTH);
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		Text[Index] = gRuleCheckAlphabet[ToolRandom() % (sizeof(gRuleCheckAlphabet) - 1)];
+	}
+
+	return(Length);
+}
+
+// Writes a random list of tokens, rules and list-wide directives into Text, and what it means into List.
+static size_t RandomList(RULE_CHECK_LIST* List, char* Text)
+{
+	uint32_t LineCount = 1 + (uint32_t)(ToolRandom() % RULE_CHECK_MAX_TOKENS);
+
+	size_t Size = 0;
+
+	memset(List, 0, sizeof(RULE_CHECK_LIST));
+
+	for (uint32_t Line = 0; Line < LineCount; Line++)
+	{
+		char Token[RULE_CHECK_MAX_TOKEN_LENGTH + 1] = { 0 };
+
+		uint32_t Length = RandomToken(Token);
+
+		uint32_t Kind = (uint32_t)(ToolRandom() % 8);
+
+		if (Kind == 0)
+		{
+			List->Coverage = 1 + (uint32_t)(ToolRandom() % 100);
+
+			Size += (size_t)sprintf(Text + Size, BLACKLIST_COVERAGE_DIRECTIVE "%u\n", List->Coverage);
+		}
+		else if (Kind == 1)
+		{
+			List->CombinedCoverage = 1 + (uint32_t)(ToolRandom() % 100);
+
+			Size += (size_t)sprintf(Text + Size, BLACKLIST_COMBINED_DIRECTIVE "%u\n", List->CombinedCoverage);
+		}
+		else if (Kind == 2)
+		{
+			RULE_CHECK_TOKEN* Ruled = AddToken(List, Token, Length);
+
+			Ruled->Exact = true;
+
+			Ruled->Coverage = 100;
+
+			Size += (size_t)sprintf(Text + Size, BLACKLIST_RULE_DIRECTIVE BLACKLIST_RULE_EXACT " %s\n", Token);
+		}
+		else if (Kind <= 4)
+		{
+			RULE_CHECK_TOKEN* Ruled = AddToken(List, Token, Length);
+
+			Ruled->Exact = false;
+
+			Ruled->Coverage = 1 + (uint32_t)(ToolRandom() % 100);
+
+			Size += (size_t)sprintf(Text + Size, BLACKLIST_RULE_DIRECTIVE "%u %s\n", Ruled->Coverage, Token);
+		}
+		else
+		{
+			AddToken(List, Token, Length);
+
+			Size += (size_t)sprintf(Text + Size, "%s\n", Token);
+		}
+	}
+
+	return(Size);
+}
+
+// Plain tokens to append to the list, which go by its rules.
+static size_t RandomAppended(RULE_CHECK_LIST* List, char* Text)
+{
+	uint32_t LineCount = 1 + (uint32_t)(ToolRandom() % RULE_CHECK_MAX_APPENDED);
+
+	size_t Size = 0;
+
+	for (uint32_t Line = 0; Line < LineCount; Line++)
+	{
+		char Token[RULE_CHECK_MAX_TOKEN_LENGTH + 1] = { 0 };
+
+		uint32_t Length = RandomToken(Token);
+
+		AddToken(List, Token, Length);
+
+		Size += (size_t)sprintf(Text + Size, "%s\n", Token);
+	}
+
+	return(Size);
+}
+
+// The slow way: every token on its own against its coverage, then every character of every token that counts toward !combined.
+static RULE_CHECK_KIND SlowJudge(const RULE_CHECK_LIST* List, const uint16_t* Password, uint32_t Length)
+{
+	bool Covered[RULE_CHECK_MAX_PASSWORD_LENGTH] = { 0 };
+
+	uint32_t Longest = 0;
+
+	uint32_t ListCoverage = (List->Coverage != 0) ? List->Coverage : 50;
+
+	for (uint32_t Index = 0; Index < List->TokenCount; Index++)
+	{
+		const RULE_CHECK_TOKEN* Token = &List->Tokens[Index];
+
+		uint32_t Coverage = (Token->Coverage != 0) ? Token->Coverage : ListCoverage;
+
+		for (uint32_t Start = 0; Start + Token->Length <= Length; Start++)
+		{
+			uint32_t Matched = 0;
+
+			while (Matched < Token->Length && Password[Start + Matched] == (uint16_t)Token->Text[Matched])
+			{
+				Matched++;
+			}
+
+			if (Matched < Token->Length)
+			{
+				continue;
+			}
+
+			if (Token->Length * 100 >= Coverage * Length)
+			{
+				return(RuleCheckBlacklisted);
+			}
+
+			if (Token->Exact == false)
+			{
+				memset(Covered + Start, 1, Token->Length);
+
+				Longest = (Token->Length > Longest) ? Token->Length : Longest;
+			}
+		}
+	}
+
+	uint32_t CoveredCount = 0;
+
+	for (uint32_t Index = 0; Index < Length; Index++)
+	{
+		CoveredCount += Covered[Index];
+	}
+
+	// Only more than the longest token alone takes two or more of them.
+	if (List->CombinedCoverage != 0 && CoveredCount > Longest && CoveredCount * 100 >= List->CombinedCoverage * Length)
+	{
+		return(RuleCheckTogether);
+	}
+
+	return(RuleCheckAccepted);
+}
+
+static RULE_CHECK_KIND FastJudge(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const uint16_t* Password, uint32_t Length)
+{
+	bool Together = false;
+
+	if (BlacklistFindToken(Automaton, Overlay, NULL, Password, Length, &Together) == AC_NO_PATTERN)
+	{
+		return(RuleCheckAccepted);
+	}
+
+	return(Together ? RuleCheckTogether : RuleCheckBlacklisted);
+}
+
+static uint64_t CheckCases(void)
+{
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t Password[RULE_CHECK_MAX_LINE];
+
+	uint64_t Wrong = 0;
+
+	if (BlacklistLoad((const uint8_t*)gRuleCheckBlacklist, sizeof(gRuleCheckBlacklist) - 1, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the test blacklist!\n");
+
+		return(1);
+	}
+
+	if (Stats.Rules != 4 || Stats.BadDirectives != 1)
+	{
+		fprintf(stderr, "Expected 4 rules and 1 bad directive, got %lu and %lu!\n", (unsigned long)Stats.Rules, (unsigned long)Stats.BadDirectives);
+
+		Wrong++;
+	}
+
+	for (size_t Case = 0; Case < sizeof(gRuleCheckCases) / sizeof(gRuleCheckCases[0]); Case++)
+	{
+		const RULE_CHECK_CASE* Known = &gRuleCheckCases[Case];
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		size_t Length = ToolDecodeUtf8((const uint8_t*)Known->Password, (uint32_t)strlen(Known->Password), Password, RULE_CHECK_MAX_LINE);
+
+		PLATFORM_STRING String = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Password };
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, NULL, NULL, &String, NULL, NULL, &MatchedPattern);
+
+		if (Verdict != Known->Expected)
+		{
+			fprintf(stderr, "%s: expected %s, got %s.\n", Known->Password, PasswordVerdictString(Known->Expected), PasswordVerdictString(Verdict));
+
+			Wrong++;
+		}
+	}
+
+	printf("%lu known cases, %llu wrong.\n", (unsigned long)(sizeof(gRuleCheckCases) / sizeof(gRuleCheckCases[0])), (unsigned long long)Wrong);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(Wrong);
+}
+
+// Loads Text both as it is and through an image, and Appended on top of it, and judges random passwords all three ways.
+static uint64_t CheckList(const RULE_CHECK_LIST* List, const RULE_CHECK_LIST* WithAppended, const char* Text, size_t Size, const char* Appended, size_t AppendedSize, uint64_t* Counts)
+{
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	TOKEN_STORE ImageTokens = { 0 };
+
+	AC_AUTOMATON* ImageAutomaton = NULL;
+
+	TOKEN_STORE OverlayTokens = { 0 };
+
+	AC_AUTOMATON* Overlay = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	BLACKLIST_DELTA_STATS DeltaStats = { 0 };
+
+	void* Image = NULL;
+
+	uint16_t Password[RULE_CHECK_MAX_PASSWORD_LENGTH];
+
+	uint64_t Wrong = 0;
+
+	if (BlacklistLoad((const uint8_t*)Text, Size, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load a random blacklist!\n");
+
+		return(1);
+	}
+
+	size_t ImageSize = BlacklistImageSize(&Tokens, Automaton);
+
+	if ((Image = malloc(ImageSize)) == NULL ||
+		BlacklistImageWrite(&Tokens, Automaton, Image, ImageSize) == false ||
+		BlacklistImageOpen(Image, ImageSize, &ImageTokens, NULL, &ImageAutomaton) != BlacklistImageOk ||
+		BlacklistDeltaLoad(Tokens.TokenCount, Automaton, (const uint8_t*)Appended, AppendedSize, &OverlayTokens, &Overlay, &DeltaStats) != BlacklistDeltaOk)
+	{
+		fprintf(stderr, "Unable to write and open the image of a random blacklist, or to append to it!\n");
+
+		Wrong++;
+
+		goto End;
+	}
+
+	for (uint32_t Check = 0; Check < RULE_CHECK_PASSWORDS_PER_LIST; Check++)
+	{
+		uint32_t Length = 1 + (uint32_t)(ToolRandom() % RULE_CHECK_MAX_PASSWORD_LENGTH);
+
+		for (uint32_t Index = 0; Index < Length; Index++)
+		{
+			Password[Index] = (uint16_t)gRuleCheckAlphabet[ToolRandom() % (sizeof(gRuleCheckAlphabet) - 1)];
+		}
+
+		RULE_CHECK_KIND Expected = SlowJudge(List, Password, Length);
+
+		RULE_CHECK_KIND ExpectedAppended = SlowJudge(WithAppended, Password, Length);
+
+		RULE_CHECK_KIND Loaded = FastJudge(Automaton, NULL, Password, Length);
+
+		RULE_CHECK_KIND Mapped = FastJudge(ImageAutomaton, NULL, Password, Length);
+
+		RULE_CHECK_KIND Delta = FastJudge(Automaton, Overlay, Password, Length);
+
+		Counts[Expected]++;
+
+		if (Loaded != Expected || Mapped != Expected || Delta != ExpectedAppended)
+		{
+			if (Wrong < 10)
+			{
+				fprintf(stderr, "A password of %lu characters: expected %s (%s appended), got %s loaded, %s from the image, %s appended. The list:\n%.*s\n",
+					(unsigned long)Length,
+					gRuleCheckKinds[Expected],
+					gRuleCheckKinds[ExpectedAppended],
+					gRuleCheckKinds[Loaded],
+					gRuleCheckKinds[Mapped],
+					gRuleCheckKinds[Delta],
+					(int)Size,
+					Text);
+			}
+
+			Wrong++;
+		}
+	}
+
+End:
+
+	AcDestroy(Overlay);
+
+	TokenStoreFree(&OverlayTokens);
+
+	AcDestroy(ImageAutomaton);
+
+	TokenStoreFree(&ImageTokens);
+
+	free(Image);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(Wrong);
+}
+
+static uint64_t CheckRandomLists(void)
+{
+	char Text[RULE_CHECK_MAX_TOKENS * RULE_CHECK_MAX_LINE];
+
+	char Appended[RULE_CHECK_MAX_APPENDED * RULE_CHECK_MAX_LINE];
+
+	RULE_CHECK_LIST List;
+
+	RULE_CHECK_LIST WithAppended;
+
+	uint64_t Counts[3] = { 0 };
+
+	uint64_t Wrong = 0;
+
+	for (uint32_t Round = 0; Round < RULE_CHECK_RANDOM_LISTS; Round++)
+	{
+		size_t Size = RandomList(&List, Text);
+
+		WithAppended = List;
+
+		size_t AppendedSize = RandomAppended(&WithAppended, Appended);
+
+		Wrong += CheckList(&List, &WithAppended, Text, Size, Appended, AppendedSize, Counts);
+	}
+
+	printf("%lu random blacklists, %llu passwords: %llu accepted, %llu rejected by one token, %llu by tokens together, %llu wrong.\n",
+		(unsigned long)RULE_CHECK_RANDOM_LISTS,
+		(unsigned long long)(Counts[0] + Counts[1] + Counts[2]),
+		(unsigned long long)Counts[RuleCheckAccepted],
+		(unsigned long long)Counts[RuleCheckBlacklisted],
+		(unsigned long long)Counts[RuleCheckTogether],
+		(unsigned long long)Wrong);
+
+	return(Wrong);
+}
+
+// The generated list, then !combined and a rule for Percent of its tokens, picked at random, if Row is not the first.
+static uint8_t* MakeRuledText(const uint8_t* List, size_t ListSize, const TOKEN_STORE* Tokens, uint32_t Row, size_t* Size, uint32_t* RuleCount)
+{
+	uint64_t Rules = ((uint64_t)Tokens->TokenCount * gRuleCheckBenchPercentages[Row]) / 100;
+
+	uint8_t* Text = malloc(ListSize + 32 + ((size_t)Rules * (MAX_BLACKLIST_STRING_SIZE + 16)));
+
+	if (Text == NULL)
+	{
+		return(NULL);
+	}
+
+	memcpy(Text, List, ListSize);
+
+	*Size = ListSize;
+
+	if (Row > 0)
+	{
+		*Size += (size_t)sprintf((char*)Text + *Size, BLACKLIST_COMBINED_DIRECTIVE "80\n");
+	}
+
+	for (uint64_t Rule = 0; Rule < Rules; Rule++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(Tokens, (uint32_t)(ToolRandom() % Tokens->TokenCount), &Length);
+
+		if ((ToolRandom() % 4) == 0)
+		{
+			*Size += (size_t)sprintf((char*)Text + *Size, BLACKLIST_RULE_DIRECTIVE BLACKLIST_RULE_EXACT " %.*s\n", (int)Length, (const char*)Token);
+		}
+		else
+		{
+			*Size += (size_t)sprintf((char*)Text + *Size, BLACKLIST_RULE_DIRECTIVE "%u %.*s\n", (unsigned)(10 + (ToolRandom() % 91)), (int)Length, (const char*)Token);
+		}
+	}
+
+	*RuleCount = (uint32_t)Rules;
+
+	return(Text);
+}
+
+static void RunChecks(const AC_AUTOMATON* Automaton, SCRATCH_POOL* Scratch, const uint16_t* Passwords, uint64_t Checks, uint64_t* Latencies, const char* Name, uint32_t RuleCount)
+{
+	uint64_t Rejected = 0;
+
+	uint64_t Together = 0;
+
+	TOOL_LATENCY_SUMMARY Latency;
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		PLATFORM_STRING String = { RULE_CHECK_PASSWORD_LENGTH * sizeof(uint16_t), RULE_CHECK_PASSWORD_LENGTH * sizeof(uint16_t), Passwords + (Check * RULE_CHECK_PASSWORD_LENGTH) };
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		uint64_t CheckStart = PlatformTimestamp();
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, NULL, Scratch, &String, NULL, NULL, &MatchedPattern);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		Rejected += PasswordVerdictRejects(Verdict);
+
+		Together += (Verdict == PasswordBlacklistedTogether);
+	}
+
+	// A warm-up run, which isn't printed.
+	if (Name == NULL)
+	{
+		return;
+	}
+
+	ToolSummarizeLatencies(Latencies, Checks, &Latency);
+
+	printf("%-10s  %9lu  %10llu  %7.2f%%  %7.2f%%  %8llu  %8llu  %8llu  %8llu\n",
+		Name,
+		(unsigned long)RuleCount,
+		(unsigned long long)((Automaton->Reach != NULL) ? (size_t)Automaton->PatternCount + ((size_t)Automaton->StateCount * 2 * sizeof(uint16_t)) : 0),
+		(100.0 * (double)Rejected) / (double)Checks,
+		(100.0 * (double)Together) / (double)Checks,
+		(unsigned long long)Latency.Mean,
+		(unsigned long long)Latency.P50,
+		(unsigned long long)Latency.P99,
+		(unsigned long long)Latency.P999);
+}
+
+int CommandRuleCheck(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = RULE_CHECK_DEFAULT_TOKENS;
+
+	uint64_t Checks = RULE_CHECK_DEFAULT_CHECKS;
+
+	uint8_t* List = NULL;
+
+	size_t ListSize = 0;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t* Passwords = NULL;
+
+	uint64_t* Latencies = NULL;
+
+	SCRATCH_POOL Scratch;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool rule-check [--tokens <n>] [--checks <n>]\n");
+
+			return(2);
+		}
+	}
+
+	if (CheckCases() != 0 || CheckRandomLists() != 0)
+	{
+		fprintf(stderr, "Rules were not applied the way they should have been!\n");
+
+		return(1);
+	}
+
+	ScratchPoolInitialize(&Scratch);
+
+	if ((List = ToolGenerateBlacklist((uint32_t)TokenCount, &ListSize)) == NULL ||
+		(Passwords = malloc((size_t)Checks * RULE_CHECK_PASSWORD_LENGTH * sizeof(uint16_t))) == NULL ||
+		(Latencies = malloc((size_t)Checks * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	// Passwords are made from the tokens of the list without rules, which are the tokens of every other row as well.
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoad(List, ListSize, NULL, &Tokens, NULL, &Automaton, &Stats);
+
+	if (Status != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(Status));
+
+		goto End;
+	}
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		ToolMakePassword(Passwords + (Check * RULE_CHECK_PASSWORD_LENGTH), RULE_CHECK_PASSWORD_LENGTH, &Tokens, (ToolRandom() % 100) < RULE_CHECK_HIT_PERCENT);
+	}
+
+	printf("\n%llu lines, %lu unique tokens. %llu checks of %d characters, %d%% of them built around a token.\n\n",
+		(unsigned long long)TokenCount,
+		(unsigned long)Tokens.TokenCount,
+		(unsigned long long)Checks,
+		RULE_CHECK_PASSWORD_LENGTH,
+		RULE_CHECK_HIT_PERCENT);
+
+	printf("ruled           rules  table bytes  rejected  together   mean ns    p50 ns    p99 ns  p99.9 ns\n");
+
+	for (uint32_t Row = 0; Row < RULE_CHECK_BENCH_ROWS; Row++)
+	{
+		TOKEN_STORE RuledTokens = { 0 };
+
+		AC_AUTOMATON* RuledAutomaton = NULL;
+
+		uint32_t RuleCount = 0;
+
+		size_t Size = 0;
+
+		char Name[32];
+
+		uint8_t* Text = MakeRuledText(List, ListSize, &Tokens, Row, &Size, &RuleCount);
+
+		if (Text == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+
+		Status = BlacklistLoad(Text, Size, NULL, &RuledTokens, NULL, &RuledAutomaton, &Stats);
+
+		free(Text);
+
+		if (Status != BlacklistLoadOk)
+		{
+			fprintf(stderr, "Unable to load the blacklist with rules: %s\n", BlacklistLoadStatusString(Status));
+
+			goto End;
+		}
+
+		snprintf(Name, sizeof(Name), (Row == 0) ? "none" : "%u%%", gRuleCheckBenchPercentages[Row]);
+
+		// Once to warm up, then the run that counts.
+		RunChecks(RuledAutomaton, &Scratch, Passwords, Checks / 10 + 1, Latencies, NULL, RuleCount);
+
+		RunChecks(RuledAutomaton, &Scratch, Passwords, Checks, Latencies, Name, RuleCount);
+
+		AcDestroy(RuledAutomaton);
+
+		TokenStoreFree(&RuledTokens);
+	}
+
+	ExitCode = 0;
+
+End:
+
+	free(Latencies);
+
+	free(Passwords);
+
+	free(List);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	ScratchPoolDestroy(&Scratch);
+
+	return(ExitCode);
+}
@@ -0,0 +1,462 @@
+/*
+ToolScratch.c
+
+The alloc-check command: proves that PasswordCheck, given a SCRATCH_POOL as PasswordFilter gives it one, never asks the
+heap for anything, and that the pool gives back every buffer it hands out wiped.
+
+Every allocation made through PlatformAllocate is counted (see PlatformAllocationCount), so the proof is just a matter of
+reading the count before and after a run of checks:
+
+  - First without a pool. Every check has to copy its password to the heap, so the count must go up by exactly the number
+    of checks. If it doesn't, the counter isn't counting, and nothing that follows would mean anything.
+
+  - Then with a pool, over the same passwords, from 1 to 255 characters long, some of them built to be rejected. The count
+    must not move, and every verdict must be the same as before.
+
+  - Then a password too long for a pool buffer, which must go to the heap and be counted as oversized.
+
+  - Then from several threads at once, which must not move the count either.
+
+After each run, every buffer in the pool must be all zeros and every slot free. The command fails if any of that is not so,
+so it doubles as a test of ScratchPool.c on whatever machine it runs on.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BreachIndex.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#define ALLOC_CHECK_DEFAULT_TOKENS 10000
+
+#define ALLOC_CHECK_DEFAULT_CHECKS 100000
+
+#define ALLOC_CHECK_DEFAULT_THREADS 8
+
+// Each thread needs a slot of its own for the run to be allocation-free.
+#define ALLOC_CHECK_MAX_THREADS SCRATCH_POOL_SLOTS
+
+// The longest password that fits in a pool buffer, with room for the terminating null.
+#define ALLOC_CHECK_MAX_PASSWORD_LENGTH ((SCRATCH_BUFFER_SIZE / sizeof(uint16_t)) - 1)
+
+#define ALLOC_CHECK_OVERSIZED_LENGTH (ALLOC_CHECK_MAX_PASSWORD_LENGTH + 45)
+
+#define ALLOC_CHECK_HIT_PERCENT 30
+
+typedef struct ALLOC_CHECK
+{
+	const AC_AUTOMATON* Automaton;
+
+	const BREACH_INDEX* Breach;
+
+	SCRATCH_POOL* Scratch;
+
+	const TOOL_NAMES* Names;
+
+	const uint16_t* Passwords;
+
+	const uint8_t* PasswordLengths;
+
+	// What the run without a pool decided for each password.
+	const uint8_t* Verdicts;
+
+	uint64_t Checks;
+
+	volatile int32_t Start;
+
+	volatile int32_t Finished;
+
+} ALLOC_CHECK;
+
+typedef struct ALLOC_CHECK_WORKER
+{
+	ALLOC_CHECK* Check;
+
+	uint64_t Mismatches;
+
+} ALLOC_CHECK_WORKER;
+
+static PASSWORD_VERDICT CheckPassword(const ALLOC_CHECK* Check, SCRATCH_POOL* Scratch, uint64_t Index)
+{
+	uint32_t PasswordIndex = (uint32_t)Index;
+
+	uint32_t MatchedPattern = 0;
+
+	PLATFORM_STRING Password = { (uint16_t)(Check->PasswordLengths[PasswordIndex] * sizeof(uint16_t)), (uint16_t)(ALLOC_CHECK_MAX_PASSWORD_LENGTH * sizeof(uint16_t)), Check->Passwords + ((size_t)PasswordIndex * ALLOC_CHECK_MAX_PASSWORD_LENGTH) };
+
+	return(PasswordCheck(Check->Automaton, NULL, Check->Breach, Scratch, &Password, &Check->Names->AccountName, &Check->Names->FullName, &MatchedPattern));
+}
+
+// Whether every buffer in the pool has been wiped and every slot given back.
+static bool PoolIsClean(const SCRATCH_POOL* Scratch)
+{
+	for (uint32_t Slot = 0; Slot < SCRATCH_POOL_SLOTS; Slot++)
+	{
+		if (Scratch->Slots[Slot].InUse != 0)
+		{
+			fprintf(stderr, "Scratch slot %lu was never given back!\n", (unsigned long)Slot);
+
+			return(false);
+		}
+	}
+
+	for (size_t Byte = 0; Byte < (size_t)SCRATCH_POOL_SLOTS * SCRATCH_BUFFER_SIZE; Byte++)
+	{
+		if (Scratch->Buffers[Byte] != 0)
+		{
+			fprintf(stderr, "Scratch buffer %lu was not wiped!\n", (unsigned long)(Byte / SCRATCH_BUFFER_SIZE));
+
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+static uint32_t AllocCheckWorker(void* Argument)
+{
+	ALLOC_CHECK_WORKER* Worker = Argument;
+
+	ALLOC_CHECK* Check = Worker->Check;
+
+	while (PlatformLoad(&Check->Start) == 0)
+	{
+	}
+
+	for (uint64_t Index = 0; Index < Check->Checks; Index++)
+	{
+		if (CheckPassword(Check, Check->Scratch, Index) != (PASSWORD_VERDICT)Check->Verdicts[Index])
+		{
+			Worker->Mismatches++;
+		}
+	}
+
+	PlatformIncrement(&Check->Finished);
+
+	return(0);
+}
+
+// Runs every password through PasswordCheck from ThreadCount threads at once. Returns how many allocations were made meanwhile, or UINT64_MAX.
+static uint64_t RunThreads(ALLOC_CHECK* Check, uint32_t ThreadCount, uint64_t* Mismatches)
+{
+	ALLOC_CHECK_WORKER Workers[ALLOC_CHECK_MAX_THREADS];
+
+	PLATFORM_THREAD* Threads[ALLOC_CHECK_MAX_THREADS] = { 0 };
+
+	uint32_t Started = 0;
+
+	Check->Start = 0;
+
+	Check->Finished = 0;
+
+	for (Started = 0; Started < ThreadCount; Started++)
+	{
+		Workers[Started].Check = Check;
+
+		Workers[Started].Mismatches = 0;
+
+		if ((Threads[Started] = PlatformStartThread(AllocCheckWorker, &Workers[Started])) == NULL)
+		{
+			fprintf(stderr, "Unable to start thread %lu!\n", (unsigned long)Started);
+
+			break;
+		}
+	}
+
+	// Starting a thread allocates, so counting only begins once they all have been.
+	uint64_t AllocationsBefore = PlatformAllocationCount();
+
+	PlatformStore(&Check->Start, 1);
+
+	while (PlatformLoad(&Check->Finished) < (int32_t)Started)
+	{
+		PlatformSleep(1);
+	}
+
+	uint64_t Allocations = PlatformAllocationCount() - AllocationsBefore;
+
+	for (uint32_t Index = 0; Index < Started; Index++)
+	{
+		PlatformJoinThread(Threads[Index]);
+
+		*Mismatches += Workers[Index].Mismatches;
+	}
+
+	return((Started == ThreadCount) ? Allocations : UINT64_MAX);
+}
+
+int CommandAllocCheck(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t Tokens = ALLOC_CHECK_DEFAULT_TOKENS;
+
+	uint64_t Checks = ALLOC_CHECK_DEFAULT_CHECKS;
+
+	uint32_t ThreadCount = ALLOC_CHECK_DEFAULT_THREADS;
+
+	const char* BreachPath = NULL;
+
+	uint8_t* BlacklistText = NULL;
+
+	size_t BlacklistSize = 0;
+
+	TOKEN_STORE TokenStore = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS LoadStats = { 0 };
+
+	const void* BreachImage = NULL;
+
+	size_t BreachSize = 0;
+
+	BREACH_INDEX Breach;
+
+	SCRATCH_POOL Scratch;
+
+	ALLOC_CHECK Check;
+
+	TOOL_NAMES Names;
+
+	uint16_t* Passwords = NULL;
+
+	uint8_t* PasswordLengths = NULL;
+
+	uint8_t* Verdicts = NULL;
+
+	uint16_t* Oversized = NULL;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((Tokens = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Checks <= UINT32_MAX);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--threads") == 0)
+		{
+			Valid = ((ThreadCount = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0 && ThreadCount <= ALLOC_CHECK_MAX_THREADS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--breach") == 0)
+		{
+			BreachPath = Arguments[++Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool alloc-check [--tokens <n>] [--checks <n>] [--threads <1-%d>] [--breach <breached.bin>]\n", ALLOC_CHECK_MAX_THREADS);
+
+			return(2);
+		}
+	}
+
+	if (ScratchPoolInitialize(&Scratch) == false)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(1);
+	}
+
+	printf("Scratch pool: %d buffers of %d bytes, %s.\n", SCRATCH_POOL_SLOTS, SCRATCH_BUFFER_SIZE, Scratch.Locked ? "locked into memory" : "NOT locked into memory (not allowed to lock that much?)");
+
+	if ((BlacklistText = ToolGenerateBlacklist((uint32_t)Tokens, &BlacklistSize)) == NULL ||
+		(Passwords = malloc((size_t)Checks * ALLOC_CHECK_MAX_PASSWORD_LENGTH * sizeof(uint16_t))) == NULL ||
+		(PasswordLengths = malloc((size_t)Checks)) == NULL ||
+		(Verdicts = malloc((size_t)Checks)) == NULL ||
+		(Oversized = malloc(ALLOC_CHECK_OVERSIZED_LENGTH * sizeof(uint16_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if (BlacklistLoad(BlacklistText, BlacklistSize, NULL, &TokenStore, NULL, &Automaton, &LoadStats) != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the generated blacklist!\n");
+
+		goto End;
+	}
+
+	if (BreachPath != NULL)
+	{
+		if ((BreachImage = ToolMapFile(BreachPath, &BreachSize)) == NULL)
+		{
+			goto End;
+		}
+
+		BREACH_INDEX_STATUS Status = BreachIndexOpen(BreachImage, BreachSize, &Breach);
+
+		if (Status != BreachIndexOk)
+		{
+			fprintf(stderr, "%s is not usable: %s\n", BreachPath, BreachIndexStatusString(Status));
+
+			goto End;
+		}
+	}
+
+	// Every length from 1 up to the longest that fits, over and over.
+	for (uint64_t Index = 0; Index < Checks; Index++)
+	{
+		PasswordLengths[Index] = (uint8_t)(1 + (Index % ALLOC_CHECK_MAX_PASSWORD_LENGTH));
+
+		ToolMakePassword(Passwords + ((size_t)Index * ALLOC_CHECK_MAX_PASSWORD_LENGTH), PasswordLengths[Index], &TokenStore, (ToolRandom() % 100) < ALLOC_CHECK_HIT_PERCENT);
+	}
+
+	memset(&Check, 0, sizeof(Check));
+
+	Check.Automaton = Automaton;
+
+	Check.Breach = (BreachPath != NULL) ? &Breach : NULL;
+
+	Check.Scratch = &Scratch;
+
+	ToolMakeNames(&Names, TOOL_ACCOUNT_NAME, TOOL_FULL_NAME);
+
+	Check.Names = &Names;
+
+	Check.Passwords = Passwords;
+
+	Check.PasswordLengths = PasswordLengths;
+
+	Check.Verdicts = Verdicts;
+
+	Check.Checks = Checks;
+
+	printf("%llu passwords of 1 to %d characters, %llu blacklist lines, %s.\n\n", (unsigned long long)Checks, (int)ALLOC_CHECK_MAX_PASSWORD_LENGTH, (unsigned long long)Tokens, (BreachPath != NULL) ? "with the breach index" : "no breach index");
+
+	// Without a pool: one allocation per check, or the counter is broken.
+	uint64_t Rejected = 0;
+
+	uint64_t AllocationsBefore = PlatformAllocationCount();
+
+	for (uint64_t Index = 0; Index < Checks; Index++)
+	{
+		Verdicts[Index] = (uint8_t)CheckPassword(&Check, NULL, Index);
+
+		Rejected += PasswordVerdictRejects((PASSWORD_VERDICT)Verdicts[Index]);
+	}
+
+	uint64_t Allocations = PlatformAllocationCount() - AllocationsBefore;
+
+	printf("Without a pool:    %10llu allocations (%llu rejected)\n", (unsigned long long)Allocations, (unsigned long long)Rejected);
+
+	if (Allocations != Checks)
+	{
+		fprintf(stderr, "Expected exactly %llu allocations. PlatformAllocationCount isn't counting!\n", (unsigned long long)Checks);
+
+		goto End;
+	}
+
+	// With a pool: none at all, and the same verdicts.
+	uint64_t Mismatches = 0;
+
+	AllocationsBefore = PlatformAllocationCount();
+
+	for (uint64_t Index = 0; Index < Checks; Index++)
+	{
+		Mismatches += (CheckPassword(&Check, &Scratch, Index) != (PASSWORD_VERDICT)Verdicts[Index]);
+	}
+
+	Allocations = PlatformAllocationCount() - AllocationsBefore;
+
+	printf("With a pool:       %10llu allocations\n", (unsigned long long)Allocations);
+
+	if (Allocations != 0 || Mismatches != 0 || PoolIsClean(&Scratch) == false)
+	{
+		fprintf(stderr, "Expected no allocations and the same verdicts, but %llu verdicts differed.\n", (unsigned long long)Mismatches);
+
+		goto End;
+	}
+
+	// Too long for the pool: one trip to the heap, counted.
+	ToolMakePassword(Oversized, ALLOC_CHECK_OVERSIZED_LENGTH, &TokenStore, false);
+
+	PLATFORM_STRING OversizedPassword = { (uint16_t)(ALLOC_CHECK_OVERSIZED_LENGTH * sizeof(uint16_t)), (uint16_t)(ALLOC_CHECK_OVERSIZED_LENGTH * sizeof(uint16_t)), Oversized };
+
+	uint32_t MatchedPattern = 0;
+
+	int32_t OversizedBefore = Scratch.Oversized;
+
+	AllocationsBefore = PlatformAllocationCount();
+
+	PasswordCheck(Automaton, NULL, Check.Breach, &Scratch, &OversizedPassword, &Names.AccountName, &Names.FullName, &MatchedPattern);
+
+	Allocations = PlatformAllocationCount() - AllocationsBefore;
+
+	printf("Oversized (%3d):   %10llu allocations\n", (int)ALLOC_CHECK_OVERSIZED_LENGTH, (unsigned long long)Allocations);
+
+	if (Allocations != 1 || Scratch.Oversized != OversizedBefore + 1 || PoolIsClean(&Scratch) == false)
+	{
+		fprintf(stderr, "Expected a password of %d characters to take exactly one allocation, and to be counted as oversized.\n", (int)ALLOC_CHECK_OVERSIZED_LENGTH);
+
+		goto End;
+	}
+
+	// Several threads at once, each of which should find a slot of its own.
+	Mismatches = 0;
+
+	Allocations = RunThreads(&Check, ThreadCount, &Mismatches);
+
+	if (Allocations == UINT64_MAX)
+	{
+		goto End;
+	}
+
+	printf("%2lu threads:        %10llu allocations (%lu of %llu checks found every slot taken)\n", (unsigned long)ThreadCount, (unsigned long long)Allocations, (unsigned long)Scratch.Exhausted, (unsigned long long)(Checks * ThreadCount));
+
+	if (Allocations != 0 || Mismatches != 0 || PoolIsClean(&Scratch) == false)
+	{
+		fprintf(stderr, "Expected no allocations and the same verdicts from every thread, but %llu verdicts differed.\n", (unsigned long long)Mismatches);
+
+		goto End;
+	}
+
+	printf("\nPasswordCheck made no allocations.\n");
+
+	ExitCode = 0;
+
+End:
+
+	free(Oversized);
+
+	free(Verdicts);
+
+	free(PasswordLengths);
+
+	free(Passwords);
+
+	free(BlacklistText);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&TokenStore);
+
+	ToolUnmapFile(BreachImage, BreachSize);
+
+	ScratchPoolDestroy(&Scratch);
+
+	return(ExitCode);
+}
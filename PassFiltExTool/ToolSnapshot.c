@@ -0,0 +1,403 @@
+/*
+ToolSnapshot.c
+
+The snapshot-stress command: proof that SnapshotGuard (see SnapshotGuard.c) never lets a reader look at a snapshot that has
+been freed, with readers and a writer going at it as hard as they can.
+
+storm shows how fast PasswordFilter is while the blacklist is reloaded, but a reader that strays into a freed blacklist there
+most likely finds it still intact, and nothing notices. Here the snapshots are small and cheap, so the writer can publish many
+thousands a second instead of ten, and every one of them is written to be checked:
+
+  - Each snapshot starts and ends with a canary, and every word in between is worked out from its generation number, so a
+    reader can tell at once whether what it is looking at is whole.
+
+  - Once SnapshotGuardExchange has handed a snapshot back, the writer overwrites all of it with a poison pattern, and then
+    keeps it aside for a while before freeing it, so that a reader that got there too late finds the poison rather than memory
+    that has been handed out again.
+
+  - Each reader checks the canaries before and after going over the words, and checks that the generations it sees never go
+    backwards, since the published pointer only ever moves on.
+
+Every reader also times its SnapshotGuardEnter. Readers never wait for a lock there, but they can go round again when a publish
+flips the epoch as they register, and every one of them increments the same counter, so the longest time any reader spent in
+it is what a PasswordFilter call could be held up by a reload at worst.
+
+The command fails if a single reader saw a damaged snapshot. Most races only show up under a sanitizer, so it is worth running
+twice more, built as PassFiltExTool.c says but with -O1 -g -fsanitize=address in place of -O2, which catches a read of a
+snapshot after it was freed, and with -O1 -g -fsanitize=thread, which catches a read that isn't ordered after the write it
+depends on. The two sanitizers can't go into one build.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#include "SnapshotGuard.h"
+
+#define SNAPSHOT_STRESS_DEFAULT_THREADS 8
+
+#define SNAPSHOT_STRESS_DEFAULT_SECONDS 5
+
+#define SNAPSHOT_STRESS_MAX_THREADS 256
+
+// Words between the canaries. Enough that going over them takes a while, so that a publish has time to land in the middle.
+#define SNAPSHOT_STRESS_WORDS 256
+
+#define SNAPSHOT_STRESS_CANARY 0x5846504C53544F4EULL
+
+#define SNAPSHOT_STRESS_POISON 0xDD
+
+// Retired snapshots are kept poisoned for this many publishes before they are freed.
+#define SNAPSHOT_STRESS_QUARANTINE 1024
+
+typedef struct STRESS_SNAPSHOT
+{
+	uint64_t Canary;
+
+	uint64_t Generation;
+
+	uint64_t Words[SNAPSHOT_STRESS_WORDS];
+
+	uint64_t EndCanary;
+
+} STRESS_SNAPSHOT;
+
+typedef struct SNAPSHOT_STRESS
+{
+	SNAPSHOT_GUARD Guard;
+
+	STRESS_SNAPSHOT* volatile Snapshot;
+
+	volatile int32_t Stop;
+
+	uint32_t ReloadMilliseconds;
+
+	// Written by the writer thread, read once it has been joined.
+	uint64_t Publishes;
+
+	uint64_t MaxPublishWaitTicks;
+
+} SNAPSHOT_STRESS;
+
+// One per reader. Each reader only writes to its own, and only once, when it is done.
+typedef struct SNAPSHOT_STRESS_READER
+{
+	SNAPSHOT_STRESS* Stress;
+
+	uint64_t Reads;
+
+	uint64_t BadReads;
+
+	uint64_t EnterTicks;
+
+	uint64_t MaxEnterTicks;
+
+} SNAPSHOT_STRESS_READER;
+
+static uint64_t StressWord(uint64_t Generation, uint32_t Index)
+{
+	return((Generation * 0x9E3779B97F4A7C15ULL) ^ Index);
+}
+
+static STRESS_SNAPSHOT* MakeStressSnapshot(uint64_t Generation)
+{
+	STRESS_SNAPSHOT* Snapshot = malloc(sizeof(STRESS_SNAPSHOT));
+
+	if (Snapshot == NULL)
+	{
+		return(NULL);
+	}
+
+	Snapshot->Canary = SNAPSHOT_STRESS_CANARY;
+
+	Snapshot->Generation = Generation;
+
+	for (uint32_t Index = 0; Index < SNAPSHOT_STRESS_WORDS; Index++)
+	{
+		Snapshot->Words[Index] = StressWord(Generation, Index);
+	}
+
+	Snapshot->EndCanary = SNAPSHOT_STRESS_CANARY;
+
+	return(Snapshot);
+}
+
+static bool StressSnapshotIsWhole(const STRESS_SNAPSHOT* Snapshot)
+{
+	if (Snapshot == NULL || Snapshot->Canary != SNAPSHOT_STRESS_CANARY || Snapshot->EndCanary != SNAPSHOT_STRESS_CANARY)
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < SNAPSHOT_STRESS_WORDS; Index++)
+	{
+		if (Snapshot->Words[Index] != StressWord(Snapshot->Generation, Index))
+		{
+			return(false);
+		}
+	}
+
+	// Once more, in case the snapshot was poisoned while the words were gone over.
+	return(Snapshot->Canary == SNAPSHOT_STRESS_CANARY && Snapshot->EndCanary == SNAPSHOT_STRESS_CANARY);
+}
+
+static uint32_t SnapshotStressReader(void* Argument)
+{
+	SNAPSHOT_STRESS_READER* Reader = Argument;
+
+	SNAPSHOT_STRESS* Stress = Reader->Stress;
+
+	uint64_t Reads = 0;
+
+	uint64_t BadReads = 0;
+
+	uint64_t EnterTicks = 0;
+
+	uint64_t MaxEnterTicks = 0;
+
+	uint64_t LastGeneration = 0;
+
+	while (PlatformLoad(&Stress->Stop) == 0)
+	{
+		int32_t ReaderSlot = 0;
+
+		uint64_t StartTime = PlatformTimestamp();
+
+		STRESS_SNAPSHOT* Snapshot = SnapshotGuardEnter(&Stress->Guard, (void* volatile*)&Stress->Snapshot, &ReaderSlot);
+
+		uint64_t EnteredTime = PlatformTimestamp();
+
+		if (StressSnapshotIsWhole(Snapshot) == false || Snapshot->Generation < LastGeneration)
+		{
+			BadReads++;
+		}
+		else
+		{
+			LastGeneration = Snapshot->Generation;
+		}
+
+		SnapshotGuardLeave(&Stress->Guard, ReaderSlot);
+
+		EnterTicks += EnteredTime - StartTime;
+
+		if (EnteredTime - StartTime > MaxEnterTicks)
+		{
+			MaxEnterTicks = EnteredTime - StartTime;
+		}
+
+		Reads++;
+	}
+
+	Reader->Reads = Reads;
+
+	Reader->BadReads = BadReads;
+
+	Reader->EnterTicks = EnterTicks;
+
+	Reader->MaxEnterTicks = MaxEnterTicks;
+
+	return(0);
+}
+
+static uint32_t SnapshotStressWriter(void* Argument)
+{
+	SNAPSHOT_STRESS* Stress = Argument;
+
+	STRESS_SNAPSHOT* Quarantine[SNAPSHOT_STRESS_QUARANTINE] = { 0 };
+
+	while (PlatformLoad(&Stress->Stop) == 0)
+	{
+		if (Stress->ReloadMilliseconds > 0)
+		{
+			PlatformSleep(Stress->ReloadMilliseconds);
+		}
+
+		STRESS_SNAPSHOT* NewSnapshot = MakeStressSnapshot(Stress->Publishes + 2);
+
+		if (NewSnapshot == NULL)
+		{
+			continue;
+		}
+
+		uint64_t StartTime = PlatformTimestamp();
+
+		STRESS_SNAPSHOT* OldSnapshot = SnapshotGuardExchange(&Stress->Guard, (void* volatile*)&Stress->Snapshot, NewSnapshot);
+
+		uint64_t EndTime = PlatformTimestamp();
+
+		// No reader can be looking at it any more, so nobody should ever see this.
+		memset(OldSnapshot, SNAPSHOT_STRESS_POISON, sizeof(STRESS_SNAPSHOT));
+
+		uint32_t Slot = (uint32_t)(Stress->Publishes % SNAPSHOT_STRESS_QUARANTINE);
+
+		free(Quarantine[Slot]);
+
+		Quarantine[Slot] = OldSnapshot;
+
+		Stress->Publishes++;
+
+		if (EndTime - StartTime > Stress->MaxPublishWaitTicks)
+		{
+			Stress->MaxPublishWaitTicks = EndTime - StartTime;
+		}
+	}
+
+	for (uint32_t Slot = 0; Slot < SNAPSHOT_STRESS_QUARANTINE; Slot++)
+	{
+		free(Quarantine[Slot]);
+	}
+
+	return(0);
+}
+
+int CommandSnapshotStress(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	SNAPSHOT_STRESS Stress;
+
+	SNAPSHOT_STRESS_READER Readers[SNAPSHOT_STRESS_MAX_THREADS];
+
+	PLATFORM_THREAD* Threads[SNAPSHOT_STRESS_MAX_THREADS] = { 0 };
+
+	PLATFORM_THREAD* Writer = NULL;
+
+	uint32_t ThreadCount = SNAPSHOT_STRESS_DEFAULT_THREADS;
+
+	uint32_t Seconds = SNAPSHOT_STRESS_DEFAULT_SECONDS;
+
+	uint32_t Started = 0;
+
+	memset(&Stress, 0, sizeof(Stress));
+
+	memset(Readers, 0, sizeof(Readers));
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--threads") == 0)
+		{
+			Valid = ((ThreadCount = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0 && ThreadCount <= SNAPSHOT_STRESS_MAX_THREADS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--seconds") == 0)
+		{
+			Valid = ((Seconds = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--reload-ms") == 0)
+		{
+			Stress.ReloadMilliseconds = (uint32_t)strtoul(Arguments[++Argument], NULL, 10);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool snapshot-stress [--threads <n>] [--seconds <n>] [--reload-ms <n, 0 for flat out>]\n");
+
+			return(2);
+		}
+	}
+
+	if ((Stress.Snapshot = MakeStressSnapshot(1)) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(1);
+	}
+
+	for (Started = 0; Started < ThreadCount; Started++)
+	{
+		Readers[Started].Stress = &Stress;
+
+		if ((Threads[Started] = PlatformStartThread(SnapshotStressReader, &Readers[Started])) == NULL)
+		{
+			fprintf(stderr, "Unable to start reader thread %lu!\n", (unsigned long)Started);
+
+			break;
+		}
+	}
+
+	if (Started == ThreadCount && (Writer = PlatformStartThread(SnapshotStressWriter, &Stress)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the writer thread!\n");
+	}
+
+	if (Writer != NULL)
+	{
+		PlatformSleep(Seconds * 1000);
+	}
+
+	PlatformIncrement(&Stress.Stop);
+
+	for (uint32_t Index = 0; Index < Started; Index++)
+	{
+		PlatformJoinThread(Threads[Index]);
+	}
+
+	if (Writer == NULL)
+	{
+		goto End;
+	}
+
+	PlatformJoinThread(Writer);
+
+	uint64_t Reads = 0;
+
+	uint64_t BadReads = 0;
+
+	uint64_t EnterTicks = 0;
+
+	uint64_t MaxEnterTicks = 0;
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		Reads += Readers[Index].Reads;
+
+		BadReads += Readers[Index].BadReads;
+
+		EnterTicks += Readers[Index].EnterTicks;
+
+		MaxEnterTicks = (Readers[Index].MaxEnterTicks > MaxEnterTicks) ? Readers[Index].MaxEnterTicks : MaxEnterTicks;
+	}
+
+	printf("%lu readers, %lu seconds: %llu reads, %llu publishes, %llu damaged or out of order.\n",
+		(unsigned long)ThreadCount,
+		(unsigned long)Seconds,
+		(unsigned long long)Reads,
+		(unsigned long long)Stress.Publishes,
+		(unsigned long long)BadReads);
+
+	printf("SnapshotGuardEnter: %.0f ns per read, %.0f ns at most. SnapshotGuardExchange: %.3f ms at most.\n",
+		(Reads > 0) ? ToolTicksToNanoseconds(EnterTicks) / (double)Reads : 0.0,
+		ToolTicksToNanoseconds(MaxEnterTicks),
+		ToolTicksToNanoseconds(Stress.MaxPublishWaitTicks) / 1e6);
+
+	if (Reads == 0 || Stress.Publishes == 0)
+	{
+		fprintf(stderr, "The readers and the writer never got going!\n");
+	}
+	else if (BadReads > 0)
+	{
+		fprintf(stderr, "Readers saw snapshots that had already been retired!\n");
+	}
+	else
+	{
+		ExitCode = 0;
+	}
+
+End:
+
+	free(Stress.Snapshot);
+
+	return(ExitCode);
+}
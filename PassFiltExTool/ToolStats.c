@@ -0,0 +1,203 @@
+/*
+ToolStats.c
+
+The stats command: prints the counters that PassFiltEx.dll keeps in PassFiltExStats.bin (see Stats.c), from a consistent
+snapshot, while lsass carries on updating them. The file is mapped rather than read, so that what is printed is what is in
+memory right now, not whatever was last flushed to disk.
+
+storm --stats writes the same kind of file from its own threads, so all of this can be tried out and tested without a DC.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#include "Stats.h"
+
+#define STATS_DEFAULT_TOP 10
+
+// Whether every call in Snapshot was counted everywhere it should have been. If not, StatsSnapshot has a bug.
+bool ToolStatsAddUp(const STATS_SNAPSHOT* Snapshot)
+{
+	uint64_t HistogramTotal = 0;
+
+	for (uint32_t Bucket = 0; Bucket < STATS_HISTOGRAM_BUCKETS; Bucket++)
+	{
+		HistogramTotal += Snapshot->Latency[Bucket];
+	}
+
+	const uint64_t* Counters = Snapshot->Counters;
+
+	return(HistogramTotal == Counters[StatsCalls] &&
+		Counters[StatsSets] + Counters[StatsChanges] == Counters[StatsCalls] &&
+		Counters[StatsAccepted] + Counters[StatsBreached] + Counters[StatsBlacklisted] + Counters[StatsNamed] + Counters[StatsWeak] + Counters[StatsOutOfMemory] == Counters[StatsCalls]);
+}
+
+static void PrintSnapshot(const STATS_SNAPSHOT* Snapshot, uint32_t Top, bool Histogram)
+{
+	const uint64_t* Counters = Snapshot->Counters;
+
+	const STATS_RELOADS* Reloads = &Snapshot->Reloads;
+
+	uint64_t Rejected = Counters[StatsBreached] + Counters[StatsBlacklisted] + Counters[StatsNamed] + Counters[StatsWeak] + Counters[StatsOutOfMemory];
+
+	printf("Password checks:      %llu (%llu SET, %llu CHANGE)\n", (unsigned long long)Counters[StatsCalls], (unsigned long long)Counters[StatsSets], (unsigned long long)Counters[StatsChanges]);
+
+	printf("Accepted:             %llu\n", (unsigned long long)Counters[StatsAccepted]);
+
+	printf("Rejected:             %llu (%llu breached, %llu blacklisted, %llu user's name, %llu too easy to guess, %llu out of memory)\n",
+		(unsigned long long)Rejected,
+		(unsigned long long)Counters[StatsBreached],
+		(unsigned long long)Counters[StatsBlacklisted],
+		(unsigned long long)Counters[StatsNamed],
+		(unsigned long long)Counters[StatsWeak],
+		(unsigned long long)Counters[StatsOutOfMemory]);
+
+	printf("Latency (ns):         p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n",
+		(unsigned long long)StatsPercentile(Snapshot, 50.0),
+		(unsigned long long)StatsPercentile(Snapshot, 90.0),
+		(unsigned long long)StatsPercentile(Snapshot, 99.0),
+		(unsigned long long)StatsPercentile(Snapshot, 99.9),
+		(unsigned long long)StatsPercentile(Snapshot, 100.0));
+
+	printf("Blacklist reloads:    %lld (%lld failed), last %lld us, max %lld us, average %lld us\n",
+		(long long)Reloads->BlacklistReloads,
+		(long long)Reloads->BlacklistReloadFailures,
+		(long long)Reloads->LastBlacklistMicroseconds,
+		(long long)Reloads->MaxBlacklistMicroseconds,
+		(long long)((Reloads->BlacklistReloads > 0) ? Reloads->TotalBlacklistMicroseconds / Reloads->BlacklistReloads : 0));
+
+	printf("Blacklist:            %lld tokens, %lld automaton states, %lld bytes, from the %s\n",
+		(long long)Reloads->BlacklistTokens,
+		(long long)Reloads->BlacklistStates,
+		(long long)Reloads->BlacklistBytes,
+		Reloads->BlacklistFromImage ? "image" : "text file");
+
+	printf("Breach index reloads: %lld (%lld failed), last %lld us, %lld hashes\n",
+		(long long)Reloads->BreachReloads,
+		(long long)Reloads->BreachReloadFailures,
+		(long long)Reloads->LastBreachMicroseconds,
+		(long long)Reloads->BreachHashes);
+
+	if (Histogram)
+	{
+		printf("\n%14s %14s %10s\n", "From (ns)", "Calls", "Cumulative");
+
+		uint64_t Seen = 0;
+
+		for (uint32_t Bucket = 0; Bucket < STATS_HISTOGRAM_BUCKETS; Bucket++)
+		{
+			if (Snapshot->Latency[Bucket] == 0)
+			{
+				continue;
+			}
+
+			Seen += Snapshot->Latency[Bucket];
+
+			printf("%14llu %14llu %9.3f%%\n", (unsigned long long)StatsBucketLowerBound(Bucket), (unsigned long long)Snapshot->Latency[Bucket], (100.0 * (double)Seen) / (double)Counters[StatsCalls]);
+		}
+	}
+
+	printf("\nMost hit blacklist tokens (%lu distinct, %llu hits not counted for lack of room):\n", (unsigned long)Snapshot->TokenCount, (unsigned long long)Snapshot->TokenHitsLost);
+
+	for (uint32_t Index = 0; Index < Snapshot->TokenCount && Index < Top; Index++)
+	{
+		printf("%12llu  %.*s\n", (unsigned long long)Snapshot->Tokens[Index].Hits, (int)Snapshot->Tokens[Index].TextLength, Snapshot->Tokens[Index].Text);
+	}
+}
+
+int CommandStats(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	const char* Path = NULL;
+
+	uint32_t Top = STATS_DEFAULT_TOP;
+
+	bool Histogram = false;
+
+	const STATS_SEGMENT* Segment = NULL;
+
+	size_t Size = 0;
+
+	STATS_SNAPSHOT* Snapshot = NULL;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = true;
+
+		if (strcmp(Arguments[Argument], "--top") == 0 && Argument + 1 < ArgumentCount)
+		{
+			Top = (uint32_t)strtoul(Arguments[++Argument], NULL, 10);
+		}
+		else if (strcmp(Arguments[Argument], "--histogram") == 0)
+		{
+			Histogram = true;
+		}
+		else if (Path == NULL && Arguments[Argument][0] != '-')
+		{
+			Path = Arguments[Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			Path = NULL;
+
+			break;
+		}
+	}
+
+	if (Path == NULL)
+	{
+		fprintf(stderr, "Usage: PassFiltExTool stats <PassFiltExStats.bin> [--top <n>] [--histogram]\n");
+
+		return(2);
+	}
+
+	if ((Segment = ToolMapFile(Path, &Size)) == NULL)
+	{
+		goto End;
+	}
+
+	if (StatsSegmentValid(Segment, Size) == false)
+	{
+		fprintf(stderr, "%s is not a stats file that this version of PassFiltExTool understands.\n", Path);
+
+		goto End;
+	}
+
+	if ((Snapshot = malloc(sizeof(STATS_SNAPSHOT))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if (StatsSnapshot(Segment, Snapshot) == false)
+	{
+		fprintf(stderr, "WARNING: The counters were changing too fast to copy cleanly. They may not add up exactly.\n");
+	}
+
+	PrintSnapshot(Snapshot, Top, Histogram);
+
+	ExitCode = 0;
+
+End:
+
+	free(Snapshot);
+
+	ToolUnmapFile(Segment, Size);
+
+	return(ExitCode);
+}
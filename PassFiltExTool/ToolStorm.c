@@ -0,0 +1,724 @@
+/*
+ToolStorm.c
+
+The storm command: what happens to PasswordFilter when lots of lsass threads call it at once, as they do during bulk account
+provisioning, while the blacklist is being reloaded underneath them.
+
+Each worker thread plays one lsass thread. It registers with a SNAPSHOT_GUARD exactly the way AcquireBlacklistSnapshot does,
+judges a password with PasswordCheck, and leaves again, as fast as it can, for a fixed time. A share of the calls are SETs
+and the rest are CHANGEs. Meanwhile a reload thread plays BlacklistThreadProc: it loads the blacklist from scratch and
+publishes it with SnapshotGuardExchange, over and over, at a fixed interval.
+
+Readers never block, so there is no lock to wait on as such. What there is instead:
+
+  - Time spent in SnapshotGuardEnter. Every reader increments the same counter, so this is where cache line contention
+    between threads shows up, along with the occasional retry when a reload flips the epoch at the wrong moment.
+
+  - Time the reload thread spends in SnapshotGuardExchange waiting for readers of the old snapshot to drain. That is the
+    writer's side of the same bargain, and it holds up the next reload, never a password change.
+
+The run is repeated for each thread count, and every run prints one line of CSV, so the output can go straight into a
+spreadsheet or a plotting script and be compared between releases.
+
+With --stats, the workers and the reload thread also keep the DLL's always-on counters (see Stats.c), in a file that
+PassFiltExTool stats can read from another shell while the storm is going on. Meanwhile the main thread takes snapshots of
+them ten times a second and checks that each one adds up, which is as hard a test of StatsSnapshot as lsass could give it.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+#include "SnapshotGuard.h"
+
+#include "Stats.h"
+
+#define STORM_DEFAULT_TOKENS 100000
+
+#define STORM_DEFAULT_SECONDS 2
+
+#define STORM_DEFAULT_SET_PERCENT 50
+
+#define STORM_DEFAULT_RELOAD_MILLISECONDS 100
+
+#define STORM_MAX_THREADS 256
+
+// Workers cycle through this many pre-generated passwords, each starting at a different place.
+#define STORM_PASSWORD_COUNT 65536
+
+#define STORM_MIN_PASSWORD_LENGTH 8
+
+#define STORM_MAX_PASSWORD_LENGTH 16
+
+#define STORM_HIT_PERCENT 10
+
+// Latencies of each worker are kept in a ring this big. A long run keeps the most recent ones.
+#define STORM_LATENCY_SAMPLES (1024 * 1024)
+
+#define STORM_STATS_SNAPSHOT_MILLISECONDS 100
+
+static const uint32_t gStormDefaultThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+typedef struct STORM_SNAPSHOT
+{
+	TOKEN_STORE Tokens;
+
+	AC_AUTOMATON* Automaton;
+
+} STORM_SNAPSHOT;
+
+// Everything the threads share. Only Stop and the published snapshot change while they run.
+typedef struct STORM
+{
+	SNAPSHOT_GUARD Guard;
+
+	STORM_SNAPSHOT* volatile Snapshot;
+
+	volatile int32_t Stop;
+
+	const uint8_t* BlacklistText;
+
+	size_t BlacklistSize;
+
+	const uint16_t* Passwords;
+
+	const uint8_t* PasswordLengths;
+
+	uint32_t SetPercent;
+
+	uint32_t ReloadMilliseconds;
+
+	SCRATCH_POOL Scratch;
+
+	TOOL_NAMES Names;
+
+	// NULL unless --stats was given.
+	STATS_SEGMENT* Stats;
+
+	// Written by the reload thread, read once it has been joined.
+	uint64_t Reloads;
+
+	uint64_t ReloadFailures;
+
+	uint64_t ReloadTicks;
+
+	uint64_t PublishWaitTicks;
+
+	uint64_t MaxPublishWaitTicks;
+
+} STORM;
+
+// One per worker. Each worker only writes to its own, and only once, when it is done.
+typedef struct STORM_WORKER
+{
+	STORM* Storm;
+
+	uint32_t Index;
+
+	uint64_t Operations;
+
+	uint64_t SetOperations;
+
+	uint64_t Rejected;
+
+	uint64_t EnterTicks;
+
+	uint64_t MaxEnterTicks;
+
+	uint64_t* Latencies;
+
+	uint64_t LatencyCount;
+
+} STORM_WORKER;
+
+static STORM_SNAPSHOT* LoadStormSnapshot(const STORM* Storm)
+{
+	BLACKLIST_LOAD_STATS Stats;
+
+	STORM_SNAPSHOT* Snapshot = calloc(1, sizeof(STORM_SNAPSHOT));
+
+	if (Snapshot == NULL)
+	{
+		return(NULL);
+	}
+
+	if (BlacklistLoad(Storm->BlacklistText, Storm->BlacklistSize, NULL, &Snapshot->Tokens, NULL, &Snapshot->Automaton, &Stats) != BlacklistLoadOk)
+	{
+		free(Snapshot);
+
+		return(NULL);
+	}
+
+	return(Snapshot);
+}
+
+static void FreeStormSnapshot(STORM_SNAPSHOT* Snapshot)
+{
+	if (Snapshot == NULL)
+	{
+		return;
+	}
+
+	AcDestroy(Snapshot->Automaton);
+
+	TokenStoreFree(&Snapshot->Tokens);
+
+	free(Snapshot);
+}
+
+static uint32_t StormWorker(void* Argument)
+{
+	STORM_WORKER* Worker = Argument;
+
+	STORM* Storm = Worker->Storm;
+
+	uint64_t Operations = 0;
+
+	uint64_t SetOperations = 0;
+
+	uint64_t Rejected = 0;
+
+	uint64_t EnterTicks = 0;
+
+	uint64_t MaxEnterTicks = 0;
+
+	// Spread the workers out over the passwords, and over SETs and CHANGEs.
+	uint32_t Next = Worker->Index * 7919;
+
+	while (PlatformLoad(&Storm->Stop) == 0)
+	{
+		uint32_t PasswordIndex = Next++ % STORM_PASSWORD_COUNT;
+
+		PLATFORM_STRING Password = { (uint16_t)(Storm->PasswordLengths[PasswordIndex] * sizeof(uint16_t)), (uint16_t)(STORM_MAX_PASSWORD_LENGTH * sizeof(uint16_t)), Storm->Passwords + ((size_t)PasswordIndex * STORM_MAX_PASSWORD_LENGTH) };
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		int32_t ReaderSlot = 0;
+
+		uint64_t StartTime = PlatformTimestamp();
+
+		STORM_SNAPSHOT* Snapshot = SnapshotGuardEnter(&Storm->Guard, (void* volatile*)&Storm->Snapshot, &ReaderSlot);
+
+		uint64_t EnteredTime = PlatformTimestamp();
+
+		// SET and CHANGE take the same path through the checks; PasswordFilter only logs them differently.
+		bool IsSet = ((Next % 100) < Storm->SetPercent);
+
+		SetOperations += IsSet;
+
+		PASSWORD_VERDICT Verdict = PasswordCheck((Snapshot != NULL) ? Snapshot->Automaton : NULL, NULL, NULL, &Storm->Scratch, &Password, &Storm->Names.AccountName, &Storm->Names.FullName, &MatchedPattern);
+
+		Rejected += PasswordVerdictRejects(Verdict);
+
+		if (MatchedPattern != AC_NO_PATTERN && Storm->Stats != NULL)
+		{
+			uint32_t MatchedLength = 0;
+
+			const uint8_t* MatchedToken = TokenStoreGet(&Snapshot->Tokens, MatchedPattern, &MatchedLength);
+
+			StatsRecordTokenHit(Storm->Stats, MatchedToken, MatchedLength);
+		}
+
+		SnapshotGuardLeave(&Storm->Guard, ReaderSlot);
+
+		uint64_t EndTime = PlatformTimestamp();
+
+		StatsRecordPassword(Storm->Stats, Verdict, IsSet, PlatformElapsedNanoseconds(StartTime, EndTime));
+
+		EnterTicks += EnteredTime - StartTime;
+
+		if (EnteredTime - StartTime > MaxEnterTicks)
+		{
+			MaxEnterTicks = EnteredTime - StartTime;
+		}
+
+		Worker->Latencies[Operations % STORM_LATENCY_SAMPLES] = EndTime - StartTime;
+
+		Operations++;
+	}
+
+	Worker->Operations = Operations;
+
+	Worker->SetOperations = SetOperations;
+
+	Worker->Rejected = Rejected;
+
+	Worker->EnterTicks = EnterTicks;
+
+	Worker->MaxEnterTicks = MaxEnterTicks;
+
+	Worker->LatencyCount = (Operations < STORM_LATENCY_SAMPLES) ? Operations : STORM_LATENCY_SAMPLES;
+
+	return(0);
+}
+
+static uint32_t StormReloader(void* Argument)
+{
+	STORM* Storm = Argument;
+
+	while (PlatformLoad(&Storm->Stop) == 0)
+	{
+		PlatformSleep(Storm->ReloadMilliseconds);
+
+		uint64_t StartTime = PlatformTimestamp();
+
+		STORM_SNAPSHOT* NewSnapshot = LoadStormSnapshot(Storm);
+
+		if (NewSnapshot == NULL)
+		{
+			StatsRecordBlacklistReload(Storm->Stats, false, 0, 0, 0, 0, false);
+
+			Storm->ReloadFailures++;
+
+			continue;
+		}
+
+		uint64_t PublishTime = PlatformTimestamp();
+
+		StatsRecordBlacklistReload(Storm->Stats, true, PlatformElapsedMicroseconds(StartTime, PublishTime), NewSnapshot->Tokens.TokenCount, NewSnapshot->Automaton->StateCount, TokenStoreMemoryUsage(&NewSnapshot->Tokens) + AcMemoryUsage(NewSnapshot->Automaton), false);
+
+		FreeStormSnapshot(SnapshotGuardExchange(&Storm->Guard, (void* volatile*)&Storm->Snapshot, NewSnapshot));
+
+		uint64_t EndTime = PlatformTimestamp();
+
+		Storm->Reloads++;
+
+		Storm->ReloadTicks += EndTime - StartTime;
+
+		Storm->PublishWaitTicks += EndTime - PublishTime;
+
+		if (EndTime - PublishTime > Storm->MaxPublishWaitTicks)
+		{
+			Storm->MaxPublishWaitTicks = EndTime - PublishTime;
+		}
+	}
+
+	return(0);
+}
+
+// Accepts a comma-separated list of thread counts. Returns how many there were, or 0 if the list is no good.
+static uint32_t ParseThreadCounts(const char* List, uint32_t* ThreadCounts, uint32_t Capacity)
+{
+	uint32_t Count = 0;
+
+	while (*List != '\0')
+	{
+		char* End = NULL;
+
+		unsigned long Value = strtoul(List, &End, 10);
+
+		if (End == List || Value == 0 || Value > STORM_MAX_THREADS || Count == Capacity || (*End != ',' && *End != '\0'))
+		{
+			return(0);
+		}
+
+		ThreadCounts[Count++] = (uint32_t)Value;
+
+		List = (*End == ',') ? End + 1 : End;
+	}
+
+	return(Count);
+}
+
+// Takes a snapshot of the counters every so often until Seconds are up. Returns false if one of them didn't add up.
+static bool WatchStats(const STORM* Storm, uint32_t ThreadCount, uint32_t Seconds)
+{
+	bool Result = true;
+
+	STATS_SNAPSHOT* Snapshot = malloc(sizeof(STATS_SNAPSHOT));
+
+	uint64_t LastCalls = 0;
+
+	uint32_t Snapshots = 0;
+
+	uint32_t Unclean = 0;
+
+	uint64_t Retries = 0;
+
+	if (Snapshot == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(false);
+	}
+
+	for (uint32_t Waited = 0; Waited < Seconds * 1000; Waited += STORM_STATS_SNAPSHOT_MILLISECONDS)
+	{
+		PlatformSleep(STORM_STATS_SNAPSHOT_MILLISECONDS);
+
+		bool Clean = StatsSnapshot(Storm->Stats, Snapshot);
+
+		Snapshots++;
+
+		Retries += Snapshot->Retries;
+
+		if (Clean == false)
+		{
+			Unclean++;
+
+			continue;
+		}
+
+		if (ToolStatsAddUp(Snapshot) == false || Snapshot->Counters[StatsCalls] < LastCalls)
+		{
+			fprintf(stderr, "A snapshot of the counters doesn't add up!\n");
+
+			Result = false;
+		}
+
+		LastCalls = Snapshot->Counters[StatsCalls];
+	}
+
+	fprintf(stderr, "%lu threads: %lu counter snapshots, %lu not clean, %llu shard retries.\n", (unsigned long)ThreadCount, (unsigned long)Snapshots, (unsigned long)Unclean, (unsigned long long)Retries);
+
+	free(Snapshot);
+
+	return(Result);
+}
+
+// One storm at one thread count. Prints one line of CSV. Returns false if the threads could not be started.
+static bool RunStorm(STORM* Storm, uint32_t ThreadCount, uint32_t Seconds, STORM_WORKER* Workers)
+{
+	bool Result = false;
+
+	PLATFORM_THREAD* Threads[STORM_MAX_THREADS] = { 0 };
+
+	PLATFORM_THREAD* Reloader = NULL;
+
+	uint64_t* AllLatencies = NULL;
+
+	TOOL_LATENCY_SUMMARY Latency = { 0 };
+
+	uint32_t Started = 0;
+
+	Storm->Stop = 0;
+
+	Storm->Reloads = 0;
+
+	Storm->ReloadFailures = 0;
+
+	Storm->ReloadTicks = 0;
+
+	Storm->PublishWaitTicks = 0;
+
+	Storm->MaxPublishWaitTicks = 0;
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		Workers[Index].Storm = Storm;
+
+		Workers[Index].Index = Index;
+	}
+
+	double StartTime = ToolNowInSeconds();
+
+	for (Started = 0; Started < ThreadCount; Started++)
+	{
+		if ((Threads[Started] = PlatformStartThread(StormWorker, &Workers[Started])) == NULL)
+		{
+			fprintf(stderr, "Unable to start worker thread %lu!\n", (unsigned long)Started);
+
+			break;
+		}
+	}
+
+	if (Started == ThreadCount && Storm->ReloadMilliseconds > 0 && (Reloader = PlatformStartThread(StormReloader, Storm)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the reload thread!\n");
+	}
+
+	if (Started == ThreadCount && (Storm->ReloadMilliseconds == 0 || Reloader != NULL))
+	{
+		if (Storm->Stats != NULL)
+		{
+			Result = WatchStats(Storm, ThreadCount, Seconds);
+		}
+		else
+		{
+			PlatformSleep(Seconds * 1000);
+
+			Result = true;
+		}
+	}
+
+	PlatformIncrement(&Storm->Stop);
+
+	for (uint32_t Index = 0; Index < Started; Index++)
+	{
+		PlatformJoinThread(Threads[Index]);
+	}
+
+	if (Reloader != NULL)
+	{
+		PlatformJoinThread(Reloader);
+	}
+
+	double Elapsed = ToolNowInSeconds() - StartTime;
+
+	if (Result == false)
+	{
+		goto End;
+	}
+
+	uint64_t Operations = 0;
+
+	uint64_t SetOperations = 0;
+
+	uint64_t Rejected = 0;
+
+	uint64_t EnterTicks = 0;
+
+	uint64_t MaxEnterTicks = 0;
+
+	uint64_t LatencyCount = 0;
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		Operations += Workers[Index].Operations;
+
+		SetOperations += Workers[Index].SetOperations;
+
+		Rejected += Workers[Index].Rejected;
+
+		EnterTicks += Workers[Index].EnterTicks;
+
+		MaxEnterTicks = (Workers[Index].MaxEnterTicks > MaxEnterTicks) ? Workers[Index].MaxEnterTicks : MaxEnterTicks;
+
+		LatencyCount += Workers[Index].LatencyCount;
+	}
+
+	if (Operations == 0 || (AllLatencies = malloc((size_t)LatencyCount * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "No operations completed, or out of memory!\n");
+
+		Result = false;
+
+		goto End;
+	}
+
+	uint64_t Merged = 0;
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		memcpy(AllLatencies + Merged, Workers[Index].Latencies, (size_t)Workers[Index].LatencyCount * sizeof(uint64_t));
+
+		Merged += Workers[Index].LatencyCount;
+	}
+
+	ToolSummarizeLatencies(AllLatencies, LatencyCount, &Latency);
+
+	printf("%lu,%.3f,%llu,%.0f,%llu,%llu,%llu,%.0f,%.0f,%.0f,%.0f,%.1f,%.0f,%llu,%.3f,%.3f,%.3f\n",
+		(unsigned long)ThreadCount,
+		Elapsed,
+		(unsigned long long)Operations,
+		(double)Operations / Elapsed,
+		(unsigned long long)SetOperations,
+		(unsigned long long)(Operations - SetOperations),
+		(unsigned long long)Rejected,
+		(double)Latency.P50,
+		(double)Latency.P99,
+		(double)Latency.P999,
+		(double)Latency.Max,
+		ToolTicksToNanoseconds(EnterTicks) / (double)Operations,
+		ToolTicksToNanoseconds(MaxEnterTicks),
+		(unsigned long long)Storm->Reloads,
+		(Storm->Reloads > 0) ? ToolTicksToNanoseconds(Storm->ReloadTicks) / 1e6 / (double)Storm->Reloads : 0.0,
+		(Storm->Reloads > 0) ? ToolTicksToNanoseconds(Storm->PublishWaitTicks) / 1e6 / (double)Storm->Reloads : 0.0,
+		ToolTicksToNanoseconds(Storm->MaxPublishWaitTicks) / 1e6);
+
+	fflush(stdout);
+
+End:
+
+	free(AllLatencies);
+
+	return(Result);
+}
+
+int CommandStorm(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	STORM Storm;
+
+	STORM_WORKER* Workers = NULL;
+
+	uint16_t* Passwords = NULL;
+
+	uint8_t* PasswordLengths = NULL;
+
+	uint8_t* BlacklistText = NULL;
+
+	uint32_t ThreadCounts[STORM_MAX_THREADS] = { 0 };
+
+	uint32_t ThreadCountCount = sizeof(gStormDefaultThreadCounts) / sizeof(gStormDefaultThreadCounts[0]);
+
+	uint32_t MaxThreads = 0;
+
+	uint64_t Tokens = STORM_DEFAULT_TOKENS;
+
+	uint32_t Seconds = STORM_DEFAULT_SECONDS;
+
+	const char* StatsPath = NULL;
+
+	memset(&Storm, 0, sizeof(Storm));
+
+	Storm.SetPercent = STORM_DEFAULT_SET_PERCENT;
+
+	Storm.ReloadMilliseconds = STORM_DEFAULT_RELOAD_MILLISECONDS;
+
+memcpy(ThreadCounts, gStormDefaultThreadCounts, sizeof(gStormDefaultThreadCounts));
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--threads") == 0)
+		{
+			Valid = ((ThreadCountCount = ParseThreadCounts(Arguments[++Argument], ThreadCounts, STORM_MAX_THREADS)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--seconds") == 0)
+		{
+			Valid = ((Seconds = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((Tokens = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Tokens <= UINT32_MAX);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--set-percent") == 0)
+		{
+			Valid = ((Storm.SetPercent = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) <= 100);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--reload-ms") == 0)
+		{
+			Storm.ReloadMilliseconds = (uint32_t)strtoul(Arguments[++Argument], NULL, 10);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--stats") == 0)
+		{
+			StatsPath = Arguments[++Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool storm [--threads <n,n,...>] [--seconds <n>] [--tokens <n>] [--set-percent <0-100>] [--reload-ms <n, 0 for none>] [--stats <stats.bin>]\n");
+
+			return(2);
+		}
+	}
+
+	ScratchPoolInitialize(&Storm.Scratch);
+
+	ToolMakeNames(&Storm.Names, TOOL_ACCOUNT_NAME, TOOL_FULL_NAME);
+
+	for (uint32_t Index = 0; Index < ThreadCountCount; Index++)
+	{
+		MaxThreads = (ThreadCounts[Index] > MaxThreads) ? ThreadCounts[Index] : MaxThreads;
+	}
+
+	if ((BlacklistText = ToolGenerateBlacklist((uint32_t)Tokens, &Storm.BlacklistSize)) == NULL ||
+		(Passwords = malloc((size_t)STORM_PASSWORD_COUNT * STORM_MAX_PASSWORD_LENGTH * sizeof(uint16_t))) == NULL ||
+		(PasswordLengths = malloc(STORM_PASSWORD_COUNT)) == NULL ||
+		(Workers = calloc(MaxThreads, sizeof(STORM_WORKER))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	Storm.BlacklistText = BlacklistText;
+
+	if (StatsPath != NULL)
+	{
+		if ((Storm.Stats = ToolCreateMappedFile(StatsPath, sizeof(STATS_SEGMENT))) == NULL)
+		{
+			goto End;
+		}
+
+		StatsInitialize(Storm.Stats);
+	}
+
+	for (uint32_t Index = 0; Index < MaxThreads; Index++)
+	{
+		if ((Workers[Index].Latencies = malloc(STORM_LATENCY_SAMPLES * sizeof(uint64_t))) == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+	}
+
+	if ((Storm.Snapshot = LoadStormSnapshot(&Storm)) == NULL)
+	{
+		fprintf(stderr, "Unable to load the blacklist!\n");
+
+		goto End;
+	}
+
+	for (uint32_t Index = 0; Index < STORM_PASSWORD_COUNT; Index++)
+	{
+		PasswordLengths[Index] = (uint8_t)(STORM_MIN_PASSWORD_LENGTH + (ToolRandom() % (STORM_MAX_PASSWORD_LENGTH - STORM_MIN_PASSWORD_LENGTH + 1)));
+
+		ToolMakePassword(Passwords + ((size_t)Index * STORM_MAX_PASSWORD_LENGTH), PasswordLengths[Index], &Storm.Snapshot->Tokens, (ToolRandom() % 100) < STORM_HIT_PERCENT);
+	}
+
+	Storm.Passwords = Passwords;
+
+	Storm.PasswordLengths = PasswordLengths;
+
+	fprintf(stderr, "%llu blacklist lines, %lu unique tokens, %lu%% SET, reload every %lu ms, %lu seconds per run.\n", (unsigned long long)Tokens, (unsigned long)Storm.Snapshot->Tokens.TokenCount, (unsigned long)Storm.SetPercent, (unsigned long)Storm.ReloadMilliseconds, (unsigned long)Seconds);
+
+	printf("threads,seconds,operations,operations_per_second,set_operations,change_operations,rejected,p50_ns,p99_ns,p999_ns,max_ns,enter_ns_per_operation,enter_max_ns,reloads,reload_ms_per_reload,publish_wait_ms_per_reload,publish_wait_max_ms\n");
+
+	for (uint32_t Index = 0; Index < ThreadCountCount; Index++)
+	{
+		if (RunStorm(&Storm, ThreadCounts[Index], Seconds, Workers) == false)
+		{
+			goto End;
+		}
+	}
+
+	ExitCode = 0;
+
+End:
+
+	FreeStormSnapshot(Storm.Snapshot);
+
+	ToolUnmapFile(Storm.Stats, sizeof(STATS_SEGMENT));
+
+	ScratchPoolDestroy(&Storm.Scratch);
+
+	if (Workers != NULL)
+	{
+		for (uint32_t Index = 0; Index < MaxThreads; Index++)
+		{
+			free(Workers[Index].Latencies);
+		}
+	}
+
+	free(Workers);
+
+	free(PasswordLengths);
+
+	free(Passwords);
+
+	free(BlacklistText);
+
+	return(ExitCode);
+}
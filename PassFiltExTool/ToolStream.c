@@ -0,0 +1,839 @@
+/*
+ToolStream.c
+
+The stream-bench command: proof that a gzipped blacklist (see BlacklistStream.c) loads into exactly the same blacklist as the
+text it was made from, and how long it takes.
+
+A blacklist of the usual synthetic tokens (see ToolBench.c), with a !substitute line at the top and !distance, !combined and
+!rule lines in the middle, is gzipped here three ways, none of them much like each other:
+
+  - fixed:   one member, in blocks compressed with the fixed Huffman codes and greedy matches.
+
+  - stored:  one member, in blocks that aren't compressed at all.
+
+  - mixed:   the text cut into several members at places that are nowhere near line breaks, each in blocks of both kinds
+             taking turns, with matches that reach back into the block before, and a file name in one of the headers.
+
+The little compressor here never uses dynamic Huffman codes, which is what gzip itself writes nearly all of the time. For
+those, gzip a blacklist and give it to --gzip along with the text, and it is checked the same way.
+
+Each one is decompressed on its own, a few thousand bytes at a time so that matches and stored blocks are cut off in the
+middle, and must give back the text byte for byte. Then it is loaded with BlacklistLoadCompressed and the text with
+BlacklistLoad, and the two token stores, automatons and counts must be identical. The times printed are of those two loads,
+and of decompressing alone. Last, damaged files must fail to load: a byte changed, the end cut off, and a zstd file.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistStream.h"
+
+#include "Inflate.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#include "Strength.h"
+
+#include "WorkerPool.h"
+
+#define STREAM_BENCH_DEFAULT_TOKENS 1000000
+
+// What the round trip check decompresses into at a time. Odd, so that it lines up with nothing.
+#define STREAM_BENCH_SMALL_OUTPUT 4093
+
+#define STREAM_BENCH_BLOCK_SIZE (256 * 1024)
+
+#define STREAM_BENCH_MIXED_MEMBERS 7
+
+#define STREAM_BENCH_HASH_BITS 15
+
+static const char gStreamBenchHeader[] = BLACKLIST_SUBSTITUTE_DIRECTIVE "a@4\n";
+
+static const char gStreamBenchDistance[] = BLACKLIST_DISTANCE_DIRECTIVE "1\n" BLACKLIST_COMBINED_DIRECTIVE "90\n" BLACKLIST_RULE_DIRECTIVE BLACKLIST_RULE_EXACT " qqqq\n" BLACKLIST_STRENGTH_DIRECTIVE "8\n";
+
+static const uint16_t gLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+static const uint8_t gLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+static const uint16_t gDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+static const uint8_t gDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+typedef enum GZIP_STYLE
+{
+	GzipStyleFixed,
+
+	GzipStyleStored,
+
+	GzipStyleMixed
+
+} GZIP_STYLE;
+
+typedef struct BIT_WRITER
+{
+	uint8_t* Output;
+
+	size_t Size;
+
+	uint64_t Bits;
+
+	uint32_t Count;
+
+} BIT_WRITER;
+
+typedef struct STREAM_BENCH_RESULT
+{
+	TOKEN_STORE Tokens;
+
+	AC_AUTOMATON* Automaton;
+
+	BLACKLIST_LOAD_STATS Stats;
+
+	uint64_t Microseconds;
+
+} STREAM_BENCH_RESULT;
+
+static void PutBits(BIT_WRITER* Writer, uint32_t Value, uint32_t Count)
+{
+	Writer->Bits |= (uint64_t)Value << Writer->Count;
+
+	Writer->Count += Count;
+
+	while (Writer->Count >= 8)
+	{
+		Writer->Output[Writer->Size++] = (uint8_t)Writer->Bits;
+
+		Writer->Bits >>= 8;
+
+		Writer->Count -= 8;
+	}
+}
+
+static void PutBytes(BIT_WRITER* Writer, const void* Data, size_t Size)
+{
+	if (Writer->Count > 0)
+	{
+		PutBits(Writer, 0, 8 - Writer->Count);
+	}
+
+	memcpy(Writer->Output + Writer->Size, Data, Size);
+
+	Writer->Size += Size;
+}
+
+// Huffman codes go into the stream from their top bit down.
+static void PutCode(BIT_WRITER* Writer, uint32_t Code, uint32_t Length)
+{
+	uint32_t Reversed = 0;
+
+	for (uint32_t Bit = 0; Bit < Length; Bit++)
+	{
+		Reversed = (Reversed << 1) | ((Code >> Bit) & 1);
+	}
+
+	PutBits(Writer, Reversed, Length);
+}
+
+static void PutFixedLiteral(BIT_WRITER* Writer, uint32_t Symbol)
+{
+	if (Symbol < 144)
+	{
+		PutCode(Writer, 0x30 + Symbol, 8);
+	}
+	else if (Symbol < 256)
+	{
+		PutCode(Writer, 0x190 + Symbol - 144, 9);
+	}
+	else if (Symbol < 280)
+	{
+		PutCode(Writer, Symbol - 256, 7);
+	}
+	else
+	{
+		PutCode(Writer, 0xC0 + Symbol - 280, 8);
+	}
+}
+
+static void PutMatch(BIT_WRITER* Writer, uint32_t Length, uint32_t Distance)
+{
+	uint32_t LengthCode = 28;
+
+	uint32_t DistanceCode = 29;
+
+	while (gLengthBase[LengthCode] > Length)
+	{
+		LengthCode--;
+	}
+
+	while (gDistanceBase[DistanceCode] > Distance)
+	{
+		DistanceCode--;
+	}
+
+	PutFixedLiteral(Writer, 257 + LengthCode);
+
+	PutBits(Writer, Length - gLengthBase[LengthCode], gLengthExtra[LengthCode]);
+
+	PutCode(Writer, DistanceCode, 5);
+
+	PutBits(Writer, Distance - gDistanceBase[DistanceCode], gDistanceExtra[DistanceCode]);
+}
+
+static uint32_t HashAt(const uint8_t* Data)
+{
+	return((((uint32_t)Data[0] << 16 | (uint32_t)Data[1] << 8 | Data[2]) * 2654435761u) >> (32 - STREAM_BENCH_HASH_BITS));
+}
+
+// One block of Data[Start, End) with the fixed codes. Matches may reach back to the start of Data, which is the member's.
+static void PutFixedBlock(BIT_WRITER* Writer, const uint8_t* Data, size_t Start, size_t End, int64_t* Heads, bool Last)
+{
+	PutBits(Writer, Last ? 1 : 0, 1);
+
+	PutBits(Writer, 1, 2);
+
+	for (size_t Position = Start; Position < End; )
+	{
+		uint32_t Length = 0;
+
+		if (Position + 3 <= End)
+		{
+			uint32_t Hash = HashAt(Data + Position);
+
+			int64_t Candidate = Heads[Hash];
+
+			Heads[Hash] = (int64_t)Position;
+
+			if (Candidate >= 0 && Position - (size_t)Candidate <= INFLATE_WINDOW_SIZE)
+			{
+				while (Length < 258 && Position + Length < End && Data[(size_t)Candidate + Length] == Data[Position + Length])
+				{
+					Length++;
+				}
+			}
+
+			if (Length >= 3)
+			{
+				PutMatch(Writer, Length, (uint32_t)(Position - (size_t)Candidate));
+
+				Position += Length;
+
+				continue;
+			}
+		}
+
+		PutFixedLiteral(Writer, Data[Position]);
+
+		Position++;
+	}
+
+	PutFixedLiteral(Writer, 256);
+}
+
+static void PutStoredBlocks(BIT_WRITER* Writer, const uint8_t* Data, size_t Start, size_t End, bool Last)
+{
+	do
+	{
+		size_t Length = (End - Start > 65535) ? 65535 : End - Start;
+
+		uint8_t Header[4] = { (uint8_t)Length, (uint8_t)(Length >> 8), (uint8_t)~Length, (uint8_t)(~Length >> 8) };
+
+		PutBits(Writer, (Last && Start + Length == End) ? 1 : 0, 1);
+
+		PutBits(Writer, 0, 2);
+
+		PutBytes(Writer, Header, sizeof(Header));
+
+		PutBytes(Writer, Data + Start, Length);
+
+		Start += Length;
+
+	} while (Start < End);
+}
+
+static void PutMember(BIT_WRITER* Writer, const INFLATE_STREAM* Crc, const uint8_t* Data, size_t Size, GZIP_STYLE Style, bool Named, int64_t* Heads)
+{
+	static const uint8_t Header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+
+	static const char Name[] = "PassFiltExBlacklist.txt";
+
+	uint32_t Checksum = InflateCrc32(Crc, 0, Data, Size);
+
+	uint8_t Trailer[8] = { (uint8_t)Checksum, (uint8_t)(Checksum >> 8), (uint8_t)(Checksum >> 16), (uint8_t)(Checksum >> 24), (uint8_t)Size, (uint8_t)(Size >> 8), (uint8_t)(Size >> 16), (uint8_t)(Size >> 24) };
+
+	PutBytes(Writer, Header, sizeof(Header));
+
+	if (Named)
+	{
+		// FNAME.
+		Writer->Output[Writer->Size - 7] = 0x08;
+
+		PutBytes(Writer, Name, sizeof(Name));
+	}
+
+	for (uint32_t Index = 0; Index < (1u << STREAM_BENCH_HASH_BITS); Index++)
+	{
+		Heads[Index] = -1;
+	}
+
+	for (size_t Start = 0, Block = 0; Start < Size || Block == 0; Block++)
+	{
+		size_t End = (Size - Start > STREAM_BENCH_BLOCK_SIZE) ? Start + STREAM_BENCH_BLOCK_SIZE : Size;
+
+		if (Style == GzipStyleStored || (Style == GzipStyleMixed && Block % 2 == 1))
+		{
+			PutStoredBlocks(Writer, Data, Start, End, End == Size);
+		}
+		else
+		{
+			PutFixedBlock(Writer, Data, Start, End, Heads, End == Size);
+		}
+
+		Start = End;
+	}
+
+	PutBytes(Writer, Trailer, sizeof(Trailer));
+}
+
+// Gzips Text in the given style, into a buffer that is big enough for the worst case of either kind of block.
+static uint8_t* Gzip(const INFLATE_STREAM* Crc, const uint8_t* Text, size_t Size, GZIP_STYLE Style, size_t* CompressedSize)
+{
+	uint32_t MemberCount = (Style == GzipStyleMixed) ? STREAM_BENCH_MIXED_MEMBERS : 1;
+
+	BIT_WRITER Writer = { 0 };
+
+	int64_t* Heads = malloc(sizeof(int64_t) << STREAM_BENCH_HASH_BITS);
+
+	if (Heads == NULL || (Writer.Output = malloc(Size + Size / 7 + (Size / 65535 + 2) * 5 * 2 + MemberCount * 64)) == NULL)
+	{
+		free(Heads);
+
+		return(NULL);
+	}
+
+	size_t Start = 0;
+
+	for (uint32_t Member = 0; Member < MemberCount; Member++)
+	{
+		// Cut wherever the arithmetic says, line break or not.
+		size_t End = (size_t)(((uint64_t)Size * (Member + 1)) / MemberCount) - ((Member + 1 < MemberCount) ? 3 : 0);
+
+		End = (End < Start) ? Start : End;
+
+		PutMember(&Writer, Crc, Text + Start, End - Start, Style, Member == 1, Heads);
+
+		Start = End;
+	}
+
+	free(Heads);
+
+	*CompressedSize = Writer.Size;
+
+	return(Writer.Output);
+}
+
+// Decompresses Data OutputSize bytes at a time, and checks it against Text. Returns how long it took, or 0 if it didn't match.
+static uint64_t CheckRoundTrip(INFLATE_STREAM* Stream, const uint8_t* Data, size_t Size, const uint8_t* Text, size_t TextSize, uint8_t* Output, size_t OutputSize)
+{
+	INFLATE_STATUS Status = InflateOk;
+
+	size_t Position = 0;
+
+	uint64_t Start = PlatformTimestamp();
+
+	InflateInitialize(Stream, Data, Size);
+
+	while (Status == InflateOk)
+	{
+		size_t Written = 0;
+
+		Status = InflateRead(Stream, Output, OutputSize, &Written);
+
+		if (Status == InflateCorrupt || Written > TextSize - Position || memcmp(Output, Text + Position, Written) != 0)
+		{
+			fprintf(stderr, "Decompressing gave back something other than the text, %llu bytes in!\n", (unsigned long long)Position);
+
+			return(0);
+		}
+
+		Position += Written;
+	}
+
+	if (Position != TextSize)
+	{
+		fprintf(stderr, "Decompressing gave back %llu bytes of the text's %llu!\n", (unsigned long long)Position, (unsigned long long)TextSize);
+
+		return(0);
+	}
+
+	uint64_t Microseconds = PlatformElapsedMicroseconds(Start, PlatformTimestamp());
+
+	return((Microseconds > 0) ? Microseconds : 1);
+}
+
+static void FreeResult(STREAM_BENCH_RESULT* Result)
+{
+	AcDestroy(Result->Automaton);
+
+	TokenStoreFree(&Result->Tokens);
+
+	memset(Result, 0, sizeof(STREAM_BENCH_RESULT));
+}
+
+static BLACKLIST_LOAD_STATUS Load(const uint8_t* Data, size_t Size, bool Compressed, const WORKER_POOL* Pool, STREAM_BENCH_RESULT* Result)
+{
+	uint64_t Start = PlatformTimestamp();
+
+	BLACKLIST_LOAD_STATUS Status = Compressed ?
+		BlacklistLoadCompressed(Data, Size, Pool, &Result->Tokens, NULL, &Result->Automaton, &Result->Stats) :
+		BlacklistLoad(Data, Size, Pool, &Result->Tokens, NULL, &Result->Automaton, &Result->Stats);
+
+	Result->Microseconds = PlatformElapsedMicroseconds(Start, PlatformTimestamp());
+
+	return(Status);
+}
+
+// Whether the compressed load came out the same as the text's, byte for byte.
+static bool SameResult(const STREAM_BENCH_RESULT* Left, const STREAM_BENCH_RESULT* Right)
+{
+	const TOKEN_STORE* LeftTokens = &Left->Tokens;
+
+	const TOKEN_STORE* RightTokens = &Right->Tokens;
+
+	const AC_AUTOMATON* LeftAutomaton = Left->Automaton;
+
+	const AC_AUTOMATON* RightAutomaton = Right->Automaton;
+
+	if (LeftTokens->TokenCount != RightTokens->TokenCount || LeftTokens->ByteCount != RightTokens->ByteCount ||
+		memcmp(LeftTokens->Offsets, RightTokens->Offsets, ((size_t)LeftTokens->TokenCount + 1) * sizeof(uint32_t)) != 0 ||
+		memcmp(LeftTokens->Bytes, RightTokens->Bytes, LeftTokens->ByteCount) != 0)
+	{
+		fprintf(stderr, "The token stores are different!\n");
+
+		return(false);
+	}
+
+	if (LeftAutomaton->StateCount != RightAutomaton->StateCount || LeftAutomaton->EdgeCount != RightAutomaton->EdgeCount ||
+		LeftAutomaton->PatternCount != RightAutomaton->PatternCount ||
+		memcmp(LeftAutomaton->States, RightAutomaton->States, (size_t)LeftAutomaton->StateCount * sizeof(AC_STATE)) != 0 ||
+		memcmp(LeftAutomaton->EdgeLabels, RightAutomaton->EdgeLabels, LeftAutomaton->EdgeCount) != 0 ||
+		memcmp(LeftAutomaton->EdgeTargets, RightAutomaton->EdgeTargets, (size_t)LeftAutomaton->EdgeCount * sizeof(uint32_t)) != 0 ||
+		LeftAutomaton->Substituting != RightAutomaton->Substituting ||
+		memcmp(LeftAutomaton->Substitutions, RightAutomaton->Substitutions, sizeof(LeftAutomaton->Substitutions)) != 0 ||
+		LeftAutomaton->EditDistance != RightAutomaton->EditDistance ||
+		LeftAutomaton->Coverage != RightAutomaton->Coverage ||
+		LeftAutomaton->CombinedCoverage != RightAutomaton->CombinedCoverage ||
+		(LeftAutomaton->Reach != NULL) != (RightAutomaton->Reach != NULL) ||
+		LeftAutomaton->MinimumStrength != RightAutomaton->MinimumStrength ||
+		(LeftAutomaton->Strength != NULL) != (RightAutomaton->Strength != NULL) ||
+		(LeftAutomaton->Strength != NULL && memcmp(LeftAutomaton->Strength, RightAutomaton->Strength, sizeof(STRENGTH_TABLES)) != 0))
+	{
+		fprintf(stderr, "The automatons are different!\n");
+
+		return(false);
+	}
+
+	if (LeftAutomaton->Reach != NULL &&
+		(memcmp(LeftAutomaton->PatternCoverage, RightAutomaton->PatternCoverage, LeftTokens->TokenCount) != 0 ||
+		memcmp(LeftAutomaton->Reach, RightAutomaton->Reach, (size_t)LeftAutomaton->StateCount * sizeof(uint16_t)) != 0 ||
+		memcmp(LeftAutomaton->Span, RightAutomaton->Span, (size_t)LeftAutomaton->StateCount * sizeof(uint16_t)) != 0))
+	{
+		fprintf(stderr, "The rules are different!\n");
+
+		return(false);
+	}
+
+	if (Left->Stats.BytesRead != Right->Stats.BytesRead || Left->Stats.LinesRead != Right->Stats.LinesRead ||
+		Left->Stats.EmptyLines != Right->Stats.EmptyLines || Left->Stats.TruncatedLines != Right->Stats.TruncatedLines ||
+		Left->Stats.TokensAdded != Right->Stats.TokensAdded || Left->Stats.Directives != Right->Stats.Directives ||
+		Left->Stats.LateDirectives != Right->Stats.LateDirectives || Left->Stats.BadDirectives != Right->Stats.BadDirectives ||
+		Left->Stats.Rules != Right->Stats.Rules)
+	{
+		fprintf(stderr, "The load counts are different!\n");
+
+		return(false);
+	}
+
+	return(true);
+}
+
+// Decompresses and loads one compressed file, and checks both against the text and the text's load.
+static bool CheckCompressed(const char* Name, const uint8_t* Data, size_t Size, const uint8_t* Text, size_t TextSize, const STREAM_BENCH_RESULT* Baseline, const WORKER_POOL* Pool, INFLATE_STREAM* Stream, uint8_t* Output)
+{
+	STREAM_BENCH_RESULT Result = { 0 };
+
+	if (CheckRoundTrip(Stream, Data, Size, Text, TextSize, Output, STREAM_BENCH_SMALL_OUTPUT) == 0)
+	{
+		fprintf(stderr, "The %s file doesn't decompress to the text!\n", Name);
+
+		return(false);
+	}
+
+	uint64_t InflateMicroseconds = CheckRoundTrip(Stream, Data, Size, Text, TextSize, Output, BLACKLIST_STREAM_BUFFER_SIZE);
+
+	BLACKLIST_LOAD_STATUS Status = Load(Data, Size, true, Pool, &Result);
+
+	if (Status != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the %s file: %s\n", Name, BlacklistLoadStatusString(Status));
+
+		return(false);
+	}
+
+	bool Same = SameResult(Baseline, &Result);
+
+	printf("%-8s  %10llu  %5.1f%%  %12.1f  %13.1f  %8.1f  %12.1f  %7.1f\n",
+		Name,
+		(unsigned long long)Size,
+		100.0 * (double)Size / (double)TextSize,
+		(double)TextSize / (double)InflateMicroseconds,
+		(double)Result.Stats.ParseMicroseconds / 1000.0,
+		(double)Result.Stats.MergeMicroseconds / 1000.0,
+		(double)Result.Stats.AutomatonMicroseconds / 1000.0,
+		(double)Result.Microseconds / 1000.0);
+
+	fflush(stdout);
+
+	FreeResult(&Result);
+
+	if (Same == false)
+	{
+		fprintf(stderr, "The %s file doesn't load into the same blacklist as the text!\n", Name);
+	}
+
+	return(Same);
+}
+
+// Damaged copies of a good compressed file must all fail to load.
+static bool CheckDamaged(const uint8_t* Data, size_t Size, const WORKER_POOL* Pool)
+{
+	static const uint8_t Zstd[] = { 0x28, 0xB5, 0x2F, 0xFD, 0x24, 0x00, 0x01, 0x00, 0x00 };
+
+	uint8_t* Copy = malloc(Size + 1);
+
+	bool Succeeded = false;
+
+	if (Copy == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(false);
+	}
+
+	struct
+	{
+		const char* Name;
+
+		size_t Size;
+
+		BLACKLIST_LOAD_STATUS Expected;
+
+	} Cases[] =
+	{
+		{ "a byte changed in the middle", Size, BlacklistLoadCorrupt },
+
+		{ "a byte changed in the trailer", Size, BlacklistLoadCorrupt },
+
+		{ "the last byte cut off", Size - 1, BlacklistLoadCorrupt },
+
+		{ "cut off halfway", Size / 2, BlacklistLoadCorrupt },
+
+		{ "a byte of garbage on the end", Size + 1, BlacklistLoadCorrupt },
+
+		{ "zstd", sizeof(Zstd), BlacklistLoadUnsupported }
+	};
+
+	for (uint32_t Index = 0; Index < sizeof(Cases) / sizeof(Cases[0]); Index++)
+	{
+		STREAM_BENCH_RESULT Result = { 0 };
+
+		memcpy(Copy, Data, Size);
+
+		Copy[Size] = 0;
+
+		switch (Index)
+		{
+			case 0:
+			{
+				Copy[Size / 2] ^= 0x10;
+
+				break;
+			}
+			case 1:
+			{
+				Copy[Size - 6] ^= 0x01;
+
+				break;
+			}
+			case 5:
+			{
+				memcpy(Copy, Zstd, sizeof(Zstd));
+
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+
+		BLACKLIST_LOAD_STATUS Status = Load(Copy, Cases[Index].Size, true, Pool, &Result);
+
+		FreeResult(&Result);
+
+		printf("  %-30s  %s\n", Cases[Index].Name, BlacklistLoadStatusString(Status));
+
+		if (Status != Cases[Index].Expected)
+		{
+			fprintf(stderr, "A file with %s should have failed with \"%s\"!\n", Cases[Index].Name, BlacklistLoadStatusString(Cases[Index].Expected));
+
+			goto End;
+		}
+	}
+
+	Succeeded = true;
+
+End:
+
+	free(Copy);
+
+	return(Succeeded);
+}
+
+// The generated list, with the header in front and the other directives halfway through.
+static uint8_t* MakeText(uint32_t TokenCount, size_t* Size)
+{
+	size_t ListSize = 0;
+
+	uint8_t* List = ToolGenerateBlacklist(TokenCount, &ListSize);
+
+	uint8_t* Text = NULL;
+
+	if (List == NULL || (Text = malloc(ListSize + sizeof(gStreamBenchHeader) + sizeof(gStreamBenchDistance))) == NULL)
+	{
+		free(List);
+
+		return(NULL);
+	}
+
+	const uint8_t* Middle = memchr(List + (ListSize / 2), '\n', ListSize - (ListSize / 2));
+
+	size_t FirstHalf = (size_t)(Middle - List) + 1;
+
+	*Size = 0;
+
+	memcpy(Text + *Size, gStreamBenchHeader, sizeof(gStreamBenchHeader) - 1);
+
+	*Size += sizeof(gStreamBenchHeader) - 1;
+
+	memcpy(Text + *Size, List, FirstHalf);
+
+	*Size += FirstHalf;
+
+	memcpy(Text + *Size, gStreamBenchDistance, sizeof(gStreamBenchDistance) - 1);
+
+	*Size += sizeof(gStreamBenchDistance) - 1;
+
+	memcpy(Text + *Size, List + FirstHalf, ListSize - FirstHalf);
+
+	*Size += ListSize - FirstHalf;
+
+	free(List);
+
+	return(Text);
+}
+
+int CommandStreamBench(int ArgumentCount, char** Arguments)
+{
+	static const char* const StyleNames[] = { "fixed", "stored", "mixed" };
+
+	int ExitCode = 1;
+
+	uint64_t TokenCount = STREAM_BENCH_DEFAULT_TOKENS;
+
+	const char* GzipPath = NULL;
+
+	const char* TextPath = NULL;
+
+	const uint8_t* Text = NULL;
+
+	size_t TextSize = 0;
+
+	const uint8_t* GzipFile = NULL;
+
+	size_t GzipFileSize = 0;
+
+	uint8_t* Generated = NULL;
+
+	uint8_t* Compressed[3] = { NULL };
+
+	size_t CompressedSizes[3] = { 0 };
+
+	INFLATE_STREAM* Stream = NULL;
+
+	uint8_t* Output = NULL;
+
+	STREAM_BENCH_RESULT Baseline = { 0 };
+
+	WORKER_POOL Pool;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX / 2);
+		}
+		else if (Argument + 2 < ArgumentCount && strcmp(Arguments[Argument], "--gzip") == 0)
+		{
+			GzipPath = Arguments[++Argument];
+
+			TextPath = Arguments[++Argument];
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool stream-bench [--tokens <n>] [--gzip <blacklist.txt.gz> <blacklist.txt>]\n");
+
+			return(2);
+		}
+	}
+
+	WorkerPoolInitialize(&Pool, WorkerPoolDefaultThreadCount(WORKER_POOL_MAX_THREADS));
+
+	if ((Stream = malloc(sizeof(INFLATE_STREAM))) == NULL || (Output = malloc(BLACKLIST_STREAM_BUFFER_SIZE)) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if (TextPath != NULL)
+	{
+		if ((Text = ToolMapFile(TextPath, &TextSize)) == NULL || (GzipFile = ToolMapFile(GzipPath, &GzipFileSize)) == NULL)
+		{
+			fprintf(stderr, "Unable to read %s!\n", (Text == NULL) ? TextPath : GzipPath);
+
+			goto End;
+		}
+	}
+	else
+	{
+		if ((Generated = MakeText((uint32_t)TokenCount, &TextSize)) == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+
+		Text = Generated;
+	}
+
+	// Just for the CRC table.
+	InflateInitialize(Stream, NULL, 0);
+
+	for (uint32_t Style = 0; Style < 3 && GzipFile == NULL; Style++)
+	{
+		if ((Compressed[Style] = Gzip(Stream, Text, TextSize, (GZIP_STYLE)Style, &CompressedSizes[Style])) == NULL)
+		{
+			fprintf(stderr, "Out of memory!\n");
+
+			goto End;
+		}
+	}
+
+	BLACKLIST_LOAD_STATUS Status = Load(Text, TextSize, false, &Pool, &Baseline);
+
+	if (Status != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the text: %s\n", BlacklistLoadStatusString(Status));
+
+		goto End;
+	}
+
+	printf("\n%llu lines (%llu bytes), %lu unique tokens, loaded on %u threads.\n\n",
+		(unsigned long long)Baseline.Stats.LinesRead,
+		(unsigned long long)TextSize,
+		(unsigned long)Baseline.Tokens.TokenCount,
+		WorkerPoolThreadCount(&Pool));
+
+	printf("file           bytes   ratio  inflate MB/s  inflate+parse ms  sort ms  automaton ms  load ms\n");
+
+	printf("%-8s  %10llu  %5.1f%%  %12s  %13.1f  %8.1f  %12.1f  %7.1f\n",
+		"text",
+		(unsigned long long)TextSize,
+		100.0,
+		"-",
+		(double)Baseline.Stats.ParseMicroseconds / 1000.0,
+		(double)Baseline.Stats.MergeMicroseconds / 1000.0,
+		(double)Baseline.Stats.AutomatonMicroseconds / 1000.0,
+		(double)Baseline.Microseconds / 1000.0);
+
+	if (GzipFile != NULL)
+	{
+		if (CheckCompressed("gzip", GzipFile, GzipFileSize, Text, TextSize, &Baseline, &Pool, Stream, Output) == false)
+		{
+			goto End;
+		}
+	}
+
+	for (uint32_t Style = 0; Style < 3 && GzipFile == NULL; Style++)
+	{
+		if (CheckCompressed(StyleNames[Style], Compressed[Style], CompressedSizes[Style], Text, TextSize, &Baseline, &Pool, Stream, Output) == false)
+		{
+			goto End;
+		}
+	}
+
+	printf("\nDamaged files:\n");
+
+	if (CheckDamaged((GzipFile != NULL) ? GzipFile : Compressed[GzipStyleMixed], (GzipFile != NULL) ? GzipFileSize : CompressedSizes[GzipStyleMixed], &Pool) == false)
+	{
+		goto End;
+	}
+
+	printf("\nEvery file decompressed to the text and loaded into the same blacklist, and every damaged one was turned away.\n");
+
+	ExitCode = 0;
+
+End:
+
+	FreeResult(&Baseline);
+
+	for (uint32_t Style = 0; Style < 3; Style++)
+	{
+		free(Compressed[Style]);
+	}
+
+	if (Generated != NULL)
+	{
+		free(Generated);
+	}
+	else if (Text != NULL)
+	{
+		ToolUnmapFile(Text, TextSize);
+	}
+
+	if (GzipFile != NULL)
+	{
+		ToolUnmapFile(GzipFile, GzipFileSize);
+	}
+
+	free(Output);
+
+	free(Stream);
+
+	return(ExitCode);
+}
@@ -0,0 +1,675 @@
+/*
+ToolStrength.c
+
+The strength-bench command: proof that a blacklist's !strength (see Strength.c) turns away the passwords it should, and that
+estimating one never takes long, whatever the password and whatever the blacklist.
+
+First, a small blacklist with a !strength goes through PasswordCheck with known cases: keyboard walks, sequences, repeats, dates,
+and blacklist tokens with digits and symbols around them, which must be rejected, and passwords that only brute force gets,
+which must not be. The same cases are judged again through a blacklist image of it, which has to come out with the same tables.
+Then a blacklist with a !distance as well, which the near match search runs out of budget on, has to reject the password that
+is too easy to guess all the same.
+
+Then a blacklist of the usual synthetic tokens (see ToolBench.c) is loaded with a !strength, and StrengthEstimate is timed on its
+own, call by call, for passwords as long as it estimates, made to be as much work as they can: one character over and over, two
+in turn, keyboard walks, digits that can be read as dates in many ways, dates one after another, tokens one after another, and
+random characters, and one character too long. Last, a blacklist of "a", "aa", and so on up to the longest token there can be,
+which is the most dictionary matches a password can have, is timed with a password of all "a". For each, the mean and the
+percentiles show how far the worst case is from the typical one, and the share of estimates that ran out of budget shows how
+often STRENGTH_WORK_BUDGET decides the verdict.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "BlacklistImage.h"
+
+#include "FuzzyMatch.h"
+
+#include "Normalize.h"
+
+#include "PassFiltExTool.h"
+
+#include "PasswordCheck.h"
+
+#include "Platform.h"
+
+#include "Strength.h"
+
+#define STRENGTH_BENCH_DEFAULT_TOKENS 1000000
+
+#define STRENGTH_BENCH_DEFAULT_CHECKS 20000
+
+#define STRENGTH_BENCH_MINIMUM 8
+
+#define STRENGTH_BENCH_MAX_CASE_LENGTH 64
+
+#define STRENGTH_BENCH_KINDS 8
+
+// Enough tokens over few enough letters that a near match search through a long password goes past FUZZY_STATE_BUDGET.
+#define STRENGTH_FUZZY_TOKENS 100000
+
+#define STRENGTH_FUZZY_TOKEN_LENGTH 16
+
+static const char gStrengthCheckBlacklist[] =
+	BLACKLIST_COVERAGE_DIRECTIVE "100\n"
+	BLACKLIST_SUBSTITUTE_DIRECTIVE "o0\n"
+	BLACKLIST_STRENGTH_DIRECTIVE "12\n"
+	"password\n"
+	"football\n"
+	"summer\n"
+	"dragon\n"
+	"monkey\n"
+	"letmein\n"
+	BLACKLIST_STRENGTH_DIRECTIVE "8\n";
+
+static const char* gStrengthBenchKinds[STRENGTH_BENCH_KINDS] = { "aaaa", "abab", "walk", "digits", "dates", "tokens", "random", "too long" };
+
+// A walk along the three rows of letters and back.
+static const char gStrengthBenchWalk[] = "qwertyuiopoiuytrewqasdfghjkllkjhgfdsazxcvbnm";
+
+typedef struct STRENGTH_CHECK_CASE
+{
+	const char* Password;
+
+	PASSWORD_VERDICT Expected;
+
+} STRENGTH_CHECK_CASE;
+
+// The blacklist's tokens only reject a password they are all of (!coverage 100), so that everything else is up to the estimate.
+static const STRENGTH_CHECK_CASE gStrengthCheckCases[] =
+{
+	{ "qwertyuiop", PasswordTooGuessable },
+	{ "QWERTYuiop", PasswordTooGuessable },
+	{ "zxcvbnm,./", PasswordTooGuessable },
+	{ "7896321456", PasswordTooGuessable },
+	{ "abcdefghijkl", PasswordTooGuessable },
+	{ "97531", PasswordTooGuessable },
+	{ "aaaaaaaaaaaaaaaa", PasswordTooGuessable },
+	{ "abcabcabcabcabc", PasswordTooGuessable },
+	{ "19/07/1987", PasswordTooGuessable },
+	{ "07191987", PasswordTooGuessable },
+	{ "Summer2019!", PasswordTooGuessable },
+	{ "Passw0rd1987", PasswordTooGuessable },
+	{ "dragonmonkey", PasswordTooGuessable },
+	{ "FOOTBALL123", PasswordTooGuessable },
+	// The last !strength is the one that counts, so this one is over 10^8, and under 10^12.
+	{ "Pqx7vR2mW9", PasswordAccepted },
+	{ "letmein", PasswordBlacklisted },
+	{ "correcthorsebatterystaple", PasswordAccepted },
+	{ "Xk#9vQ2!mZp4", PasswordAccepted },
+	{ "tr0ub4dor&3", PasswordAccepted },
+	{ "summer-8Jq#d", PasswordAccepted }
+};
+
+typedef struct STRENGTH_BENCH_RESULT
+{
+	uint64_t Rejected;
+
+	uint64_t OverBudget;
+
+	uint64_t MaxWork;
+
+	TOOL_LATENCY_SUMMARY Latency;
+
+} STRENGTH_BENCH_RESULT;
+
+static uint64_t CheckCasesWith(const AC_AUTOMATON* Automaton, const char* Name)
+{
+	uint16_t Password[STRENGTH_BENCH_MAX_CASE_LENGTH];
+
+	uint64_t Wrong = 0;
+
+	for (size_t Case = 0; Case < sizeof(gStrengthCheckCases) / sizeof(gStrengthCheckCases[0]); Case++)
+	{
+		const STRENGTH_CHECK_CASE* Known = &gStrengthCheckCases[Case];
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		size_t Length = ToolDecodeUtf8((const uint8_t*)Known->Password, (uint32_t)strlen(Known->Password), Password, STRENGTH_BENCH_MAX_CASE_LENGTH);
+
+		PLATFORM_STRING String = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Password };
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, NULL, NULL, &String, NULL, NULL, &MatchedPattern);
+
+		if (Verdict != Known->Expected)
+		{
+			fprintf(stderr, "%s, %s: expected %s, got %s.\n", Known->Password, Name, PasswordVerdictString(Known->Expected), PasswordVerdictString(Verdict));
+
+			Wrong++;
+		}
+	}
+
+	return(Wrong);
+}
+
+static uint64_t CheckCases(void)
+{
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	TOKEN_STORE ImageTokens = { 0 };
+
+	AC_AUTOMATON* ImageAutomaton = NULL;
+
+	TOKEN_STORE OlderTokens = { 0 };
+
+	AC_AUTOMATON* OlderAutomaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	void* Image = NULL;
+
+	uint64_t Wrong = 0;
+
+	if (BlacklistLoad((const uint8_t*)gStrengthCheckBlacklist, sizeof(gStrengthCheckBlacklist) - 1, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk)
+	{
+		fprintf(stderr, "Unable to load the test blacklist!\n");
+
+		return(1);
+	}
+
+	size_t ImageSize = BlacklistImageSize(&Tokens, Automaton);
+
+	if ((Image = malloc(ImageSize)) == NULL ||
+		BlacklistImageWrite(&Tokens, Automaton, Image, ImageSize) == false ||
+		BlacklistImageOpen(Image, ImageSize, &ImageTokens, NULL, &ImageAutomaton) != BlacklistImageOk)
+	{
+		fprintf(stderr, "Unable to write and open the image of the test blacklist!\n");
+
+		Wrong++;
+
+		goto End;
+	}
+
+	if (Automaton->MinimumStrength != STRENGTH_BENCH_MINIMUM || Automaton->Strength == NULL ||
+		ImageAutomaton->MinimumStrength != STRENGTH_BENCH_MINIMUM || ImageAutomaton->Strength == NULL ||
+		memcmp(Automaton->Strength, ImageAutomaton->Strength, sizeof(STRENGTH_TABLES)) != 0)
+	{
+		fprintf(stderr, "Expected a !strength of %d, with the same tables from the image!\n", STRENGTH_BENCH_MINIMUM);
+
+		Wrong++;
+	}
+
+	// The checksum doesn't cover the header, so the same image with an older version is one a DLL could be handed. It has to be
+	// turned down, not opened without its !strength.
+	BLACKLIST_IMAGE_HEADER* Header = Image;
+
+	if (Header->Version != BLACKLIST_IMAGE_VERSION_STRENGTH)
+	{
+		fprintf(stderr, "Expected an image version of %d, got %lu!\n", BLACKLIST_IMAGE_VERSION_STRENGTH, (unsigned long)Header->Version);
+
+		Wrong++;
+	}
+
+	Header->Version = BLACKLIST_IMAGE_VERSION_RULES;
+
+	if (BlacklistImageOpen(Image, ImageSize, &OlderTokens, NULL, &OlderAutomaton) != BlacklistImageBadTables)
+	{
+		fprintf(stderr, "An image with a !strength was opened as version %d!\n", BLACKLIST_IMAGE_VERSION_RULES);
+
+		AcDestroy(OlderAutomaton);
+
+		Wrong++;
+	}
+
+	Wrong += CheckCasesWith(Automaton, "loaded");
+
+	Wrong += CheckCasesWith(ImageAutomaton, "from the image");
+
+	printf("%lu known cases, %llu wrong.\n", (unsigned long)(sizeof(gStrengthCheckCases) / sizeof(gStrengthCheckCases[0])), (unsigned long long)Wrong);
+
+End:
+
+	AcDestroy(ImageAutomaton);
+
+	TokenStoreFree(&ImageTokens);
+
+	free(Image);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(Wrong);
+}
+
+/*
+A !distance and a !strength together, with a list the near match search runs out of budget on. The estimate still has to be
+made then: a password that is too easy to guess is rejected, and one that is not keeps the verdict that says the near match
+search was cut short. The tokens are too short to make up half of either password, so only the budget stops the search.
+
+*/
+static uint64_t CheckFuzzyOverBudget(void)
+{
+	static const STRENGTH_CHECK_CASE Cases[] =
+	{
+		{ "abcdabcdabcdabcdabcdabcdabcdabcdabcdabcd", PasswordTooGuessable },
+		{ "dacbbdacadcbbadcabdcaddbcabdacbdcbadcabd", PasswordAcceptedOverBudget }
+	};
+
+	const size_t Head = sizeof(BLACKLIST_DISTANCE_DIRECTIVE "3\n" BLACKLIST_STRENGTH_DIRECTIVE "8\n") - 1;
+
+	size_t Size = Head + (size_t)STRENGTH_FUZZY_TOKENS * (STRENGTH_FUZZY_TOKEN_LENGTH + 1);
+
+	uint8_t* Text = malloc(Size);
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	uint16_t Password[STRENGTH_BENCH_MAX_CASE_LENGTH];
+
+	uint64_t Wrong = 0;
+
+	if (Text == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(1);
+	}
+
+	memcpy(Text, BLACKLIST_DISTANCE_DIRECTIVE "3\n" BLACKLIST_STRENGTH_DIRECTIVE "8\n", Head);
+
+	for (size_t Token = 0, Offset = Head; Token < STRENGTH_FUZZY_TOKENS; Token++)
+	{
+		for (uint32_t Character = 0; Character < STRENGTH_FUZZY_TOKEN_LENGTH; Character++)
+		{
+			Text[Offset++] = (uint8_t)('a' + ToolRandom() % 4);
+		}
+
+		Text[Offset++] = '\n';
+	}
+
+	if (BlacklistLoad(Text, Size, NULL, &Tokens, NULL, &Automaton, &Stats) != BlacklistLoadOk || Automaton->Strength == NULL)
+	{
+		fprintf(stderr, "Unable to load the near match test blacklist!\n");
+
+		Wrong++;
+
+		goto End;
+	}
+
+	for (size_t Case = 0; Case < sizeof(Cases) / sizeof(Cases[0]); Case++)
+	{
+		FUZZY_STATUS FuzzyStatus = FuzzyNotFound;
+
+		uint32_t MatchedPattern = AC_NO_PATTERN;
+
+		size_t Length = ToolDecodeUtf8((const uint8_t*)Cases[Case].Password, (uint32_t)strlen(Cases[Case].Password), Password, STRENGTH_BENCH_MAX_CASE_LENGTH);
+
+		PLATFORM_STRING String = { (uint16_t)(Length * sizeof(uint16_t)), (uint16_t)(Length * sizeof(uint16_t)), Password };
+
+		// Both passwords are plain lower case letters, so they are already folded for the search.
+		if (FuzzyFindToken(Automaton, Password, Length, Automaton->EditDistance, FUZZY_STATE_BUDGET, &FuzzyStatus, NULL) != AC_NO_PATTERN || FuzzyStatus != FuzzyOverBudget)
+		{
+			fprintf(stderr, "%s: expected the near match search to run out of budget!\n", Cases[Case].Password);
+
+			Wrong++;
+		}
+
+		PASSWORD_VERDICT Verdict = PasswordCheck(Automaton, NULL, NULL, NULL, &String, NULL, NULL, &MatchedPattern);
+
+		if (Verdict != Cases[Case].Expected)
+		{
+			fprintf(stderr, "%s, near match over budget: expected %s, got %s.\n", Cases[Case].Password, PasswordVerdictString(Cases[Case].Expected), PasswordVerdictString(Verdict));
+
+			Wrong++;
+		}
+	}
+
+	printf("%lu cases with the near match search over budget, %llu wrong.\n", (unsigned long)(sizeof(Cases) / sizeof(Cases[0])), (unsigned long long)Wrong);
+
+End:
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	free(Text);
+
+	return(Wrong);
+}
+
+// A password of one of gStrengthBenchKinds, as long as it can be. Returns its length.
+static uint32_t MakePassword(uint32_t Kind, const TOKEN_STORE* Tokens, uint16_t* Password)
+{
+	uint32_t Length = STRENGTH_MAX_PASSWORD_LENGTH;
+
+	uint16_t First = (Kind == 0) ? L'a' : (uint16_t)('a' + (ToolRandom() % 26));
+
+	uint16_t Second = (uint16_t)('a' + (ToolRandom() % 26));
+
+	size_t Offset = (size_t)(ToolRandom() % (sizeof(gStrengthBenchWalk) - 1));
+
+	uint32_t Index = 0;
+
+	switch (Kind)
+	{
+		case 0:
+		case 1:
+		{
+			for (Index = 0; Index < Length; Index++)
+			{
+				Password[Index] = (Kind == 0 || (Index % 2) == 0) ? First : Second;
+			}
+
+			break;
+		}
+		case 2:
+		{
+			for (Index = 0; Index < Length; Index++)
+			{
+				Password[Index] = (uint16_t)gStrengthBenchWalk[(Offset + Index) % (sizeof(gStrengthBenchWalk) - 1)];
+			}
+
+			break;
+		}
+		case 3:
+		{
+			for (Index = 0; Index < Length; Index++)
+			{
+				Password[Index] = (uint16_t)('0' + (ToolRandom() % 10));
+			}
+
+			break;
+		}
+		case 4:
+		{
+			while (Index < Length)
+			{
+				char Date[16];
+
+				int DateLength = snprintf(Date, sizeof(Date), "%02u/%02u/%04u", (unsigned)(1 + (ToolRandom() % 28)), (unsigned)(1 + (ToolRandom() % 12)), (unsigned)(1950 + (ToolRandom() % 80)));
+
+				for (int Character = 0; Character < DateLength && Index < Length; Character++)
+				{
+					Password[Index++] = (uint16_t)Date[Character];
+				}
+			}
+
+			break;
+		}
+		case 5:
+		{
+			while (Index < Length)
+			{
+				uint32_t TokenLength = 0;
+
+				const uint8_t* Token = TokenStoreGet(Tokens, (uint32_t)(ToolRandom() % Tokens->TokenCount), &TokenLength);
+
+				for (uint32_t Character = 0; Character < TokenLength && Index < Length; Character++)
+				{
+					Password[Index++] = Token[Character];
+				}
+			}
+
+			break;
+		}
+		default:
+		{
+			Length += (Kind == STRENGTH_BENCH_KINDS - 1);
+
+			ToolMakePassword(Password, Length, Tokens, false);
+
+			break;
+		}
+	}
+
+	return(Length);
+}
+
+// Kind is one of gStrengthBenchKinds. Every password is made, folded and canonicalized before its estimate is timed.
+static void RunChecks(const AC_AUTOMATON* Automaton, const TOKEN_STORE* Tokens, uint32_t Kind, uint64_t Checks, uint64_t* Latencies, STRENGTH_BENCH_RESULT* Result)
+{
+	uint16_t Password[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	uint16_t Canonical[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	memset(Result, 0, sizeof(STRENGTH_BENCH_RESULT));
+
+	for (uint64_t Check = 0; Check < Checks; Check++)
+	{
+		uint32_t Length = MakePassword(Kind, Tokens, Password);
+
+		double Guesses = 0.0;
+
+		uint64_t Work = 0;
+
+		memcpy(Canonical, Password, Length * sizeof(uint16_t));
+
+		NormalizeString(Canonical, Length);
+
+		BlacklistCanonicalize(Automaton, Canonical, Length);
+
+		uint64_t CheckStart = PlatformTimestamp();
+
+		STRENGTH_STATUS Status = StrengthEstimate(Automaton, NULL, Password, Canonical, Length, &Guesses, &Work);
+
+		Latencies[Check] = PlatformTimestamp() - CheckStart;
+
+		Result->Rejected += (Status != StrengthTooLong && Guesses < Automaton->Strength->Threshold);
+
+		Result->OverBudget += (Status == StrengthOverBudget);
+
+		Result->MaxWork = (Work > Result->MaxWork) ? Work : Result->MaxWork;
+	}
+
+	ToolSummarizeLatencies(Latencies, Checks, &Result->Latency);
+}
+
+static void PrintResult(const char* Name, const STRENGTH_BENCH_RESULT* Result, uint64_t Checks)
+{
+	printf("%-18s  %8.2f%%  %11.2f%%  %8llu  %8llu  %8llu  %8llu  %8llu  %8llu\n",
+		Name,
+		(100.0 * (double)Result->Rejected) / (double)Checks,
+		(100.0 * (double)Result->OverBudget) / (double)Checks,
+		(unsigned long long)Result->MaxWork,
+		(unsigned long long)Result->Latency.Mean,
+		(unsigned long long)Result->Latency.P50,
+		(unsigned long long)Result->Latency.P99,
+		(unsigned long long)Result->Latency.P999,
+		(unsigned long long)Result->Latency.Max);
+}
+
+// List with a !strength line after it, in a buffer of its own.
+static uint8_t* WithStrength(const uint8_t* List, size_t ListSize, size_t* Size)
+{
+	uint8_t* Text = malloc(ListSize + 32);
+
+	if (Text == NULL)
+	{
+		return(NULL);
+	}
+
+	memcpy(Text, List, ListSize);
+
+	*Size = ListSize + (size_t)sprintf((char*)Text + ListSize, BLACKLIST_STRENGTH_DIRECTIVE "%d\n", STRENGTH_BENCH_MINIMUM);
+
+	return(Text);
+}
+
+// "a", "aa", and so on, up to the longest token there can be.
+static uint8_t* PathologicalList(size_t* Size)
+{
+	uint8_t* Text = malloc((size_t)MAX_BLACKLIST_STRING_SIZE * MAX_BLACKLIST_STRING_SIZE);
+
+	size_t Length = 0;
+
+	if (Text == NULL)
+	{
+		return(NULL);
+	}
+
+	for (uint32_t TokenLength = 1; TokenLength < MAX_BLACKLIST_STRING_SIZE; TokenLength++)
+	{
+		memset(Text + Length, 'a', TokenLength);
+
+		Length += TokenLength;
+
+		Text[Length++] = '\n';
+	}
+
+	*Size = Length;
+
+	return(Text);
+}
+
+static bool LoadWithStrength(const uint8_t* List, size_t ListSize, TOKEN_STORE* Tokens, AC_AUTOMATON** Automaton)
+{
+	BLACKLIST_LOAD_STATS Stats = { 0 };
+
+	size_t Size = 0;
+
+	uint8_t* Text = WithStrength(List, ListSize, &Size);
+
+	if (Text == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(false);
+	}
+
+	BLACKLIST_LOAD_STATUS Status = BlacklistLoad(Text, Size, NULL, Tokens, NULL, Automaton, &Stats);
+
+	free(Text);
+
+	if (Status != BlacklistLoadOk || (*Automaton)->Strength == NULL)
+	{
+		fprintf(stderr, "Unable to load the blacklist: %s\n", BlacklistLoadStatusString(Status));
+
+		return(false);
+	}
+
+	return(true);
+}
+
+int CommandStrengthBench(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t TokenCount = STRENGTH_BENCH_DEFAULT_TOKENS;
+
+	uint64_t Checks = STRENGTH_BENCH_DEFAULT_CHECKS;
+
+	uint8_t* List = NULL;
+
+	size_t ListSize = 0;
+
+	TOKEN_STORE Tokens = { 0 };
+
+	AC_AUTOMATON* Automaton = NULL;
+
+	TOKEN_STORE PathologicalTokens = { 0 };
+
+	AC_AUTOMATON* PathologicalAutomaton = NULL;
+
+	uint64_t* Latencies = NULL;
+
+	STRENGTH_BENCH_RESULT Result;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--tokens") == 0)
+		{
+			Valid = ((TokenCount = strtoull(Arguments[++Argument], NULL, 10)) > 0 && TokenCount <= UINT32_MAX);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--checks") == 0)
+		{
+			Valid = ((Checks = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool strength-bench [--tokens <n>] [--checks <n>]\n");
+
+			return(2);
+		}
+	}
+
+	if (CheckCases() != 0 || CheckFuzzyOverBudget() != 0)
+	{
+		fprintf(stderr, "Passwords were not estimated the way they should have been!\n");
+
+		return(1);
+	}
+
+	if ((List = ToolGenerateBlacklist((uint32_t)TokenCount, &ListSize)) == NULL ||
+		(Latencies = malloc((size_t)Checks * sizeof(uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		goto End;
+	}
+
+	if (LoadWithStrength(List, ListSize, &Tokens, &Automaton) == false)
+	{
+		goto End;
+	}
+
+	printf("\n%llu lines, %lu unique tokens, %s%d. %llu estimates of each kind, %d characters long.\n\n",
+		(unsigned long long)TokenCount,
+		(unsigned long)Tokens.TokenCount,
+		BLACKLIST_STRENGTH_DIRECTIVE,
+		STRENGTH_BENCH_MINIMUM,
+		(unsigned long long)Checks,
+		STRENGTH_MAX_PASSWORD_LENGTH);
+
+	printf("password            rejected  over budget  max work   mean ns    p50 ns    p99 ns  p99.9 ns    max ns\n");
+
+	for (uint32_t Kind = 0; Kind < STRENGTH_BENCH_KINDS; Kind++)
+	{
+		// Once to warm up, then the run that counts.
+		RunChecks(Automaton, &Tokens, Kind, Checks / 10 + 1, Latencies, &Result);
+
+		RunChecks(Automaton, &Tokens, Kind, Checks, Latencies, &Result);
+
+		PrintResult(gStrengthBenchKinds[Kind], &Result, Checks);
+	}
+
+	free(List);
+
+	if ((List = PathologicalList(&ListSize)) == NULL || LoadWithStrength(List, ListSize, &PathologicalTokens, &PathologicalAutomaton) == false)
+	{
+		goto End;
+	}
+
+	RunChecks(PathologicalAutomaton, &PathologicalTokens, 0, Checks / 10 + 1, Latencies, &Result);
+
+	RunChecks(PathologicalAutomaton, &PathologicalTokens, 0, Checks, Latencies, &Result);
+
+	PrintResult("aaaa, a..a list", &Result, Checks);
+
+	ExitCode = 0;
+
+End:
+
+	free(Latencies);
+
+	free(List);
+
+	AcDestroy(PathologicalAutomaton);
+
+	TokenStoreFree(&PathologicalTokens);
+
+	AcDestroy(Automaton);
+
+	TokenStoreFree(&Tokens);
+
+	return(ExitCode);
+}
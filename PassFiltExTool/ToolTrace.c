@@ -0,0 +1,467 @@
+/*
+ToolTrace.c
+
+The trace-bench command: what tracing costs PasswordFilter, with and without a trace session listening, next to what
+formatting a message for every call used to cost.
+
+Three things are timed, per event:
+
+  - TraceWrite while tracing is off. This is what every password pays when nobody is tracing, and should be a few
+    nanoseconds at most.
+
+  - Formatting a message into a 2048 character buffer, the way EventWriteStringW2 does, with vswprintf standing in for
+    _vsnwprintf_s. PasswordFilter used to do this twice for every password, listening or not.
+
+  - TraceWrite while tracing is on, from one thread, draining in between so that nothing is dropped, and then from several
+    at once, with TraceStartDrain's thread draining the rings as it does in the DLL, every TRACE_BENCH_DRAIN_MILLISECONDS
+    and whenever a ring passes TRACE_RING_HIGH_WATER. Those producers are paced, writing bursts of TRACE_BENCH_BURST events
+    at --rate events a second each for --seconds, since flat out they would only show how much faster a few threads can
+    write than any one thread can read, and a domain controller never sees passwords at that rate. Only the bursts are timed.
+
+The sink checks every event it gets back: its ID, its text, and that each producer's events arrive in the order they were
+written. Events the rings had no room for are counted by Trace.c, and every event written must come back or be counted as
+dropped. At a paced rate, no more than TRACE_BENCH_MAX_DROPPED_PER_THOUSAND in a thousand may be dropped. The command fails if
+any of that doesn't add up, so it doubles as a test of Trace.c on whatever machine it runs on.
+
+*/
+
+#include <stdarg.h>
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <wchar.h>
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#include "Trace.h"
+
+#define TRACE_BENCH_DEFAULT_EVENTS 1000000
+
+#define TRACE_BENCH_DEFAULT_THREADS 4
+
+#define TRACE_BENCH_MAX_THREADS 64
+
+// Events a second for each paced producer, and for how long.
+#define TRACE_BENCH_DEFAULT_RATE 50000
+
+#define TRACE_BENCH_DEFAULT_SECONDS 2
+
+// Events a paced producer writes at a time. Well under TRACE_RING_HIGH_WATER, even with a few producers sharing a ring.
+#define TRACE_BENCH_BURST 64
+
+// Same as TRACE_DRAIN_FREQUENCY in PassFiltEx.h.
+#define TRACE_BENCH_DRAIN_MILLISECONDS 1000
+
+#define TRACE_BENCH_MAX_DROPPED_PER_THOUSAND 1
+
+// Same as ETW_MAX_STRING_SIZE in PassFiltEx.h.
+#define TRACE_BENCH_MESSAGE_SIZE 2048
+
+static const uint16_t gTraceBenchText[] = { 'b', 'e', 'n', 'c', 'h', 'u', 's', 'e', 'r' };
+
+#define TRACE_BENCH_TEXT_LENGTH (sizeof(gTraceBenchText) / sizeof(gTraceBenchText[0]))
+
+// What the sink has seen. Values[0] of every event is the producer's index, and Values[1] its sequence number.
+typedef struct TRACE_CHECK
+{
+	uint64_t Received;
+
+	uint64_t Errors;
+
+	uint64_t NextSequence[TRACE_BENCH_MAX_THREADS];
+
+} TRACE_CHECK;
+
+typedef struct TRACE_PRODUCER
+{
+	uint32_t Index;
+
+	uint64_t Events;
+
+	uint64_t Rate;
+
+	volatile int32_t* Start;
+
+	// Spent in TraceWrite. Only read once the thread has been joined.
+	uint64_t Ticks;
+
+} TRACE_PRODUCER;
+
+static void CheckingSink(void* Context, const TRACE_EVENT* Event)
+{
+	TRACE_CHECK* Check = Context;
+
+	uint64_t Producer = Event->Values[0];
+
+	Check->Received++;
+
+	if (Event->Id != TraceEventPasswordChecked ||
+		Event->TextLength != TRACE_BENCH_TEXT_LENGTH ||
+		memcmp(Event->Text, gTraceBenchText, sizeof(gTraceBenchText)) != 0 ||
+		Producer >= TRACE_BENCH_MAX_THREADS ||
+		Event->Values[1] < Check->NextSequence[Producer])
+	{
+		Check->Errors++;
+
+		return;
+	}
+
+	// Dropped events leave gaps, but a producer's events never come back out of order.
+	Check->NextSequence[Producer] = Event->Values[1] + 1;
+}
+
+static void DiscardingSink(void* Context, const TRACE_EVENT* Event)
+{
+	(void)Context;
+
+	(void)Event;
+}
+
+// Formats the way EventWriteStringW2 does, into a buffer of the same size. Returns the length, so the work can't be optimized away.
+static int FormatMessage2048(const wchar_t* Format, ...)
+{
+	wchar_t FormattedString[TRACE_BENCH_MESSAGE_SIZE];
+
+	va_list ArgPointer;
+
+	va_start(ArgPointer, Format);
+
+	int Length = vswprintf(FormattedString, TRACE_BENCH_MESSAGE_SIZE, Format, ArgPointer);
+
+	va_end(ArgPointer);
+
+	return(Length);
+}
+
+static double TicksToNanosecondsPerEvent(uint64_t Ticks, uint64_t Events)
+{
+	return(ToolTicksToNanoseconds(Ticks) / (double)((Events > 0) ? Events : 1));
+}
+
+static uint32_t TraceProducer(void* Argument)
+{
+	TRACE_PRODUCER* Producer = Argument;
+
+	uint64_t Values[TRACE_VALUE_COUNT] = { Producer->Index, 0, 0, 0 };
+
+	const uint64_t Frequency = PlatformTimestampFrequency();
+
+	while (PlatformLoad(Producer->Start) == 0)
+	{
+		PlatformSleep(0);
+	}
+
+	const uint64_t BurstTicks = (Frequency * TRACE_BENCH_BURST) / Producer->Rate;
+
+	uint64_t Ticks = 0;
+
+	uint64_t Due = PlatformTimestamp();
+
+	for (uint64_t Sequence = 0; Sequence < Producer->Events; )
+	{
+		uint64_t StartTime = PlatformTimestamp();
+
+		for (uint32_t Burst = 0; Burst < TRACE_BENCH_BURST && Sequence < Producer->Events; Burst++, Sequence++)
+		{
+			Values[1] = Sequence;
+
+			TraceWrite(TraceEventPasswordChecked, Values, gTraceBenchText, TRACE_BENCH_TEXT_LENGTH);
+		}
+
+		uint64_t EndTime = PlatformTimestamp();
+
+		Ticks += EndTime - StartTime;
+
+		// A late burst is made up for by starting the next one straight away, but no more than that, so that a producer held
+		// up by the scheduler doesn't then write several at once.
+		Due += BurstTicks;
+
+		Due = (Due + BurstTicks < EndTime) ? EndTime - BurstTicks : Due;
+
+		while (PlatformTimestamp() < Due)
+		{
+			PlatformSleep(1);
+		}
+	}
+
+	Producer->Ticks = Ticks;
+
+	return(0);
+}
+
+// Has ThreadCount threads write Events events each, Rate a second, while Trace.c's drain thread drains. Returns false if any
+// event went missing or came back wrong, or too many were dropped.
+static bool RunProducers(uint32_t ThreadCount, uint64_t Events, uint64_t Rate)
+{
+	bool Result = false;
+
+	TRACE_PRODUCER Producers[TRACE_BENCH_MAX_THREADS];
+
+	PLATFORM_THREAD* Threads[TRACE_BENCH_MAX_THREADS] = { 0 };
+
+	TRACE_CHECK* Check = NULL;
+
+	volatile int32_t Start = 0;
+
+	uint32_t Started = 0;
+
+	if ((Check = calloc(1, sizeof(TRACE_CHECK))) == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(false);
+	}
+
+	// Whatever is still in the rings from before belongs to somebody else.
+	TraceDrain(DiscardingSink, NULL);
+
+	uint64_t DroppedBefore = TraceDroppedEvents();
+
+	if (TraceStartDrain(CheckingSink, Check, TRACE_BENCH_DRAIN_MILLISECONDS) == false)
+	{
+		fprintf(stderr, "Unable to start the drain thread!\n");
+
+		free(Check);
+
+		return(false);
+	}
+
+	for (Started = 0; Started < ThreadCount; Started++)
+	{
+		Producers[Started].Index = Started;
+
+		Producers[Started].Events = Events;
+
+		Producers[Started].Rate = Rate;
+
+		Producers[Started].Start = &Start;
+
+		Producers[Started].Ticks = 0;
+
+		if ((Threads[Started] = PlatformStartThread(TraceProducer, &Producers[Started])) == NULL)
+		{
+			fprintf(stderr, "Unable to start producer thread %lu!\n", (unsigned long)Started);
+
+			break;
+		}
+	}
+
+	double StartTime = ToolNowInSeconds();
+
+	PlatformStore(&Start, 1);
+
+	for (uint32_t Index = 0; Index < Started; Index++)
+	{
+		PlatformJoinThread(Threads[Index]);
+	}
+
+	double Elapsed = ToolNowInSeconds() - StartTime;
+
+	// Hands over whatever the producers wrote last. Check is the drain thread's until then.
+	TraceStopDrain();
+
+	if (Started < ThreadCount)
+	{
+		goto End;
+	}
+
+	uint64_t Written = (uint64_t)ThreadCount * Events;
+
+	uint64_t Dropped = TraceDroppedEvents() - DroppedBefore;
+
+	uint64_t ProducerTicks = 0;
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		ProducerTicks += Producers[Index].Ticks;
+	}
+
+	printf("%7lu %14llu %14llu %12llu %14.1f %14.0f\n",
+		(unsigned long)ThreadCount,
+		(unsigned long long)Written,
+		(unsigned long long)Check->Received,
+		(unsigned long long)Dropped,
+		TicksToNanosecondsPerEvent(ProducerTicks, Written),
+		(double)Written / Elapsed);
+
+	if (Check->Errors > 0 || Check->Received + Dropped != Written)
+	{
+		fprintf(stderr, "Trace events went missing or came back wrong: %llu written, %llu received, %llu dropped, %llu bad.\n",
+			(unsigned long long)Written,
+			(unsigned long long)Check->Received,
+			(unsigned long long)Dropped,
+			(unsigned long long)Check->Errors);
+
+		goto End;
+	}
+
+	if (Dropped * 1000 > Written * TRACE_BENCH_MAX_DROPPED_PER_THOUSAND)
+	{
+		fprintf(stderr, "The drain thread fell behind: %llu of %llu events were dropped, more than %d in a thousand.\n",
+			(unsigned long long)Dropped,
+			(unsigned long long)Written,
+			TRACE_BENCH_MAX_DROPPED_PER_THOUSAND);
+
+		goto End;
+	}
+
+	Result = true;
+
+End:
+
+	free(Check);
+
+	return(Result);
+}
+
+int CommandTraceBench(int ArgumentCount, char** Arguments)
+{
+	uint64_t Events = TRACE_BENCH_DEFAULT_EVENTS;
+
+	uint32_t MaxThreads = TRACE_BENCH_DEFAULT_THREADS;
+
+	uint64_t Rate = TRACE_BENCH_DEFAULT_RATE;
+
+	uint64_t Seconds = TRACE_BENCH_DEFAULT_SECONDS;
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--events") == 0)
+		{
+			Valid = ((Events = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--threads") == 0)
+		{
+			Valid = ((MaxThreads = (uint32_t)strtoul(Arguments[++Argument], NULL, 10)) > 0 && MaxThreads <= TRACE_BENCH_MAX_THREADS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--rate") == 0)
+		{
+			Valid = ((Rate = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--seconds") == 0)
+		{
+			Valid = ((Seconds = strtoull(Arguments[++Argument], NULL, 10)) > 0);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool trace-bench [--events <n>] [--threads <1-%d>] [--rate <n>] [--seconds <n>]\n", TRACE_BENCH_MAX_THREADS);
+
+			return(2);
+		}
+	}
+
+	uint64_t Values[TRACE_VALUE_COUNT] = { 0, 0, 0, 0 };
+
+	// Off. The rings haven't even been allocated yet, just as in a DLL that has never been traced.
+	uint64_t StartTime = PlatformTimestamp();
+
+	for (uint64_t Event = 0; Event < Events; Event++)
+	{
+		Values[1] = Event;
+
+		TraceWrite(TraceEventPasswordChecked, Values, gTraceBenchText, TRACE_BENCH_TEXT_LENGTH);
+	}
+
+	double DisabledNanoseconds = TicksToNanosecondsPerEvent(PlatformTimestamp() - StartTime, Events);
+
+	// The two messages PasswordFilter used to format for every password.
+	uint64_t Characters = 0;
+
+	StartTime = PlatformTimestamp();
+
+	for (uint64_t Event = 0; Event < Events; Event++)
+	{
+		Characters += (uint64_t)FormatMessage2048(L"[%ls:%ls@%d] SET password for user %ls.", L"PassFiltEx.c", L"PasswordFilter", 386, L"benchuser");
+
+		Characters += (uint64_t)FormatMessage2048(L"[%ls:%ls@%d] Finished in %llu microseconds.", L"PassFiltEx.c", L"PasswordFilter", 439, (unsigned long long)Event);
+	}
+
+	double FormattedNanoseconds = TicksToNanosecondsPerEvent(PlatformTimestamp() - StartTime, Events);
+
+	TraceSetEnabled(true);
+
+	if (TraceEnabled() == false)
+	{
+		fprintf(stderr, "Unable to allocate the trace rings!\n");
+
+		return(1);
+	}
+
+	// On, from one thread, draining before the ring can fill up so that nothing is dropped.
+	TRACE_CHECK* Check = calloc(1, sizeof(TRACE_CHECK));
+
+	if (Check == NULL)
+	{
+		fprintf(stderr, "Out of memory!\n");
+
+		return(1);
+	}
+
+	uint64_t WriteTicks = 0;
+
+	Values[0] = 0;
+
+	for (uint64_t Event = 0; Event < Events; )
+	{
+		StartTime = PlatformTimestamp();
+
+		for (uint32_t Batch = 0; Batch < TRACE_RING_SIZE && Event < Events; Batch++, Event++)
+		{
+			Values[1] = Event;
+
+			TraceWrite(TraceEventPasswordChecked, Values, gTraceBenchText, TRACE_BENCH_TEXT_LENGTH);
+		}
+
+		WriteTicks += PlatformTimestamp() - StartTime;
+
+		TraceDrain(CheckingSink, Check);
+	}
+
+	double EnabledNanoseconds = TicksToNanosecondsPerEvent(WriteTicks, Events);
+
+	bool SingleThreadOk = (Check->Received == Events && Check->Errors == 0 && TraceDroppedEvents() == 0);
+
+	free(Check);
+
+	printf("Per event, %llu events (%llu characters formatted):\n\n", (unsigned long long)Events, (unsigned long long)Characters);
+
+	printf("  TraceWrite, tracing off:           %10.1f ns\n", DisabledNanoseconds);
+
+	printf("  Two 2048-character messages:       %10.1f ns\n", FormattedNanoseconds);
+
+	printf("  TraceWrite, tracing on, 1 thread:  %10.1f ns\n\n", EnabledNanoseconds);
+
+	if (SingleThreadOk == false)
+	{
+		fprintf(stderr, "Trace events went missing or came back wrong from a single thread!\n");
+
+		return(1);
+	}
+
+	printf("Paced at %llu events a second per thread, for %llu seconds:\n\n", (unsigned long long)Rate, (unsigned long long)Seconds);
+
+	printf("%7s %14s %14s %12s %14s %14s\n", "Threads", "Written", "Received", "Dropped", "ns/event", "Events/s");
+
+	for (uint32_t ThreadCount = 1; ThreadCount <= MaxThreads; ThreadCount *= 2)
+	{
+		if (RunProducers(ThreadCount, Rate * Seconds, Rate) == false)
+		{
+			return(1);
+		}
+	}
+
+	return(0);
+}
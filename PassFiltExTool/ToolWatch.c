@@ -0,0 +1,359 @@
+/*
+ToolWatch.c
+
+The watch-check command: proof that the blacklist is reloaded soon after it changes, only once however it is written, and
+never while it doesn't change (see FileWatch.c).
+
+A reload thread does what BlacklistThreadProc does, for one test blacklist in the directory given (the current one by
+default): it waits on a FILE_WATCH, and every time the file is due, opens and loads it, and counts that. Then:
+
+  - Nothing happens for a while, except that another file in the same directory is written to over and over. The test
+    blacklist must not be opened once.
+
+  - The test blacklist is rewritten, in place and slowly, the way an editor or a copy over the network might: a few chunks,
+    with pauses between them shorter than the debounce. Every round must be reloaded exactly once, with every line of that
+    round, never with part of them. How long it took from the file being closed to the new blacklist being loaded is
+    printed for each round.
+
+With --debounce-ms 0, the reload thread reads the file as soon as anything happens to it, and the rounds should fail: that
+is what the debounce is for. The command also fails if the directory can't be watched at all, as FileWatch would then be
+polling.
+
+*/
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "FileWatch.h"
+
+#include "PassFiltExTool.h"
+
+#include "Platform.h"
+
+#define WATCH_CHECK_FILE "PassFiltExWatchCheck.txt"
+
+#define WATCH_CHECK_OTHER_FILE "PassFiltExWatchCheck.tmp"
+
+#define WATCH_CHECK_DEFAULT_ROUNDS 10
+
+#define WATCH_CHECK_DEFAULT_DEBOUNCE 250
+
+#define WATCH_CHECK_IDLE_MILLISECONDS 2000
+
+// The same as BLACKLIST_THREAD_RUN_FREQUENCY. Only used if the watch stops working halfway through.
+#define WATCH_CHECK_POLL_MILLISECONDS 60000
+
+#define WATCH_CHECK_CHUNKS 4
+
+#define WATCH_CHECK_LINES 20000
+
+// How long a round waits for its reload before giving up on it.
+#define WATCH_CHECK_TIMEOUT_MILLISECONDS 5000
+
+#define WATCH_CHECK_MAX_ROUNDS 1000
+
+#define WATCH_CHECK_MAX_PATH 1024
+
+typedef struct WATCH_CHECK
+{
+	char Path[WATCH_CHECK_MAX_PATH];
+
+	const char* Directory;
+
+	uint32_t DebounceMilliseconds;
+
+	bool Watching;
+
+	volatile int32_t Started;
+
+	volatile int32_t Stop;
+
+	// Written by the reload thread before Loads goes up, so they are current whenever Loads is read.
+	volatile int32_t Loads;
+
+	uint32_t LastTokenCount;
+
+	uint64_t LastLoadedAt;
+
+	uint64_t Notifications;
+
+} WATCH_CHECK;
+
+// Does what BlacklistThreadProc does with the blacklist, and nothing else.
+static uint32_t WatchCheckReloader(void* Argument)
+{
+	WATCH_CHECK* Check = Argument;
+
+	static const char* const FileNames[] = { WATCH_CHECK_FILE };
+
+	FILE_WATCH Watch;
+
+	uint32_t Due = 1;
+
+	Check->Watching = FileWatchStart(&Watch, Check->Directory, FileNames, 1, Check->DebounceMilliseconds, WATCH_CHECK_POLL_MILLISECONDS);
+
+	PlatformStore(&Check->Started, 1);
+
+	while (PlatformLoad(&Check->Stop) == 0)
+	{
+		if (Due != 0)
+		{
+			TOKEN_STORE Tokens = { 0 };
+
+			AC_AUTOMATON* Automaton = NULL;
+
+			TOOL_TEXT_STATS Stats = { 0 };
+
+			if (ToolLoadBlacklistText(Check->Path, &Tokens, &Automaton, &Stats))
+			{
+				Check->LastTokenCount = Tokens.TokenCount;
+			}
+			else
+			{
+				Check->LastTokenCount = 0;
+			}
+
+			Check->LastLoadedAt = PlatformTimestamp();
+
+			Check->Notifications = Watch.Notifications;
+
+			PlatformIncrement(&Check->Loads);
+
+			AcDestroy(Automaton);
+
+			TokenStoreFree(&Tokens);
+		}
+
+		// Short, so that the command doesn't have to wait long for this thread to notice Stop.
+		Due = FileWatchWait(&Watch, 100);
+	}
+
+	FileWatchStop(&Watch);
+
+	return(0);
+}
+
+// Writes LineCount lines for Round in WATCH_CHECK_CHUNKS pieces, PauseMilliseconds apart. Returns when the file was closed, or 0.
+static uint64_t WriteSlowly(const char* Path, uint32_t Round, uint32_t LineCount, uint32_t PauseMilliseconds)
+{
+	FILE* File = NULL;
+
+	if ((File = fopen(Path, "wb")) == NULL)
+	{
+		return(0);
+	}
+
+	for (uint32_t Line = 0; Line < LineCount; Line++)
+	{
+		fprintf(File, "watch%04lucheck%06lu\n", (unsigned long)Round, (unsigned long)Line);
+
+		if ((Line + 1) % (LineCount / WATCH_CHECK_CHUNKS) == 0 && Line + 1 < LineCount)
+		{
+			fflush(File);
+
+			PlatformSleep(PauseMilliseconds);
+		}
+	}
+
+	if (fclose(File) != 0)
+	{
+		return(0);
+	}
+
+	return(PlatformTimestamp());
+}
+
+// Waits up to Milliseconds for Loads to go past Loads. Returns the new count.
+static int32_t WaitForLoads(WATCH_CHECK* Check, int32_t Loads, uint32_t Milliseconds)
+{
+	uint64_t Start = PlatformTimestamp();
+
+	while (PlatformLoad(&Check->Loads) == Loads && PlatformElapsedMicroseconds(Start, PlatformTimestamp()) < (uint64_t)Milliseconds * 1000)
+	{
+		PlatformSleep(1);
+	}
+
+	return(PlatformLoad(&Check->Loads));
+}
+
+int CommandWatchCheck(int ArgumentCount, char** Arguments)
+{
+	int ExitCode = 1;
+
+	uint64_t Rounds = WATCH_CHECK_DEFAULT_ROUNDS;
+
+	uint64_t Debounce = WATCH_CHECK_DEFAULT_DEBOUNCE;
+
+	char OtherPath[WATCH_CHECK_MAX_PATH];
+
+	uint64_t Latencies[WATCH_CHECK_MAX_ROUNDS];
+
+	TOOL_LATENCY_SUMMARY Latency = { 0 };
+
+	uint64_t Wrong = 0;
+
+	PLATFORM_THREAD* Thread = NULL;
+
+	static WATCH_CHECK Check;
+
+	Check.Directory = ".";
+
+	for (int Argument = 0; Argument < ArgumentCount; Argument++)
+	{
+		bool Valid = (Argument + 1 < ArgumentCount);
+
+		if (Valid && strcmp(Arguments[Argument], "--directory") == 0)
+		{
+			Check.Directory = Arguments[++Argument];
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--rounds") == 0)
+		{
+			Valid = ((Rounds = strtoull(Arguments[++Argument], NULL, 10)) > 0 && Rounds <= WATCH_CHECK_MAX_ROUNDS);
+		}
+		else if (Valid && strcmp(Arguments[Argument], "--debounce-ms") == 0)
+		{
+			Valid = ((Debounce = strtoull(Arguments[++Argument], NULL, 10)) <= 10000);
+		}
+		else
+		{
+			Valid = false;
+		}
+
+		if (Valid == false)
+		{
+			fprintf(stderr, "Usage: PassFiltExTool watch-check [--directory <directory>] [--rounds <1-%d>] [--debounce-ms <0-10000>]\n", WATCH_CHECK_MAX_ROUNDS);
+
+			return(2);
+		}
+	}
+
+	Check.DebounceMilliseconds = (uint32_t)Debounce;
+
+	snprintf(Check.Path, sizeof(Check.Path), "%s/%s", Check.Directory, WATCH_CHECK_FILE);
+
+	snprintf(OtherPath, sizeof(OtherPath), "%s/%s", Check.Directory, WATCH_CHECK_OTHER_FILE);
+
+	if (WriteSlowly(Check.Path, 0, WATCH_CHECK_LINES, 0) == 0)
+	{
+		fprintf(stderr, "Unable to write %s!\n", Check.Path);
+
+		return(1);
+	}
+
+	if ((Thread = PlatformStartThread(WatchCheckReloader, &Check)) == NULL)
+	{
+		fprintf(stderr, "Unable to start the reload thread!\n");
+
+		goto End;
+	}
+
+	while (PlatformLoad(&Check.Started) == 0)
+	{
+		PlatformSleep(1);
+	}
+
+	if (Check.Watching == false)
+	{
+		fprintf(stderr, "Unable to watch %s for changes! PassFiltEx would be checking the files every %d seconds instead.\n", Check.Directory, WATCH_CHECK_POLL_MILLISECONDS / 1000);
+
+		goto End;
+	}
+
+	int32_t Loads = WaitForLoads(&Check, 0, WATCH_CHECK_TIMEOUT_MILLISECONDS);
+
+	printf("Watching %s, with a debounce of %lu ms. First load: %lu tokens.\n\n", Check.Path, (unsigned long)Debounce, (unsigned long)Check.LastTokenCount);
+
+	// Other files in the directory changing must not make the blacklist be opened.
+	for (uint32_t Waited = 0; Waited < WATCH_CHECK_IDLE_MILLISECONDS; Waited += 100)
+	{
+		if (ToolWriteFile(OtherPath, "noise\n", 6) == false)
+		{
+			fprintf(stderr, "Unable to write %s!\n", OtherPath);
+
+			goto End;
+		}
+
+		PlatformSleep(100);
+	}
+
+	int32_t IdleLoads = PlatformLoad(&Check.Loads) - Loads;
+
+	printf("Idle for %d ms while %s was written %d times: %ld blacklist loads.\n\n", WATCH_CHECK_IDLE_MILLISECONDS, WATCH_CHECK_OTHER_FILE, WATCH_CHECK_IDLE_MILLISECONDS / 100, (long)IdleLoads);
+
+	if (IdleLoads != 0)
+	{
+		Wrong++;
+	}
+
+	Loads = PlatformLoad(&Check.Loads);
+
+	printf("round     lines  loads  loaded  latency ms\n");
+
+	for (uint32_t Round = 1; Round <= Rounds; Round++)
+	{
+		uint32_t LineCount = WATCH_CHECK_LINES + Round;
+
+		// Less than the debounce, so that the pauses alone never make the file due. Without a debounce, there are still pauses.
+		uint32_t Pause = (Debounce >= 40) ? (uint32_t)(Debounce / 2) : 20;
+
+		uint64_t ClosedAt = WriteSlowly(Check.Path, Round, LineCount, Pause);
+
+		if (ClosedAt == 0)
+		{
+			fprintf(stderr, "Unable to write %s!\n", Check.Path);
+
+			goto End;
+		}
+
+		bool Loaded = (WaitForLoads(&Check, Loads, WATCH_CHECK_TIMEOUT_MILLISECONDS) != Loads);
+
+		uint64_t LoadedAt = Check.LastLoadedAt;
+
+		// Anything more than one load per round would come within a debounce or two of the first.
+		PlatformSleep((uint32_t)(Debounce * 2) + 100);
+
+		int32_t RoundLoads = PlatformLoad(&Check.Loads) - Loads;
+
+		Loads += RoundLoads;
+
+		// A load that started before the file was closed read part of it.
+		Latencies[Round - 1] = (Loaded && LoadedAt > ClosedAt) ? LoadedAt - ClosedAt : 0;
+
+		// The last load of the round has to have had every line, and there has to have been only one.
+		bool Right = (RoundLoads == 1 && Check.LastTokenCount == LineCount && Latencies[Round - 1] != 0);
+
+		printf("%5lu  %8lu  %5ld  %6lu  %10.1f%s\n", (unsigned long)Round, (unsigned long)LineCount, (long)RoundLoads, (unsigned long)Check.LastTokenCount, ToolTicksToNanoseconds(Latencies[Round - 1]) / 1e6, Right ? "" : "  WRONG");
+
+		Wrong += (Right == false);
+	}
+
+	ToolSummarizeLatencies(Latencies, Rounds, &Latency);
+
+	printf("\nLatency from close to loaded: min %.1f ms, median %.1f ms, max %.1f ms. %llu change notifications in all.\n",
+		(double)Latency.Min / 1e6,
+		(double)Latency.P50 / 1e6,
+		(double)Latency.Max / 1e6,
+		(unsigned long long)Check.Notifications);
+
+	printf("%llu wrong.\n", (unsigned long long)Wrong);
+
+	ExitCode = (Wrong == 0) ? 0 : 1;
+
+End:
+
+	if (Thread != NULL)
+	{
+		PlatformStore(&Check.Stop, 1);
+
+		PlatformJoinThread(Thread);
+	}
+
+	remove(Check.Path);
+
+	remove(OtherPath);
+
+	return(ExitCode);
+}
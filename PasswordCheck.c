@@ -0,0 +1,237 @@
+/*
+PasswordCheck.c
+
+The verdict on one password, from the moment LSA hands it over to the moment PasswordFilter answers, minus the logging.
+
+This used to live inside PasswordFilter. It is here so that PassFiltExTool bench can time exactly what a domain controller
+does for each password change, heap allocation and hashing included, on any machine, and so that a change to any of it
+shows up in those numbers before the DLL is rolled out.
+
+The steps, in order:
+
+  - The password is copied, because it has to be folded and LSA's buffer is not ours to change. The copy goes into a
+    locked buffer from a SCRATCH_POOL (see ScratchPool.c), so there is no heap call for it, and is wiped as it is handed back.
+
+  - If there is a breach index, the NT hash of the password as typed is looked up in it.
+
+  - The copy is folded (see Normalize.c), has the blacklist's substitutions made, and is scanned for blacklist tokens
+    (see Blacklist.c), tokens appended since the blacklist was last built (see BlacklistDelta.c) and, in the same pass,
+    for the parts of the user's account name and full name (see NameMatch.c).
+
+  - If the blacklist has a !distance and no token was found as it is, the copy is searched again for tokens spelled with
+    typos (see FuzzyMatch.c), in the overlay too, within one budget. That search costs more, so it only happens to passwords
+    that got through the first one.
+
+  - If the blacklist has a !strength, a password that got through all of that has its guesses estimated (see Strength.c), from
+    the password as typed and, for the blacklist's tokens, the copy. That costs more again, and it is bounded the same way.
+    A password the near match search ran out of budget on is estimated as well.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "Blacklist.h"
+
+#include "FuzzyMatch.h"
+
+#include "Md4.h"
+
+#include "NameMatch.h"
+
+#include "Normalize.h"
+
+#include "PasswordCheck.h"
+
+#include "ScratchPool.h"
+
+#include "Strength.h"
+
+/*
+Automaton, Overlay and Breach are optional; leave any of them NULL to skip that check. Overlay must have been loaded on top of
+Automaton (see BlacklistDeltaLoad). Scratch may be NULL too, and the copy of the
+password then comes from the heap, as it always used to. AccountName and FullName may be NULL, and are then not looked
+for. When the verdict is PasswordBlacklisted or PasswordNearlyBlacklisted,
+*MatchedPattern is the pattern ID of the token that matched (see BlacklistDeltaToken), and it is AC_NO_PATTERN otherwise.
+
+*/
+PASSWORD_VERDICT PasswordCheck(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const BREACH_INDEX* Breach, SCRATCH_POOL* Scratch, const PLATFORM_STRING* Password, const PLATFORM_STRING* AccountName, const PLATFORM_STRING* FullName, uint32_t* MatchedPattern)
+{
+	PASSWORD_VERDICT Verdict = PasswordAccepted;
+
+	// On the stack, like everything else the name check needs, so that it never allocates.
+	NAME_PATTERNS Names;
+
+	uint16_t* PasswordCopy = NULL;
+
+	int32_t ScratchSlot = SCRATCH_HEAP_SLOT;
+
+	size_t PasswordLength = 0;
+
+	bool Together = false;
+
+	*MatchedPattern = AC_NO_PATTERN;
+
+	// One extra character so that the copy is always terminated. Scratch buffers are all zeros to begin with.
+	if ((PasswordCopy = ScratchAcquire(Scratch, (size_t)Password->Length + sizeof(uint16_t), &ScratchSlot)) == NULL)
+	{
+		return(PasswordOutOfMemory);
+	}
+
+	memcpy(PasswordCopy, Password->Buffer, Password->Length);
+
+	// Breached passwords are matched exactly as they were typed, so this happens before anything is folded.
+	if (Breach != NULL)
+	{
+		uint8_t PasswordHash[MD4_DIGEST_SIZE] = { 0 };
+
+		NtlmHash(Password->Buffer, Password->Length / sizeof(uint16_t), PasswordHash);
+
+		bool Breached = BreachIndexContains(Breach, PasswordHash);
+
+		// An NT hash is as good as the password itself to an attacker.
+		SecureWipe(PasswordHash, sizeof(PasswordHash));
+
+		if (Breached)
+		{
+			Verdict = PasswordBreached;
+
+			goto End;
+		}
+	}
+
+	// The blacklist has always seen the password only up to its first null character.
+	while (PasswordLength < Password->Length / sizeof(uint16_t) && PasswordCopy[PasswordLength] != 0)
+	{
+		PasswordLength++;
+	}
+
+	// Every character, the last one included. The first versions stopped one short, so "PASSWORD" got past a "password" token.
+	NormalizeString(PasswordCopy, PasswordLength);
+
+	BlacklistCanonicalize(Automaton, PasswordCopy, PasswordLength);
+
+	NamePatternsBuild(&Names, Automaton, AccountName, FullName);
+
+	if ((*MatchedPattern = BlacklistFindToken(Automaton, Overlay, &Names, PasswordCopy, PasswordLength, &Together)) == NAME_PATTERN)
+	{
+		*MatchedPattern = AC_NO_PATTERN;
+
+		Verdict = PasswordContainsName;
+
+		goto End;
+	}
+
+	if (*MatchedPattern != AC_NO_PATTERN)
+	{
+		Verdict = Together ? PasswordBlacklistedTogether : PasswordBlacklisted;
+
+		goto End;
+	}
+
+	if (Automaton != NULL && Automaton->EditDistance > 0)
+	{
+		FUZZY_STATUS Status = FuzzyNotFound;
+
+		uint64_t Visited = 0;
+
+		*MatchedPattern = FuzzyFindToken(Automaton, PasswordCopy, PasswordLength, Automaton->EditDistance, FUZZY_STATE_BUDGET, &Status, &Visited);
+
+		if (*MatchedPattern == AC_NO_PATTERN && Status == FuzzyNotFound && Overlay != NULL)
+		{
+			*MatchedPattern = FuzzyFindToken(Overlay, PasswordCopy, PasswordLength, Automaton->EditDistance, FUZZY_STATE_BUDGET - Visited, &Status, NULL);
+		}
+
+		if (*MatchedPattern != AC_NO_PATTERN)
+		{
+			Verdict = PasswordNearlyBlacklisted;
+		}
+		else if (Status == FuzzyOverBudget)
+		{
+			Verdict = PasswordAcceptedOverBudget;
+		}
+	}
+
+	// A password the near match search gave up on is estimated too, or padding one out to use up that budget would skip this.
+	if ((Verdict == PasswordAccepted || Verdict == PasswordAcceptedOverBudget) && Automaton != NULL && Automaton->Strength != NULL)
+	{
+		double Guesses = 0.0;
+
+		STRENGTH_STATUS Status = StrengthEstimate(Automaton, Overlay, Password->Buffer, PasswordCopy, PasswordLength, &Guesses, NULL);
+
+		// Cut short, the estimate can only be too high, so a password that is still under the threshold is rejected all the same.
+		// Otherwise the verdict that says the near match search was cut short wins, since that one left more unchecked.
+		if (Status != StrengthTooLong && Guesses < Automaton->Strength->Threshold)
+		{
+			Verdict = PasswordTooGuessable;
+		}
+		else if (Status == StrengthOverBudget && Verdict == PasswordAccepted)
+		{
+			Verdict = PasswordStrengthOverBudget;
+		}
+	}
+
+End:
+
+	ScratchRelease(Scratch, PasswordCopy, Password->Length, ScratchSlot);
+
+	return(Verdict);
+}
+
+const char* PasswordVerdictString(PASSWORD_VERDICT Verdict)
+{
+	switch (Verdict)
+	{
+		case PasswordAccepted:
+		{
+			return("accepted");
+		}
+		case PasswordBreached:
+		{
+			return("rejected, breached");
+		}
+		case PasswordBlacklisted:
+		{
+			return("rejected, blacklisted");
+		}
+		case PasswordOutOfMemory:
+		{
+			return("rejected, out of memory");
+		}
+		case PasswordNearlyBlacklisted:
+		{
+			return("rejected, nearly blacklisted");
+		}
+		case PasswordAcceptedOverBudget:
+		{
+			return("accepted, near match search over budget");
+		}
+		case PasswordContainsName:
+		{
+			return("rejected, contains the user's name");
+		}
+		case PasswordBlacklistedTogether:
+		{
+			return("rejected, blacklisted tokens together");
+		}
+		case PasswordTooGuessable:
+		{
+			return("rejected, too easy to guess");
+		}
+		case PasswordStrengthOverBudget:
+		{
+			return("accepted, strength estimate over budget");
+		}
+		default:
+		{
+			return("unknown verdict");
+		}
+	}
+}
+
+// Anything not known to be acceptable is a rejection, the way PasswordFilter treats it.
+bool PasswordVerdictRejects(PASSWORD_VERDICT Verdict)
+{
+	return(Verdict != PasswordAccepted && Verdict != PasswordAcceptedOverBudget && Verdict != PasswordStrengthOverBudget);
+}
@@ -0,0 +1,58 @@
+// Please read PasswordCheck.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "BreachIndex.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+typedef enum PASSWORD_VERDICT
+{
+	PasswordAccepted,
+
+	PasswordBreached,
+
+	PasswordBlacklisted,
+
+	// The password could not be checked, and must be rejected.
+	PasswordOutOfMemory,
+
+	// Part of the password is within the blacklist's !distance of a token.
+	PasswordNearlyBlacklisted,
+
+	// Accepted, but only on the exact match: the search for near matches ran out of budget.
+	PasswordAcceptedOverBudget,
+
+	// A part of the user's account name or full name makes up at least half of the password.
+	PasswordContainsName,
+
+	// Two or more blacklist tokens together make up the blacklist's !combined share of the password.
+	PasswordBlacklistedTogether,
+
+	// The password would take fewer guesses than the blacklist's !strength asks for. See Strength.c.
+	PasswordTooGuessable,
+
+	// Accepted, but the strength estimate ran out of budget before it was done, so it may have been too generous.
+	PasswordStrengthOverBudget
+
+} PASSWORD_VERDICT;
+
+PASSWORD_VERDICT PasswordCheck(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const BREACH_INDEX* Breach, SCRATCH_POOL* Scratch, const PLATFORM_STRING* Password, const PLATFORM_STRING* AccountName, const PLATFORM_STRING* FullName, uint32_t* MatchedPattern);
+
+const char* PasswordVerdictString(PASSWORD_VERDICT Verdict);
+
+bool PasswordVerdictRejects(PASSWORD_VERDICT Verdict);
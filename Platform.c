@@ -0,0 +1,975 @@
+/*
+Platform.c
+
+The few operating system services that the platform-neutral parts of the password filter need: memory, including memory
+that is never paged out, atomic counters, sleeping, threads and how many processors there are to run them, events for them
+to wait on, a clock and change notifications for the files in a directory.
+
+Everything else in the filter either talks to Windows directly (PassFiltEx.c: LSA, ETW, files and threads) or doesn't
+need the operating system at all. Keeping this list short and in one place is what lets PassFiltExTool build and run the
+exact code that judges passwords in lsass on any machine with a C11 compiler, including the bench command, which times it.
+
+On Windows, memory comes from the process heap, as it always has inside the DLL. Elsewhere it comes from calloc. Every
+allocation is counted, so that PassFiltExTool alloc-check can prove that judging a password doesn't make any.
+The atomics are the Interlocked functions on Windows and the GCC/Clang __atomic builtins everywhere else; all of them are
+full barriers, which is what SnapshotGuard.c relies on.
+
+Directory watches are ReadDirectoryChangesW on Windows and inotify on Linux. Both only say that something happened to a file
+with one of the names asked about; FileWatch.c decides when that file has settled down enough to be read. Anywhere else,
+PlatformWatchStart fails, and FileWatch.c goes back to looking at the files every so often.
+
+This is the one source file shared by the DLL and the tool that is not platform-neutral C, so that nothing else has to be.
+
+*/
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+
+#pragma warning(push, 0)
+
+#include <Windows.h>
+
+#pragma warning(pop)
+
+#else
+
+// For clock_gettime and nanosleep.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <sys/mman.h>
+
+#include <time.h>
+
+#include <unistd.h>
+
+#ifdef __linux__
+
+#include <poll.h>
+
+#include <sys/inotify.h>
+
+#endif
+
+#endif
+
+#include "Platform.h"
+
+// Notifications are read this many bytes at a time. Even a busy System32 seldom has more than this waiting between two waits.
+#define PLATFORM_WATCH_BUFFER_SIZE (64 * 1024)
+
+struct PLATFORM_THREAD
+{
+#ifdef _WIN32
+
+	HANDLE Handle;
+
+#else
+
+	pthread_t Handle;
+
+#endif
+
+	PLATFORM_THREAD_ROUTINE Routine;
+
+	void* Argument;
+};
+
+struct PLATFORM_EVENT
+{
+#ifdef _WIN32
+
+	HANDLE Handle;
+
+#else
+
+	pthread_mutex_t Mutex;
+
+	pthread_cond_t Condition;
+
+	bool Signaled;
+
+#endif
+};
+
+struct PLATFORM_WATCH
+{
+#ifdef _WIN32
+
+	HANDLE Directory;
+
+	OVERLAPPED Overlapped;
+
+	// Whether a ReadDirectoryChangesW call is outstanding.
+	BOOL Reading;
+
+#else
+
+	int Descriptor;
+
+#endif
+
+	const char* const* FileNames;
+
+	uint32_t FileCount;
+
+	// DWORD-aligned, as ReadDirectoryChangesW needs, because it comes from PlatformAllocate.
+	uint8_t* Buffer;
+};
+
+static volatile int64_t gPlatformAllocations;
+
+// Zero-filled, like HEAP_ZERO_MEMORY. Returns NULL if there isn't enough memory.
+void* PlatformAllocate(size_t Size)
+{
+	PlatformAdd64(&gPlatformAllocations, 1);
+
+#ifdef _WIN32
+
+	return(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Size));
+
+#else
+
+	// calloc(0) may legitimately return NULL, which callers would take for running out of memory.
+	return(calloc(1, (Size > 0) ? Size : 1));
+
+#endif
+}
+
+void PlatformFree(void* Memory)
+{
+	if (Memory == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+
+	HeapFree(GetProcessHeap(), 0, Memory);
+
+#else
+
+	free(Memory);
+
+#endif
+}
+
+// How many times PlatformAllocate or PlatformAllocateLocked has been called, by any thread.
+uint64_t PlatformAllocationCount(void)
+{
+	return((uint64_t)PlatformAdd64(&gPlatformAllocations, 0));
+}
+
+/*
+Zero-filled, page-aligned memory for secrets, locked into RAM so that it is never written to the page file. Locking can
+fail, for instance past the process's minimum working set on Windows or RLIMIT_MEMLOCK elsewhere, in which case the memory
+is still returned, and *Locked says so. Returns NULL if there isn't enough memory.
+
+*/
+void* PlatformAllocateLocked(size_t Size, bool* Locked)
+{
+	void* Memory = NULL;
+
+	PlatformAdd64(&gPlatformAllocations, 1);
+
+	*Locked = false;
+
+#ifdef _WIN32
+
+	if ((Memory = VirtualAlloc(NULL, Size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)) == NULL)
+	{
+		return(NULL);
+	}
+
+	*Locked = (VirtualLock(Memory, Size) != FALSE);
+
+#else
+
+	if (posix_memalign(&Memory, (size_t)sysconf(_SC_PAGESIZE), Size) != 0)
+	{
+		return(NULL);
+	}
+
+	memset(Memory, 0, Size);
+
+	*Locked = (mlock(Memory, Size) == 0);
+
+#endif
+
+	return(Memory);
+}
+
+// The caller must have wiped anything secret first.
+void PlatformFreeLocked(void* Memory, size_t Size)
+{
+	if (Memory == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+
+	VirtualUnlock(Memory, Size);
+
+	VirtualFree(Memory, 0, MEM_RELEASE);
+
+#else
+
+	munlock(Memory, Size);
+
+	free(Memory);
+
+#endif
+}
+
+// Returns the new value.
+int32_t PlatformIncrement(volatile int32_t* Value)
+{
+#ifdef _WIN32
+
+	return(InterlockedIncrement((volatile LONG*)Value));
+
+#else
+
+	return(__atomic_add_fetch(Value, 1, __ATOMIC_SEQ_CST));
+
+#endif
+}
+
+// Returns the new value.
+int32_t PlatformDecrement(volatile int32_t* Value)
+{
+#ifdef _WIN32
+
+	return(InterlockedDecrement((volatile LONG*)Value));
+
+#else
+
+	return(__atomic_sub_fetch(Value, 1, __ATOMIC_SEQ_CST));
+
+#endif
+}
+
+int32_t PlatformLoad(const volatile int32_t* Value)
+{
+#ifdef _WIN32
+
+	// Volatile reads have acquire semantics under MSVC, and aligned 32-bit reads are atomic.
+	return(*Value);
+
+#else
+
+	return(__atomic_load_n(Value, __ATOMIC_SEQ_CST));
+
+#endif
+}
+
+void PlatformStore(volatile int32_t* Value, int32_t NewValue)
+{
+#ifdef _WIN32
+
+	InterlockedExchange((volatile LONG*)Value, NewValue);
+
+#else
+
+	__atomic_store_n(Value, NewValue, __ATOMIC_SEQ_CST);
+
+#endif
+}
+
+// Sets *Value to NewValue if it was Comparand. Returns what *Value was before, either way.
+int32_t PlatformCompareExchange(volatile int32_t* Value, int32_t NewValue, int32_t Comparand)
+{
+#ifdef _WIN32
+
+	return(InterlockedCompareExchange((volatile LONG*)Value, NewValue, Comparand));
+
+#else
+
+	__atomic_compare_exchange_n(Value, &Comparand, NewValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+	return(Comparand);
+
+#endif
+}
+
+// Returns the new value.
+int64_t PlatformAdd64(volatile int64_t* Value, int64_t Addend)
+{
+#ifdef _WIN32
+
+	return(InterlockedExchangeAdd64((volatile LONGLONG*)Value, Addend) + Addend);
+
+#else
+
+	return(__atomic_add_fetch(Value, Addend, __ATOMIC_SEQ_CST));
+
+#endif
+}
+
+// Returns the old value.
+void* PlatformExchangePointer(void* volatile* Target, void* Value)
+{
+#ifdef _WIN32
+
+	return(InterlockedExchangePointer(Target, Value));
+
+#else
+
+	return(__atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST));
+
+#endif
+}
+
+void* PlatformLoadPointer(void* const volatile* Value)
+{
+#ifdef _WIN32
+
+	// As with PlatformLoad, a volatile read of an aligned pointer is an atomic acquire under MSVC.
+	return(*Value);
+
+#else
+
+	return(__atomic_load_n(Value, __ATOMIC_SEQ_CST));
+
+#endif
+}
+
+void PlatformSleep(uint32_t Milliseconds)
+{
+#ifdef _WIN32
+
+	Sleep(Milliseconds);
+
+#else
+
+	struct timespec Duration = { (time_t)(Milliseconds / 1000), (long)(Milliseconds % 1000) * 1000000L };
+
+	nanosleep(&Duration, NULL);
+
+#endif
+}
+
+// Only good for telling threads apart, e.g. in traces. On POSIX systems it is derived from pthread_self.
+uint32_t PlatformThreadId(void)
+{
+#ifdef _WIN32
+
+	return(GetCurrentThreadId());
+
+#else
+
+	uint64_t Self = (uint64_t)(uintptr_t)pthread_self();
+
+	return((uint32_t)(Self ^ (Self >> 32)));
+
+#endif
+}
+
+#ifdef _WIN32
+
+static DWORD WINAPI ThreadTrampoline(LPVOID Argument)
+
+#else
+
+static void* ThreadTrampoline(void* Argument)
+
+#endif
+{
+	PLATFORM_THREAD* Thread = Argument;
+
+	Thread->Routine(Thread->Argument);
+
+#ifdef _WIN32
+
+	return(0);
+
+#else
+
+	return(NULL);
+
+#endif
+}
+
+// Processors this process can run on, for sizing WorkerPool.c's pools. Never 0.
+uint32_t PlatformProcessorCount(void)
+{
+#ifdef _WIN32
+
+	SYSTEM_INFO Info = { 0 };
+
+	GetSystemInfo(&Info);
+
+	return((Info.dwNumberOfProcessors > 0) ? (uint32_t)Info.dwNumberOfProcessors : 1);
+
+#else
+
+	long Count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return((Count > 0) ? (uint32_t)Count : 1);
+
+#endif
+}
+
+// Returns NULL if the thread could not be started. Every thread that was started must be joined.
+PLATFORM_THREAD* PlatformStartThread(PLATFORM_THREAD_ROUTINE Routine, void* Argument)
+{
+	PLATFORM_THREAD* Thread = PlatformAllocate(sizeof(PLATFORM_THREAD));
+
+	if (Thread == NULL)
+	{
+		return(NULL);
+	}
+
+	Thread->Routine = Routine;
+
+	Thread->Argument = Argument;
+
+#ifdef _WIN32
+
+	if ((Thread->Handle = CreateThread(NULL, 0, ThreadTrampoline, Thread, 0, NULL)) == NULL)
+
+#else
+
+	if (pthread_create(&Thread->Handle, NULL, ThreadTrampoline, Thread) != 0)
+
+#endif
+	{
+		PlatformFree(Thread);
+
+		return(NULL);
+	}
+
+	return(Thread);
+}
+
+void PlatformJoinThread(PLATFORM_THREAD* Thread)
+{
+#ifdef _WIN32
+
+	WaitForSingleObject(Thread->Handle, INFINITE);
+
+	CloseHandle(Thread->Handle);
+
+#else
+
+	pthread_join(Thread->Handle, NULL);
+
+#endif
+
+	PlatformFree(Thread);
+}
+
+/*
+An event that one thread sets and another waits on, such as a worker waiting for work. Setting it when it is already set does
+nothing more. It resets itself as a wait returns, so each set wakes one wait. Returns NULL if there isn't enough memory.
+
+*/
+PLATFORM_EVENT* PlatformEventCreate(void)
+{
+	PLATFORM_EVENT* Event = PlatformAllocate(sizeof(PLATFORM_EVENT));
+
+	if (Event == NULL)
+	{
+		return(NULL);
+	}
+
+#ifdef _WIN32
+
+	if ((Event->Handle = CreateEventW(NULL, FALSE, FALSE, NULL)) == NULL)
+	{
+		PlatformFree(Event);
+
+		return(NULL);
+	}
+
+#else
+
+	pthread_condattr_t Attributes;
+
+	bool Created = false;
+
+	if (pthread_condattr_init(&Attributes) == 0)
+	{
+		// Waits are measured on the same clock as PlatformTimestamp, so that setting the time of day doesn't stretch them.
+		Created = (pthread_condattr_setclock(&Attributes, CLOCK_MONOTONIC) == 0 && pthread_cond_init(&Event->Condition, &Attributes) == 0);
+
+		pthread_condattr_destroy(&Attributes);
+	}
+
+	if (Created == false)
+	{
+		PlatformFree(Event);
+
+		return(NULL);
+	}
+
+	if (pthread_mutex_init(&Event->Mutex, NULL) != 0)
+	{
+		pthread_cond_destroy(&Event->Condition);
+
+		PlatformFree(Event);
+
+		return(NULL);
+	}
+
+#endif
+
+	return(Event);
+}
+
+void PlatformEventSet(PLATFORM_EVENT* Event)
+{
+#ifdef _WIN32
+
+	SetEvent(Event->Handle);
+
+#else
+
+	pthread_mutex_lock(&Event->Mutex);
+
+	Event->Signaled = true;
+
+	pthread_cond_signal(&Event->Condition);
+
+	pthread_mutex_unlock(&Event->Mutex);
+
+#endif
+}
+
+// Waits up to Milliseconds for the event to be set. Returns whether it was, as opposed to the time running out.
+bool PlatformEventWait(PLATFORM_EVENT* Event, uint32_t Milliseconds)
+{
+#ifdef _WIN32
+
+	return(WaitForSingleObject(Event->Handle, Milliseconds) == WAIT_OBJECT_0);
+
+#else
+
+	struct timespec Deadline;
+
+	bool Signaled = false;
+
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+
+	Deadline.tv_sec += (time_t)(Milliseconds / 1000);
+
+	Deadline.tv_nsec += (long)(Milliseconds % 1000) * 1000000L;
+
+	if (Deadline.tv_nsec >= 1000000000L)
+	{
+		Deadline.tv_sec++;
+
+		Deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&Event->Mutex);
+
+	while (Event->Signaled == false)
+	{
+		if (pthread_cond_timedwait(&Event->Condition, &Event->Mutex, &Deadline) != 0)
+		{
+			break;
+		}
+	}
+
+	Signaled = Event->Signaled;
+
+	Event->Signaled = false;
+
+	pthread_mutex_unlock(&Event->Mutex);
+
+	return(Signaled);
+
+#endif
+}
+
+void PlatformEventDestroy(PLATFORM_EVENT* Event)
+{
+	if (Event == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+
+	CloseHandle(Event->Handle);
+
+#else
+
+	pthread_cond_destroy(&Event->Condition);
+
+	pthread_mutex_destroy(&Event->Mutex);
+
+#endif
+
+	PlatformFree(Event);
+}
+
+// A monotonic tick count, in units of 1 / PlatformTimestampFrequency() seconds.
+uint64_t PlatformTimestamp(void)
+{
+#ifdef _WIN32
+
+	LARGE_INTEGER Now = { 0 };
+
+	QueryPerformanceCounter(&Now);
+
+	return((uint64_t)Now.QuadPart);
+
+#else
+
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+
+	return(((uint64_t)Now.tv_sec * 1000000000ULL) + (uint64_t)Now.tv_nsec);
+
+#endif
+}
+
+uint64_t PlatformTimestampFrequency(void)
+{
+#ifdef _WIN32
+
+	static volatile LONGLONG Frequency;
+
+	if (Frequency == 0)
+	{
+		LARGE_INTEGER Value = { 0 };
+
+#pragma warning(push)
+#pragma warning(disable: 6031)
+		// MSDN states that this call never fails so no need to bother with the return value.
+		QueryPerformanceFrequency(&Value);
+#pragma warning(pop)
+
+		Frequency = Value.QuadPart;
+	}
+
+	return((uint64_t)Frequency);
+
+#else
+
+	return(1000000000ULL);
+
+#endif
+}
+
+uint64_t PlatformElapsedMicroseconds(uint64_t StartTimestamp, uint64_t EndTimestamp)
+{
+	return(((EndTimestamp - StartTimestamp) * 1000000) / PlatformTimestampFrequency());
+}
+
+// Whole seconds and the remainder are scaled separately, so that this doesn't overflow after a few seconds with a 1 GHz clock.
+uint64_t PlatformElapsedNanoseconds(uint64_t StartTimestamp, uint64_t EndTimestamp)
+{
+	uint64_t Elapsed = EndTimestamp - StartTimestamp;
+
+	uint64_t Frequency = PlatformTimestampFrequency();
+
+	return(((Elapsed / Frequency) * 1000000000ULL) + (((Elapsed % Frequency) * 1000000000ULL) / Frequency));
+}
+
+// Which of Watch->FileNames Name is, as a bit, or 0. File names are ASCII, and compared without case on Windows.
+static uint32_t WatchedFileBit(const PLATFORM_WATCH* Watch, const uint16_t* WideName, const char* Name, size_t Length)
+{
+	for (uint32_t File = 0; File < Watch->FileCount; File++)
+	{
+		const char* Wanted = Watch->FileNames[File];
+
+		size_t Index = 0;
+
+		for (Index = 0; Index < Length && Wanted[Index] != '\0'; Index++)
+		{
+			uint32_t Character = (WideName != NULL) ? WideName[Index] : (uint8_t)Name[Index];
+
+			uint32_t WantedCharacter = (uint8_t)Wanted[Index];
+
+#ifdef _WIN32
+
+			Character = (Character >= 'A' && Character <= 'Z') ? Character + 0x20 : Character;
+
+			WantedCharacter = (WantedCharacter >= 'A' && WantedCharacter <= 'Z') ? WantedCharacter + 0x20 : WantedCharacter;
+
+#endif
+
+			if (Character != WantedCharacter)
+			{
+				break;
+			}
+		}
+
+		if (Index == Length && Wanted[Index] == '\0')
+		{
+			return((uint32_t)1 << File);
+		}
+	}
+
+	return(0);
+}
+
+#ifdef _WIN32
+
+static BOOL WatchRead(PLATFORM_WATCH* Watch)
+{
+	ResetEvent(Watch->Overlapped.hEvent);
+
+	Watch->Reading = ReadDirectoryChangesW(Watch->Directory, Watch->Buffer, PLATFORM_WATCH_BUFFER_SIZE, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, &Watch->Overlapped, NULL);
+
+	return(Watch->Reading);
+}
+
+#endif
+
+/*
+Starts watching Directory (not its subdirectories) for files named FileNames being created, written to, renamed or deleted.
+There can be up to 32 names, and they must stay put until the watch is stopped. Returns NULL if the directory can't be
+watched, or this platform has no way of doing it.
+
+*/
+PLATFORM_WATCH* PlatformWatchStart(const char* Directory, const char* const* FileNames, uint32_t FileCount)
+{
+	PLATFORM_WATCH* Watch = NULL;
+
+	if (FileCount > 32 || (Watch = PlatformAllocate(sizeof(PLATFORM_WATCH))) == NULL)
+	{
+		return(NULL);
+	}
+
+	Watch->FileNames = FileNames;
+
+	Watch->FileCount = FileCount;
+
+#ifdef _WIN32
+
+	Watch->Directory = INVALID_HANDLE_VALUE;
+
+	if ((Watch->Buffer = PlatformAllocate(PLATFORM_WATCH_BUFFER_SIZE)) == NULL)
+	{
+		goto Failed;
+	}
+
+	if ((Watch->Overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL)) == NULL)
+	{
+		goto Failed;
+	}
+
+	// Without FILE_SHARE_DELETE, nothing in the directory could be renamed or deleted while we watch it.
+	if ((Watch->Directory = CreateFileA(Directory, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		goto Failed;
+	}
+
+	if (WatchRead(Watch) == FALSE)
+	{
+		goto Failed;
+	}
+
+	return(Watch);
+
+#elif defined(__linux__)
+
+	if ((Watch->Buffer = PlatformAllocate(PLATFORM_WATCH_BUFFER_SIZE)) == NULL)
+	{
+		goto Failed;
+	}
+
+	if ((Watch->Descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+	{
+		goto Failed;
+	}
+
+	if (inotify_add_watch(Watch->Descriptor, Directory, IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR) < 0)
+	{
+		close(Watch->Descriptor);
+
+		goto Failed;
+	}
+
+	return(Watch);
+
+#else
+
+	(void)Directory;
+
+	goto Failed;
+
+#endif
+
+Failed:
+
+#ifdef _WIN32
+
+	if (Watch->Directory != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(Watch->Directory);
+	}
+
+	if (Watch->Overlapped.hEvent != NULL)
+	{
+		CloseHandle(Watch->Overlapped.hEvent);
+	}
+
+#endif
+
+	if (Watch->Buffer != NULL)
+	{
+		PlatformFree(Watch->Buffer);
+	}
+
+	PlatformFree(Watch);
+
+	return(NULL);
+}
+
+/*
+Waits up to Milliseconds for something to happen to the watched files. *Changed gets a bit for each of them that did, in the
+order they were given to PlatformWatchStart, or all of them if notifications were lost, and 0 if nothing happened in time.
+Returns false if the watch has stopped working, after which it can only be stopped.
+
+*/
+bool PlatformWatchWait(PLATFORM_WATCH* Watch, uint32_t Milliseconds, uint32_t* Changed)
+{
+	const uint32_t All = (Watch->FileCount == 32) ? UINT32_MAX : (((uint32_t)1 << Watch->FileCount) - 1);
+
+	*Changed = 0;
+
+#ifdef _WIN32
+
+	DWORD Bytes = 0;
+
+	DWORD Wait = WaitForSingleObject(Watch->Overlapped.hEvent, Milliseconds);
+
+	if (Wait == WAIT_TIMEOUT)
+	{
+		return(true);
+	}
+
+	if (Wait != WAIT_OBJECT_0 || GetOverlappedResult(Watch->Directory, &Watch->Overlapped, &Bytes, FALSE) == FALSE)
+	{
+		Watch->Reading = FALSE;
+
+		return(false);
+	}
+
+	// Nothing returned means more happened than fit into the buffer.
+	if (Bytes == 0)
+	{
+		*Changed = All;
+	}
+
+	for (DWORD Offset = 0; Bytes != 0; )
+	{
+		const FILE_NOTIFY_INFORMATION* Notification = (const FILE_NOTIFY_INFORMATION*)(Watch->Buffer + Offset);
+
+		*Changed |= WatchedFileBit(Watch, (const uint16_t*)Notification->FileName, NULL, Notification->FileNameLength / sizeof(WCHAR));
+
+		if (Notification->NextEntryOffset == 0)
+		{
+			break;
+		}
+
+		Offset += Notification->NextEntryOffset;
+	}
+
+	// Changes made between here and the next read are kept for it.
+	return(WatchRead(Watch) != FALSE);
+
+#elif defined(__linux__)
+
+	struct pollfd Poll = { Watch->Descriptor, POLLIN, 0 };
+
+	int Ready = poll(&Poll, 1, (int)Milliseconds);
+
+	if (Ready == 0)
+	{
+		return(true);
+	}
+
+	if (Ready < 0 || (Poll.revents & POLLIN) == 0)
+	{
+		return(false);
+	}
+
+	while (true)
+	{
+		ssize_t Bytes = read(Watch->Descriptor, Watch->Buffer, PLATFORM_WATCH_BUFFER_SIZE);
+
+		if (Bytes <= 0)
+		{
+			break;
+		}
+
+		for (ssize_t Offset = 0; Offset < Bytes; )
+		{
+			const struct inotify_event* Event = (const struct inotify_event*)(Watch->Buffer + Offset);
+
+			if ((Event->mask & IN_Q_OVERFLOW) != 0)
+			{
+				*Changed = All;
+			}
+			else if ((Event->mask & IN_IGNORED) != 0)
+			{
+				// The directory itself is gone.
+				return(false);
+			}
+			else if (Event->len > 0)
+			{
+				*Changed |= WatchedFileBit(Watch, NULL, Event->name, strlen(Event->name));
+			}
+
+			Offset += (ssize_t)(sizeof(struct inotify_event) + Event->len);
+		}
+	}
+
+	return(true);
+
+#else
+
+	(void)Milliseconds;
+
+	(void)All;
+
+	return(false);
+
+#endif
+}
+
+void PlatformWatchStop(PLATFORM_WATCH* Watch)
+{
+	if (Watch == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+
+	DWORD Bytes = 0;
+
+	// The buffer has to stay put until the read has really finished.
+	if (Watch->Reading && CancelIoEx(Watch->Directory, &Watch->Overlapped))
+	{
+		GetOverlappedResult(Watch->Directory, &Watch->Overlapped, &Bytes, TRUE);
+	}
+
+	CloseHandle(Watch->Directory);
+
+	CloseHandle(Watch->Overlapped.hEvent);
+
+#elif defined(__linux__)
+
+	close(Watch->Descriptor);
+
+#endif
+
+	PlatformFree(Watch->Buffer);
+
+	PlatformFree(Watch);
+}
@@ -0,0 +1,92 @@
+// Please read Platform.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+// Laid out like UNICODE_STRING: lengths are in bytes, and the buffer is usually not null-terminated.
+typedef struct PLATFORM_STRING
+{
+	uint16_t Length;
+
+	uint16_t MaximumLength;
+
+	const uint16_t* Buffer;
+
+} PLATFORM_STRING;
+
+typedef uint32_t (*PLATFORM_THREAD_ROUTINE)(void* Argument);
+
+typedef struct PLATFORM_THREAD PLATFORM_THREAD;
+
+typedef struct PLATFORM_EVENT PLATFORM_EVENT;
+
+typedef struct PLATFORM_WATCH PLATFORM_WATCH;
+
+void* PlatformAllocate(size_t Size);
+
+void PlatformFree(void* Memory);
+
+uint64_t PlatformAllocationCount(void);
+
+void* PlatformAllocateLocked(size_t Size, bool* Locked);
+
+void PlatformFreeLocked(void* Memory, size_t Size);
+
+int32_t PlatformIncrement(volatile int32_t* Value);
+
+int32_t PlatformDecrement(volatile int32_t* Value);
+
+int32_t PlatformLoad(const volatile int32_t* Value);
+
+void PlatformStore(volatile int32_t* Value, int32_t NewValue);
+
+int32_t PlatformCompareExchange(volatile int32_t* Value, int32_t NewValue, int32_t Comparand);
+
+int64_t PlatformAdd64(volatile int64_t* Value, int64_t Addend);
+
+void* PlatformExchangePointer(void* volatile* Target, void* Value);
+
+void* PlatformLoadPointer(void* const volatile* Value);
+
+void PlatformSleep(uint32_t Milliseconds);
+
+uint32_t PlatformThreadId(void);
+
+uint32_t PlatformProcessorCount(void);
+
+PLATFORM_THREAD* PlatformStartThread(PLATFORM_THREAD_ROUTINE Routine, void* Argument);
+
+void PlatformJoinThread(PLATFORM_THREAD* Thread);
+
+PLATFORM_EVENT* PlatformEventCreate(void);
+
+void PlatformEventSet(PLATFORM_EVENT* Event);
+
+bool PlatformEventWait(PLATFORM_EVENT* Event, uint32_t Milliseconds);
+
+void PlatformEventDestroy(PLATFORM_EVENT* Event);
+
+uint64_t PlatformTimestamp(void);
+
+uint64_t PlatformTimestampFrequency(void);
+
+uint64_t PlatformElapsedMicroseconds(uint64_t StartTimestamp, uint64_t EndTimestamp);
+
+uint64_t PlatformElapsedNanoseconds(uint64_t StartTimestamp, uint64_t EndTimestamp);
+
+PLATFORM_WATCH* PlatformWatchStart(const char* Directory, const char* const* FileNames, uint32_t FileCount);
+
+bool PlatformWatchWait(PLATFORM_WATCH* Watch, uint32_t Milliseconds, uint32_t* Changed);
+
+void PlatformWatchStop(PLATFORM_WATCH* Watch);
@@ -0,0 +1,124 @@
+/*
+ScratchPool.c
+
+Scratch buffers for password copies, set aside once so that judging a password never has to ask the heap for anything.
+
+PasswordCheck needs a copy of every password it is given, since folding it in place would change LSA's buffer. The copy
+used to come from the lsass process heap, once per call: a heap lock taken and released twice on every password change,
+shared with everything else in lsass, and a copy of a password left behind in general heap pages, wiped, but in memory
+that might have been paged out before it was.
+
+Instead, a SCRATCH_POOL holds SCRATCH_POOL_SLOTS buffers in one block of memory, allocated when the DLL starts and locked
+into RAM (see PlatformAllocateLocked), so no password copy ever reaches the page file:
+
+  - ScratchAcquire starts looking at a slot picked by thread ID, so a thread usually gets the same slot every time and
+    two threads rarely go for the same one, and claims the first free slot with a single compare-exchange. No lock is
+    taken, and nobody waits.
+
+  - ScratchRelease wipes whatever was written to the buffer before handing it back, so every buffer in the pool is all
+    zeros whenever it is free, and a password copy never outlives the call it was made for.
+
+A password longer than SCRATCH_BUFFER_SIZE allows, or a call that comes in while every slot is taken, still gets a buffer:
+from the heap, wiped and freed afterwards just as before. Both are counted. Neither should happen in practice: passwords
+that long are rare, and LSA would need more than SCRATCH_POOL_SLOTS threads changing passwords at once.
+
+Platform-neutral C.
+
+*/
+
+#include "Md4.h"
+
+#include "Platform.h"
+
+#include "ScratchPool.h"
+
+typedef char SCRATCH_POOL_SLOTS_CHECK[((SCRATCH_POOL_SLOTS & (SCRATCH_POOL_SLOTS - 1)) == 0) ? 1 : -1];
+
+// Returns false if there isn't enough memory. The pool can still be used then; every buffer comes from the heap.
+bool ScratchPoolInitialize(SCRATCH_POOL* Pool)
+{
+	for (uint32_t Slot = 0; Slot < SCRATCH_POOL_SLOTS; Slot++)
+	{
+		Pool->Slots[Slot].InUse = 0;
+	}
+
+	Pool->Oversized = 0;
+
+	Pool->Exhausted = 0;
+
+	Pool->Buffers = PlatformAllocateLocked((size_t)SCRATCH_POOL_SLOTS * SCRATCH_BUFFER_SIZE, &Pool->Locked);
+
+	return(Pool->Buffers != NULL);
+}
+
+// Nothing may be using the pool any more.
+void ScratchPoolDestroy(SCRATCH_POOL* Pool)
+{
+	// Every free buffer is already wiped, so there is nothing secret left to wipe here.
+	PlatformFreeLocked(Pool->Buffers, (size_t)SCRATCH_POOL_SLOTS * SCRATCH_BUFFER_SIZE);
+
+	Pool->Buffers = NULL;
+}
+
+/*
+Returns a zero-filled buffer of at least Size bytes, or NULL if there isn't one to be had. *Slot says where it came from,
+and must be handed back to ScratchRelease along with it. Pool may be NULL, in which case the buffer comes from the heap.
+
+*/
+void* ScratchAcquire(SCRATCH_POOL* Pool, size_t Size, int32_t* Slot)
+{
+	*Slot = SCRATCH_HEAP_SLOT;
+
+	if (Pool == NULL || Pool->Buffers == NULL)
+	{
+		return(PlatformAllocate(Size));
+	}
+
+	if (Size > SCRATCH_BUFFER_SIZE)
+	{
+		PlatformIncrement(&Pool->Oversized);
+
+		return(PlatformAllocate(Size));
+	}
+
+	uint32_t ThreadId = PlatformThreadId();
+
+	uint32_t First = (ThreadId ^ (ThreadId >> 8)) & (SCRATCH_POOL_SLOTS - 1);
+
+	for (uint32_t Probe = 0; Probe < SCRATCH_POOL_SLOTS; Probe++)
+	{
+		uint32_t Index = (First + Probe) & (SCRATCH_POOL_SLOTS - 1);
+
+		if (PlatformLoad(&Pool->Slots[Index].InUse) == 0 && PlatformCompareExchange(&Pool->Slots[Index].InUse, 1, 0) == 0)
+		{
+			*Slot = (int32_t)Index;
+
+			return(Pool->Buffers + ((size_t)Index * SCRATCH_BUFFER_SIZE));
+		}
+	}
+
+	PlatformIncrement(&Pool->Exhausted);
+
+	return(PlatformAllocate(Size));
+}
+
+// Wipes the first UsedSize bytes of Buffer, which must be everything that was written to it, and gives it back.
+void ScratchRelease(SCRATCH_POOL* Pool, void* Buffer, size_t UsedSize, int32_t Slot)
+{
+	if (Buffer == NULL)
+	{
+		return;
+	}
+
+	SecureWipe(Buffer, UsedSize);
+
+	if (Slot == SCRATCH_HEAP_SLOT)
+	{
+		PlatformFree(Buffer);
+
+		return;
+	}
+
+	// The wipe is done before the slot is seen to be free: PlatformStore is a full barrier.
+	PlatformStore(&Pool->Slots[Slot].InUse, 0);
+}
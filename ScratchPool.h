@@ -0,0 +1,58 @@
+// Please read ScratchPool.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+// How many passwords can be judged at once without touching the heap. A power of two.
+#define SCRATCH_POOL_SLOTS 64
+
+// Bytes per buffer: room for a password of 255 characters and a terminating null.
+#define SCRATCH_BUFFER_SIZE 512
+
+// What ScratchAcquire puts in *Slot for a buffer that came from the heap instead.
+#define SCRATCH_HEAP_SLOT (-1)
+
+typedef struct SCRATCH_SLOT
+{
+	volatile int32_t InUse;
+
+	// Each flag has a cache line of its own, so that threads on different slots never slow each other down.
+	uint8_t Padding[64 - sizeof(int32_t)];
+
+} SCRATCH_SLOT;
+
+typedef struct SCRATCH_POOL
+{
+	SCRATCH_SLOT Slots[SCRATCH_POOL_SLOTS];
+
+	// SCRATCH_POOL_SLOTS buffers of SCRATCH_BUFFER_SIZE bytes, one after the other. NULL if the pool isn't initialized.
+	uint8_t* Buffers;
+
+	// Whether Buffers could be locked into memory.
+	bool Locked;
+
+	// Buffers that had to come from the heap because the password was too long, or because every slot was taken.
+	volatile int32_t Oversized;
+
+	volatile int32_t Exhausted;
+
+} SCRATCH_POOL;
+
+bool ScratchPoolInitialize(SCRATCH_POOL* Pool);
+
+void ScratchPoolDestroy(SCRATCH_POOL* Pool);
+
+void* ScratchAcquire(SCRATCH_POOL* Pool, size_t Size, int32_t* Slot);
+
+void ScratchRelease(SCRATCH_POOL* Pool, void* Buffer, size_t UsedSize, int32_t Slot);
@@ -0,0 +1,74 @@
+/*
+SnapshotGuard.c
+
+Lock-free publication of read-mostly snapshots, such as the blacklist and the breach index.
+
+PasswordFilter runs on many lsass threads at once and must never wait behind a reload, so readers do not take any lock.
+
+Instead, every reader registers itself in one of two counters, chosen by the current epoch, before it reads a published
+pointer. When a new snapshot is published, the epoch is flipped and the counter of the old epoch is left to drain.
+After that, nobody can still be looking at the old snapshot, so it can be freed. (A poor man's RCU.)
+
+The atomic operations in Platform.c are full memory barriers, which is what makes the re-check of the epoch safe: either the
+reader sees the flipped epoch and tries again, or the writer sees the reader's increment and waits for it.
+
+One guard can cover any number of published pointers. A reader that entered through one of them may read all the others
+too, and they will all stay valid until it leaves.
+
+Platform-neutral C.
+
+*/
+
+#include "Platform.h"
+
+#include "SnapshotGuard.h"
+
+typedef char READER_COUNTER_SIZE_CHECK[(sizeof(READER_COUNTER) == 64) ? 1 : -1];
+
+// Registers the calling thread as a reader and returns the snapshot that is currently published at *Published.
+void* SnapshotGuardEnter(SNAPSHOT_GUARD* Guard, void* volatile* Published, int32_t* ReaderSlot)
+{
+	while (true)
+	{
+		int32_t Epoch = PlatformLoad(&Guard->Epoch);
+
+		PlatformIncrement(&Guard->Readers[Epoch & 1].Count);
+
+		if (Epoch == PlatformLoad(&Guard->Epoch))
+		{
+			*ReaderSlot = Epoch & 1;
+
+			// An atomic load, so that what the snapshot points to is read after the writer filled it in.
+			return(PlatformLoadPointer(Published));
+		}
+
+		// A new snapshot was published while we were registering. This can only happen once per reload.
+		PlatformDecrement(&Guard->Readers[Epoch & 1].Count);
+	}
+}
+
+void SnapshotGuardLeave(SNAPSHOT_GUARD* Guard, int32_t ReaderSlot)
+{
+	PlatformDecrement(&Guard->Readers[ReaderSlot].Count);
+}
+
+/*
+Publishes NewSnapshot in place of whatever *Published pointed to, waits until no reader can still be looking at the old one,
+and returns the old one to be freed.
+
+Writers must not race each other; in the DLL there is only ever one, BlacklistThreadProc.
+
+*/
+void* SnapshotGuardExchange(SNAPSHOT_GUARD* Guard, void* volatile* Published, void* NewSnapshot)
+{
+	void* OldSnapshot = PlatformExchangePointer(Published, NewSnapshot);
+
+	int32_t OldSlot = (PlatformIncrement(&Guard->Epoch) - 1) & 1;
+
+	while (PlatformLoad(&Guard->Readers[OldSlot].Count) != 0)
+	{
+		PlatformSleep(1);
+	}
+
+	return(OldSnapshot);
+}
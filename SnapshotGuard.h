@@ -0,0 +1,34 @@
+// Please read SnapshotGuard.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdint.h>
+
+// Each counter gets its own cache line so that readers in one epoch don't slow down readers in the other.
+typedef struct READER_COUNTER
+{
+	volatile int32_t Count;
+
+	uint8_t Padding[64 - sizeof(int32_t)];
+
+} READER_COUNTER;
+
+typedef struct SNAPSHOT_GUARD
+{
+	volatile int32_t Epoch;
+
+	READER_COUNTER Readers[2];
+
+} SNAPSHOT_GUARD;
+
+void* SnapshotGuardEnter(SNAPSHOT_GUARD* Guard, void* volatile* Published, int32_t* ReaderSlot);
+
+void SnapshotGuardLeave(SNAPSHOT_GUARD* Guard, int32_t ReaderSlot);
+
+void* SnapshotGuardExchange(SNAPSHOT_GUARD* Guard, void* volatile* Published, void* NewSnapshot);
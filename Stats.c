@@ -0,0 +1,494 @@
+/*
+Stats.c
+
+Counters that are always on, cheap enough to keep in PasswordFilter, and readable from outside lsass without a trace.
+
+Until now the only way to see how long password checks took was to collect an ETW trace and pick "Finished in N
+microseconds" out of the text. Instead, PasswordFilter and BlacklistThreadProc now keep their numbers in a STATS_SEGMENT:
+
+  - For every call: SET or CHANGE, the verdict, and the latency in a histogram in the style of HdrHistogram. Each power of
+    two of nanoseconds is split into STATS_SUB_BUCKETS buckets, so any latency from 1 ns to about a minute is recorded to
+    within about 6%, in a fixed 528 buckets, with a few shifts and no floating point.
+
+  - For every reload of the blacklist or the breach index: how long it took, how big the result is, and whether it failed.
+
+  - For every blacklist token that caused a rejection: how many times it did. Tokens are counted by their text, not by their
+    index in the token store, so counts carry on across reloads even though every reload numbers the tokens afresh.
+
+Threads don't share counters if they can help it. There are STATS_SHARD_COUNT shards, each on cache lines of its own, and a
+thread always uses the one its thread ID hashes to. All counters are bumped with atomic adds, so two threads that do share
+a shard still never lose a count; they just pass the cache line back and forth.
+
+The segment is plain data with a fixed layout, so it can live in a file that lsass maps and that PassFiltExTool stats maps
+too, from another process, while lsass keeps writing to it. Reading it while it changes is what StatsSnapshot is for:
+
+  - Each shard has a count of the threads writing to it right now, and a generation that each one bumps when it is done.
+    A shard is copied when nobody is writing to it, and the copy is kept only if still nobody is, and the generation is the
+    same as before, so a copied shard is always one in which every call was counted everywhere it should be: in Calls,
+    in SETs or CHANGEs, in one verdict and in one histogram bucket.
+
+  - The reload numbers have a single writer, so they use a plain sequence lock.
+
+  - Token counts are copied as they are. A count can be one behind the others, which doesn't matter for a top ten.
+
+Platform-neutral C.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "Platform.h"
+
+#include "Stats.h"
+
+// Give up on a shard, rather than spin forever, if it keeps changing under us.
+#define STATS_SNAPSHOT_ATTEMPTS 1000
+
+// After this many attempts, sleep between them: the thread in the middle of an update may be waiting for our CPU.
+#define STATS_SNAPSHOT_SPINS 64
+
+// How far a token is looked for before its hit is counted in TokenHitsLost instead. Bounds the cost of a rejection when the table is full.
+#define STATS_TOKEN_PROBES 64
+
+typedef char STATS_SHARD_COUNT_CHECK[((STATS_SHARD_COUNT & (STATS_SHARD_COUNT - 1)) == 0) ? 1 : -1];
+
+typedef char STATS_TOKEN_SLOTS_CHECK[((STATS_TOKEN_SLOTS & (STATS_TOKEN_SLOTS - 1)) == 0) ? 1 : -1];
+
+// The DLL and PassFiltExTool may be built by different compilers, and must agree on where everything is.
+typedef char STATS_LAYOUT_CHECK[(sizeof(STATS_HEADER) == 64 && sizeof(STATS_RELOADS) == 128 && (sizeof(STATS_SHARD) % 64) == 0 && sizeof(STATS_TOKEN_SLOT) == 64) ? 1 : -1];
+
+// Index of the highest set bit. Value must not be 0.
+static uint32_t HighestBit(uint64_t Value)
+{
+	uint32_t Bit = 0;
+
+	for (uint32_t Shift = 32; Shift > 0; Shift /= 2)
+	{
+		if (Value >> Shift)
+		{
+			Value >>= Shift;
+
+			Bit += Shift;
+		}
+	}
+
+	return(Bit);
+}
+
+static uint32_t BucketIndex(uint64_t Nanoseconds)
+{
+	if (Nanoseconds < STATS_SUB_BUCKETS)
+	{
+		return((uint32_t)Nanoseconds);
+	}
+
+	uint32_t Exponent = HighestBit(Nanoseconds);
+
+	if (Exponent >= STATS_MAX_EXPONENT)
+	{
+		return(STATS_HISTOGRAM_BUCKETS - 1);
+	}
+
+	return(((Exponent - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS) + (uint32_t)((Nanoseconds >> (Exponent - STATS_SUB_BUCKET_BITS)) & (STATS_SUB_BUCKETS - 1)));
+}
+
+// The smallest latency, in nanoseconds, that goes into Bucket.
+uint64_t StatsBucketLowerBound(uint32_t Bucket)
+{
+	if (Bucket < STATS_SUB_BUCKETS)
+	{
+		return(Bucket);
+	}
+
+	uint32_t Exponent = (Bucket / STATS_SUB_BUCKETS) + STATS_SUB_BUCKET_BITS - 1;
+
+	return((uint64_t)(STATS_SUB_BUCKETS + (Bucket % STATS_SUB_BUCKETS)) << (Exponent - STATS_SUB_BUCKET_BITS));
+}
+
+// Any counts that were in the segment before are lost.
+void StatsInitialize(STATS_SEGMENT* Segment)
+{
+	memset(Segment, 0, sizeof(STATS_SEGMENT));
+
+	Segment->Header.Magic = STATS_MAGIC;
+
+	Segment->Header.Version = STATS_VERSION;
+
+	Segment->Header.Size = (uint32_t)sizeof(STATS_SEGMENT);
+
+	Segment->Header.ShardCount = STATS_SHARD_COUNT;
+
+	Segment->Header.HistogramBuckets = STATS_HISTOGRAM_BUCKETS;
+
+	Segment->Header.TokenSlots = STATS_TOKEN_SLOTS;
+}
+
+// Whether Size bytes at Segment hold a segment that this build knows how to read.
+bool StatsSegmentValid(const STATS_SEGMENT* Segment, size_t Size)
+{
+	return(Size >= sizeof(STATS_SEGMENT) &&
+		Segment->Header.Magic == STATS_MAGIC &&
+		Segment->Header.Version == STATS_VERSION &&
+		Segment->Header.Size == sizeof(STATS_SEGMENT) &&
+		Segment->Header.ShardCount == STATS_SHARD_COUNT &&
+		Segment->Header.HistogramBuckets == STATS_HISTOGRAM_BUCKETS &&
+		Segment->Header.TokenSlots == STATS_TOKEN_SLOTS);
+}
+
+// Called once for every password judged. Segment may be NULL, in which case nothing is counted.
+void StatsRecordPassword(STATS_SEGMENT* Segment, PASSWORD_VERDICT Verdict, bool IsSet, uint64_t ElapsedNanoseconds)
+{
+	STATS_COUNTER VerdictCounter = StatsOutOfMemory;
+
+	if (Segment == NULL)
+	{
+		return;
+	}
+
+	switch (Verdict)
+	{
+		case PasswordAccepted:
+		case PasswordAcceptedOverBudget:
+		case PasswordStrengthOverBudget:
+		{
+			VerdictCounter = StatsAccepted;
+
+			break;
+		}
+		case PasswordBreached:
+		{
+			VerdictCounter = StatsBreached;
+
+			break;
+		}
+		case PasswordBlacklisted:
+		case PasswordNearlyBlacklisted:
+		case PasswordBlacklistedTogether:
+		{
+			VerdictCounter = StatsBlacklisted;
+
+			break;
+		}
+		case PasswordContainsName:
+		{
+			VerdictCounter = StatsNamed;
+
+			break;
+		}
+		case PasswordTooGuessable:
+		{
+			VerdictCounter = StatsWeak;
+
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	uint32_t ThreadId = PlatformThreadId();
+
+	STATS_SHARD* Shard = &Segment->Shards[(ThreadId ^ (ThreadId >> 8)) & (STATS_SHARD_COUNT - 1)];
+
+	PlatformIncrement(&Shard->Writers);
+
+	PlatformAdd64(&Shard->Counters[StatsCalls], 1);
+
+	PlatformAdd64(&Shard->Counters[IsSet ? StatsSets : StatsChanges], 1);
+
+	PlatformAdd64(&Shard->Counters[VerdictCounter], 1);
+
+	PlatformAdd64(&Shard->Latency[BucketIndex(ElapsedNanoseconds)], 1);
+
+	PlatformIncrement(&Shard->Generation);
+
+	PlatformDecrement(&Shard->Writers);
+}
+
+// Called when a password is rejected because of a blacklist token. Token is the normalized token, as kept in the token store.
+void StatsRecordTokenHit(STATS_SEGMENT* Segment, const uint8_t* Token, uint32_t TokenLength)
+{
+	if (Segment == NULL)
+	{
+		return;
+	}
+
+	int32_t TextLength = (int32_t)((TokenLength < STATS_TOKEN_TEXT_LENGTH) ? TokenLength : STATS_TOKEN_TEXT_LENGTH);
+
+	// FNV-1a. 0 marks a free slot, so it can't be a key.
+	uint32_t Hash = 2166136261U;
+
+	for (int32_t Index = 0; Index < TextLength; Index++)
+	{
+		Hash = (Hash ^ Token[Index]) * 16777619U;
+	}
+
+	int32_t Key = (Hash != 0) ? (int32_t)Hash : 1;
+
+	for (uint32_t Probe = 0; Probe < STATS_TOKEN_PROBES; Probe++)
+	{
+		STATS_TOKEN_SLOT* Slot = &Segment->Tokens[(Hash + Probe) & (STATS_TOKEN_SLOTS - 1)];
+
+		int32_t Seen = PlatformLoad(&Slot->Key);
+
+		if (Seen == 0 && (Seen = PlatformCompareExchange(&Slot->Key, Key, 0)) == 0)
+		{
+			memcpy(Slot->Text, Token, (size_t)TextLength);
+
+			PlatformStore(&Slot->TextLength, TextLength);
+
+			PlatformAdd64(&Slot->Hits, 1);
+
+			return;
+		}
+
+		if (Seen != Key)
+		{
+			continue;
+		}
+
+		int32_t SeenLength = PlatformLoad(&Slot->TextLength);
+
+		// A slot whose text isn't in yet is being claimed for a token with the same hash, almost certainly this one.
+		if (SeenLength == 0 || (SeenLength == TextLength && memcmp(Slot->Text, Token, (size_t)TextLength) == 0))
+		{
+			PlatformAdd64(&Slot->Hits, 1);
+
+			return;
+		}
+	}
+
+	PlatformAdd64(&Segment->TokenHitsLost, 1);
+}
+
+// Only ever called from one thread at a time: BlacklistThreadProc.
+void StatsRecordBlacklistReload(STATS_SEGMENT* Segment, bool Succeeded, uint64_t Microseconds, uint32_t Tokens, uint32_t States, uint64_t Bytes, bool FromImage)
+{
+	if (Segment == NULL)
+	{
+		return;
+	}
+
+	STATS_RELOADS* Reloads = &Segment->Reloads;
+
+	PlatformIncrement(&Reloads->Sequence);
+
+	if (Succeeded)
+	{
+		Reloads->BlacklistReloads++;
+
+		Reloads->LastBlacklistMicroseconds = (int64_t)Microseconds;
+
+		Reloads->TotalBlacklistMicroseconds += (int64_t)Microseconds;
+
+		if ((int64_t)Microseconds > Reloads->MaxBlacklistMicroseconds)
+		{
+			Reloads->MaxBlacklistMicroseconds = (int64_t)Microseconds;
+		}
+
+		Reloads->BlacklistTokens = Tokens;
+
+		Reloads->BlacklistStates = States;
+
+		Reloads->BlacklistBytes = (int64_t)Bytes;
+
+		Reloads->BlacklistFromImage = FromImage ? 1 : 0;
+	}
+	else
+	{
+		Reloads->BlacklistReloadFailures++;
+	}
+
+	PlatformIncrement(&Reloads->Sequence);
+}
+
+// Only ever called from one thread at a time: BlacklistThreadProc. A breach index that was removed counts as a reload to 0 hashes.
+void StatsRecordBreachReload(STATS_SEGMENT* Segment, bool Succeeded, uint64_t Microseconds, uint64_t Hashes)
+{
+	if (Segment == NULL)
+	{
+		return;
+	}
+
+	STATS_RELOADS* Reloads = &Segment->Reloads;
+
+	PlatformIncrement(&Reloads->Sequence);
+
+	if (Succeeded)
+	{
+		Reloads->BreachReloads++;
+
+		Reloads->LastBreachMicroseconds = (int64_t)Microseconds;
+
+		Reloads->BreachHashes = (int64_t)Hashes;
+	}
+	else
+	{
+		Reloads->BreachReloadFailures++;
+	}
+
+	PlatformIncrement(&Reloads->Sequence);
+}
+
+static int CompareTokenHits(const void* Left, const void* Right)
+{
+	uint64_t LeftHits = ((const STATS_TOKEN_HITS*)Left)->Hits;
+
+	uint64_t RightHits = ((const STATS_TOKEN_HITS*)Right)->Hits;
+
+	return((LeftHits < RightHits) - (LeftHits > RightHits));
+}
+
+/*
+Copies a segment that may be changing under us into something that adds up: see the top of this file. Works just as well
+on a segment that some other process is writing to, through a shared mapping. Returns false if a shard or the reload
+numbers kept changing for too long to get a clean copy; the snapshot is then only as good as the last attempt.
+
+*/
+bool StatsSnapshot(const STATS_SEGMENT* Segment, STATS_SNAPSHOT* Snapshot)
+{
+	bool Result = true;
+
+	memset(Snapshot, 0, sizeof(STATS_SNAPSHOT));
+
+	for (uint32_t ShardIndex = 0; ShardIndex < STATS_SHARD_COUNT; ShardIndex++)
+	{
+		const STATS_SHARD* Shard = &Segment->Shards[ShardIndex];
+
+		uint64_t Counters[StatsCounterCount] = { 0 };
+
+		uint64_t Latency[STATS_HISTOGRAM_BUCKETS] = { 0 };
+
+		bool Clean = false;
+
+		for (uint32_t Attempt = 0; Attempt < STATS_SNAPSHOT_ATTEMPTS && Clean == false; Attempt++)
+		{
+			if (Attempt >= STATS_SNAPSHOT_SPINS)
+			{
+				PlatformSleep(1);
+			}
+
+			int32_t Generation = PlatformLoad(&Shard->Generation);
+
+			if (PlatformLoad(&Shard->Writers) != 0)
+			{
+				Snapshot->Retries++;
+
+				continue;
+			}
+
+			for (uint32_t Counter = 0; Counter < StatsCounterCount; Counter++)
+			{
+				Counters[Counter] = (uint64_t)Shard->Counters[Counter];
+			}
+
+			for (uint32_t Bucket = 0; Bucket < STATS_HISTOGRAM_BUCKETS; Bucket++)
+			{
+				Latency[Bucket] = (uint64_t)Shard->Latency[Bucket];
+			}
+
+			Clean = (PlatformLoad(&Shard->Writers) == 0 && PlatformLoad(&Shard->Generation) == Generation);
+
+			Snapshot->Retries += (Clean == false);
+		}
+
+		Result = Result && Clean;
+
+		for (uint32_t Counter = 0; Counter < StatsCounterCount; Counter++)
+		{
+			Snapshot->Counters[Counter] += Counters[Counter];
+		}
+
+		for (uint32_t Bucket = 0; Bucket < STATS_HISTOGRAM_BUCKETS; Bucket++)
+		{
+			Snapshot->Latency[Bucket] += Latency[Bucket];
+		}
+	}
+
+	bool Clean = false;
+
+	for (uint32_t Attempt = 0; Attempt < STATS_SNAPSHOT_ATTEMPTS && Clean == false; Attempt++)
+	{
+		if (Attempt >= STATS_SNAPSHOT_SPINS)
+		{
+			PlatformSleep(1);
+		}
+
+		int32_t Sequence = PlatformLoad(&Segment->Reloads.Sequence);
+
+		if (Sequence & 1)
+		{
+			continue;
+		}
+
+		Snapshot->Reloads = Segment->Reloads;
+
+		Clean = (PlatformLoad(&Segment->Reloads.Sequence) == Sequence);
+	}
+
+	Result = Result && Clean;
+
+	Snapshot->TokenHitsLost = (uint64_t)Segment->TokenHitsLost;
+
+	for (uint32_t SlotIndex = 0; SlotIndex < STATS_TOKEN_SLOTS; SlotIndex++)
+	{
+		const STATS_TOKEN_SLOT* Slot = &Segment->Tokens[SlotIndex];
+
+		int32_t TextLength = PlatformLoad(&Slot->TextLength);
+
+		if (TextLength <= 0 || TextLength > STATS_TOKEN_TEXT_LENGTH || Slot->Hits <= 0)
+		{
+			continue;
+		}
+
+		STATS_TOKEN_HITS* Hits = &Snapshot->Tokens[Snapshot->TokenCount++];
+
+		Hits->Hits = (uint64_t)Slot->Hits;
+
+		Hits->TextLength = (uint32_t)TextLength;
+
+		memcpy(Hits->Text, Slot->Text, (size_t)TextLength);
+	}
+
+	qsort(Snapshot->Tokens, Snapshot->TokenCount, sizeof(STATS_TOKEN_HITS), CompareTokenHits);
+
+	return(Result);
+}
+
+// The latency, in nanoseconds, that Percentile (0 to 100) of the calls in Snapshot took no longer than, to within a bucket.
+uint64_t StatsPercentile(const STATS_SNAPSHOT* Snapshot, double Percentile)
+{
+	uint64_t Total = 0;
+
+	for (uint32_t Bucket = 0; Bucket < STATS_HISTOGRAM_BUCKETS; Bucket++)
+	{
+		Total += Snapshot->Latency[Bucket];
+	}
+
+	if (Total == 0)
+	{
+		return(0);
+	}
+
+	uint64_t Wanted = (uint64_t)(((double)Total * Percentile) / 100.0);
+
+	Wanted = (Wanted < 1) ? 1 : ((Wanted > Total) ? Total : Wanted);
+
+	uint64_t Seen = 0;
+
+	for (uint32_t Bucket = 0; Bucket < STATS_HISTOGRAM_BUCKETS; Bucket++)
+	{
+		Seen += Snapshot->Latency[Bucket];
+
+		if (Seen >= Wanted)
+		{
+			// The top of the bucket, so as never to flatter.
+			return((Bucket + 1 < STATS_HISTOGRAM_BUCKETS) ? StatsBucketLowerBound(Bucket + 1) - 1 : StatsBucketLowerBound(Bucket));
+		}
+	}
+
+	return(StatsBucketLowerBound(STATS_HISTOGRAM_BUCKETS - 1));
+}
@@ -0,0 +1,228 @@
+// Please read Stats.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "PasswordCheck.h"
+
+// "PFXS"
+#define STATS_MAGIC 0x53584650
+
+// 2 added StatsNamed, 3 StatsWeak.
+#define STATS_VERSION 3
+
+// Threads are spread over this many sets of counters by thread ID. A power of two.
+#define STATS_SHARD_COUNT 16
+
+// Each power of two of the latency histogram is split into 2 ^ STATS_SUB_BUCKET_BITS buckets, which keeps every bucket
+// within about 6% of the latencies it holds.
+#define STATS_SUB_BUCKET_BITS 4
+
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+
+// Latencies of 2 ^ STATS_MAX_EXPONENT nanoseconds (about a minute) and up all go into the last bucket.
+#define STATS_MAX_EXPONENT 36
+
+#define STATS_HISTOGRAM_BUCKETS ((STATS_MAX_EXPONENT - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS)
+
+// Distinct blacklist tokens whose hits are counted. A power of two.
+#define STATS_TOKEN_SLOTS 4096
+
+// Tokens longer than this are counted under their first STATS_TOKEN_TEXT_LENGTH bytes.
+#define STATS_TOKEN_TEXT_LENGTH 48
+
+typedef enum STATS_COUNTER
+{
+	StatsCalls,
+
+	StatsSets,
+
+	StatsChanges,
+
+	StatsAccepted,
+
+	StatsBreached,
+
+	StatsBlacklisted,
+
+	StatsOutOfMemory,
+
+	// Rejected because part of the user's name makes up at least half of the password.
+	StatsNamed,
+
+	// Rejected because it would take fewer guesses than the blacklist's !strength.
+	StatsWeak,
+
+	StatsCounterCount
+
+} STATS_COUNTER;
+
+typedef struct STATS_HEADER
+{
+	uint32_t Magic;
+
+	uint32_t Version;
+
+	uint32_t Size;
+
+	uint32_t ShardCount;
+
+	uint32_t HistogramBuckets;
+
+	uint32_t TokenSlots;
+
+	uint8_t Padding[40];
+
+} STATS_HEADER;
+
+// Everything about reloads. Only ever written by one thread, under Sequence.
+typedef struct STATS_RELOADS
+{
+	// Odd while the fields below are being changed.
+	volatile int32_t Sequence;
+
+	int32_t Padding;
+
+	volatile int64_t BlacklistReloads;
+
+	volatile int64_t BlacklistReloadFailures;
+
+	volatile int64_t LastBlacklistMicroseconds;
+
+	volatile int64_t MaxBlacklistMicroseconds;
+
+	volatile int64_t TotalBlacklistMicroseconds;
+
+	volatile int64_t BlacklistTokens;
+
+	volatile int64_t BlacklistStates;
+
+	volatile int64_t BlacklistBytes;
+
+	// 1 if the blacklist in use came from an image.
+	volatile int64_t BlacklistFromImage;
+
+	volatile int64_t BreachReloads;
+
+	volatile int64_t BreachReloadFailures;
+
+	volatile int64_t LastBreachMicroseconds;
+
+	volatile int64_t BreachHashes;
+
+	uint8_t Tail[16];
+
+} STATS_RELOADS;
+
+// The counters of the threads that hash to one shard.
+typedef struct STATS_SHARD
+{
+	// How many threads are changing this shard right now.
+	volatile int32_t Writers;
+
+	// Bumped by every thread that has finished changing this shard.
+	volatile int32_t Generation;
+
+	uint8_t Padding[56];
+
+	volatile int64_t Counters[StatsCounterCount];
+
+	uint8_t CounterPadding[64 - ((StatsCounterCount * sizeof(int64_t)) % 64)];
+
+	// Latencies of PasswordFilter calls, in nanoseconds. See StatsBucketLowerBound.
+	volatile int64_t Latency[STATS_HISTOGRAM_BUCKETS];
+
+} STATS_SHARD;
+
+typedef struct STATS_TOKEN_SLOT
+{
+	// A hash of the token, or 0 if the slot is free.
+	volatile int32_t Key;
+
+	// Set once Text has been filled in. 0 until then.
+	volatile int32_t TextLength;
+
+	volatile int64_t Hits;
+
+	char Text[STATS_TOKEN_TEXT_LENGTH];
+
+} STATS_TOKEN_SLOT;
+
+// The layout of the whole segment, whether it is a file mapped by lsass and PassFiltExTool or a block of heap.
+typedef struct STATS_SEGMENT
+{
+	STATS_HEADER Header;
+
+	STATS_RELOADS Reloads;
+
+	// Hits on tokens that didn't fit in Tokens.
+	volatile int64_t TokenHitsLost;
+
+	uint8_t Padding[56];
+
+	STATS_SHARD Shards[STATS_SHARD_COUNT];
+
+	STATS_TOKEN_SLOT Tokens[STATS_TOKEN_SLOTS];
+
+} STATS_SEGMENT;
+
+typedef struct STATS_TOKEN_HITS
+{
+	uint64_t Hits;
+
+	uint32_t TextLength;
+
+	char Text[STATS_TOKEN_TEXT_LENGTH];
+
+} STATS_TOKEN_HITS;
+
+// A copy of a segment that adds up, see StatsSnapshot.
+typedef struct STATS_SNAPSHOT
+{
+	uint64_t Counters[StatsCounterCount];
+
+	uint64_t Latency[STATS_HISTOGRAM_BUCKETS];
+
+	// Copied as is. Sequence is always even.
+	STATS_RELOADS Reloads;
+
+	uint64_t TokenHitsLost;
+
+	// Sorted by Hits, most first.
+	STATS_TOKEN_HITS Tokens[STATS_TOKEN_SLOTS];
+
+	uint32_t TokenCount;
+
+	// How many times a shard had to be copied again because it changed while it was being copied.
+	uint32_t Retries;
+
+} STATS_SNAPSHOT;
+
+void StatsInitialize(STATS_SEGMENT* Segment);
+
+bool StatsSegmentValid(const STATS_SEGMENT* Segment, size_t Size);
+
+void StatsRecordPassword(STATS_SEGMENT* Segment, PASSWORD_VERDICT Verdict, bool IsSet, uint64_t ElapsedNanoseconds);
+
+void StatsRecordTokenHit(STATS_SEGMENT* Segment, const uint8_t* Token, uint32_t TokenLength);
+
+void StatsRecordBlacklistReload(STATS_SEGMENT* Segment, bool Succeeded, uint64_t Microseconds, uint32_t Tokens, uint32_t States, uint64_t Bytes, bool FromImage);
+
+void StatsRecordBreachReload(STATS_SEGMENT* Segment, bool Succeeded, uint64_t Microseconds, uint64_t Hashes);
+
+bool StatsSnapshot(const STATS_SEGMENT* Segment, STATS_SNAPSHOT* Snapshot);
+
+uint64_t StatsBucketLowerBound(uint32_t Bucket);
+
+uint64_t StatsPercentile(const STATS_SNAPSHOT* Snapshot, double Percentile);
@@ -0,0 +1,1042 @@
+/*
+Strength.c
+
+Estimates how many guesses a password would take to crack, the way zxcvbn (Wheeler, USENIX Security 2016) does, so that a
+blacklist can turn away passwords that are easy to guess without listing them: keyboard walks, sequences, repeats and dates,
+and short runs of blacklist tokens with those around them.
+
+A blacklist asks for this with a line "!strength n" (see Blacklist.c), and passwords that come out at fewer than 10^n guesses
+are rejected. zxcvbn calls 10^8 to 10^10 "safely unguessable" for an online attack; 8 is a good place to start.
+
+The estimate:
+
+  - Every piece of the password that something recognizes is a match, with the number of guesses an attacker who knew what
+    kind of piece it was would need to find it:
+
+      - A blacklist token: how many tokens of its length the list has, times the ways its letters could have been capitalized
+        and its characters written with the list's !substitute spellings. These are found with the blacklist's own automaton (and
+        the overlay, see BlacklistDelta.c) on the canonicalized password, following every dictionary link.
+      - A walk of three keys or more on a QWERTY keyboard or a keypad, counted by its length, its turns and how many of its keys
+        were shifted.
+      - A run of characters that go up or down by the same step, of 5 or less.
+      - A unit of up to STRENGTH_MAX_REPEAT_UNIT characters, repeated.
+      - A year, or a date with or without separators, counted by how far its year is from this one.
+
+  - Any stretch that nothing recognizes is brute force, at 10 guesses a character.
+
+  - Dynamic programming then finds the least guessable way of reading the whole password as pieces one after another: for each
+    end position and number of pieces, the smallest product of the pieces' guesses. A reading of l pieces takes l! times that
+    product, since the attacker doesn't know their order, plus 10^4^(l-1), for trying ever longer readings. Two brute force
+    pieces never follow each other.
+
+Nothing here allocates, and nothing is formatted or parsed: the keyboards, the tokens of each length, the substitution groups,
+the powers of 10 and the year are all worked out into flat arrays in STRENGTH_TABLES when the blacklist is loaded (see
+StrengthTablesBuild), and the estimate itself lives on the stack (about 20 KB).
+
+The time an estimate can take is bounded twice over. Passwords longer than STRENGTH_MAX_PASSWORD_LENGTH are not estimated, and a
+reading has at most STRENGTH_MAX_PIECES pieces, so that the brute force pieces ending at each position are one running minimum
+per number of pieces rather than a loop over where they start. What is left that grows with the password and the blacklist is
+the blacklist tokens, up to one for every length at every position, so every dictionary link followed and every way of
+reading a piece weighed counts against STRENGTH_WORK_BUDGET. Once that runs out, no more matches are looked for, and the
+positions left are read with the pieces already found and brute force. The guesses that come out are then never fewer than the
+full estimate's, so a password that is still too easy to guess is rejected all the same, and one that isn't is accepted with
+a verdict that says the estimate was cut short.
+
+PassFiltExTool strength-bench checks known cases, and prints the latency for long, adversarial passwords.
+
+Platform-neutral C.
+
+*/
+
+#include <float.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include <time.h>
+
+#include "Normalize.h"
+
+#include "Strength.h"
+
+// The constants are zxcvbn's.
+#define STRENGTH_BRUTEFORCE_GUESSES_SINGLE 11.0
+
+#define STRENGTH_MIN_GUESSES_SINGLE 10.0
+
+#define STRENGTH_MIN_GUESSES_MULTI 50.0
+
+// What each piece past the first costs a reading, on top of the factorial. zxcvbn's MIN_GUESSES_BEFORE_GROWING_SEQUENCE.
+#define STRENGTH_PIECE_PENALTY 10000.0
+
+#define STRENGTH_MIN_YEAR_SPACE 20
+
+#define STRENGTH_MIN_YEAR 1000
+
+#define STRENGTH_MAX_YEAR 2050
+
+#define STRENGTH_DAYS_PER_YEAR 365.0
+
+// A date written with separators could have used any of about this many.
+#define STRENGTH_SEPARATOR_GUESSES 4.0
+
+// The year dates are counted from, if the clock can't say.
+#define STRENGTH_DEFAULT_REFERENCE_YEAR 2026
+
+#define STRENGTH_SECONDS_PER_YEAR 31556952
+
+#define STRENGTH_UNREACHABLE DBL_MAX
+
+#define STRENGTH_LAYOUT_ROWS 5
+
+#define STRENGTH_LAYOUT_COLUMNS 16
+
+// A layout as rows of keys, each CharactersPerKey characters (unshifted, then shifted), with the column each row starts at.
+typedef struct STRENGTH_LAYOUT
+{
+	const char* Rows[STRENGTH_LAYOUT_ROWS];
+
+	uint8_t Offsets[STRENGTH_LAYOUT_ROWS];
+
+	uint32_t CharactersPerKey;
+
+	// Rows that are each half a key to the right of the one above, as on a keyboard, rather than lined up, as on a keypad.
+	bool Slanted;
+
+} STRENGTH_LAYOUT;
+
+static const STRENGTH_LAYOUT gStrengthLayouts[STRENGTH_LAYOUT_COUNT] =
+{
+	{ { "`~1!2@3#4$5%6^7&8*9(0)-_=+", "qQwWeErRtTyYuUiIoOpP[{]}\\|", "aAsSdDfFgGhHjJkKlL;:'\"", "zZxXcCvVbBnNmM,<.>/?", NULL }, { 0, 1, 1, 1, 0 }, 2, true },
+
+	{ { "/*-", "789+", "456", "123", "0." }, { 1, 0, 0, 0, 1 }, 1, false }
+};
+
+// Column and row steps to each neighbor, in the order zxcvbn lists them.
+static const int8_t gSlantedDirections[6][2] = { { -1, 0 }, { 0, -1 }, { 1, -1 }, { 1, 0 }, { 0, 1 }, { -1, 1 } };
+
+static const int8_t gAlignedDirections[8][2] = { { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 } };
+
+// How a date without separators can be cut into three numbers, for each length from 4 to 8: the ends of the first two.
+static const uint8_t gDateSplits[5][4][2] =
+{
+	{ { 1, 2 }, { 2, 3 }, { 0, 0 }, { 0, 0 } },
+	{ { 1, 3 }, { 2, 3 }, { 0, 0 }, { 0, 0 } },
+	{ { 1, 2 }, { 2, 4 }, { 4, 5 }, { 0, 0 } },
+	{ { 1, 3 }, { 2, 3 }, { 4, 5 }, { 4, 6 } },
+	{ { 2, 4 }, { 4, 6 }, { 0, 0 }, { 0, 0 } }
+};
+
+typedef struct STRENGTH_MATCH
+{
+	uint8_t Start;
+
+	uint8_t End;
+
+	// The next match that ends at the same position, plus one, or 0.
+	uint16_t Next;
+
+	double Guesses;
+
+} STRENGTH_MATCH;
+
+typedef struct STRENGTH_STATE
+{
+	const STRENGTH_TABLES* Tables;
+
+	const uint16_t* Password;
+
+	const uint16_t* Canonical;
+
+	uint32_t Length;
+
+	uint64_t Work;
+
+	uint32_t MatchCount;
+
+	STRENGTH_MATCH Matches[STRENGTH_MAX_MATCHES];
+
+	// The first match that ends at each position, plus one, or 0.
+	uint16_t FirstMatch[STRENGTH_MAX_PASSWORD_LENGTH];
+
+	// How many upper and lower case letters, substituted characters, and characters that could have been substituted but
+	// weren't, come before each position, so that any piece's count is a subtraction.
+	uint8_t Uppers[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	uint8_t Lowers[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	uint8_t Substituted[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	uint8_t Unsubstituted[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	// For each end position and number of pieces less one, the least product of guesses for the password up to there, over
+	// readings whose last piece isn't brute force, and over all of them.
+	double Matched[STRENGTH_MAX_PASSWORD_LENGTH][STRENGTH_MAX_PIECES];
+
+	double Any[STRENGTH_MAX_PASSWORD_LENGTH][STRENGTH_MAX_PIECES];
+
+	// For each number of pieces less one, the least product of guesses before a brute force piece, over where it starts, divided
+	// by 10 to the power of that start. See StrengthEstimate.
+	double BruteForceFrom[STRENGTH_MAX_PIECES];
+
+} STRENGTH_STATE;
+
+static void BuildKeyboard(const STRENGTH_LAYOUT* Layout, STRENGTH_KEYBOARD* Keyboard)
+{
+	uint8_t Grid[STRENGTH_LAYOUT_ROWS][STRENGTH_LAYOUT_COLUMNS];
+
+	uint8_t Columns[STRENGTH_MAX_KEYS] = { 0 };
+
+	uint8_t Rows[STRENGTH_MAX_KEYS] = { 0 };
+
+	uint32_t KeyCount = 0;
+
+	uint32_t Degrees = 0;
+
+	const int8_t (*Directions)[2] = Layout->Slanted ? gSlantedDirections : gAlignedDirections;
+
+	memset(Grid, STRENGTH_NO_KEY, sizeof(Grid));
+
+	memset(Keyboard->Keys, STRENGTH_NO_KEY, sizeof(Keyboard->Keys));
+
+	memset(Keyboard->Neighbors, STRENGTH_NO_KEY, sizeof(Keyboard->Neighbors));
+
+	Keyboard->DirectionCount = Layout->Slanted ? 6 : 8;
+
+	for (uint32_t Row = 0; Row < STRENGTH_LAYOUT_ROWS; Row++)
+	{
+		if (Layout->Rows[Row] == NULL)
+		{
+			continue;
+		}
+
+		size_t RowLength = strlen(Layout->Rows[Row]);
+
+		for (size_t Index = 0; Index + Layout->CharactersPerKey <= RowLength && KeyCount < STRENGTH_MAX_KEYS; Index += Layout->CharactersPerKey)
+		{
+			uint32_t Column = Layout->Offsets[Row] + (uint32_t)(Index / Layout->CharactersPerKey);
+
+			Grid[Row][Column] = (uint8_t)KeyCount;
+
+			Columns[KeyCount] = (uint8_t)Column;
+
+			Rows[KeyCount] = (uint8_t)Row;
+
+			for (uint32_t Shift = 0; Shift < Layout->CharactersPerKey; Shift++)
+			{
+				Keyboard->Keys[(uint8_t)Layout->Rows[Row][Index + Shift] & 0x7F] = (uint8_t)(KeyCount | (Shift > 0 ? STRENGTH_SHIFTED : 0));
+			}
+
+			KeyCount++;
+		}
+	}
+
+	for (uint32_t Key = 0; Key < KeyCount; Key++)
+	{
+		for (uint32_t Direction = 0; Direction < Keyboard->DirectionCount; Direction++)
+		{
+			int32_t Column = Columns[Key] + Directions[Direction][0];
+
+			int32_t Row = Rows[Key] + Directions[Direction][1];
+
+			if (Column >= 0 && Column < STRENGTH_LAYOUT_COLUMNS && Row >= 0 && Row < STRENGTH_LAYOUT_ROWS && Grid[Row][Column] != STRENGTH_NO_KEY)
+			{
+				Keyboard->Neighbors[Key][Direction] = Grid[Row][Column];
+
+				Degrees++;
+			}
+		}
+	}
+
+	// Every character of a key has the key's neighbors, so the average over characters is the average over keys.
+	Keyboard->StartingPositions = (double)(KeyCount * Layout->CharactersPerKey);
+
+	Keyboard->AverageDegree = (KeyCount > 0) ? (double)Degrees / (double)KeyCount : 0.0;
+}
+
+/*
+Works out everything an estimate looks up, for a blacklist of Tokens built into Automaton with a !strength of Minimum. Returns
+NULL if out of memory. Walking the DAWG to count the tokens by length is the only part that grows with the list.
+
+*/
+STRENGTH_TABLES* StrengthTablesBuild(const TOKEN_DAWG* Tokens, const AC_AUTOMATON* Automaton, uint32_t Minimum)
+{
+	STRENGTH_TABLES* Tables = calloc(1, sizeof(STRENGTH_TABLES));
+
+	uint32_t GroupCounts[AC_ALPHABET_SIZE] = { 0 };
+
+	uint32_t LengthCounts[TOKEN_DAWG_MAX_LENGTH + 1];
+
+	time_t Now = time(NULL);
+
+	if (Tables == NULL)
+	{
+		return(NULL);
+	}
+
+	Tables->Powers[0] = 1.0;
+
+	Tables->InversePowers[0] = 1.0;
+
+	for (uint32_t Index = 1; Index < STRENGTH_MAX_PASSWORD_LENGTH + 2; Index++)
+	{
+		Tables->Powers[Index] = Tables->Powers[Index - 1] * 10.0;
+
+		Tables->InversePowers[Index] = Tables->InversePowers[Index - 1] / 10.0;
+	}
+
+	Tables->Threshold = Tables->Powers[(Minimum <= STRENGTH_MAX_MINIMUM) ? Minimum : STRENGTH_MAX_MINIMUM];
+
+	TokenDawgCountLengths(Tokens, LengthCounts);
+
+	// A token nobody would have to go through fewer than one of.
+	for (uint32_t Length = 0; Length <= STRENGTH_MAX_PASSWORD_LENGTH; Length++)
+	{
+		Tables->TokensOfLength[Length] = (LengthCounts[Length] > 0) ? (double)LengthCounts[Length] : 1.0;
+	}
+
+	for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+	{
+		GroupCounts[Automaton->Substituting ? Automaton->Substitutions[Character] : Character]++;
+	}
+
+	for (uint32_t Character = 0; Character < AC_ALPHABET_SIZE; Character++)
+	{
+		Tables->GroupSizes[Character] = (uint16_t)GroupCounts[Automaton->Substituting ? Automaton->Substitutions[Character] : Character];
+	}
+
+	Tables->ReferenceYear = (Now > 0) ? (uint32_t)(1970 + ((uint64_t)Now / STRENGTH_SECONDS_PER_YEAR)) : STRENGTH_DEFAULT_REFERENCE_YEAR;
+
+	for (uint32_t Layout = 0; Layout < STRENGTH_LAYOUT_COUNT; Layout++)
+	{
+		BuildKeyboard(&gStrengthLayouts[Layout], &Tables->Keyboards[Layout]);
+	}
+
+	return(Tables);
+}
+
+/*
+zxcvbn's count of the ways a piece could have had Changed of its Changed + Unchanged characters changed (capitalized, shifted or
+substituted), up to as many as it has of the other: the sum of the binomial coefficients up to the smaller of the two. Only
+called with both above 0.
+
+*/
+static double Variations(STRENGTH_STATE* State, uint32_t Changed, uint32_t Unchanged)
+{
+	uint32_t Total = Changed + Unchanged;
+
+	uint32_t Limit = (Changed < Unchanged) ? Changed : Unchanged;
+
+	double Binomial = 1.0;
+
+	double Sum = 0.0;
+
+	for (uint32_t Index = 1; Index <= Limit; Index++)
+	{
+		Binomial = (Binomial * (double)(Total - Index + 1)) / (double)Index;
+
+		Sum += Binomial;
+	}
+
+	State->Work += Limit;
+
+	return(Sum);
+}
+
+// A match of the characters from Start to End, both included. Short matches are never taken as easier to guess than zxcvbn's
+// least, unless they are the whole password. Returns false once there is no more room, which only leaves the estimate higher.
+static bool AddMatch(STRENGTH_STATE* State, uint32_t Start, uint32_t End, double Guesses)
+{
+	uint32_t Length = End - Start + 1;
+
+	if (State->MatchCount == STRENGTH_MAX_MATCHES)
+	{
+		return(false);
+	}
+
+	if (Length < State->Length)
+	{
+		double Least = (Length == 1) ? STRENGTH_MIN_GUESSES_SINGLE : STRENGTH_MIN_GUESSES_MULTI;
+
+		Guesses = (Guesses < Least) ? Least : Guesses;
+	}
+
+	STRENGTH_MATCH* Match = &State->Matches[State->MatchCount++];
+
+	Match->Start = (uint8_t)Start;
+
+	Match->End = (uint8_t)End;
+
+	Match->Guesses = Guesses;
+
+	Match->Next = State->FirstMatch[End];
+
+	State->FirstMatch[End] = (uint16_t)State->MatchCount;
+
+	return(true);
+}
+
+static double SpatialGuesses(STRENGTH_STATE* State, const STRENGTH_KEYBOARD* Keyboard, uint32_t Length, uint32_t Turns, uint32_t Shifted)
+{
+	double Guesses = 0.0;
+
+	for (uint32_t Walked = 2; Walked <= Length; Walked++)
+	{
+		uint32_t PossibleTurns = (Turns < Walked - 1) ? Turns : Walked - 1;
+
+		// C(Walked - 1, Turn - 1) * StartingPositions * AverageDegree^Turn, for each number of turns.
+		double Binomial = 1.0;
+
+		double Degree = Keyboard->AverageDegree;
+
+		for (uint32_t Turn = 1; Turn <= PossibleTurns; Turn++)
+		{
+			Guesses += Binomial * Keyboard->StartingPositions * Degree;
+
+			Binomial = (Binomial * (double)(Walked - Turn)) / (double)Turn;
+
+			Degree *= Keyboard->AverageDegree;
+		}
+
+		State->Work += PossibleTurns;
+	}
+
+	if (Shifted > 0)
+	{
+		Guesses *= (Shifted == Length) ? 2.0 : Variations(State, Shifted, Length - Shifted);
+	}
+
+	return(Guesses);
+}
+
+// Walks of three keys or more, each one key from the last.
+static void MatchSpatial(STRENGTH_STATE* State, const STRENGTH_KEYBOARD* Keyboard)
+{
+	const uint16_t* Password = State->Password;
+
+	uint32_t Start = 0;
+
+	while (Start + 2 < State->Length)
+	{
+		uint8_t First = (Password[Start] < 128) ? Keyboard->Keys[Password[Start]] : STRENGTH_NO_KEY;
+
+		uint32_t End = Start + 1;
+
+		uint32_t Turns = 0;
+
+		uint32_t Shifted = 0;
+
+		uint32_t LastDirection = STRENGTH_DIRECTIONS;
+
+		if (First == STRENGTH_NO_KEY)
+		{
+			Start++;
+
+			continue;
+		}
+
+		Shifted += ((First & STRENGTH_SHIFTED) != 0);
+
+		uint8_t Previous = (uint8_t)(First & ~STRENGTH_SHIFTED);
+
+		for (; End < State->Length; End++)
+		{
+			uint8_t Key = (Password[End] < 128) ? Keyboard->Keys[Password[End]] : STRENGTH_NO_KEY;
+
+			uint32_t Direction = 0;
+
+			if (Key == STRENGTH_NO_KEY)
+			{
+				break;
+			}
+
+			while (Direction < Keyboard->DirectionCount && Keyboard->Neighbors[Previous][Direction] != (Key & ~STRENGTH_SHIFTED))
+			{
+				Direction++;
+			}
+
+			if (Direction == Keyboard->DirectionCount)
+			{
+				break;
+			}
+
+			Shifted += ((Key & STRENGTH_SHIFTED) != 0);
+
+			Turns += (Direction != LastDirection);
+
+			LastDirection = Direction;
+
+			Previous = (uint8_t)(Key & ~STRENGTH_SHIFTED);
+		}
+
+		State->Work += End - Start;
+
+		if (End - Start >= 3)
+		{
+			AddMatch(State, Start, End - 1, SpatialGuesses(State, Keyboard, End - Start, Turns, Shifted));
+		}
+
+		Start = End;
+	}
+}
+
+static void AddSequence(STRENGTH_STATE* State, uint32_t Start, uint32_t End, int32_t Delta)
+{
+	uint32_t Step = (uint32_t)((Delta < 0) ? -Delta : Delta);
+
+	uint16_t First = State->Password[Start];
+
+	if ((End - Start > 1 || Step == 1) && Step > 0 && Step <= 5)
+	{
+		// Starting on an obvious character, then digits, then anything else.
+		double Guesses = (First == L'a' || First == L'A' || First == L'z' || First == L'Z' || First == L'0' || First == L'1' || First == L'9') ? 4.0 : (First >= L'0' && First <= L'9') ? 10.0 : 26.0;
+
+		Guesses *= (Delta < 0) ? 2.0 : 1.0;
+
+		AddMatch(State, Start, End, Guesses * (double)(End - Start + 1));
+	}
+}
+
+// Runs of characters that each differ from the last by the same step. Runs share their ends, as in zxcvbn.
+static void MatchSequences(STRENGTH_STATE* State)
+{
+	const uint16_t* Password = State->Password;
+
+	uint32_t Start = 0;
+
+	int32_t LastDelta = 0;
+
+	if (State->Length < 2)
+	{
+		return;
+	}
+
+	for (uint32_t Index = 1; Index < State->Length; Index++)
+	{
+		int32_t Delta = (int32_t)Password[Index] - (int32_t)Password[Index - 1];
+
+		if (Index == 1)
+		{
+			LastDelta = Delta;
+		}
+
+		if (Delta == LastDelta)
+		{
+			continue;
+		}
+
+		AddSequence(State, Start, Index - 1, LastDelta);
+
+		Start = Index - 1;
+
+		LastDelta = Delta;
+	}
+
+	AddSequence(State, Start, State->Length - 1, LastDelta);
+
+	State->Work += State->Length;
+}
+
+// The longest stretch from each position that is one unit over and over, taking the unit to be brute force.
+static void MatchRepeats(STRENGTH_STATE* State)
+{
+	const uint16_t* Password = State->Password;
+
+	uint32_t Start = 0;
+
+	while (Start + 1 < State->Length)
+	{
+		uint32_t BestLength = 0;
+
+		uint32_t BestUnit = 0;
+
+		for (uint32_t Unit = 1; Unit <= STRENGTH_MAX_REPEAT_UNIT && Start + (2 * Unit) <= State->Length; Unit++)
+		{
+			uint32_t Covered = Unit;
+
+			while (Start + Covered < State->Length && Password[Start + Covered] == Password[Start + Covered - Unit])
+			{
+				Covered++;
+			}
+
+			State->Work += Covered;
+
+			Covered -= Covered % Unit;
+
+			if (Covered >= 2 * Unit && Covered > BestLength)
+			{
+				BestLength = Covered;
+
+				BestUnit = Unit;
+			}
+		}
+
+		if (BestLength == 0)
+		{
+			Start++;
+
+			continue;
+		}
+
+		double UnitGuesses = (BestUnit == 1) ? STRENGTH_BRUTEFORCE_GUESSES_SINGLE : State->Tables->Powers[BestUnit];
+
+		AddMatch(State, Start, Start + BestLength - 1, UnitGuesses * (double)(BestLength / BestUnit));
+
+		Start += BestLength;
+	}
+}
+
+static bool IsDigit(uint16_t Character)
+{
+	return(Character >= L'0' && Character <= L'9');
+}
+
+static uint32_t DigitsValue(const uint16_t* Digits, uint32_t Count)
+{
+	uint32_t Value = 0;
+
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		Value = (Value * 10) + (uint32_t)(Digits[Index] - L'0');
+	}
+
+	return(Value);
+}
+
+static bool IsDayMonth(uint32_t First, uint32_t Second)
+{
+	return((First >= 1 && First <= 31 && Second >= 1 && Second <= 12) || (Second >= 1 && Second <= 31 && First >= 1 && First <= 12));
+}
+
+// The year of a date written as the three numbers in Values, in any of the orders zxcvbn allows, or 0 if it isn't one.
+static uint32_t DateYear(const uint32_t* Values)
+{
+	uint32_t Over12 = 0;
+
+	uint32_t Over31 = 0;
+
+	uint32_t Under1 = 0;
+
+	if (Values[1] > 31 || Values[1] == 0)
+	{
+		return(0);
+	}
+
+	for (uint32_t Index = 0; Index < 3; Index++)
+	{
+		if ((Values[Index] > 99 && Values[Index] < STRENGTH_MIN_YEAR) || Values[Index] > STRENGTH_MAX_YEAR)
+		{
+			return(0);
+		}
+
+		Over31 += (Values[Index] > 31);
+
+		Over12 += (Values[Index] > 12);
+
+		Under1 += (Values[Index] == 0);
+	}
+
+	if (Over31 >= 2 || Over12 == 3 || Under1 >= 2)
+	{
+		return(0);
+	}
+
+	// The year last, then first. A four-digit year decides it.
+	const uint32_t Years[2] = { Values[2], Values[0] };
+
+	const uint32_t Rests[2][2] = { { Values[0], Values[1] }, { Values[1], Values[2] } };
+
+	for (uint32_t Split = 0; Split < 2; Split++)
+	{
+		if (Years[Split] >= STRENGTH_MIN_YEAR && Years[Split] <= STRENGTH_MAX_YEAR)
+		{
+			return(IsDayMonth(Rests[Split][0], Rests[Split][1]) ? Years[Split] : 0);
+		}
+	}
+
+	for (uint32_t Split = 0; Split < 2; Split++)
+	{
+		if (IsDayMonth(Rests[Split][0], Rests[Split][1]))
+		{
+			return((Years[Split] > 99) ? Years[Split] : (Years[Split] > 50) ? 1900 + Years[Split] : 2000 + Years[Split]);
+		}
+	}
+
+	return(0);
+}
+
+static double YearSpace(const STRENGTH_STATE* State, uint32_t Year)
+{
+	uint32_t Space = (Year > State->Tables->ReferenceYear) ? Year - State->Tables->ReferenceYear : State->Tables->ReferenceYear - Year;
+
+	return((double)((Space < STRENGTH_MIN_YEAR_SPACE) ? STRENGTH_MIN_YEAR_SPACE : Space));
+}
+
+// Recent years, dates of 4 to 8 digits, and dates of three numbers with the same separator between them.
+static void MatchDates(STRENGTH_STATE* State)
+{
+	const uint16_t* Password = State->Password;
+
+	for (uint32_t Start = 0; Start < State->Length; Start++)
+	{
+		uint32_t Digits = 0;
+
+		while (Start + Digits < State->Length && Digits < 8 && IsDigit(Password[Start + Digits]))
+		{
+			Digits++;
+		}
+
+		if (Digits >= 4 && DigitsValue(Password + Start, 4) >= 1900 && DigitsValue(Password + Start, 4) <= 2099)
+		{
+			AddMatch(State, Start, Start + 3, YearSpace(State, DigitsValue(Password + Start, 4)));
+		}
+
+		for (uint32_t Length = 4; Length <= Digits; Length++)
+		{
+			uint32_t BestYear = 0;
+
+			for (uint32_t Split = 0; Split < 4 && gDateSplits[Length - 4][Split][0] != 0; Split++)
+			{
+				uint32_t First = gDateSplits[Length - 4][Split][0];
+
+				uint32_t Second = gDateSplits[Length - 4][Split][1];
+
+				uint32_t Values[3] = { DigitsValue(Password + Start, First), DigitsValue(Password + Start + First, Second - First), DigitsValue(Password + Start + Second, Length - Second) };
+
+				uint32_t Year = DateYear(Values);
+
+				if (Year != 0 && (BestYear == 0 || YearSpace(State, Year) < YearSpace(State, BestYear)))
+				{
+					BestYear = Year;
+				}
+			}
+
+			State->Work += 4;
+
+			if (BestYear != 0)
+			{
+				AddMatch(State, Start, Start + Length - 1, YearSpace(State, BestYear) * STRENGTH_DAYS_PER_YEAR);
+			}
+		}
+
+		// With separators: 1 to 4 digits, a separator, 1 or 2 digits, the same separator, and 1 to 4 digits.
+		uint32_t Position = Start + Digits;
+
+		if (Digits == 0 || Digits > 4 || Position + 3 >= State->Length)
+		{
+			continue;
+		}
+
+		uint16_t Separator = Password[Position];
+
+		if (Separator != L' ' && Separator != L'/' && Separator != L'\\' && Separator != L'_' && Separator != L'.' && Separator != L'-')
+		{
+			continue;
+		}
+
+		uint32_t Middle = 0;
+
+		while (Position + 1 + Middle < State->Length && Middle < 3 && IsDigit(Password[Position + 1 + Middle]))
+		{
+			Middle++;
+		}
+
+		uint32_t Last = Position + 1 + Middle + 1;
+
+		if (Middle == 0 || Middle > 2 || Last > State->Length || Password[Last - 1] != Separator)
+		{
+			continue;
+		}
+
+		for (uint32_t Length = 1; Length <= 4 && Last + Length <= State->Length && IsDigit(Password[Last + Length - 1]); Length++)
+		{
+			uint32_t Values[3] = { DigitsValue(Password + Start, Digits), DigitsValue(Password + Position + 1, Middle), DigitsValue(Password + Last, Length) };
+
+			uint32_t Year = DateYear(Values);
+
+			uint32_t Total = Last + Length - Start;
+
+			if (Year != 0 && Total >= 6 && Total <= 10)
+			{
+				AddMatch(State, Start, Last + Length - 1, YearSpace(State, Year) * STRENGTH_DAYS_PER_YEAR * STRENGTH_SEPARATOR_GUESSES);
+			}
+		}
+
+		State->Work += 4;
+	}
+}
+
+// The least product of guesses for the password before Start, in Pieces pieces, from Table, or 1 if Start is the beginning.
+static double Preceding(const double (*Table)[STRENGTH_MAX_PIECES], uint32_t Start, uint32_t Pieces)
+{
+	if (Start == 0)
+	{
+		return((Pieces == 0) ? 1.0 : STRENGTH_UNREACHABLE);
+	}
+
+	return((Pieces == 0) ? STRENGTH_UNREACHABLE : Table[Start - 1][Pieces - 1]);
+}
+
+// Every reading that ends with a piece from Start to End that Guesses guesses find.
+static void ReadPiece(STRENGTH_STATE* State, uint32_t Start, uint32_t End, double Guesses)
+{
+	for (uint32_t Pieces = 0; Pieces < STRENGTH_MAX_PIECES; Pieces++)
+	{
+		double Before = Preceding(State->Any, Start, Pieces);
+
+		if (Before == STRENGTH_UNREACHABLE)
+		{
+			continue;
+		}
+
+		double Product = Before * Guesses;
+
+		if (Product < State->Matched[End][Pieces])
+		{
+			State->Matched[End][Pieces] = Product;
+
+			if (Product < State->Any[End][Pieces])
+			{
+				State->Any[End][Pieces] = Product;
+			}
+		}
+	}
+
+	State->Work += STRENGTH_MAX_PIECES;
+}
+
+// A blacklist token from Start to End: the tokens of its length, times its capitalizations and its substituted spellings.
+static double DictionaryGuesses(STRENGTH_STATE* State, uint32_t Start, uint32_t End)
+{
+	uint32_t Length = End - Start + 1;
+
+	uint32_t Uppers = State->Uppers[End + 1] - State->Uppers[Start];
+
+	uint32_t Lowers = State->Lowers[End + 1] - State->Lowers[Start];
+
+	uint32_t Substituted = State->Substituted[End + 1] - State->Substituted[Start];
+
+	uint32_t Unsubstituted = State->Unsubstituted[End + 1] - State->Unsubstituted[Start];
+
+	double Guesses = State->Tables->TokensOfLength[Length];
+
+	if (Uppers > 0)
+	{
+		bool FirstOnly = (Uppers == 1 && State->Uppers[Start + 1] != State->Uppers[Start]);
+
+		bool LastOnly = (Uppers == 1 && State->Uppers[End + 1] != State->Uppers[End]);
+
+		Guesses *= (Lowers == 0 || FirstOnly || LastOnly) ? 2.0 : Variations(State, Uppers, Lowers);
+	}
+
+	if (Substituted > 0)
+	{
+		Guesses *= (Unsubstituted == 0) ? 2.0 : Variations(State, Substituted, Unsubstituted);
+	}
+
+	return(Guesses);
+}
+
+// Every token of Automaton that ends at End, found by following the dictionary links from State.
+static void ReadTokens(STRENGTH_STATE* State, const AC_AUTOMATON* Automaton, uint32_t AutomatonState, uint32_t End)
+{
+	uint32_t Match = AcFirstMatch(Automaton, AutomatonState);
+
+	while (Match != AC_ROOT_STATE && State->Work < STRENGTH_WORK_BUDGET)
+	{
+		uint32_t Depth = Automaton->States[Match].Depth;
+
+		uint32_t Start = End + 1 - Depth;
+
+		double Guesses = DictionaryGuesses(State, Start, End);
+
+		if (Depth < State->Length)
+		{
+			Guesses = (Guesses < STRENGTH_MIN_GUESSES_MULTI && Depth > 1) ? STRENGTH_MIN_GUESSES_MULTI : (Guesses < STRENGTH_MIN_GUESSES_SINGLE) ? STRENGTH_MIN_GUESSES_SINGLE : Guesses;
+		}
+
+		ReadPiece(State, Start, End, Guesses);
+
+		Match = Automaton->States[Match].DictionaryLink;
+
+		State->Work++;
+	}
+}
+
+/*
+Estimates how many guesses Password (PasswordLength characters, as typed) would take, into *Guesses. Canonical is the same
+password folded and canonicalized (see BlacklistCanonicalize), which the blacklist's tokens are looked for in. Automaton must
+have STRENGTH_TABLES (see StrengthTablesBuild). Overlay may be NULL. Work may be NULL; PassFiltExTool uses it to see how close
+estimates come to STRENGTH_WORK_BUDGET.
+
+*/
+STRENGTH_STATUS StrengthEstimate(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const uint16_t* Password, const uint16_t* Canonical, size_t PasswordLength, double* Guesses, uint64_t* Work)
+{
+	STRENGTH_STATE State;
+
+	uint32_t AutomatonState = AC_ROOT_STATE;
+
+	uint32_t OverlayState = AC_ROOT_STATE;
+
+	double Best = STRENGTH_UNREACHABLE;
+
+	double Factorial = 1.0;
+
+	double Penalty = 1.0;
+
+	*Guesses = 1.0;
+
+	if (PasswordLength > STRENGTH_MAX_PASSWORD_LENGTH)
+	{
+		return(StrengthTooLong);
+	}
+
+	if (PasswordLength == 0)
+	{
+		return(StrengthDone);
+	}
+
+	State.Tables = Automaton->Strength;
+
+	State.Password = Password;
+
+	State.Canonical = Canonical;
+
+	State.Length = (uint32_t)PasswordLength;
+
+	State.Work = 0;
+
+	State.MatchCount = 0;
+
+	memset(State.FirstMatch, 0, sizeof(State.FirstMatch));
+
+	State.Uppers[0] = State.Lowers[0] = State.Substituted[0] = State.Unsubstituted[0] = 0;
+
+	for (uint32_t Index = 0; Index < State.Length; Index++)
+	{
+		uint16_t Folded = NormalizeCharacter(Password[Index]);
+
+		bool Substituted = (Folded != Canonical[Index]);
+
+		State.Uppers[Index + 1] = (uint8_t)(State.Uppers[Index] + (Password[Index] >= L'A' && Password[Index] <= L'Z'));
+
+		State.Lowers[Index + 1] = (uint8_t)(State.Lowers[Index] + (Password[Index] >= L'a' && Password[Index] <= L'z'));
+
+		State.Substituted[Index + 1] = (uint8_t)(State.Substituted[Index] + Substituted);
+
+		State.Unsubstituted[Index + 1] = (uint8_t)(State.Unsubstituted[Index] + (Substituted == false && Folded < AC_ALPHABET_SIZE && State.Tables->GroupSizes[Folded] > 1));
+
+		for (uint32_t Pieces = 0; Pieces < STRENGTH_MAX_PIECES; Pieces++)
+		{
+			State.Matched[Index][Pieces] = STRENGTH_UNREACHABLE;
+
+			State.Any[Index][Pieces] = STRENGTH_UNREACHABLE;
+		}
+	}
+
+	for (uint32_t Pieces = 0; Pieces < STRENGTH_MAX_PIECES; Pieces++)
+	{
+		State.BruteForceFrom[Pieces] = STRENGTH_UNREACHABLE;
+	}
+
+	for (uint32_t Layout = 0; Layout < STRENGTH_LAYOUT_COUNT; Layout++)
+	{
+		MatchSpatial(&State, &State.Tables->Keyboards[Layout]);
+	}
+
+	MatchSequences(&State);
+
+	MatchRepeats(&State);
+
+	MatchDates(&State);
+
+	for (uint32_t End = 0; End < State.Length; End++)
+	{
+		// Brute force from End - 1 back. From Start on, it takes 10^(End + 1 - Start) guesses, so the least product over every
+		// start is a running minimum of what comes before each start divided by 10^Start, times 10^(End + 1).
+		if (End > 0)
+		{
+			for (uint32_t Pieces = 0; Pieces < STRENGTH_MAX_PIECES; Pieces++)
+			{
+				double Before = Preceding(State.Matched, End - 1, Pieces);
+
+				if (Before != STRENGTH_UNREACHABLE && Before * State.Tables->InversePowers[End - 1] < State.BruteForceFrom[Pieces])
+				{
+					State.BruteForceFrom[Pieces] = Before * State.Tables->InversePowers[End - 1];
+				}
+			}
+		}
+
+		for (uint32_t Pieces = 0; Pieces < STRENGTH_MAX_PIECES; Pieces++)
+		{
+			double Before = Preceding(State.Matched, End, Pieces);
+
+			double Product = STRENGTH_UNREACHABLE;
+
+			if (Before != STRENGTH_UNREACHABLE)
+			{
+				Product = Before * ((State.Length > 1) ? STRENGTH_BRUTEFORCE_GUESSES_SINGLE : 10.0);
+			}
+
+			if (State.BruteForceFrom[Pieces] != STRENGTH_UNREACHABLE && State.BruteForceFrom[Pieces] * State.Tables->Powers[End + 1] < Product)
+			{
+				Product = State.BruteForceFrom[Pieces] * State.Tables->Powers[End + 1];
+			}
+
+			State.Any[End][Pieces] = Product;
+		}
+
+		// Once the budget is gone, nothing more is looked for, so the automata are never needed again.
+		if (State.Work >= STRENGTH_WORK_BUDGET)
+		{
+			continue;
+		}
+
+		if (Canonical[End] < AC_ALPHABET_SIZE)
+		{
+			AutomatonState = AcNextState(Automaton, AutomatonState, Canonical[End]);
+
+			OverlayState = (Overlay != NULL) ? AcNextState(Overlay, OverlayState, Canonical[End]) : AC_ROOT_STATE;
+		}
+		else
+		{
+			AutomatonState = AC_ROOT_STATE;
+
+			OverlayState = AC_ROOT_STATE;
+		}
+
+		ReadTokens(&State, Automaton, AutomatonState, End);
+
+		if (Overlay != NULL)
+		{
+			ReadTokens(&State, Overlay, OverlayState, End);
+		}
+
+		for (uint32_t Next = State.FirstMatch[End]; Next != 0 && State.Work < STRENGTH_WORK_BUDGET; Next = State.Matches[Next - 1].Next)
+		{
+			ReadPiece(&State, State.Matches[Next - 1].Start, End, State.Matches[Next - 1].Guesses);
+		}
+	}
+
+	for (uint32_t Pieces = 0; Pieces < STRENGTH_MAX_PIECES; Pieces++)
+	{
+		Factorial *= (double)(Pieces + 1);
+
+		if (State.Any[State.Length - 1][Pieces] != STRENGTH_UNREACHABLE && Factorial * State.Any[State.Length - 1][Pieces] + Penalty < Best)
+		{
+			Best = Factorial * State.Any[State.Length - 1][Pieces] + Penalty;
+		}
+
+		Penalty *= STRENGTH_PIECE_PENALTY;
+	}
+
+	*Guesses = Best;
+
+	if (Work != NULL)
+	{
+		*Work = State.Work;
+	}
+
+	return((State.Work >= STRENGTH_WORK_BUDGET) ? StrengthOverBudget : StrengthDone);
+}
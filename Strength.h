@@ -0,0 +1,108 @@
+// Please read Strength.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "AhoCorasick.h"
+
+#include "TokenDawg.h"
+
+// The largest !strength a blacklist can ask for: a password has to take at least 10^n guesses.
+#define STRENGTH_MAX_MINIMUM 30
+
+// Longer passwords are not estimated. The blacklist still applies to them.
+#define STRENGTH_MAX_PASSWORD_LENGTH 128
+
+// The most pieces a password is taken apart into. Every piece multiplies the guesses by another factor, so passwords that need
+// more than this are far from the least guessable way of reading them.
+#define STRENGTH_MAX_PIECES 8
+
+// Keyboard walks, sequences, repeats and dates (not blacklist tokens, which are never stored) one estimate keeps track of.
+#define STRENGTH_MAX_MATCHES 256
+
+// Repeats of a unit longer than this aren't looked for.
+#define STRENGTH_MAX_REPEAT_UNIT 8
+
+// The most keys on a layout, and the directions a key can have a neighbor in.
+#define STRENGTH_MAX_KEYS 64
+
+#define STRENGTH_DIRECTIONS 8
+
+#define STRENGTH_LAYOUT_COUNT 2
+
+// Steps one estimate may take (a dictionary link followed, or one way of reading a piece weighed) before it stops looking for
+// more pieces. Each is a few nanoseconds, so this is a fraction of a millisecond, and far more than any real password needs.
+#define STRENGTH_WORK_BUDGET 100000
+
+typedef enum STRENGTH_STATUS
+{
+	StrengthDone,
+
+	// Ran out of STRENGTH_WORK_BUDGET. The guesses are what the pieces found up to then add up to, which is never fewer than
+	// the full estimate would have been.
+	StrengthOverBudget,
+
+	// The password is longer than STRENGTH_MAX_PASSWORD_LENGTH, and wasn't estimated.
+	StrengthTooLong
+
+} STRENGTH_STATUS;
+
+// For a character below 128, its key, with STRENGTH_SHIFTED set if it is the key's shifted character.
+#define STRENGTH_NO_KEY 0xFF
+
+#define STRENGTH_SHIFTED 0x80
+
+typedef struct STRENGTH_KEYBOARD
+{
+	uint8_t Keys[128];
+
+	// The key in each direction from a key, or STRENGTH_NO_KEY.
+	uint8_t Neighbors[STRENGTH_MAX_KEYS][STRENGTH_DIRECTIONS];
+
+	uint32_t DirectionCount;
+
+	// How many characters a walk can start on, and how many neighbors a character has on average.
+	double StartingPositions;
+
+	double AverageDegree;
+
+} STRENGTH_KEYBOARD;
+
+// Built once for each blacklist, when it is loaded, so that an estimate only ever looks things up. One block; free() frees it.
+typedef struct STRENGTH_TABLES
+{
+	// Passwords estimated at fewer guesses than this are rejected: 10 to the blacklist's !strength.
+	double Threshold;
+
+	// How many tokens of each length the blacklist has, which is how many guesses it takes to go through them.
+	double TokensOfLength[STRENGTH_MAX_PASSWORD_LENGTH + 1];
+
+	// 10 to the power of each length a password can have, and one over it.
+	double Powers[STRENGTH_MAX_PASSWORD_LENGTH + 2];
+
+	double InversePowers[STRENGTH_MAX_PASSWORD_LENGTH + 2];
+
+	// How many characters the blacklist's !substitute lines make the same as each one, itself included.
+	uint16_t GroupSizes[AC_ALPHABET_SIZE];
+
+	// The year that dates are counted from.
+	uint32_t ReferenceYear;
+
+	STRENGTH_KEYBOARD Keyboards[STRENGTH_LAYOUT_COUNT];
+
+} STRENGTH_TABLES;
+
+STRENGTH_TABLES* StrengthTablesBuild(const TOKEN_DAWG* Tokens, const AC_AUTOMATON* Automaton, uint32_t Minimum);
+
+STRENGTH_STATUS StrengthEstimate(const AC_AUTOMATON* Automaton, const AC_AUTOMATON* Overlay, const uint16_t* Password, const uint16_t* Canonical, size_t PasswordLength, double* Guesses, uint64_t* Work);
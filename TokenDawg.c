@@ -0,0 +1,748 @@
+/*
+TokenDawg.c
+
+The blacklist tokens as a minimized DAWG (directed acyclic word graph), bit-packed, in a fraction of the memory of a token store.
+
+A TOKEN_STORE costs every byte of every token plus a four byte offset for each one, and the automaton built from it (see
+AhoCorasick.c) costs 25 bytes or so for every node of its trie on top of that. Blacklists are anything but random, though.
+"password1", "password12" and "password123" start the same way, and "summer2024" and "winter2024" end the same way. A trie
+only shares the beginnings. A DAWG is a trie in which states that lead on to the same endings are merged, so each distinct
+ending is stored once, however many tokens end with it.
+
+  - It is built in one pass over a finished TOKEN_STORE, which is sorted, with the incremental algorithm of Daciuk, Mihov,
+    Watson and Watson. Once the next token turns away from the previous one, the states of the previous one it left behind can
+    no longer change. Each of them is either merged into an identical state that was built before, found through a hash
+    table, or added as a new one. What comes out is the smallest DAWG there is for those tokens.
+
+  - A state is a run of edges, one for each byte that can come next, in byte order. Whether a state ends a token is kept on
+    the edges into it, so two states that differ in nothing else are stored once. Each edge is a record of a fixed number of
+    bits: its byte, whether it is the last edge of its state, whether its target ends a token, the first edge of its target,
+    and its rank. The last two are only as wide as the list needs, so a small list has small records.
+
+  - Token i of the store is token i here as well. The rank of an edge is how many tokens are reached through the edges before
+    it in the same state, so the index of a token is the sum of the ranks along its path plus the number of shorter tokens
+    that it starts with (see PathIndex). TokenDawgGet goes the other way.
+
+  - The substring check reads the packed records as they are; nothing is unpacked. There are no failure links, so it walks
+    from the root once for every place in the password where a token could start. A token only counts if it is at least
+    half of the password (see BlacklistFindToken), so that is only the first half or so of the places, and each walk ends as
+    soon as the DAWG has no edge for the next character. That is more steps than the automaton takes, but each one is into
+    a table a tenth the size, which stays in the cache far better. PassFiltExTool dawg-bench times both, next to how much
+    memory each takes.
+
+  - This is how the DLL keeps the tokens once a blacklist is loaded (see BLACKLIST_SNAPSHOT). The token store they are loaded
+    into is freed as soon as the automaton and the DAWG have been built from it. TokenDawgGet says which token a password was
+    rejected for, and TokenDawgCountLengths how many tokens there are of each length, for the strength tables. The automaton
+    still does the checking, since fuzzy matching, the overlay and the name pass all walk its states.
+
+  - Edge 0 is never used, so that a target of 0 can mean the state that has no edges at all, where every token ends.
+
+Records are read 8 bytes at a time, so the table ends in a few bytes of padding. Like BlacklistImage.c, this assumes a
+little-endian machine.
+
+Platform-neutral C.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "TokenDawg.h"
+
+// The byte, the last edge bit and the final bit come before the target in every record.
+#define DAWG_HEAD_FLAG_BITS 10
+
+#define DAWG_LABEL_MASK 0xFF
+
+#define DAWG_LAST_EDGE 0x100
+
+#define DAWG_FINAL_TARGET 0x200
+
+// Enough for an 8 byte read at the start of the last record.
+#define DAWG_PADDING 8
+
+typedef struct DAWG_BUILD_EDGE
+{
+	uint32_t Target;
+
+	uint32_t Rank;
+
+	uint8_t Label;
+
+	bool Last;
+
+	bool Final;
+
+} DAWG_BUILD_EDGE;
+
+// A state on the path of the token being added. Only these can still get new edges.
+typedef struct DAWG_OPEN_STATE
+{
+	DAWG_BUILD_EDGE Edges[TOKEN_DAWG_ALPHABET_SIZE];
+
+	uint32_t EdgeCount;
+
+	// Tokens reached through the edges so far, which is the rank of the next one.
+	uint32_t Tokens;
+
+	bool Final;
+
+} DAWG_OPEN_STATE;
+
+// A state that has been built, by its first edge. First is 0 in an empty slot.
+typedef struct DAWG_TABLE_ENTRY
+{
+	uint32_t First;
+
+	uint32_t Hash;
+
+} DAWG_TABLE_ENTRY;
+
+typedef struct DAWG_BUILDER
+{
+	DAWG_OPEN_STATE Path[TOKEN_DAWG_MAX_LENGTH + 1];
+
+	// The edges of every state built so far, back to back.
+	DAWG_BUILD_EDGE* Edges;
+
+	size_t EdgeCount;
+
+	size_t EdgeCapacity;
+
+	// Open addressing. The size is a power of two, and it is never more than half full.
+	DAWG_TABLE_ENTRY* Table;
+
+	size_t TableSize;
+
+	size_t StateCount;
+
+} DAWG_BUILDER;
+
+static bool GrowArray(void** Array, size_t ElementSize, size_t* Capacity, size_t Needed)
+{
+	if (Needed <= *Capacity)
+	{
+		return(true);
+	}
+
+	size_t NewCapacity = (*Capacity == 0) ? 4096 : *Capacity;
+
+	while (NewCapacity < Needed)
+	{
+		NewCapacity *= 2;
+	}
+
+	void* NewArray = realloc(*Array, NewCapacity * ElementSize);
+
+	if (NewArray == NULL)
+	{
+		return(false);
+	}
+
+	*Array = NewArray;
+
+	*Capacity = NewCapacity;
+
+	return(true);
+}
+
+static uint32_t HashEdges(const DAWG_BUILD_EDGE* Edges, uint32_t Count)
+{
+	uint64_t Hash = 0xCBF29CE484222325ULL;
+
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		Hash ^= (uint64_t)Edges[Index].Label | ((uint64_t)Edges[Index].Final << 8) | ((uint64_t)Edges[Index].Target << 9);
+
+		Hash *= 0x100000001B3ULL;
+	}
+
+	return((uint32_t)(Hash ^ (Hash >> 32)));
+}
+
+// Whether the built state starting at First has exactly these edges. Ranks follow from the rest, so they needn't be compared.
+static bool SameEdges(const DAWG_BUILDER* Builder, uint32_t First, const DAWG_BUILD_EDGE* Edges, uint32_t Count)
+{
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		const DAWG_BUILD_EDGE* Built = &Builder->Edges[First + Index];
+
+		if (Built->Label != Edges[Index].Label || Built->Final != Edges[Index].Final || Built->Target != Edges[Index].Target)
+		{
+			return(false);
+		}
+
+		if (Built->Last != (Index + 1 == Count))
+		{
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+static bool GrowTable(DAWG_BUILDER* Builder)
+{
+	if ((Builder->StateCount + 1) * 2 <= Builder->TableSize)
+	{
+		return(true);
+	}
+
+	size_t NewSize = (Builder->TableSize == 0) ? 4096 : Builder->TableSize * 2;
+
+	DAWG_TABLE_ENTRY* NewTable = calloc(NewSize, sizeof(DAWG_TABLE_ENTRY));
+
+	if (NewTable == NULL)
+	{
+		return(false);
+	}
+
+	for (size_t Slot = 0; Slot < Builder->TableSize; Slot++)
+	{
+		if (Builder->Table[Slot].First == 0)
+		{
+			continue;
+		}
+
+		size_t NewSlot = Builder->Table[Slot].Hash & (NewSize - 1);
+
+		while (NewTable[NewSlot].First != 0)
+		{
+			NewSlot = (NewSlot + 1) & (NewSize - 1);
+		}
+
+		NewTable[NewSlot] = Builder->Table[Slot];
+	}
+
+	free(Builder->Table);
+
+	Builder->Table = NewTable;
+
+	Builder->TableSize = NewSize;
+
+	return(true);
+}
+
+// Finds a built state identical to State, or builds it, and returns its first edge in *First. A state without edges is 0.
+static bool CloseState(DAWG_BUILDER* Builder, const DAWG_OPEN_STATE* State, uint32_t* First)
+{
+	*First = 0;
+
+	if (State->EdgeCount == 0)
+	{
+		return(true);
+	}
+
+	if (GrowTable(Builder) == false)
+	{
+		return(false);
+	}
+
+	uint32_t Hash = HashEdges(State->Edges, State->EdgeCount);
+
+	size_t Slot = Hash & (Builder->TableSize - 1);
+
+	while (Builder->Table[Slot].First != 0)
+	{
+		if (Builder->Table[Slot].Hash == Hash && SameEdges(Builder, Builder->Table[Slot].First, State->Edges, State->EdgeCount))
+		{
+			*First = Builder->Table[Slot].First;
+
+			return(true);
+		}
+
+		Slot = (Slot + 1) & (Builder->TableSize - 1);
+	}
+
+	// Targets and the root are 32 bits wide.
+	if (Builder->EdgeCount + State->EdgeCount > UINT32_MAX)
+	{
+		return(false);
+	}
+
+	if (GrowArray((void**)&Builder->Edges, sizeof(DAWG_BUILD_EDGE), &Builder->EdgeCapacity, Builder->EdgeCount + State->EdgeCount) == false)
+	{
+		return(false);
+	}
+
+	*First = (uint32_t)Builder->EdgeCount;
+
+	memcpy(Builder->Edges + Builder->EdgeCount, State->Edges, State->EdgeCount * sizeof(DAWG_BUILD_EDGE));
+
+	Builder->EdgeCount += State->EdgeCount;
+
+	Builder->Edges[Builder->EdgeCount - 1].Last = true;
+
+	Builder->Table[Slot].First = *First;
+
+	Builder->Table[Slot].Hash = Hash;
+
+	Builder->StateCount++;
+
+	return(true);
+}
+
+// Closes the states of Token that are deeper than Depth, deepest first, and hangs each one off the state above it.
+static bool ClosePath(DAWG_BUILDER* Builder, const uint8_t* Token, uint32_t Length, uint32_t Depth)
+{
+	for (uint32_t Closing = Length; Closing > Depth; Closing--)
+	{
+		const DAWG_OPEN_STATE* State = &Builder->Path[Closing];
+
+		DAWG_OPEN_STATE* Parent = &Builder->Path[Closing - 1];
+
+		uint32_t First = 0;
+
+		if (CloseState(Builder, State, &First) == false)
+		{
+			return(false);
+		}
+
+		DAWG_BUILD_EDGE* Edge = &Parent->Edges[Parent->EdgeCount++];
+
+		Edge->Target = First;
+
+		Edge->Rank = Parent->Tokens;
+
+		Edge->Label = Token[Closing - 1];
+
+		Edge->Last = false;
+
+		Edge->Final = State->Final;
+
+		Parent->Tokens += (uint32_t)State->Final + State->Tokens;
+	}
+
+	return(true);
+}
+
+static uint32_t BitsFor(uint64_t Value)
+{
+	uint32_t Bits = 1;
+
+	while (Bits < 64 && (Value >> Bits) != 0)
+	{
+		Bits++;
+	}
+
+	return(Bits);
+}
+
+// Bits is all zeros to begin with.
+static void WriteBits(uint8_t* Bits, uint64_t Offset, uint64_t Value, uint32_t Width)
+{
+	while (Width > 0)
+	{
+		uint32_t Shift = (uint32_t)(Offset & 7);
+
+		uint32_t Taken = (8 - Shift < Width) ? 8 - Shift : Width;
+
+		Bits[Offset >> 3] |= (uint8_t)((Value & ((1U << Taken) - 1)) << Shift);
+
+		Value >>= Taken;
+
+		Offset += Taken;
+
+		Width -= Taken;
+	}
+}
+
+// Width is never more than 56, so one 8 byte read always has every bit of the field.
+static uint64_t ReadBits(const uint8_t* Bits, uint64_t Offset, uint32_t Width)
+{
+	uint64_t Value = 0;
+
+	memcpy(&Value, Bits + (Offset >> 3), sizeof(Value));
+
+	return((Value >> (Offset & 7)) & ((1ULL << Width) - 1));
+}
+
+// Lays the built edges out as records. Target and rank are at most 32 bits each, so a record's head is at most 42 bits.
+static bool PackEdges(const DAWG_BUILDER* Builder, uint32_t TokenCount, TOKEN_DAWG* Dawg)
+{
+	Dawg->EdgeCount = (uint32_t)Builder->EdgeCount;
+
+	Dawg->TargetBits = BitsFor(Builder->EdgeCount - 1);
+
+	Dawg->RankBits = BitsFor(TokenCount);
+
+	Dawg->EdgeBits = DAWG_HEAD_FLAG_BITS + Dawg->TargetBits + Dawg->RankBits;
+
+	Dawg->BitsSize = (size_t)((((uint64_t)Dawg->EdgeCount * Dawg->EdgeBits) + 7) / 8) + DAWG_PADDING;
+
+	uint8_t* Bits = calloc(1, Dawg->BitsSize);
+
+	if (Bits == NULL)
+	{
+		return(false);
+	}
+
+	for (uint32_t Edge = 1; Edge < Dawg->EdgeCount; Edge++)
+	{
+		const DAWG_BUILD_EDGE* Built = &Builder->Edges[Edge];
+
+		uint64_t Head = (uint64_t)Built->Label | (Built->Last ? DAWG_LAST_EDGE : 0) | (Built->Final ? DAWG_FINAL_TARGET : 0) | ((uint64_t)Built->Target << DAWG_HEAD_FLAG_BITS);
+
+		uint64_t Offset = (uint64_t)Edge * Dawg->EdgeBits;
+
+		WriteBits(Bits, Offset, Head, DAWG_HEAD_FLAG_BITS + Dawg->TargetBits);
+
+		WriteBits(Bits, Offset + DAWG_HEAD_FLAG_BITS + Dawg->TargetBits, Built->Rank, Dawg->RankBits);
+	}
+
+	Dawg->Bits = Bits;
+
+	Dawg->Allocation = Bits;
+
+	return(true);
+}
+
+static uint64_t EdgeHead(const TOKEN_DAWG* Dawg, uint32_t Edge)
+{
+	return(ReadBits(Dawg->Bits, (uint64_t)Edge * Dawg->EdgeBits, DAWG_HEAD_FLAG_BITS + Dawg->TargetBits));
+}
+
+static uint32_t EdgeRank(const TOKEN_DAWG* Dawg, uint32_t Edge)
+{
+	return((uint32_t)ReadBits(Dawg->Bits, ((uint64_t)Edge * Dawg->EdgeBits) + DAWG_HEAD_FLAG_BITS + Dawg->TargetBits, Dawg->RankBits));
+}
+
+/*
+Builds a DAWG of every token in Tokens, which must be sorted and free of duplicates, as TokenStoreBuilderFinish leaves them.
+Fails if they aren't, if a token is empty or longer than TOKEN_DAWG_MAX_LENGTH, or if memory runs out. Tokens can be freed
+afterwards.
+
+*/
+bool TokenDawgBuild(const TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg)
+{
+	bool Result = false;
+
+	const uint8_t* Previous = NULL;
+
+	uint32_t PreviousLength = 0;
+
+	DAWG_BUILDER* Builder = calloc(1, sizeof(DAWG_BUILDER));
+
+	memset(Dawg, 0, sizeof(TOKEN_DAWG));
+
+	// Edge 0 is never used.
+	if (Builder == NULL || GrowArray((void**)&Builder->Edges, sizeof(DAWG_BUILD_EDGE), &Builder->EdgeCapacity, 1) == false)
+	{
+		goto End;
+	}
+
+	memset(Builder->Edges, 0, sizeof(DAWG_BUILD_EDGE));
+
+	Builder->EdgeCount = 1;
+
+	for (uint32_t Index = 0; Index < Tokens->TokenCount; Index++)
+	{
+		uint32_t Length = 0;
+
+		const uint8_t* Token = TokenStoreGet(Tokens, Index, &Length);
+
+		uint32_t Common = 0;
+
+		if (Length == 0 || Length > TOKEN_DAWG_MAX_LENGTH)
+		{
+			goto End;
+		}
+
+		while (Common < Length && Common < PreviousLength && Token[Common] == Previous[Common])
+		{
+			Common++;
+		}
+
+		// Every token must come after the one before it.
+		if (Index > 0 && (Common == Length || (Common < PreviousLength && Token[Common] < Previous[Common])))
+		{
+			goto End;
+		}
+
+		if (ClosePath(Builder, Previous, PreviousLength, Common) == false)
+		{
+			goto End;
+		}
+
+		for (uint32_t Depth = Common + 1; Depth <= Length; Depth++)
+		{
+			Builder->Path[Depth].EdgeCount = 0;
+
+			Builder->Path[Depth].Tokens = 0;
+
+			Builder->Path[Depth].Final = false;
+		}
+
+		Builder->Path[Length].Final = true;
+
+		Previous = Token;
+
+		PreviousLength = Length;
+	}
+
+	if (ClosePath(Builder, Previous, PreviousLength, 0) == false || CloseState(Builder, &Builder->Path[0], &Dawg->Root) == false)
+	{
+		goto End;
+	}
+
+	if (PackEdges(Builder, Tokens->TokenCount, Dawg) == false)
+	{
+		goto End;
+	}
+
+	Dawg->TokenCount = Tokens->TokenCount;
+
+	for (uint32_t Edge = Dawg->Root; Edge != 0; Edge++)
+	{
+		uint64_t Head = EdgeHead(Dawg, Edge);
+
+		Dawg->RootEdges[Head & DAWG_LABEL_MASK] = Edge;
+
+		if ((Head & DAWG_LAST_EDGE) != 0)
+		{
+			break;
+		}
+	}
+
+	Result = true;
+
+End:
+
+	if (Builder != NULL)
+	{
+		free(Builder->Edges);
+
+		free(Builder->Table);
+
+		free(Builder);
+	}
+
+	return(Result);
+}
+
+void TokenDawgFree(TOKEN_DAWG* Dawg)
+{
+	free(Dawg->Allocation);
+
+	memset(Dawg, 0, sizeof(TOKEN_DAWG));
+}
+
+size_t TokenDawgMemoryUsage(const TOKEN_DAWG* Dawg)
+{
+	return(sizeof(TOKEN_DAWG) + Dawg->BitsSize);
+}
+
+// The edge labelled Label out of the state whose edges start at First, or 0 if it has none. First must not be 0.
+static uint32_t FindEdge(const TOKEN_DAWG* Dawg, uint32_t First, uint8_t Label, uint64_t* Head)
+{
+	for (uint32_t Edge = First; ; Edge++)
+	{
+		*Head = EdgeHead(Dawg, Edge);
+
+		uint32_t EdgeLabel = (uint32_t)(*Head & DAWG_LABEL_MASK);
+
+		if (EdgeLabel == Label)
+		{
+			return(Edge);
+		}
+
+		// Edges are in byte order, so it can't be any further along.
+		if (EdgeLabel > Label || (*Head & DAWG_LAST_EDGE) != 0)
+		{
+			return(0);
+		}
+	}
+}
+
+// The index of the token spelled by the first Length edges of Path, which must end on a state that ends a token.
+static uint32_t PathIndex(const TOKEN_DAWG* Dawg, const uint32_t* Path, uint32_t Length)
+{
+	uint32_t Index = 0;
+
+	for (uint32_t Depth = 0; Depth < Length; Depth++)
+	{
+		Index += EdgeRank(Dawg, Path[Depth]);
+
+		// A shorter token that this one starts with comes before it.
+		if (Depth + 1 < Length && (EdgeHead(Dawg, Path[Depth]) & DAWG_FINAL_TARGET) != 0)
+		{
+			Index++;
+		}
+	}
+
+	return(Index);
+}
+
+// The index of Token, the same as in the TOKEN_STORE the DAWG was built from, or TOKEN_DAWG_NO_TOKEN if it isn't one.
+uint32_t TokenDawgIndex(const TOKEN_DAWG* Dawg, const uint8_t* Token, uint32_t Length)
+{
+	uint32_t Path[TOKEN_DAWG_MAX_LENGTH];
+
+	uint64_t Head = 0;
+
+	if (Length == 0 || Length > TOKEN_DAWG_MAX_LENGTH || (Path[0] = Dawg->RootEdges[Token[0]]) == 0)
+	{
+		return(TOKEN_DAWG_NO_TOKEN);
+	}
+
+	Head = EdgeHead(Dawg, Path[0]);
+
+	for (uint32_t Depth = 1; Depth < Length; Depth++)
+	{
+		uint32_t Target = (uint32_t)(Head >> DAWG_HEAD_FLAG_BITS);
+
+		if (Target == 0 || (Path[Depth] = FindEdge(Dawg, Target, Token[Depth], &Head)) == 0)
+		{
+			return(TOKEN_DAWG_NO_TOKEN);
+		}
+	}
+
+	return(((Head & DAWG_FINAL_TARGET) != 0) ? PathIndex(Dawg, Path, Length) : TOKEN_DAWG_NO_TOKEN);
+}
+
+// Copies token Index into Token, which must have room for TOKEN_DAWG_MAX_LENGTH bytes, and returns its length. 0 if there is no such token.
+uint32_t TokenDawgGet(const TOKEN_DAWG* Dawg, uint32_t Index, uint8_t* Token)
+{
+	uint32_t State = Dawg->Root;
+
+	uint32_t Length = 0;
+
+	if (Index >= Dawg->TokenCount)
+	{
+		return(0);
+	}
+
+	while (State != 0 && Length < TOKEN_DAWG_MAX_LENGTH)
+	{
+		uint32_t Edge = State;
+
+		// The last edge whose rank isn't past Index. Every token before it went through an earlier edge.
+		while ((EdgeHead(Dawg, Edge) & DAWG_LAST_EDGE) == 0 && EdgeRank(Dawg, Edge + 1) <= Index)
+		{
+			Edge++;
+		}
+
+		uint64_t Head = EdgeHead(Dawg, Edge);
+
+		Index -= EdgeRank(Dawg, Edge);
+
+		Token[Length++] = (uint8_t)(Head & DAWG_LABEL_MASK);
+
+		if ((Head & DAWG_FINAL_TARGET) != 0)
+		{
+			if (Index == 0)
+			{
+				return(Length);
+			}
+
+			Index--;
+		}
+
+		State = (uint32_t)(Head >> DAWG_HEAD_FLAG_BITS);
+	}
+
+	// Only a damaged DAWG gets here.
+	return(0);
+}
+
+/*
+Counts the tokens of every length into Counts, which must have room for TOKEN_DAWG_MAX_LENGTH + 1 of them. Goes down every path
+once, which is one step for every node of the trie the DAWG stands for, so it is for loading a blacklist, not for checking a
+password against one.
+
+*/
+void TokenDawgCountLengths(const TOKEN_DAWG* Dawg, uint32_t* Counts)
+{
+	// The edge being followed at each depth.
+	uint32_t Path[TOKEN_DAWG_MAX_LENGTH];
+
+	uint32_t Depth = 0;
+
+	memset(Counts, 0, (TOKEN_DAWG_MAX_LENGTH + 1) * sizeof(uint32_t));
+
+	if ((Path[0] = Dawg->Root) == 0)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		uint64_t Head = EdgeHead(Dawg, Path[Depth]);
+
+		uint32_t Target = (uint32_t)(Head >> DAWG_HEAD_FLAG_BITS);
+
+		if ((Head & DAWG_FINAL_TARGET) != 0)
+		{
+			Counts[Depth + 1]++;
+		}
+
+		if (Target != 0 && Depth + 1 < TOKEN_DAWG_MAX_LENGTH)
+		{
+			Path[++Depth] = Target;
+
+			continue;
+		}
+
+		// On to the next edge of the deepest state that has one left.
+		while ((EdgeHead(Dawg, Path[Depth]) & DAWG_LAST_EDGE) != 0)
+		{
+			if (Depth == 0)
+			{
+				return;
+			}
+
+			Depth--;
+		}
+
+		Path[Depth]++;
+	}
+}
+
+/*
+The same search as BlacklistFindToken, without the overlay and the names: returns the index of a token that is in the
+password and makes up at least half of it, or TOKEN_DAWG_NO_TOKEN. Of several such tokens, the first to start is the one
+found, and of those the shortest, where the automaton finds the first to end. The verdict is the same either way.
+
+*/
+uint32_t TokenDawgFindToken(const TOKEN_DAWG* Dawg, const uint16_t* Password, size_t PasswordLength)
+{
+	uint32_t Path[TOKEN_DAWG_MAX_LENGTH];
+
+	// Tokens that start any later than this are too short to count.
+	size_t LastStart = PasswordLength / 2;
+
+	for (size_t Start = 0; Start <= LastStart && Start < PasswordLength; Start++)
+	{
+		if (Password[Start] >= TOKEN_DAWG_ALPHABET_SIZE || (Path[0] = Dawg->RootEdges[Password[Start]]) == 0)
+		{
+			continue;
+		}
+
+		uint64_t Head = EdgeHead(Dawg, Path[0]);
+
+		for (uint32_t Depth = 1; ; Depth++)
+		{
+			if ((Head & DAWG_FINAL_TARGET) != 0 && (size_t)Depth * 2 >= PasswordLength)
+			{
+				return(PathIndex(Dawg, Path, Depth));
+			}
+
+			uint32_t Target = (uint32_t)(Head >> DAWG_HEAD_FLAG_BITS);
+
+			size_t Next = Start + Depth;
+
+			if (Target == 0 || Next == PasswordLength || Password[Next] >= TOKEN_DAWG_ALPHABET_SIZE || Depth == TOKEN_DAWG_MAX_LENGTH)
+			{
+				break;
+			}
+
+			if ((Path[Depth] = FindEdge(Dawg, Target, (uint8_t)Password[Next], &Head)) == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return(TOKEN_DAWG_NO_TOKEN);
+}
@@ -0,0 +1,68 @@
+// Please read TokenDawg.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+#include "TokenStore.h"
+
+// Tokens are bytes, like the automaton's patterns.
+#define TOKEN_DAWG_ALPHABET_SIZE 256
+
+// Longer tokens can't be built into a DAWG. The blacklist never has any (see MAX_BLACKLIST_STRING_SIZE).
+#define TOKEN_DAWG_MAX_LENGTH 255
+
+// Same value as AC_NO_PATTERN, so that either kind of index can go wherever a pattern ID goes.
+#define TOKEN_DAWG_NO_TOKEN 0xFFFFFFFF
+
+typedef struct TOKEN_DAWG
+{
+	uint32_t TokenCount;
+
+	// Edge records, including the unused edge 0.
+	uint32_t EdgeCount;
+
+	// First edge of the root state, or 0 if there are no tokens.
+	uint32_t Root;
+
+	// Width of an edge record, and of its target and rank fields.
+	uint32_t EdgeBits;
+
+	uint32_t TargetBits;
+
+	uint32_t RankBits;
+
+	// The root's edge for each first byte, or 0. Every search starts here, many times over, so it's worth the kilobyte.
+	uint32_t RootEdges[TOKEN_DAWG_ALPHABET_SIZE];
+
+	const uint8_t* Bits;
+
+	size_t BitsSize;
+
+	void* Allocation;
+
+} TOKEN_DAWG;
+
+bool TokenDawgBuild(const TOKEN_STORE* Tokens, TOKEN_DAWG* Dawg);
+
+void TokenDawgFree(TOKEN_DAWG* Dawg);
+
+size_t TokenDawgMemoryUsage(const TOKEN_DAWG* Dawg);
+
+uint32_t TokenDawgIndex(const TOKEN_DAWG* Dawg, const uint8_t* Token, uint32_t Length);
+
+uint32_t TokenDawgGet(const TOKEN_DAWG* Dawg, uint32_t Index, uint8_t* Token);
+
+void TokenDawgCountLengths(const TOKEN_DAWG* Dawg, uint32_t* Counts);
+
+uint32_t TokenDawgFindToken(const TOKEN_DAWG* Dawg, const uint16_t* Password, size_t PasswordLength);
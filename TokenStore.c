@@ -0,0 +1,429 @@
+/*
+TokenStore.c
+
+Packed, sorted, deduplicated storage for blacklist tokens.
+
+Every BADSTRING used to embed a 128-wchar_t array and a Next pointer, and every one of them was its own heap allocation.
+An 8 character token cost over 260 bytes before heap overhead, which adds up fast inside lsass when the list is big.
+
+Here all of the tokens are packed back to back, one byte per character, into one block, with an offset array
+to find where each one starts. The list is sorted and duplicates are dropped, so a token's index is also its rank in sorted
+order, and walking the tokens walks memory front to back. Freeing the whole store is a single free().
+
+Platform-neutral C.
+
+*/
+
+#include <stdlib.h>
+
+#include <string.h>
+
+#include "TokenStore.h"
+
+struct TOKEN_STORE_BUILDER
+{
+	uint8_t* Bytes;
+
+	size_t ByteCount;
+
+	size_t ByteCapacity;
+
+	// Tokens as they were added. Unlike the finished store, these are not sorted and may repeat.
+	uint32_t* Offsets;
+
+	size_t TokenCapacity;
+
+	uint32_t TokenCount;
+};
+
+static bool GrowArray(void** Array, size_t ElementSize, size_t* Capacity, size_t Needed)
+{
+	if (Needed <= *Capacity)
+	{
+		return(true);
+	}
+
+	size_t NewCapacity = (*Capacity == 0) ? 4096 : *Capacity;
+
+	while (NewCapacity < Needed)
+	{
+		NewCapacity *= 2;
+	}
+
+	void* NewArray = realloc(*Array, NewCapacity * ElementSize);
+
+	if (NewArray == NULL)
+	{
+		return(false);
+	}
+
+	*Array = NewArray;
+
+	*Capacity = NewCapacity;
+
+	return(true);
+}
+
+// Tokens are appended back to back, so each one ends where the next one starts.
+static uint32_t BuilderTokenLength(const TOKEN_STORE_BUILDER* Builder, uint32_t Index)
+{
+	size_t End = (Index + 1 < Builder->TokenCount) ? Builder->Offsets[Index + 1] : Builder->ByteCount;
+
+	return((uint32_t)(End - Builder->Offsets[Index]));
+}
+
+static int CompareTokens(const TOKEN_STORE_BUILDER* Builder, uint32_t Left, uint32_t Right)
+{
+	uint32_t LeftLength = BuilderTokenLength(Builder, Left);
+
+	uint32_t RightLength = BuilderTokenLength(Builder, Right);
+
+	int Result = memcmp(Builder->Bytes + Builder->Offsets[Left], Builder->Bytes + Builder->Offsets[Right], (LeftLength < RightLength) ? LeftLength : RightLength);
+
+	if (Result != 0)
+	{
+		return(Result);
+	}
+
+	return((LeftLength > RightLength) - (LeftLength < RightLength));
+}
+
+// Bottom-up merge sort of token numbers. qsort can't be used because its comparator has no context pointer,
+// and qsort_s and qsort_r don't agree with each other across platforms.
+static uint32_t* SortTokens(const TOKEN_STORE_BUILDER* Builder)
+{
+	uint32_t Count = Builder->TokenCount;
+
+	uint32_t* Source = malloc(((size_t)Count + 1) * sizeof(uint32_t));
+
+	uint32_t* Target = malloc(((size_t)Count + 1) * sizeof(uint32_t));
+
+	if (Source == NULL || Target == NULL)
+	{
+		free(Source);
+
+		free(Target);
+
+		return(NULL);
+	}
+
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		Source[Index] = Index;
+	}
+
+	for (size_t Width = 1; Width < Count; Width *= 2)
+	{
+		for (size_t Start = 0; Start < Count; Start += 2 * Width)
+		{
+			size_t Middle = (Start + Width < Count) ? Start + Width : Count;
+
+			size_t End = (Start + (2 * Width) < Count) ? Start + (2 * Width) : Count;
+
+			size_t Left = Start;
+
+			size_t Right = Middle;
+
+			size_t Output = Start;
+
+			while (Left < Middle && Right < End)
+			{
+				Target[Output++] = (CompareTokens(Builder, Source[Left], Source[Right]) <= 0) ? Source[Left++] : Source[Right++];
+			}
+
+			while (Left < Middle)
+			{
+				Target[Output++] = Source[Left++];
+			}
+
+			while (Right < End)
+			{
+				Target[Output++] = Source[Right++];
+			}
+		}
+
+		uint32_t* Swap = Source;
+
+		Source = Target;
+
+		Target = Swap;
+	}
+
+	free(Target);
+
+	return(Source);
+}
+
+TOKEN_STORE_BUILDER* TokenStoreBuilderCreate(void)
+{
+	return(calloc(1, sizeof(TOKEN_STORE_BUILDER)));
+}
+
+bool TokenStoreBuilderAdd(TOKEN_STORE_BUILDER* Builder, const uint8_t* Token, uint32_t Length)
+{
+	// Offsets are 32 bits wide, and so is the finished store.
+	if (Builder->ByteCount + Length > UINT32_MAX || Builder->TokenCount == UINT32_MAX - 1)
+	{
+		return(false);
+	}
+
+	if (GrowArray((void**)&Builder->Bytes, 1, &Builder->ByteCapacity, Builder->ByteCount + Length) == false)
+	{
+		return(false);
+	}
+
+	if (GrowArray((void**)&Builder->Offsets, sizeof(uint32_t), &Builder->TokenCapacity, (size_t)Builder->TokenCount + 1) == false)
+	{
+		return(false);
+	}
+
+	memcpy(Builder->Bytes + Builder->ByteCount, Token, Length);
+
+	Builder->Offsets[Builder->TokenCount] = (uint32_t)Builder->ByteCount;
+
+	Builder->ByteCount += Length;
+
+	Builder->TokenCount++;
+
+	return(true);
+}
+
+uint32_t TokenStoreBuilderCount(const TOKEN_STORE_BUILDER* Builder)
+{
+	return(Builder->TokenCount);
+}
+
+// Sorts, removes duplicates and packs everything into one block. The builder can be destroyed afterwards.
+bool TokenStoreBuilderFinish(TOKEN_STORE_BUILDER* Builder, TOKEN_STORE* Store)
+{
+	uint32_t* Order = NULL;
+
+	uint32_t UniqueCount = 0;
+
+	size_t UniqueBytes = 0;
+
+	memset(Store, 0, sizeof(TOKEN_STORE));
+
+	if ((Order = SortTokens(Builder)) == NULL)
+	{
+		return(false);
+	}
+
+	for (uint32_t Index = 0; Index < Builder->TokenCount; Index++)
+	{
+		if (Index > 0 && CompareTokens(Builder, Order[Index - 1], Order[Index]) == 0)
+		{
+			continue;
+		}
+
+		Order[UniqueCount++] = Order[Index];
+
+		UniqueBytes += BuilderTokenLength(Builder, Order[Index]);
+	}
+
+	size_t OffsetBytes = ((size_t)UniqueCount + 1) * sizeof(uint32_t);
+
+	uint8_t* Allocation = malloc(OffsetBytes + UniqueBytes + 1);
+
+	if (Allocation == NULL)
+	{
+		free(Order);
+
+		return(false);
+	}
+
+	uint32_t* Offsets = (uint32_t*)(void*)Allocation;
+
+	uint8_t* Bytes = Allocation + OffsetBytes;
+
+	uint32_t Cursor = 0;
+
+	for (uint32_t Index = 0; Index < UniqueCount; Index++)
+	{
+		uint32_t Length = BuilderTokenLength(Builder, Order[Index]);
+
+		memcpy(Bytes + Cursor, Builder->Bytes + Builder->Offsets[Order[Index]], Length);
+
+		Offsets[Index] = Cursor;
+
+		Cursor += Length;
+	}
+
+	Offsets[UniqueCount] = Cursor;
+
+	free(Order);
+
+	Store->TokenCount = UniqueCount;
+
+	Store->ByteCount = Cursor;
+
+	Store->Offsets = Offsets;
+
+	Store->Bytes = Bytes;
+
+	Store->Allocation = Allocation;
+
+	return(true);
+}
+
+static int CompareStoredTokens(const TOKEN_STORE* Left, uint32_t LeftIndex, const TOKEN_STORE* Right, uint32_t RightIndex)
+{
+	uint32_t LeftLength = 0;
+
+	uint32_t RightLength = 0;
+
+	const uint8_t* LeftToken = TokenStoreGet(Left, LeftIndex, &LeftLength);
+
+	const uint8_t* RightToken = TokenStoreGet(Right, RightIndex, &RightLength);
+
+	int Result = memcmp(LeftToken, RightToken, (LeftLength < RightLength) ? LeftLength : RightLength);
+
+	if (Result != 0)
+	{
+		return(Result);
+	}
+
+	return((LeftLength > RightLength) - (LeftLength < RightLength));
+}
+
+/*
+Merges two finished stores into a new one, sorted and without duplicates, just as if every token of both had gone through one
+builder. BlacklistLoadParallel finishes a store for each piece of the file at the same time, and merges them pairwise after.
+Left and Right are left alone, and can be freed afterwards.
+
+*/
+bool TokenStoreMerge(const TOKEN_STORE* Left, const TOKEN_STORE* Right, TOKEN_STORE* Store)
+{
+	uint32_t LeftIndex = 0;
+
+	uint32_t RightIndex = 0;
+
+	uint32_t Count = 0;
+
+	uint32_t Cursor = 0;
+
+	memset(Store, 0, sizeof(TOKEN_STORE));
+
+	// Room for the worst case, where no token is in both.
+	if ((uint64_t)Left->ByteCount + Right->ByteCount > UINT32_MAX || (uint64_t)Left->TokenCount + Right->TokenCount >= UINT32_MAX - 1)
+	{
+		return(false);
+	}
+
+	size_t OffsetBytes = ((size_t)Left->TokenCount + Right->TokenCount + 1) * sizeof(uint32_t);
+
+	uint8_t* Allocation = malloc(OffsetBytes + Left->ByteCount + Right->ByteCount + 1);
+
+	if (Allocation == NULL)
+	{
+		return(false);
+	}
+
+	uint32_t* Offsets = (uint32_t*)(void*)Allocation;
+
+	uint8_t* Bytes = Allocation + OffsetBytes;
+
+	while (LeftIndex < Left->TokenCount || RightIndex < Right->TokenCount)
+	{
+		int Order = (LeftIndex == Left->TokenCount) ? 1 : (RightIndex == Right->TokenCount) ? -1 : CompareStoredTokens(Left, LeftIndex, Right, RightIndex);
+
+		uint32_t Length = 0;
+
+		const uint8_t* Token = (Order <= 0) ? TokenStoreGet(Left, LeftIndex, &Length) : TokenStoreGet(Right, RightIndex, &Length);
+
+		LeftIndex += (Order <= 0);
+
+		RightIndex += (Order >= 0);
+
+		memcpy(Bytes + Cursor, Token, Length);
+
+		Offsets[Count++] = Cursor;
+
+		Cursor += Length;
+	}
+
+	Offsets[Count] = Cursor;
+
+	Store->TokenCount = Count;
+
+	Store->ByteCount = Cursor;
+
+	Store->Offsets = Offsets;
+
+	Store->Bytes = Bytes;
+
+	Store->Allocation = Allocation;
+
+	return(true);
+}
+
+void TokenStoreBuilderDestroy(TOKEN_STORE_BUILDER* Builder)
+{
+	if (Builder != NULL)
+	{
+		free(Builder->Bytes);
+
+		free(Builder->Offsets);
+
+		free(Builder);
+	}
+}
+
+void TokenStoreFree(TOKEN_STORE* Store)
+{
+	free(Store->Allocation);
+
+	memset(Store, 0, sizeof(TOKEN_STORE));
+}
+
+size_t TokenStoreMemoryUsage(const TOKEN_STORE* Store)
+{
+	return((((size_t)Store->TokenCount + 1) * sizeof(uint32_t)) + Store->ByteCount);
+}
+
+const uint8_t* TokenStoreGet(const TOKEN_STORE* Store, uint32_t Index, uint32_t* Length)
+{
+	*Length = Store->Offsets[Index + 1] - Store->Offsets[Index];
+
+	return(Store->Bytes + Store->Offsets[Index]);
+}
+
+// The index of Token in a finished store, found by binary search since the store is sorted, or TOKEN_STORE_NOT_FOUND.
+uint32_t TokenStoreFind(const TOKEN_STORE* Store, const uint8_t* Token, uint32_t Length)
+{
+	uint32_t Low = 0;
+
+	uint32_t High = Store->TokenCount;
+
+	while (Low < High)
+	{
+		uint32_t Middle = Low + ((High - Low) / 2);
+
+		uint32_t MiddleLength = 0;
+
+		const uint8_t* MiddleToken = TokenStoreGet(Store, Middle, &MiddleLength);
+
+		int Result = memcmp(MiddleToken, Token, (MiddleLength < Length) ? MiddleLength : Length);
+
+		if (Result == 0)
+		{
+			Result = (MiddleLength > Length) - (MiddleLength < Length);
+		}
+
+		if (Result == 0)
+		{
+			return(Middle);
+		}
+
+		if (Result < 0)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+
+	return(TOKEN_STORE_NOT_FOUND);
+}
@@ -0,0 +1,56 @@
+// Please read TokenStore.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+// Token i is Bytes[Offsets[i]] up to, but not including, Bytes[Offsets[i + 1]].
+typedef struct TOKEN_STORE
+{
+	uint32_t TokenCount;
+
+	uint32_t ByteCount;
+
+	const uint32_t* Offsets;
+
+	const uint8_t* Bytes;
+
+	// The offsets and the bytes live in this one block. NULL if the store points into memory that belongs to someone else.
+	void* Allocation;
+
+} TOKEN_STORE;
+
+// What TokenStoreFind returns for a token that isn't in the store.
+#define TOKEN_STORE_NOT_FOUND 0xFFFFFFFF
+
+typedef struct TOKEN_STORE_BUILDER TOKEN_STORE_BUILDER;
+
+TOKEN_STORE_BUILDER* TokenStoreBuilderCreate(void);
+
+bool TokenStoreBuilderAdd(TOKEN_STORE_BUILDER* Builder, const uint8_t* Token, uint32_t Length);
+
+uint32_t TokenStoreBuilderCount(const TOKEN_STORE_BUILDER* Builder);
+
+bool TokenStoreBuilderFinish(TOKEN_STORE_BUILDER* Builder, TOKEN_STORE* Store);
+
+void TokenStoreBuilderDestroy(TOKEN_STORE_BUILDER* Builder);
+
+bool TokenStoreMerge(const TOKEN_STORE* Left, const TOKEN_STORE* Right, TOKEN_STORE* Store);
+
+void TokenStoreFree(TOKEN_STORE* Store);
+
+size_t TokenStoreMemoryUsage(const TOKEN_STORE* Store);
+
+const uint8_t* TokenStoreGet(const TOKEN_STORE* Store, uint32_t Index, uint32_t* Length);
+
+uint32_t TokenStoreFind(const TOKEN_STORE* Store, const uint8_t* Token, uint32_t Length);
@@ -0,0 +1,334 @@
+/*
+Trace.c
+
+Structured tracing that costs next to nothing when nobody is listening.
+
+Every trace used to go through EventWriteStringW2, which formats a message into a 2 KB stack buffer with _vsnwprintf_s
+whether or not an ETW session is running, several times for every password. Here the hot path records a few numbers
+instead, and only after a single check of whether tracing is on at all:
+
+  - TraceEnabled() is one read of a global flag. PassFiltEx.c keeps the flag in sync with ETW from the provider's enable
+    callback, so when no session has enabled the provider, a trace costs a load and a branch.
+
+  - An event is a fixed-size TRACE_EVENT: an ID, a timestamp, a thread ID, four numbers and a few characters of text.
+    Nothing is formatted when it is written.
+
+  - Events go into one of TRACE_RING_COUNT rings, picked by thread ID, so threads rarely share one. Each ring is a bounded
+    lock-free queue in the style of Dmitry Vyukov's: every slot carries a sequence number that says whose turn it is, so
+    writers that do land on the same ring never wait for each other, and never for the reader. When a ring is full the
+    event is dropped and counted, rather than making a password change wait.
+
+  - TraceDrain empties the rings into a TRACE_SINK. TraceStartDrain gives it a thread of its own, the way NotifyQueue.c's
+    worker has one, which drains every so often, and straight away when a write leaves its ring TRACE_RING_HIGH_WATER full.
+    So a storm of password changes is drained as it comes rather than once a second, and a reload of a big blacklist, which
+    used to keep BlacklistThreadProc from draining for as long as it took, no longer holds events up. In the DLL the sink
+    turns events into ETW strings on that thread, well away from PasswordFilter. PassFiltExTool trace-bench uses a sink that
+    checks every event it gets back.
+
+The rings are only allocated the first time tracing is turned on, so a DLL that is never traced never pays for them.
+
+Platform-neutral C.
+
+*/
+
+#include <string.h>
+
+#include "Platform.h"
+
+#include "Trace.h"
+
+typedef char TRACE_RING_COUNT_CHECK[((TRACE_RING_COUNT & (TRACE_RING_COUNT - 1)) == 0) ? 1 : -1];
+
+typedef char TRACE_RING_SIZE_CHECK[((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0) ? 1 : -1];
+
+typedef struct TRACE_SLOT
+{
+	// Equal to the position a writer may claim the slot at, or one past it once the event is in and can be read.
+	volatile int32_t Sequence;
+
+	TRACE_EVENT Event;
+
+} TRACE_SLOT;
+
+typedef struct TRACE_RING
+{
+	// Next position to write. Shared by every writer on this ring.
+	volatile int32_t Head;
+
+	uint8_t HeadPadding[64 - sizeof(int32_t)];
+
+	// Next position to read. Only TraceDrain moves it; writes look at it to tell how full the ring is.
+	volatile int32_t Tail;
+
+	uint8_t TailPadding[64 - sizeof(int32_t)];
+
+	TRACE_SLOT Slots[TRACE_RING_SIZE];
+
+} TRACE_RING;
+
+static volatile int32_t gTraceEnabled;
+
+static volatile int32_t gTraceDropped;
+
+// NULL until tracing is turned on for the first time. Never freed after that.
+static TRACE_RING* volatile gTraceRings;
+
+// The drain thread's. Wake is NULL while there isn't one.
+static PLATFORM_EVENT* volatile gTraceDrainWake;
+
+static PLATFORM_THREAD* gTraceDrainThread;
+
+static TRACE_SINK gTraceDrainSink;
+
+static void* gTraceDrainContext;
+
+static uint32_t gTraceDrainMilliseconds;
+
+// Set by the write that wakes the drain thread, until it starts draining, so that a storm costs one wake per drain and not
+// one per event.
+static volatile int32_t gTraceDrainWakePending;
+
+static volatile int32_t gTraceDrainStopping;
+
+// Called whenever a trace session starts or stops listening. Not safe to call from two threads at once.
+void TraceSetEnabled(bool Enabled)
+{
+	if (Enabled && gTraceRings == NULL)
+	{
+		TRACE_RING* Rings = PlatformAllocate(sizeof(TRACE_RING) * TRACE_RING_COUNT);
+
+		// Without rings, there is nowhere to put events, so tracing stays off.
+		if (Rings == NULL)
+		{
+			return;
+		}
+
+		for (uint32_t Ring = 0; Ring < TRACE_RING_COUNT; Ring++)
+		{
+			for (int32_t Slot = 0; Slot < TRACE_RING_SIZE; Slot++)
+			{
+				Rings[Ring].Slots[Slot].Sequence = Slot;
+			}
+		}
+
+		PlatformExchangePointer((void* volatile*)&gTraceRings, Rings);
+	}
+
+	PlatformStore(&gTraceEnabled, Enabled ? 1 : 0);
+}
+
+bool TraceEnabled(void)
+{
+	return(PlatformLoad(&gTraceEnabled) != 0);
+}
+
+// Text is optional and is cut off after TRACE_TEXT_LENGTH characters.
+void TraceWrite(uint16_t Id, const uint64_t Values[TRACE_VALUE_COUNT], const uint16_t* Text, size_t TextLength)
+{
+	if (TraceEnabled() == false)
+	{
+		return;
+	}
+
+	uint32_t ThreadId = PlatformThreadId();
+
+	TRACE_RING* Ring = &gTraceRings[(ThreadId ^ (ThreadId >> 8)) & (TRACE_RING_COUNT - 1)];
+
+	int32_t Position = PlatformLoad(&Ring->Head);
+
+	TRACE_SLOT* Slot = NULL;
+
+	while (true)
+	{
+		Slot = &Ring->Slots[Position & (TRACE_RING_SIZE - 1)];
+
+		int32_t Difference = (int32_t)((uint32_t)PlatformLoad(&Slot->Sequence) - (uint32_t)Position);
+
+		if (Difference == 0)
+		{
+			int32_t Seen = PlatformCompareExchange(&Ring->Head, (int32_t)((uint32_t)Position + 1), Position);
+
+			if (Seen == Position)
+			{
+				break;
+			}
+
+			Position = Seen;
+		}
+		else if (Difference < 0)
+		{
+			// The reader hasn't caught up with this slot yet: the ring is full.
+			PlatformIncrement(&gTraceDropped);
+
+			return;
+		}
+		else
+		{
+			// Another writer got here first.
+			Position = PlatformLoad(&Ring->Head);
+		}
+	}
+
+	Slot->Event.Timestamp = PlatformTimestamp();
+
+	Slot->Event.Id = Id;
+
+	Slot->Event.ThreadId = ThreadId;
+
+	memcpy(Slot->Event.Values, Values, sizeof(Slot->Event.Values));
+
+	if (TextLength > TRACE_TEXT_LENGTH)
+	{
+		TextLength = TRACE_TEXT_LENGTH;
+	}
+
+	if (Text != NULL && TextLength > 0)
+	{
+		memcpy(Slot->Event.Text, Text, TextLength * sizeof(uint16_t));
+	}
+
+	Slot->Event.TextLength = (Text != NULL) ? (uint16_t)TextLength : 0;
+
+	// Only now may the reader have it.
+	PlatformStore(&Slot->Sequence, (int32_t)((uint32_t)Position + 1));
+
+	if ((int32_t)((uint32_t)Position + 1 - (uint32_t)PlatformLoad(&Ring->Tail)) >= TRACE_RING_HIGH_WATER && PlatformLoad(&gTraceDrainWakePending) == 0 && PlatformCompareExchange(&gTraceDrainWakePending, 1, 0) == 0)
+	{
+		PLATFORM_EVENT* Wake = PlatformLoadPointer((void* const volatile*)&gTraceDrainWake);
+
+		if (Wake != NULL)
+		{
+			PlatformEventSet(Wake);
+		}
+	}
+}
+
+/*
+Hands every event that has been written so far to Sink, ring by ring, and returns how many there were. Events from one
+thread come out in the order they were written; events from different threads can be put back in order by Timestamp.
+
+Only one thread may drain at a time.
+
+*/
+uint64_t TraceDrain(TRACE_SINK Sink, void* Context)
+{
+	uint64_t Drained = 0;
+
+	TRACE_RING* Rings = gTraceRings;
+
+	if (Rings == NULL)
+	{
+		return(0);
+	}
+
+	for (uint32_t RingIndex = 0; RingIndex < TRACE_RING_COUNT; RingIndex++)
+	{
+		TRACE_RING* Ring = &Rings[RingIndex];
+
+		while (true)
+		{
+			TRACE_SLOT* Slot = &Ring->Slots[Ring->Tail & (TRACE_RING_SIZE - 1)];
+
+			if (PlatformLoad(&Slot->Sequence) != (int32_t)((uint32_t)Ring->Tail + 1))
+			{
+				break;
+			}
+
+			Sink(Context, &Slot->Event);
+
+			// Free the slot for the writer that will get to it on the next lap.
+			PlatformStore(&Slot->Sequence, (int32_t)((uint32_t)Ring->Tail + TRACE_RING_SIZE));
+
+			PlatformStore(&Ring->Tail, (int32_t)((uint32_t)Ring->Tail + 1));
+
+			Drained++;
+		}
+	}
+
+	return(Drained);
+}
+
+static uint32_t TraceDrainProc(void* Argument)
+{
+	(void)Argument;
+
+	while (true)
+	{
+		// Looked at before draining, so that whatever was written before TraceStopDrain is handed over on the way out.
+		bool Stopping = (PlatformLoad(&gTraceDrainStopping) != 0);
+
+		PlatformStore(&gTraceDrainWakePending, 0);
+
+		TraceDrain(gTraceDrainSink, gTraceDrainContext);
+
+		if (Stopping)
+		{
+			break;
+		}
+
+		PlatformEventWait(gTraceDrainWake, gTraceDrainMilliseconds);
+	}
+
+	return(0);
+}
+
+/*
+Starts a thread that hands events to Sink every Milliseconds, and as soon as a ring passes TRACE_RING_HIGH_WATER. Nothing else
+may call TraceDrain until TraceStopDrain. Returns false if the thread couldn't be started, in which case nothing is drained.
+
+*/
+bool TraceStartDrain(TRACE_SINK Sink, void* Context, uint32_t Milliseconds)
+{
+	PLATFORM_EVENT* Wake = NULL;
+
+	gTraceDrainSink = Sink;
+
+	gTraceDrainContext = Context;
+
+	gTraceDrainMilliseconds = Milliseconds;
+
+	PlatformStore(&gTraceDrainStopping, 0);
+
+	if ((Wake = PlatformEventCreate()) == NULL)
+	{
+		return(false);
+	}
+
+	PlatformExchangePointer((void* volatile*)&gTraceDrainWake, Wake);
+
+	if ((gTraceDrainThread = PlatformStartThread(TraceDrainProc, NULL)) == NULL)
+	{
+		PlatformExchangePointer((void* volatile*)&gTraceDrainWake, NULL);
+
+		PlatformEventDestroy(Wake);
+
+		return(false);
+	}
+
+	return(true);
+}
+
+// Hands over everything written so far and stops the drain thread. Nothing may be traced while this runs.
+void TraceStopDrain(void)
+{
+	if (gTraceDrainThread == NULL)
+	{
+		return;
+	}
+
+	PlatformStore(&gTraceDrainStopping, 1);
+
+	PlatformEventSet(gTraceDrainWake);
+
+	PlatformJoinThread(gTraceDrainThread);
+
+	gTraceDrainThread = NULL;
+
+	PlatformEventDestroy(PlatformExchangePointer((void* volatile*)&gTraceDrainWake, NULL));
+}
+
+// Events thrown away because their ring was full, since the DLL was loaded.
+uint64_t TraceDroppedEvents(void)
+{
+	return((uint32_t)PlatformLoad(&gTraceDropped));
+}
@@ -0,0 +1,84 @@
+// Please read Trace.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+#include <stdint.h>
+
+// Enough for any sAMAccountName, which can be at most 20 characters long.
+#define TRACE_TEXT_LENGTH 20
+
+#define TRACE_VALUE_COUNT 4
+
+// Rings are picked by thread ID. A power of two.
+#define TRACE_RING_COUNT 16
+
+// Events per ring. A power of two. 16 rings of 1,024 take about 1.5 MB, and only once tracing has been turned on.
+#define TRACE_RING_SIZE 1024
+
+// A write that leaves its ring this full wakes the drain thread, instead of leaving the events to wait for the next drain,
+// so a storm of password changes fills a quarter of a ring between drains and not all of it.
+#define TRACE_RING_HIGH_WATER (TRACE_RING_SIZE / 4)
+
+typedef enum TRACE_EVENT_ID
+{
+	// Values: PASSWORD_VERDICT, 1 for a SET or 0 for a CHANGE, matched token index or AC_NO_PATTERN, elapsed microseconds.
+	// Text: account name.
+	TraceEventPasswordChecked = 1,
+
+	// Values: relative ID. Text: account name.
+	TraceEventPasswordChanged = 2,
+
+	// Values: unique tokens, automaton states, 1 if it came from an image or 0 from the text file, elapsed microseconds.
+	TraceEventBlacklistLoaded = 3,
+
+	// Values: hashes, Bloom filter blocks, 1 if the filter is resident, elapsed microseconds.
+	TraceEventBreachIndexLoaded = 4,
+
+	// Values: tokens in the overlay, overlay automaton states, elapsed microseconds, microseconds the last full rebuild took.
+	TraceEventBlacklistAppended = 5
+
+} TRACE_EVENT_ID;
+
+typedef struct TRACE_EVENT
+{
+	// PlatformTimestamp() ticks.
+	uint64_t Timestamp;
+
+	uint16_t Id;
+
+	uint16_t TextLength;
+
+	uint32_t ThreadId;
+
+	uint64_t Values[TRACE_VALUE_COUNT];
+
+	// Not null-terminated.
+	uint16_t Text[TRACE_TEXT_LENGTH];
+
+} TRACE_EVENT;
+
+typedef void (*TRACE_SINK)(void* Context, const TRACE_EVENT* Event);
+
+void TraceSetEnabled(bool Enabled);
+
+bool TraceEnabled(void);
+
+void TraceWrite(uint16_t Id, const uint64_t Values[TRACE_VALUE_COUNT], const uint16_t* Text, size_t TextLength);
+
+uint64_t TraceDrain(TRACE_SINK Sink, void* Context);
+
+bool TraceStartDrain(TRACE_SINK Sink, void* Context, uint32_t Milliseconds);
+
+void TraceStopDrain(void);
+
+uint64_t TraceDroppedEvents(void);
@@ -0,0 +1,115 @@
+/*
+WorkerPool.c
+
+Spreads the work of building a blacklist over a bounded number of threads.
+
+A reload used to parse, sort and compile the whole list on BlacklistThreadProc alone, so a big list took seconds to come
+into effect while the other processors sat idle. Now the build is cut into tasks (see BlacklistLoadParallel) and handed to
+a pool of at most ThreadCount threads, the blacklist thread being one of them.
+
+The pool is bounded on purpose. This runs inside lsass on a domain controller, and logons, replication and Kerberos need those
+processors far more than a reload does, so the DLL only ever uses a share of them (see WorkerPoolDefaultThreadCount).
+
+Each run starts its threads and joins them before it returns. Reloads are minutes or days apart, so there is nothing to gain
+from keeping threads parked between them, and a thread or two that fail to start only make the run slower: the calling thread
+works through the tasks too, so every task is always done. Tasks are claimed one at a time from a shared counter, so a thread
+that gets a slow one doesn't hold the others up.
+
+Platform-neutral C.
+
+*/
+
+#include "Platform.h"
+
+#include "WorkerPool.h"
+
+typedef struct WORKER_POOL_RUN
+{
+	WORKER_POOL_ROUTINE Routine;
+
+	void* Context;
+
+	uint32_t TaskCount;
+
+	volatile int32_t NextTask;
+
+} WORKER_POOL_RUN;
+
+static uint32_t WorkerPoolThreadProc(void* Argument)
+{
+	WORKER_POOL_RUN* Run = Argument;
+
+	while (true)
+	{
+		uint32_t Task = (uint32_t)(PlatformIncrement(&Run->NextTask) - 1);
+
+		if (Task >= Run->TaskCount)
+		{
+			break;
+		}
+
+		Run->Routine(Run->Context, Task);
+	}
+
+	return(0);
+}
+
+void WorkerPoolInitialize(WORKER_POOL* Pool, uint32_t ThreadCount)
+{
+	if (ThreadCount == 0)
+	{
+		ThreadCount = 1;
+	}
+
+	Pool->ThreadCount = (ThreadCount > WORKER_POOL_MAX_THREADS) ? WORKER_POOL_MAX_THREADS : ThreadCount;
+}
+
+// Half of the processors, leaving the rest to whatever else the machine is for, and no more than Limit.
+uint32_t WorkerPoolDefaultThreadCount(uint32_t Limit)
+{
+	uint32_t Count = PlatformProcessorCount() / 2;
+
+	if (Count > Limit)
+	{
+		Count = Limit;
+	}
+
+	return((Count > 0) ? Count : 1);
+}
+
+// Pool may be NULL, which is the same as a pool of one thread.
+uint32_t WorkerPoolThreadCount(const WORKER_POOL* Pool)
+{
+	return((Pool != NULL) ? Pool->ThreadCount : 1);
+}
+
+// Runs Routine once for every task from 0 to TaskCount - 1, and returns once all of them are done. Pool may be NULL.
+void WorkerPoolRun(const WORKER_POOL* Pool, uint32_t TaskCount, WORKER_POOL_ROUTINE Routine, void* Context)
+{
+	PLATFORM_THREAD* Threads[WORKER_POOL_MAX_THREADS] = { NULL };
+
+	WORKER_POOL_RUN Run = { Routine, Context, TaskCount, 0 };
+
+	uint32_t ThreadCount = WorkerPoolThreadCount(Pool);
+
+	if (ThreadCount > TaskCount)
+	{
+		ThreadCount = TaskCount;
+	}
+
+	// The calling thread is one of them.
+	for (uint32_t Thread = 1; Thread < ThreadCount; Thread++)
+	{
+		Threads[Thread] = PlatformStartThread(WorkerPoolThreadProc, &Run);
+	}
+
+	WorkerPoolThreadProc(&Run);
+
+	for (uint32_t Thread = 1; Thread < ThreadCount; Thread++)
+	{
+		if (Threads[Thread] != NULL)
+		{
+			PlatformJoinThread(Threads[Thread]);
+		}
+	}
+}
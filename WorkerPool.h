@@ -0,0 +1,32 @@
+// Please read WorkerPool.c for full commentary.
+
+#pragma once
+
+#ifdef _MSC_VER
+
+#pragma warning(disable: 4820)
+
+#endif
+
+#include <stdint.h>
+
+// No run uses more threads than this, however many processors there are.
+#define WORKER_POOL_MAX_THREADS 64
+
+// Called once for each task of a run, on whichever thread claims it. Tasks of the same run may run at the same time.
+typedef void (*WORKER_POOL_ROUTINE)(void* Context, uint32_t Task);
+
+typedef struct WORKER_POOL
+{
+	// Threads a run may use, the calling thread included. 1 runs every task on the calling thread.
+	uint32_t ThreadCount;
+
+} WORKER_POOL;
+
+void WorkerPoolInitialize(WORKER_POOL* Pool, uint32_t ThreadCount);
+
+uint32_t WorkerPoolDefaultThreadCount(uint32_t Limit);
+
+uint32_t WorkerPoolThreadCount(const WORKER_POOL* Pool);
+
+void WorkerPoolRun(const WORKER_POOL* Pool, uint32_t TaskCount, WORKER_POOL_ROUTINE Routine, void* Context);